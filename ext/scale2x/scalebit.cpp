@@ -469,3 +469,74 @@ void scale(unsigned scale, void* void_dst, unsigned dst_slice, const void* void_
 	}
 }
 
+
+// OpenJazz addition
+
+/**
+ * Apply the Scale effect on a band of rows of a bitmap.
+ * Rows bordering the band are read but never written, so separate bands of
+ * the same bitmap may be scaled at the same time.
+ * \param scale Scale factor. 2, 203 (fox 2x3), 204 (for 2x4) or 3.
+ * \param void_dst Pointer at the first pixel of the destination bitmap.
+ * \param dst_slice Size in bytes of a destination bitmap row.
+ * \param void_src Pointer at the first pixel of the source bitmap.
+ * \param src_slice Size in bytes of a source bitmap row.
+ * \param pixel Bytes per pixel of the source and destination bitmap.
+ * \param width Horizontal size in pixels of the source bitmap.
+ * \param height Vertical size in pixels of the source bitmap.
+ * \param first First source row of the band.
+ * \param count Number of source rows in the band.
+ * \return
+ *   - -1 if the scale factor cannot be applied a band at a time.
+ *   - 0 on success.
+ */
+int scale_band(unsigned scale, void* void_dst, unsigned dst_slice, const void* void_src, unsigned src_slice, unsigned pixel, unsigned width, unsigned height, unsigned first, unsigned count)
+{
+	unsigned char* dst;
+	const unsigned char* src = (const unsigned char*)void_src;
+	const unsigned char* src0;
+	const unsigned char* src2;
+	unsigned rows;
+	unsigned y;
+
+	switch (scale) {
+	case 202 :
+	case 2 :
+		rows = 2;
+		break;
+	case 203 :
+	case 303 :
+	case 3 :
+		rows = 3;
+		break;
+	case 204 :
+		rows = 4;
+		break;
+	default :
+		return -1;
+	}
+
+	for (y = first; y < first + count; ++y) {
+		dst = (unsigned char*)void_dst + y * rows * dst_slice;
+		src0 = src + (y > 0 ? y - 1 : 0) * src_slice;
+		src2 = src + (y + 1 < height ? y + 1 : y) * src_slice;
+
+		switch (scale) {
+		case 202 :
+		case 2 :
+			stage_scale2x(SCDST(0), SCDST(1), src0, SCSRC(y), src2, pixel, width);
+			break;
+		case 203 :
+			stage_scale2x3(SCDST(0), SCDST(1), SCDST(2), src0, SCSRC(y), src2, pixel, width);
+			break;
+		case 204 :
+			stage_scale2x4(SCDST(0), SCDST(1), SCDST(2), SCDST(3), src0, SCSRC(y), src2, pixel, width);
+			break;
+		default :
+			stage_scale3x(SCDST(0), SCDST(1), SCDST(2), src0, SCSRC(y), src2, pixel, width);
+			break;
+		}
+	}
+
+	return 0;
+}
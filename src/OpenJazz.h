@@ -65,6 +65,10 @@
 // Standard string length
 #define STRING_LENGTH 32
 
+// Lengths of buffers for names and paths built without allocating
+#define FILE_NAME_LENGTH 32
+#define PATH_LENGTH      256
+
 // Return values
 #define E_N_OTHER      -(0x26)
 #define E_N_DISCONNECT -(0x25)
@@ -73,6 +77,7 @@
 #define E_N_LISTEN     -(0x22)
 #define E_N_BIND       -(0x21)
 #define E_N_SOCKET     -(0x20)
+#define E_REGRESSION   -(0x16)
 #define E_DATA         -(0x15)
 #define E_VERSION      -(0x14)
 #define E_TIMEOUT      -(0x13)
@@ -0,0 +1,85 @@
+
+/**
+ *
+ * @file clock.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created clock.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Reads the performance counter, counting from the moment the clock started
+ * so that its milliseconds match SDL_GetTicks(). Whole seconds and the rest
+ * are converted separately, so that fast counters do not overflow.
+ *
+ */
+
+
+#include "clock.h"
+
+
+static Uint64 clockFrequency = 0; ///< Performance counter ticks per second, or 0 if the counter is not used
+static Uint64 clockCounter = 0; ///< The performance counter when the clock started
+static Uint64 clockStart = 0; ///< The time when the clock started
+
+
+/**
+ * Start the clock. Must be called before any other thread reads it.
+ */
+void startClock () {
+
+#ifdef SDL2
+	clockFrequency = SDL_GetPerformanceFrequency();
+	clockCounter = SDL_GetPerformanceCounter();
+#endif
+
+	clockStart = (Uint64)SDL_GetTicks() * (CLOCK_RATE / 1000);
+
+	return;
+
+}
+
+
+/**
+ * Get the time.
+ *
+ * @return The time, in microseconds
+ */
+Uint64 getClock () {
+
+#ifdef SDL2
+	Uint64 elapsed;
+
+	if (clockFrequency) {
+
+		elapsed = SDL_GetPerformanceCounter() - clockCounter;
+
+		return clockStart + ((elapsed / clockFrequency) * CLOCK_RATE) +
+			(((elapsed % clockFrequency) * CLOCK_RATE) / clockFrequency);
+
+	}
+#endif
+
+	return (Uint64)SDL_GetTicks() * (CLOCK_RATE / 1000);
+
+}
+
+
+/**
+ * Get the time to the nearest millisecond below.
+ *
+ * @return The time, in milliseconds
+ */
+unsigned int getTicks () {
+
+	return (unsigned int)(getClock() / (CLOCK_RATE / 1000));
+
+}
+
@@ -0,0 +1,51 @@
+
+/**
+ *
+ * @file clock.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created clock.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * A monotonic clock with microsecond resolution, for pacing frames and steps
+ * and for timing. Its milliseconds keep step with SDL_GetTicks().
+ *
+ */
+
+
+#ifndef _CLOCK_H
+#define _CLOCK_H
+
+
+#include "OpenJazz.h"
+
+#define SDL2
+
+#ifdef SDL2
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+
+// Constant
+
+#define CLOCK_RATE 1000000 /* Clock units in a second */
+
+
+// Functions
+
+EXTERN void         startClock ();
+EXTERN Uint64       getClock   ();
+EXTERN unsigned int getTicks   ();
+
+#endif
+
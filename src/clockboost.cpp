@@ -0,0 +1,88 @@
+
+/**
+ *
+ * @file clockboost.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created clockboost.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Raises the processor's clock for as long as any phase of loading is under
+ * way. Phases nest, and may run on several threads at once, so the clock is
+ * only changed as the first begins and the last ends. On the Switch, the CPU
+ * boost mode is used. Elsewhere the clock is left to the operating system.
+ *
+ */
+
+
+#include "clockboost.h"
+
+#ifdef __SWITCH__
+	#include <switch.h>
+#endif
+
+
+/**
+ * Create the clock boost, with nothing loading.
+ */
+ClockBoost::ClockBoost () {
+
+	lock = 0;
+	depth = 0;
+
+	return;
+
+}
+
+
+/**
+ * Note the start of a phase of loading, raising the clock if it is the first.
+ */
+void ClockBoost::begin () {
+
+	SDL_AtomicLock(&lock);
+
+#ifdef __SWITCH__
+	if (!depth) appletSetCpuBoostMode(ApmCpuBoostMode_FastLoad);
+#endif
+
+	depth++;
+
+	SDL_AtomicUnlock(&lock);
+
+	return;
+
+}
+
+
+/**
+ * Note the end of a phase of loading, restoring the clock if it was the last.
+ */
+void ClockBoost::end () {
+
+	SDL_AtomicLock(&lock);
+
+	if (depth) {
+
+		depth--;
+
+#ifdef __SWITCH__
+		if (!depth) appletSetCpuBoostMode(ApmCpuBoostMode_Normal);
+#endif
+
+	}
+
+	SDL_AtomicUnlock(&lock);
+
+	return;
+
+}
+
@@ -0,0 +1,59 @@
+
+/**
+ *
+ * @file clockboost.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created clockboost.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _CLOCKBOOST_H
+#define _CLOCKBOOST_H
+
+
+#include "OpenJazz.h"
+
+#define SDL2
+
+#ifdef SDL2
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+
+// Class
+
+/// Raises the processor's clock while anything is loading, where the platform
+/// allows it
+class ClockBoost {
+
+	private:
+		SDL_SpinLock lock; ///< Guards the depth
+		int          depth; ///< Number of loading phases under way, across all threads
+
+	public:
+		ClockBoost ();
+
+		void begin ();
+		void end   ();
+
+};
+
+
+// Variable
+
+EXTERN ClockBoost clockBoost; ///< Raises the clock while loading
+
+#endif
+
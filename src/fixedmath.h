@@ -0,0 +1,129 @@
+
+/**
+ *
+ * @file fixedmath.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created fixedmath.h from parts of util.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Fixed-point trigonometry. The sine table is made by the compiler, so it
+ * needs no filling at start-up, and holds the same values on every platform
+ * whatever its maths library, which keeps replays and network games in step.
+ *
+ */
+
+
+#ifndef _FIXEDMATH_H
+#define _FIXEDMATH_H
+
+
+#include "OpenJazz.h"
+
+
+// Constants
+
+#define FANGLES    1024 /* Angles in a full circle */
+#define FSIN_TERMS 20 /* Terms of the series used to make the sine table */
+
+
+// Datatype
+
+/// Sine of each angle, followed by a further quarter circle so that cosines
+/// need no second wrap
+class FixedSinTable {
+
+	public:
+		fixed values[FANGLES + (FANGLES >> 2)]; ///< Sine of each angle
+
+		/**
+		 * Find the sine of an angle, in radians, from its Taylor series.
+		 *
+		 * @param x The angle, from 0 to 2 pi
+		 *
+		 * @return The sine of the angle
+		 */
+		static constexpr double taylorSin (double x) {
+
+			// Constant expressions need their variables set as they are declared
+			double term = x;
+			double sum = x;
+			int count = 1;
+
+			for (; count < FSIN_TERMS; count++) {
+
+				term *= -x * x / ((2 * count) * ((2 * count) + 1));
+				sum += term;
+
+			}
+
+			return sum;
+
+		}
+
+
+		/**
+		 * Fill the table. The angles and rounding follow the single-precision
+		 * sums the table was once filled with at start-up, so the values have
+		 * not changed.
+		 */
+		constexpr FixedSinTable () : values() {
+
+			int count = 0;
+
+			for (; count < FANGLES + (FANGLES >> 2); count++) {
+
+				values[count] = fixed(float(taylorSin(double(2 * 3.141592f *
+					float(count & (FANGLES - 1)) / float(FANGLES)))) * 1024.0f);
+
+			}
+
+		}
+
+};
+
+
+// Variable
+
+inline constexpr FixedSinTable fixedSinTable; ///< Sine of each angle
+
+
+// Functions
+
+/**
+ * Get the sine of the given angle
+ *
+ * @param angle The given angle (where 1024 represents a full circle)
+ *
+ * @return The sine of the angle
+ */
+inline fixed fSin (fixed angle) {
+
+	return fixedSinTable.values[angle & (FANGLES - 1)];
+
+}
+
+
+/**
+ * Get the cosine of the given angle
+ *
+ * @param angle The given angle (where 1024 represents a full circle)
+ *
+ * @return The cosine of the angle
+ */
+inline fixed fCos (fixed angle) {
+
+	return fixedSinTable.values[(angle & (FANGLES - 1)) + (FANGLES >> 2)];
+
+}
+
+#endif
+
@@ -22,6 +22,8 @@
 
 #include "game.h"
 #include "gamemode.h"
+#include "snapshot.h"
+#include "wire.h"
 
 #include "io/controls.h"
 #include "io/file.h"
@@ -30,9 +32,14 @@
 #include "io/network.h"
 #include "player/player.h"
 #include "loop.h"
+#include "memtrack.h"
+#include "pacer.h"
+#include "scratch.h"
 #include "setup.h"
 #include "util.h"
 
+#include "../miniz.h"
+
 #include <string.h>
 
 
@@ -40,30 +47,44 @@
  * Create game client
  *
  * @param address Address of the server to which to connect
+ * @param spectate Whether to watch the game, following the existing players,
+ * rather than join it
  */
-ClientGame::ClientGame (char* address) {
+ClientGame::ClientGame (char* address, bool spectate) : rate(T_CSEND, T_CSEND_MAX) {
 
 	unsigned char buffer[BUFFER_LENGTH];
 	unsigned int timeout;
-	int count, ret;
+	int sock, ret;
 	GameModeType modeType;
 
+	MEMORY_SCOPE(MEM_NETWORK);
+
 	sock = net->join(address);
 
 	if (sock < 0) throw sock; // Tee hee hee hee hee.
 
+	// The connection is read and written by the network thread from now on
+	channel = net->open(sock);
+
+	if (!channel) {
+
+		net->close(sock);
+
+		throw E_N_OTHER;
+
+	}
+
 
 	// Receive initialisation message
 
-	count = 0;
 	timeout = globalTicks + T_SCHECK + T_TIMEOUT;
 
 	// Wait for whole message to arrive
-	while (count < MTL_G_PROPS) {
+	while (true) {
 
 		if (loop(NORMAL_LOOP) == E_QUIT) {
 
-			net->close(sock);
+			net->close(channel);
 
 			throw E_QUIT;
 
@@ -71,25 +92,23 @@ ClientGame::ClientGame (char* address) {
 
 		if (controls.release(C_ESCAPE)) {
 
-			net->close(sock);
+			net->close(channel);
 
 			throw E_RETURN;
 
 		}
 
-		SDL_Delay(T_MENU_FRAME);
+		pacer.idle(true);
 
 		video.clearScreen(0);
 		fontmn2->showString("WAITING FOR REPLY", canvasW >> 2, (canvasH >> 1) - 16);
 		fontmn2->setPalette(canvas->format->palette->colors);
 
-		ret = net->recv(sock, buffer + count, MTL_G_PROPS - count);
-
-		if (ret > 0) count += ret;
+		if (channel->getMessage(buffer)) break;
 
 		if (globalTicks > timeout) {
 
-			net->close(sock);
+			net->close(channel);
 
 			throw E_TIMEOUT;
 
@@ -100,13 +119,13 @@ ClientGame::ClientGame (char* address) {
 	// Make sure message is valid
 	if (buffer[1] != MT_G_PROPS) {
 
-		net->close(sock);
+		net->close(channel);
 
 		throw E_DATA;
 
-	} else if (buffer[2] != 1) {
+	} else if (buffer[2] != NET_VERSION) {
 
-		net->close(sock);
+		net->close(channel);
 
 		throw E_VERSION;
 
@@ -125,7 +144,7 @@ ClientGame::ClientGame (char* address) {
 
 	if (nPlayers > maxPlayers) {
 
-		net->close(sock);
+		net->close(channel);
 
 		throw E_DATA;
 
@@ -136,7 +155,7 @@ ClientGame::ClientGame (char* address) {
 
 	if (!mode) {
 
-		net->close(sock);
+		net->close(channel);
 
 		throw E_DATA;
 
@@ -151,15 +170,22 @@ ClientGame::ClientGame (char* address) {
 	// Download the level from the server
 
 	levelFile = createString(LEVEL_FILE);
-	file = NULL;
+	levelPacked = NULL;
+	levelArrived = false;
+	snapshots = NULL;
+	rtt = -1;
+	udpSock = -1;
+	spectator = spectate;
+	localPlayer = NULL;
 
 	ret = setLevel(NULL);
 
 	if (ret < 0) {
 
-		net->close(sock);
+		net->close(channel);
 
-		if (file) delete file;
+		if (levelPacked) delete[] levelPacked;
+		stopDatagrams();
 
 		delete mode;
 
@@ -167,7 +193,7 @@ ClientGame::ClientGame (char* address) {
 
 	}
 
-	// Add a new player to the game
+	// Add a new player to the game, unless only watching
 
 	buffer[0] = MTL_G_PJOIN + strlen(setup.characterName);
 	buffer[1] = MT_G_PJOIN;
@@ -179,17 +205,16 @@ ClientGame::ClientGame (char* address) {
 	send(buffer);
 
 
-	// Wait for acknowledgement
-
-	localPlayer = NULL;
+	// Wait for acknowledgement, or for a player to follow
 
 	while (!localPlayer) {
 
 		if (loop(NORMAL_LOOP) == E_QUIT) {
 
-			net->close(sock);
+			net->close(channel);
 
-			if (file) delete file;
+			if (levelPacked) delete[] levelPacked;
+			stopDatagrams();
 
 			delete mode;
 
@@ -199,9 +224,10 @@ ClientGame::ClientGame (char* address) {
 
 		if (controls.release(C_ESCAPE)) {
 
-			net->close(sock);
+			net->close(channel);
 
-			if (file) delete file;
+			if (levelPacked) delete[] levelPacked;
+			stopDatagrams();
 
 			delete mode;
 
@@ -210,16 +236,17 @@ ClientGame::ClientGame (char* address) {
 		}
 
 		video.clearScreen(0);
-		fontmn2->showString("JOINING GAME", canvasW >> 2, (canvasH >> 1) - 16);
+		fontmn2->showString(spectator? "WAITING FOR PLAYERS": "JOINING GAME", canvasW >> 2, (canvasH >> 1) - 16);
 		fontmn2->setPalette(canvas->format->palette->colors);
 
 		ret = step(0);
 
 		if (ret < 0) {
 
-			net->close(sock);
+			net->close(channel);
 
-			if (file) delete file;
+			if (levelPacked) delete[] levelPacked;
+			stopDatagrams();
 
 			delete mode;
 
@@ -239,9 +266,10 @@ ClientGame::ClientGame (char* address) {
  */
 ClientGame::~ClientGame () {
 
-	net->close(sock);
+	net->close(channel);
 
-	if (file) delete file;
+	if (levelPacked) delete[] levelPacked;
+	stopDatagrams();
 
 	delete mode;
 
@@ -265,14 +293,15 @@ int ClientGame::setLevel (char* fileName) {
 
 	video.setPalette(menuPalette);
 
-	// Wait for level data to start arriving
-	while (!file && levelFile) {
+	// Wait for level data to start arriving, unless the level has already
+	// been found in the cache
+	while (!levelPacked && !levelArrived && levelFile) {
 
 		if (loop(NORMAL_LOOP) == E_QUIT) return E_QUIT;
 
 		if (controls.release(C_ESCAPE)) return E_RETURN;
 
-		SDL_Delay(T_MENU_FRAME);
+		pacer.idle(true);
 
 		video.clearScreen(0);
 		fontmn2->showString("WAITING FOR SERVER", canvasW >> 2, (canvasH >> 1) - 16);
@@ -285,17 +314,17 @@ int ClientGame::setLevel (char* fileName) {
 	}
 
 	// Wait for level data to finish arriving
-	while (file && levelFile) {
+	while (levelPacked && levelFile) {
 
 		if (loop(NORMAL_LOOP) == E_QUIT) return E_QUIT;
 
 		if (controls.release(C_ESCAPE)) return E_RETURN;
 
-		SDL_Delay(T_MENU_FRAME);
+		pacer.idle(true);
 
 		video.clearScreen(0);
 		fontmn2->showString("downloaded", canvasW >> 2, (canvasH >> 1) - 16);
-		fontmn2->showNumber(file->tell(), (canvasW >> 2) + 56, canvasH >> 1);
+		fontmn2->showNumber(levelReceived, (canvasW >> 2) + 56, canvasH >> 1);
 		fontmn2->showString("bytes", (canvasW >> 2) + 64, canvasH >> 1);
 		fontmn2->setPalette(canvas->format->palette->colors);
 
@@ -305,25 +334,227 @@ int ClientGame::setLevel (char* fileName) {
 
 	}
 
+	levelArrived = false;
+
 	return E_NONE;
 
 }
 
 
 /**
- * Send data to server
+ * Queue data to be sent to the server at the end of the next iteration
  *
  * @param buffer Data to send. First byte indicates length.
  */
 void ClientGame::send (unsigned char* buffer) {
 
-	net->send(sock, buffer);
+	unsigned char packed[BUFFER_LENGTH];
+
+	// Steps taken again have already told the server everything
+	if (baseLevel && baseLevel->isResimulating()) return;
+
+	// Spectators only take part in the exchange of levels
+	if (spectator && (buffer[1] != MT_G_LCACHE) && (buffer[1] != MT_G_PING) &&
+		(buffer[1] != MT_G_LSYNC))
+		return;
+
+	packMessage(buffer, packed);
+	sendQueue.add(packed, buffer[1] == MT_P_TEMP);
+
+	return;
+
+}
+
+
+/**
+ * Close the datagram socket, if open.
+ */
+void ClientGame::stopDatagrams () {
+
+	if (udpSock != -1) net->close(udpSock);
+	udpSock = -1;
+
+	if (snapshots) delete snapshots;
+	snapshots = NULL;
 
 	return;
 
 }
 
 
+/**
+ * Receive player state from any datagrams which have arrived from the server
+ */
+void ClientGame::receiveStates () {
+
+	unsigned char packet[SNAPSHOT_SIZE];
+	unsigned char (*states)[MTL_P_TEMP];
+	unsigned int address;
+	int datagrams, length, port, count, nStates;
+
+	states = (unsigned char (*)[MTL_P_TEMP])frameAllocate(MAX_PLAYERS * MTL_P_TEMP);
+
+	// Limit the number of datagrams taken at once, in case of a flood
+	for (datagrams = 0; datagrams < MAX_PLAYERS; datagrams++) {
+
+		length = net->recvFrom(udpSock, packet, SNAPSHOT_SIZE, &address, &port);
+
+		if (length < 0) break;
+
+		if ((address != serverAddress) || (port != NET_PORT)) continue;
+
+		nStates = snapshots->decode(packet, length, states);
+
+		for (count = 0; count < nStates; count++) {
+
+			if ((states[count][2] < nPlayers) &&
+				(spectator || (players + states[count][2] != localPlayer))) {
+
+				players[states[count][2]].receive(states[count]);
+				if (baseLevel) baseLevel->logMessage(states[count]);
+
+			}
+
+		}
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Send the local player's state to the server as a datagram
+ *
+ * @param state The MT_P_TEMP state
+ */
+void ClientGame::sendState (unsigned char* state) {
+
+	unsigned char packet[5 + SNAPSHOT_SIZE];
+	int length;
+
+	// Identify the client to the server
+	packet[0] = clientID;
+	packet[1] = udpToken >> 24;
+	packet[2] = (udpToken >> 16) & 255;
+	packet[3] = (udpToken >> 8) & 255;
+	packet[4] = udpToken & 255;
+
+	length = snapshots->encode(packet + 5, &state, 1, SNAPSHOT_SIZE);
+
+	net->sendTo(udpSock, packet, 5 + length, serverAddress, NET_PORT);
+
+	return;
+
+}
+
+
+/**
+ * Use the cache entry for the incoming level, and see if it already holds the
+ * level.
+ *
+ * @return Whether or not the level is in the cache
+ */
+bool ClientGame::findLevel () {
+
+	File* file;
+	unsigned char* data;
+	char name[32];
+	bool found;
+
+	snprintf(name, sizeof(name), LEVEL_CACHE, levelHash, levelSize);
+
+	if (levelFile) delete[] levelFile;
+	levelFile = createString(name);
+
+	try {
+
+		file = new File(levelFile, false);
+
+	} catch (int e) {
+
+		return false;
+
+	}
+
+	found = false;
+
+	// Make sure the entry is complete and intact
+	if (file->getSize() == levelSize) {
+
+		data = file->loadBlock(levelSize);
+		found = (mz_crc32(MZ_CRC32_INIT, data, levelSize) == levelHash);
+		delete[] data;
+
+	}
+
+	delete file;
+
+	return found;
+
+}
+
+
+/**
+ * Receive as much of the compressed level as has arrived. Once all of it has
+ * arrived, decompress it and write it to the level file.
+ *
+ * @return Error code
+ */
+int ClientGame::receiveLevel () {
+
+	File* file;
+	unsigned char* data;
+	mz_ulong length;
+	int ret;
+
+	ret = channel->read(levelPacked + levelReceived, packedSize - levelReceived);
+
+	if (ret > 0) levelReceived += ret;
+
+	if (levelReceived < packedSize) return E_NONE;
+
+	data = new unsigned char[levelSize];
+	length = levelSize;
+
+	ret = mz_uncompress(data, &length, levelPacked, packedSize);
+
+	delete[] levelPacked;
+	levelPacked = NULL;
+
+	if ((ret != MZ_OK) || (length != (mz_ulong)levelSize)) {
+
+		delete[] data;
+
+		return E_DATA;
+
+	}
+
+	try {
+
+		file = new File(levelFile, true);
+
+	} catch (int e) {
+
+		delete[] data;
+
+		return e;
+
+	}
+
+	file->storeBlock(data, levelSize);
+
+	delete file;
+	delete[] data;
+
+	levelArrived = true;
+
+	return E_NONE;
+
+}
+
+
 /**
  * Game iteration
  *
@@ -334,180 +565,228 @@ void ClientGame::send (unsigned char* buffer) {
 int ClientGame::step (unsigned int ticks) {
 
 	unsigned char sendBuffer[BUFFER_LENGTH];
-	int length, count;
-	bool firstMessage;
+	unsigned char recvBuffer[BUFFER_LENGTH];
+	int count, ret;
 
 	// Receive data from server
 
-	if (received == 0) {
+	if (snapshots) receiveStates();
 
-		// Not currently receiving a message
-		// See if there is a new message to receive
+	if (levelPacked) {
 
-		length = net->recv(sock, recvBuffer, 1);
+		// Receiving the compressed level
 
-		if (length > 0) received++;
+		ret = receiveLevel();
 
-	}
+		if (ret < 0) return ret;
 
-	if (received > 0) {
+	}
 
-		// Currently receiving a message
-		// See if there is any more data
+	// Deal with each whole message that has arrived, until the compressed
+	// level, which does not arrive as messages
+	while (!levelPacked && channel->getMessage(recvBuffer)) {
 
-		length = net->recv(sock, recvBuffer + received,
-			recvBuffer[0] - received);
+		if (!unpackMessage(recvBuffer)) continue;
 
-		if (length > 0) received += length;
+		switch (recvBuffer[1] & MCMASK) {
 
+			case MC_GAME:
 
-		// See if the whole message has arrived
+				if (recvBuffer[1] == MT_G_LEVEL) {
 
-		if (received >= recvBuffer[0]) {
+					packedSize = (recvBuffer[2] << 24) + (recvBuffer[3] << 16) +
+						(recvBuffer[4] << 8) + recvBuffer[5];
+					levelSize = (recvBuffer[6] << 24) + (recvBuffer[7] << 16) +
+						(recvBuffer[8] << 8) + recvBuffer[9];
 
-			switch (recvBuffer[1] & MCMASK) {
+					if (!packedSize) {
 
-				case MC_GAME:
+						// The run of levels has ended
 
-					if (recvBuffer[1] == MT_G_LEVEL) {
+						delete[] levelFile;
+						levelFile = NULL;
 
-						if (!file) {
+						break;
 
-							// Not already storing level data, so open the file
+					}
 
-							try {
+					if ((packedSize < 0) || (levelSize <= 0) ||
+						(levelSize > MAX_LEVEL_SIZE) ||
+						(packedSize > (int)mz_compressBound(levelSize)))
+						return E_DATA;
 
-								file = new File(levelFile, true);
+					levelHash = (recvBuffer[10] << 24) + (recvBuffer[11] << 16) +
+						(recvBuffer[12] << 8) + recvBuffer[13];
 
-							} catch (int e) {
+					// Tell the server whether or not the level is needed
+					sendBuffer[0] = MTL_G_LCACHE;
+					sendBuffer[1] = MT_G_LCACHE;
 
-								return e;
+					if (findLevel()) {
 
-							}
+						levelArrived = true;
+						sendBuffer[2] = 1;
 
-							firstMessage = true;
+					} else {
 
-						} else firstMessage = false;
+						// The compressed level follows, outside of the
+						// usual messages
+						levelPacked = new unsigned char[packedSize];
+						levelReceived = 0;
+						sendBuffer[2] = 0;
 
-						file->seek((recvBuffer[2] << 8) + recvBuffer[3], true);
+					}
 
-						for (count = 4; count < recvBuffer[0]; count++)
-							file->storeChar(recvBuffer[count]);
+					send(sendBuffer);
 
-						// If a zero-length block has been sent, it is the last
-						if (recvBuffer[0] == MTL_G_LEVEL) {
+					break;
 
-							if (firstMessage) {
+				}
 
-								// If the last message was also the first,
-								// then the run of levels has ended
+				if ((recvBuffer[1] == MT_G_PJOIN) &&
+					(recvBuffer[3] < maxPlayers)) {
 
-								delete[] levelFile;
-								levelFile = NULL;
+					printf("Player %d joined the game.\n", recvBuffer[3]);
 
-							}
+					// Add the new player, and any that have been missed
 
-							delete file;
-							file = NULL;
+					for (count = nPlayers; count <= recvBuffer[3]; count++) {
 
-						}
+						players[count].init(this, (char *)recvBuffer + 9,
+							recvBuffer + 5, recvBuffer[4]);
+						addLevelPlayer(players + count);
 
-						break;
+						printf("Player %d joined team %d.\n", count, recvBuffer[4]);
 
 					}
 
-					if ((recvBuffer[1] == MT_G_PJOIN) &&
-						(recvBuffer[3] < maxPlayers)) {
+					nPlayers = count;
 
-						printf("Player %d joined the game.\n", recvBuffer[3]);
+					if (!spectator && (recvBuffer[2] == clientID))
+						localPlayer = players + recvBuffer[3];
 
-						// Add the new player, and any that have been missed
+				}
 
-						for (count = nPlayers; count <= recvBuffer[3]; count++) {
+				if ((recvBuffer[1] == MT_G_PQUIT) &&
+					(recvBuffer[2] < nPlayers)) {
 
-							players[count].init(this, (char *)recvBuffer + 9,
-								recvBuffer + 5, recvBuffer[4]);
-							addLevelPlayer(players + count);
+					printf("Player %d left the game.\n", recvBuffer[2]);
 
-							printf("Player %d joined team %d.\n", count, recvBuffer[4]);
+					// Remove the player
 
-						}
+					nPlayers--;
 
-						nPlayers = count;
+					players[recvBuffer[2]].deinit();
 
-						if (recvBuffer[2] == clientID)
-							localPlayer = players + recvBuffer[3];
+					// If necessary, move more recent players
+					for (count = recvBuffer[2]; count < nPlayers; count++)
+						memcpy(static_cast<void*>(players + count), players + count + 1,
+							sizeof(Player));
 
-					}
+					// Clear duplicate pointers
+					memset(static_cast<void*>(players + nPlayers), 0, sizeof(Player));
 
-					if ((recvBuffer[1] == MT_G_PQUIT) &&
-						(recvBuffer[2] < nPlayers)) {
+					// Follow another player if the followed player has left
+					// The server's own player never leaves
+					if (spectator && (localPlayer >= players + nPlayers))
+						localPlayer = players;
 
-						printf("Player %d left the game.\n", recvBuffer[2]);
+				}
 
-						// Remove the player
+				if (recvBuffer[1] == MT_G_CHECK) {
 
-						players[recvBuffer[2]].deinit();
+					checkX = recvBuffer[2];
+					checkY = recvBuffer[3];
 
-						// If necessary, move more recent players
-						for (count = recvBuffer[2]; count < nPlayers; count++)
-							memcpy(static_cast<void*>(players + count), players + count + 1,
-								sizeof(Player));
+					if (recvBuffer[0] > 4) {
 
-						// Clear duplicate pointers
-						memset(static_cast<void*>(players + nPlayers), 0, sizeof(Player));
+						checkX += recvBuffer[4] << 8;
+						checkY += recvBuffer[5] << 8;
 
 					}
 
-					if (recvBuffer[1] == MT_G_CHECK) {
+				}
 
-						checkX = recvBuffer[2];
-						checkY = recvBuffer[3];
+				if (recvBuffer[1] == MT_G_SCORE) {
 
-						if (recvBuffer[0] > 4) {
+					for (count = 0; count < nPlayers; count++) {
 
-							checkX += recvBuffer[4] << 8;
-							checkY += recvBuffer[5] << 8;
-
-						}
+						if (players[count].getTeam() == recvBuffer[2])
+							players[count].teamScore++;
 
 					}
 
-					if (recvBuffer[1] == MT_G_SCORE) {
+				}
+
+				if ((recvBuffer[1] == MT_G_UDP) && !snapshots &&
+					net->getPeer(channel->getSock(), &serverAddress)) {
 
-						for (count = 0; count < nPlayers; count++) {
+					// The server can exchange player state as datagrams
+					udpSock = net->openDatagram(0);
 
-							if (players[count].getTeam() == recvBuffer[2])
-								players[count].teamScore++;
+					if (udpSock != -1) {
 
-						}
+						snapshots = new Snapshots(maxPlayers);
+						udpToken = (recvBuffer[2] << 24) + (recvBuffer[3] << 16) +
+							(recvBuffer[4] << 8) + recvBuffer[5];
 
 					}
 
-					if (recvBuffer[1] == MT_G_LTYPE) {
+				}
+
+				if (recvBuffer[1] == MT_G_PING) {
+
+					if (recvBuffer[2]) {
+
+						// A ping sent to the server has returned
+						rtt = globalTicks -
+							((recvBuffer[3] << 24) + (recvBuffer[4] << 16) +
+							(recvBuffer[5] << 8) + recvBuffer[6]);
+
+					} else {
 
-						levelType = (LevelType)recvBuffer[2];
+						// Return the server's ping
+						recvBuffer[2] = 1;
+						send(recvBuffer);
 
 					}
 
-					break;
+				}
 
-				case MC_LEVEL:
+				if (recvBuffer[1] == MT_G_LTYPE) {
 
-					if (baseLevel) baseLevel->receive(recvBuffer);
+					levelType = (LevelType)recvBuffer[2];
 
-					break;
+				}
 
-				case MC_PLAYER:
+				break;
 
-					if (recvBuffer[2] < maxPlayers)
-						players[recvBuffer[2]].receive(recvBuffer);
+			case MC_LEVEL:
 
-					break;
+				if (baseLevel) {
 
-			}
+					baseLevel->receive(recvBuffer);
+					baseLevel->logMessage(recvBuffer);
+
+				}
+
+				break;
+
+			case MC_PLAYER:
 
-			received = 0;
+				if (recvBuffer[1] == MT_P_INPUT) {
+
+					// Controls are applied at the step they took effect
+					if (baseLevel) baseLevel->receiveInput(recvBuffer);
+
+				} else if (recvBuffer[2] < maxPlayers) {
+
+					players[recvBuffer[2]].receive(recvBuffer);
+					if (baseLevel) baseLevel->logMessage(recvBuffer);
+
+				}
+
+				break;
 
 		}
 
@@ -517,20 +796,38 @@ int ClientGame::step (unsigned int ticks) {
 
 		// Check for disconnection
 
-		if (!(net->isConnected(sock))) {
+		if (channel->isClosed()) {
 
-			if (file) delete file;
-			file = NULL;
+			if (levelPacked) delete[] levelPacked;
+			levelPacked = NULL;
 
 			return E_N_DISCONNECT;
 
 		}
 
+		// Measure the round-trip time to the server
+		sendBuffer[0] = MTL_G_PING;
+		sendBuffer[1] = MT_G_PING;
+		sendBuffer[2] = 0;
+		sendBuffer[3] = globalTicks >> 24;
+		sendBuffer[4] = (globalTicks >> 16) & 255;
+		sendBuffer[5] = (globalTicks >> 8) & 255;
+		sendBuffer[6] = globalTicks & 255;
+		send(sendBuffer);
+
 		checkTime = ticks + T_CCHECK;
 
 	}
 
-	if (localPlayer && (ticks >= sendTime)) {
+	if (spectator) {
+
+		// Follow the first player until another is chosen
+		if (!localPlayer && nPlayers) localPlayer = players;
+
+		if (localPlayer && controls.release(C_CHANGE))
+			localPlayer = players + ((localPlayer - players + 1) % nPlayers);
+
+	} else if (localPlayer && (ticks >= sendTime)) {
 
 		// Update server
 
@@ -538,12 +835,22 @@ int ClientGame::step (unsigned int ticks) {
 		sendBuffer[1] = MT_P_TEMP;
 		sendBuffer[2] = 0;
 		localPlayer->send(sendBuffer);
-		send(sendBuffer);
 
-		sendTime = ticks + T_CSEND;
+		// Until the server is known to receive datagrams, also send the
+		// state as a message
+		if (snapshots) sendState(sendBuffer);
+		if (!snapshots || !snapshots->isAcknowledged()) send(sendBuffer);
+
+		// Updates are sent less often while the connection is backed up
+		rate.update(channel, &sendQueue, rtt, ticks);
+		sendTime = ticks + rate.getInterval();
 
 	}
 
+	// Send everything queued this iteration, holding back what the connection
+	// could only deliver late
+	sendQueue.flush(channel, rate.getBacklog());
+
 	return E_NONE;
 
 }
@@ -592,3 +899,79 @@ void ClientGame::setCheckpoint (int gridX, int gridY) {
 }
 
 
+/**
+ * Get the network statistics for the connection to the server, which carries
+ * every player.
+ *
+ * @param player The player
+ * @param stats Statistics to which the connection's traffic is added
+ *
+ * @return Whether or not the player is the local player
+ */
+bool ClientGame::getStats (Player *player, NetStats *stats) {
+
+	if (player != localPlayer) return false;
+
+	channel->getStats(stats);
+	sendQueue.getStats(stats);
+	rate.getStats(stats);
+
+	stats->rtt = rtt;
+
+	if (levelPacked) {
+
+		stats->levelSent = levelReceived;
+		stats->levelSize = packedSize;
+
+	}
+
+	return true;
+
+}
+
+
+/**
+ * Ask the server for the changes made to the level, which was loaded without
+ * them.
+ */
+void ClientGame::syncLevel () {
+
+	unsigned char buffer[MTL_G_LSYNC];
+
+	buffer[0] = MTL_G_LSYNC;
+	buffer[1] = MT_G_LSYNC;
+	send(buffer);
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not the client only watches the game.
+ *
+ * @return True if following the existing players rather than playing
+ */
+bool ClientGame::isSpectating () {
+
+	return spectator;
+
+}
+
+
+/**
+ * Determine whether or not levels may be rolled back when other players'
+ * controls arrive late. Only small battles and races, which depend most on
+ * exact timing, roll back.
+ *
+ * @return True if levels may roll back
+ */
+bool ClientGame::canRollBack () {
+
+	if (!setup.rollback || spectator || (maxPlayers > ROLLBACK_PLAYERS)) return false;
+
+	return (mode->getMode() == M_BATTLE) || (mode->getMode() == M_TEAMBATTLE) ||
+		(mode->getMode() == M_RACE);
+
+}
+
@@ -32,6 +32,9 @@
 #include "jj1level/jj1level.h"
 #include "jj1planet/jj1planet.h"
 #include "jj2level/jj2level.h"
+#include "level/benchmark.h"
+#include "level/replay.h"
+#include "loop.h"
 #include "player/player.h"
 #include "util.h"
 
@@ -49,6 +52,9 @@ Game::Game () {
 	players = NULL;
 	baseLevel = NULL;
 
+	demoLevel = NULL;
+	demoFile = NULL;
+
 	return;
 
 }
@@ -59,6 +65,9 @@ Game::Game () {
  */
 Game::~Game () {
 
+	if (demoLevel) delete demoLevel;
+	if (demoFile) delete[] demoFile;
+
 	if (levelFile) delete[] levelFile;
 
 	if (players) delete[] players;
@@ -154,6 +163,22 @@ int Game::getDifficulty () {
 }
 
 
+/**
+ * Get the level checkpoint.
+ *
+ * @param gridX X-coordinate (in tiles) of the checkpoint
+ * @param gridY Y-coordinate (in tiles) of the checkpoint
+ */
+void Game::getCheckpoint (int& gridX, int& gridY) {
+
+	gridX = checkX;
+	gridY = checkY;
+
+	return;
+
+}
+
+
 /**
  * Set the game's difficulty
  */
@@ -178,25 +203,59 @@ int Game::playLevel (char* fileName, bool intro, bool checkpoint) {
 
 	multiplayer = (mode->getMode() != M_SINGLE);
 
+	// Replays cover single-player levels, but not demos, nor the second
+	// player's controls
+	if (!multiplayer && (nPlayers == 1) && !isFileType(fileName, "macro", 5))
+		replay.start(fileName, difficulty);
+
 	if (isFileType(fileName, "macro", 5)) {
 
-		// Load and play the level
+		// A demo played before is put back to its state when it was loaded,
+		// rather than being loaded again
+		if (demoLevel && (strcmp(demoFile, fileName) || !demoLevel->restart())) {
 
-		try {
+			delete demoLevel;
+			demoLevel = NULL;
 
-			baseLevel = level = new JJ1DemoLevel(this, fileName);
+			delete[] demoFile;
+			demoFile = NULL;
 
-		} catch (int e) {
+		}
 
-			return e;
+		if (!demoLevel) {
+
+			// Load the level
+
+			try {
+
+				demoLevel = new JJ1DemoLevel(this, fileName);
+
+			} catch (int e) {
+
+				return e;
+
+			}
+
+			demoFile = createString(fileName);
 
 		}
 
+		baseLevel = level = demoLevel;
+
 		ret = level->play();
 
-		delete level;
 		baseLevel = level = NULL;
 
+		if (ret < 0) {
+
+			delete demoLevel;
+			demoLevel = NULL;
+
+			delete[] demoFile;
+			demoFile = NULL;
+
+		} else demoLevel->suspend();
+
 	} else if (levelType == LT_JJ1BONUS) {
 
 		JJ1BonusLevel *bonus;
@@ -211,7 +270,9 @@ int Game::playLevel (char* fileName, bool intro, bool checkpoint) {
 
 		}
 
-		ret = bonus->play();
+		if (headless) ret = bonus->serve();
+		else if (bench.getMode()) ret = bonus->benchmark();
+		else ret = bonus->play();
 
 		delete bonus;
 		baseLevel = NULL;
@@ -228,7 +289,11 @@ int Game::playLevel (char* fileName, bool intro, bool checkpoint) {
 
 		}
 
-		ret = jj2Level->play();
+		splitView(jj2Level);
+
+		if (headless) ret = jj2Level->serve();
+		else if (bench.getMode()) ret = jj2Level->benchmark();
+		else ret = jj2Level->play();
 
 		delete jj2Level;
 		baseLevel = jj2Level = NULL;
@@ -245,12 +310,17 @@ int Game::playLevel (char* fileName, bool intro, bool checkpoint) {
 
 		}
 
-		if (intro) {
+		// Changes made while the level was loading have been missed
+		if (multiplayer) syncLevel();
+
+		splitView(level);
+
+		if (intro && !bench.getMode()) {
 
 			JJ1Planet *planet;
-			char *planetFileName = NULL;
+			char planetFileName[FILE_NAME_LENGTH];
 
-			planetFileName = createFileName("PLANET", level->getWorld());
+			writeFileName(planetFileName, FILE_NAME_LENGTH, "PLANET", level->getWorld());
 
 			try {
 
@@ -262,8 +332,6 @@ int Game::playLevel (char* fileName, bool intro, bool checkpoint) {
 
 			}
 
-			delete[] planetFileName;
-
 			if (planet) {
 
 				if (planet->play() == E_QUIT) {
@@ -283,13 +351,17 @@ int Game::playLevel (char* fileName, bool intro, bool checkpoint) {
 
 		}
 
-		ret = level->play();
+		if (headless) ret = level->serve();
+		else if (bench.getMode()) ret = level->benchmark();
+		else ret = level->play();
 
 		delete level;
 		baseLevel = level = NULL;
 
 	}
 
+	replay.stop();
+
 	return ret;
 
 }
@@ -427,6 +499,76 @@ void Game::view (int change) {
 }
 
 
+/**
+ * Get the network statistics for the connection a player is played over.
+ *
+ * @param player The player
+ * @param stats Statistics to which the connection's traffic is added
+ *
+ * @return Whether or not the player is played over a connection
+ */
+bool Game::getStats (Player *player, NetStats *stats) {
+
+	(void)player;
+	(void)stats;
+
+	return false;
+
+}
+
+
+/**
+ * Bring a newly-loaded level up to date with the rest of the game. Only
+ * clients need to do this.
+ */
+void Game::syncLevel () {
+
+	return;
+
+}
+
+
+/**
+ * Choose the views of a newly-loaded level to show. Only local games with more
+ * than one player split the canvas.
+ *
+ * @param newLevel The level about to be played
+ */
+void Game::splitView (Level* newLevel) {
+
+	(void)newLevel;
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not the game is only being watched, so the local player
+ * is another player being followed.
+ *
+ * @return True if only watching
+ */
+bool Game::isSpectating () {
+
+	return false;
+
+}
+
+
+/**
+ * Determine whether or not levels may be rolled back when other players'
+ * controls arrive late.
+ *
+ * @return True if levels may roll back
+ */
+bool Game::canRollBack () {
+
+	return false;
+
+}
+
+
 /**
  * Make a player restart the level from the beginning/last checkpoint
  *
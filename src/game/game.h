@@ -34,9 +34,12 @@
 
 // Time intervals
 #define T_SSEND   20
+#define T_SSEND_MAX 200 /* Longest interval between updates to a client with a slow connection */
 #define T_SCHECK  1000
 #define T_CSEND   10
+#define T_CSEND_MAX 100 /* Longest interval between updates to a server over a slow connection */
 #define T_CCHECK  1000
+#define T_STATS   10000
 
 // Message categories and types
 #define MCMASK     0xF0
@@ -51,37 +54,75 @@
 #define MT_G_CHECK 0x04
 #define MT_G_SCORE 0x05 /* Team scored a roast/lap/etc. */
 #define MT_G_LTYPE 0x06 /* Level type */
+#define MT_G_LCACHE 0x07 /* Whether or not the client already has the level */
+#define MT_G_UDP   0x08 /* Player state may be sent as datagrams */
+#define MT_G_PING  0x09 /* Round-trip time measurement, returned to the sender */
+#define MT_G_LSYNC 0x0A /* The client has loaded the level, and needs the changes made to it */
 
 #define MT_L_PROP  0x10 /* Level property */
 #define MT_L_GRID  0x11 /* Change to gridElement */
 #define MT_L_STAGE 0x12 /* Change in level stage */
+#define MT_L_GRIDS 0x13 /* Runs of changes to grid elements */
 
 #define MT_P_ANIMS 0x20 /* Player animations */
 #define MT_P_TEMP  0x21 /* Temporary player properties, e.g. position */
+#define MT_P_INPUT 0x22 /* Player controls, from the step at which they took effect */
 
 // Minimum message lengths, including header
 #define MTL_G_PROPS 8
 #define MTL_G_PJOIN 10
 #define MTL_G_PQUIT 3
-#define MTL_G_LEVEL 4 /* + amount of level data */
+#define MTL_G_LEVEL 14 /* Followed by the compressed level data, unless the client has the level */
 #define MTL_G_CHECK 6
 #define MTL_G_SCORE 3
 #define MTL_G_LTYPE 3
+#define MTL_G_LCACHE 3
+#define MTL_G_UDP   6
+#define MTL_G_PING  7
+#define MTL_G_LSYNC 2
 
 #define MTL_L_PROP  5
 #define MTL_L_GRID  8
 #define MTL_L_STAGE 3
+#define MTL_L_GRIDS 2 /* + MTL_L_RUN for each run */
+#define MTL_L_RUN   5
 
 #define MTL_P_ANIMS 3 /* + PANIMS, BPANIMS, or 1 (for JJ2) */
 #define MTL_P_TEMP  46
+#define MTL_P_INPUT 8
 
 #define BUFFER_LENGTH 255 /* Should always be big enough to hold any message */
 
+// Multiplayer protocol version
+#define NET_VERSION 8
+
+// Largest level the client will accept
+#define MAX_LEVEL_SIZE 0x1000000
+
+// Name of a received level in the client's cache, from its hash and size
+#define LEVEL_CACHE "openjazz-%08x-%d.tmp"
+
+// Interest management, by which servers send each client less about what is
+// far from its player
+#define INTEREST_CELL  3 /* Cells of interest are (1 << INTEREST_CELL) tiles across */
+#define INTEREST_NEAR  3 /* Cells within which other players' state is sent every time */
+#define INTEREST_RATE  4 /* Sends for each state sent of players further away */
+#define INTEREST_GRID  4 /* Cells within which grid changes are sent, beyond the view */
+#define INTEREST_RUNS  256 /* Most deferred grid runs for each client */
+
+// Network statistics written periodically by servers
+#define STATS_FILE "netstats.json"
+
+// Most characters taken by each client in the statistics file
+#define STATS_LENGTH 4096
+
 
 // Classes
 
 class Anim;
 class File;
+class JJ1DemoLevel;
+class Snapshots;
 
 /// Base class for game handling classes
 class Game {
@@ -101,6 +142,8 @@ class Game {
 		unsigned int   checkTime; ///< The next time a connection/disconnection will be dealt with
 		short int      checkX; ///< X-coordinate of the level checkpoint
 		short int      checkY; ///< Y-coordinate of the level checkpoint
+		JJ1DemoLevel*  demoLevel; ///< Demo level kept to be played again, or NULL
+		char*          demoFile; ///< Name of the kept demo level's macro file
 
 		Game ();
 
@@ -117,6 +160,7 @@ class Game {
 		GameMode*    getMode       ();
 		int          getDifficulty ();
 		void         setDifficulty (int diff);
+		void         getCheckpoint (int& gridX, int& gridY);
 		int          playLevel     (char *fileName);
 		virtual int  setLevel      (char *fileName) = 0;
 		int          play          ();
@@ -125,16 +169,21 @@ class Game {
 		virtual int  step          (unsigned int ticks) = 0;
 		virtual void score         (unsigned char team) = 0;
 		virtual void setCheckpoint (int gridX, int gridY) = 0;
+		virtual bool getStats      (Player *player, NetStats *stats);
+		virtual void syncLevel     ();
+		virtual void splitView     (Level* newLevel);
+		virtual bool isSpectating  ();
+		virtual bool canRollBack   ();
 		void         resetPlayer   (Player *player);
 
 };
 
 
-/// Game handling for single-player local play
+/// Game handling for local play, by one player or two sharing the screen
 class LocalGame : public Game {
 
 	public:
-		LocalGame  (const char *firstLevel, int gameDifficulty);
+		LocalGame  (const char *firstLevel, int gameDifficulty, int localPlayers);
 		~LocalGame ();
 
 		int  setLevel      (char *fileName);
@@ -142,6 +191,39 @@ class LocalGame : public Game {
 		int  step          (unsigned int ticks);
 		void score         (unsigned char team);
 		void setCheckpoint (int gridX, int gridY);
+		void splitView     (Level* newLevel);
+
+};
+
+
+/// Connection to a client of a multiplayer server
+class ServerClient {
+
+	public:
+		ServerClient  *next; ///< Next client
+		int            id; ///< Client's index on the server
+		int            status; /**< Client's status
+ 			-3: Level header sent, waiting for the client to say whether or not it has the level
+			-2: Connected and operational
+ 			-1: Disconnected, to be removed
+			0: Level header not yet sent
+			>0: 1 + number of bytes of the compressed level that have been sent */
+		int            player; ///< Index of the client's player, or -1 if it has not joined
+		NetChannel    *channel; ///< Connection to the client
+		NetQueue       sendQueue; ///< Messages waiting to be sent to the client
+		Snapshots     *snapshots; ///< Player state datagram history, or NULL if the client has no datagrams
+		unsigned int   udpToken; ///< Token identifying the client's datagrams
+		unsigned int   udpAddress; ///< The client's address
+		int            udpPort; ///< The client's datagram port, or 0 if not yet known
+		int            rtt; ///< Round-trip time to the client in milliseconds, or -1 if not yet measured
+		unsigned char (*held)[MTL_P_TEMP]; ///< The last state of each player sent to the client as a datagram, or NULL if the client has no datagrams
+		unsigned char  deferred[INTEREST_RUNS][MTL_L_RUN]; ///< Grid runs waiting for the client's view to approach them, oldest first
+		int            nDeferred; ///< Number of deferred grid runs
+		NetRate        rate; ///< Paces player state sent to the client
+		unsigned int   stateTime; ///< The next time player state is due to be sent to the client
+
+		ServerClient  (ServerClient* nextClient, int clientID, NetChannel* clientChannel);
+		~ServerClient ();
 
 };
 
@@ -149,18 +231,39 @@ class LocalGame : public Game {
 /// Game handling for multiplayer servers
 class ServerGame : public Game {
 
-	private:
-		int            clientStatus[MAX_CLIENTS]; /**< Array of client statuses
- 			-2: Connected and operational
- 			-1: Not connected
-			>=0: Number of bytes of the level that have been sent */
-		int            clientPlayer[MAX_CLIENTS]; ///< Array of client player indexes
-		int            clientSock[MAX_CLIENTS]; ///< Array of client sockets
-		unsigned char  recvBuffers[MAX_CLIENTS][BUFFER_LENGTH]; ///< Array of buffers containing data received from clients
-		int            received[MAX_CLIENTS]; ///< Array containing the amount of data received from each client
+	protected:
+		ServerClient  *clients; ///< Connected clients
+		int            nClients; ///< Number of connected clients
+		int            maxClients; ///< Most clients which may connect
+		int            maxPlayers; ///< Most players the game may have
+		bool           watchOnly; ///< Whether clients may only watch, rather than join
 		unsigned char *levelData; ///< Contents of the current level file
 		int            levelSize; ///< Size of the current level file
+		unsigned char *levelPacked; ///< Compressed contents of the current level file
+		int            packedSize; ///< Size of the compressed level
+		unsigned int   levelHash; ///< CRC-32 of the current level file
 		int            sock; ///< Server socket
+		int            udpSock; ///< Server datagram socket, or -1 if datagrams are not available
+		unsigned int   statsTime; ///< The next time the network statistics will be written
+		unsigned int   sends; ///< Number of times player state has been sent
+
+		ServerGame ();
+
+	private:
+		bool getView       (ServerClient* client, int* cellX, int* cellY);
+		bool isInterested  (ServerClient* client, int player);
+		bool isNear        (ServerClient* client, unsigned char* run);
+		bool isDue         (ServerClient* client);
+		void addRun        (ServerClient* client, unsigned char* buffer, unsigned char* run);
+		void sendRuns      (ServerClient* client, unsigned char* buffer);
+		void sendDeferred  (ServerClient* client);
+		void sendState     (ServerClient* client);
+		void disconnect    (ServerClient* client);
+		void accept        (unsigned int ticks);
+		void receiveStates ();
+		void sendStates    (unsigned char states[][MTL_P_TEMP]);
+		void gatherStats   (ServerClient* client, NetStats *stats);
+		void writeStats    ();
 
 	public:
 		ServerGame         (GameModeType mode, char *firstLevel, int gameDifficulty);
@@ -171,6 +274,7 @@ class ServerGame : public Game {
 		int  step          (unsigned int ticks);
 		void score         (unsigned char team);
 		void setCheckpoint (int gridX, int gridY);
+		bool getStats      (Player *player, NetStats *stats);
 
 };
 
@@ -179,15 +283,32 @@ class ServerGame : public Game {
 class ClientGame : public Game {
 
 	private:
-		File          *file; ///< File to which the incoming level will be written
-		unsigned char  recvBuffer[BUFFER_LENGTH]; ///< Buffer containing data received from server
-		int            received; ///< Amount of data received from server
+		unsigned char *levelPacked; ///< Buffer receiving the compressed level, if a transfer is in progress
+		int            packedSize; ///< Size of the compressed level
+		int            levelSize; ///< Size of the level once decompressed
+		int            levelReceived; ///< Amount of the compressed level received so far
+		unsigned int   levelHash; ///< CRC-32 of the incoming level
+		bool           levelArrived; ///< Whether or not the level has arrived since it was last waited for
+		NetQueue       sendQueue; ///< Messages waiting to be sent to the server
+		Snapshots     *snapshots; ///< Player state datagram history, or NULL if datagrams are not in use
+		unsigned int   udpToken; ///< Token identifying the client's datagrams
+		unsigned int   serverAddress; ///< The server's address
+		int            udpSock; ///< Client datagram socket, or -1 if datagrams are not in use
 		int            clientID; ///< Client's index on the server
 		int            maxPlayers; ///< The maximum number of players in the game
-		int            sock; ///< Client socket
+		NetChannel    *channel; ///< Connection to the server
+		int            rtt; ///< Round-trip time to the server in milliseconds, or -1 if not yet measured
+		NetRate        rate; ///< Paces player state sent to the server
+		bool           spectator; ///< Whether or not the client only watches, without joining
+
+		bool findLevel     ();
+		int  receiveLevel  ();
+		void stopDatagrams ();
+		void receiveStates ();
+		void sendState     (unsigned char *state);
 
 	public:
-		ClientGame         (char *address);
+		ClientGame         (char *address, bool spectate);
 		~ClientGame        ();
 
 		int  setLevel      (char *fileName);
@@ -195,6 +316,42 @@ class ClientGame : public Game {
 		int  step          (unsigned int ticks);
 		void score         (unsigned char team);
 		void setCheckpoint (int gridX, int gridY);
+		bool getStats      (Player *player, NetStats *stats);
+		void syncLevel     ();
+		bool isSpectating  ();
+		bool canRollBack   ();
+
+};
+
+
+/// Game handling for relays, which watch a server and pass on everything it
+/// sends to clients of their own, who may only watch
+class RelayGame : public ServerGame {
+
+	private:
+		NetChannel    *upstream; ///< Connection to the server
+		NetQueue       upstreamQueue; ///< Messages waiting to be sent to the server
+		unsigned char *incoming; ///< Buffer receiving the server's compressed level, if a transfer is in progress
+		int            incomingSize; ///< Size of the incoming compressed level
+		int            incomingLevelSize; ///< Size of the incoming level once decompressed
+		int            incomingReceived; ///< Amount of the incoming compressed level received so far
+		unsigned int   incomingHash; ///< CRC-32 of the incoming level
+		LevelType      incomingType; ///< Type of the incoming level
+		bool           levelArrived; ///< Whether or not a level has arrived since it was last waited for
+
+		int  receiveLevel   ();
+		int  receiveMessage (unsigned char *buffer);
+
+	public:
+		RelayGame          (char *address);
+		~RelayGame         ();
+
+		int  setLevel      (char *fileName);
+		void send          (unsigned char *buffer);
+		int  step          (unsigned int ticks);
+		void score         (unsigned char team);
+		void setCheckpoint (int gridX, int gridY);
+		void syncLevel     ();
 
 };
 
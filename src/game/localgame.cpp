@@ -26,18 +26,22 @@
 #include "game.h"
 #include "gamemode.h"
 
+#include "level/level.h"
 #include "player/player.h"
 #include "setup.h"
 #include "util.h"
 
 
 /**
- * Create a single-player local game
+ * Create a local game
  *
  * @param firstLevel File name of the first level to play
  * @param gameDifficulty Difficulty setting
+ * @param localPlayers Number of players sharing the screen, 1 or 2
  */
-LocalGame::LocalGame (const char *firstLevel, int gameDifficulty) {
+LocalGame::LocalGame (const char *firstLevel, int gameDifficulty, int localPlayers) {
+
+	char *secondName;
 
 	levelFile = createString(firstLevel);
 	levelType = getLevelType(firstLevel);
@@ -46,11 +50,19 @@ LocalGame::LocalGame (const char *firstLevel, int gameDifficulty) {
 
 	mode = new SingleGameMode();
 
-	// Create the player
-	nPlayers = 1;
-	localPlayer = players = new Player[1];
+	// Create the players, the second using the second set of controls
+	nPlayers = (localPlayers > 1)? 2: 1;
+	localPlayer = players = new Player[nPlayers];
 	localPlayer->init(this, setup.characterName, NULL, 0);
 
+	if (nPlayers > 1) {
+
+		secondName = createString(setup.characterName, " 2");
+		players[1].init(this, secondName, NULL, 0);
+		delete[] secondName;
+
+	}
+
 	return;
 
 }
@@ -141,6 +153,28 @@ void LocalGame::score (unsigned char team) {
 }
 
 
+/**
+ * Show each local player's view side by side, if there is more than one.
+ *
+ * @param newLevel The level about to be played
+ */
+void LocalGame::splitView (Level* newLevel) {
+
+	Player* viewers[MAX_VIEWPORTS];
+	int count;
+
+	if (nPlayers < 2) return;
+
+	for (count = 0; (count < nPlayers) && (count < MAX_VIEWPORTS); count++)
+		viewers[count] = players + count;
+
+	newLevel->setViewers(viewers, count);
+
+	return;
+
+}
+
+
 /**
  * Set the checkpoint
  *
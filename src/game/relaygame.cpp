@@ -0,0 +1,562 @@
+
+/**
+ *
+ * @file relaygame.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created relaygame.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * A relay connects to a server as a client without a player, and passes on
+ * everything the server sends to clients of its own, who may only watch. This
+ * lets many spectators watch a game without each of them adding to the load
+ * on the server.
+ *
+ */
+
+
+#include "game.h"
+#include "gamemode.h"
+
+#include "io/file.h"
+#include "io/gfx/video.h"
+#include "io/network.h"
+#include "player/player.h"
+#include "level/level.h"
+#include "loop.h"
+#include "pacer.h"
+#include "util.h"
+
+#include "../miniz.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/**
+ * Create a relay, connected to the server it passes on
+ *
+ * @param address Address of the server to which to connect
+ */
+RelayGame::RelayGame (char* address) {
+
+	unsigned char buffer[BUFFER_LENGTH];
+	unsigned int timeout;
+	int upstreamSock, ret;
+
+	incoming = NULL;
+	incomingType = LT_JJ1;
+	levelArrived = false;
+
+	upstreamSock = net->join(address);
+
+	if (upstreamSock < 0) throw upstreamSock;
+
+	upstream = net->open(upstreamSock);
+
+	if (!upstream) {
+
+		net->close(upstreamSock);
+
+		throw E_N_OTHER;
+
+	}
+
+
+	// Receive initialisation message
+
+	timeout = globalTicks + T_SCHECK + T_TIMEOUT;
+
+	while (!upstream->getMessage(buffer)) {
+
+		if (loop(NORMAL_LOOP) == E_QUIT) {
+
+			net->close(upstream);
+
+			throw E_QUIT;
+
+		}
+
+		pacer.idle(true);
+
+		if (globalTicks > timeout) {
+
+			net->close(upstream);
+
+			throw E_TIMEOUT;
+
+		}
+
+	}
+
+	if (buffer[1] != MT_G_PROPS) {
+
+		net->close(upstream);
+
+		throw E_DATA;
+
+	} else if (buffer[2] != NET_VERSION) {
+
+		net->close(upstream);
+
+		throw E_VERSION;
+
+	}
+
+	printf("Relaying server (version %d).\n", buffer[2]);
+
+	difficulty = buffer[4];
+	maxPlayers = buffer[5];
+
+	if (!maxPlayers || (maxPlayers > MAX_PLAYERS) || (buffer[6] > maxPlayers)) {
+
+		net->close(upstream);
+
+		throw E_DATA;
+
+	}
+
+	mode = createMode(GameModeType(buffer[3]));
+
+	if (!mode) {
+
+		net->close(upstream);
+
+		throw E_DATA;
+
+	}
+
+	// The players are those of the server
+	nPlayers = 0;
+	players = new Player[maxPlayers];
+
+
+	// Wait for the first level, and for the server's players to be announced
+
+	while (!levelArrived || (levelFile && !nPlayers)) {
+
+		if (loop(NORMAL_LOOP) == E_QUIT) ret = E_QUIT;
+		else ret = step(0);
+
+		if (ret < 0) {
+
+			net->close(upstream);
+
+			if (incoming) delete[] incoming;
+
+			throw ret;
+
+		}
+
+		pacer.idle(true);
+
+	}
+
+	levelArrived = false;
+
+	// The relay has no player of its own, so the view follows the server's
+	localPlayer = players;
+
+	return;
+
+}
+
+
+/**
+ * Disconnect from the server and destroy the relay
+ */
+RelayGame::~RelayGame () {
+
+	net->close(upstream);
+
+	if (incoming) delete[] incoming;
+
+	return;
+
+}
+
+
+/**
+ * Wait for the server to send the next level
+ *
+ * @param fileName Ignored, as the server chooses the level
+ *
+ * @return Error code
+ */
+int RelayGame::setLevel (char* fileName) {
+
+	(void)fileName;
+
+	int ret;
+
+	while (!levelArrived) {
+
+		if (loop(NORMAL_LOOP) == E_QUIT) return E_QUIT;
+
+		pacer.idle(true);
+
+		ret = step(0);
+
+		if (ret < 0) return ret;
+
+	}
+
+	levelArrived = false;
+
+	// Make sure the clients are told the run has ended
+	if (!levelFile) step(0);
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Ignore data from the relay's own copy of the game, as the clients receive
+ * the server's
+ *
+ * @param buffer Data to send. First byte indicates length.
+ */
+void RelayGame::send (unsigned char* buffer) {
+
+	(void)buffer;
+
+	return;
+
+}
+
+
+/**
+ * Receive as much of the server's compressed level as has arrived. Once all of
+ * it has arrived, decompress it, write it to the level file and offer it to
+ * the clients.
+ *
+ * @return Error code
+ */
+int RelayGame::receiveLevel () {
+
+	ServerClient* client;
+	File* file;
+	unsigned char* data;
+	mz_ulong length;
+	int ret;
+
+	ret = upstream->read(incoming + incomingReceived, incomingSize - incomingReceived);
+
+	if (ret > 0) incomingReceived += ret;
+
+	if (incomingReceived < incomingSize) return E_NONE;
+
+	data = new unsigned char[incomingLevelSize];
+	length = incomingLevelSize;
+
+	ret = mz_uncompress(data, &length, incoming, incomingSize);
+
+	if ((ret != MZ_OK) || (length != (mz_ulong)incomingLevelSize)) {
+
+		delete[] data;
+		delete[] incoming;
+		incoming = NULL;
+
+		return E_DATA;
+
+	}
+
+	try {
+
+		file = new File(LEVEL_FILE, true);
+
+	} catch (int e) {
+
+		delete[] data;
+		delete[] incoming;
+		incoming = NULL;
+
+		return e;
+
+	}
+
+	file->storeBlock(data, incomingLevelSize);
+
+	delete file;
+
+	// The compressed level is passed on exactly as it arrived
+	if (levelFile) delete[] levelFile;
+	if (levelData) delete[] levelData;
+	if (levelPacked) delete[] levelPacked;
+
+	levelFile = createString(LEVEL_FILE);
+	levelData = data;
+	levelSize = incomingLevelSize;
+	levelPacked = incoming;
+	packedSize = incomingSize;
+	levelHash = incomingHash;
+	levelType = incomingType;
+
+	incoming = NULL;
+
+	// The new level will be sent to all clients
+	for (client = clients; client; client = client->next) {
+
+		if (client->status != -1) client->status = 0;
+
+	}
+
+	levelArrived = true;
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Act on a message from the server, and pass it on to the clients
+ *
+ * @param buffer The message
+ *
+ * @return Error code
+ */
+int RelayGame::receiveMessage (unsigned char* buffer) {
+
+	unsigned char sendBuffer[MTL_G_LCACHE];
+	int count;
+
+	switch (buffer[1] & MCMASK) {
+
+		case MC_GAME:
+
+			if (buffer[1] == MT_G_LEVEL) {
+
+				incomingSize = (buffer[2] << 24) + (buffer[3] << 16) +
+					(buffer[4] << 8) + buffer[5];
+				incomingLevelSize = (buffer[6] << 24) + (buffer[7] << 16) +
+					(buffer[8] << 8) + buffer[9];
+
+				if (!incomingSize) {
+
+					// The run of levels has ended, for the clients too
+					ServerGame::setLevel(NULL);
+					levelArrived = true;
+
+					return E_NONE;
+
+				}
+
+				if ((incomingSize < 0) || (incomingLevelSize <= 0) ||
+					(incomingLevelSize > MAX_LEVEL_SIZE) ||
+					(incomingSize > (int)mz_compressBound(incomingLevelSize)))
+					return E_DATA;
+
+				incomingHash = (buffer[10] << 24) + (buffer[11] << 16) +
+					(buffer[12] << 8) + buffer[13];
+
+				// The relay keeps no cache, so always asks for the level
+				sendBuffer[0] = MTL_G_LCACHE;
+				sendBuffer[1] = MT_G_LCACHE;
+				sendBuffer[2] = 0;
+				upstreamQueue.add(sendBuffer, false);
+
+				incoming = new unsigned char[incomingSize];
+				incomingReceived = 0;
+
+				return E_NONE;
+
+			}
+
+			if (buffer[1] == MT_G_LTYPE) {
+
+				incomingType = (LevelType)buffer[2];
+
+				return E_NONE;
+
+			}
+
+			if (buffer[1] == MT_G_PING) {
+
+				// Return the server's ping, and ping the clients separately
+				if (!buffer[2]) {
+
+					buffer[2] = 1;
+					upstreamQueue.add(buffer, false);
+
+				}
+
+				return E_NONE;
+
+			}
+
+			// Player state arrives as messages, and is passed on as such
+			if ((buffer[1] == MT_G_PROPS) || (buffer[1] == MT_G_UDP)) return E_NONE;
+
+			if ((buffer[1] == MT_G_PJOIN) && (buffer[3] < maxPlayers)) {
+
+				// Add the new player, and any that have been missed
+				for (count = nPlayers; count <= buffer[3]; count++) {
+
+					players[count].init(this, (char *)buffer + 9, buffer + 5, buffer[4]);
+					addLevelPlayer(players + count);
+
+				}
+
+				nPlayers = count;
+
+			}
+
+			if ((buffer[1] == MT_G_PQUIT) && (buffer[2] < nPlayers)) {
+
+				nPlayers--;
+
+				players[buffer[2]].deinit();
+
+				// If necessary, move more recent players
+				for (count = buffer[2]; count < nPlayers; count++)
+					memcpy(static_cast<void*>(players + count), players + count + 1,
+						sizeof(Player));
+
+				// Clear duplicate pointers
+				memset(static_cast<void*>(players + nPlayers), 0, sizeof(Player));
+
+			}
+
+			if (buffer[1] == MT_G_CHECK) {
+
+				checkX = buffer[2];
+				checkY = buffer[3];
+
+				if (buffer[0] > 4) {
+
+					checkX += buffer[4] << 8;
+					checkY += buffer[5] << 8;
+
+				}
+
+			}
+
+			if (buffer[1] == MT_G_SCORE) {
+
+				for (count = 0; count < nPlayers; count++) {
+
+					if (players[count].getTeam() == buffer[2])
+						players[count].teamScore++;
+
+				}
+
+			}
+
+			break;
+
+		case MC_LEVEL:
+
+			if (baseLevel) baseLevel->receive(buffer);
+
+			break;
+
+		case MC_PLAYER:
+
+			if (buffer[2] < nPlayers) players[buffer[2]].receive(buffer);
+
+			break;
+
+	}
+
+	// Pass the message on to the clients
+	ServerGame::send(buffer);
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Relay iteration
+ *
+ * @param ticks Current time
+ *
+ * @return Error code
+ */
+int RelayGame::step (unsigned int ticks) {
+
+	unsigned char buffer[BUFFER_LENGTH];
+	int ret;
+
+	if (incoming) {
+
+		ret = receiveLevel();
+
+		if (ret < 0) return ret;
+
+	}
+
+	// Deal with each whole message that has arrived, until the compressed
+	// level, which does not arrive as messages
+	while (!incoming && upstream->getMessage(buffer)) {
+
+		ret = receiveMessage(buffer);
+
+		if (ret < 0) return ret;
+
+	}
+
+	if (upstream->isClosed()) return E_N_DISCONNECT;
+
+	upstreamQueue.flush(upstream);
+
+	return ServerGame::step(ticks);
+
+}
+
+
+/**
+ * Ignore the relay's own scoring, as the server's arrives as messages
+ *
+ * @param team Team to receive point
+ */
+void RelayGame::score (unsigned char team) {
+
+	(void)team;
+
+	return;
+
+}
+
+
+/**
+ * Ignore the relay's own checkpoints, as the server's arrive as messages
+ *
+ * @param gridX X-coordinate (in tiles) of the checkpoint
+ * @param gridY Y-coordinate (in tiles) of the checkpoint
+ */
+void RelayGame::setCheckpoint (int gridX, int gridY) {
+
+	(void)gridX;
+	(void)gridY;
+
+	return;
+
+}
+
+
+/**
+ * Ask the server for the changes made to the level, which was loaded without
+ * them.
+ */
+void RelayGame::syncLevel () {
+
+	unsigned char buffer[MTL_G_LSYNC];
+
+	buffer[0] = MTL_G_LSYNC;
+	buffer[1] = MT_G_LSYNC;
+	upstreamQueue.add(buffer, false);
+
+	return;
+
+}
+
@@ -22,18 +22,103 @@
 
 
 #include "game.h"
+#include "snapshot.h"
+#include "wire.h"
 
 #include "io/file.h"
 #include "io/gfx/font.h"
 #include "io/gfx/video.h"
 #include "io/network.h"
+#include "level/levelplayer.h"
+#include "loop.h"
+#include "memtrack.h"
 #include "player/player.h"
+#include "scratch.h"
 #include "setup.h"
 #include "util.h"
 
+#include "../miniz.h"
+
+#include <new>
+#include <stdio.h>
 #include <string.h>
 
 
+/**
+ * Write a JSON object of message counts, leaving out types with none.
+ *
+ * @param text Buffer to receive the object
+ * @param size Size of the buffer
+ * @param counts Message counts, indexed by type
+ *
+ * @return Number of characters written
+ */
+static int writeCounts (char* text, int size, unsigned int* counts) {
+
+	int length, type;
+	bool first;
+
+	length = snprintf(text, size, "{");
+	first = true;
+
+	for (type = 0; type < NET_TYPES; type++) {
+
+		if (!counts[type] || (length >= size)) continue;
+
+		length += snprintf(text + length, size - length, "%s\"0x%02x\": %u",
+			first? "": ", ", type, counts[type]);
+		first = false;
+
+	}
+
+	if (length < size) length += snprintf(text + length, size - length, "}");
+
+	return length;
+
+}
+
+
+/**
+ * Create a client connection
+ *
+ * @param nextClient Next client
+ * @param clientID Client's index on the server
+ * @param clientChannel Connection to the client
+ */
+ServerClient::ServerClient (ServerClient* nextClient, int clientID, NetChannel* clientChannel) : rate(T_SSEND, T_SSEND_MAX) {
+
+	next = nextClient;
+	id = clientID;
+	status = 0;
+	player = -1;
+	channel = clientChannel;
+	snapshots = NULL;
+	udpToken = 0;
+	udpAddress = 0;
+	udpPort = 0;
+	rtt = -1;
+	held = NULL;
+	nDeferred = 0;
+	stateTime = 0;
+
+	return;
+
+}
+
+
+/**
+ * Delete a client connection
+ */
+ServerClient::~ServerClient () {
+
+	if (snapshots) delete snapshots;
+	if (held) delete[] held;
+
+	return;
+
+}
+
+
 /**
  * Create game server
  *
@@ -43,7 +128,9 @@
  */
 ServerGame::ServerGame (GameModeType modeType, char* firstLevel, int gameDifficulty) {
 
-	int count;
+	int ret;
+
+	MEMORY_SCOPE(MEM_NETWORK);
 
 
 	// Create the server
@@ -52,31 +139,42 @@ ServerGame::ServerGame (GameModeType modeType, char* firstLevel, int gameDifficu
 
 	if (sock < 0) throw sock; // Tee hee. Throw sock.
 
+	// Player state can also be sent as datagrams, if they are available
+	udpSock = net->openDatagram(NET_PORT);
+
+	clients = NULL;
+	nClients = 0;
+	maxClients = setup.maxClients;
+	maxPlayers = maxClients + 1;
+	watchOnly = false;
+	statsTime = globalTicks + T_STATS;
+	sends = 0;
 
-	// Create the players
+
+	// Create the players, with room for one for each client
 
 	nPlayers = 1;
-	localPlayer = players = new Player[MAX_PLAYERS];
+	localPlayer = players = new Player[maxPlayers];
 	localPlayer->init(this, setup.characterName, setup.characterCols, 0);
 
-	for (count = 0; count < MAX_CLIENTS; count++)
-		clientPlayer[count] = clientStatus[count] = -1;
-
 
 	// Copy the first level into memory
 
 	levelFile = NULL;
 	levelData = NULL;
+	levelPacked = NULL;
 
-	count = setLevel(firstLevel);
+	ret = setLevel(firstLevel);
 
-	if (count < 0) {
+	if (ret < 0) {
 
 		net->close(sock);
+		if (udpSock != -1) net->close(udpSock);
 
 		if (levelData) delete[] levelData;
+		if (levelPacked) delete[] levelPacked;
 
-		throw count;
+		throw ret;
 
 	}
 
@@ -89,24 +187,70 @@ ServerGame::ServerGame (GameModeType modeType, char* firstLevel, int gameDifficu
 }
 
 
+/**
+ * Create a game server with no players or level, for relays to fill in from
+ * the server they watch. Clients may only watch.
+ */
+ServerGame::ServerGame () {
+
+	MEMORY_SCOPE(MEM_NETWORK);
+
+	sock = net->host();
+
+	if (sock < 0) throw sock;
+
+	// Player state is only passed on as messages
+	udpSock = -1;
+
+	clients = NULL;
+	nClients = 0;
+	maxClients = setup.maxClients;
+	maxPlayers = 0;
+	watchOnly = true;
+	statsTime = globalTicks + T_STATS;
+	sends = 0;
+
+	nPlayers = 0;
+	localPlayer = NULL;
+	mode = NULL;
+
+	levelFile = NULL;
+	levelData = NULL;
+	levelPacked = NULL;
+	packedSize = 0;
+	levelSize = 0;
+	levelHash = 0;
+
+	return;
+
+}
+
+
 /**
  * Disconnect clients and destroy server
  */
 ServerGame::~ServerGame () {
 
-	int count;
+	ServerClient* client;
+
+	while (clients) {
 
-	for (count = 0; count < MAX_CLIENTS; count++) {
+		client = clients->next;
 
-		if (clientStatus[count] != -1) net->close(clientSock[count]);
+		if (clients->status != -1) net->close(clients->channel);
+		delete clients;
+
+		clients = client;
 
 	}
 
 	net->close(sock);
+	if (udpSock != -1) net->close(udpSock);
 
 	if (levelData) delete[] levelData;
+	if (levelPacked) delete[] levelPacked;
 
-	delete mode;
+	if (mode) delete mode;
 
 	return;
 
@@ -114,7 +258,7 @@ ServerGame::~ServerGame () {
 
 
 /**
- * Set the next level and load it into memory
+ * Set the next level, load it into memory and compress it for sending
  *
  * @param fileName The file name of the next level
  *
@@ -122,16 +266,27 @@ ServerGame::~ServerGame () {
  */
 int ServerGame::setLevel (char* fileName) {
 
+	ServerClient* client;
 	File* file;
+	mz_ulong length;
 	int count;
 
 	if (levelFile) delete[] levelFile;
 	if (levelData) delete[] levelData;
+	if (levelPacked) delete[] levelPacked;
+
+	levelPacked = NULL;
+	packedSize = 0;
+	levelSize = 0;
+	levelHash = 0;
 
 	// The new level will be sent to all clients
-	for (count = 0; count < MAX_CLIENTS; count++) {
+	for (client = clients; client; client = client->next) {
 
-		if (clientStatus[count] != -1) clientStatus[count] = 0;
+		if (client->status != -1) client->status = 0;
+
+		// The new level's changes are sent once it has loaded
+		client->nDeferred = 0;
 
 	}
 
@@ -167,20 +322,305 @@ int ServerGame::setLevel (char* fileName) {
 
 	levelType = getLevelType(fileName);
 
-	if (levelType != LT_JJ1) return E_NONE;
+	if (levelType == LT_JJ1) {
+
+		// Modify the extension section to match the actual extension
+		count = levelSize - 5;
+		while (levelData[count - 1] != 3) count--;
+		levelData[count] = fileName[strlen(fileName) - 3];
+		levelData[count + 1] = fileName[strlen(fileName) - 2];
+		levelData[count + 2] = fileName[strlen(fileName) - 1];
+
+	}
+
+	// Compress the level once, rather than for each client
+	length = mz_compressBound(levelSize);
+	levelPacked = new unsigned char[length];
+
+	if (mz_compress(levelPacked, &length, levelData, levelSize) != MZ_OK) {
+
+		delete[] levelPacked;
+		levelPacked = NULL;
+
+		delete[] levelData;
+		levelData = NULL;
+
+		return E_DATA;
+
+	}
+
+	packedSize = length;
 
-	// Modify the extension section to match the actual extension
-	count = levelSize - 5;
-	while (levelData[count - 1] != 3) count--;
-	levelData[count] = fileName[strlen(fileName) - 3];
-	levelData[count + 1] = fileName[strlen(fileName) - 2];
-	levelData[count + 2] = fileName[strlen(fileName) - 1];
+	// Clients keep the levels they have received, identified by their hash
+	levelHash = mz_crc32(MZ_CRC32_INIT, levelData, levelSize);
 
 	return E_NONE;
 
 }
 
 
+/**
+ * Find the cell of interest around which a client's view is centred.
+ *
+ * @param client The client
+ * @param cellX Variable to receive the x-coordinate of the cell
+ * @param cellY Variable to receive the y-coordinate of the cell
+ *
+ * @return Whether or not the client has a player in the level, without which
+ * everything is of interest
+ */
+bool ServerGame::getView (ServerClient* client, int* cellX, int* cellY) {
+
+	LevelPlayer* levelPlayer;
+
+	if ((client->player == -1) || (client->player >= nPlayers)) return false;
+
+	levelPlayer = players[client->player].getLevelPlayer();
+
+	if (!levelPlayer) return false;
+
+	*cellX = FTOT(levelPlayer->getX()) >> INTEREST_CELL;
+	*cellY = FTOT(levelPlayer->getY()) >> INTEREST_CELL;
+
+	return true;
+
+}
+
+
+/**
+ * Determine whether or not a player's state is to be sent to a client this
+ * time. Players near the client's are always sent, those further away only
+ * every INTEREST_RATE sends, and those not in the level not at all.
+ *
+ * @param client The client
+ * @param player The player
+ *
+ * @return Whether or not the player's state is to be sent
+ */
+bool ServerGame::isInterested (ServerClient* client, int player) {
+
+	LevelPlayer* levelPlayer;
+	int cellX, cellY, dX, dY;
+
+	if (!getView(client, &cellX, &cellY)) return true;
+
+	if (player >= nPlayers) return true;
+
+	levelPlayer = players[player].getLevelPlayer();
+
+	if (!levelPlayer) return false;
+
+	dX = (FTOT(levelPlayer->getX()) >> INTEREST_CELL) - cellX;
+	dY = (FTOT(levelPlayer->getY()) >> INTEREST_CELL) - cellY;
+
+	if ((dX >= -INTEREST_NEAR) && (dX <= INTEREST_NEAR) &&
+		(dY >= -INTEREST_NEAR) && (dY <= INTEREST_NEAR)) return true;
+
+	// Players further away take turns
+	return !((sends + player) % INTEREST_RATE);
+
+}
+
+
+/**
+ * Determine whether or not a run of grid changes is close enough to a client's
+ * view to be sent.
+ *
+ * @param client The client
+ * @param run The run: its first element, row, variable, length and value
+ *
+ * @return Whether or not the run is to be sent
+ */
+bool ServerGame::isNear (ServerClient* client, unsigned char* run) {
+
+	int cellX, cellY;
+
+	if (!getView(client, &cellX, &cellY)) return true;
+
+	return ((run[1] >> INTEREST_CELL) >= cellY - INTEREST_GRID) &&
+		((run[1] >> INTEREST_CELL) <= cellY + INTEREST_GRID) &&
+		(((run[0] + run[3] - 1) >> INTEREST_CELL) >= cellX - INTEREST_GRID) &&
+		((run[0] >> INTEREST_CELL) <= cellX + INTEREST_GRID);
+
+}
+
+
+/**
+ * Determine whether or not player state is due to be sent to a client. Clients
+ * paced at the fastest rate are also sent the states relayed between updates.
+ *
+ * @param client The client
+ *
+ * @return Whether or not player state is due
+ */
+bool ServerGame::isDue (ServerClient* client) {
+
+	return (client->rate.getInterval() <= T_SSEND) || (globalTicks >= client->stateTime);
+
+}
+
+
+/**
+ * Add a run of grid changes to a message for a client, sending the message
+ * first if it is full.
+ *
+ * @param client The client
+ * @param buffer The MT_L_GRIDS message
+ * @param run The run
+ */
+void ServerGame::addRun (ServerClient* client, unsigned char* buffer, unsigned char* run) {
+
+	if (buffer[0] + MTL_L_RUN > BUFFER_LENGTH) {
+
+		client->sendQueue.add(buffer, false);
+		buffer[0] = MTL_L_GRIDS;
+
+	}
+
+	memcpy(buffer + buffer[0], run, MTL_L_RUN);
+	buffer[0] += MTL_L_RUN;
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not two runs of grid changes set any of the same
+ * elements.
+ *
+ * @param first The first run
+ * @param second The second run
+ *
+ * @return Whether or not the runs overlap
+ */
+static bool overlaps (unsigned char* first, unsigned char* second) {
+
+	return (first[1] == second[1]) && (first[2] == second[2]) &&
+		(first[0] < second[0] + second[3]) && (second[0] < first[0] + first[3]);
+
+}
+
+
+/**
+ * Send a client the runs of grid changes near its view, deferring the rest.
+ * Runs hold values rather than differences, so a run sent must not be
+ * overtaken by an older deferred run of the same elements. When that would
+ * happen, every deferred run is sent first.
+ *
+ * @param client The client
+ * @param buffer The MT_L_GRIDS message
+ */
+void ServerGame::sendRuns (ServerClient* client, unsigned char* buffer) {
+
+	unsigned char message[BUFFER_LENGTH];
+	unsigned char* run;
+	int position, count;
+
+	message[0] = MTL_L_GRIDS;
+	message[1] = MT_L_GRIDS;
+
+	for (position = MTL_L_GRIDS; position + MTL_L_RUN <= buffer[0]; position += MTL_L_RUN) {
+
+		run = buffer + position;
+
+		if (isNear(client, run)) {
+
+			for (count = 0; count < client->nDeferred; count++) {
+
+				if (overlaps(run, client->deferred[count])) break;
+
+			}
+
+			if (count < client->nDeferred) {
+
+				for (count = 0; count < client->nDeferred; count++)
+					addRun(client, message, client->deferred[count]);
+
+				client->nDeferred = 0;
+
+			}
+
+			addRun(client, message, run);
+
+		} else {
+
+			// Without room, the oldest deferred run is sent
+			if (client->nDeferred == INTEREST_RUNS) {
+
+				addRun(client, message, client->deferred[0]);
+				memmove(client->deferred[0], client->deferred[1], (INTEREST_RUNS - 1) * MTL_L_RUN);
+				client->nDeferred--;
+
+			}
+
+			memcpy(client->deferred[client->nDeferred++], run, MTL_L_RUN);
+
+		}
+
+	}
+
+	if (message[0] > MTL_L_GRIDS) client->sendQueue.add(message, false);
+
+	return;
+
+}
+
+
+/**
+ * Send a client the deferred runs of grid changes its view has approached.
+ *
+ * @param client The client
+ */
+void ServerGame::sendDeferred (ServerClient* client) {
+
+	unsigned char message[BUFFER_LENGTH];
+	int count, kept, older;
+
+	message[0] = MTL_L_GRIDS;
+	message[1] = MT_L_GRIDS;
+	kept = 0;
+
+	for (count = 0; count < client->nDeferred; count++) {
+
+		if (isNear(client, client->deferred[count])) {
+
+			// An older run still deferred must not overtake this one
+			for (older = 0; older < kept; older++) {
+
+				if (overlaps(client->deferred[count], client->deferred[older])) break;
+
+			}
+
+			if (older < kept) {
+
+				for (older = 0; older < kept; older++)
+					addRun(client, message, client->deferred[older]);
+
+				kept = 0;
+
+			}
+
+			addRun(client, message, client->deferred[count]);
+
+		} else {
+
+			if (kept < count) memcpy(client->deferred[kept], client->deferred[count], MTL_L_RUN);
+			kept++;
+
+		}
+
+	}
+
+	client->nDeferred = kept;
+
+	if (message[0] > MTL_L_GRIDS) client->sendQueue.add(message, false);
+
+	return;
+
+}
+
+
 /**
  * Send data to clients
  *
@@ -188,16 +628,31 @@ int ServerGame::setLevel (char* fileName) {
  */
 void ServerGame::send (unsigned char* buffer) {
 
-	int count;
+	ServerClient* client;
+	unsigned char packed[BUFFER_LENGTH];
 
-	for (count = 0; count < MAX_CLIENTS; count++) {
+	packMessage(buffer, packed);
+
+	for (client = clients; client; client = client->next) {
 
 		// Send data to client, unless the data concerns the client's player
 		// Each client is solely responsible for its player's state
-		if ((clientStatus[count] != -1) &&
+		// Clients still receiving the level are sent nothing until the
+		// transfer is complete, as the level is not divided into messages
+		// Clients known to receive datagrams get player state that way
+		// Players far from the client's are sent less often
+		// Grid changes far from the client's player wait until it approaches
+		if ((client->status == -2) &&
 			(((buffer[1] & MCMASK) != MC_PLAYER) ||
-			(buffer[2] != clientPlayer[count])))
-			net->send(clientSock[count], buffer);
+			(buffer[2] != client->player)) &&
+			((buffer[1] != MT_P_TEMP) || ((!client->snapshots ||
+			!client->snapshots->isAcknowledged()) && isDue(client) &&
+			isInterested(client, buffer[2])))) {
+
+			if (buffer[1] == MT_L_GRIDS) sendRuns(client, buffer);
+			else client->sendQueue.add(packed, buffer[1] == MT_P_TEMP);
+
+		}
 
 	}
 
@@ -207,149 +662,538 @@ void ServerGame::send (unsigned char* buffer) {
 
 
 /**
- * Game iteration
- *
- * @param ticks Current time
+ * Inform a client of the checkpoint and the existing players
  *
- * @return Error code
+ * @param client The client
  */
-int ServerGame::step (unsigned int ticks) {
+void ServerGame::sendState (ServerClient* client) {
 
 	unsigned char sendBuffer[BUFFER_LENGTH];
-	int count, pcount, length;
+	int count;
+
+	sendBuffer[0] = MTL_G_CHECK;
+	sendBuffer[1] = MT_G_CHECK;
+	sendBuffer[2] = checkX & 0xFF;
+	sendBuffer[3] = checkY & 0xFF;
+	sendBuffer[4] = (checkX >> 8) & 0xFF;
+	sendBuffer[5] = (checkY >> 8) & 0xFF;
+	client->sendQueue.add(sendBuffer, false);
 
-	for (count = 0; count < MAX_CLIENTS; count++) {
+	sendBuffer[1] = MT_G_PJOIN;
 
-		if (clientStatus[count] >= 0) {
+	for (count = 0; count < nPlayers; count++) {
 
-			if (clientStatus[count] == 0) {
+		sendBuffer[0] = MTL_G_PJOIN + strlen(players[count].getName());
+		sendBuffer[2] = client->id;
+		sendBuffer[3] = count;
+		sendBuffer[4] = players[count].getTeam();
+		memcpy(sendBuffer + 5, players[count].getCols(), PCOLOURS);
+		memcpy(sendBuffer + 9, players[count].getName(), strlen(players[count].getName()) + 1);
 
-				// Send level type
-				sendBuffer[0] = MTL_G_LTYPE;
-				sendBuffer[1] = MT_G_LTYPE;
-				sendBuffer[2] = levelType;
-				net->send(clientSock[count], sendBuffer);
+		client->sendQueue.add(sendBuffer, false);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Disconnect a client, and remove its player from the game. The client itself
+ * is removed at the end of the step.
+ *
+ * @param client The client
+ */
+void ServerGame::disconnect (ServerClient* client) {
+
+	ServerClient* other;
+	unsigned char sendBuffer[MTL_G_PQUIT];
+	int count;
+
+	printf("Client %d disconnected (code: %d).\n", client->id, net->getError());
+
+	// Disconnect client
+	net->close(client->channel);
+	client->status = -1;
+	client->sendQueue.clear();
+
+	if (client->player != -1) {
+
+		// Remove the client's player
+
+		printf("Player %d (client %d) left the game.\n", client->player, client->id);
+
+		nPlayers--;
+
+		players[client->player].deinit();
+
+		// If necessary, move more recent players
+		for (count = client->player; count < nPlayers; count++)
+			memcpy(static_cast<void*>(players + count), players + count + 1, sizeof(Player));
+
+		// Clear duplicate pointers
+		memset(static_cast<void*>(players + nPlayers), 0, sizeof(Player));
+
+		// The other clients' players may have moved
+		for (other = clients; other; other = other->next) {
+
+			if (other->player > client->player) other->player--;
+
+			if (other->held) {
+
+				memmove(other->held[client->player], other->held[client->player + 1],
+					(nPlayers - client->player) * MTL_P_TEMP);
+				memset(other->held[nPlayers], 0, MTL_P_TEMP);
 
 			}
 
-			// Client is connected, but not operational
-			// Send a chunk of the level
+		}
 
-			length = levelSize - clientStatus[count];
+		// Inform remaining clients that the player has left
+		sendBuffer[0] = MTL_G_PQUIT;
+		sendBuffer[1] = MT_G_PQUIT;
+		sendBuffer[2] = client->player;
+		send(sendBuffer);
 
-			if (length > 251) length = 251;
+		client->player = -1;
 
-			sendBuffer[0] = MTL_G_LEVEL + length;
-			sendBuffer[1] = MT_G_LEVEL;
-			sendBuffer[2] = clientStatus[count] >> 8;
-			sendBuffer[3] = clientStatus[count] & 255;
-			memcpy(sendBuffer + 4, levelData + clientStatus[count], length);
-			length = net->send(clientSock[count], sendBuffer);
+	}
 
-			// Client is operational if the whole level has been sent
-			// Otherwise, keep sending data
-			if (length == MTL_G_LEVEL) clientStatus[count] = -2;
-			else if (length > 0) clientStatus[count] += length - MTL_G_LEVEL;
+	return;
+
+}
+
+
+/**
+ * Accept a waiting connection, unless the server is full
+ *
+ * @param ticks Current time
+ */
+void ServerGame::accept (unsigned int ticks) {
+
+	ServerClient* client;
+	NetChannel* channel;
+	unsigned char sendBuffer[BUFFER_LENGTH];
+	unsigned int address;
+	bool peer;
+	int clientSock, id;
+
+	clientSock = net->accept(sock);
+
+	if (clientSock == -1) return;
+
+	if (nClients >= maxClients) {
+
+		printf("Connection refused, as the server is full.\n");
+
+		net->close(clientSock);
+
+		return;
+
+	}
+
+	// The address must be found before the network thread takes the socket
+	peer = net->getPeer(clientSock, &address);
+
+	// The connection is read and written by the network thread from now on
+	channel = net->open(clientSock);
+
+	if (!channel) {
+
+		printf("Connection refused, as the network thread could not be started.\n");
+
+		net->close(clientSock);
+
+		return;
+
+	}
+
+	// Use the lowest free client ID
+	for (id = 0; id < maxClients; id++) {
+
+		for (client = clients; client && (client->id != id); client = client->next);
+
+		if (!client) break;
+
+	}
+
+	client = clients = new ServerClient(clients, id, channel);
+	nClients++;
+
+	printf("Client %d connected.\n", id);
+
+
+	// Incorporate the new client
+
+	// Send data
+	sendBuffer[0] = MTL_G_PROPS;
+	sendBuffer[1] = MT_G_PROPS;
+	sendBuffer[2] = NET_VERSION; // Server version
+	sendBuffer[3] = mode->getMode();
+	sendBuffer[4] = difficulty;
+	sendBuffer[5] = maxPlayers; // Maximum number of players
+	sendBuffer[6] = nPlayers; // Number of players
+	sendBuffer[7] = id; // Client's clientID
+	client->sendQueue.add(sendBuffer, false);
+
+	if ((udpSock != -1) && peer) {
+
+		// Offer to exchange player state as datagrams
+		// The client is only trusted to send datagrams from the address of its
+		// connection, with its token
+		client->snapshots = new Snapshots(maxPlayers);
+		client->held = new unsigned char[maxPlayers][MTL_P_TEMP];
+		memset(client->held, 0, maxPlayers * MTL_P_TEMP);
+		client->udpAddress = address;
+		client->udpToken = (ticks * 2654435761u) ^ (id << 24) ^ clientSock;
+
+		sendBuffer[0] = MTL_G_UDP;
+		sendBuffer[1] = MT_G_UDP;
+		sendBuffer[2] = client->udpToken >> 24;
+		sendBuffer[3] = (client->udpToken >> 16) & 255;
+		sendBuffer[4] = (client->udpToken >> 8) & 255;
+		sendBuffer[5] = client->udpToken & 255;
+		client->sendQueue.add(sendBuffer, false);
+
+	}
+
+	// The level is sent next, and once it has been sent, the client is
+	// informed of the checkpoint and the existing players
+
+	return;
+
+}
+
+
+/**
+ * Receive player state from any datagrams which have arrived
+ */
+void ServerGame::receiveStates () {
+
+	ServerClient* client;
+	unsigned char packet[5 + SNAPSHOT_SIZE];
+	unsigned char (*states)[MTL_P_TEMP];
+	unsigned int address, token;
+	int datagrams, length, port, id, count, nStates;
+
+	if (udpSock == -1) return;
+
+	states = (unsigned char (*)[MTL_P_TEMP])frameAllocate(MAX_PLAYERS * MTL_P_TEMP);
+
+	// Limit the number of datagrams taken at once, in case of a flood
+	for (datagrams = 0; datagrams < (nClients + 1) * 4; datagrams++) {
+
+		length = net->recvFrom(udpSock, packet, 5 + SNAPSHOT_SIZE, &address, &port);
+
+		if (length < 0) break;
+
+		// Datagrams start with the client's ID and token
+		if (length < 5 + SNAPSHOT_HEADER) continue;
+
+		id = packet[0];
+		token = (packet[1] << 24) + (packet[2] << 16) + (packet[3] << 8) + packet[4];
+
+		for (client = clients; client && (client->id != id); client = client->next);
+
+		if (!client || (client->status == -1) || !client->snapshots ||
+			(token != client->udpToken) || (address != client->udpAddress))
+			continue;
+
+		// Reply to wherever the datagrams come from, which may change
+		client->udpPort = port;
+
+		nStates = client->snapshots->decode(packet + 5, length - 5, states);
+
+		if (client->player == -1) continue;
+
+		// Each client only sends the state of its own player
+		for (count = 0; count < nStates; count++) {
+
+			if (states[count][2]) continue;
+
+			states[count][2] = client->player;
+			players[client->player].receive(states[count]);
 
 		}
 
+	}
+
+	return;
+
+}
+
+
+/**
+ * Send player state as datagrams to the clients which can receive them
+ *
+ * @param states The MT_P_TEMP states of the players
+ */
+void ServerGame::sendStates (unsigned char states[][MTL_P_TEMP]) {
 
-		if ((clientStatus[count] == -2) && (received[count] == 0)) {
+	ServerClient* client;
+	unsigned char packet[SNAPSHOT_SIZE];
+	unsigned char* included[MAX_PLAYERS];
+	int count, length, size;
 
-			// Client is operational, but not currently receiving a message
-			// See if there is a new message to receive
+	if (udpSock == -1) return;
 
-			length = net->recv(clientSock[count], recvBuffers[count], 1);
+	for (client = clients; client; client = client->next) {
 
-			if (length > 0) received[count]++;
+		if ((client->status != -2) || !client->snapshots || !client->udpPort ||
+			!isDue(client)) continue;
+
+		// Each client is solely responsible for its player's state
+		// Players the client is not interested in this time keep the state
+		// last sent, as those left out would revert to an older snapshot
+		for (count = 0; count < nPlayers; count++) {
+
+			if (count == client->player) {
+
+				included[count] = NULL;
+
+			} else if (isInterested(client, count)) {
+
+				memcpy(client->held[count], states[count], MTL_P_TEMP);
+				included[count] = states[count];
+
+			} else included[count] = client->held[count][0]? client->held[count]: NULL;
 
 		}
 
+		// Snapshots take no more than the client's share of its connection,
+		// with the players left out going first next time
+		size = client->rate.getBudget();
+		if (!size || (size > SNAPSHOT_SIZE)) size = SNAPSHOT_SIZE;
+		else if (size < SNAPSHOT_MIN) size = SNAPSHOT_MIN;
+
+		length = client->snapshots->encode(packet, included, nPlayers, size);
 
-		if ((clientStatus[count] == -2) && (received[count] > 0)) {
+		net->sendTo(udpSock, packet, length, client->udpAddress, client->udpPort);
 
-			// Currently receiving a message
-			// See if there is any more data
+	}
+
+	return;
+
+}
 
-			length = net->recv(clientSock[count],
-				recvBuffers[count] + received[count],
-				recvBuffers[count][0] - received[count]);
 
-			if (length > 0) received[count] += length;
+/**
+ * Game iteration
+ *
+ * @param ticks Current time
+ *
+ * @return Error code
+ */
+int ServerGame::step (unsigned int ticks) {
+
+	ServerClient* client;
+	ServerClient** link;
+	unsigned char sendBuffer[BUFFER_LENGTH];
+	unsigned char recvBuffer[BUFFER_LENGTH];
+	unsigned char (*states)[MTL_P_TEMP];
+	bool readable;
+	int count, pcount, length, listening;
 
+	states = (unsigned char (*)[MTL_P_TEMP])frameAllocate(MAX_PLAYERS * MTL_P_TEMP);
 
-			// See if the whole message has arrived
+	// The clients' connections are read by the network thread, so only the
+	// server socket is checked for a new connection
+	listening = ((ticks >= checkTime) && levelData)? sock: -1;
+	net->ready(&listening, 1, &readable);
 
-			if (received[count] >= recvBuffers[count][0]) {
+	receiveStates();
 
-				switch (recvBuffers[count][1] & MCMASK) {
+	for (client = clients; client; client = client->next) {
+
+		if (client->status >= 0) {
+
+			// Client is connected, but not operational
+
+			if (client->status == 0) {
+
+				// Send level type
+				sendBuffer[0] = MTL_G_LTYPE;
+				sendBuffer[1] = MT_G_LTYPE;
+				sendBuffer[2] = levelType;
+				client->sendQueue.add(sendBuffer, false);
+
+				// Send the sizes and hash of the level
+				// A compressed size of 0 means the run of levels has ended
+				// Otherwise, the client replies to say whether or not it
+				// already has the level, and if not, the compressed data
+				// follows
+				sendBuffer[0] = MTL_G_LEVEL;
+				sendBuffer[1] = MT_G_LEVEL;
+				sendBuffer[2] = packedSize >> 24;
+				sendBuffer[3] = (packedSize >> 16) & 255;
+				sendBuffer[4] = (packedSize >> 8) & 255;
+				sendBuffer[5] = packedSize & 255;
+				sendBuffer[6] = levelSize >> 24;
+				sendBuffer[7] = (levelSize >> 16) & 255;
+				sendBuffer[8] = (levelSize >> 8) & 255;
+				sendBuffer[9] = levelSize & 255;
+				sendBuffer[10] = levelHash >> 24;
+				sendBuffer[11] = (levelHash >> 16) & 255;
+				sendBuffer[12] = (levelHash >> 8) & 255;
+				sendBuffer[13] = levelHash & 255;
+
+				if (client->sendQueue.add(sendBuffer, false))
+					client->status = packedSize? -3: 1;
+
+			} else if (client->sendQueue.isEmpty()) {
+
+				// Once any messages ahead of it have been handed over, hand
+				// over as much of the compressed level as there is room for
+
+				length = client->channel->write(levelPacked + client->status - 1,
+					packedSize + 1 - client->status);
+
+				if (length > 0) client->status += length;
+
+			}
+
+			// Client is operational if the whole level has been sent
+			if (client->status == packedSize + 1) {
+
+				client->status = -2;
+
+				// Messages were withheld during the transfer, so bring the
+				// client up to date
+				sendState(client);
+
+			}
+
+		}
+
+
+		if ((client->status == -2) || (client->status == -3)) {
+
+			// Deal with each whole message that has arrived
+			while (client->channel->getMessage(recvBuffer)) {
+
+				if (!unpackMessage(recvBuffer)) continue;
+
+				// Clients which may only watch have nothing to say about the
+				// game itself
+				if (watchOnly && (recvBuffer[1] != MT_G_LCACHE) &&
+					(recvBuffer[1] != MT_G_PING) && (recvBuffer[1] != MT_G_LSYNC))
+					continue;
+
+				switch (recvBuffer[1] & MCMASK) {
 
 					case MC_GAME:
 
-						if ((recvBuffers[count][1] == MT_G_PJOIN) &&
-							(clientPlayer[count] == -1)) {
+						if ((recvBuffer[1] == MT_G_PJOIN) &&
+							(client->player == -1)) {
 
-							printf("Player %d (client %d) joined the game.\n", nPlayers, count);
+							printf("Player %d (client %d) joined the game.\n", nPlayers, client->id);
 
 
 							// Set up the new player
 
-							recvBuffers[count][4] = mode->chooseTeam();
+							recvBuffer[4] = mode->chooseTeam();
 
 							players[nPlayers].init(this,
-								(char *)(recvBuffers[count]) + 9,
-								recvBuffers[count] + 5, recvBuffers[count][4]);
+								(char *)(recvBuffer) + 9,
+								recvBuffer + 5, recvBuffer[4]);
 							addLevelPlayer(players + nPlayers);
 
-							printf("Player %d joined team %d.\n", nPlayers, recvBuffers[count][4]);
+							printf("Player %d joined team %d.\n", nPlayers, recvBuffer[4]);
 
-							recvBuffers[count][3] = clientPlayer[count] = nPlayers;
+							recvBuffer[3] = client->player = nPlayers;
 
 							nPlayers++;
 
 						}
 
-						if (recvBuffers[count][1] == MT_G_CHECK) {
+						if (recvBuffer[1] == MT_G_CHECK) {
 
-							checkX = recvBuffers[count][2];
-							checkY = recvBuffers[count][3];
+							checkX = recvBuffer[2];
+							checkY = recvBuffer[3];
 
-							if (recvBuffers[count][0] > 4) {
+							if (recvBuffer[0] > 4) {
 
-								checkX += recvBuffers[count][4] << 8;
-								checkY += recvBuffers[count][5] << 8;
+								checkX += recvBuffer[4] << 8;
+								checkY += recvBuffer[5] << 8;
 
 							}
 
 						}
 
-						if (recvBuffers[count][1] == MT_G_SCORE) {
+						if (recvBuffer[1] == MT_G_SCORE) {
 
 							for (pcount = 0; pcount < nPlayers; pcount++) {
 
-								if (players[pcount].getTeam() == recvBuffers[count][2])
+								if (players[pcount].getTeam() == recvBuffer[2])
 									players[pcount].teamScore++;
 
 							}
 
 						}
 
+						if (recvBuffer[1] == MT_G_PING) {
+
+							if (recvBuffer[2]) {
+
+								// A ping sent to the client has returned
+								client->rtt = globalTicks -
+									((recvBuffer[3] << 24) + (recvBuffer[4] << 16) +
+									(recvBuffer[5] << 8) + recvBuffer[6]);
+
+							} else {
+
+								// Return the client's ping
+								recvBuffer[2] = 1;
+								client->sendQueue.add(recvBuffer, false);
+
+							}
+
+						}
+
+						if ((recvBuffer[1] == MT_G_LSYNC) && baseLevel) {
+
+							// The client's copy of the level is as it was
+							// loaded, and every change is about to be sent
+							client->nDeferred = 0;
+							baseLevel->sendChanges(&(client->sendQueue));
+
+						}
+
+						if ((recvBuffer[1] == MT_G_LCACHE) &&
+							(client->status == -3)) {
+
+							if (recvBuffer[2]) {
+
+								// The client already has the level
+								client->status = -2;
+								sendState(client);
+
+							} else {
+
+								// Start sending the compressed level
+								client->status = 1;
+
+							}
+
+						}
+
 						break;
 
 					case MC_LEVEL:
 
-						baseLevel->receive(recvBuffers[count]);
+						baseLevel->receive(recvBuffer);
 
 						break;
 
 					case MC_PLAYER:
 
-						if (clientPlayer[count] != -1) {
+						if (client->player != -1) {
 
 							// Assign player byte based on sender
-							recvBuffers[count][2] = clientPlayer[count];
+							recvBuffer[2] = client->player;
 
-							players[clientPlayer[count]].receive(recvBuffers[count]);
+							players[client->player].receive(recvBuffer);
 
 						}
 
@@ -358,144 +1202,244 @@ int ServerGame::step (unsigned int ticks) {
 				}
 
 				// Update clients
-				send(recvBuffers[count]);
-
-				received[count] = 0;
+				if ((recvBuffer[1] != MT_G_LCACHE) && (recvBuffer[1] != MT_G_PING) &&
+					(recvBuffer[1] != MT_G_LSYNC))
+					send(recvBuffer);
 
 			}
 
 		}
 
-		if (ticks >= checkTime) {
+		// Check for disconnection
+		if ((client->status != -1) && client->channel->isClosed())
+			disconnect(client);
 
-			if ((clientStatus[count] == -1) && levelData) {
+	}
 
-				// Client is not connected
-				// Check for new connection
+	// Remove the clients which have disconnected
+	link = &clients;
 
-				clientSock[count] = net->accept(sock);
+	while (*link) {
 
-				if (clientSock[count] != -1) {
+		client = *link;
 
-					printf("Client %d connected.\n", count);
+		if (client->status == -1) {
 
-					clientPlayer[count] = -1;
-					received[count] = 0;
+			*link = client->next;
+			delete client;
+			nClients--;
 
-					// Incorporate the new client
+		} else link = &(client->next);
 
-					// Send data
-					sendBuffer[0] = MTL_G_PROPS;
-					sendBuffer[1] = MT_G_PROPS;
-					sendBuffer[2] = 1; // Server version
-					sendBuffer[3] = mode->getMode();
-					sendBuffer[4] = difficulty;
-					sendBuffer[5] = MAX_PLAYERS;
-					sendBuffer[6] = nPlayers; // Number of players
-					sendBuffer[7] = count; // Client's clientID
-					net->send(clientSock[count], sendBuffer);
+	}
 
-					// Initiate sending of level data
-					clientStatus[count] = 0;
+	// Any further connections are accepted at the next check
+	if (readable) accept(ticks);
 
-					// Inform the new client of the checkpoint
-					sendBuffer[0] = MTL_G_CHECK;
-					sendBuffer[1] = MT_G_CHECK;
-					sendBuffer[2] = checkX & 0xFF;
-					sendBuffer[3] = checkY & 0xFF;
-					sendBuffer[4] = (checkX >> 8) & 0xFF;
-					sendBuffer[5] = (checkY >> 8) & 0xFF;
-					net->send(clientSock[count], sendBuffer);
+	if (ticks >= checkTime) {
 
-					// Inform the new client of the existing players
+		// Measure the round-trip time to each operational client
+		sendBuffer[0] = MTL_G_PING;
+		sendBuffer[1] = MT_G_PING;
+		sendBuffer[2] = 0;
+		sendBuffer[3] = globalTicks >> 24;
+		sendBuffer[4] = (globalTicks >> 16) & 255;
+		sendBuffer[5] = (globalTicks >> 8) & 255;
+		sendBuffer[6] = globalTicks & 255;
 
-					sendBuffer[1] = MT_G_PJOIN;
+		for (client = clients; client; client = client->next) {
 
-					for (pcount = 0; pcount < nPlayers; pcount++) {
+			if (client->status == -2) client->sendQueue.add(sendBuffer, false);
 
-						sendBuffer[0] = MTL_G_PJOIN + strlen(players[pcount].getName());
-						sendBuffer[2] = count;
-						sendBuffer[3] = pcount;
-						sendBuffer[4] = players[pcount].getTeam();
-						memcpy(sendBuffer + 5, players[pcount].getCols(), PCOLOURS);
-						memcpy(sendBuffer + 9, players[pcount].getName(), strlen(players[pcount].getName()) + 1);
+		}
 
-						net->send(clientSock[count], sendBuffer);
+		checkTime = ticks + T_SCHECK;
 
-					}
+	}
 
-				}
+	if (globalTicks >= statsTime) {
+
+		writeStats();
+
+		statsTime = globalTicks + T_STATS;
+
+	}
+
+	if (ticks >= sendTime) {
+
+		// Update clients
 
-			} else {
+		for (count = 0; count < nPlayers; count++) {
 
-				// Client is connected
-				// Check for disconnection
+			states[count][0] = MTL_P_TEMP;
+			states[count][1] = MT_P_TEMP;
+			states[count][2] = count;
+			players[count].send(states[count]);
+			send(states[count]);
 
-				if (!(net->isConnected(clientSock[count]))) {
+		}
 
-					printf("Client %d disconnected (code: %d).\n", count, net->getError());
+		sendStates(states);
 
-					// Disconnect client
-					net->close(clientSock[count]);
-					clientStatus[count] = -1;
+		// Each client is updated as often as its connection allows
+		for (client = clients; client; client = client->next) {
 
-					if (clientPlayer[count] != -1) {
+			if ((client->status == -2) && (ticks >= client->stateTime)) {
 
-						// Remove the client's player
+				client->rate.update(client->channel, &(client->sendQueue), client->rtt, ticks);
+				client->stateTime = ticks + client->rate.getInterval();
 
-						printf("Player %d (client %d) left the game.\n", clientPlayer[count], count);
+			}
 
-						nPlayers--;
+		}
 
-						players[clientPlayer[count]].deinit();
+		sends++;
+		sendTime = ticks + T_SSEND;
 
-						// If necessary, move more recent players
-						for (pcount = clientPlayer[count]; pcount < nPlayers; pcount++)
-							memcpy(static_cast<void*>(players + pcount), players + pcount + 1, sizeof(Player));
+	}
 
-						// Clear duplicate pointers
-						memset(static_cast<void*>(players + nPlayers), 0, sizeof(Player));
+	// Send everything queued for each client this tick, including grid changes
+	// the client's player has approached
+	for (client = clients; client; client = client->next) {
 
-						// Inform remaining clients that the player has left
-						sendBuffer[0] = MTL_G_PQUIT;
-						sendBuffer[1] = MT_G_PQUIT;
-						sendBuffer[2] = clientPlayer[count];
-						send(sendBuffer);
+		if ((client->status == -2) && client->nDeferred) sendDeferred(client);
 
-						clientPlayer[count] = -1;
+		// What the connection could only deliver late is held back, where
+		// newer player state can replace it
+		client->sendQueue.flush(client->channel,
+			(client->status == -2)? client->rate.getBacklog(): NET_QUEUE);
 
-					}
+	}
 
-				}
+	return E_NONE;
 
-			}
+}
 
-		}
+
+/**
+ * Gather the network statistics for a client.
+ *
+ * @param client The client
+ * @param stats Statistics to which the client's traffic is added
+ */
+void ServerGame::gatherStats (ServerClient* client, NetStats *stats) {
+
+	if (client->status == -1) return;
+
+	client->channel->getStats(stats);
+	client->sendQueue.getStats(stats);
+	client->rate.getStats(stats);
+
+	stats->rtt = client->rtt;
+
+	if (client->status > 0) {
+
+		stats->levelSent = client->status - 1;
+		stats->levelSize = packedSize;
 
 	}
 
-	if (ticks >= checkTime) checkTime = ticks + T_SCHECK;
+	return;
 
-	if (ticks >= sendTime) {
+}
 
-		// Update clients
 
-		sendBuffer[0] = MTL_P_TEMP;
-		sendBuffer[1] = MT_P_TEMP;
+/**
+ * Get the network statistics for the client a player is played by.
+ *
+ * @param player The player
+ * @param stats Statistics to which the client's traffic is added
+ *
+ * @return Whether or not the player is played by a client
+ */
+bool ServerGame::getStats (Player *player, NetStats *stats) {
+
+	ServerClient* client;
 
-		for (count = 0; count < nPlayers; count++) {
+	for (client = clients; client; client = client->next) {
+
+		if ((client->status != -1) && (client->player != -1) &&
+			(players + client->player == player)) {
+
+			gatherStats(client, stats);
 
-			sendBuffer[2] = count;
-			players[count].send(sendBuffer);
-			send(sendBuffer);
+			return true;
 
 		}
 
-		sendTime = ticks + T_SSEND;
+	}
+
+	return false;
+
+}
+
+
+/**
+ * Write the network statistics of every client to the statistics file, so that
+ * the traffic of a live server can be examined.
+ */
+void ServerGame::writeStats () {
+
+	ServerClient* client;
+	NetStats* stats;
+	File* file;
+	char* text;
+	int size, length;
+	bool first;
+
+	size = STATS_LENGTH * (nClients + 1);
+	text = (char *)frameAllocate(size);
+	stats = (NetStats *)frameAllocate(sizeof(NetStats));
+
+	length = snprintf(text, size, "{\n\t\"time\": %u,\n\t\"clients\": [", globalTicks);
+	first = true;
+
+	for (client = clients; client && (length < size - STATS_LENGTH); client = client->next) {
+
+		if (client->status == -1) continue;
+
+		new(stats) NetStats();
+		gatherStats(client, stats);
+
+		length += snprintf(text + length, size - length,
+			"%s\n\t\t{\"id\": %d, \"player\": %d, \"operational\": %s, "
+			"\"rtt\": %d, \"bytesIn\": %u, \"bytesOut\": %u, "
+			"\"queued\": %d, \"stalls\": %d, \"dropped\": %d, "
+			"\"levelSent\": %d, \"levelSize\": %d, \"interval\": %d, "
+			"\"bandwidth\": %d, \"messagesIn\": ",
+			first? "": ",", client->id, client->player,
+			(client->status == -2)? "true": "false", stats->rtt,
+			stats->bytesIn, stats->bytesOut, stats->queued, stats->stalls,
+			stats->dropped, stats->levelSent, stats->levelSize,
+			stats->interval, stats->bandwidth);
+		length += writeCounts(text + length, size - length, stats->messagesIn);
+		length += snprintf(text + length, size - length, ", \"messagesOut\": ");
+		length += writeCounts(text + length, size - length, stats->messagesOut);
+		length += snprintf(text + length, size - length, "}");
+
+		first = false;
 
 	}
 
-	return E_NONE;
+	length += snprintf(text + length, size - length, "\n\t]\n}\n");
+
+	if (length > size - 1) length = size - 1;
+
+	try {
+
+		file = new File(STATS_FILE, true);
+
+	} catch (int e) {
+
+		return;
+
+	}
+
+	file->storeBlock((unsigned char *)text, length);
+
+	delete file;
+
+	return;
 
 }
 
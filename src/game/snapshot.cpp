@@ -0,0 +1,343 @@
+
+/**
+ *
+ * @file snapshot.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created snapshot.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Encodes and decodes snapshots of player state for datagrams.
+ *
+ * A snapshot begins with its sequence number, the sequence number of the
+ * snapshot it is relative to (0 for none), the sequence number of the last
+ * snapshot received from the other side, and the number of players it
+ * contains. Each player then has its number, a mask of the bytes of its
+ * MT_P_TEMP state which differ from the base snapshot, and those bytes.
+ * Players whose state has not changed are left out.
+ *
+ */
+
+
+#include "snapshot.h"
+
+#include <string.h>
+
+
+/// Player states assumed by snapshots which are not relative to another
+static const unsigned char noStates[MAX_PLAYERS * MTL_P_TEMP] = {0};
+
+
+/**
+ * Determine whether one sequence number is later than another, allowing for
+ * wrapping.
+ *
+ * @param seq The sequence number
+ * @param other The other sequence number
+ *
+ * @return True if seq is later
+ */
+static bool isLater (unsigned short seq, unsigned short other) {
+
+	return (short)(seq - other) > 0;
+
+}
+
+
+/**
+ * Create an empty snapshot history.
+ *
+ * @param players Number of players each snapshot can hold, at most MAX_PLAYERS
+ */
+Snapshots::Snapshots (int players) {
+
+	maxPlayers = players;
+
+	sent = new unsigned char[SNAPSHOT_HISTORY * maxPlayers * MTL_P_TEMP];
+	received = new unsigned char[SNAPSHOT_HISTORY * maxPlayers * MTL_P_TEMP];
+	current = new unsigned char[maxPlayers * MTL_P_TEMP];
+
+	memset(sentSeqs, 0, sizeof(sentSeqs));
+	memset(receivedSeqs, 0, sizeof(receivedSeqs));
+	memset(current, 0, maxPlayers * MTL_P_TEMP);
+
+	first = 0;
+	seq = 0;
+	acked = 0;
+	latest = 0;
+
+	return;
+
+}
+
+
+/**
+ * Delete the snapshot history.
+ */
+Snapshots::~Snapshots () {
+
+	delete[] sent;
+	delete[] received;
+	delete[] current;
+
+	return;
+
+}
+
+
+/**
+ * Encode a new snapshot of the given player states.
+ *
+ * @param packet Buffer to receive the snapshot, at least SNAPSHOT_SIZE bytes
+ * @param states MT_P_TEMP player states, indexed by player number. Players
+ * with NULL states are left out.
+ * @param nStates Number of entries in states
+ * @param size Most bytes the snapshot may take, up to SNAPSHOT_SIZE. Players
+ * which do not fit are encoded first next time.
+ *
+ * @return The length of the snapshot
+ */
+int Snapshots::encode (unsigned char* packet, unsigned char** states, int nStates, int size) {
+
+	const unsigned char* base;
+	unsigned char* slotStates;
+	unsigned char* state;
+	unsigned char* mask;
+	unsigned short baseSeq;
+	int slot, player, skipped, offset, count, position, changed;
+
+	seq++;
+	if (!seq) seq = 1;
+
+	slot = seq & (SNAPSHOT_HISTORY - 1);
+	slotStates = sent + (slot * maxPlayers * MTL_P_TEMP);
+
+	// Encode relative to the last snapshot the other side received, if it is
+	// still remembered
+	if (acked && ((unsigned short)(seq - acked) < SNAPSHOT_HISTORY) &&
+		(sentSeqs[acked & (SNAPSHOT_HISTORY - 1)] == acked)) {
+
+		baseSeq = acked;
+		base = sent + ((acked & (SNAPSHOT_HISTORY - 1)) * maxPlayers * MTL_P_TEMP);
+
+	} else {
+
+		baseSeq = 0;
+		base = noStates;
+
+	}
+
+	packet[0] = seq >> 8;
+	packet[1] = seq & 255;
+	packet[2] = baseSeq >> 8;
+	packet[3] = baseSeq & 255;
+	packet[4] = latest >> 8;
+	packet[5] = latest & 255;
+	packet[6] = 0;
+	position = SNAPSHOT_HEADER;
+
+	// Unless encoded below, the other side will keep the base states
+	memcpy(slotStates, base, maxPlayers * MTL_P_TEMP);
+
+	if (nStates > maxPlayers) nStates = maxPlayers;
+	if (first >= nStates) first = 0;
+
+	skipped = -1;
+
+	for (offset = 0; offset < nStates; offset++) {
+
+		// Start with any player left out of the last snapshot, so that every
+		// player gets through when they cannot all fit
+		player = (first + offset) % nStates;
+
+		if (!states[player]) continue;
+
+		if (position + 1 + SNAPSHOT_MASK + MTL_P_TEMP - SNAPSHOT_FIRST > size) {
+
+			if (skipped == -1) skipped = player;
+
+			continue;
+
+		}
+
+		state = slotStates + (player * MTL_P_TEMP);
+		memcpy(state, states[player], MTL_P_TEMP);
+		state[0] = MTL_P_TEMP;
+		state[1] = MT_P_TEMP;
+		state[2] = player;
+
+		// Quantise positions to 1/16 of a pixel
+		state[40] &= 0xC0;
+		state[44] &= 0xC0;
+
+		mask = packet + position + 1;
+		memset(mask, 0, SNAPSHOT_MASK);
+		changed = 0;
+
+		for (count = SNAPSHOT_FIRST; count < MTL_P_TEMP; count++) {
+
+			if (state[count] != base[(player * MTL_P_TEMP) + count]) {
+
+				mask[(count - SNAPSHOT_FIRST) >> 3] |= 1 << ((count - SNAPSHOT_FIRST) & 7);
+				packet[position + 1 + SNAPSHOT_MASK + changed] = state[count];
+				changed++;
+
+			}
+
+		}
+
+		if (!changed) continue;
+
+		packet[position] = player;
+		position += 1 + SNAPSHOT_MASK + changed;
+		packet[6]++;
+
+	}
+
+	if (skipped != -1) first = skipped;
+
+	sentSeqs[slot] = seq;
+
+	return position;
+
+}
+
+
+/**
+ * Decode a received snapshot.
+ *
+ * @param packet The snapshot
+ * @param length The length of the snapshot
+ * @param states Array to receive the MT_P_TEMP states of the players which have
+ * changed since the last snapshot received, at least as many entries as the
+ * snapshots can hold players
+ *
+ * @return The number of player states received
+ */
+int Snapshots::decode (unsigned char* packet, int length, unsigned char states[][MTL_P_TEMP]) {
+
+	const unsigned char* base;
+	unsigned char* slotStates;
+	unsigned char* state;
+	unsigned char* mask;
+	unsigned short packetSeq, baseSeq, ack;
+	bool changed[MAX_PLAYERS];
+	int slot, player, count, position, nPlayers, nStates;
+
+	if (length < SNAPSHOT_HEADER) return 0;
+
+	packetSeq = (packet[0] << 8) + packet[1];
+	baseSeq = (packet[2] << 8) + packet[3];
+	ack = (packet[4] << 8) + packet[5];
+	nPlayers = packet[6];
+
+	if (!packetSeq) return 0;
+
+	// Note which of the sent snapshots the other side has received
+	if (ack && !isLater(ack, seq) && (!acked || isLater(ack, acked))) acked = ack;
+
+	// Ignore snapshots which arrive late or twice
+	if (latest && !isLater(packetSeq, latest)) return 0;
+
+	if (!baseSeq) {
+
+		base = noStates;
+
+	} else {
+
+		// The base snapshot must still be remembered
+		if (((unsigned short)(packetSeq - baseSeq) >= SNAPSHOT_HISTORY) ||
+			(receivedSeqs[baseSeq & (SNAPSHOT_HISTORY - 1)] != baseSeq))
+			return 0;
+
+		base = received + ((baseSeq & (SNAPSHOT_HISTORY - 1)) * maxPlayers * MTL_P_TEMP);
+
+	}
+
+	slot = packetSeq & (SNAPSHOT_HISTORY - 1);
+	slotStates = received + (slot * maxPlayers * MTL_P_TEMP);
+	receivedSeqs[slot] = 0;
+	memcpy(slotStates, base, maxPlayers * MTL_P_TEMP);
+
+	memset(changed, 0, sizeof(changed));
+	position = SNAPSHOT_HEADER;
+
+	for (; nPlayers; nPlayers--) {
+
+		if (position + 1 + SNAPSHOT_MASK > length) return 0;
+
+		player = packet[position];
+
+		if (player >= maxPlayers) return 0;
+
+		mask = packet + position + 1;
+		position += 1 + SNAPSHOT_MASK;
+
+		state = slotStates + (player * MTL_P_TEMP);
+		state[0] = MTL_P_TEMP;
+		state[1] = MT_P_TEMP;
+		state[2] = player;
+		changed[player] = true;
+
+		for (count = SNAPSHOT_FIRST; count < MTL_P_TEMP; count++) {
+
+			if (mask[(count - SNAPSHOT_FIRST) >> 3] & (1 << ((count - SNAPSHOT_FIRST) & 7))) {
+
+				if (position >= length) return 0;
+
+				state[count] = packet[position++];
+
+			}
+
+		}
+
+	}
+
+	receivedSeqs[slot] = packetSeq;
+	latest = packetSeq;
+
+	// Players left out match the base snapshot, which may be older than the
+	// last snapshot received, so compare every player with its last state
+	nStates = 0;
+
+	for (player = 0; player < maxPlayers; player++) {
+
+		state = slotStates + (player * MTL_P_TEMP);
+
+		if (!changed[player] &&
+			!memcmp(state, current + (player * MTL_P_TEMP), MTL_P_TEMP)) continue;
+
+		memcpy(current + (player * MTL_P_TEMP), state, MTL_P_TEMP);
+		memcpy(states[nStates], state, MTL_P_TEMP);
+		states[nStates][0] = MTL_P_TEMP;
+		states[nStates][1] = MT_P_TEMP;
+		states[nStates][2] = player;
+		nStates++;
+
+	}
+
+	return nStates;
+
+}
+
+
+/**
+ * Determine whether or not the other side has received any of the sent
+ * snapshots.
+ *
+ * @return True if a snapshot has been received
+ */
+bool Snapshots::isAcknowledged () {
+
+	return acked != 0;
+
+}
+
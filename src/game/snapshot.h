@@ -0,0 +1,78 @@
+
+/**
+ *
+ * @file snapshot.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created snapshot.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _SNAPSHOT_H
+#define _SNAPSHOT_H
+
+
+#include "game.h"
+#include "gamemode.h"
+
+
+// Constants
+
+// Number of snapshots remembered in each direction, must be a power of 2
+#define SNAPSHOT_HISTORY 16
+
+// Largest encoded snapshot, keeping datagrams within a typical MTU
+#define SNAPSHOT_SIZE 1200
+
+// Smallest limit on an encoded snapshot, leaving room for a few players
+#define SNAPSHOT_MIN  256
+
+// Snapshot header: sequence number, base sequence number, acknowledgement and
+// number of players
+#define SNAPSHOT_HEADER 7
+
+// Bytes of each player's state which are delta-compressed, and the size of the
+// mask of those which have changed
+#define SNAPSHOT_FIRST 3
+#define SNAPSHOT_MASK  ((MTL_P_TEMP - SNAPSHOT_FIRST + 7) >> 3)
+
+
+// Class
+
+/// Sequence-numbered player state sent over an unreliable connection, with
+/// each snapshot delta-compressed against the last one the other side received
+class Snapshots {
+
+	private:
+		unsigned char *sent; ///< Sent player states, as the other side will have decoded them, for each snapshot in the history
+		unsigned short sentSeqs[SNAPSHOT_HISTORY]; ///< Sequence numbers of the sent snapshots
+		unsigned char *received; ///< Decoded player states, for each snapshot in the history
+		unsigned short receivedSeqs[SNAPSHOT_HISTORY]; ///< Sequence numbers of the decoded snapshots
+		unsigned char *current; ///< The last decoded state of each player
+		int            maxPlayers; ///< Number of players each snapshot can hold
+		int            first; ///< Player whose state is encoded first next time
+		unsigned short seq; ///< Sequence number of the last snapshot sent
+		unsigned short acked; ///< Sequence number of the last sent snapshot the other side received, or 0
+		unsigned short latest; ///< Sequence number of the last snapshot received, or 0
+
+	public:
+		Snapshots  (int players);
+		~Snapshots ();
+
+		int  encode         (unsigned char* packet, unsigned char** states, int nStates, int size);
+		int  decode         (unsigned char* packet, int length, unsigned char states[][MTL_P_TEMP]);
+		bool isAcknowledged ();
+
+};
+
+#endif
+
@@ -0,0 +1,257 @@
+
+/**
+ *
+ * @file wire.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created wire.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Packs the messages sent most often into as few bits as their values need,
+ * and unpacks them as they arrive. The layout of each packed message type is
+ * held here, in one place. Everywhere else, messages keep their fixed byte
+ * layout, which the datagram snapshots are delta-compressed against.
+ *
+ * Packing loses nothing. Every machine places each player exactly where the
+ * player's owner says, and rolled-back levels compare their states, so
+ * positions are only sent in fewer bits when they fit in them.
+ *
+ */
+
+
+#include "wire.h"
+
+#include "game.h"
+#include "io/bitstream.h"
+
+#include <string.h>
+
+
+/// Temporary player properties, see Player::send() and LevelPlayer::send()
+static const WireField pTempFields[] = {
+
+	{3, 1, WF_FLAG, 1}, // Up
+	{4, 1, WF_FLAG, 1}, // Down
+	{5, 1, WF_FLAG, 1}, // Left
+	{6, 1, WF_FLAG, 1}, // Right
+	{7, 1, WF_FLAG, 1}, // Jump
+	{8, 1, WF_FLAG, 1}, // Fire
+	{45, 1, WF_FLAG, 1}, // Swim
+	{26, 1, WF_FLAG, 1}, // Flying or floating
+	{27, 1, WF_FLAG, 1}, // Facing
+	{9, 1, WF_SMALL, 3}, // Birds
+	{10, 2, WF_VARINT, 0}, // Ammo
+	{12, 2, WF_VARINT, 0},
+	{14, 2, WF_VARINT, 0},
+	{16, 2, WF_VARINT, 0},
+	{18, 1, WF_SMALL, 3}, // Ammo type
+	{19, 4, WF_VARINT, 0}, // Score
+	{23, 1, WF_SMALL, 3}, // Energy
+	{24, 1, WF_SMALL, 4}, // Lives
+	{25, 1, WF_SMALL, 3}, // Shield
+	{28, 1, WF_SMALL, 4}, // Fire speed
+	{29, 4, WF_SIGNED, WIRE_POSITION_BITS}, // Jump height
+	{33, 4, WF_SIGNED, WIRE_POSITION_BITS}, // Target or throw y-coordinate
+	{37, 4, WF_SIGNED, WIRE_POSITION_BITS}, // X-coordinate
+	{41, 4, WF_SIGNED, WIRE_POSITION_BITS} // Y-coordinate
+
+};
+
+/// Player controls, see Level::sendInput()
+static const WireField pInputFields[] = {
+
+	{3, 4, WF_VARINT, 0}, // Step
+	{7, 1, WF_SMALL, 7} // Controls held
+
+};
+
+/// The message types which are packed
+static const WireLayout layouts[] = {
+
+	{MT_P_TEMP, MTL_P_TEMP, pTempFields, sizeof(pTempFields) / sizeof(WireField)},
+	{MT_P_INPUT, MTL_P_INPUT, pInputFields, sizeof(pInputFields) / sizeof(WireField)}
+
+};
+
+
+/**
+ * Find how a type of message is packed.
+ *
+ * @param type The message type
+ *
+ * @return The message type's layout, or NULL if it is sent as it is
+ */
+static const WireLayout* findLayout (unsigned char type) {
+
+	unsigned int count;
+
+	for (count = 0; count < sizeof(layouts) / sizeof(WireLayout); count++) {
+
+		if (layouts[count].type == type) return layouts + count;
+
+	}
+
+	return NULL;
+
+}
+
+
+/**
+ * Pack a message to be sent.
+ *
+ * @param message The message, with its usual layout
+ * @param packed Buffer of BUFFER_LENGTH bytes to hold the packed message,
+ * which may be the same as the message
+ *
+ * @return The packed message's length
+ */
+int packMessage (const unsigned char* message, unsigned char* packed) {
+
+	unsigned char bits[BUFFER_LENGTH];
+	const WireLayout* layout;
+	const WireField* field;
+	unsigned int value;
+	int count, byte;
+
+	layout = findLayout(message[1]);
+
+	if (!layout || (message[0] != layout->length)) {
+
+		if (packed != message) memcpy(packed, message, message[0]);
+
+		return message[0];
+
+	}
+
+	BitWriter writer(bits, BUFFER_LENGTH - WIRE_HEADER);
+
+	for (count = 0; count < layout->nFields; count++) {
+
+		field = layout->fields + count;
+
+		value = 0;
+
+		for (byte = 0; byte < field->size; byte++) value = (value << 8) + message[field->offset + byte];
+
+		switch (field->type) {
+
+			case WF_FLAG:
+
+				writer.writeBits(value? 1: 0, 1);
+
+				break;
+
+			case WF_SMALL:
+
+				writer.writeBounded(value, field->bits, field->size << 3);
+
+				break;
+
+			case WF_VARINT:
+
+				writer.writeVarint(value);
+
+				break;
+
+			case WF_SIGNED:
+
+				writer.writeSigned((int)value, field->bits, field->size << 3);
+
+				break;
+
+		}
+
+	}
+
+	packed[0] = WIRE_HEADER + writer.getLength();
+	packed[1] = message[1];
+	packed[2] = message[2];
+	memcpy(packed + WIRE_HEADER, bits, writer.getLength());
+
+	return packed[0];
+
+}
+
+
+/**
+ * Unpack a message as it arrives, in place.
+ *
+ * @param message Buffer of BUFFER_LENGTH bytes holding the packed message
+ *
+ * @return Whether or not the message was whole
+ */
+bool unpackMessage (unsigned char* message) {
+
+	unsigned char bits[BUFFER_LENGTH];
+	const WireLayout* layout;
+	const WireField* field;
+	unsigned int value;
+	int count, byte;
+
+	layout = findLayout(message[1]);
+
+	if (!layout) return true;
+
+	if (message[0] < WIRE_HEADER) return false;
+
+	memcpy(bits, message + WIRE_HEADER, message[0] - WIRE_HEADER);
+
+	BitReader reader(bits, message[0] - WIRE_HEADER);
+
+	memset(message + WIRE_HEADER, 0, layout->length - WIRE_HEADER);
+
+	for (count = 0; count < layout->nFields; count++) {
+
+		field = layout->fields + count;
+
+		switch (field->type) {
+
+			case WF_FLAG:
+
+				value = reader.readBits(1);
+
+				break;
+
+			case WF_SMALL:
+
+				value = reader.readBounded(field->bits, field->size << 3);
+
+				break;
+
+			case WF_VARINT:
+
+				value = reader.readVarint();
+
+				break;
+
+			default:
+
+				value = reader.readSigned(field->bits, field->size << 3);
+
+				break;
+
+		}
+
+		for (byte = field->size - 1; byte >= 0; byte--) {
+
+			message[field->offset + byte] = value & 255;
+			value >>= 8;
+
+		}
+
+	}
+
+	message[0] = layout->length;
+
+	return !reader.hasOverflowed();
+
+}
+
@@ -0,0 +1,76 @@
+
+/**
+ *
+ * @file wire.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created wire.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * The compact forms in which messages are sent between machines.
+ *
+ */
+
+
+#ifndef _WIRE_H
+#define _WIRE_H
+
+
+// Constants
+
+// Bytes at the start of each message which are always sent as they are: its
+// length, type and player or other subject
+#define WIRE_HEADER 3
+
+// Bits within which positions are expected to fit, including their sign
+#define WIRE_POSITION_BITS 25
+
+
+// Datatypes
+
+/// How a field of a message is packed
+enum WireFieldType {
+
+	WF_FLAG, ///< A byte which is either 0 or 1, sent as a single bit
+	WF_SMALL, ///< An unsigned value expected to fit in a few bits
+	WF_VARINT, ///< An unsigned value of any size, sent in groups of bits
+	WF_SIGNED ///< A signed value expected to fit in a few bits
+
+};
+
+/// A field of a message
+typedef struct {
+
+	unsigned char offset; ///< The field's first byte
+	unsigned char size; ///< Number of bytes, most significant first
+	WireFieldType type; ///< How the field is packed
+	unsigned char bits; ///< Bits the field is expected to fit in
+
+} WireField;
+
+/// The layout of a type of message which is packed
+typedef struct {
+
+	unsigned char    type; ///< The message type
+	unsigned char    length; ///< The unpacked message's length
+	const WireField* fields; ///< The message's fields, after the header
+	int              nFields; ///< Number of fields
+
+} WireLayout;
+
+
+// Functions
+
+int  packMessage   (const unsigned char* message, unsigned char* packed);
+bool unpackMessage (unsigned char* message);
+
+#endif
+
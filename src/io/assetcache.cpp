@@ -0,0 +1,521 @@
+
+/**
+ *
+ * @file assetcache.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created assetcache.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Keeps data decoded from files, such as tile sets and sprites, so that later
+ * levels using the same files need not decode them again.
+ *
+ */
+
+
+#include "assetcache.h"
+#include "file.h"
+
+#include "util.h"
+
+#include <string.h>
+
+
+/**
+ * Delete the asset.
+ */
+Asset::~Asset () {
+
+	return;
+
+}
+
+
+/**
+ * Make whatever part of the asset can only be made on the main thread, such
+ * as surfaces, which share a palette. Preloaders decode assets on other
+ * threads, so the main thread finishes every asset before it is used. Nothing
+ * is done if the asset is already finished.
+ */
+void Asset::finish () {
+
+	return;
+
+}
+
+
+/**
+ * Create a cached asset.
+ *
+ * @param newNext Next cached asset
+ * @param newFileName Name of the file the asset was decoded from
+ * @param newTime Modification time of the file
+ * @param newAsset The decoded data
+ * @param newSize Approximate memory used by the asset
+ */
+CachedAsset::CachedAsset (CachedAsset* newNext, const char* newFileName, time_t newTime, Asset* newAsset, int newSize) {
+
+	next = newNext;
+	fileName = createString(newFileName);
+	time = newTime;
+	asset = newAsset;
+	size = newSize;
+	users = 1;
+	lastUsed = 0;
+
+	return;
+
+}
+
+
+/**
+ * Delete the cached asset.
+ */
+CachedAsset::~CachedAsset () {
+
+	delete asset;
+	delete[] fileName;
+
+	return;
+
+}
+
+
+/**
+ * Create an empty cache.
+ */
+AssetCache::AssetCache () {
+
+	assets = NULL;
+	budget = ASSET_BUDGET;
+	uses = 0;
+	lock = SDL_CreateMutex();
+	preloadFile = NULL;
+	SDL_AtomicSet(&cancelled, 0);
+
+	return;
+
+}
+
+
+/**
+ * Delete the cache and every asset in it.
+ */
+AssetCache::~AssetCache () {
+
+	clear();
+
+	if (lock) SDL_DestroyMutex(lock);
+
+	return;
+
+}
+
+
+/**
+ * Evict the least recently used assets which no level is using, until the
+ * unused assets fit within a limit. The lock must be held.
+ *
+ * @param limit Memory which may be spent on unused assets
+ *
+ * @return Whether or not any assets were evicted
+ */
+bool AssetCache::trim (int limit) {
+
+	CachedAsset* cached;
+	CachedAsset** oldest;
+	CachedAsset** link;
+	int unused;
+	bool evicted;
+
+	evicted = false;
+
+	while (true) {
+
+		unused = 0;
+		oldest = NULL;
+
+		for (link = &assets; *link; link = &((*link)->next)) {
+
+			cached = *link;
+
+			if (cached->users) continue;
+
+			unused += cached->size;
+
+			if (!oldest || (cached->lastUsed < (*oldest)->lastUsed)) oldest = link;
+
+		}
+
+		if (!oldest || (unused <= limit)) return evicted;
+
+		cached = *oldest;
+		*oldest = cached->next;
+
+		LOG("Evicted asset", cached->fileName);
+
+		delete cached;
+
+		evicted = true;
+
+	}
+
+}
+
+
+/**
+ * Find the asset decoded from a file, if it is cached and the file has not
+ * changed since. The caller must release the asset when done with it.
+ *
+ * @param fileName Name of the file
+ *
+ * @return The asset, or NULL if it has to be decoded
+ */
+Asset* AssetCache::find (const char* fileName) {
+
+	CachedAsset* cached;
+	time_t time;
+
+	// The asset may be being preloaded
+	finishPreload();
+
+	time = getFileTime(fileName);
+
+	SDL_LockMutex(lock);
+
+	for (cached = assets; cached; cached = cached->next) {
+
+		if (strcmp(cached->fileName, fileName) || (cached->time != time)) continue;
+
+		cached->users++;
+		cached->lastUsed = ++uses;
+
+		SDL_UnlockMutex(lock);
+
+		return cached->asset;
+
+	}
+
+	SDL_UnlockMutex(lock);
+
+	return NULL;
+
+}
+
+
+/**
+ * Check whether the asset decoded from a file is cached, and the file has not
+ * changed since. Unlike find(), this does not wait for preloading, so may be
+ * used by preloaders.
+ *
+ * @param fileName Name of the file
+ *
+ * @return Whether or not the asset is cached
+ */
+bool AssetCache::contains (const char* fileName) {
+
+	CachedAsset* cached;
+	time_t time;
+
+	time = getFileTime(fileName);
+
+	SDL_LockMutex(lock);
+
+	for (cached = assets; cached; cached = cached->next) {
+
+		if (!strcmp(cached->fileName, fileName) && (cached->time == time)) break;
+
+	}
+
+	SDL_UnlockMutex(lock);
+
+	return cached != NULL;
+
+}
+
+
+/**
+ * Add a newly decoded asset to the cache. The asset belongs to the cache from
+ * then on, and counts as being in use by the caller, who must release it when
+ * done with it.
+ *
+ * @param fileName Name of the file the asset was decoded from
+ * @param asset The decoded data
+ * @param size Approximate memory used by the asset
+ */
+void AssetCache::add (const char* fileName, Asset* asset, int size) {
+
+	CachedAsset* cached;
+	CachedAsset** link;
+	time_t time;
+
+	time = getFileTime(fileName);
+
+	SDL_LockMutex(lock);
+
+	// Any unused copy decoded from an older version of the file is now useless
+	link = &assets;
+
+	while (*link) {
+
+		cached = *link;
+
+		if (!cached->users && !strcmp(cached->fileName, fileName)) {
+
+			*link = cached->next;
+			delete cached;
+
+		} else link = &(cached->next);
+
+	}
+
+	assets = new CachedAsset(assets, fileName, time, asset, size);
+	assets->lastUsed = ++uses;
+
+	SDL_UnlockMutex(lock);
+
+	return;
+
+}
+
+
+/**
+ * Stop using an asset. It stays cached while the budget allows.
+ *
+ * @param asset The asset
+ */
+void AssetCache::release (Asset* asset) {
+
+	CachedAsset* cached;
+
+	SDL_LockMutex(lock);
+
+	for (cached = assets; cached; cached = cached->next) {
+
+		if (cached->asset == asset) {
+
+			if (cached->users) cached->users--;
+
+			break;
+
+		}
+
+	}
+
+	trim(budget);
+
+	SDL_UnlockMutex(lock);
+
+	return;
+
+}
+
+
+/**
+ * Run the preloader, as a background job.
+ *
+ * @param data The cache
+ */
+void AssetCache::runPreloader (void* data) {
+
+	AssetCache* cache;
+
+	cache = (AssetCache *)data;
+
+	cache->preloader(cache->preloadFile);
+
+	return;
+
+}
+
+
+/**
+ * Start decoding assets for a file in the background, such as the next
+ * level's tile set while a cutscene plays. The preloader uses contains(),
+ * add() and release() to put what it decodes in the cache, leaving the assets
+ * to be finished. Any earlier preloading is finished first.
+ *
+ * @param newPreloader The function that decodes the assets
+ * @param fileName The file to pass to the preloader
+ */
+void AssetCache::preload (AssetPreloader newPreloader, const char* fileName) {
+
+	finishPreload();
+
+	preloader = newPreloader;
+	preloadFile = createString(fileName);
+	SDL_AtomicSet(&cancelled, 0);
+
+	// Without worker threads, the assets are decoded now
+	jobs.prepare(&preloadJob, runPreloader, this, NULL, true);
+	jobs.submit(&preloadJob);
+
+	return;
+
+}
+
+
+/**
+ * Wait for any preloading to finish, then finish the assets it decoded.
+ * Called by the main thread.
+ */
+void AssetCache::finishPreload () {
+
+	CachedAsset* cached;
+
+	if (!preloadFile) return;
+
+	jobs.wait(&preloadJob);
+
+	delete[] preloadFile;
+	preloadFile = NULL;
+
+	SDL_LockMutex(lock);
+
+	for (cached = assets; cached; cached = cached->next) cached->asset->finish();
+
+	SDL_UnlockMutex(lock);
+
+	return;
+
+}
+
+
+/**
+ * Ask the preloader to stop at its next opportunity, without waiting for it.
+ * Whatever it has already added to the cache is kept.
+ */
+void AssetCache::cancelPreload () {
+
+	SDL_AtomicSet(&cancelled, 1);
+
+	return;
+
+}
+
+
+/**
+ * Find whether or not preloading is still going on.
+ *
+ * @return Whether or not the preloader is running
+ */
+bool AssetCache::isPreloading () {
+
+	return preloadFile && !jobs.isDone(&preloadJob);
+
+}
+
+
+/**
+ * Find whether or not the preloader has been asked to stop. Called by the
+ * preloader between its steps.
+ *
+ * @return Whether or not the preloader should stop
+ */
+bool AssetCache::isCancelled () {
+
+	return SDL_AtomicGet(&cancelled) != 0;
+
+}
+
+
+/**
+ * Cancel any preloading, as memory is running short. Called by any thread.
+ *
+ * @param data The cache
+ *
+ * @return Whether or not preloading was cancelled
+ */
+bool AssetCache::relievePreload (void* data) {
+
+	AssetCache* cache;
+
+	cache = (AssetCache *)data;
+
+	if (!cache->preloadFile || cache->isCancelled()) return false;
+
+	cache->cancelPreload();
+
+	// The memory is only freed as the preloader stops, so whether this
+	// helped an allocation is unknown
+	return true;
+
+}
+
+
+/**
+ * Evict every asset which no level is using, as memory is running short.
+ * Called by any thread, so gives up if another thread holds the lock.
+ *
+ * @param data The cache
+ *
+ * @return Whether or not any assets were evicted
+ */
+bool AssetCache::relieveUnused (void* data) {
+
+	AssetCache* cache;
+	bool evicted;
+
+	cache = (AssetCache *)data;
+
+	if (SDL_TryLockMutex(cache->lock)) return false;
+
+	evicted = cache->trim(0);
+
+	SDL_UnlockMutex(cache->lock);
+
+	return evicted;
+
+}
+
+
+/**
+ * Set how much memory may be spent on assets which no level is using.
+ *
+ * @param newBudget The budget, in bytes
+ */
+void AssetCache::setBudget (int newBudget) {
+
+	SDL_LockMutex(lock);
+
+	budget = newBudget;
+
+	trim(budget);
+
+	SDL_UnlockMutex(lock);
+
+	return;
+
+}
+
+
+/**
+ * Delete every cached asset. No level may be using any of them.
+ */
+void AssetCache::clear () {
+
+	CachedAsset* cached;
+
+	finishPreload();
+
+	while (assets) {
+
+		cached = assets;
+		assets = cached->next;
+
+		delete cached;
+
+	}
+
+	return;
+
+}
+
@@ -0,0 +1,125 @@
+
+/**
+ *
+ * @file assetcache.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created assetcache.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _ASSETCACHE_H
+#define _ASSETCACHE_H
+
+
+#include "OpenJazz.h"
+
+#define SDL2
+
+#ifdef SDL2
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+#include <time.h>
+
+#include "jobs.h"
+
+
+// Constant
+
+// Memory to spend on assets no level is using
+#ifndef ASSET_BUDGET
+	#define ASSET_BUDGET (48 << 20)
+#endif
+
+
+// Datatype
+
+/// Function which decodes assets for a file in the background
+typedef void (*AssetPreloader) (const char* fileName);
+
+
+// Classes
+
+/// Data decoded from a file, which may be kept for later levels
+class Asset {
+
+	public:
+		virtual ~Asset ();
+
+		virtual void finish ();
+
+};
+
+/// Cached asset
+class CachedAsset {
+
+	public:
+		CachedAsset* next; ///< Next cached asset
+		char*        fileName; ///< Name of the file the asset was decoded from
+		time_t       time; ///< Modification time of the file
+		Asset*       asset; ///< The decoded data
+		int          size; ///< Approximate memory used by the asset
+		int          users; ///< Number of levels using the asset
+		unsigned int lastUsed; ///< When the asset was last requested
+
+		CachedAsset  (CachedAsset* newNext, const char* newFileName, time_t newTime, Asset* newAsset, int newSize);
+		~CachedAsset ();
+
+};
+
+/// Cache of assets shared between levels
+class AssetCache {
+
+	private:
+		CachedAsset*   assets; ///< Cached assets
+		int            budget; ///< Memory which may be spent on unused assets
+		unsigned int   uses; ///< Number of requests made, used to order assets by use
+		SDL_mutex*     lock; ///< Guards the cached assets against the preloading job
+		Job            preloadJob; ///< Job decoding assets in the background
+		AssetPreloader preloader; ///< Function run by the preloading job
+		char*          preloadFile; ///< File passed to the preloader
+		SDL_atomic_t   cancelled; ///< Whether or not the preloader should stop early
+
+		static void runPreloader (void* data);
+
+		bool trim (int limit);
+
+	public:
+		AssetCache  ();
+		~AssetCache ();
+
+		static bool relievePreload (void* data);
+		static bool relieveUnused  (void* data);
+
+		Asset* find           (const char* fileName);
+		bool   contains       (const char* fileName);
+		void   add            (const char* fileName, Asset* asset, int size);
+		void   release        (Asset* asset);
+		void   preload        (AssetPreloader newPreloader, const char* fileName);
+		void   finishPreload  ();
+		void   cancelPreload  ();
+		bool   isPreloading   ();
+		bool   isCancelled    ();
+		void   setBudget      (int newBudget);
+		void   clear          ();
+
+};
+
+
+// Variable
+
+EXTERN AssetCache assetCache; ///< Assets shared between levels
+
+#endif
+
@@ -0,0 +1,322 @@
+
+/**
+ *
+ * @file bitstream.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created bitstream.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Packs values into buffers a few bits at a time, and unpacks them again.
+ *
+ * Bounded values are sent in fewer bits than they are held in, as long as
+ * they fit, after a bit saying whether they did. Those which do not are sent
+ * whole, so nothing is ever lost. Variable-length integers are sent
+ * BIT_VARINT_GROUP bits at a time, least significant first, each group
+ * preceded by a bit saying whether another follows.
+ *
+ */
+
+
+#include "bitstream.h"
+
+
+/**
+ * Create a writer for an empty buffer.
+ *
+ * @param buffer The buffer
+ * @param bytes Bytes in the buffer
+ */
+BitWriter::BitWriter (unsigned char* buffer, int bytes) {
+
+	data = buffer;
+	size = bytes;
+	position = 0;
+	overflowed = false;
+
+	return;
+
+}
+
+
+/**
+ * Write the lowest bits of a value.
+ *
+ * @param value The value
+ * @param bits Number of bits, from 1 to 32
+ */
+void BitWriter::writeBits (unsigned int value, int bits) {
+
+	int bit;
+
+	if (position + bits > size << 3) {
+
+		overflowed = true;
+
+		return;
+
+	}
+
+	for (bit = bits - 1; bit >= 0; bit--) {
+
+		if (!(position & 7)) data[position >> 3] = 0;
+
+		if ((value >> bit) & 1) data[position >> 3] |= 128 >> (position & 7);
+
+		position++;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Write a value in as few bytes' worth of groups as it needs.
+ *
+ * @param value The value
+ */
+void BitWriter::writeVarint (unsigned int value) {
+
+	while (value >= 1U << BIT_VARINT_GROUP) {
+
+		writeBits(1, 1);
+		writeBits(value & ((1 << BIT_VARINT_GROUP) - 1), BIT_VARINT_GROUP);
+		value >>= BIT_VARINT_GROUP;
+
+	}
+
+	writeBits(0, 1);
+	writeBits(value, BIT_VARINT_GROUP);
+
+	return;
+
+}
+
+
+/**
+ * Write an unsigned value in fewer bits if it fits, or whole if it does not.
+ *
+ * @param value The value
+ * @param bits Number of bits the value is expected to fit in
+ * @param fullBits Number of bits the value is held in
+ */
+void BitWriter::writeBounded (unsigned int value, int bits, int fullBits) {
+
+	if ((bits < 32) && (value >> bits)) {
+
+		writeBits(1, 1);
+		writeBits(value, fullBits);
+
+	} else {
+
+		writeBits(0, 1);
+		writeBits(value, bits);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Write a signed value in fewer bits if it fits, or whole if it does not.
+ *
+ * @param value The value
+ * @param bits Number of bits the value is expected to fit in, including its
+ * sign
+ * @param fullBits Number of bits the value is held in
+ */
+void BitWriter::writeSigned (int value, int bits, int fullBits) {
+
+	if ((value >= -(1 << (bits - 1))) && (value < (1 << (bits - 1)))) {
+
+		writeBits(0, 1);
+		writeBits(value, bits);
+
+	} else {
+
+		writeBits(1, 1);
+		writeBits(value, fullBits);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Find how many bytes have been written to, including any partly filled.
+ *
+ * @return Number of bytes
+ */
+int BitWriter::getLength () {
+
+	return (position + 7) >> 3;
+
+}
+
+
+/**
+ * Determine whether or not anything has failed to fit in the buffer.
+ *
+ * @return Whether or not the buffer overflowed
+ */
+bool BitWriter::hasOverflowed () {
+
+	return overflowed;
+
+}
+
+
+/**
+ * Create a reader for a buffer.
+ *
+ * @param buffer The buffer
+ * @param bytes Bytes in the buffer
+ */
+BitReader::BitReader (const unsigned char* buffer, int bytes) {
+
+	data = buffer;
+	size = bytes;
+	position = 0;
+	overflowed = false;
+
+	return;
+
+}
+
+
+/**
+ * Read a value.
+ *
+ * @param bits Number of bits, from 1 to 32
+ *
+ * @return The value, or 0 if it lies beyond the buffer
+ */
+unsigned int BitReader::readBits (int bits) {
+
+	unsigned int value;
+
+	if (position + bits > size << 3) {
+
+		overflowed = true;
+
+		return 0;
+
+	}
+
+	value = 0;
+
+	for (; bits > 0; bits--) {
+
+		value = (value << 1) | ((data[position >> 3] >> (7 - (position & 7))) & 1);
+		position++;
+
+	}
+
+	return value;
+
+}
+
+
+/**
+ * Read a value written in groups.
+ *
+ * @return The value
+ */
+unsigned int BitReader::readVarint () {
+
+	unsigned int value;
+	int shift;
+	bool more;
+
+	value = 0;
+	shift = 0;
+
+	do {
+
+		more = readBits(1);
+
+		// No 32-bit value has more groups than this
+		if (shift >= 32) {
+
+			overflowed = true;
+
+			return 0;
+
+		}
+
+		value |= readBits(BIT_VARINT_GROUP) << shift;
+		shift += BIT_VARINT_GROUP;
+
+	} while (more && !overflowed);
+
+	return value;
+
+}
+
+
+/**
+ * Read an unsigned value written by BitWriter::writeBounded().
+ *
+ * @param bits Number of bits the value was expected to fit in
+ * @param fullBits Number of bits the value is held in
+ *
+ * @return The value
+ */
+unsigned int BitReader::readBounded (int bits, int fullBits) {
+
+	if (readBits(1)) return readBits(fullBits);
+
+	return readBits(bits);
+
+}
+
+
+/**
+ * Read a signed value written by BitWriter::writeSigned().
+ *
+ * @param bits Number of bits the value was expected to fit in
+ * @param fullBits Number of bits the value is held in
+ *
+ * @return The value
+ */
+int BitReader::readSigned (int bits, int fullBits) {
+
+	unsigned int value;
+
+	if (readBits(1)) bits = fullBits;
+
+	value = readBits(bits);
+
+	// Extend the sign
+	if ((bits < 32) && (value & (1U << (bits - 1)))) value |= ~0U << bits;
+
+	return (int)value;
+
+}
+
+
+/**
+ * Determine whether or not anything was read beyond the buffer.
+ *
+ * @return Whether or not the buffer overflowed
+ */
+bool BitReader::hasOverflowed () {
+
+	return overflowed;
+
+}
+
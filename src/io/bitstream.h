@@ -0,0 +1,78 @@
+
+/**
+ *
+ * @file bitstream.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created bitstream.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Values packed into and out of buffers a few bits at a time, for messages
+ * sent over the network.
+ *
+ */
+
+
+#ifndef _BITSTREAM_H
+#define _BITSTREAM_H
+
+
+// Constant
+
+// Bits of a value held by each byte of a variable-length integer
+#define BIT_VARINT_GROUP 7
+
+
+// Classes
+
+/// Packs values into a buffer, most significant bit first
+class BitWriter {
+
+	private:
+		unsigned char* data; ///< The buffer
+		int            size; ///< Bytes in the buffer
+		int            position; ///< Next bit to be written
+		bool           overflowed; ///< Whether or not a value did not fit in the buffer
+
+	public:
+		BitWriter (unsigned char* buffer, int bytes);
+
+		void writeBits    (unsigned int value, int bits);
+		void writeVarint  (unsigned int value);
+		void writeBounded (unsigned int value, int bits, int fullBits);
+		void writeSigned  (int value, int bits, int fullBits);
+		int  getLength    ();
+		bool hasOverflowed ();
+
+};
+
+/// Unpacks values from a buffer written by a BitWriter
+class BitReader {
+
+	private:
+		const unsigned char* data; ///< The buffer
+		int                  size; ///< Bytes in the buffer
+		int                  position; ///< Next bit to be read
+		bool                 overflowed; ///< Whether or not a value was read beyond the buffer
+
+	public:
+		BitReader (const unsigned char* buffer, int bytes);
+
+		unsigned int readBits    (int bits);
+		unsigned int readVarint  ();
+		unsigned int readBounded (int bits, int fullBits);
+		int          readSigned  (int bits, int fullBits);
+		bool         hasOverflowed ();
+
+};
+
+#endif
+
@@ -107,6 +107,16 @@
 #define DEFAULT_KEY_BOUNCER             (SDLK_4)
 #define DEFAULT_KEY_TNT                 (SDLK_5)
 
+/* The second local player's keys */
+#define SECOND_KEY_UP                   (SDLK_w)
+#define SECOND_KEY_DOWN                 (SDLK_s)
+#define SECOND_KEY_LEFT                 (SDLK_a)
+#define SECOND_KEY_RIGHT                (SDLK_d)
+#define SECOND_KEY_JUMP                 (SDLK_LSHIFT)
+#define SECOND_KEY_SWIM                 (SDLK_LSHIFT)
+#define SECOND_KEY_FIRE                 (SDLK_LCTRL)
+#define SECOND_KEY_CHANGE               (SDLK_TAB)
+
 #if defined(GP2X) || defined(WIZ)
     #define DEFAULT_BUTTON_UP           (0)
     #define DEFAULT_BUTTON_DOWN         (4)
@@ -299,11 +309,173 @@ Controls::Controls () {
 	cursorPressed = false;
 	cursorReleased = false;
 
+	joystick = -1;
+
+	buildLookups();
+
 	return;
 
 }
 
 
+/**
+ * Find the slot in the table of keys for the given key, or the empty slot
+ * where it would go.
+ *
+ * @param key The key
+ *
+ * @return Index of the slot
+ */
+static int getKeySlot (int key) {
+
+	return ((unsigned int)key * 2654435761U) >> (32 - CONTROL_KEY_BITS);
+
+}
+
+
+/**
+ * Rebuild the tables of which controls use each key, button, axis and hat.
+ */
+void Controls::buildLookups () {
+
+	int count, slot;
+
+	for (count = 0; count < (1 << CONTROL_KEY_BITS); count++) keySlots[count].mask = 0;
+
+	for (count = 0; count < CONTROL_INDICES; count++) {
+
+		buttonMasks[count] = 0;
+		axisMasks[count] = 0;
+		hatMasks[count] = 0;
+
+	}
+
+	for (count = 0; count < CONTROLS; count++) {
+
+		// Keys sharing a slot move on to the next free one
+		slot = getKeySlot(keys[count].key);
+
+		while (keySlots[slot].mask && (keySlots[slot].key != keys[count].key))
+			slot = (slot + 1) & ((1 << CONTROL_KEY_BITS) - 1);
+
+		keySlots[slot].key = keys[count].key;
+		keySlots[slot].mask |= 1 << count;
+
+		if ((buttons[count].button >= 0) && (buttons[count].button < CONTROL_INDICES))
+			buttonMasks[buttons[count].button] |= 1 << count;
+
+		if ((axes[count].axis >= 0) && (axes[count].axis < CONTROL_INDICES))
+			axisMasks[axes[count].axis] |= 1 << count;
+
+		if ((hats[count].hat >= 0) && (hats[count].hat < CONTROL_INDICES))
+			hatMasks[hats[count].hat] |= 1 << count;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Find the controls using the given key.
+ *
+ * @param key The key
+ *
+ * @return The controls, a bit each
+ */
+unsigned int Controls::findKey (int key) {
+
+	int slot;
+
+	slot = getKeySlot(key);
+
+	while (keySlots[slot].mask) {
+
+		if (keySlots[slot].key == key) return keySlots[slot].mask;
+
+		slot = (slot + 1) & ((1 << CONTROL_KEY_BITS) - 1);
+
+	}
+
+	return 0;
+
+}
+
+
+/**
+ * Find the controls using the given joystick button.
+ *
+ * @param button The button
+ *
+ * @return The controls, a bit each
+ */
+unsigned int Controls::findButton (int button) {
+
+	unsigned int mask;
+	int count;
+
+	if ((button >= 0) && (button < CONTROL_INDICES)) return buttonMasks[button];
+
+	// Buttons beyond the table are rare enough to search for
+	mask = 0;
+
+	for (count = 0; count < CONTROLS; count++)
+		if (buttons[count].button == button) mask |= 1 << count;
+
+	return mask;
+
+}
+
+
+/**
+ * Find the controls using the given joystick axis.
+ *
+ * @param axis The axis
+ *
+ * @return The controls, a bit each
+ */
+unsigned int Controls::findAxis (int axis) {
+
+	unsigned int mask;
+	int count;
+
+	if ((axis >= 0) && (axis < CONTROL_INDICES)) return axisMasks[axis];
+
+	mask = 0;
+
+	for (count = 0; count < CONTROLS; count++)
+		if (axes[count].axis == axis) mask |= 1 << count;
+
+	return mask;
+
+}
+
+
+/**
+ * Find the controls using the given joystick hat.
+ *
+ * @param hat The hat
+ *
+ * @return The controls, a bit each
+ */
+unsigned int Controls::findHat (int hat) {
+
+	unsigned int mask;
+	int count;
+
+	if ((hat >= 0) && (hat < CONTROL_INDICES)) return hatMasks[hat];
+
+	mask = 0;
+
+	for (count = 0; count < CONTROLS; count++)
+		if (hats[count].hat == hat) mask |= 1 << count;
+
+	return mask;
+
+}
+
+
 /**
  * Set the key to use for the specified control.
  *
@@ -315,6 +487,8 @@ void Controls::setKey (int control, int key) {
 	keys[control].key = key;
 	keys[control].pressed = false;
 
+	buildLookups();
+
 	return;
 
 }
@@ -331,6 +505,8 @@ void Controls::setButton (int control, int button) {
 	buttons[control].button = button;
 	buttons[control].pressed = false;
 
+	buildLookups();
+
 	return;
 
 }
@@ -349,6 +525,8 @@ void Controls::setAxis (int control, int axis, bool direction) {
 	axes[control].direction = direction;
 	axes[control].pressed = false;
 
+	buildLookups();
+
 	return;
 
 }
@@ -367,6 +545,8 @@ void Controls::setHat (int control, int hat, int direction) {
 	hats[control].direction = direction;
 	hats[control].pressed = false;
 
+	buildLookups();
+
 	return;
 
 }
@@ -456,6 +636,61 @@ int Controls::getHatDirection (int control) {
 }
 
 
+/**
+ * Only use events from the given joystick.
+ *
+ * @param index The joystick, or -1 for any
+ */
+void Controls::setJoystick (int index) {
+
+	int count;
+
+	joystick = index;
+
+	for (count = 0; count < CONTROLS; count++) {
+
+		buttons[count].pressed = false;
+		axes[count].pressed = false;
+		hats[count].pressed = false;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Set up the second local player's controls. Only the movement and weapon
+ * controls have keys, so the menus and the pause key stay with the first
+ * player, and only the second joystick is used.
+ */
+void Controls::useSecondSet () {
+
+	int count;
+
+	for (count = 0; count < CONTROLS; count++) keys[count].key = -1;
+
+	keys[C_UP].key = SECOND_KEY_UP;
+	keys[C_DOWN].key = SECOND_KEY_DOWN;
+	keys[C_LEFT].key = SECOND_KEY_LEFT;
+	keys[C_RIGHT].key = SECOND_KEY_RIGHT;
+	keys[C_JUMP].key = SECOND_KEY_JUMP;
+	keys[C_SWIM].key = SECOND_KEY_SWIM;
+	keys[C_FIRE].key = SECOND_KEY_FIRE;
+	keys[C_CHANGE].key = SECOND_KEY_CHANGE;
+
+	for (count = 0; count < CONTROLS; count++) keys[count].pressed = false;
+
+	buildLookups();
+
+	setJoystick(1);
+
+	return;
+
+}
+
+
 /**
  * Set the position and state of the cursor.
  *
@@ -485,6 +720,7 @@ void Controls::setCursor(int x, int y, bool pressed) {
  */
 int Controls::update (SDL_Event *event, LoopType type) {
 
+	unsigned int mask;
 	int count;
 
 	count = CONTROLS;
@@ -495,9 +731,8 @@ int Controls::update (SDL_Event *event, LoopType type) {
 
 			if (type == SET_KEY_LOOP) return event->key.keysym.sym;
 
-			for (count = 0; count < CONTROLS; count++)
-				if (event->key.keysym.sym == keys[count].key)
-					keys[count].pressed = true;
+			for (mask = findKey(event->key.keysym.sym); mask; mask &= mask - 1)
+				keys[__builtin_ctz(mask)].pressed = true;
 
 			if (type == TYPING_LOOP) return event->key.keysym.sym;
 
@@ -505,9 +740,8 @@ int Controls::update (SDL_Event *event, LoopType type) {
 
 		case SDL_KEYUP:
 
-			for (count = 0; count < CONTROLS; count++)
-				if (event->key.keysym.sym == keys[count].key)
-					keys[count].pressed = false;
+			for (mask = findKey(event->key.keysym.sym); mask; mask &= mask - 1)
+				keys[__builtin_ctz(mask)].pressed = false;
 
 			break;
 
@@ -515,17 +749,19 @@ int Controls::update (SDL_Event *event, LoopType type) {
 
 			if (type == SET_JOYSTICK_LOOP) return JOYSTICKB | event->jbutton.button;
 
-			for (count = 0; count < CONTROLS; count++)
-				if (event->jbutton.button == buttons[count].button)
-					buttons[count].pressed = true;
+			if ((joystick >= 0) && (event->jbutton.which != joystick)) break;
+
+			for (mask = findButton(event->jbutton.button); mask; mask &= mask - 1)
+				buttons[__builtin_ctz(mask)].pressed = true;
 
 			break;
 
 		case SDL_JOYBUTTONUP:
 
-			for (count = 0; count < CONTROLS; count++)
-				if (event->jbutton.button == buttons[count].button)
-					buttons[count].pressed = false;
+			if ((joystick >= 0) && (event->jbutton.which != joystick)) break;
+
+			for (mask = findButton(event->jbutton.button); mask; mask &= mask - 1)
+				buttons[__builtin_ctz(mask)].pressed = false;
 
 			break;
 
@@ -540,17 +776,20 @@ int Controls::update (SDL_Event *event, LoopType type) {
 
 			}
 
-			for (count = 0; count < CONTROLS; count++)
-				if (event->jaxis.axis == axes[count].axis) {
+			if ((joystick >= 0) && (event->jaxis.which != joystick)) break;
 
-					if (!axes[count].direction && (event->jaxis.value < -16384))
-						axes[count].pressed = true;
-					else if (axes[count].direction && (event->jaxis.value > 16384))
-						axes[count].pressed = true;
-					else
-						axes[count].pressed = false;
+			for (mask = findAxis(event->jaxis.axis); mask; mask &= mask - 1) {
 
-				}
+				count = __builtin_ctz(mask);
+
+				if (!axes[count].direction && (event->jaxis.value < -16384))
+					axes[count].pressed = true;
+				else if (axes[count].direction && (event->jaxis.value > 16384))
+					axes[count].pressed = true;
+				else
+					axes[count].pressed = false;
+
+			}
 
 			break;
 
@@ -570,15 +809,18 @@ int Controls::update (SDL_Event *event, LoopType type) {
 				}
 			}
 
-			for(count = 0; count < CONTROLS; count++)
-				if (event->jhat.hat == hats[count].hat) {
+			if ((joystick >= 0) && (event->jhat.which != joystick)) break;
 
-					if (hats[count].direction & event->jhat.value)
-						hats[count].pressed = true;
-					else
-						hats[count].pressed = false;
+			for (mask = findHat(event->jhat.hat); mask; mask &= mask - 1) {
 
-				}
+				count = __builtin_ctz(mask);
+
+				if (hats[count].direction & event->jhat.value)
+					hats[count].pressed = true;
+				else
+					hats[count].pressed = false;
+
+			}
 
 			break;
 
@@ -61,6 +61,10 @@
 // Time interval
 #define T_KEY   200
 
+// Reverse lookups
+#define CONTROL_KEY_BITS 6 /* The table of keys has (1 << CONTROL_KEY_BITS) slots, comfortably more than CONTROLS */
+#define CONTROL_INDICES  32 /* Joystick buttons, axes and hats below this are looked up directly */
+
 
 // Class
 
@@ -111,8 +115,25 @@ class Controls {
 		bool         cursorReleased; ///< Whether or not the cursor has been released
 		int          wheelUp; ///< How many times the wheel has been scrolled upwards
 		int          wheelDown; ///< How many times the wheel has been scrolled downwards
+		int          joystick; ///< The joystick whose events are used, or -1 for any
+
+		struct {
+
+			int          key; ///< Keyboard key
+			unsigned int mask; ///< Controls using the key, a bit each, or 0 if the slot is empty
+
+		} keySlots[1 << CONTROL_KEY_BITS]; ///< Controls using each key, found by hashing the key
+
+		unsigned int buttonMasks[CONTROL_INDICES]; ///< Controls using each joystick button
+		unsigned int axisMasks[CONTROL_INDICES]; ///< Controls using each joystick axis
+		unsigned int hatMasks[CONTROL_INDICES]; ///< Controls using each joystick hat
 
-		void setCursor (int x, int y, bool pressed);
+		void         setCursor    (int x, int y, bool pressed);
+		void         buildLookups ();
+		unsigned int findKey      (int key);
+		unsigned int findButton   (int button);
+		unsigned int findAxis     (int axis);
+		unsigned int findHat      (int hat);
 
 	public:
 		Controls ();
@@ -127,6 +148,8 @@ class Controls {
 		int  getAxisDirection (int control);
 		int  getHat           (int control);
 		int  getHatDirection  (int control);
+		void setJoystick      (int index);
+		void useSecondSet     ();
 
 		int  update           (SDL_Event *event, LoopType type);
 		void loop             ();
@@ -139,8 +162,9 @@ class Controls {
 };
 
 
-// Variable
+// Variables
 
 EXTERN Controls controls;
+EXTERN Controls secondControls; ///< The second local player's controls, when two share the screen
 
 #endif
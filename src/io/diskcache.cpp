@@ -0,0 +1,158 @@
+
+/**
+ *
+ * @file diskcache.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created diskcache.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Keeps data decoded from files on disk, next to the files themselves, so that
+ * later runs can read the data back instead of decoding the files again.
+ *
+ * A cache file starts with a 16-byte header: "OJC", the cache version, then the
+ * size, modification time and hash of the file it was decoded from. The
+ * decoder that wrote the file decides the layout of the rest.
+ *
+ */
+
+
+#include "diskcache.h"
+#include "file.h"
+
+#include "util.h"
+
+
+/**
+ * Open the cache file for a source file, if it exists and was written from
+ * the source file as it is now.
+ *
+ * @param source The source file
+ * @param sourceName The name of the source file
+ *
+ * @return The cache file, positioned after its header, or NULL if there is no
+ * usable cache file
+ */
+File* openDiskCache (File* source, const char* sourceName) {
+
+#ifdef NO_DISK_CACHE
+	return NULL;
+#else
+	File* cache;
+	char cacheName[PATH_LENGTH];
+
+	if (!writeString(cacheName, PATH_LENGTH, sourceName, DISKCACHE_EXTENSION) ||
+		!fileExists(cacheName)) return NULL;
+
+	try {
+
+		cache = new File(cacheName, false);
+
+	} catch (int e) {
+
+		cache = NULL;
+
+	}
+
+	if (!cache) return NULL;
+
+	if ((cache->loadChar() != 'O') ||
+		(cache->loadChar() != 'J') ||
+		(cache->loadChar() != 'C') ||
+		(cache->loadChar() != DISKCACHE_VERSION) ||
+		(cache->loadInt() != source->getSize()) ||
+		(cache->loadInt() != (int)getFileTime(sourceName)) ||
+		((unsigned int)(cache->loadInt()) != source->getHash())) {
+
+		// Out of date, so decode the source file again
+		delete cache;
+
+		return NULL;
+
+	}
+
+	return cache;
+#endif
+
+}
+
+
+/**
+ * Create the cache file for a source file, replacing any existing one.
+ *
+ * @param source The source file
+ * @param sourceName The name of the source file
+ *
+ * @return The cache file, with its header written, or NULL if it could not be
+ * created
+ */
+File* createDiskCache (File* source, const char* sourceName) {
+
+#ifdef NO_DISK_CACHE
+	return NULL;
+#else
+	File* cache;
+	char cacheName[PATH_LENGTH];
+
+	if (!writeString(cacheName, PATH_LENGTH, sourceName, DISKCACHE_EXTENSION)) return NULL;
+
+	try {
+
+		cache = new File(cacheName, true);
+
+	} catch (int e) {
+
+		cache = NULL;
+
+	}
+
+	if (!cache) return NULL;
+
+	cache->storeChar('O');
+	cache->storeChar('J');
+	cache->storeChar('C');
+	cache->storeChar(DISKCACHE_VERSION);
+	cache->storeInt(source->getSize());
+	cache->storeInt((int)getFileTime(sourceName));
+	cache->storeInt((int)source->getHash());
+
+	return cache;
+#endif
+
+}
+
+
+/**
+ * Move to the start of the next block in a cache file.
+ *
+ * @param cache The cache file
+ * @param write Whether or not the cache file is being written
+ */
+void alignDiskCache (File* cache, bool write) {
+
+	int padding;
+
+	padding = (DISKCACHE_ALIGN - (cache->tell() & (DISKCACHE_ALIGN - 1))) & (DISKCACHE_ALIGN - 1);
+
+	if (write) {
+
+		while (padding--) cache->storeChar(0);
+
+	} else {
+
+		cache->seek(padding, false);
+
+	}
+
+	return;
+
+}
+
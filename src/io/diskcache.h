@@ -0,0 +1,46 @@
+
+/**
+ *
+ * @file diskcache.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created diskcache.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _DISKCACHE_H
+#define _DISKCACHE_H
+
+
+#include "OpenJazz.h"
+
+
+// Constants
+
+#define DISKCACHE_EXTENSION ".ojc" /* Appended to the source file's name */
+#define DISKCACHE_VERSION   1 /* Changes whenever the layout of any cache file changes */
+#define DISKCACHE_ALIGN     16 /* Blocks in cache files start at multiples of this */
+
+
+// Classes
+
+class File;
+
+
+// Functions
+
+EXTERN File* openDiskCache   (File* source, const char* sourceName);
+EXTERN File* createDiskCache (File* source, const char* sourceName);
+EXTERN void  alignDiskCache  (File* cache, bool write);
+
+#endif
+
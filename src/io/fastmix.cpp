@@ -7,8 +7,13 @@
 
 #include "stdafx.h"
 #include "sndfile.h"
+#include "psmplug.h"
 #include <math.h>
 
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
 #ifdef MSC_VER
 #pragma bss_seg(".modplug")
 #endif
@@ -358,7 +363,31 @@ CzWINDOWEDFIR sfir;
 #define WFIR_FRACMASK	((((1L<<(17-WFIR_FRACSHIFT))-1)&~((1L<<WFIR_LOG2WIDTH)-1)))
 #define WFIR_FRACHALVE	(1L<<(16-(WFIR_FRACBITS+2)))
 
-#define SNDMIX_GETMONOVOL8FIRFILTER \
+#if defined(__ARM_NEON) && defined(__aarch64__)
+// All eight taps at once. Integer sums don't depend on the order the
+// products are added in, so these give the same results as the C versions.
+#define SNDMIX_GETMONOVOL8FIRFILTER_NEON \
+	int poshi  = nPos >> 16;\
+	int poslo  = (nPos & 0xFFFF);\
+	int firidx = ((poslo+WFIR_FRACHALVE)>>WFIR_FRACSHIFT) & WFIR_FRACMASK; \
+	int16x8_t fir = vld1q_s16(CzWINDOWEDFIR::lut+firidx);\
+	int16x8_t smp = vmovl_s8(vld1_s8(p+poshi+1-4));\
+	int vol    = vaddvq_s32(vaddq_s32(vmull_s16(vget_low_s16(fir), vget_low_s16(smp)),\
+	                                  vmull_s16(vget_high_s16(fir), vget_high_s16(smp))));\
+	    vol  >>= WFIR_8SHIFT;
+
+#define SNDMIX_GETMONOVOL16FIRFILTER_NEON \
+	int poshi  = nPos >> 16;\
+	int poslo  = (nPos & 0xFFFF);\
+	int firidx = ((poslo+WFIR_FRACHALVE)>>WFIR_FRACSHIFT) & WFIR_FRACMASK; \
+	int16x8_t fir = vld1q_s16(CzWINDOWEDFIR::lut+firidx);\
+	int16x8_t smp = vld1q_s16(p+poshi+1-4);\
+	int vol1   = vaddvq_s32(vmull_s16(vget_low_s16(fir), vget_low_s16(smp)));\
+	int vol2   = vaddvq_s32(vmull_s16(vget_high_s16(fir), vget_high_s16(smp)));\
+	int vol    = ((vol1>>1)+(vol2>>1)) >> (WFIR_16BITSHIFT-1);
+#endif
+
+#define SNDMIX_GETMONOVOL8FIRFILTER_C \
 	int poshi  = nPos >> 16;\
 	int poslo  = (nPos & 0xFFFF);\
 	int firidx = ((poslo+WFIR_FRACHALVE)>>WFIR_FRACSHIFT) & WFIR_FRACMASK; \
@@ -372,7 +401,7 @@ CzWINDOWEDFIR sfir;
             vol   += (CzWINDOWEDFIR::lut[firidx+7]*(int)p[poshi+8-4]);	\
             vol  >>= WFIR_8SHIFT;
 
-#define SNDMIX_GETMONOVOL16FIRFILTER \
+#define SNDMIX_GETMONOVOL16FIRFILTER_C \
     int poshi  = nPos >> 16;\
     int poslo  = (nPos & 0xFFFF);\
     int firidx = ((poslo+WFIR_FRACHALVE)>>WFIR_FRACSHIFT) & WFIR_FRACMASK; \
@@ -386,6 +415,15 @@ CzWINDOWEDFIR sfir;
 	vol2  += (CzWINDOWEDFIR::lut[firidx+7]*(int)p[poshi+8-4]);	\
     int vol    = ((vol1>>1)+(vol2>>1)) >> (WFIR_16BITSHIFT-1);
 
+// NEON builds keep the C versions too, for ModPlug_RunKernel() to check against
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define SNDMIX_GETMONOVOL8FIRFILTER	SNDMIX_GETMONOVOL8FIRFILTER_NEON
+#define SNDMIX_GETMONOVOL16FIRFILTER	SNDMIX_GETMONOVOL16FIRFILTER_NEON
+#else
+#define SNDMIX_GETMONOVOL8FIRFILTER	SNDMIX_GETMONOVOL8FIRFILTER_C
+#define SNDMIX_GETMONOVOL16FIRFILTER	SNDMIX_GETMONOVOL16FIRFILTER_C
+#endif
+
 /////////////////////////////////////////////////////////////////////////////
 // Stereo
 
@@ -441,7 +479,38 @@ CzWINDOWEDFIR sfir;
 	           CzCUBICSPLINE::lut[poslo+3]*(int)p[(poshi+2)*2+1]) >> SPLINE_16SHIFT;
 
 // fir interpolation
-#define SNDMIX_GETSTEREOVOL8FIRFILTER \
+#if defined(__ARM_NEON) && defined(__aarch64__)
+// Both channels' eight taps at once, splitting the interleaved samples
+#define SNDMIX_GETSTEREOVOL8FIRFILTER_NEON \
+    int poshi   = nPos >> 16;\
+    int poslo   = (nPos & 0xFFFF);\
+    int firidx  = ((poslo+WFIR_FRACHALVE)>>WFIR_FRACSHIFT) & WFIR_FRACMASK; \
+    int16x8_t fir = vld1q_s16(CzWINDOWEDFIR::lut+firidx);\
+    int8x8x2_t smp = vld2_s8(p+(poshi+1-4)*2);\
+    int16x8_t smp_l = vmovl_s8(smp.val[0]);\
+    int16x8_t smp_r = vmovl_s8(smp.val[1]);\
+    int vol_l   = vaddvq_s32(vaddq_s32(vmull_s16(vget_low_s16(fir), vget_low_s16(smp_l)),\
+                                       vmull_s16(vget_high_s16(fir), vget_high_s16(smp_l))));\
+        vol_l >>= WFIR_8SHIFT; \
+    int vol_r   = vaddvq_s32(vaddq_s32(vmull_s16(vget_low_s16(fir), vget_low_s16(smp_r)),\
+                                       vmull_s16(vget_high_s16(fir), vget_high_s16(smp_r))));\
+        vol_r >>= WFIR_8SHIFT;
+
+#define SNDMIX_GETSTEREOVOL16FIRFILTER_NEON \
+    int poshi   = nPos >> 16;\
+    int poslo   = (nPos & 0xFFFF);\
+    int firidx  = ((poslo+WFIR_FRACHALVE)>>WFIR_FRACSHIFT) & WFIR_FRACMASK; \
+    int16x8_t fir = vld1q_s16(CzWINDOWEDFIR::lut+firidx);\
+    int16x8x2_t smp = vld2q_s16(p+(poshi+1-4)*2);\
+    int vol1_l  = vaddvq_s32(vmull_s16(vget_low_s16(fir), vget_low_s16(smp.val[0])));\
+    int vol2_l  = vaddvq_s32(vmull_s16(vget_high_s16(fir), vget_high_s16(smp.val[0])));\
+    int vol_l   = ((vol1_l>>1)+(vol2_l>>1)) >> (WFIR_16BITSHIFT-1); \
+    int vol1_r  = vaddvq_s32(vmull_s16(vget_low_s16(fir), vget_low_s16(smp.val[1])));\
+    int vol2_r  = vaddvq_s32(vmull_s16(vget_high_s16(fir), vget_high_s16(smp.val[1])));\
+    int vol_r   = ((vol1_r>>1)+(vol2_r>>1)) >> (WFIR_16BITSHIFT-1);
+#endif
+
+#define SNDMIX_GETSTEREOVOL8FIRFILTER_C \
     int poshi   = nPos >> 16;\
     int poslo   = (nPos & 0xFFFF);\
     int firidx  = ((poslo+WFIR_FRACHALVE)>>WFIR_FRACSHIFT) & WFIR_FRACMASK; \
@@ -464,7 +533,7 @@ CzWINDOWEDFIR sfir;
         vol_r  += (CzWINDOWEDFIR::lut[firidx+7]*(int)p[(poshi+8-4)*2+1]);   \
         vol_r >>= WFIR_8SHIFT;
 
-#define SNDMIX_GETSTEREOVOL16FIRFILTER \
+#define SNDMIX_GETSTEREOVOL16FIRFILTER_C \
     int poshi   = nPos >> 16;\
     int poslo   = (nPos & 0xFFFF);\
     int firidx  = ((poslo+WFIR_FRACHALVE)>>WFIR_FRACSHIFT) & WFIR_FRACMASK; \
@@ -487,6 +556,14 @@ CzWINDOWEDFIR sfir;
        vol2_r += (CzWINDOWEDFIR::lut[firidx+7]*(int)p[(poshi+8-4)*2+1]);    \
    int vol_r   = ((vol1_r>>1)+(vol2_r>>1)) >> (WFIR_16BITSHIFT-1);
 
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define SNDMIX_GETSTEREOVOL8FIRFILTER	SNDMIX_GETSTEREOVOL8FIRFILTER_NEON
+#define SNDMIX_GETSTEREOVOL16FIRFILTER	SNDMIX_GETSTEREOVOL16FIRFILTER_NEON
+#else
+#define SNDMIX_GETSTEREOVOL8FIRFILTER	SNDMIX_GETSTEREOVOL8FIRFILTER_C
+#define SNDMIX_GETSTEREOVOL16FIRFILTER	SNDMIX_GETSTEREOVOL16FIRFILTER_C
+#endif
+
 /////////////////////////////////////////////////////////////////////////////
 
 #define SNDMIX_STOREMONOVOL\
@@ -1630,7 +1707,39 @@ DWORD MPPASMCALL X86_Convert32To16(LPVOID lp16, int *pBuffer, DWORD lSampleCount
 {
 	int vumin = *lpMin, vumax = *lpMax;
 	signed short *p = (signed short *)lp16;
-	for (UINT i=0; i<lSampleCount; i++)
+	UINT i = 0;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	// Until the meter has a real minimum and maximum, a sample can only move
+	// one of them, so leave those samples to the C loop
+	while ((vumin > vumax) && (i < lSampleCount))
+	{
+		int n = pBuffer[i];
+		if (n < MIXING_CLIPMIN)
+			n = MIXING_CLIPMIN;
+		else if (n > MIXING_CLIPMAX)
+			n = MIXING_CLIPMAX;
+		if (n < vumin)
+			vumin = n;
+		else if (n > vumax)
+			vumax = n;
+		p[i++] = n >> (16-MIXING_ATTENUATION);
+	}
+	if (i + 4 <= lSampleCount)
+	{
+		int32x4_t clipmin = vdupq_n_s32(MIXING_CLIPMIN), clipmax = vdupq_n_s32(MIXING_CLIPMAX);
+		int32x4_t mins = vdupq_n_s32(vumin), maxs = vdupq_n_s32(vumax);
+		for (; i+4<=lSampleCount; i+=4)
+		{
+			int32x4_t n = vminq_s32(vmaxq_s32(vld1q_s32(pBuffer+i), clipmin), clipmax);
+			mins = vminq_s32(mins, n);
+			maxs = vmaxq_s32(maxs, n);
+			vst1_s16(p+i, vmovn_s32(vshrq_n_s32(n, 16-MIXING_ATTENUATION)));
+		}
+		vumin = vminvq_s32(mins);
+		vumax = vmaxvq_s32(maxs);
+	}
+#endif
+	for (; i<lSampleCount; i++)
 	{
 		int n = pBuffer[i];
 		if (n < MIXING_CLIPMIN)
@@ -1743,6 +1852,20 @@ void MPPASMCALL X86_StereoFill(int *pBuffer, UINT nSamples, LPLONG lpROfs, LPLON
 		X86_InitMixBuffer(pBuffer, nSamples*2);
 		return;
 	}
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	// Each sample depends on the last, but both channels can decay together
+	int32_t ofsPair[2] = {rofs, lofs};
+	int32x2_t ofs = vld1_s32(ofsPair);
+	int32x2_t mask = vdup_n_s32(OFSDECAYMASK);
+	for (UINT i=0; i<nSamples; i++)
+	{
+		int32x2_t x = vshr_n_s32(vadd_s32(ofs, vand_s32(vshr_n_s32(vneg_s32(ofs), 31), mask)), OFSDECAYSHIFT);
+		ofs = vsub_s32(ofs, x);
+		vst1_s32(pBuffer+i*2, x);
+	}
+	rofs = vget_lane_s32(ofs, 0);
+	lofs = vget_lane_s32(ofs, 1);
+#else
 	for (UINT i=0; i<nSamples; i++)
 	{
 		int x_r = (rofs + (((-rofs)>>31) & OFSDECAYMASK)) >> OFSDECAYSHIFT;
@@ -1752,6 +1875,7 @@ void MPPASMCALL X86_StereoFill(int *pBuffer, UINT nSamples, LPLONG lpROfs, LPLON
 		pBuffer[i*2] = x_r;
 		pBuffer[i*2+1] = x_l;
 	}
+#endif
 	*lpROfs = rofs;
 	*lpLOfs = lofs;
 }
@@ -1775,3 +1899,139 @@ static void MPPASMCALL X86_EndChannelOfs(MODCHANNEL *pChannel, int *pBuffer, UIN
 	pChannel->nROfs = rofs;
 	pChannel->nLOfs = lofs;
 }
+
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+/////////////////////////////////////////////////////
+// Plain C versions of the NEON kernels, to check them against
+
+static BEGIN_MIX_INTERFACE(C_Mono8BitFirFilterMix)
+	SNDMIX_BEGINSAMPLELOOP8
+	SNDMIX_GETMONOVOL8FIRFILTER_C
+	SNDMIX_STOREMONOVOL
+END_MIX_INTERFACE()
+
+static BEGIN_MIX_INTERFACE(C_Mono16BitFirFilterMix)
+	SNDMIX_BEGINSAMPLELOOP16
+	SNDMIX_GETMONOVOL16FIRFILTER_C
+	SNDMIX_STOREMONOVOL
+END_MIX_INTERFACE()
+
+static BEGIN_MIX_INTERFACE(C_Stereo8BitFirFilterMix)
+	SNDMIX_BEGINSAMPLELOOP8
+	SNDMIX_GETSTEREOVOL8FIRFILTER_C
+	SNDMIX_STORESTEREOVOL
+END_MIX_INTERFACE()
+
+static BEGIN_MIX_INTERFACE(C_Stereo16BitFirFilterMix)
+	SNDMIX_BEGINSAMPLELOOP16
+	SNDMIX_GETSTEREOVOL16FIRFILTER_C
+	SNDMIX_STORESTEREOVOL
+END_MIX_INTERFACE()
+
+static DWORD MPPASMCALL C_Convert32To16(LPVOID lp16, int *pBuffer, DWORD lSampleCount, LPLONG lpMin, LPLONG lpMax)
+{
+	int vumin = *lpMin, vumax = *lpMax;
+	signed short *p = (signed short *)lp16;
+	for (UINT i=0; i<lSampleCount; i++)
+	{
+		int n = pBuffer[i];
+		if (n < MIXING_CLIPMIN)
+			n = MIXING_CLIPMIN;
+		else if (n > MIXING_CLIPMAX)
+			n = MIXING_CLIPMAX;
+		if (n < vumin)
+			vumin = n;
+		else if (n > vumax)
+			vumax = n;
+		p[i] = n >> (16-MIXING_ATTENUATION);	// 16-bit signed
+	}
+	*lpMin = vumin;
+	*lpMax = vumax;
+	return lSampleCount * 2;
+}
+
+static void MPPASMCALL C_StereoFill(int *pBuffer, UINT nSamples, LPLONG lpROfs, LPLONG lpLOfs)
+{
+	int rofs = *lpROfs;
+	int lofs = *lpLOfs;
+
+	if ((!rofs) && (!lofs))
+	{
+		X86_InitMixBuffer(pBuffer, nSamples*2);
+		return;
+	}
+	for (UINT i=0; i<nSamples; i++)
+	{
+		int x_r = (rofs + (((-rofs)>>31) & OFSDECAYMASK)) >> OFSDECAYSHIFT;
+		int x_l = (lofs + (((-lofs)>>31) & OFSDECAYMASK)) >> OFSDECAYSHIFT;
+		rofs -= x_r;
+		lofs -= x_l;
+		pBuffer[i*2] = x_r;
+		pBuffer[i*2+1] = x_l;
+	}
+	*lpROfs = rofs;
+	*lpLOfs = lofs;
+}
+
+// The FIR mixes, C versions first, in the order of the MODPLUG_KERNEL_FIR_* kernels
+static const LPMIXINTERFACE gpCheckMixFunctionTable[2][4] =
+{
+	{C_Mono8BitFirFilterMix, C_Mono16BitFirFilterMix, C_Stereo8BitFirFilterMix, C_Stereo16BitFirFilterMix},
+	{Mono8BitFirFilterMix, Mono16BitFirFilterMix, Stereo8BitFirFilterMix, Stereo16BitFirFilterMix}
+};
+#endif
+
+int ModPlug_RunKernel(int kernel, int neon, const void *input, int samples, void *output)
+//---------------------------------------------------------------------------------------
+{
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	if (kernel == MODPLUG_KERNEL_CONVERT16)
+	{
+		LONG vu[2] = {0x7FFFFFFF, -0x7FFFFFFF};
+		DWORD (MPPASMCALL *pCvt)(LPVOID, int *, DWORD, LPLONG, LPLONG) = neon ? X86_Convert32To16 : C_Convert32To16;
+		UINT nHalf = samples >> 1;
+		// In two parts, as the mixer converts them, the first starting
+		// without a real minimum and maximum
+		pCvt(output, (int *)input, nHalf, &vu[0], &vu[1]);
+		pCvt((signed short *)output + nHalf, (int *)input + nHalf, samples - nHalf, &vu[0], &vu[1]);
+		memcpy((signed short *)output + samples, vu, sizeof(vu));
+		return samples * 2 + sizeof(vu);
+	}
+	if (kernel == MODPLUG_KERNEL_STEREOFILL)
+	{
+		LONG ofs[2];
+		memcpy(ofs, input, sizeof(ofs));
+		if (neon) X86_StereoFill((int *)output, samples, &ofs[0], &ofs[1]);
+		else C_StereoFill((int *)output, samples, &ofs[0], &ofs[1]);
+		memcpy((int *)output + samples * 2, ofs, sizeof(ofs));
+		return samples * 8 + sizeof(ofs);
+	}
+	if ((kernel >= MODPLUG_KERNEL_FIR_MONO8) && (kernel <= MODPLUG_KERNEL_FIR_STEREO16))
+	{
+		MODCHANNEL chn;
+		int index = kernel - MODPLUG_KERNEL_FIR_MONO8;
+		memset(&chn, 0, sizeof(chn));
+		chn.pCurrentSample = (signed char *)input;
+		chn.dwFlags = ((index & 1) ? CHN_16BIT : 0) | ((index & 2) ? CHN_STEREO : 0);
+		// Leave room for the taps before the first sample, and step by an
+		// uneven amount, so every part of the filter table is used
+		chn.nPos = 4;
+		chn.nInc = 0x17A3D;
+		chn.nRightVol = 0x100;
+		chn.nLeftVol = 0xC0;
+		memset(output, 0, samples * 2 * sizeof(int));
+		gpCheckMixFunctionTable[neon ? 1 : 0][index](&chn, (int *)output, (int *)output + samples * 2);
+		memcpy((int *)output + samples * 2, &chn.nPos, sizeof(DWORD));
+		memcpy((int *)output + samples * 2 + 1, &chn.nPosLo, sizeof(DWORD));
+		return samples * 8 + 2 * sizeof(DWORD);
+	}
+#else
+	(void)kernel;
+	(void)neon;
+	(void)input;
+	(void)samples;
+	(void)output;
+#endif
+	return 0;
+}
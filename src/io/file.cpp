@@ -24,18 +24,258 @@
 
 
 #include "file.h"
+#include "inflate.h"
+#include "loadprofile.h"
 
 #include "io/gfx/video.h"
 #include "util.h"
 
 #include <string.h>
-#include "../miniz.h"
+#include <sys/stat.h>
 
 #if !(defined(_WIN32) || defined(WII) || defined(PSP))
     #define UPPERCASE_FILENAMES
     #define LOWERCASE_FILENAMES
 #endif
 
+#ifndef _MSC_VER
+	#include <dirent.h>
+	#define PATH_INDEX
+#endif
+
+#define PATH_INDEX_BUCKETS 1024 /* Must be a power of 2 */
+
+
+// Datatype
+
+/// File found in one of the paths
+typedef struct PathEntry {
+
+	struct PathEntry* next; ///< Next entry in the same bucket
+	Path*             path; ///< The path containing the file
+	char*             name; ///< The file's name, in lower case
+	char*             filePath; ///< The file's path, with the name in its actual case
+
+} PathEntry;
+
+
+// Variables
+
+static PathEntry* pathIndex[PATH_INDEX_BUCKETS]; ///< Files in the indexed paths, by the hash of their names
+static SDL_mutex* pathIndexLock = NULL; ///< Guards the path index against files being opened on other threads
+
+
+/**
+ * Get the hash of a file name, ignoring case.
+ *
+ * @param name The file name
+ *
+ * @return The hash
+ */
+static unsigned int hashFileName (const char* name) {
+
+	unsigned int hash;
+	int count;
+
+	hash = 2166136261u;
+
+	for (count = 0; name[count]; count++) {
+
+		if ((name[count] >= 65) && (name[count] <= 90)) hash ^= name[count] + 32;
+		else hash ^= (unsigned char)(name[count]);
+
+		hash *= 16777619u;
+
+	}
+
+	return hash;
+
+}
+
+
+/**
+ * Add a file to the path index. Must be called with the index locked.
+ *
+ * @param path The path containing the file
+ * @param name The file's name, in its actual case
+ */
+static void indexFile (Path* path, const char* name) {
+
+	PathEntry* entry;
+	unsigned int bucket;
+	int count;
+
+	bucket = hashFileName(name) & (PATH_INDEX_BUCKETS - 1);
+
+	entry = new PathEntry;
+	entry->next = pathIndex[bucket];
+	entry->path = path;
+	entry->name = createString(name);
+	entry->filePath = createString(path->path, name);
+
+	for (count = 0; entry->name[count]; count++) {
+
+		if ((entry->name[count] >= 65) && (entry->name[count] <= 90)) entry->name[count] += 32;
+
+	}
+
+	pathIndex[bucket] = entry;
+
+	return;
+
+}
+
+
+/**
+ * Find a file in one of the indexed paths, ignoring case. Must be called with
+ * the index locked.
+ *
+ * @param path The path to look in
+ * @param name The file's name
+ *
+ * @return The file's entry, or NULL if the path does not contain the file
+ */
+static PathEntry* findIndexedFile (Path* path, const char* name) {
+
+	PathEntry* entry;
+	int count;
+
+	entry = pathIndex[hashFileName(name) & (PATH_INDEX_BUCKETS - 1)];
+
+	while (entry) {
+
+		if (entry->path == path) {
+
+			for (count = 0; entry->name[count]; count++) {
+
+				if ((name[count] == entry->name[count]) ||
+					((name[count] >= 65) && (name[count] <= 90) && (name[count] + 32 == entry->name[count]))) continue;
+
+				break;
+
+			}
+
+			if (!entry->name[count] && !name[count]) return entry;
+
+		}
+
+		entry = entry->next;
+
+	}
+
+	return NULL;
+
+}
+
+
+/**
+ * Get the path of a file in one of the indexed paths.
+ *
+ * @param path The path to look in
+ * @param name The file's name
+ * @param buffer Buffer of PATH_LENGTH characters to write the path into
+ *
+ * @return The buffer, or NULL if the path does not contain the file
+ */
+static char* findIndexedPath (Path* path, const char* name, char* buffer) {
+
+	PathEntry* entry;
+	char* filePath;
+
+	SDL_LockMutex(pathIndexLock);
+
+	entry = findIndexedFile(path, name);
+
+	if (entry) filePath = writeString(buffer, PATH_LENGTH, entry->filePath, "");
+	else filePath = NULL;
+
+	SDL_UnlockMutex(pathIndexLock);
+
+	return filePath;
+
+}
+
+
+/**
+ * Delete the path index. Paths are looked in directly until they are indexed
+ * again.
+ */
+void clearPathIndex () {
+
+	PathEntry* entry;
+	Path* path;
+	int bucket;
+
+	if (pathIndexLock) SDL_LockMutex(pathIndexLock);
+
+	for (path = firstPath; path; path = path->next) path->indexed = false;
+
+	for (bucket = 0; bucket < PATH_INDEX_BUCKETS; bucket++) {
+
+		while (pathIndex[bucket]) {
+
+			entry = pathIndex[bucket];
+			pathIndex[bucket] = entry->next;
+
+			delete[] entry->name;
+			delete[] entry->filePath;
+			delete entry;
+
+		}
+
+	}
+
+	if (pathIndexLock) SDL_UnlockMutex(pathIndexLock);
+
+	return;
+
+}
+
+
+/**
+ * List the files in every path, so that files can be found without looking in
+ * each path in turn. Call again to pick up files added by other programs.
+ */
+void indexPaths () {
+
+#ifdef PATH_INDEX
+	Path* path;
+	DIR* dir;
+	struct dirent* dirEntry;
+
+	clearPathIndex();
+
+	if (!pathIndexLock) pathIndexLock = SDL_CreateMutex();
+	if (!pathIndexLock) return;
+
+	SDL_LockMutex(pathIndexLock);
+
+	for (path = firstPath; path; path = path->next) {
+
+		dir = opendir(path->path[0]? path->path: ".");
+
+		// Paths which cannot be listed are still looked in directly
+		if (!dir) continue;
+
+		while ((dirEntry = readdir(dir))) {
+
+			if (dirEntry->d_name[0] != '.') indexFile(path, dirEntry->d_name);
+
+		}
+
+		closedir(dir);
+
+		path->indexed = true;
+
+	}
+
+	SDL_UnlockMutex(pathIndexLock);
+#endif
+
+	return;
+
+}
+
 
 /**
  * Try opening a file from the available paths.
@@ -47,11 +287,16 @@ File::File (const char* name, bool write) {
 
 	Path* path;
 
+#ifdef PROFILE
+	loadIndex = -1;
+	syscalls = 0;
+#endif
+
 	path = firstPath;
 
 	while (path) {
 
-		if (open(path->path, name, write)) return;
+		if (open(path, name, write)) return;
 		path = path->next;
 
 	}
@@ -63,12 +308,37 @@ File::File (const char* name, bool write) {
 }
 
 
+/**
+ * Read from a copy of the given data, as if it were the contents of a file.
+ *
+ * @param data The data
+ * @param length The length of the data
+ */
+File::File (const unsigned char* data, int length) {
+
+	file = NULL;
+	filePath = createString("(memory)");
+	contents = new unsigned char[length? length: 1];
+	memcpy(contents, data, length);
+	size = length;
+	position = 0;
+
+#ifdef PROFILE
+	loadIndex = -1;
+#endif
+
+	return;
+
+}
+
+
 /**
  * Delete the file object.
  */
 File::~File () {
 
-	fclose(file);
+	if (file) fclose(file);
+	if (contents) delete[] contents;
 
 #ifdef VERBOSE
 	log("Closed file", filePath);
@@ -82,36 +352,37 @@ File::~File () {
 
 
 /**
- * Try opening a file from the given path
+ * Open a file, trying its name in upper and lower case if need be. The name is
+ * left in the case with which the file was opened.
  *
- * @param path Directory path
- * @param name File name
- * @param write Whether or not the file can be written to
+ * @param filePath The file's path
+ * @param start Offset of the file name within the path
+ * @param mode The mode in which to open the file
+ *
+ * @return The opened file, or NULL if it could not be opened
  */
-bool File::open (const char* path, const char* name, bool write) {
+static FILE* openFile (char* filePath, int start, const char* mode) {
 
+	FILE* file;
 #if defined(UPPERCASE_FILENAMES) || defined(LOWERCASE_FILENAMES)
 	int count;
 #endif
 
-	// Create the file path for the given directory
-	filePath = createString(path, name);
-
 	// Open the file from the path
-	file = fopen(filePath, write ? "wb": "rb");
+	file = fopen(filePath, mode);
 
 #ifdef UPPERCASE_FILENAMES
     if (!file) {
 
         // Convert the file name to upper case
-        for (count = strlen(path); filePath[count]; count++) {
+        for (count = start; filePath[count]; count++) {
 
             if ((filePath[count] >= 97) && (filePath[count] <= 122)) filePath[count] -= 32;
 
         }
 
         // Open the file from the path
-        file = fopen(filePath, write ? "wb": "rb");
+        file = fopen(filePath, mode);
 
     }
 #endif
@@ -120,33 +391,128 @@ bool File::open (const char* path, const char* name, bool write) {
     if (!file) {
 
         // Convert the file name to lower case
-        for (count = strlen(path); filePath[count]; count++) {
+        for (count = start; filePath[count]; count++) {
 
             if ((filePath[count] >= 65) && (filePath[count] <= 90)) filePath[count] += 32;
 
         }
 
         // Open the file from the path
-        file = fopen(filePath, write ? "wb": "rb");
+        file = fopen(filePath, mode);
 
     }
 #endif
 
+	return file;
+
+}
+
+
+/**
+ * Try opening a file from the given path
+ *
+ * @param path Directory path
+ * @param name File name
+ * @param write Whether or not the file can be written to
+ */
+bool File::open (Path* path, const char* name, bool write) {
+
+	char buffer[PATH_LENGTH];
+
+#ifdef PROFILE
+	Uint64 start;
+
+	start = SDL_GetPerformanceCounter();
+#endif
+
+	if (path->indexed && !write) {
+
+		// Only open files the path is known to contain
+		if (!findIndexedPath(path, name, buffer)) return false;
+
+		file = fopen(buffer, "rb");
+
+	} else {
+
+		// Build the file path for the given directory on the stack, as most
+		// paths tried will not contain the file
+		if (!writeString(buffer, PATH_LENGTH, path->path, name)) return false;
+
+		file = openFile(buffer, strlen(path->path), write ? "wb": "rb");
+
+		if (file && path->indexed) {
+
+			// Add new files to the index
+			SDL_LockMutex(pathIndexLock);
+
+			if (!findIndexedFile(path, buffer + strlen(path->path)))
+				indexFile(path, buffer + strlen(path->path));
+
+			SDL_UnlockMutex(pathIndexLock);
+
+		}
+
+	}
+
+#ifdef PROFILE
+	syscalls++;
+#endif
+
 	if (file) {
 
+		filePath = createString(buffer);
+
         LOG("Opened file", filePath);
 
+		contents = NULL;
+		size = 0;
+		position = 0;
+
+		if (!write) {
+
+			// Read the whole file at once, and decode it from memory
+			fseek(file, 0, SEEK_END);
+			size = ftell(file);
+			fseek(file, 0, SEEK_SET);
+
+			contents = new unsigned char[size? size: 1];
+			size = fread(contents, 1, size, file);
+
+			fclose(file);
+			file = NULL;
+
+#ifdef PROFILE
+			// Seeking to the end and back, finding the size, reading, closing
+			syscalls += 5;
+#endif
+
+		}
+
+#ifdef PROFILE
+		loadIndex = loadProfiler.openFile(filePath, write? 0: size, syscalls, start);
+#endif
+
 		return true;
 
 	}
 
-	delete[] filePath;
-
 	return false;
 
 }
 
 
+/**
+ * Get the path the file was opened from.
+ *
+ * @return The path
+ */
+const char* File::getPath () {
+
+	return filePath;
+
+}
+
+
 /**
  * Get the size of the file.
  *
@@ -154,17 +520,43 @@ bool File::open (const char* path, const char* name, bool write) {
  */
 int File::getSize () {
 
-	int pos, size;
+	int pos, end;
+
+	if (contents) return size;
 
 	pos = ftell(file);
 
 	fseek(file, 0, SEEK_END);
 
-	size = ftell(file);
+	end = ftell(file);
 
 	fseek(file, pos, SEEK_SET);
 
-	return size;
+	return end;
+
+}
+
+
+/**
+ * Get a hash of the contents of the file being read.
+ *
+ * @return The FNV-1a hash of the file's contents
+ */
+unsigned int File::getHash () {
+
+	unsigned int hash;
+	int count;
+
+	hash = 2166136261u;
+
+	for (count = 0; count < size; count++) {
+
+		hash ^= contents[count];
+		hash *= 16777619u;
+
+	}
+
+	return hash;
 
 }
 
@@ -176,6 +568,8 @@ int File::getSize () {
  */
 int File::tell () {
 
+	if (contents) return position;
+
 	return ftell(file);
 
 }
@@ -189,6 +583,15 @@ int File::tell () {
  */
 void File::seek (int offset, bool reset) {
 
+	if (contents) {
+
+		position = reset? offset: position + offset;
+		if (position < 0) position = 0;
+
+		return;
+
+	}
+
 	fseek(file, offset, reset ? SEEK_SET: SEEK_CUR);
 
 	return;
@@ -197,13 +600,16 @@ void File::seek (int offset, bool reset) {
 
 
 /**
- * Load an unsigned char from the file.
+ * Load an unsigned char from the file. Reading past the end of the file gives
+ * 255, as fgetc()'s EOF would.
  *
  * @return The value read
  */
 unsigned char File::loadChar () {
 
-	return fgetc(file);
+	if (position < size) return contents[position++];
+
+	return 255;
 
 }
 
@@ -226,8 +632,17 @@ unsigned short int File::loadShort () {
 
 	unsigned short int val;
 
-	val = fgetc(file);
-	val += fgetc(file) << 8;
+	if (position + 2 <= size) {
+
+		val = contents[position] + (contents[position + 1] << 8);
+		position += 2;
+
+		return val;
+
+	}
+
+	val = loadChar();
+	val += loadChar() << 8;
 
 	return val;
 
@@ -277,10 +692,20 @@ signed int File::loadInt () {
 
 	unsigned int val;
 
-	val = fgetc(file);
-	val += fgetc(file) << 8;
-	val += fgetc(file) << 16;
-	val += fgetc(file) << 24;
+	if (position + 4 <= size) {
+
+		val = contents[position] + (contents[position + 1] << 8) +
+			(contents[position + 2] << 16) + (contents[position + 3] << 24);
+		position += 4;
+
+		return *((signed int *)&val);
+
+	}
+
+	val = loadChar();
+	val += loadChar() << 8;
+	val += loadChar() << 16;
+	val += loadChar() << 24;
 
 	return *((signed int *)&val);
 
@@ -313,16 +738,39 @@ void File::storeInt (signed int val) {
 unsigned char * File::loadBlock (int length) {
 
 	unsigned char *buffer;
+	int available;
 
 	buffer = new unsigned char[length];
 
-	fread(buffer, 1, length, file);
+	available = size - position;
+	if (available > length) available = length;
+	if (available < 0) available = 0;
+
+	if (available) memcpy(buffer, contents + position, available);
+	memset(buffer + available, 0, length - available);
+
+	position += length;
 
 	return buffer;
 
 }
 
 
+/**
+ * Store a block of data in the file.
+ *
+ * @param data The data to store
+ * @param length The length of the block
+ */
+void File::storeBlock (const unsigned char* data, int length) {
+
+	fwrite(data, 1, length, file);
+
+	return;
+
+}
+
+
 /**
  * Load a block of RLE compressed data from the file.
  *
@@ -333,46 +781,54 @@ unsigned char * File::loadBlock (int length) {
 unsigned char* File::loadRLE (int length) {
 
 	unsigned char* buffer;
-	int rle, pos, byte, count, next;
+	unsigned char* src;
+	unsigned char* end;
+	int rle, pos, count, copy, next;
+
+	LOAD_DECODE_START();
 
 	// Determine the offset that follows the block
-	next = fgetc(file);
-	next += fgetc(file) << 8;
-	next += ftell(file);
+	next = loadShort();
+	next += position;
 
 	buffer = new unsigned char[length];
 
+	src = contents + ((position < size)? position: size);
+	end = contents + size;
+
 	pos = 0;
 
+	// Decode runs straight from memory, treating the end of the file as 255s
 	while (pos < length) {
 
-		rle = fgetc(file);
+		rle = (src < end)? *(src++): 255;
 
 		if (rle & 128) {
 
-			byte = fgetc(file);
-
-			for (count = 0; count < (rle & 127); count++) {
+			count = rle & 127;
+			if (count > length - pos) count = length - pos;
 
-				buffer[pos++] = byte;
-				if (pos >= length) break;
-
-			}
+			memset(buffer + pos, (src < end)? *(src++): 255, count);
+			pos += count;
 
 		} else if (rle) {
 
-			for (count = 0; count < rle; count++) {
-
-				buffer[pos++] = fgetc(file);
-				if (pos >= length) break;
+			count = rle;
+			if (count > length - pos) count = length - pos;
+			copy = (count < end - src)? count: end - src;
 
-			}
+			memcpy(buffer + pos, src, copy);
+			memset(buffer + pos + copy, 255, count - copy);
+			src += copy;
+			pos += count;
 
-		} else buffer[pos++] = fgetc(file);
+		} else buffer[pos++] = (src < end)? *(src++): 255;
 
 	}
 
-	fseek(file, next, SEEK_SET);
+	position = next;
+
+	LOAD_DECODE_END(loadIndex, LD_RLE);
 
 	return buffer;
 
@@ -386,10 +842,9 @@ void File::skipRLE () {
 
 	int next;
 
-	next = fgetc(file);
-	next += fgetc(file) << 8;
+	next = loadShort();
 
-	fseek(file, next, SEEK_CUR);
+	position += next;
 
 	return;
 
@@ -406,22 +861,54 @@ void File::skipRLE () {
  */
 unsigned char* File::loadLZ (int compressedLength, int length) {
 
-	unsigned char* compressedBuffer;
 	unsigned char* buffer;
 
-	compressedBuffer = loadBlock(compressedLength);
-
 	buffer = new unsigned char[length];
 
-	uncompress(buffer, (unsigned long int *)&length, compressedBuffer, compressedLength);
-
-	delete[] compressedBuffer;
+	loadLZ(compressedLength, buffer, length);
 
 	return buffer;
 
 }
 
 
+/**
+ * Load the start of a block of LZ compressed data from the file, inflating it
+ * straight from the file's contents. Inflating stops once the given buffer is
+ * full, so only as much of the block as is needed gets decompressed. Any part
+ * of the buffer the block does not fill is cleared.
+ *
+ * @param compressedLength The length of the compressed block
+ * @param buffer Buffer to receive the uncompressed data
+ * @param length The length of the buffer
+ *
+ * @return The number of bytes decompressed
+ */
+int File::loadLZ (int compressedLength, unsigned char* buffer, int length) {
+
+	int available, inflated;
+
+	LOAD_DECODE_START();
+
+	available = size - position;
+	if (available > compressedLength) available = compressedLength;
+	if (available < 0) available = 0;
+
+	inflated = inflateZlib(available? contents + position: contents, available, buffer, length);
+
+	if (inflated < 0) inflated = 0;
+
+	if (inflated < length) memset(buffer + inflated, 0, length - inflated);
+
+	position += compressedLength;
+
+	LOAD_DECODE_END(loadIndex, LD_LZ);
+
+	return inflated;
+
+}
+
+
 /**
  * Load a string from the file.
  *
@@ -432,12 +919,13 @@ char * File::loadString () {
 	char *string;
 	int length, count;
 
-	length = fgetc(file);
+	length = loadChar();
 
 	if (length) {
 
 		string = new char[length + 1];
-		fread(string, 1, length, file);
+
+		for (count = 0; count < length; count++) string[count] = loadChar();
 
 	} else {
 
@@ -446,13 +934,13 @@ char * File::loadString () {
 
 		for (count = 0; count < 9; count++) {
 
-			string[count] = fgetc(file);
+			string[count] = loadChar();
 
 			if (string[count] == '.') {
 
-				string[++count] = fgetc(file);
-				string[++count] = fgetc(file);
-				string[++count] = fgetc(file);
+				string[++count] = loadChar();
+				string[++count] = loadChar();
+				string[++count] = loadChar();
 				count++;
 
 				break;
@@ -509,6 +997,8 @@ unsigned char* File::loadPixels  (int length) {
 	unsigned char* sorted;
 	int count;
 
+	LOAD_DECODE_START();
+
 	sorted = new unsigned char[length];
 
 	pixels = loadBlock(length);
@@ -522,6 +1012,8 @@ unsigned char* File::loadPixels  (int length) {
 
 	delete[] pixels;
 
+	LOAD_DECODE_END(loadIndex, LD_PIXELS);
+
 	return sorted;
 
 }
@@ -542,6 +1034,7 @@ unsigned char* File::loadPixels (int length, int key) {
 	unsigned char mask = 0;
 	int count;
 
+	LOAD_DECODE_START();
 
 	sorted = new unsigned char[length];
 	pixels = new unsigned char[length];
@@ -552,7 +1045,7 @@ unsigned char* File::loadPixels (int length, int key) {
 	// Four pixels are packed into the lower end of each byte
 	for (count = 0; count < length; count++) {
 
-		if (!(count & 3)) mask = fgetc(file);
+		if (!(count & 3)) mask = loadChar();
 		pixels[count] = (mask >> (count & 3)) & 1;
 
 	}
@@ -576,7 +1069,7 @@ unsigned char* File::loadPixels (int length, int key) {
 
 			// The unmasked portions are transparent, so no masked
 			// portion should be transparent.
-			while (pixels[count] == key) pixels[count] = fgetc(file);
+			while (pixels[count] == key) pixels[count] = loadChar();
 
 		}
 
@@ -591,6 +1084,8 @@ unsigned char* File::loadPixels (int length, int key) {
 
 	delete[] pixels;
 
+	LOAD_DECODE_END(loadIndex, LD_PIXELS);
+
 	return sorted;
 
 }
@@ -627,6 +1122,153 @@ void File::loadPalette (SDL_Color* palette, bool rle) {
 }
 
 
+/**
+ * Find when a file in any of the available paths was last modified, without
+ * reading it.
+ *
+ * @param name File name
+ *
+ * @return The modification time, or -1 if the file could not be found
+ */
+time_t getFileTime (const char* name) {
+
+	Path* path;
+	FILE* file;
+	char filePath[PATH_LENGTH];
+	struct stat info;
+
+	for (path = firstPath; path; path = path->next) {
+
+		if (path->indexed) {
+
+			if (!findIndexedPath(path, name, filePath)) continue;
+
+			file = fopen(filePath, "rb");
+
+		} else {
+
+			if (!writeString(filePath, PATH_LENGTH, path->path, name)) continue;
+
+			file = openFile(filePath, strlen(path->path), "rb");
+
+		}
+
+		if (file) {
+
+			if (fstat(fileno(file), &info)) info.st_mtime = 0;
+
+			fclose(file);
+
+			return info.st_mtime;
+
+		}
+
+	}
+
+	return -1;
+
+}
+
+
+/**
+ * Find whether or not a file is in any of the paths, without opening it if
+ * the path index can answer.
+ *
+ * @param name The file's name
+ *
+ * @return Whether or not the file was found
+ */
+bool hasFile (const char* name) {
+
+	Path* path;
+	FILE* file;
+	char filePath[PATH_LENGTH];
+
+	for (path = firstPath; path; path = path->next) {
+
+		if (path->indexed) {
+
+			if (findIndexedPath(path, name, filePath)) return true;
+
+			continue;
+
+		}
+
+		if (!writeString(filePath, PATH_LENGTH, path->path, name)) continue;
+
+		file = openFile(filePath, strlen(path->path), "rb");
+
+		if (file) {
+
+			fclose(file);
+
+			return true;
+
+		}
+
+	}
+
+	return false;
+
+}
+
+
+/**
+ * Call a function for each file in the indexed paths, with the file's name in
+ * lower case. Files in paths which could not be listed are not visited. The
+ * function must not open files.
+ *
+ * @param visit The function
+ * @param data Passed to the function
+ */
+void visitFiles (FileVisitor visit, void* data) {
+
+	PathEntry* entry;
+	int bucket;
+
+	if (!pathIndexLock) return;
+
+	SDL_LockMutex(pathIndexLock);
+
+	for (bucket = 0; bucket < PATH_INDEX_BUCKETS; bucket++) {
+
+		for (entry = pathIndex[bucket]; entry; entry = entry->next) visit(entry->name, data);
+
+	}
+
+	SDL_UnlockMutex(pathIndexLock);
+
+	return;
+
+}
+
+
+/**
+ * Find when any of the paths last had files added, removed or renamed.
+ *
+ * @return The latest modification time of the paths' directories, or 0 if
+ * none could be found
+ */
+time_t getPathsTime () {
+
+	Path* path;
+	struct stat info;
+	time_t latest;
+
+	latest = 0;
+
+	for (path = firstPath; path; path = path->next) {
+
+		if (!stat(path->path[0]? path->path: ".", &info) && (info.st_mtime > latest))
+			latest = info.st_mtime;
+
+	}
+
+	return latest;
+
+}
+
+
 /**
  * Create a new directory path object.
  *
@@ -637,6 +1279,7 @@ Path::Path (Path* newNext, char* newPath) {
 
 	next = newNext;
 	path = newPath;
+	indexed = false;
 
 	return;
 
@@ -32,24 +32,37 @@
 #include <SDL.h>
 #endif
 #include <stdio.h>
+#include <time.h>
 
 
 // Classes
 
+class Path;
+
 /// File i/o
 class File {
 
 	private:
-		FILE* file;
-		char* filePath;
+		FILE*          file; ///< File being written, or NULL if being read
+		char*          filePath; ///< Path of the file
+		unsigned char* contents; ///< Contents of the file being read, or NULL if being written
+		int            size; ///< Size of the file being read
+		int            position; ///< Read location within the file being read
+#ifdef PROFILE
+		int            loadIndex; ///< Entry in the load report, or -1
+		int            syscalls; ///< Calls made to the file system while opening
+#endif
 
-		bool open (const char* path, const char* name, bool write);
+		bool open (Path* path, const char* name, bool write);
 
 	public:
 		File                           (const char* name, bool write);
+		File                           (const unsigned char* data, int length);
 		~File                          ();
 
 		int                getSize     ();
+		const char*        getPath     ();
+		unsigned int       getHash     ();
 		void               seek        (int offset, bool reset);
 		int                tell        ();
 		unsigned char      loadChar    ();
@@ -60,9 +73,11 @@ class File {
 		signed int         loadInt     ();
 		void               storeInt    (signed int val);
 		unsigned char*     loadBlock   (int length);
+		void               storeBlock  (const unsigned char* data, int length);
 		unsigned char*     loadRLE     (int length);
 		void               skipRLE     ();
 		unsigned char*     loadLZ      (int compressedLength, int length);
+		int                loadLZ      (int compressedLength, unsigned char* buffer, int length);
 		char*              loadString  ();
 		SDL_Surface*       loadSurface (int width, int height);
 		unsigned char*     loadPixels  (int length);
@@ -77,6 +92,7 @@ class Path {
 	public:
 		Path* next; ///< Next path to check
 		char* path; ///< Path
+		bool  indexed; ///< Whether or not the path's files are in the path index
 
 		Path  (Path* newNext, char* newPath);
 		~Path ();
@@ -84,9 +100,25 @@ class Path {
 };
 
 
+// Datatype
+
+/// Function called for each file listed in the path index
+typedef void (*FileVisitor) (const char* name, void* data);
+
+
 // Variable
 
 EXTERN Path* firstPath; ///< Paths to files
 
+
+// Functions
+
+EXTERN void   indexPaths     ();
+EXTERN void   clearPathIndex ();
+EXTERN time_t getFileTime    (const char* name);
+EXTERN bool   hasFile        (const char* name);
+EXTERN void   visitFiles     (FileVisitor visit, void* data);
+EXTERN time_t getPathsTime   ();
+
 #endif
 
@@ -26,8 +26,6 @@
 #include "anim.h"
 #include "sprite.h"
 
-#include "jj1level/jj1level.h"
-
 
 /**
  * Create empty animation.
@@ -40,6 +38,8 @@ Anim::Anim () {
 
 	frame = 0;
 	yOffset = 0;
+	accessory = 0;
+	accessoryAnim = NULL;
 
 	return;
 
@@ -93,6 +93,30 @@ void Anim::setData (int length, signed char sX, signed char sY, signed char aX,
 	accessory = a;
 	yOffset = y;
 
+	// Found once the whole set has its data
+	accessoryAnim = NULL;
+
+	return;
+
+}
+
+
+/**
+ * Find the accessory animation, and where it is drawn, once all the
+ * animations in its set have their data. Animations whose accessory is never
+ * found are drawn without one.
+ *
+ * @param animSet The animation set holding the accessory
+ * @param anims The number of animations in the set
+ */
+void Anim::setAccessory (Anim* animSet, int anims) {
+
+	if (!accessory || (accessory >= anims)) return;
+
+	accessoryAnim = animSet + accessory;
+	accessoryDX = ITOF(accessoryX << 2);
+	accessoryDY = ITOF(accessoryY - yOffset) - accessoryAnim->getOffset();
+
 	return;
 
 }
@@ -261,24 +285,67 @@ fixed Anim::getYOffset () {
  */
 void Anim::draw (fixed x, fixed y, int accessories) {
 
-	Anim* anim;
-
 	sprites[frame]->draw(
 		FTOI(x) + (xOffsets[frame] << 2),
 		FTOI(y) + yOffsets[frame] - yOffset);
 
+	drawAccessories(x, y, accessories);
+
+	return;
+
+}
+
+
+/**
+ * Draw the chain of accessories following the current frame, each on the
+ * frame of the one before.
+ *
+ * @param x X-coordinate at which the animation is drawn
+ * @param y Y-coordinate at which the animation is drawn
+ * @param accessories Number of accessory animations to draw
+ */
+void Anim::drawAccessories (fixed x, fixed y, int accessories) {
+
+	Anim* anim;
+	Anim* next;
+
+	// The chain may lead back to an earlier animation, so is cut short
+	for (anim = this; accessories && anim->accessoryAnim; accessories--) {
 
-	if (accessories && accessory) {
+		next = anim->accessoryAnim;
+		next->setFrame(anim->frame, true);
 
-		anim = level->getAnim(accessory);
-		anim->setFrame(frame, true);
-		anim->draw(
-			x + ITOF(accessoryX << 2),
-			y + ITOF(accessoryY - yOffset) - anim->getOffset(),
-			accessories - 1);
+		x += anim->accessoryDX;
+		y += anim->accessoryDY;
+		anim = next;
+
+		anim->sprites[anim->frame]->draw(
+			FTOI(x) + (anim->xOffsets[anim->frame] << 2),
+			FTOI(y) + anim->yOffsets[anim->frame] - anim->yOffset);
 
 	}
 
+	return;
+
+}
+
+
+/**
+ * Draw current frame in a single colour, as when it has been hit, with its
+ * accessories drawn as usual.
+ *
+ * @param x X-coordinate at which to draw
+ * @param y Y-coordinate at which to draw
+ * @param index The colour
+ */
+void Anim::drawFlashed (fixed x, fixed y, unsigned char index) {
+
+	sprites[frame]->drawFlashed(
+		FTOI(x) + (xOffsets[frame] << 2),
+		FTOI(y) + yOffsets[frame] - yOffset,
+		index);
+
+	drawAccessories(x, y, 7);
 
 	return;
 
@@ -318,20 +385,6 @@ void Anim::setPalette (SDL_Color *palette, int start, int amount) {
 }
 
 
-/**
- * Turn the whole of the current frame a single colour.
- *
- * @param index The index of the colour to use
- */
-void Anim::flashPalette (int index) {
-
-	sprites[frame]->flashPalette(index);
-
-	return;
-
-}
-
-
 /**
  * Restore the current frame's original palette.
  */
@@ -55,12 +55,18 @@ class Anim {
 		unsigned char  frame;     ///< Current frame
 		unsigned char  accessory; ///< Number of an animation that is an accessory to this animation
 		                          ///< Most of the time accessories are used with guardians.
+		Anim*          accessoryAnim; ///< The accessory animation, or NULL if there is none
+		fixed          accessoryDX; ///< Horizontal offset of the accessory animation
+		fixed          accessoryDY; ///< Vertical offset of the accessory animation
+
+		void  drawAccessories       (fixed x, fixed y, int accessories);
 
 	public:
 		Anim                        ();
 		~Anim                       ();
 
 		void  setData               (int length, signed char sX, signed char sY, signed char aX, signed char aY, unsigned char a, signed char y);
+		void  setAccessory          (Anim* animSet, int anims);
 		void  setFrame              (int nextFrame, bool looping);
 		void  setFrameData          (Sprite *frameSprite, signed char x, signed char y);
 		int   getWidth              ();
@@ -74,9 +80,9 @@ class Anim {
 		fixed getXOffset            ();
 		fixed getYOffset            ();
 		void  draw                  (fixed x, fixed y, int accessories = 7);
+		void  drawFlashed           (fixed x, fixed y, unsigned char index);
 		void  drawScaled            (fixed x, fixed y, fixed scale);
 		void  setPalette            (SDL_Color *palette, int start, int amount);
-		void  flashPalette          (int index);
 		void  restorePalette        ();
 
 };
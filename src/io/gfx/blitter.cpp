@@ -0,0 +1,844 @@
+
+/**
+ *
+ * @file blitter.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created blitter.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Draws 8-bit colour-keyed images straight into the canvas, without going
+ * through SDL's generic blitting.
+ *
+ */
+
+
+#include "blitter.h"
+
+#include "loop.h"
+
+#include <string.h>
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	#include <arm_neon.h>
+#endif
+
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+/**
+ * Copy every pixel in a row except those matching the colour key.
+ *
+ * @param src Source pixels
+ * @param dst Destination pixels
+ * @param width Number of pixels
+ * @param key Colour key
+ */
+static void blendRow (const unsigned char* src, unsigned char* dst, int width, unsigned char key) {
+
+	uint8x16_t keys, pixels, transparent;
+	int x;
+
+	keys = vdupq_n_u8(key);
+
+	for (x = 0; x + 16 <= width; x += 16) {
+
+		pixels = vld1q_u8(src + x);
+		transparent = vceqq_u8(pixels, keys);
+		vst1q_u8(dst + x, vbslq_u8(transparent, vld1q_u8(dst + x), pixels));
+
+	}
+
+	for (; x < width; x++) {
+
+		if (src[x] != key) dst[x] = src[x];
+
+	}
+
+	return;
+
+}
+#endif
+
+
+/**
+ * Create an empty image.
+ */
+BlitImage::BlitImage () {
+
+	pixels = NULL;
+	width = 0;
+	height = 0;
+	type = BT_EMPTY;
+	spans = NULL;
+	rowSpans = NULL;
+
+	return;
+
+}
+
+
+/**
+ * Delete the image.
+ */
+BlitImage::~BlitImage () {
+
+	if (spans) delete[] spans;
+	if (rowSpans) delete[] rowSpans;
+
+	return;
+
+}
+
+
+/**
+ * Classify the image's pixels, and find the runs of opaque pixels in each
+ * row. The pixels are not copied, so must outlive the image.
+ *
+ * @param data The pixels
+ * @param dataPitch Bytes between the starts of successive rows
+ * @param newWidth The width of the image
+ * @param newHeight The height of the image
+ * @param newKey The colour key
+ */
+void BlitImage::setPixels (unsigned char* data, int dataPitch, int newWidth, int newHeight, unsigned char newKey) {
+
+	unsigned char* row;
+	int x, y, count, opaque;
+
+	if (spans) delete[] spans;
+	if (rowSpans) delete[] rowSpans;
+
+	pixels = data;
+	pitch = dataPitch;
+	width = newWidth;
+	height = newHeight;
+	key = newKey;
+	spans = NULL;
+	rowSpans = NULL;
+
+
+	// Count the runs, and the pixels in them
+
+	count = 0;
+	opaque = 0;
+
+	for (y = 0; y < height; y++) {
+
+		row = pixels + (pitch * y);
+
+		for (x = 0; x < width; x++) {
+
+			if (row[x] != key) {
+
+				if (!x || (row[x - 1] == key)) count++;
+				opaque++;
+
+			}
+
+		}
+
+	}
+
+	if (!opaque) {
+
+		type = BT_EMPTY;
+
+		return;
+
+	}
+
+	if (opaque == width * height) {
+
+		type = BT_OPAQUE;
+
+		return;
+
+	}
+
+	type = BT_KEYED;
+
+
+	// Record the runs
+
+	spans = new BlitSpan[count];
+	rowSpans = new int[height + 1];
+	count = 0;
+
+	for (y = 0; y < height; y++) {
+
+		row = pixels + (pitch * y);
+		rowSpans[y] = count;
+
+		for (x = 0; x < width; x++) {
+
+			if (row[x] != key) {
+
+				if (!x || (row[x - 1] == key)) {
+
+					spans[count].start = x;
+					spans[count].length = 0;
+					count++;
+
+				}
+
+				spans[count - 1].length++;
+
+			}
+
+		}
+
+	}
+
+	rowSpans[height] = count;
+
+	return;
+
+}
+
+
+/**
+ * Give the image a size but no pixels, for when it will never be drawn.
+ *
+ * @param newWidth The width of the image
+ * @param newHeight The height of the image
+ */
+void BlitImage::setSize (int newWidth, int newHeight) {
+
+	if (spans) delete[] spans;
+	if (rowSpans) delete[] rowSpans;
+
+	pixels = NULL;
+	pitch = 0;
+	width = newWidth;
+	height = newHeight;
+	key = 0;
+	type = BT_EMPTY;
+	spans = NULL;
+	rowSpans = NULL;
+
+	return;
+
+}
+
+
+/**
+ * Get how the image needs to be drawn.
+ *
+ * @return The image's type
+ */
+BlitType BlitImage::getType () {
+
+	return type;
+
+}
+
+
+/**
+ * Draw rows of the image into the canvas. Each combination of the image's
+ * type, mirroring and clipping gets its own copy of this function, so that
+ * none of them are tested for each row or run.
+ *
+ * @param dst The canvas pixel at which the first row's left edge is drawn
+ * @param top The first row to draw
+ * @param bottom The row after the last row to draw
+ * @param left The first column to draw
+ * @param right The column after the last column to draw
+ */
+template <BlitType TYPE, bool MIRRORED, bool CLIPPED>
+void BlitImage::drawRows (unsigned char* dst, int top, int bottom, int left, int right) {
+
+	unsigned char* src;
+	int row, span, start, end, count;
+
+	for (row = top; row < bottom; row++) {
+
+		// When mirrored, destination column c takes source column
+		// (width - 1 - c)
+		src = pixels + (pitch * row);
+		if (MIRRORED) src += width - 1;
+
+		if (TYPE == BT_OPAQUE) {
+
+			if (MIRRORED) {
+
+				for (count = left; count < right; count++) dst[count] = src[-count];
+
+			} else {
+
+				memcpy(dst + left, src + left, right - left);
+
+			}
+
+			dst += canvas->pitch;
+
+			continue;
+
+		}
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+		// Rows broken into many runs are quicker to blend a vector at a time
+		if (!MIRRORED && !CLIPPED && (rowSpans[row + 1] - rowSpans[row] > 2)) {
+
+			blendRow(src, dst, width, key);
+			dst += canvas->pitch;
+
+			continue;
+
+		}
+#endif
+
+		for (span = rowSpans[row]; span < rowSpans[row + 1]; span++) {
+
+			if (MIRRORED) {
+
+				start = width - spans[span].start - spans[span].length;
+				end = width - spans[span].start;
+
+			} else {
+
+				start = spans[span].start;
+				end = start + spans[span].length;
+
+			}
+
+			if (CLIPPED) {
+
+				if (start < left) start = left;
+				if (end > right) end = right;
+				if (end <= start) continue;
+
+			}
+
+			if (MIRRORED) {
+
+				for (count = start; count < end; count++) dst[count] = src[-count];
+
+			} else {
+
+				memcpy(dst + start, src + start, end - start);
+
+			}
+
+		}
+
+		dst += canvas->pitch;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Fill the opaque pixels in rows of the image's area of the canvas with a
+ * single colour, as when a sprite flashes. Only used for a few sprites at a
+ * time, so the choices are made for each row.
+ *
+ * @param dst The canvas pixel at which the first row's left edge is drawn
+ * @param top The first row to fill
+ * @param bottom The row after the last row to fill
+ * @param left The first column to fill
+ * @param right The column after the last column to fill
+ * @param mirrored Whether or not to mirror the image horizontally
+ * @param index The colour
+ */
+void BlitImage::drawSolidRows (unsigned char* dst, int top, int bottom, int left, int right, bool mirrored, unsigned char index) {
+
+	int row, span, start, end;
+
+	for (row = top; row < bottom; row++) {
+
+		if (type == BT_OPAQUE) {
+
+			memset(dst + left, index, right - left);
+			dst += canvas->pitch;
+
+			continue;
+
+		}
+
+		for (span = rowSpans[row]; span < rowSpans[row + 1]; span++) {
+
+			if (mirrored) start = width - spans[span].start - spans[span].length;
+			else start = spans[span].start;
+
+			end = start + spans[span].length;
+
+			if (start < left) start = left;
+			if (end > right) end = right;
+
+			if (end > start) memset(dst + start, index, end - start);
+
+		}
+
+		dst += canvas->pitch;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Draw the image, within the given rectangle of the canvas, choosing the rows
+ * drawing function once for the whole image. The canvas must already be
+ * locked, if it needs to be.
+ *
+ * @param x The x-coordinate at which to draw the image
+ * @param y The y-coordinate at which to draw the image
+ * @param clip The rectangle, which must be within the canvas
+ * @param mirrored Whether or not to mirror the image horizontally
+ * @param solid The colour to draw every opaque pixel, or -1 to draw the
+ * image's own pixels
+ */
+void BlitImage::drawInRect (int x, int y, SDL_Rect* clip, bool mirrored, int solid) {
+
+	unsigned char* dst;
+	int top, bottom, left, right;
+	bool clipped;
+
+	if (type == BT_EMPTY) return;
+
+	// Find the visible part of the image
+	top = (clip->y > y)? clip->y - y: 0;
+	bottom = (clip->y + clip->h < y + height)? clip->y + clip->h - y: height;
+	left = (clip->x > x)? clip->x - x: 0;
+	right = (clip->x + clip->w < x + width)? clip->x + clip->w - x: width;
+
+	if ((top >= bottom) || (left >= right)) return;
+
+	dst = ((unsigned char *)(canvas->pixels)) + (canvas->pitch * (y + top)) + x;
+
+	if (solid >= 0) {
+
+		drawSolidRows(dst, top, bottom, left, right, mirrored, solid);
+
+		return;
+
+	}
+
+	// Only the columns need clipping, as the rows are chosen above
+	clipped = left || (right < width);
+
+	if (type == BT_OPAQUE) {
+
+		if (mirrored) drawRows<BT_OPAQUE, true, false>(dst, top, bottom, left, right);
+		else drawRows<BT_OPAQUE, false, false>(dst, top, bottom, left, right);
+
+	} else if (clipped) {
+
+		if (mirrored) drawRows<BT_KEYED, true, true>(dst, top, bottom, left, right);
+		else drawRows<BT_KEYED, false, true>(dst, top, bottom, left, right);
+
+	} else {
+
+		if (mirrored) drawRows<BT_KEYED, true, false>(dst, top, bottom, left, right);
+		else drawRows<BT_KEYED, false, false>(dst, top, bottom, left, right);
+
+	}
+
+	return;
+
+}
+
+
+#ifdef SDL2
+/**
+ * Draw rows of the image into the 32-bit canvas, from its expanded pixels.
+ * Only used for tiles in true-colour mode, so the choices are made for each
+ * row.
+ *
+ * @param dst The 32-bit canvas pixel at which the first row's left edge is
+ * drawn
+ * @param colours The image's expanded pixels, laid out like its palette
+ * indices
+ * @param top The first row to draw
+ * @param bottom The row after the last row to draw
+ * @param left The first column to draw
+ * @param right The column after the last column to draw
+ * @param mirrored Whether or not to mirror the image horizontally
+ */
+void BlitImage::drawTrueRows (Uint32* dst, const Uint32* colours, int top, int bottom, int left, int right, bool mirrored) {
+
+	const Uint32* src;
+	int row, span, start, end, count;
+
+	for (row = top; row < bottom; row++) {
+
+		// When mirrored, destination column c takes source column
+		// (width - 1 - c)
+		src = colours + (pitch * row);
+		if (mirrored) src += width - 1;
+
+		if (type == BT_OPAQUE) {
+
+			if (mirrored) {
+
+				for (count = left; count < right; count++) dst[count] = src[-count];
+
+			} else {
+
+				memcpy(dst + left, src + left, (right - left) * sizeof(Uint32));
+
+			}
+
+			dst += canvas->pitch;
+
+			continue;
+
+		}
+
+		for (span = rowSpans[row]; span < rowSpans[row + 1]; span++) {
+
+			if (mirrored) start = width - spans[span].start - spans[span].length;
+			else start = spans[span].start;
+
+			end = start + spans[span].length;
+
+			if (start < left) start = left;
+			if (end > right) end = right;
+			if (end <= start) continue;
+
+			if (mirrored) {
+
+				for (count = start; count < end; count++) dst[count] = src[-count];
+
+			} else {
+
+				memcpy(dst + start, src + start, (end - start) * sizeof(Uint32));
+
+			}
+
+		}
+
+		dst += canvas->pitch;
+
+	}
+
+	return;
+
+}
+#endif
+
+
+/**
+ * Draw the image, respecting the canvas's clipping rectangle.
+ *
+ * @param x The x-coordinate at which to draw the image
+ * @param y The y-coordinate at which to draw the image
+ */
+void BlitImage::draw (int x, int y) {
+
+	if (type == BT_EMPTY) return;
+
+	if (SDL_MUSTLOCK(canvas)) SDL_LockSurface(canvas);
+
+	draw(x, y, &(canvas->clip_rect));
+
+	if (SDL_MUSTLOCK(canvas)) SDL_UnlockSurface(canvas);
+
+	return;
+
+}
+
+
+/**
+ * Draw the image, within the given rectangle of the canvas. The canvas must
+ * already be locked, if it needs to be. Images drawn within rectangles which
+ * do not overlap may be drawn on different threads at once.
+ *
+ * @param x The x-coordinate at which to draw the image
+ * @param y The y-coordinate at which to draw the image
+ * @param clip The rectangle, which must be within the canvas
+ */
+void BlitImage::draw (int x, int y, SDL_Rect* clip) {
+
+	drawInRect(x, y, clip, false, -1);
+
+	return;
+
+}
+
+
+/**
+ * Draw the image mirrored horizontally, respecting the canvas's clipping
+ * rectangle.
+ *
+ * @param x The x-coordinate at which to draw the image
+ * @param y The y-coordinate at which to draw the image
+ */
+void BlitImage::drawMirrored (int x, int y) {
+
+	if (type == BT_EMPTY) return;
+
+	if (SDL_MUSTLOCK(canvas)) SDL_LockSurface(canvas);
+
+	drawMirrored(x, y, &(canvas->clip_rect));
+
+	if (SDL_MUSTLOCK(canvas)) SDL_UnlockSurface(canvas);
+
+	return;
+
+}
+
+
+/**
+ * Draw the image mirrored horizontally, within the given rectangle of the
+ * canvas. The canvas must already be locked, if it needs to be.
+ *
+ * @param x The x-coordinate at which to draw the image
+ * @param y The y-coordinate at which to draw the image
+ * @param clip The rectangle, which must be within the canvas
+ */
+void BlitImage::drawMirrored (int x, int y, SDL_Rect* clip) {
+
+	drawInRect(x, y, clip, true, -1);
+
+	return;
+
+}
+
+
+/**
+ * Draw the image's opaque pixels in a single colour, respecting the canvas's
+ * clipping rectangle.
+ *
+ * @param x The x-coordinate at which to draw the image
+ * @param y The y-coordinate at which to draw the image
+ * @param index The colour
+ * @param mirrored Whether or not to mirror the image horizontally
+ */
+void BlitImage::drawSolid (int x, int y, unsigned char index, bool mirrored) {
+
+	if (type == BT_EMPTY) return;
+
+	if (SDL_MUSTLOCK(canvas)) SDL_LockSurface(canvas);
+
+	drawInRect(x, y, &(canvas->clip_rect), mirrored, index);
+
+	if (SDL_MUSTLOCK(canvas)) SDL_UnlockSurface(canvas);
+
+	return;
+
+}
+
+
+#ifdef SDL2
+/**
+ * Draw the image into the 32-bit canvas, within the given rectangle, from its
+ * expanded pixels. Its opaque pixels in the canvas are made see-through, so
+ * that it shows over whatever has been drawn beneath it. The canvas must
+ * already be locked, if it needs to be. Images drawn within rectangles which
+ * do not overlap may be drawn on different threads at once.
+ *
+ * @param target The 32-bit canvas
+ * @param colours The image's expanded pixels, laid out like its palette
+ * indices
+ * @param x The x-coordinate at which to draw the image
+ * @param y The y-coordinate at which to draw the image
+ * @param clip The rectangle, which must be within the canvas
+ * @param mirrored Whether or not to mirror the image horizontally
+ */
+void BlitImage::drawTrue (Uint32* target, const Uint32* colours, int x, int y, SDL_Rect* clip, bool mirrored) {
+
+	int top, bottom, left, right;
+
+	if (type == BT_EMPTY) return;
+
+	// Find the visible part of the image
+	top = (clip->y > y)? clip->y - y: 0;
+	bottom = (clip->y + clip->h < y + height)? clip->y + clip->h - y: height;
+	left = (clip->x > x)? clip->x - x: 0;
+	right = (clip->x + clip->w < x + width)? clip->x + clip->w - x: width;
+
+	if ((top >= bottom) || (left >= right)) return;
+
+	drawTrueRows(target + (canvas->pitch * (y + top)) + x, colours, top, bottom, left, right, mirrored);
+	drawSolidRows(((unsigned char *)(canvas->pixels)) + (canvas->pitch * (y + top)) + x,
+		top, bottom, left, right, mirrored, SEE_THROUGH);
+
+	return;
+
+}
+#endif
+
+
+/**
+ * Get the width of the image.
+ *
+ * @return The width
+ */
+int BlitImage::getWidth () {
+
+	return width;
+
+}
+
+
+/**
+ * Get the height of the image.
+ *
+ * @return The height
+ */
+int BlitImage::getHeight () {
+
+	return height;
+
+}
+
+
+/**
+ * Prepare each tile in a tile set for drawing. The tile set must outlive the
+ * prepared tiles. No surface is needed, so any thread may prepare them.
+ *
+ * @param tileSet The tile set's pixels, with square tiles stacked vertically
+ * @param size The width and height of each tile, and the length of each row
+ * @param tiles The number of tiles in the tile set
+ * @param slots The number of tile indices which may be used, leaving any
+ * beyond the end of the tile set empty
+ * @param key The colour key
+ *
+ * @return The prepared tiles
+ */
+BlitImage* createBlitImages (unsigned char* tileSet, int size, int tiles, int slots, unsigned char key) {
+
+	BlitImage* images;
+	int count;
+
+	images = new BlitImage[slots];
+
+	// A dedicated server never draws tiles
+	if (headless) return images;
+
+	for (count = 0; count < tiles; count++) {
+
+		images[count].setPixels(tileSet + (size * size * count), size, size, size, key);
+
+	}
+
+	return images;
+
+}
+
+
+#ifdef SDL2
+/**
+ * Prepare to expand images' palette indices. Nothing is expanded until the
+ * images are first refreshed.
+ *
+ * @param newPixels The images' palette indices, one image after another, which
+ * must outlive the expanded images
+ * @param newSize The number of pixels in each image
+ * @param newImages The number of images
+ */
+ExpandedSet::ExpandedSet (unsigned char* newPixels, int newSize, int newImages) {
+
+	int image, count;
+
+	pixels = newPixels;
+	size = newSize;
+	images = newImages;
+	epoch = 0;
+
+	colours = new Uint32[size * images];
+	used = new Uint32[images << 3];
+
+	memset(used, 0, (images << 3) * sizeof(Uint32));
+
+	for (image = 0; image < images; image++) {
+
+		for (count = 0; count < size; count++)
+			used[(image << 3) + (pixels[(image * size) + count] >> 5)] |= 1u << (pixels[(image * size) + count] & 31);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Delete the expanded images.
+ */
+ExpandedSet::~ExpandedSet () {
+
+	delete[] used;
+	delete[] colours;
+
+	return;
+
+}
+
+
+/**
+ * Expand again the images using any colour of the display palette which has
+ * changed since they were last expanded. Must be called on the main thread,
+ * before the images are drawn.
+ */
+void ExpandedSet::refresh () {
+
+	Uint32* current;
+	Uint32 changed[8];
+	int image, count;
+
+	if (epoch == video.getPaletteEpoch()) return;
+
+	current = video.getPaletteLUT();
+
+	memset(changed, 0, sizeof(changed));
+
+	for (count = 0; count < 256; count++) {
+
+		if (!epoch || (current[count] != lut[count])) changed[count >> 5] |= 1u << (count & 31);
+
+	}
+
+	for (image = 0; image < images; image++) {
+
+		for (count = 0; count < 8; count++) {
+
+			if (used[(image << 3) + count] & changed[count]) {
+
+				expandRow(pixels + (image * size), colours + (image * size), size, current);
+
+				break;
+
+			}
+
+		}
+
+	}
+
+	memcpy(lut, current, sizeof(lut));
+	epoch = video.getPaletteEpoch();
+
+	return;
+
+}
+
+
+/**
+ * Get an image's expanded pixels.
+ *
+ * @param image The number of the image
+ *
+ * @return The expanded pixels, or NULL if there is no such image
+ */
+Uint32* ExpandedSet::getColours (int image) {
+
+	if ((image < 0) || (image >= images)) return NULL;
+
+	return colours + (image * size);
+
+}
+#endif
@@ -0,0 +1,121 @@
+
+/**
+ *
+ * @file blitter.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created blitter.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _BLITTER_H
+#define _BLITTER_H
+
+
+#include "video.h"
+
+
+// Datatypes
+
+/// How an image needs to be drawn
+enum BlitType {
+
+	BT_EMPTY, ///< Nothing to draw
+	BT_OPAQUE, ///< Every pixel is drawn
+	BT_KEYED ///< Only pixels other than the colour key are drawn
+
+};
+
+/// Run of opaque pixels in a row of an image
+typedef struct {
+
+	unsigned short int start; ///< Offset of the first pixel in the run
+	unsigned short int length; ///< Number of pixels in the run
+
+} BlitSpan;
+
+
+// Class
+
+/// 8-bit colour-keyed image prepared for drawing straight into the canvas
+class BlitImage {
+
+	private:
+		unsigned char* pixels; ///< Image pixels (owned by the caller)
+		int            pitch; ///< Bytes between the starts of successive rows
+		int            width; ///< Width
+		int            height; ///< Height
+		unsigned char  key; ///< Colour key
+		BlitType       type; ///< How the image needs to be drawn
+		BlitSpan*      spans; ///< Runs of opaque pixels, row by row
+		int*           rowSpans; ///< Index of each row's first run, followed by the total number of runs
+
+		template <BlitType TYPE, bool MIRRORED, bool CLIPPED>
+		void drawRows      (unsigned char* dst, int top, int bottom, int left, int right);
+		void drawSolidRows (unsigned char* dst, int top, int bottom, int left, int right, bool mirrored, unsigned char index);
+		void drawInRect    (int x, int y, SDL_Rect* clip, bool mirrored, int solid);
+#ifdef SDL2
+		void drawTrueRows  (Uint32* dst, const Uint32* colours, int top, int bottom, int left, int right, bool mirrored);
+#endif
+
+	public:
+		BlitImage  ();
+		~BlitImage ();
+
+		void     setPixels    (unsigned char* data, int dataPitch, int newWidth, int newHeight, unsigned char newKey);
+		void     setSize      (int newWidth, int newHeight);
+		BlitType getType      ();
+		int      getWidth     ();
+		int      getHeight    ();
+		void     draw         (int x, int y);
+		void     draw         (int x, int y, SDL_Rect* clip);
+		void     drawMirrored (int x, int y);
+		void     drawMirrored (int x, int y, SDL_Rect* clip);
+		void     drawSolid    (int x, int y, unsigned char index, bool mirrored);
+#ifdef SDL2
+		void     drawTrue     (Uint32* target, const Uint32* colours, int x, int y, SDL_Rect* clip, bool mirrored);
+#endif
+
+};
+
+#ifdef SDL2
+/// Images' palette indices expanded to the display's colours, for drawing into
+/// the 32-bit canvas. Only the images using colours which have changed are
+/// expanded again.
+class ExpandedSet {
+
+	private:
+		unsigned char* pixels; ///< The images' palette indices, one image after another (owned by the caller)
+		Uint32*        colours; ///< The images' expanded pixels, laid out like their palette indices
+		Uint32*        used; ///< Eight words for each image, with a bit set for each palette index it uses
+		Uint32         lut[256]; ///< The colours the images were last expanded to
+		Uint32         epoch; ///< The display palette epoch the images were last expanded to, or 0 if never
+		int            size; ///< Pixels in each image
+		int            images; ///< Number of images
+
+	public:
+		ExpandedSet  (unsigned char* newPixels, int newSize, int newImages);
+		~ExpandedSet ();
+
+		void    refresh    ();
+		Uint32* getColours (int image);
+
+};
+#endif
+
+
+// Functions
+
+EXTERN BlitImage* createBlitImages (unsigned char* tileSet, int size, int tiles, int slots, unsigned char key);
+
+#endif
+
@@ -0,0 +1,409 @@
+
+/**
+ *
+ * @file capture.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created capture.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Copies shown frames into a ring of buffers, which background jobs save as
+ * PNG screenshots or as clips. The main thread only copies palette indices,
+ * and drops frames rather than waiting when every buffer is still being
+ * saved.
+ *
+ * A clip file starts with "OJV" and a version number, followed by each frame's
+ * time in milliseconds, width, height, 768-byte palette, compressed length,
+ * and palette indices compressed by zlib.
+ *
+ */
+
+
+#include "capture.h"
+
+#include "clock.h"
+#include "miniz.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/**
+ * Create an idle capture.
+ */
+Capture::Capture () {
+
+	int count;
+
+	for (count = 0; count < CAPTURE_FRAMES; count++) {
+
+		frames[count].owner = this;
+		frames[count].pixels = NULL;
+		frames[count].size = 0;
+		frames[count].submitted = false;
+
+	}
+
+	nextFrame = 0;
+	lastJob = NULL;
+	clipFile = NULL;
+	nextShot = 0;
+	nextClip = 0;
+	dropped = 0;
+	shotWanted = false;
+
+	return;
+
+}
+
+
+/**
+ * Delete the capture. finish() must have been called first.
+ */
+Capture::~Capture () {
+
+	int count;
+
+	for (count = 0; count < CAPTURE_FRAMES; count++) delete[] frames[count].pixels;
+
+	return;
+
+}
+
+
+/**
+ * Save a frame. Run in the background.
+ *
+ * @param data The frame
+ */
+void Capture::save (void* data) {
+
+	CaptureFrame* frame;
+
+	frame = (CaptureFrame*)data;
+
+	if (frame->clip) frame->owner->saveClip(frame);
+	else frame->owner->saveShot(frame);
+
+	return;
+
+}
+
+
+/**
+ * Save a frame as a PNG screenshot, with the lowest unused number.
+ *
+ * @param frame The frame
+ */
+void Capture::saveShot (CaptureFrame* frame) {
+
+	File* file;
+	unsigned char* rgb;
+	void* png;
+	char name[16];
+	size_t length;
+	int count;
+
+	for (; nextShot < CAPTURE_NAMES; nextShot++) {
+
+		snprintf(name, sizeof(name), "shot%03d.png", nextShot);
+
+		if (!hasFile(name)) break;
+
+	}
+
+	if (nextShot == CAPTURE_NAMES) return;
+
+	nextShot++;
+
+	rgb = new unsigned char[frame->width * frame->height * 3];
+
+	for (count = 0; count < frame->width * frame->height; count++) {
+
+		rgb[count * 3] = frame->palette[frame->pixels[count]].r;
+		rgb[(count * 3) + 1] = frame->palette[frame->pixels[count]].g;
+		rgb[(count * 3) + 2] = frame->palette[frame->pixels[count]].b;
+
+	}
+
+	png = tdefl_write_image_to_png_file_in_memory(rgb, frame->width, frame->height, 3, &length);
+
+	delete[] rgb;
+
+	if (!png) return;
+
+	try {
+
+		file = new File(name, true);
+
+	} catch (int e) {
+
+		mz_free(png);
+
+		return;
+
+	}
+
+	file->storeBlock((unsigned char*)png, length);
+
+	delete file;
+
+	mz_free(png);
+
+	log("Saved screenshot", name);
+
+	return;
+
+}
+
+
+/**
+ * Add a frame to the clip being recorded.
+ *
+ * @param frame The frame
+ */
+void Capture::saveClip (CaptureFrame* frame) {
+
+	unsigned char* compressed;
+	mz_ulong length;
+	int count;
+
+	length = mz_compressBound(frame->width * frame->height);
+	compressed = new unsigned char[length];
+
+	if (mz_compress2(compressed, &length, frame->pixels, frame->width * frame->height, MZ_BEST_SPEED) != MZ_OK) {
+
+		delete[] compressed;
+
+		return;
+
+	}
+
+	clipFile->storeInt(frame->ticks);
+	clipFile->storeShort(frame->width);
+	clipFile->storeShort(frame->height);
+
+	for (count = 0; count < 256; count++) {
+
+		clipFile->storeChar(frame->palette[count].r);
+		clipFile->storeChar(frame->palette[count].g);
+		clipFile->storeChar(frame->palette[count].b);
+
+	}
+
+	clipFile->storeInt(length);
+	clipFile->storeBlock(compressed, length);
+
+	delete[] compressed;
+
+	return;
+
+}
+
+
+/**
+ * Start recording a clip, with the lowest unused number.
+ */
+void Capture::startClip () {
+
+	char name[16];
+
+	for (; nextClip < CAPTURE_NAMES; nextClip++) {
+
+		snprintf(name, sizeof(name), "clip%03d.ojv", nextClip);
+
+		if (!hasFile(name)) break;
+
+	}
+
+	if (nextClip == CAPTURE_NAMES) return;
+
+	nextClip++;
+
+	try {
+
+		clipFile = new File(name, true);
+
+	} catch (int e) {
+
+		return;
+
+	}
+
+	clipFile->storeBlock((const unsigned char*)"OJV", 3);
+	clipFile->storeChar(CAPTURE_VERSION);
+
+	dropped = 0;
+
+	log("Recording clip", name);
+
+	return;
+
+}
+
+
+/**
+ * Stop recording the clip, once its frames have been saved.
+ */
+void Capture::stopClip () {
+
+	if (!clipFile) return;
+
+	if (lastJob) jobs.wait(lastJob);
+
+	delete clipFile;
+	clipFile = NULL;
+
+	if (dropped) log("Frames dropped from clip", dropped);
+
+	return;
+
+}
+
+
+/**
+ * Take screenshots, and start and stop clips, when their keys are pressed.
+ *
+ * @param event The event
+ */
+void Capture::update (SDL_Event* event) {
+
+	if ((event->type != SDL_KEYDOWN) || event->key.repeat) return;
+
+	if (event->key.keysym.sym == CAPTURE_SHOT_KEY) {
+
+		shotWanted = true;
+
+	} else if (event->key.keysym.sym == CAPTURE_CLIP_KEY) {
+
+		if (clipFile) stopClip();
+		else startClip();
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Copy a frame being shown, if a screenshot is wanted or a clip is being
+ * recorded.
+ *
+ * @param surface The 8-bit surface holding the frame
+ * @param width The width of the frame
+ * @param height The height of the frame
+ * @param palette The palette the frame is shown with
+ * @param fade The fade the frame is presented with
+ */
+void Capture::grab (SDL_Surface* surface, int width, int height, SDL_Color* palette, PaletteFade* fade) {
+
+	CaptureFrame* frame;
+	int y, count;
+
+	if (!shotWanted && !clipFile) return;
+
+	frame = frames + nextFrame;
+
+	// Never wait for the frames being saved
+	if (frame->submitted && !jobs.isDone(&(frame->job))) {
+
+		dropped++;
+
+		return;
+
+	}
+
+	if (frame->size < width * height) {
+
+		delete[] frame->pixels;
+		frame->size = width * height;
+		frame->pixels = new unsigned char[frame->size];
+
+	}
+
+	for (y = 0; y < height; y++) {
+
+		memcpy(frame->pixels + (y * width),
+			((unsigned char*)(surface->pixels)) + (y * surface->pitch), width);
+
+	}
+
+	memcpy(frame->palette, palette, sizeof(SDL_Color) * 256);
+
+	// The display fades the frame without changing the palette, so the
+	// fade is applied to the copy
+	if ((fade->scale != F1) || fade->white) {
+
+		for (count = 0; count < 256; count++) {
+
+			frame->palette[count].r = FTOI((frame->palette[count].r * fade->scale) + (255 * fade->white));
+			frame->palette[count].g = FTOI((frame->palette[count].g * fade->scale) + (255 * fade->white));
+			frame->palette[count].b = FTOI((frame->palette[count].b * fade->scale) + (255 * fade->white));
+
+		}
+
+	}
+	frame->width = width;
+	frame->height = height;
+	frame->ticks = getTicks();
+
+	// A screenshot taken while recording is saved as well as the clip frame,
+	// so the frame is copied a second time into the next buffer
+	frame->clip = !shotWanted;
+	shotWanted = false;
+
+	// Frames are saved in the order they were shown
+	jobs.prepare(&(frame->job), save, frame, NULL, true);
+	if (lastJob) jobs.depend(&(frame->job), lastJob);
+	jobs.submit(&(frame->job));
+
+	frame->submitted = true;
+	lastJob = &(frame->job);
+
+	nextFrame = (nextFrame + 1) % CAPTURE_FRAMES;
+
+	if (!frame->clip && clipFile) grab(surface, width, height, palette, fade);
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not the next frame shown will be saved.
+ *
+ * @return Whether or not a screenshot is wanted, or a clip is being recorded
+ */
+bool Capture::isCapturing () {
+
+	return shotWanted || clipFile;
+
+}
+
+
+/**
+ * Stop any clip, and wait for every frame to be saved. Must be called before
+ * the job system stops.
+ */
+void Capture::finish () {
+
+	stopClip();
+
+	if (lastJob) jobs.wait(lastJob);
+
+	lastJob = NULL;
+
+	return;
+
+}
+
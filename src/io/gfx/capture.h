@@ -0,0 +1,110 @@
+
+/**
+ *
+ * @file capture.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created capture.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Screenshots and recorded clips. Frames are copied, with their palette, as
+ * they are shown, and saved by background jobs.
+ *
+ */
+
+
+#ifndef _CAPTURE_H
+#define _CAPTURE_H
+
+
+#include "paletteeffects.h"
+
+#include "io/file.h"
+#include "jobs.h"
+#include "OpenJazz.h"
+
+#define SDL2
+
+#ifdef SDL2
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+
+// Constants
+
+#define CAPTURE_FRAMES    4 /* Frames waiting to be saved, beyond which frames are dropped */
+#define CAPTURE_SHOT_KEY  SDLK_F12 /* Key taking a screenshot */
+#define CAPTURE_CLIP_KEY  SDLK_F11 /* Key starting and stopping a clip */
+#define CAPTURE_NAMES     1000 /* Numbered files tried for each screenshot or clip */
+#define CAPTURE_VERSION   1 /* Changed whenever the clip file's layout changes */
+
+
+// Classes
+
+class Capture;
+
+/// A copy of a shown frame, waiting to be saved
+class CaptureFrame {
+
+	public:
+		Capture*       owner; ///< The capture the frame belongs to
+		unsigned char* pixels; ///< The frame's palette indices, without padding
+		int            size; ///< Room for palette indices
+		int            width; ///< The frame's width
+		int            height; ///< The frame's height
+		unsigned int   ticks; ///< When the frame was shown
+		SDL_Color      palette[256]; ///< The palette the frame was shown with
+		bool           clip; ///< Whether the frame is part of a clip, rather than a screenshot
+		bool           submitted; ///< Whether or not the frame's job has been submitted
+		Job            job; ///< Job saving the frame
+
+};
+
+/// Screenshots and clips, saved off the main thread
+class Capture {
+
+	private:
+		CaptureFrame frames[CAPTURE_FRAMES]; ///< Frames being saved, in a ring
+		int          nextFrame; ///< The next frame in the ring to be used
+		Job*         lastJob; ///< The job saving the last frame copied, or NULL
+		File*        clipFile; ///< The clip being recorded, or NULL
+		int          nextShot; ///< The lowest number a new screenshot might take
+		int          nextClip; ///< The lowest number a new clip might take
+		int          dropped; ///< Frames not copied because every frame was still being saved
+		bool         shotWanted; ///< Whether or not the next frame shown is a screenshot
+
+		static void save (void* data);
+
+		void saveShot    (CaptureFrame* frame);
+		void saveClip    (CaptureFrame* frame);
+		void startClip   ();
+		void stopClip    ();
+
+	public:
+		Capture  ();
+		~Capture ();
+
+		void update      (SDL_Event* event);
+		void grab        (SDL_Surface* surface, int width, int height, SDL_Color* palette, PaletteFade* fade);
+		bool isCapturing ();
+		void finish      ();
+
+};
+
+
+// Variable
+
+EXTERN Capture capture; ///< Screenshots and clips
+
+#endif
+
@@ -40,6 +40,7 @@
 Font::Font (const char* fileName) {
 
 	File* file;
+	SDL_Surface* glyphs[128];
 	unsigned char* pixels;
 	unsigned char* blank;
 	int fileSize;
@@ -57,8 +58,6 @@ Font::Font (const char* fileName) {
 
 	}
 
-	storedPalette = SDL_AllocPalette(256);
-
 	fileSize = file->getSize();
 
 	nCharacters = 128;
@@ -98,15 +97,13 @@ Font::Font (const char* fileName) {
 			height += pixels[3] << 8;
 
 			if (size - 4 >= width * height)
-				characters[count] = createSurface(pixels + 4, width, height);
+				glyphs[count] = createSurface(pixels + 4, width, height);
 			else
-				characters[count] = createSurface(blank, 3, 1);
+				glyphs[count] = createSurface(blank, 3, 1);
 
 			delete[] pixels;
 
-		} else characters[count] = createSurface(blank, 3, 1);
-
-		SDL_SetColorKey(characters[count], SDL_TRUE, 0);
+		} else glyphs[count] = createSurface(blank, 3, 1);
 
 	}
 
@@ -114,6 +111,8 @@ Font::Font (const char* fileName) {
 
 	delete file;
 
+	createAtlas(glyphs, 0);
+
 
 	// Create ASCII->font map
 
@@ -165,6 +164,7 @@ Font::Font (const char* fileName) {
  */
 Font::Font (unsigned char* pixels, bool big) {
 
+	SDL_Surface* glyphs[40];
 	unsigned char* chrPixels;
 	int count, y;
 
@@ -178,9 +178,7 @@ Font::Font (unsigned char* pixels, bool big) {
 		for (y = 0; y < lineHeight; y++)
 			memcpy(chrPixels + (y * 8), pixels + (count * 8) + (y * SW), 8);
 
-		characters[count] = createSurface(chrPixels, 8, lineHeight);
-
-		if (big) SDL_SetColorKey(characters[count], SDL_TRUE, 31);
+		glyphs[count] = createSurface(chrPixels, 8, lineHeight);
 
 	}
 
@@ -188,6 +186,8 @@ Font::Font (unsigned char* pixels, bool big) {
 
 	delete[] chrPixels;
 
+	createAtlas(glyphs, big? 31: -1);
+
 
 	// Create ASCII->font map
 
@@ -231,6 +231,7 @@ Font::Font (unsigned char* pixels, bool big) {
 Font::Font (bool bonus) {
 
 	File* file;
+	SDL_Surface* glyphs[128];
 	unsigned char* pixels;
 	int fileSize;
 	int count, width, height;
@@ -293,8 +294,7 @@ Font::Font (bool bonus) {
 
 		pixels = file->loadPixels(width * height);
 
-		characters[count] = createSurface(pixels, width, height);
-		SDL_SetColorKey(characters[count], SDL_TRUE, 254);
+		glyphs[count] = createSurface(pixels, width, height);
 
 		delete[] pixels;
 
@@ -302,15 +302,14 @@ Font::Font (bool bonus) {
 
 	delete file;
 
-	lineHeight = characters[0]->h;
+	lineHeight = glyphs[0]->h;
 
 
 	// Create blank character data
 
 	pixels = new unsigned char[3];
 	memset(pixels, 254, 3);
-	characters[nCharacters] = createSurface(pixels, 3, 1);
-	SDL_SetColorKey(characters[nCharacters], SDL_TRUE, 254);
+	glyphs[nCharacters] = createSurface(pixels, 3, 1);
 	delete[] pixels;
 
 
@@ -344,6 +343,8 @@ Font::Font (bool bonus) {
 
 	nCharacters++;
 
+	createAtlas(glyphs, 254);
+
 	for (count = 0; count < 128; count++) {
 
 		if (map[count] >= nCharacters) map[count] = 0;
@@ -362,13 +363,175 @@ Font::~Font () {
 
 	int count;
 
-	for (count = 0; count < nCharacters; count++) SDL_FreeSurface(characters[count]);
+	for (count = 0; count < FONT_CACHE; count++) {
+
+		if (cache[count].surface) freeSurface(cache[count].surface);
+
+	}
+
+	freeSurface(atlas);
+	SDL_FreePalette(storedPalette);
+
+	return;
+
+}
+
+
+/**
+ * Pack the symbol images into the atlas, then delete them.
+ *
+ * @param glyphs The symbol images, of which there are nCharacters
+ * @param newKey Transparent palette index, or -1 if there is none
+ */
+void Font::createAtlas (SDL_Surface** glyphs, int newKey) {
+
+	int count, width, height, y, x;
+
+	// Find the space needed to put all the symbols side by side
+	width = 0;
+	height = 0;
+
+	for (count = 0; count < nCharacters; count++) {
+
+		width += glyphs[count]->w;
+		if (glyphs[count]->h > height) height = glyphs[count]->h;
+
+	}
+
+	atlas = createSurface(NULL, width, height);
+	video.ownSurfacePalette(atlas);
+	key = newKey;
+
+	if (key >= 0) {
+
+		SDL_FillRect(atlas, NULL, key);
+		SDL_SetColorKey(atlas, SDL_TRUE, key);
+
+	}
+
+	if (SDL_MUSTLOCK(atlas)) SDL_LockSurface(atlas);
+
+	for (x = count = 0; count < nCharacters; count++) {
+
+		characters[count].x = x;
+		characters[count].y = 0;
+		characters[count].w = glyphs[count]->w;
+		characters[count].h = glyphs[count]->h;
+
+		for (y = 0; y < glyphs[count]->h; y++)
+			memcpy(((unsigned char *)(atlas->pixels)) + (atlas->pitch * y) + x,
+				((unsigned char *)(glyphs[count]->pixels)) + (glyphs[count]->pitch * y),
+				glyphs[count]->w);
+
+		x += glyphs[count]->w;
+
+		freeSurface(glyphs[count]);
+
+	}
+
+	if (SDL_MUSTLOCK(atlas)) SDL_UnlockSurface(atlas);
+
+	storedPalette = SDL_AllocPalette(256);
+
+	for (count = 0; count < FONT_CACHE; count++) cache[count].surface = NULL;
+
+	cacheTime = 0;
 
 	return;
 
 }
 
 
+/**
+ * Get a single-line string rendered as one surface, rendering it if it is
+ * not already in the cache. The surface shares the atlas's palette, so
+ * palette changes apply to it without it having to be rendered again.
+ *
+ * @param string The string
+ * @param spacing Horizontal gap after each character
+ * @param width Receives the horizontal distance taken up by the string
+ *
+ * @return The rendered string, or NULL if the string cannot be cached
+ */
+SDL_Surface* Font::getString (const char *string, int spacing, int *width) {
+
+	FontString* entry;
+	SDL_Rect* character;
+	int count, height, x, y;
+
+	// Only single lines short enough to store, drawn with transparency, can be cached
+	if ((key < 0) || (strlen(string) >= STRING_LENGTH) || strchr(string, '\n')) return NULL;
+
+	cacheTime++;
+
+	// Look for the string, or failing that the least recently used entry
+	entry = cache;
+
+	for (count = 0; count < FONT_CACHE; count++) {
+
+		if (cache[count].surface && (cache[count].spacing == spacing) &&
+			!strcmp(cache[count].text, string)) {
+
+			cache[count].lastUsed = cacheTime;
+			*width = cache[count].width;
+
+			return cache[count].surface;
+
+		}
+
+		if (!cache[count].surface) entry = cache + count;
+		else if (entry->surface && (cache[count].lastUsed < entry->lastUsed)) entry = cache + count;
+
+	}
+
+	if (entry->surface) freeSurface(entry->surface);
+
+
+	// Render the string
+
+	*width = 0;
+	height = 1;
+
+	for (count = 0; string[count]; count++) {
+
+		character = characters + map[int(string[count])];
+
+		*width += character->w + spacing;
+		if (character->h > height) height = character->h;
+
+	}
+
+	strcpy(entry->text, string);
+	entry->spacing = spacing;
+	entry->width = *width;
+	entry->lastUsed = cacheTime;
+	entry->surface = SDL_CreateRGBSurface(0, *width? *width: 1, height, 8, 0, 0, 0, 0);
+	SDL_SetSurfacePalette(entry->surface, atlas->format->palette);
+	SDL_FillRect(entry->surface, NULL, key);
+	SDL_SetColorKey(entry->surface, SDL_TRUE, key);
+
+	if (SDL_MUSTLOCK(entry->surface)) SDL_LockSurface(entry->surface);
+
+	for (x = count = 0; string[count]; count++) {
+
+		character = characters + map[int(string[count])];
+
+		for (y = 0; y < character->h; y++)
+			memcpy(((unsigned char *)(entry->surface->pixels)) + (entry->surface->pitch * y) + x,
+				((unsigned char *)(atlas->pixels)) + (atlas->pitch * y) + character->x,
+				character->w);
+
+		x += character->w + spacing;
+
+	}
+
+	if (SDL_MUSTLOCK(entry->surface)) SDL_UnlockSurface(entry->surface);
+
+	return entry->surface;
+
+}
+
+
 /**
  * Draw a string using the font.
  *
@@ -381,10 +544,24 @@ Font::~Font () {
 int Font::showString (const char* string, int x, int y) {
 
 	SDL_Surface* surface;
+	SDL_Rect* character;
 	SDL_Rect dst;
 	unsigned int count;
 	int xOffset, yOffset;
 
+	// Draw the whole string at once if possible
+	surface = getString(string, 2, &xOffset);
+
+	if (surface) {
+
+		dst.x = x;
+		dst.y = y;
+		SDL_BlitSurface(surface, NULL, canvas, &dst);
+
+		return x + xOffset;
+
+	}
+
 	// Determine the position at which to draw the first character
 	xOffset = x;
 	yOffset = y;
@@ -403,13 +580,13 @@ int Font::showString (const char* string, int x, int y) {
 			dst.y = yOffset;
 			dst.x = xOffset;
 
-			// Determine the character's surface
-			surface = characters[int(map[int(string[count])])];
+			// Determine the character's area of the atlas
+			character = characters + map[int(string[count])];
 
 			// Draw the character to the screen
-			SDL_BlitSurface(surface, NULL, canvas, &dst);
+			SDL_BlitSurface(atlas, character, canvas, &dst);
 
-			xOffset += surface->w + 2;
+			xOffset += character->w + 2;
 
 		}
 
@@ -422,10 +599,24 @@ int Font::showString (const char* string, int x, int y) {
 int Font::showString_2(const char* string, int x, int y) {
 
 	SDL_Surface* surface;
+	SDL_Rect* character;
 	SDL_Rect dst;
 	unsigned int count;
 	int xOffset, yOffset;
 
+	// Draw the whole string at once if possible
+	surface = getString(string, 2, &xOffset);
+
+	if (surface) {
+
+		dst.x = x;
+		dst.y = y;
+		SDL_BlitSurface(surface, NULL, canvas, &dst);
+
+		return x + xOffset;
+
+	}
+
 	// Determine the position at which to draw the first character
 	xOffset = x;
 	yOffset = y;
@@ -444,13 +635,13 @@ int Font::showString_2(const char* string, int x, int y) {
 			dst.y = yOffset;
 			dst.x = xOffset;
 
-			// Determine the character's surface
-			surface = characters[int(map[int(string[count])])];
-       
+			// Determine the character's area of the atlas
+			character = characters + map[int(string[count])];
+
 			// Draw the character to the screen
-			SDL_BlitSurface(surface, NULL, canvas, &dst);
+			SDL_BlitSurface(atlas, character, canvas, &dst);
 
-			xOffset += surface->w + 2;
+			xOffset += character->w + 2;
 
 		}
 
@@ -471,7 +662,7 @@ int Font::showString_2(const char* string, int x, int y) {
  */
 int Font::showSceneString (const unsigned char* string, int x, int y) {
 
-	SDL_Surface* surface;
+	SDL_Rect* character;
 	SDL_Rect dst;
 	unsigned int count;
 	int offset;
@@ -486,14 +677,14 @@ int Font::showSceneString (const unsigned char* string, int x, int y) {
 		dst.y = y;
 		dst.x = offset;
 
-		// Determine the character's surface
-		if (string[count] < nCharacters) surface = characters[int(string[count])];
-		else surface = characters[0];
+		// Determine the character's area of the atlas
+		if (string[count] < nCharacters) character = characters + string[count];
+		else character = characters;
 
 		// Draw the character to the screen
-		SDL_BlitSurface(surface, NULL, canvas, &dst);
+		SDL_BlitSurface(atlas, character, canvas, &dst);
 
-		offset += surface->w + 1;
+		offset += character->w + 1;
 
 	}
 
@@ -514,64 +705,49 @@ int Font::showSceneString (const unsigned char* string, int x, int y) {
 void Font::showNumber (int n, int x, int y) {
 
 	SDL_Surface *surface;
+	SDL_Rect *character;
 	SDL_Rect dst;
-	int count, offset;
-
-	// n being 0 is a special case. It must not be considered to be a trailing
-	// zero, as these are not displayed.
-	if (!n) {
-
-		// Determine 0's surface
-		surface = characters[int(map[int('0')])];
-
-		// Determine 0's position on the screen
-		dst.y = y;
-		dst.x = x - surface->w;
+	char digits[STRING_LENGTH];
+	int count, offset, width, position;
 
-		// Draw 0 to the screen
-		SDL_BlitSurface(surface, NULL, canvas, &dst);
+	// Write out the number, so it can be drawn from the cache
+	offset = STRING_LENGTH - 1;
+	digits[offset] = 0;
+	count = (n > 0)? n: -n;
 
-		return;
-
-	}
+	do {
 
-	// Determine the length of the number to be drawn
-	if (n > 0) count = n;
-	else count = -n;
+		digits[--offset] = '0' + (count % 10);
+		count /= 10;
 
-	// Determine the position at which to draw the lowest digit
-	offset = x;
+	} while (count);
 
-	while (count) {
+	if (n < 0) digits[--offset] = '-';
 
-		// Determine the digit's surface
-		surface = characters[int(map['0' + (count % 10)])];
+	surface = getString(digits + offset, 0, &width);
 
-		offset -= surface->w;
+	if (surface) {
 
-		// Determine the digit's position on the screen
+		dst.x = x - width;
 		dst.y = y;
-		dst.x = offset;
-
-		// Draw the digit to the screen
 		SDL_BlitSurface(surface, NULL, canvas, &dst);
 
-		count /= 10;
+		return;
 
 	}
 
-	// If needed, draw the negative sign
-	if (n < 0) {
+	// Otherwise draw the characters one by one, from right to left
+	position = x;
 
-		// Determine the negative sign's surface
-		surface = characters[int(map[int('-')])];
+	for (count = STRING_LENGTH - 2; count >= offset; count--) {
 
-		// Determine the negative sign's position on the screen
-		dst.y = y;
-		dst.x = offset - surface->w;
+		character = characters + map[int(digits[count])];
 
-		// Draw the negative sign to the screen
-		SDL_BlitSurface(surface, NULL, canvas, &dst);
+		position -= character->w;
+
+		dst.x = position;
+		dst.y = y;
+		SDL_BlitSurface(atlas, character, canvas, &dst);
 
 	}
 
@@ -590,7 +766,7 @@ void Font::showNumber (int n, int x, int y) {
  */
 void Font::mapPalette (int start, int length, int newStart, int newLength) {
 
-	SDL_SetPaletteColors(storedPalette, characters[0]->format->palette->colors, 0, 256);
+	SDL_SetPaletteColors(storedPalette, atlas->format->palette->colors, 0, 256);
 
 	SDL_Color palette[256];
 	int count;
@@ -599,8 +775,8 @@ void Font::mapPalette (int start, int length, int newStart, int newLength) {
 		palette[count].r = palette[count].g = palette[count].b =
 			(count * newLength / length) + newStart;
 
-	for (count = 0; count < nCharacters; count++)
-		SDL_SetPaletteColors(characters[count]->format->palette, palette, start, length);
+	SDL_SetPaletteColors(atlas->format->palette, palette, start, length);
+	video.forgetSurfacePalette(atlas);
 
 	return;
 
@@ -612,19 +788,34 @@ void Font::mapPalette (int start, int length, int newStart, int newLength) {
  */
 void Font::restorePalette () {
 
-	int count;
-
-	for (count = 0; count < nCharacters; count++)
-		SDL_SetPaletteColors(characters[count]->format->palette, storedPalette->colors, 0, 256);
+	SDL_SetPaletteColors(atlas->format->palette, storedPalette->colors, 0, 256);
+	video.forgetSurfacePalette(atlas);
 
 	return;
 
 }
 
-void Font::setPalette(SDL_Color *colors)
-{
-	for (int index = 0; index < nCharacters; index++)
-		SDL_SetPaletteColors(characters[index]->format->palette, colors, 0, 256);
+/**
+ * Set the palette of every character.
+ *
+ * @param colors The new palette
+ */
+void Font::setPalette (SDL_Color *colors) {
+
+	// Matching the canvas only needs doing when its palette has changed
+	if (colors == canvas->format->palette->colors) {
+
+		video.syncSurfacePalette(atlas);
+
+		return;
+
+	}
+
+	SDL_SetPaletteColors(atlas->format->palette, colors, 0, 256);
+	video.forgetSurfacePalette(atlas);
+
+	return;
+
 }
 
 
@@ -658,7 +849,7 @@ int Font::getStringWidth (const char *string) {
 		// Only get the width of the first line
 		if (string[count] == '\n') return stringWidth;
 
-		stringWidth += characters[int(map[int(string[count])])]->w + 2;
+		stringWidth += characters[int(map[int(string[count])])].w + 2;
 
 	}
 
@@ -682,8 +873,8 @@ int Font::getSceneStringWidth (const unsigned char *string) {
 	// Go through each character of the string
 	for (count = 0; string[count]; count++) {
 
-		if (string[count] < nCharacters) stringWidth += characters[int(string[count])]->w + 1;
-		else stringWidth += characters[0]->w + 1;
+		if (string[count] < nCharacters) stringWidth += characters[int(string[count])].w + 1;
+		else stringWidth += characters[0].w + 1;
 
 	}
 
@@ -692,3 +883,39 @@ int Font::getSceneStringWidth (const unsigned char *string) {
 }
 
 
+/**
+ * Load the two fonts found in the panel, unless they have already been loaded.
+ * They are only needed once a level is played.
+ *
+ * @return Error code
+ */
+int loadPanelFonts () {
+
+	File* file;
+	unsigned char* pixels;
+
+	if (panelBigFont) return E_NONE;
+
+	try {
+
+		file = new File("PANEL.000", false);
+
+	} catch (int e) {
+
+		return e;
+
+	}
+
+	pixels = file->loadRLE(46272);
+
+	delete file;
+
+	panelBigFont = new Font(pixels + (40 * 320), true);
+	panelSmallFont = new Font(pixels + (48 * 320), false);
+
+	delete[] pixels;
+
+	return E_NONE;
+
+}
+
@@ -33,6 +33,25 @@
 #endif
 
 
+// Constants
+
+#define FONT_CACHE 16 /* Number of rendered strings each font keeps */
+
+
+// Datatype
+
+/// String rendered by a font, ready to be drawn again
+typedef struct {
+
+	char          text[STRING_LENGTH]; ///< The string
+	int           spacing; ///< Horizontal gap after each character
+	int           width; ///< Horizontal distance taken up by the string
+	SDL_Surface*  surface; ///< The rendered string, or NULL if the entry is unused
+	unsigned int  lastUsed; ///< When the string was last drawn
+
+} FontString;
+
+
 // Classes
 
 class File;
@@ -41,11 +60,18 @@ class File;
 class Font {
 
 	private:
-		SDL_Surface   *characters[128]; ///< Symbol images
+		SDL_Surface   *atlas; ///< Every symbol's image, side by side
+		SDL_Rect       characters[128]; ///< Each symbol's area of the atlas
 		int            nCharacters; ///< Number of symbols
+		int            key; ///< Transparent palette index, or -1 if there is none
 		unsigned char  lineHeight; ///< Vertical spacing of displayed characters
 		char           map[128]; ///< Maps ASCII values to symbol indices
 		SDL_Palette   *storedPalette;
+		FontString     cache[FONT_CACHE]; ///< Recently drawn strings
+		unsigned int   cacheTime; ///< Number of times a string has been drawn from the cache
+
+		void         createAtlas (SDL_Surface** glyphs, int newKey);
+		SDL_Surface* getString   (const char *string, int spacing, int *width);
 
 	public:
 		Font                     (const char *fileName);
@@ -77,5 +103,10 @@ EXTERN Font *fontmn2;        /** Taken from .0FN file name */
 EXTERN Font *panelBigFont;   /** Found in PANEL.000 */
 EXTERN Font *panelSmallFont; /** Found in PANEL.000 */\
 
+
+// Function
+
+EXTERN int loadPanelFonts ();
+
 #endif
 
@@ -27,11 +27,13 @@
 #include "jj1level/jj1level.h"
 #include "jj2level/jj2level.h"
 #include "level/levelplayer.h"
+#include "level/rewind.h"
 #include "player/player.h"
 
 #include <string.h>
 
 
+
 /**
  * Create a new palette effect.
  *
@@ -41,6 +43,21 @@ PaletteEffect::PaletteEffect (PaletteEffect* nextPE) {
 
 	next = nextPE;
 
+	// Flatten the chain, so it can be applied without recursion
+	chainLength = next? next->chainLength + 1: 1;
+	chain = new PaletteEffect *[chainLength];
+
+	if (next) memcpy(chain, next->chain, sizeof(PaletteEffect *) * next->chainLength);
+
+	chain[chainLength - 1] = this;
+
+	// The cache is only created if this effect is at the head of a chain
+	states = NULL;
+	cachedInput = NULL;
+	cachedOutput = NULL;
+	cachedPalette = NULL;
+	cachedEffects = 0;
+
 	return;
 
 }
@@ -53,23 +70,202 @@ PaletteEffect::~PaletteEffect () {
 
 	if (next) delete next;
 
+	delete[] chain;
+
+	if (states) {
+
+		delete[] states;
+		delete[] cachedInput;
+		delete[] cachedOutput;
+
+	}
+
 	return;
 
 }
 
 
 /**
- * Apply the palette effect.
+ * Get a value which changes whenever the effect's output would change, given
+ * the same input.
+ *
+ * @return The effect's state
+ */
+int PaletteEffect::getState () {
+
+	return 0;
+
+}
+
+
+/**
+ * Apply this effect alone.
+ *
+ * @param shownPalette The palette the effect will be applied to
+ * @param direct Whether or not to apply the effect directly
+ */
+void PaletteEffect::transform (SDL_Color* shownPalette, bool direct) {
+
+	return;
+
+}
+
+
+/**
+ * Advance this effect alone.
+ *
+ * @param mspf Ticks per frame
+ */
+void PaletteEffect::advance (int mspf) {
+
+	return;
+
+}
+
+
+/**
+ * Add this effect alone's progress to a level's state.
+ *
+ * @param rewind The level's state
+ */
+void PaletteEffect::addState (Rewind* rewind) {
+
+	(void)rewind;
+
+	return;
+
+}
+
+
+/**
+ * Find the fade this effect alone makes, if it changes every colour in the
+ * same way.
+ *
+ * @param fade Variable to receive the fade
+ *
+ * @return Whether or not the effect is a fade
+ */
+bool PaletteEffect::getFade (PaletteFade* fade) {
+
+	(void)fade;
+
+	return false;
+
+}
+
+
+/**
+ * Apply the palette effect, and those following it.
  *
  * @param shownPalette The palette the effect will be applied to
  * @param direct Whether or not to apply the effect directly
  * @param mspf Ticks per frame
  * @param isStatic Whether the effect should advance after applying
+ * @param fade If not NULL, variable to receive a fade left to be applied as
+ * the frame is presented
  */
-void PaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic) {
+void PaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic, PaletteFade* fade) {
+
+	int count, state, effects;
+	bool cached;
+
+	// A fade applied last can be left to the display, so fading neither
+	// changes the palette nor empties the cache
+	effects = chainLength;
+
+	if (fade) {
+
+		if (!direct && chain[chainLength - 1]->getFade(fade)) {
+
+			effects--;
+
+		} else {
+
+			fade->scale = F1;
+			fade->white = 0;
+
+		}
+
+	}
+
+	if (direct) {
 
-	// Apply the next palette effect
-	if (next) next->apply(shownPalette, direct, mspf, isStatic);
+		// Each effect changes the display palette itself, so nothing can be cached
+		for (count = 0; count < chainLength; count++)
+			chain[count]->transform(shownPalette, true);
+
+	} else {
+
+		// Use the last result if neither the input nor any effect has changed
+		if (states) {
+
+			cached = (cachedPalette == video.getPalette()) && (cachedEffects == effects) &&
+				!memcmp(cachedInput, shownPalette, sizeof(SDL_Color) * 256);
+
+		} else {
+
+			states = new int[chainLength];
+			cachedInput = new SDL_Color[256];
+			cachedOutput = new SDL_Color[256];
+			cached = false;
+
+		}
+
+		for (count = 0; count < effects; count++) {
+
+			state = chain[count]->getState();
+
+			if (!cached || (state != states[count])) {
+
+				states[count] = state;
+				cached = false;
+
+			}
+
+		}
+
+		if (cached) {
+
+			memcpy(shownPalette, cachedOutput, sizeof(SDL_Color) * 256);
+
+		} else {
+
+			memcpy(cachedInput, shownPalette, sizeof(SDL_Color) * 256);
+			cachedPalette = video.getPalette();
+			cachedEffects = effects;
+
+			for (count = 0; count < effects; count++)
+				chain[count]->transform(shownPalette, false);
+
+			memcpy(cachedOutput, shownPalette, sizeof(SDL_Color) * 256);
+
+		}
+
+	}
+
+	if (!isStatic) {
+
+		for (count = 0; count < chainLength; count++)
+			chain[count]->advance(mspf);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Add the progress of this and all following effects to a level's state, so
+ * that they are saved and loaded with it.
+ *
+ * @param rewind The level's state
+ */
+void PaletteEffect::addTo (Rewind* rewind) {
+
+	int count;
+
+	for (count = 0; count < chainLength; count++) chain[count]->addState(rewind);
 
 	return;
 
@@ -94,26 +290,34 @@ WhiteInPaletteEffect::WhiteInPaletteEffect
 
 
 /**
- * Apply the palette effect.
+ * Get a value which changes whenever the effect's output would change.
+ *
+ * @return The effect's state
+ */
+int WhiteInPaletteEffect::getState () {
+
+	if (whiteness > F1) return F1 + 1;
+	if (whiteness < 0) return 0;
+
+	return whiteness;
+
+}
+
+
+/**
+ * Apply this effect alone.
  *
  * @param shownPalette The palette the effect will be applied to
  * @param direct Whether or not to apply the effect directly
- * @param mspf Ticks per frame
- * @param isStatic Whether the effect should advance after applying
  */
-void WhiteInPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic) {
+void WhiteInPaletteEffect::transform (SDL_Color* shownPalette, bool direct) {
 
 	int count;
 
-	// Apply the next palette effect
-	if (next) next->apply(shownPalette, direct, mspf, isStatic);
-
 	if (whiteness > F1) {
 
 		memset(shownPalette, 255, sizeof(SDL_Color) * 256);
 
-		if (!isStatic) whiteness -= ITOF(mspf) / duration;
-
 	} else if (whiteness > 0) {
 
 		for (count = 0; count < 256; count++) {
@@ -127,8 +331,6 @@ void WhiteInPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf
 
 		}
 
-		if (!isStatic) whiteness -= ITOF(mspf) / duration;
-
 	}
 
 	if (direct) video.changePalette(shownPalette, 0, 256);
@@ -138,6 +340,54 @@ void WhiteInPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf
 }
 
 
+/**
+ * Advance this effect alone.
+ *
+ * @param mspf Ticks per frame
+ */
+void WhiteInPaletteEffect::advance (int mspf) {
+
+	if (whiteness > 0) whiteness -= ITOF(mspf) / duration;
+
+	return;
+
+}
+
+
+/**
+ * Add the effect's progress to a level's state.
+ *
+ * @param rewind The level's state
+ */
+void WhiteInPaletteEffect::addState (Rewind* rewind) {
+
+	rewind->add(&whiteness, sizeof(whiteness));
+
+	return;
+
+}
+
+
+/**
+ * Find the fade the effect makes.
+ *
+ * @param fade Variable to receive the fade
+ *
+ * @return Whether or not the effect is a fade, which it always is
+ */
+bool WhiteInPaletteEffect::getFade (PaletteFade* fade) {
+
+	if (whiteness > F1) fade->white = F1;
+	else if (whiteness > 0) fade->white = whiteness;
+	else fade->white = 0;
+
+	fade->scale = F1 - fade->white;
+
+	return true;
+
+}
+
+
 /**
  * Create a new fade-in palette effect.
  *
@@ -156,27 +406,34 @@ FadeInPaletteEffect::FadeInPaletteEffect
 
 
 /**
- * Apply the palette effect.
+ * Get a value which changes whenever the effect's output would change.
+ *
+ * @return The effect's state
+ */
+int FadeInPaletteEffect::getState () {
+
+	if (blackness > F1) return F1 + 1;
+	if (blackness < 0) return 0;
+
+	return blackness;
+
+}
+
+
+/**
+ * Apply this effect alone.
  *
  * @param shownPalette The palette the effect will be applied to
  * @param direct Whether or not to apply the effect directly
- * @param mspf Ticks per frame
- * @param isStatic Whether the effect should advance after applying
  */
-void FadeInPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic) {
+void FadeInPaletteEffect::transform (SDL_Color* shownPalette, bool direct) {
 
 	int count;
 
-	// Apply the next palette effect
-	if (next) next->apply(shownPalette, direct, mspf, isStatic);
-
-
 	if (blackness > F1) {
 
 		memset(shownPalette, 0, sizeof(SDL_Color) * 256);
 
-		if (!isStatic) blackness -= ITOF(mspf) / duration;
-
 	} else if (blackness > 0) {
 
 		for (count = 0; count < 256; count++) {
@@ -190,8 +447,6 @@ void FadeInPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf,
 
 		}
 
-		if (!isStatic) blackness -= ITOF(mspf) / duration;
-
 	}
 
 	if (direct) video.changePalette(shownPalette, 0, 256);
@@ -201,6 +456,54 @@ void FadeInPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf,
 }
 
 
+/**
+ * Advance this effect alone.
+ *
+ * @param mspf Ticks per frame
+ */
+void FadeInPaletteEffect::advance (int mspf) {
+
+	if (blackness > 0) blackness -= ITOF(mspf) / duration;
+
+	return;
+
+}
+
+
+/**
+ * Add the effect's progress to a level's state.
+ *
+ * @param rewind The level's state
+ */
+void FadeInPaletteEffect::addState (Rewind* rewind) {
+
+	rewind->add(&blackness, sizeof(blackness));
+
+	return;
+
+}
+
+
+/**
+ * Find the fade the effect makes.
+ *
+ * @param fade Variable to receive the fade
+ *
+ * @return Whether or not the effect is a fade, which it always is
+ */
+bool FadeInPaletteEffect::getFade (PaletteFade* fade) {
+
+	if (blackness > F1) fade->scale = 0;
+	else if (blackness > 0) fade->scale = F1 - blackness;
+	else fade->scale = F1;
+
+	fade->white = 0;
+
+	return true;
+
+}
+
+
 /**
  * Create a new white-out palette effect.
  *
@@ -219,43 +522,47 @@ WhiteOutPaletteEffect::WhiteOutPaletteEffect
 
 
 /**
- * Apply the palette effect.
+ * Get a value which changes whenever the effect's output would change.
+ *
+ * @return The effect's state
+ */
+int WhiteOutPaletteEffect::getState () {
+
+	if (whiteness > F1) return F1 + 1;
+	if (whiteness < 0) return 0;
+
+	return whiteness;
+
+}
+
+
+/**
+ * Apply this effect alone.
  *
  * @param shownPalette The palette the effect will be applied to
  * @param direct Whether or not to apply the effect directly
- * @param mspf Ticks per frame
- * @param isStatic Whether the effect should advance after applying
  */
-void WhiteOutPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic) {
+void WhiteOutPaletteEffect::transform (SDL_Color* shownPalette, bool direct) {
 
 	int count;
 
-	// Apply the next palette effect
-	if (next) next->apply(shownPalette, direct, mspf, isStatic);
-
-
 	if (whiteness > F1) {
 
 		memset(shownPalette, 255, sizeof(SDL_Color) * 256);
 
-	} else {
-
-		if (whiteness > 0) {
+	} else if (whiteness > 0) {
 
-			for (count = 0; count < 256; count++) {
+		for (count = 0; count < 256; count++) {
 
-				shownPalette[count].r = 255 -
-					FTOI((255 - shownPalette[count].r) * (F1 - whiteness));
-				shownPalette[count].g = 255 -
-					FTOI((255 - shownPalette[count].g) * (F1 - whiteness));
-				shownPalette[count].b = 255 -
-					FTOI((255 - shownPalette[count].b) * (F1 - whiteness));
+			shownPalette[count].r = 255 -
+				FTOI((255 - shownPalette[count].r) * (F1 - whiteness));
+			shownPalette[count].g = 255 -
+				FTOI((255 - shownPalette[count].g) * (F1 - whiteness));
+			shownPalette[count].b = 255 -
+				FTOI((255 - shownPalette[count].b) * (F1 - whiteness));
 
-			}
 		}
 
-		if (!isStatic) whiteness += ITOF(mspf) / duration;
-
 	}
 
 	if (direct) video.changePalette(shownPalette, 0, 256);
@@ -265,6 +572,54 @@ void WhiteOutPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int msp
 }
 
 
+/**
+ * Advance this effect alone.
+ *
+ * @param mspf Ticks per frame
+ */
+void WhiteOutPaletteEffect::advance (int mspf) {
+
+	if (whiteness <= F1) whiteness += ITOF(mspf) / duration;
+
+	return;
+
+}
+
+
+/**
+ * Add the effect's progress to a level's state.
+ *
+ * @param rewind The level's state
+ */
+void WhiteOutPaletteEffect::addState (Rewind* rewind) {
+
+	rewind->add(&whiteness, sizeof(whiteness));
+
+	return;
+
+}
+
+
+/**
+ * Find the fade the effect makes.
+ *
+ * @param fade Variable to receive the fade
+ *
+ * @return Whether or not the effect is a fade, which it always is
+ */
+bool WhiteOutPaletteEffect::getFade (PaletteFade* fade) {
+
+	if (whiteness > F1) fade->white = F1;
+	else if (whiteness > 0) fade->white = whiteness;
+	else fade->white = 0;
+
+	fade->scale = F1 - fade->white;
+
+	return true;
+
+}
+
+
 /**
  * Create a new fade-out palette effect.
  *
@@ -283,43 +638,47 @@ FadeOutPaletteEffect::FadeOutPaletteEffect
 
 
 /**
- * Apply the palette effect.
+ * Get a value which changes whenever the effect's output would change.
+ *
+ * @return The effect's state
+ */
+int FadeOutPaletteEffect::getState () {
+
+	if (blackness > F1) return F1 + 1;
+	if (blackness < 0) return 0;
+
+	return blackness;
+
+}
+
+
+/**
+ * Apply this effect alone.
  *
  * @param shownPalette The palette the effect will be applied to
  * @param direct Whether or not to apply the effect directly
- * @param mspf Ticks per frame
- * @param isStatic Whether the effect should advance after applying
  */
-void FadeOutPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic) {
+void FadeOutPaletteEffect::transform (SDL_Color* shownPalette, bool direct) {
 
 	int count;
 
-	// Apply the next palette effect
-	if (next) next->apply(shownPalette, direct, mspf, isStatic);
-
 	if (blackness > F1) {
 
 		memset(shownPalette, 0, sizeof(SDL_Color) * 256);
 
-	} else {
-
-		if (blackness > 0) {
-
-			for (count = 0; count < 256; count++) {
+	} else if (blackness > 0) {
 
-				shownPalette[count].r =
-					FTOI(shownPalette[count].r * (F1 - blackness));
-				shownPalette[count].g =
-					FTOI(shownPalette[count].g * (F1 - blackness));
-				shownPalette[count].b =
-					FTOI(shownPalette[count].b * (F1 - blackness));
+		for (count = 0; count < 256; count++) {
 
-			}
+			shownPalette[count].r =
+				FTOI(shownPalette[count].r * (F1 - blackness));
+			shownPalette[count].g =
+				FTOI(shownPalette[count].g * (F1 - blackness));
+			shownPalette[count].b =
+				FTOI(shownPalette[count].b * (F1 - blackness));
 
 		}
 
-		if (!isStatic) blackness += ITOF(mspf) / duration;
-
 	}
 
 	if (direct) video.changePalette(shownPalette, 0, 256);
@@ -329,6 +688,54 @@ void FadeOutPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf
 }
 
 
+/**
+ * Advance this effect alone.
+ *
+ * @param mspf Ticks per frame
+ */
+void FadeOutPaletteEffect::advance (int mspf) {
+
+	if (blackness <= F1) blackness += ITOF(mspf) / duration;
+
+	return;
+
+}
+
+
+/**
+ * Add the effect's progress to a level's state.
+ *
+ * @param rewind The level's state
+ */
+void FadeOutPaletteEffect::addState (Rewind* rewind) {
+
+	rewind->add(&blackness, sizeof(blackness));
+
+	return;
+
+}
+
+
+/**
+ * Find the fade the effect makes.
+ *
+ * @param fade Variable to receive the fade
+ *
+ * @return Whether or not the effect is a fade, which it always is
+ */
+bool FadeOutPaletteEffect::getFade (PaletteFade* fade) {
+
+	if (blackness > F1) fade->scale = 0;
+	else if (blackness > 0) fade->scale = F1 - blackness;
+	else fade->scale = F1;
+
+	fade->white = 0;
+
+	return true;
+
+}
+
+
 /**
  * Create a new flash-to-colour palette effect.
  *
@@ -355,20 +762,29 @@ FlashPaletteEffect::FlashPaletteEffect
 
 
 /**
- * Apply the palette effect.
+ * Get a value which changes whenever the effect's output would change.
+ *
+ * @return The effect's state
+ */
+int FlashPaletteEffect::getState () {
+
+	if (progress >= F1) return F1;
+
+	return progress;
+
+}
+
+
+/**
+ * Apply this effect alone.
  *
  * @param shownPalette The palette the effect will be applied to
  * @param direct Whether or not to apply the effect directly
- * @param mspf Ticks per frame
- * @param isStatic Whether the effect should advance after applying
  */
-void FlashPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic) {
+void FlashPaletteEffect::transform (SDL_Color* shownPalette, bool direct) {
 
 	int count;
 
-	// Apply the next palette effect
-	if (next) next->apply(shownPalette, direct, mspf, isStatic);
-
 	if (progress < 0) {
 
 		for (count = 0; count < 256; count++) {
@@ -382,8 +798,6 @@ void FlashPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf,
 
 		}
 
-		if (!isStatic) progress += ITOF(mspf) / duration;
-
 	} else if (progress < F1) {
 
 		for (count = 0; count < 256; count++) {
@@ -397,8 +811,6 @@ void FlashPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf,
 
 		}
 
-		if (!isStatic) progress += ITOF(mspf) / duration;
-
 	}
 
 	if (direct) video.changePalette(shownPalette, 0, 256);
@@ -408,6 +820,34 @@ void FlashPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf,
 }
 
 
+/**
+ * Advance this effect alone.
+ *
+ * @param mspf Ticks per frame
+ */
+void FlashPaletteEffect::advance (int mspf) {
+
+	if (progress < F1) progress += ITOF(mspf) / duration;
+
+	return;
+
+}
+
+
+/**
+ * Add the effect's progress to a level's state.
+ *
+ * @param rewind The level's state
+ */
+void FlashPaletteEffect::addState (Rewind* rewind) {
+
+	rewind->add(&progress, sizeof(progress));
+
+	return;
+
+}
+
+
 /**
  * Create a new colour rotation palette effect.
  *
@@ -431,21 +871,28 @@ RotatePaletteEffect::RotatePaletteEffect
 
 
 /**
- * Apply the palette effect.
+ * Get a value which changes whenever the effect's output would change.
+ *
+ * @return The effect's state
+ */
+int RotatePaletteEffect::getState () {
+
+	return FTOI(position);
+
+}
+
+
+/**
+ * Apply this effect alone.
  *
  * @param shownPalette The palette the effect will be applied to
  * @param direct Whether or not to apply the effect directly
- * @param mspf Ticks per frame
- * @param isStatic Whether the effect should advance after applying
  */
-void RotatePaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic) {
+void RotatePaletteEffect::transform (SDL_Color* shownPalette, bool direct) {
 
 	SDL_Color* currentPalette;
 	int count;
 
-	// Apply the next palette effect
-	if (next) next->apply(shownPalette, direct, mspf, isStatic);
-
 	currentPalette = video.getPalette();
 
 	for (count = 0; count < amount; count++) {
@@ -456,14 +903,36 @@ void RotatePaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf,
 
 	}
 
-	if (!isStatic) {
+	if (direct) video.changePalette(shownPalette + first, first, amount);
 
-		position -= (mspf * speed) >> 10;
-		while (position < 0) position += ITOF(amount);
+	return;
 
-	}
+}
 
-	if (direct) video.changePalette(shownPalette + first, first, amount);
+
+/**
+ * Advance this effect alone.
+ *
+ * @param mspf Ticks per frame
+ */
+void RotatePaletteEffect::advance (int mspf) {
+
+	position -= (mspf * speed) >> 10;
+	while (position < 0) position += ITOF(amount);
+
+	return;
+
+}
+
+
+/**
+ * Add the effect's progress to a level's state.
+ *
+ * @param rewind The level's state
+ */
+void RotatePaletteEffect::addState (Rewind* rewind) {
+
+	rewind->add(&position, sizeof(position));
 
 	return;
 
@@ -495,23 +964,34 @@ SkyPaletteEffect::SkyPaletteEffect
 
 
 /**
- * Apply the palette effect.
+ * Get a value which changes whenever the effect's output would change. This
+ * is the offset into the sky palette.
  *
- * @param shownPalette The palette the effect will be applied to
- * @param direct Whether or not to apply the effect directly
- * @param mspf Ticks per frame
- * @param isStatic Whether the effect should advance after applying
+ * @return The effect's state
  */
-void SkyPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic) {
-
-	int position, count, y;
+int SkyPaletteEffect::getState () {
 
-	// Apply the next palette effect
-	if (next) next->apply(shownPalette, direct, mspf, isStatic);
+	int position, y;
 
 	position = viewY + ((canvasH - 33) << 9) - F4;
 	y = ((canvasH - 34) / 100) + 1;
-	count = (((position * speed) / y) >> 20) % 255;
+
+	return (((position * speed) / y) >> 20) % 255;
+
+}
+
+
+/**
+ * Apply this effect alone.
+ *
+ * @param shownPalette The palette the effect will be applied to
+ * @param direct Whether or not to apply the effect directly
+ */
+void SkyPaletteEffect::transform (SDL_Color* shownPalette, bool direct) {
+
+	int count;
+
+	count = getState();
 
 	if (direct) {
 
@@ -571,21 +1051,33 @@ P2DPaletteEffect::P2DPaletteEffect
 
 
 /**
- * Apply the palette effect.
+ * Get a value which changes whenever the effect's output would change.
+ *
+ * @return The effect's state
+ */
+int P2DPaletteEffect::getState () {
+
+	int x, y;
+
+	x = FTOI(((256 * 32) - FTOI(viewX)) * speed);
+	y = FTOI(((64 * 32) - FTOI(viewY)) * speed);
+
+	return ((x % 8) << 4) + (y % 8);
+
+}
+
+
+/**
+ * Apply this effect alone.
  *
  * @param shownPalette The palette the effect will be applied to
  * @param direct Whether or not to apply the effect directly
- * @param mspf Ticks per frame
- * @param isStatic Whether the effect should advance after applying
  */
-void P2DPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic) {
+void P2DPaletteEffect::transform (SDL_Color* shownPalette, bool direct) {
 
 	SDL_Color* currentPalette;
 	int count, x, y, j;
 
-	// Apply the next palette effect
-	if (next) next->apply(shownPalette, direct, mspf, isStatic);
-
 	currentPalette = video.getPalette();
 	x = FTOI(((256 * 32) - FTOI(viewX)) * speed);
 	y = FTOI(((64 * 32) - FTOI(viewY)) * speed);
@@ -631,30 +1123,36 @@ P1DPaletteEffect::P1DPaletteEffect
 
 
 /**
- * Apply the palette effect.
+ * Get a value which changes whenever the effect's output would change. This
+ * is the rotation of the affected colours.
+ *
+ * @return The effect's state
+ */
+int P1DPaletteEffect::getState () {
+
+	return FTOI(MUL(viewX + viewY, speed)) % amount;
+
+}
+
+
+/**
+ * Apply this effect alone.
  *
  * @param shownPalette The palette the effect will be applied to
  * @param direct Whether or not to apply the effect directly
- * @param mspf Ticks per frame
- * @param isStatic Whether the effect should advance after applying
  */
-void P1DPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic) {
+void P1DPaletteEffect::transform (SDL_Color* shownPalette, bool direct) {
 
 	SDL_Color* currentPalette;
-	fixed position;
-	int count;
-
-	// Apply the next palette effect
-	if (next) next->apply(shownPalette, direct, mspf, isStatic);
+	int rotation, count;
 
 	currentPalette = video.getPalette();
-	position = viewX + viewY;
+	rotation = getState();
 
 	for (count = 0; count < amount; count++) {
 
 		memcpy(shownPalette + first + count,
-			currentPalette + first + ((count +
-				(amount - 1 - (FTOI(MUL(position, speed)) % amount))) % amount),
+			currentPalette + first + ((count + (amount - 1 - rotation)) % amount),
 			sizeof(SDL_Color));
 
 	}
@@ -683,39 +1181,57 @@ WaterPaletteEffect::WaterPaletteEffect (fixed newDepth, PaletteEffect* nextPE)
 
 
 /**
- * Apply the palette effect.
+ * Get a value which changes whenever the effect's output would change. This
+ * is how dark the palette is made by the local player's depth below the water
+ * surface: 0 above the surface, then from 1 up to F1 + 1 for total darkness.
+ * Depths which darken the palette equally share a state, so moving within
+ * the water only changes the palette when it changes the darkness.
+ *
+ * @return The effect's state
+ */
+int WaterPaletteEffect::getState () {
+
+	int position;
+
+	if (level) position = localPlayer->getLevelPlayer()->getY() - level->getWaterLevel();
+	else if (jj2Level) position = localPlayer->getLevelPlayer()->getY() - jj2Level->getWaterLevel();
+	else return 0;
+
+	if (position <= 0) return 0;
+	if (position >= depth) return F1 + 1;
+
+	return DIV(position, depth) + 1;
+
+}
+
+
+/**
+ * Apply this effect alone.
  *
  * @param shownPalette The palette the effect will be applied to
  * @param direct Whether or not to apply the effect directly
- * @param mspf Ticks per frame
- * @param isStatic Whether the effect should advance after applying
  */
-void WaterPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic) {
+void WaterPaletteEffect::transform (SDL_Color* shownPalette, bool direct) {
 
 	SDL_Color* currentPalette;
-	int position, count;
-
-	// Apply the next palette effect
-	if (next) next->apply(shownPalette, direct, mspf, isStatic);
+	int darkness, brightness, count;
 
 	currentPalette = video.getPalette();
 
-	if (level) position = localPlayer->getLevelPlayer()->getY() - level->getWaterLevel();
-	else if (jj2Level) position = localPlayer->getLevelPlayer()->getY() - jj2Level->getWaterLevel();
-	else return;
+	darkness = getState();
+
+	if (!darkness) return;
 
-	if (position <= 0) return;
+	if (darkness <= F1) {
 
-	if (position < depth) {
+		// The same for every colour, so found once
+		brightness = F1 - darkness;
 
 		for (count = 0; count < 256; count++) {
 
-			shownPalette[count].r = FTOI(currentPalette[count].r *
-				(1023 - DIV(position, depth)));
-			shownPalette[count].g = FTOI(currentPalette[count].g *
-				(1023 - DIV(position, depth)));
-			shownPalette[count].b = FTOI(currentPalette[count].b *
-				(1023 - DIV(position, depth)));
+			shownPalette[count].r = FTOI(currentPalette[count].r * brightness);
+			shownPalette[count].g = FTOI(currentPalette[count].g * brightness);
+			shownPalette[count].b = FTOI(currentPalette[count].b * brightness);
 
 		}
 
@@ -726,3 +1242,4 @@ void WaterPaletteEffect::apply (SDL_Color* shownPalette, bool direct, int mspf,
 	return;
 
 }
+
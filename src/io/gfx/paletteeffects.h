@@ -46,19 +46,49 @@
 #define PE_WATER  11 /* The deeper below water, the darker it gets */
 
 
-// Class
+// Datatype
+
+/// A fade left to be applied as the frame is presented, rather than to the
+/// palette. Each colour becomes colour * scale + 255 * white.
+typedef struct {
+
+	fixed scale; ///< Proportion of each colour kept
+	fixed white; ///< Proportion of white added
+
+} PaletteFade;
+
+
+// Classes
+
+class Rewind;
 
 /// Palette effect base class
 class PaletteEffect {
 
+	private:
+		PaletteEffect** chain; ///< This and all following effects, in the order they are applied
+		int             chainLength; ///< Number of effects in the chain
+		int*            states; ///< Each effect's state when the cached palettes were made
+		SDL_Color*      cachedInput; ///< Palette the effects were last applied to
+		SDL_Color*      cachedOutput; ///< Result of last applying the effects
+		SDL_Color*      cachedPalette; ///< Display palette when the effects were last applied
+		int             cachedEffects; ///< Number of effects applied to the cached palettes
+
 	protected:
 		PaletteEffect* next; ///< Next effect to use
 
+		virtual int  getState  ();
+		virtual void transform (SDL_Color* shownPalette, bool direct);
+		virtual void advance   (int mspf);
+		virtual void addState  (Rewind* rewind);
+		virtual bool getFade   (PaletteFade* fade);
+
 	public:
 		PaletteEffect          (PaletteEffect* nextPE);
 		virtual ~PaletteEffect ();
 
-		virtual void apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic);
+		void apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic, PaletteFade* fade = NULL);
+		void addTo (Rewind* rewind);
 
 };
 
@@ -72,7 +102,11 @@ class WhiteInPaletteEffect : public PaletteEffect {
 	public:
 		WhiteInPaletteEffect (int newDuration, PaletteEffect* nextPE);
 
-		void apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic);
+		int  getState  ();
+		void transform (SDL_Color* shownPalette, bool direct);
+		void advance   (int mspf);
+		void addState  (Rewind* rewind);
+		bool getFade   (PaletteFade* fade);
 
 };
 
@@ -86,7 +120,11 @@ class FadeInPaletteEffect : public PaletteEffect {
 	public:
 		FadeInPaletteEffect (int newDuration, PaletteEffect* nextPE);
 
-		void apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic);
+		int  getState  ();
+		void transform (SDL_Color* shownPalette, bool direct);
+		void advance   (int mspf);
+		void addState  (Rewind* rewind);
+		bool getFade   (PaletteFade* fade);
 
 };
 
@@ -100,7 +138,11 @@ class WhiteOutPaletteEffect : public PaletteEffect {
 	public:
 		WhiteOutPaletteEffect (int newDuration, PaletteEffect* nextPE);
 
-		void apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic);
+		int  getState  ();
+		void transform (SDL_Color* shownPalette, bool direct);
+		void advance   (int mspf);
+		void addState  (Rewind* rewind);
+		bool getFade   (PaletteFade* fade);
 
 };
 
@@ -114,7 +156,11 @@ class FadeOutPaletteEffect : public PaletteEffect {
 	public:
 		FadeOutPaletteEffect (int newDuration, PaletteEffect* nextPE);
 
-		void apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic);
+		int  getState  ();
+		void transform (SDL_Color* shownPalette, bool direct);
+		void advance   (int mspf);
+		void addState  (Rewind* rewind);
+		bool getFade   (PaletteFade* fade);
 
 };
 
@@ -129,7 +175,10 @@ class FlashPaletteEffect : public PaletteEffect {
 	public:
 		FlashPaletteEffect (unsigned char newRed, unsigned char newGreen, unsigned char newBlue, int newDuration, PaletteEffect* nextPE);
 
-		void apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic);
+		int  getState  ();
+		void transform (SDL_Color* shownPalette, bool direct);
+		void advance   (int mspf);
+		void addState  (Rewind* rewind);
 
 };
 
@@ -145,7 +194,10 @@ class RotatePaletteEffect : public PaletteEffect {
 	public:
 		RotatePaletteEffect (unsigned char newFirst, int newAmount, fixed newSpeed, PaletteEffect* nextPE);
 
-		void apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic);
+		int  getState  ();
+		void transform (SDL_Color* shownPalette, bool direct);
+		void advance   (int mspf);
+		void addState  (Rewind* rewind);
 
 };
 
@@ -161,7 +213,8 @@ class SkyPaletteEffect : public PaletteEffect {
 	public:
 		SkyPaletteEffect (unsigned char newFirst, int newAmount, fixed newSpeed, SDL_Color* newSkyPalette, PaletteEffect* nextPE);
 
-		void apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic);
+		int  getState  ();
+		void transform (SDL_Color* shownPalette, bool direct);
 
 };
 
@@ -176,7 +229,8 @@ class P2DPaletteEffect : public PaletteEffect {
 	public:
 		P2DPaletteEffect (unsigned char newFirst, int newAmount, fixed newSpeed, PaletteEffect* nextPE);
 
-		void apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic);
+		int  getState  ();
+		void transform (SDL_Color* shownPalette, bool direct);
 
 };
 
@@ -191,7 +245,8 @@ class P1DPaletteEffect : public PaletteEffect {
 	public:
 		P1DPaletteEffect (unsigned char newFirst, int newAmount, fixed newSpeed, PaletteEffect* nextPE);
 
-		void apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic);
+		int  getState  ();
+		void transform (SDL_Color* shownPalette, bool direct);
 
 };
 
@@ -204,7 +259,8 @@ class WaterPaletteEffect : public PaletteEffect {
 	public:
 		WaterPaletteEffect (fixed newDepth, PaletteEffect* nextPE);
 
-		void apply (SDL_Color* shownPalette, bool direct, int mspf, bool isStatic);
+		int  getState  ();
+		void transform (SDL_Color* shownPalette, bool direct);
 
 };
 
@@ -26,6 +26,68 @@
 #include "video.h"
 #include "sprite.h"
 
+#include "loop.h"
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	#include <arm_neon.h>
+#endif
+
+
+/// Source column of each column of the scaled sprite being drawn
+static int scaledColumns[MAX_SCREEN_WIDTH];
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+/// Position of each column's source within its block of 16 columns
+static unsigned char scaledLanes[MAX_SCREEN_WIDTH];
+#endif
+
+
+/**
+ * Draw a row of a scaled sprite, using the source columns in scaledColumns.
+ *
+ * @param src Source row
+ * @param dst Destination pixels
+ * @param width Number of destination pixels
+ * @param blocks Number of leading blocks of 16 columns whose sources lie
+ * within 16 pixels of each other, and of the end of the source row
+ * @param key Colour key
+ */
+static void drawScaledRow (const unsigned char* src, unsigned char* dst, int width, int blocks, unsigned char key) {
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	uint8x16_t keys, pixels, transparent;
+#endif
+	unsigned char pixel;
+	int x;
+
+	x = 0;
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	keys = vdupq_n_u8(key);
+
+	// Each block's pixels are picked out of one load, without gathering
+	for (; x < blocks << 4; x += 16) {
+
+		pixels = vqtbl1q_u8(vld1q_u8(src + scaledColumns[x]), vld1q_u8(scaledLanes + x));
+		transparent = vceqq_u8(pixels, keys);
+		vst1q_u8(dst + x, vbslq_u8(transparent, vld1q_u8(dst + x), pixels));
+
+	}
+#else
+	(void)blocks;
+#endif
+
+	for (; x < width; x++) {
+
+		pixel = src[scaledColumns[x]];
+		if (pixel != key) dst[x] = pixel;
+
+	}
+
+	return;
+
+}
+
 
 /**
  * Create a sprite.
@@ -33,8 +95,10 @@
 Sprite::Sprite () {
 
 	pixels = NULL;
+	original = NULL;
 	xOffset = 0;
 	yOffset = 0;
+	key = 0;
 
 	return;
 
@@ -46,7 +110,7 @@ Sprite::Sprite () {
  */
 Sprite::~Sprite () {
 
-	if (pixels) SDL_FreeSurface(pixels);
+	if (pixels) freeSurface(pixels);
 
 	return;
 
@@ -60,9 +124,11 @@ void Sprite::clearPixels () {
 
 	unsigned char data;
 
-	if (pixels) SDL_FreeSurface(pixels);
+	if (pixels) freeSurface(pixels);
 
+	original = NULL;
 	data = 0;
+	key = 0;
 	pixels = createSurface(&data, 1, 1);
 	#ifdef SDL2
 	SDL_SetColorKey(pixels, SDL_TRUE, 0);
@@ -70,6 +136,8 @@ void Sprite::clearPixels () {
 	SDL_SetColorKey(pixels, SDL_SRCCOLORKEY, 0);
 	#endif
 
+	image.setPixels((unsigned char *)(pixels->pixels), pixels->pitch, 1, 1, 0);
+
 	return;
 
 }
@@ -91,18 +159,77 @@ void Sprite::setOffset (short int x, short int y) {
  * @param data The new pixel data
  * @param width The width of the sprite image
  * @param height The height of the sprite image
- * @param key The transparent pixel value
+ * @param newKey The transparent pixel value
  */
-void Sprite::setPixels (unsigned char *data, int width, int height, unsigned char key) {
+void Sprite::setPixels (unsigned char *data, int width, int height, unsigned char newKey) {
+
+	if (pixels) freeSurface(pixels);
+
+	original = NULL;
+	key = newKey;
 
-	if (pixels) SDL_FreeSurface(pixels);
+	// A dedicated server only needs the sprite's dimensions
+	if (headless) {
+
+		pixels = NULL;
+		image.setSize(width, height);
+
+		return;
+
+	}
 
 	pixels = createSurface(data, width, height);
 	#ifdef SDL2
-	SDL_SetColorKey(pixels, SDL_TRUE, key);
+	SDL_SetColorKey(pixels, SDL_TRUE, newKey);
 	#else
-	SDL_SetColorKey(pixels, SDL_SRCCOLORKEY, key);
+	SDL_SetColorKey(pixels, SDL_SRCCOLORKEY, newKey);
 	#endif
+
+	// Find the runs of opaque pixels once, rather than on every draw
+	image.setPixels((unsigned char *)(pixels->pixels), pixels->pitch, width, height, newKey);
+
+	return;
+
+}
+
+
+/**
+ * Use pixel data held in a shared atlas for the sprite. The data is drawn in
+ * place, so no surface is created.
+ *
+ * @param data The sprite's pixels within the atlas, which must outlive the sprite
+ * @param width The width of the sprite image
+ * @param height The height of the sprite image
+ * @param key The transparent pixel value
+ */
+void Sprite::setAtlasPixels (unsigned char *data, int width, int height, unsigned char key) {
+
+	if (pixels) freeSurface(pixels);
+
+	pixels = NULL;
+	original = NULL;
+
+	if (headless) image.setSize(width, height);
+	else image.setPixels(data, width, width, height, key);
+
+	return;
+
+}
+
+
+/**
+ * Make the sprite a horizontally mirrored view of another sprite, sharing its
+ * pixels instead of keeping a flipped copy. The sprite keeps its own offsets.
+ *
+ * @param mirrored The sprite to mirror, which must outlive this sprite
+ */
+void Sprite::setMirror (Sprite* mirrored) {
+
+	if (pixels) freeSurface(pixels);
+
+	pixels = NULL;
+	original = mirrored;
+
 	return;
 
 }
@@ -115,7 +242,9 @@ void Sprite::setPixels (unsigned char *data, int width, int height, unsigned cha
  */
 int Sprite::getWidth () {
 
-	return pixels->w;
+	if (original) return original->getWidth();
+
+	return image.getWidth();
 
 }
 
@@ -127,7 +256,9 @@ int Sprite::getWidth () {
  */
 int Sprite::getHeight() {
 
-	return pixels->h;
+	if (original) return original->getHeight();
+
+	return image.getHeight();
 
 }
 
@@ -165,34 +296,23 @@ int Sprite::getYOffset () {
  */
 void Sprite::setPalette (SDL_Color *palette, int start, int amount) {
 
-	#ifdef SDL2
-	SDL_SetPaletteColors(pixels->format->palette, palette + start, start, amount);
-	#else
-	SDL_SetPalette(pixels, SDL_LOGPAL, palette + start, start, amount);
-	#endif
+	if (original) {
 
-	return;
-
-}
+		original->setPalette(palette, start, amount);
 
+		return;
 
-/**
- * Map the whole of the sprite's palette to one index.
- *
- * @param index The index to use
- */
-void Sprite::flashPalette (int index) {
-
-	SDL_Color palette[256];
-	int count;
+	}
 
-	for (count = 0; count < 256; count++)
-		palette[count].r = palette[count].g = palette[count].b = index;
+	// Atlas sprites are drawn with the canvas palette
+	if (!pixels) return;
 
 	#ifdef SDL2
-	SDL_SetPaletteColors(pixels->format->palette, palette, 0, 256);
+	video.ownSurfacePalette(pixels);
+	SDL_SetPaletteColors(pixels->format->palette, palette + start, start, amount);
+	video.forgetSurfacePalette(pixels);
 	#else
-	SDL_SetPalette(pixels, SDL_LOGPAL, palette, 0, 256);
+	SDL_SetPalette(pixels, SDL_LOGPAL, palette + start, start, amount);
 	#endif
 
 	return;
@@ -205,9 +325,19 @@ void Sprite::flashPalette (int index) {
  */
 void Sprite::restorePalette () {
 
-	//video.restoreSurfacePalette(pixels);
-	SDL_Color palette[256];
-	SDL_SetPaletteColors(pixels->format->palette, palette, 0, 256);
+	if (original) {
+
+		original->restorePalette();
+
+		return;
+
+	}
+
+	// Atlas sprites are drawn with the canvas palette
+	if (!pixels) return;
+
+	// Go back to sharing, freeing the palette set or flashed
+	video.shareSurfacePalette(pixels);
 
 	return;
 
@@ -223,19 +353,15 @@ void Sprite::restorePalette () {
  */
 void Sprite::draw (int x, int y, bool includeOffsets) {
 
-	SDL_Rect dst;
-
-	dst.x = x;
-	dst.y = y;
-
 	if (includeOffsets) {
 
-		dst.x += xOffset;
-		dst.y += yOffset;
+		x += xOffset;
+		y += yOffset;
 
 	}
-    SDL_SetPaletteColors(pixels->format->palette, canvas->format->palette->colors, 0, 256);
-	SDL_BlitSurface(pixels, NULL, canvas, &dst);
+
+	if (original) original->image.drawMirrored(x, y);
+	else image.draw(x, y);
 
 	return;
 
@@ -243,7 +369,28 @@ void Sprite::draw (int x, int y, bool includeOffsets) {
 
 
 /**
- * Draw the sprite scaled
+ * Draw the sprite in a single colour, as when it has been hit.
+ *
+ * @param x The x-coordinate at which to draw the sprite
+ * @param y The y-coordinate at which to draw the sprite
+ * @param index The colour
+ */
+void Sprite::drawFlashed (int x, int y, unsigned char index) {
+
+	x += xOffset;
+	y += yOffset;
+
+	if (original) original->image.drawSolid(x, y, index, true);
+	else image.drawSolid(x, y, index, false);
+
+	return;
+
+}
+
+
+/**
+ * Draw the sprite scaled. Each column's source is found once per call, and
+ * rows and columns are stepped through without dividing.
  *
  * @param x The x-coordinate at which to draw the sprite
  * @param y The y-coordinate at which to draw the sprite
@@ -251,22 +398,24 @@ void Sprite::draw (int x, int y, bool includeOffsets) {
  */
 void Sprite::drawScaled (int x, int y, fixed scale) {
 
-	unsigned char* srcRow;
 	unsigned char* dstRow;
-#ifdef SDL2
-	uint32_t pixel, key;
-#else
-	unsigned char pixel, key;
-#endif
 	int width, height, fullWidth, fullHeight;
 	int dstX, dstY;
 	int srcX, srcY;
+	int columns, blocks, count;
+	int source, remainder, step, stepRemainder;
 
-	#ifdef SDL2
-	SDL_GetColorKey(pixels, &key);
-	#else
-	key = pixels->format->colorkey;
-	#endif
+	// Mirrored sprites are never drawn scaled, so draw the original
+	if (original) {
+
+		original->drawScaled(x, y, scale);
+
+		return;
+
+	}
+
+	// Atlas sprites are never drawn scaled
+	if (!pixels || (scale <= 0)) return;
 
 	fullWidth = FTOI(pixels->w * scale);
 	if (x < -(fullWidth >> 1)) return; // Off-screen
@@ -278,8 +427,6 @@ void Sprite::drawScaled (int x, int y, fixed scale) {
 	if (y + (fullHeight >> 1) > canvasH) height = canvasH + (fullHeight >> 1) - y;
 	else height = fullHeight;
 
-	if (SDL_MUSTLOCK(canvas)) SDL_LockSurface(canvas);
-
 	if (y < (fullHeight >> 1)) {
 
 		srcY = (fullHeight >> 1) - y;
@@ -292,30 +439,86 @@ void Sprite::drawScaled (int x, int y, fixed scale) {
 
 	}
 
-	while (srcY < height) {
+	if (x < (fullWidth >> 1)) {
 
-		srcRow = ((unsigned char *)(pixels->pixels)) + (pixels->pitch * DIV(srcY, scale));
-		dstRow = ((unsigned char *)(canvas->pixels)) + (canvas->pitch * dstY);
+		srcX = (fullWidth >> 1) - x;
+		dstX = 0;
 
-		if (x < (fullWidth >> 1)) {
+	} else {
 
-			srcX = (fullWidth >> 1) - x;
-			dstX = 0;
+		srcX = 0;
+		dstX = x - (fullWidth >> 1);
 
-		} else {
+	}
 
-			srcX = 0;
-			dstX = x - (fullWidth >> 1);
+	if ((srcX >= width) || (srcY >= height)) return;
+
+	columns = width - srcX;
+	if (columns > MAX_SCREEN_WIDTH) columns = MAX_SCREEN_WIDTH;
+
+	// Each destination pixel moves the source on by this much
+	step = F1 / scale;
+	stepRemainder = F1 % scale;
+
+	// Find the source of each column, as DIV would
+	source = (srcX << 10) / scale;
+	remainder = (srcX << 10) % scale;
+
+	for (count = 0; count < columns; count++) {
+
+		scaledColumns[count] = source;
+
+		source += step;
+		remainder += stepRemainder;
+
+		if (remainder >= scale) {
+
+			remainder -= scale;
+			source++;
 
 		}
 
-		while (srcX < width) {
+	}
+
+	blocks = 0;
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	// When enlarging, each block of 16 columns takes its pixels from no more
+	// than 16 source pixels
+	if (scale >= F1) {
+
+		while (((blocks + 1) << 4 <= columns) && (scaledColumns[blocks << 4] + 16 <= pixels->w)) {
+
+			for (count = 0; count < 16; count++)
+				scaledLanes[(blocks << 4) + count] = scaledColumns[(blocks << 4) + count] - scaledColumns[blocks << 4];
+
+			blocks++;
+
+		}
+
+	}
+#endif
+
+	// Step through the source rows the same way
+	source = (srcY << 10) / scale;
+	remainder = (srcY << 10) % scale;
+
+	if (SDL_MUSTLOCK(canvas)) SDL_LockSurface(canvas);
+
+	while (srcY < height) {
+
+		dstRow = ((unsigned char *)(canvas->pixels)) + (canvas->pitch * dstY) + dstX;
+
+		drawScaledRow(((unsigned char *)(pixels->pixels)) + (pixels->pitch * source), dstRow,
+			columns, blocks, key);
+
+		source += step;
+		remainder += stepRemainder;
 
-			pixel = srcRow[DIV(srcX, scale)];
-			if (pixel != key) dstRow[dstX] = pixel;
+		if (remainder >= scale) {
 
-			srcX++;
-			dstX++;
+			remainder -= scale;
+			source++;
 
 		}
 
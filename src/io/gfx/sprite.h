@@ -24,6 +24,7 @@
 #define _SPRITE_H
 
 
+#include "blitter.h"
 #include "OpenJazz.h"
 
 #define SDL2
@@ -41,9 +42,12 @@
 class Sprite {
 
 	private:
-		SDL_Surface* pixels; ///< Sprite image
+		SDL_Surface* pixels; ///< Sprite image, or NULL if the pixels are in an atlas or mirrored
+		BlitImage    image; ///< Sprite image, as runs of opaque pixels
+		Sprite*      original; ///< Sprite of which this is a mirror image, or NULL
 		short int    xOffset; ///< Horizontal offset
 		short int    yOffset; ///< Vertical offset
+		unsigned char key; ///< Transparent pixel value
 
 	public:
 		Sprite              ();
@@ -51,15 +55,17 @@ class Sprite {
 
 		void clearPixels    ();
 		void setOffset      (short int x, short int y);
-		void setPixels      (unsigned char* data, int width, int height, unsigned char key);
+		void setPixels      (unsigned char* data, int width, int height, unsigned char newKey);
+		void setAtlasPixels (unsigned char* data, int width, int height, unsigned char key);
+		void setMirror      (Sprite* mirrored);
 		int  getWidth       ();
 		int  getHeight      ();
 		int  getXOffset     ();
 		int  getYOffset     ();
 		void draw           (int x, int y, bool includeOffsets = true);
+		void drawFlashed    (int x, int y, unsigned char index);
 		void drawScaled     (int x, int y, fixed scale);
 		void setPalette     (SDL_Color* palette, int start, int amount);
-		void flashPalette   (int index);
 		void restorePalette ();
 
 };
@@ -24,6 +24,7 @@
  */
 
 
+#include "capture.h"
 #include "paletteeffects.h"
 #include "video.h"
 
@@ -31,10 +32,17 @@
 	#include <scalebit.h>
 #endif
 
+#include "level/benchmark.h"
+#include "loop.h"
+#include "profile.h"
 #include "util.h"
 
 #include <string.h>
 
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	#include <arm_neon.h>
+#endif
+
 
 /**
  * Creates a surface.
@@ -53,10 +61,8 @@ SDL_Surface* createSurface (unsigned char * pixels, int width, int height) {
 	// Create the surface
 	ret = SDL_CreateRGBSurface(0, width, height, 8, 0, 0, 0, 0);
 
-	// Set the surface's palette
-	//video.restoreSurfacePalette(ret);
-	SDL_Color palette[256];
-	SDL_SetPaletteColors(ret->format->palette, palette, 0, 256);
+	// Surfaces share a palette until one needs colours of its own
+	video.shareSurfacePalette(ret);
 
 	if (pixels) {
 
@@ -76,6 +82,241 @@ SDL_Surface* createSurface (unsigned char * pixels, int width, int height) {
 }
 
 
+/**
+ * Creates a surface which draws on existing pixel data in place, rather than
+ * a copy of it. The pixel data must outlive the surface.
+ *
+ * @param pixels Pixel data, with rows width bytes apart
+ * @param width Width of the pixel data and of the surface to be created
+ * @param height Height of the pixel data and of the surface to be created
+ *
+ * @return The completed surface
+ */
+SDL_Surface* wrapSurface (unsigned char * pixels, int width, int height) {
+
+	SDL_Surface *ret;
+
+	ret = SDL_CreateRGBSurfaceFrom(pixels, width, height, 8, width, 0, 0, 0, 0);
+
+	// Surfaces share a palette until one needs colours of its own
+	video.shareSurfacePalette(ret);
+
+	return ret;
+
+}
+
+
+/**
+ * Frees a surface which may be using the shared palette, such as one made by
+ * createSurface().
+ *
+ * @param surface The surface. Can be NULL.
+ */
+void freeSurface (SDL_Surface* surface) {
+
+	#ifdef SDL2
+	video.releaseSurface(surface);
+	#else
+	SDL_FreeSurface(surface);
+	#endif
+
+	return;
+
+}
+
+
+#ifdef SDL2
+/**
+ * Convert a row of palette indices into texture pixels.
+ *
+ * @param src Palette indices
+ * @param dst Texture pixels
+ * @param width Number of pixels in the row
+ * @param lut Texture pixel value of each palette index
+ */
+void expandRow (const unsigned char* src, Uint32* dst, int width, const Uint32* lut) {
+
+	int x = 0;
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	uint8x16_t indices;
+	uint32x4_t pixels;
+
+	/* There is no gather instruction, so fetch sixteen indices at once and
+	load each looked-up colour straight into a vector lane, allowing whole
+	quads of pixels to be stored at a time. */
+	#define LOOKUP_QUAD(quad) \
+		pixels = vld1q_lane_u32(lut + vgetq_lane_u8(indices, (quad << 2)), pixels, 0); \
+		pixels = vld1q_lane_u32(lut + vgetq_lane_u8(indices, (quad << 2) + 1), pixels, 1); \
+		pixels = vld1q_lane_u32(lut + vgetq_lane_u8(indices, (quad << 2) + 2), pixels, 2); \
+		pixels = vld1q_lane_u32(lut + vgetq_lane_u8(indices, (quad << 2) + 3), pixels, 3); \
+		vst1q_u32(dst + x + (quad << 2), pixels);
+
+	pixels = vdupq_n_u32(0);
+
+	for (; x + 16 <= width; x += 16) {
+
+		indices = vld1q_u8(src + x);
+
+		LOOKUP_QUAD(0)
+		LOOKUP_QUAD(1)
+		LOOKUP_QUAD(2)
+		LOOKUP_QUAD(3)
+
+	}
+
+	#undef LOOKUP_QUAD
+#endif
+
+	for (; x + 4 <= width; x += 4) {
+
+		dst[x] = lut[src[x]];
+		dst[x + 1] = lut[src[x + 1]];
+		dst[x + 2] = lut[src[x + 2]];
+		dst[x + 3] = lut[src[x + 3]];
+
+	}
+
+	for (; x < width; x++) dst[x] = lut[src[x]];
+
+	return;
+
+}
+
+
+/**
+ * Convert a row of palette indices into texture pixels, taking the pixels of
+ * the 32-bit canvas wherever the indices are see-through.
+ *
+ * @param src Palette indices
+ * @param under The 32-bit canvas's pixels
+ * @param dst Texture pixels
+ * @param width Number of pixels in the row
+ * @param lut Texture pixel value of each palette index
+ */
+void composeRow (const unsigned char* src, const Uint32* under, Uint32* dst, int width, const Uint32* lut) {
+
+	int x, end;
+
+	x = 0;
+
+	while (x < width) {
+
+		// Tiles leave long runs of see-through pixels, copied whole
+		for (end = x; (end < width) && (src[end] == SEE_THROUGH); end++);
+
+		if (end > x) {
+
+			memcpy(dst + x, under + x, (end - x) * sizeof(Uint32));
+			x = end;
+
+		}
+
+		for (; (x < width) && (src[x] != SEE_THROUGH); x++) dst[x] = lut[src[x]];
+
+	}
+
+	return;
+
+}
+#endif
+
+
+#ifdef SHADER_PALETTE
+/// Vertex shader drawing the screen as a single quad
+static const char* vertexShaderSource =
+	"attribute vec2 position;\n"
+	"attribute vec2 texCoord;\n"
+	"uniform vec2 extent;\n"
+	"varying vec2 coord;\n"
+	"void main () {\n"
+	"	coord = texCoord * extent;\n"
+	"	gl_Position = vec4(position, 0.0, 1.0);\n"
+	"}\n";
+
+/// Fragment shader looking up each palette index in the palette texture, then
+/// fading the colour
+static const char* fragmentShaderSource =
+	"precision mediump float;\n"
+	"uniform sampler2D indices;\n"
+	"uniform sampler2D palette;\n"
+	"uniform vec2 fade;\n"
+	"varying vec2 coord;\n"
+	"void main () {\n"
+	"	float index = texture2D(indices, coord).r;\n"
+	"	gl_FragColor = vec4(texture2D(palette, vec2((index * 255.0 + 0.5) / 256.0, 0.5)).rgb * fade.x + fade.y, 1.0);\n"
+	"}\n";
+
+/// Quad corner positions
+static const GLfloat quadPositions[] = {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};
+
+/// Quad corner texture coordinates
+static const GLfloat quadCoords[] = {0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f, 1.0f, 0.0f};
+
+
+/**
+ * Compile a shader.
+ *
+ * @param type The type of shader
+ * @param source The shader's source code
+ *
+ * @return The shader (0 on failure)
+ */
+static GLuint compileShader (GLenum type, const char* source) {
+
+	GLuint shader;
+	GLint status;
+
+	shader = glCreateShader(type);
+
+	if (!shader) return 0;
+
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &status);
+
+	if (status == GL_FALSE) {
+
+		glDeleteShader(shader);
+
+		return 0;
+
+	}
+
+	return shader;
+
+}
+
+
+/**
+ * Create a texture which is sampled without filtering.
+ *
+ * @param unit The texture unit to bind the texture to
+ * @param format The format of the texture
+ * @param width The width of the texture
+ * @param height The height of the texture
+ *
+ * @return The texture
+ */
+static GLuint createTexture (GLenum unit, GLenum format, int width, int height) {
+
+	GLuint texture;
+
+	glGenTextures(1, &texture);
+	glActiveTexture(unit);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, NULL);
+
+	return texture;
+
+}
+#endif
+
+
 /**
  * Create the video output object.
  */
@@ -85,6 +326,40 @@ Video::Video () {
 
 	screen = NULL;
 
+#ifdef SDL2
+	window = NULL;
+	renderer = NULL;
+	texture = NULL;
+	shownPixels = NULL;
+	paletteEpoch = 1;
+	sharedPalette = NULL;
+	sharedEpoch = 0;
+	paletteLock = SDL_CreateMutex();
+	dynamicResolution = false;
+	dynamicPercent = 100;
+	dynamicHold = 0;
+	trueCanvas = NULL;
+	trueColour = false;
+	trueFrame = false;
+#endif
+
+	integerScale = false;
+
+#ifdef SHADER_PALETTE
+	glContext = NULL;
+	shaderProgram = 0;
+	indexTexture = 0;
+	paletteTexture = 0;
+	swapInterval = 1;
+	shownInterval = 1;
+#endif
+
+#ifdef RENDER_THREAD
+	renderThread = NULL;
+	frameReady = NULL;
+	frameFree = NULL;
+#endif
+
 #ifdef SCALE
 	scaleFactor = 1;
 #endif
@@ -101,6 +376,23 @@ Video::Video () {
 }
 
 
+/**
+ * Delete the video output object.
+ */
+Video::~Video () {
+
+#ifdef SDL2
+	// Surfaces still using the shared palette hold their own references
+	if (sharedPalette) SDL_FreePalette(sharedPalette);
+	if (paletteLock) SDL_DestroyMutex(paletteLock);
+	if (trueCanvas) delete[] trueCanvas;
+#endif
+
+	return;
+
+}
+
+
 /**
  * Find the maximum horizontal and vertical resolutions.
  */
@@ -156,6 +448,11 @@ bool Video::init (int width, int height, bool startFullscreen) {
 
 	if (fullscreen) SDL_ShowCursor(SDL_DISABLE);
 
+	#ifdef SDL2
+	// Made before any surface, as surfaces are made from then on by any thread
+	if (!sharedPalette) sharedPalette = SDL_AllocPalette(256);
+	#endif
+
 	if (!reset(width, height)) {
 
 		logError("Could not set video mode", SDL_GetError());
@@ -177,6 +474,37 @@ bool Video::init (int width, int height, bool startFullscreen) {
 }
 
 
+/**
+ * Creates an off-screen canvas instead of a window, for a dedicated server.
+ * Anything drawn while loading goes nowhere.
+ *
+ * @return Success
+ */
+bool Video::initHeadless () {
+
+	screenW = canvasW = DEFAULT_SCREEN_WIDTH;
+	screenH = canvasH = DEFAULT_SCREEN_HEIGHT;
+
+#ifdef SDL2
+	if (!sharedPalette) sharedPalette = SDL_AllocPalette(256);
+#endif
+
+	screen = canvas = createSurface(NULL, canvasW, canvasH);
+
+	if (!screen) return false;
+
+#ifdef SDL2
+	ownSurfacePalette(screen);
+#endif
+
+	fullscreen = false;
+	fakePalette = true;
+
+	return true;
+
+}
+
+
 /**
  * Sets the size of the video window or the resolution of the screen.
  *
@@ -187,11 +515,35 @@ bool Video::init (int width, int height, bool startFullscreen) {
  */
 bool Video::reset (int width, int height) {
 
+#ifdef SDL2
+	SDL_Surface* oldScreen;
+#endif
+
 	screenW = width;
 	screenH = height;
 
+#ifdef SDL2
+	// The render thread reads the screen's copy, and presents to the window,
+	// so it must stop before either is replaced
+	finishRendering();
+
+	if (texture) SDL_DestroyTexture(texture);
+	if (renderer) SDL_DestroyRenderer(renderer);
+	texture = NULL;
+	renderer = NULL;
+
+	#ifdef SHADER_PALETTE
+	deleteShaderPalette();
+	#else
+	if (window) SDL_DestroyWindow(window);
+	window = NULL;
+	#endif
+
+	oldScreen = screen;
+#endif
+
 #ifdef SCALE
-	if (canvas != screen) SDL_FreeSurface(canvas);
+	if (canvas != screen) freeSurface(canvas);
 #endif
 
 
@@ -199,28 +551,52 @@ bool Video::reset (int width, int height) {
 
 // The SDL2 window and renderer
 
-// Initalize Color Masks.
-Uint32 redMask, greenMask, blueMask;
-redMask   = 0x000000ff;
-greenMask = 0x0000ff00;
-blueMask  = 0x00ff0000;
-
-window = SDL_CreateWindow("", 0, 0, 800, 600, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
-renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC); 
-
 // The buffer where the game puts each frame into.
 screen = SDL_CreateRGBSurface(SDL_SWSURFACE, DEFAULT_SCREEN_WIDTH, DEFAULT_SCREEN_HEIGHT, 8, 0, 0, 0, 0);
 
-// The surface into wich we will convert from 8bit paletted to 32bpp RGB
-helper_surface = SDL_CreateRGBSurface(SDL_SWSURFACE, DEFAULT_SCREEN_WIDTH, DEFAULT_SCREEN_HEIGHT, 32, redMask, greenMask, blueMask, 0); 
+// The new screen carries on with the old one's colours
+if (oldScreen) {
+
+	if (screen) SDL_SetPaletteColors(screen->format->palette, oldScreen->format->palette->colors, 0, 256);
+
+	SDL_FreeSurface(oldScreen);
+
+}
+
+if (!screen) return false;
+
+// The copy of what was last shown, used to skip unchanged rows
+if (shownPixels) delete[] shownPixels;
+shownPixels = new unsigned char[screen->pitch * screen->h];
+shownValid = false;
+
+// The 32-bit canvas is made again the first time it is drawn to
+if (trueCanvas) delete[] trueCanvas;
+trueCanvas = NULL;
+trueFrame = false;
+
+#ifdef SHADER_PALETTE
+// Prefer expanding the palette on the GPU, if shaders are available
+if (!createShaderPalette())
+#endif
+{
+
+	window = SDL_CreateWindow("", 0, 0, 800, 600, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
+	renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC); 
+
+	// THE SDL2 texture, into which each frame is converted to 32bpp RGB.
+	// Its pixels stay sharp however much it is enlarged.
+	SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "nearest");
+	texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING,
+		DEFAULT_SCREEN_WIDTH, DEFAULT_SCREEN_HEIGHT);
+
+	applyScaling();
 
-// THE SDL2 texture
-texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING,
-	DEFAULT_SCREEN_WIDTH, DEFAULT_SCREEN_HEIGHT);
+	// Sure clear the screen first.. always nice.
+	SDL_RenderClear(renderer);
+	SDL_RenderPresent(renderer); 
 
-// Sure clear the screen first.. always nice.
-SDL_RenderClear(renderer);
-SDL_RenderPresent(renderer); 
+}
 
 #else // WE DO NOT HAVE SDL2...
 
@@ -243,11 +619,15 @@ SDL_RenderPresent(renderer);
 
 	}
 
-	if (scaleFactor > 1) {
+	// Whole multiples are left to the GPU where there is one
+	if ((scaleFactor > 1) && !integerScale) {
 
 		canvasW = screenW / scaleFactor;
 		canvasH = screenH / scaleFactor;
 		canvas = createSurface(NULL, canvasW, canvasH);
+	#ifdef SDL2
+		ownSurfacePalette(canvas);
+	#endif
 
 	} else
 #endif
@@ -259,6 +639,12 @@ SDL_RenderPresent(renderer);
 
 	}
 
+#ifdef SDL2
+	// The canvas starts at its full size
+	dynamicPercent = 100;
+	dynamicHold = 0;
+#endif
+
 #if !defined(WIZ) && !defined(GP2X)
 	expose();
 #endif
@@ -292,23 +678,8 @@ void Video::setPalette (SDL_Color *palette) {
 	flip(0);
 
 	#ifdef SDL2
-	/*SDL_Palette *sdlpalette = SDL_AllocPalette(256);
-	SDL_SetPaletteColors(sdlpalette, palette, 0, 256);
-	SDL_SetSurfacePalette(screen, sdlpalette);*/
-	
 	SDL_SetPaletteColors(screen->format->palette, palette, 0, 256);
-
-	printf("*****PALETTE IS SET UP AS:**********");
-
-	uint8_t r;
-	uint8_t g;
-	uint8_t b;
-	for (int i = 0; i < 255; i++) {
-		r = screen->format->palette->colors[i].r;
-		g = screen->format->palette->colors[i].g;
-		b = screen->format->palette->colors[i].b;
-		printf(" entry %d:  %d %d %d \n", i, r, g, b);
-	}
+	updatePaletteLUT(0, 256);
 	#else
 	SDL_SetPalette(screen, SDL_PHYSPAL, palette, 0, 256);
 	#endif
@@ -342,7 +713,32 @@ SDL_Color* Video::getPalette () {
 void Video::changePalette (SDL_Color *palette, unsigned char first, unsigned int amount) {
 
 	#ifdef SDL2
-	SDL_SetPaletteColors(screen->format->palette, palette, first, amount);
+	SDL_Color* colors;
+	unsigned int start, end;
+
+	// Only touch the display palette colours which have actually changed
+	colors = screen->format->palette->colors + first;
+
+	for (start = 0; start < amount; start++) {
+
+		if ((colors[start].r != palette[start].r) ||
+			(colors[start].g != palette[start].g) ||
+			(colors[start].b != palette[start].b)) break;
+
+	}
+
+	if (start == amount) return;
+
+	for (end = amount; end > start + 1; end--) {
+
+		if ((colors[end - 1].r != palette[end - 1].r) ||
+			(colors[end - 1].g != palette[end - 1].g) ||
+			(colors[end - 1].b != palette[end - 1].b)) break;
+
+	}
+
+	SDL_SetPaletteColors(screen->format->palette, palette + start, first + start, end - start);
+	updatePaletteLUT(first + start, end - start);
 	#else
 	SDL_SetPalette(screen, SDL_PHYSPAL, palette, first, amount);
 	#endif
@@ -360,6 +756,7 @@ void Video::changePalette (SDL_Color *palette, unsigned char first, unsigned int
 void Video::restoreSurfacePalette (SDL_Surface* surface) {
 
 	#ifdef SDL2
+	ownSurfacePalette(surface);
 	SDL_SetPaletteColors(surface->format->palette, logicalPalette, 0, 256);
 	#else
 	SDL_SetPalette(surface, SDL_LOGPAL, logicalPalette, 0, 256);
@@ -370,114 +767,952 @@ void Video::restoreSurfacePalette (SDL_Surface* surface) {
 }
 
 
+#ifdef SDL2
 /**
- * Returns the maximum possible screen width.
+ * Give a surface the canvas's palette, so that blitting it to the canvas
+ * copies palette indices without remapping them. Nothing is done if the
+ * surface has already been given the canvas's current palette.
  *
- * @return The maximum width
+ * @param surface The surface
  */
-int Video::getMaxWidth () {
+void Video::syncSurfacePalette (SDL_Surface* surface) {
 
-	return maxW;
+	// The shared palette is synced once for all the surfaces using it
+	if (surface->format->palette == sharedPalette) {
 
-}
+		if (sharedEpoch != paletteEpoch) {
 
+			SDL_LockMutex(paletteLock);
+			SDL_SetPaletteColors(sharedPalette, canvas->format->palette->colors, 0, 256);
+			SDL_UnlockMutex(paletteLock);
+			sharedEpoch = paletteEpoch;
 
-/**
- * Returns the maximum possible screen height.
- *
- * @return The maximum height
- */
-int Video::getMaxHeight () {
+		}
 
-	return maxH;
+		return;
 
-}
+	}
 
+	// The surface's user data holds the palette epoch it was last synced to
+	if ((uintptr_t)(surface->userdata) == paletteEpoch) return;
 
-/**
- * Returns the current width of the window or screen.
- *
- * @return The width
- */
-int Video::getWidth () {
+	SDL_SetPaletteColors(surface->format->palette, canvas->format->palette->colors, 0, 256);
+	surface->userdata = (void *)(uintptr_t)paletteEpoch;
 
-	return screenW;
+	return;
 
 }
 
 
 /**
- * Returns the current height of the window or screen.
+ * Note that a surface's palette has been changed by other means, so that the
+ * next call to syncSurfacePalette() has to sync it again.
  *
- * @return The height
+ * @param surface The surface
  */
-int Video::getHeight () {
+void Video::forgetSurfacePalette (SDL_Surface* surface) {
 
-	return screenH;
+	surface->userdata = NULL;
+
+	return;
 
 }
 
 
-#ifdef SCALE
 /**
- * Returns the current scaling factor.
+ * Make a surface use the palette shared by surfaces whose colours have not
+ * been changed, freeing any palette of its own. Before the shared palette has
+ * been made by init(), the surface keeps its own. Called by any thread.
  *
- * @return The scaling factor
+ * @param surface The surface
  */
-int Video::getScaleFactor () {
+void Video::shareSurfacePalette (SDL_Surface* surface) {
 
-	return scaleFactor;
+	if (!surface || !sharedPalette) return;
+
+	// The surface takes its own reference, and releases its old palette's.
+	// SDL counts references without atomics, so every thread takes the lock.
+	SDL_LockMutex(paletteLock);
+	SDL_SetSurfacePalette(surface, sharedPalette);
+	SDL_UnlockMutex(paletteLock);
+
+	forgetSurfacePalette(surface);
+
+	return;
 
 }
 
 
 /**
- * Sets the scaling factor.
+ * Give a surface a palette of its own, starting with the shared palette's
+ * colours, so that its colours can be changed without changing those of
+ * every other surface. Nothing is done if it already has its own.
  *
- * @param newScaleFactor The new scaling factor
+ * @param surface The surface
  */
-int Video::setScaleFactor (int newScaleFactor) {
+void Video::ownSurfacePalette (SDL_Surface* surface) {
 
-	if ((SW * newScaleFactor <= screenW) && (SH * newScaleFactor <= screenH)) {
+	SDL_Palette* palette;
 
-		scaleFactor = newScaleFactor;
+	if (!surface || !surface->format->palette ||
+		(surface->format->palette != sharedPalette)) return;
 
-		if (screen) reset(screenW, screenH);
+	palette = SDL_AllocPalette(256);
 
-	}
+	if (!palette) return;
 
-	return scaleFactor;
+	SDL_LockMutex(paletteLock);
+	SDL_SetPaletteColors(palette, sharedPalette->colors, 0, 256);
+	SDL_SetSurfacePalette(surface, palette);
+	SDL_UnlockMutex(paletteLock);
+
+	SDL_FreePalette(palette);
+	forgetSurfacePalette(surface);
+
+	return;
 
 }
-#endif
 
-#ifndef FULLSCREEN_ONLY
+
 /**
- * Determines whether or not full-screen mode is being used.
+ * Free a surface, releasing its reference on the shared palette under the
+ * lock. Called by any thread.
  *
- * @return Whether or not full-screen mode is being used
+ * @param surface The surface. Can be NULL.
+ */
+void Video::releaseSurface (SDL_Surface* surface) {
+
+	if (!surface) return;
+
+	SDL_LockMutex(paletteLock);
+	SDL_FreeSurface(surface);
+	SDL_UnlockMutex(paletteLock);
+
+	return;
+
+}
+#endif
+
+
+/**
+ * Returns the maximum possible screen width.
+ *
+ * @return The maximum width
+ */
+int Video::getMaxWidth () {
+
+	return maxW;
+
+}
+
+
+/**
+ * Returns the maximum possible screen height.
+ *
+ * @return The maximum height
+ */
+int Video::getMaxHeight () {
+
+	return maxH;
+
+}
+
+
+/**
+ * Returns the current width of the window or screen.
+ *
+ * @return The width
+ */
+int Video::getWidth () {
+
+	return screenW;
+
+}
+
+
+/**
+ * Returns the current height of the window or screen.
+ *
+ * @return The height
+ */
+int Video::getHeight () {
+
+	return screenH;
+
+}
+
+
+#ifdef SCALE
+/**
+ * Returns the current scaling factor.
+ *
+ * @return The scaling factor
+ */
+int Video::getScaleFactor () {
+
+	return scaleFactor;
+
+}
+
+
+/**
+ * Sets the scaling factor.
+ *
+ * @param newScaleFactor The new scaling factor
+ */
+int Video::setScaleFactor (int newScaleFactor) {
+
+	if ((SW * newScaleFactor <= screenW) && (SH * newScaleFactor <= screenH)) {
+
+		scaleFactor = newScaleFactor;
+
+		if (screen) reset(screenW, screenH);
+
+	}
+
+	return scaleFactor;
+
+}
+
+
+/**
+ * Scaling job. Scales bands of the canvas until none are left.
+ *
+ * @param data The video output object
+ */
+void Video::scaleJob (void* data) {
+
+	((Video *)data)->scaleBands();
+
+	return;
+
+}
+
+
+/**
+ * Scale bands of the canvas until none are left.
+ */
+void Video::scaleBands () {
+
+	int band, first, last;
+
+	while ((band = SDL_AtomicAdd(&scaleBand, 1)) < SCALE_BANDS) {
+
+		first = (canvas->h * band) / SCALE_BANDS;
+		last = (canvas->h * (band + 1)) / SCALE_BANDS;
+
+		if (last > first)
+			scale_band(scaleFactor,
+				screen->pixels, screen->pitch,
+				canvas->pixels, canvas->pitch,
+				screen->format->BytesPerPixel, canvas->w, canvas->h,
+				first, last - first);
+
+	}
+
+	return;
+
+}
+#endif
+
+#ifndef FULLSCREEN_ONLY
+/**
+ * Determines whether or not full-screen mode is being used.
+ *
+ * @return Whether or not full-screen mode is being used
  */
 bool Video::isFullscreen () {
 
-	return fullscreen;
+	return fullscreen;
+
+}
+#endif
+
+
+/**
+ * Determines whether or not the canvas is only enlarged by whole multiples.
+ *
+ * @return Whether or not integer scaling is being used
+ */
+bool Video::isIntegerScale () {
+
+	return integerScale;
+
+}
+
+
+/**
+ * Sets whether the canvas is enlarged to fill the window, or only by the
+ * largest whole multiple which fits, leaving borders. Either way the canvas
+ * stays at its own resolution, and is enlarged by the GPU as it is shown.
+ *
+ * @param enable Whether or not to use integer scaling
+ */
+void Video::setIntegerScale (bool enable) {
+
+	integerScale = enable;
+
+#ifdef SDL2
+	// A shrunk canvas would not be a whole multiple
+	if (enable) fullResolution();
+
+	applyScaling();
+#endif
+
+	return;
+
+}
+
+
+/**
+ * Sets whether or not frames wait for the display to refresh. Only the GPU
+ * palette path can change this once the window is open, the SDL2 renderer
+ * always waits.
+ *
+ * @param enable Whether or not to wait for the display
+ */
+void Video::setVsync (bool enable) {
+
+#ifdef SHADER_PALETTE
+	swapInterval = enable? 1: 0;
+#else
+	(void)enable;
+#endif
+
+	return;
+
+}
+
+
+#ifdef SDL2
+/**
+ * Determines whether or not the canvas shrinks when frames take too long.
+ *
+ * @return Whether or not the resolution is dynamic
+ */
+bool Video::isDynamicResolution () {
+
+	return dynamicResolution;
+
+}
+
+
+/**
+ * Sets whether or not the canvas shrinks when frames take too long to draw,
+ * and grows again once they no longer do. The smaller canvas is stretched to
+ * fill the window as it is shown.
+ *
+ * @param enable Whether or not to use dynamic resolution
+ */
+void Video::setDynamicResolution (bool enable) {
+
+	dynamicResolution = enable;
+
+	if (!enable) fullResolution();
+
+	return;
+
+}
+
+
+/**
+ * Shrink or grow the canvas, if the resolution is dynamic, to keep the time
+ * spent on each frame within its interval. Called between frames, only while
+ * a level is being played.
+ *
+ * @param load Percentage of each frame's interval recently spent working
+ */
+void Video::adaptResolution (int load) {
+
+	int percent;
+
+	// The canvas can only be shrunk while it is the screen itself
+	if (!dynamicResolution || integerScale || (canvas != screen)) return;
+
+	// Each change is given time to show in the load, and the gap between the
+	// thresholds stops the size from going back and forth
+	if (dynamicHold) {
+
+		dynamicHold--;
+
+		return;
+
+	}
+
+	if ((load > DYNAMIC_HIGH) && (dynamicPercent > DYNAMIC_MIN))
+		percent = dynamicPercent - DYNAMIC_STEP;
+	else if ((load < DYNAMIC_LOW) && (dynamicPercent < 100))
+		percent = dynamicPercent + DYNAMIC_STEP;
+	else
+		return;
+
+	resizeCanvas(percent);
+	dynamicHold = DYNAMIC_HOLD;
+
+	return;
+
+}
+
+
+/**
+ * Return the canvas to its full size, if it has been shrunk.
+ */
+void Video::fullResolution () {
+
+	if ((dynamicPercent < 100) && (canvas == screen)) resizeCanvas(100);
+
+	dynamicHold = 0;
+
+	return;
+
+}
+
+
+/**
+ * Change the part of the screen used as the canvas. Drawing is clipped to it.
+ *
+ * @param percent The canvas size, as a percentage of the screen's
+ */
+void Video::resizeCanvas (int percent) {
+
+	SDL_Rect clip;
+
+	if (percent < DYNAMIC_MIN) percent = DYNAMIC_MIN;
+	if (percent > 100) percent = 100;
+
+	dynamicPercent = percent;
+
+	canvasW = (screenW * percent) / 100;
+	canvasH = (screenH * percent) / 100;
+
+	// The panel and menus are laid out for at least the original screen
+	if (canvasW < SW) canvasW = (screenW < SW)? screenW: SW;
+	if (canvasH < SH) canvasH = (screenH < SH)? screenH: SH;
+
+	if (percent < 100) {
+
+		if (canvasW > screen->w) canvasW = screen->w;
+		if (canvasH > screen->h) canvasH = screen->h;
+
+	}
+
+	clip.x = 0;
+	clip.y = 0;
+	clip.w = canvasW;
+	clip.h = canvasH;
+	SDL_SetClipRect(canvas, &clip);
+
+	shownValid = false;
+
+	return;
+
+}
+#endif
+
+
+#ifdef SDL2
+/**
+ * Determines whether or not levels are to draw their tiles into a 32-bit
+ * canvas. Frames may still be drawn in 8 bits, where getTrueCanvas() gives
+ * none.
+ *
+ * @return Whether or not true-colour mode has been chosen
+ */
+bool Video::isTrueColour () {
+
+	return trueColour;
+
+}
+
+
+/**
+ * Sets whether or not levels draw their tiles into a 32-bit canvas, from
+ * copies already expanded to the display's colours, instead of into the 8-bit
+ * canvas. This trades memory for not expanding most of each frame as it is
+ * shown, and only works where frames are expanded without shaders.
+ *
+ * @param enable Whether or not to use true-colour mode
+ */
+void Video::setTrueColour (bool enable) {
+
+	trueColour = enable;
+
+	return;
+
+}
+
+
+/**
+ * Get the 32-bit canvas, in which tiles are drawn beneath the 8-bit canvas's
+ * see-through pixels, with the same pitch in pixels as the canvas has in
+ * bytes. The coming frame is composed from both canvases as it is shown. Must
+ * be called on the main thread.
+ *
+ * @return The 32-bit canvas, or NULL if the frame is to be drawn in 8 bits
+ */
+Uint32* Video::getTrueCanvas () {
+
+	if (!trueColour || headless || (canvas != screen)) return NULL;
+
+#ifdef SHADER_PALETTE
+	// The shader already expands the whole frame on the GPU
+	if (glContext) return NULL;
+#endif
+
+	// Screenshots and clips keep palette indices, so are drawn in 8 bits
+	if (capture.isCapturing()) return NULL;
+
+	if (!trueCanvas) trueCanvas = new Uint32[screen->pitch * screen->h];
+
+	trueFrame = true;
+
+	return trueCanvas;
+
+}
+
+
+/**
+ * Get the display palette as texture pixel values, the colours drawn into the
+ * 32-bit canvas.
+ *
+ * @return The texture pixel value of each palette index
+ */
+Uint32* Video::getPaletteLUT () {
+
+	return paletteLUT;
+
+}
+
+
+/**
+ * Get the number of the display palette's latest change, so that copies
+ * expanded to its colours can tell when they need expanding again.
+ *
+ * @return The palette epoch
+ */
+Uint32 Video::getPaletteEpoch () {
+
+	return paletteEpoch;
+
+}
+
+
+/**
+ * Tell the SDL2 renderer, if it is being used, how to enlarge the canvas.
+ */
+void Video::applyScaling () {
+
+#ifdef SHADER_PALETTE
+	// The shader finds its own viewport
+	if (glContext) return;
+#endif
+
+	if (!renderer) return;
+
+	if (integerScale) SDL_RenderSetLogicalSize(renderer, screen->w, screen->h);
+	else SDL_RenderSetLogicalSize(renderer, 0, 0);
+
+	SDL_RenderSetIntegerScale(renderer, integerScale? SDL_TRUE: SDL_FALSE);
+
+	return;
+
+}
+#endif
+
+
+/**
+ * Refresh display palette.
+ */
+void Video::expose () {
+
+	#ifdef SDL2
+	SDL_SetPaletteColors(screen->format->palette, logicalPalette, 0, 256);
+	SDL_SetPaletteColors(screen->format->palette, currentPalette, 0, 256);
+	updatePaletteLUT(0, 256);
+	shownValid = false;
+	#else
+	SDL_SetPalette(screen, SDL_LOGPAL, logicalPalette, 0, 256);
+	SDL_SetPalette(screen, SDL_PHYSPAL, currentPalette, 0, 256);
+	#endif
+
+	return;
+
+}
+
+
+#ifdef SDL2
+/**
+ * Rebuild part of the look-up table used to convert the display's palette
+ * indices into texture pixels.
+ *
+ * @param first The first palette index to rebuild
+ * @param amount The number of palette indices to rebuild
+ */
+void Video::updatePaletteLUT (int first, int amount) {
+
+	SDL_Color* colors;
+	int count;
+
+	colors = screen->format->palette->colors;
+
+	// Pack entries in the same RGBA order as the texture format
+	for (count = first; (count < first + amount) && (count < 256); count++) {
+
+		paletteLUT[count] = (colors[count].r << 24) | (colors[count].g << 16) |
+			(colors[count].b << 8) | 0xFF;
+
+	}
+
+	paletteChanged = true;
+
+	// Surfaces matched to the old palette need matching again
+	if (!++paletteEpoch) paletteEpoch = 1;
+
+	return;
+
+}
+#endif
+
+
+#ifdef SDL2
+/**
+ * Find the rows of the screen which have changed since the last frame was
+ * shown, and remember their new contents.
+ *
+ * Many things draw straight into the canvas's pixels, so rather than relying
+ * on every drawing function to report what it touched, the screen is
+ * compared against a copy of what was last shown. This costs far less than
+ * converting and uploading rows that have not changed.
+ *
+ * @param top Variable to receive the first changed row
+ * @param bottom Variable to receive the row after the last changed row
+ */
+void Video::findChangedRows (int* top, int* bottom) {
+
+	unsigned char* pixels;
+	int pitch, first, last;
+
+	pixels = (unsigned char *)(screen->pixels);
+	pitch = screen->pitch;
+	first = 0;
+	last = screen->h;
+
+	if (shownValid) {
+
+		while ((first < last) &&
+			!memcmp(shownPixels + (pitch * first), pixels + (pitch * first), screen->w)) first++;
+
+		while ((last > first) &&
+			!memcmp(shownPixels + (pitch * (last - 1)), pixels + (pitch * (last - 1)), screen->w)) last--;
+
+	}
+
+	if (last > first)
+		memcpy(shownPixels + (pitch * first), pixels + (pitch * first), pitch * (last - first));
+
+	shownValid = true;
+
+	*top = first;
+	*bottom = last;
+
+	return;
 
 }
 #endif
 
 
+#ifdef SHADER_PALETTE
 /**
- * Refresh display palette.
+ * Create a window with an OpenGL ES 2 context, and the shader and textures
+ * used to expand the display's palette indices on the GPU.
+ *
+ * @return Success
  */
-void Video::expose () {
+bool Video::createShaderPalette () {
 
-	#ifdef SDL2
-	SDL_SetPaletteColors(screen->format->palette, logicalPalette, 0, 256);
-	SDL_SetPaletteColors(screen->format->palette, currentPalette, 0, 256);
-	#else
-	SDL_SetPalette(screen, SDL_LOGPAL, logicalPalette, 0, 256);
-	SDL_SetPalette(screen, SDL_PHYSPAL, currentPalette, 0, 256);
+	GLuint vertexShader, fragmentShader;
+	GLint status;
+
+	// The render thread would otherwise be left presenting to the old window
+	finishRendering();
+
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_ES);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 2);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
+
+	window = SDL_CreateWindow("", 0, 0, 800, 600, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE | SDL_WINDOW_OPENGL);
+
+	if (!window) return false;
+
+	glContext = SDL_GL_CreateContext(window);
+
+	if (!glContext) {
+
+		deleteShaderPalette();
+
+		return false;
+
+	}
+
+	SDL_GL_SetSwapInterval(swapInterval);
+	shownInterval = swapInterval;
+
+	// Build the shader
+	vertexShader = compileShader(GL_VERTEX_SHADER, vertexShaderSource);
+	fragmentShader = compileShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+	status = GL_FALSE;
+
+	if (vertexShader && fragmentShader) {
+
+		shaderProgram = glCreateProgram();
+		glAttachShader(shaderProgram, vertexShader);
+		glAttachShader(shaderProgram, fragmentShader);
+		glBindAttribLocation(shaderProgram, 0, "position");
+		glBindAttribLocation(shaderProgram, 1, "texCoord");
+		glLinkProgram(shaderProgram);
+		glGetProgramiv(shaderProgram, GL_LINK_STATUS, &status);
+
+	}
+
+	if (vertexShader) glDeleteShader(vertexShader);
+	if (fragmentShader) glDeleteShader(fragmentShader);
+
+	if (status == GL_FALSE) {
+
+		deleteShaderPalette();
+
+		return false;
+
+	}
+
+	glUseProgram(shaderProgram);
+	glUniform1i(glGetUniformLocation(shaderProgram, "indices"), 0);
+	glUniform1i(glGetUniformLocation(shaderProgram, "palette"), 1);
+	extentUniform = glGetUniformLocation(shaderProgram, "extent");
+	glUniform2f(extentUniform, 1.0f, 1.0f);
+	fadeUniform = glGetUniformLocation(shaderProgram, "fade");
+	glUniform2f(fadeUniform, 1.0f, 0.0f);
+
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, quadPositions);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, quadCoords);
+	glEnableVertexAttribArray(1);
+
+	// Palette indices stay bound to the first unit, the palette to the second
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	paletteTexture = createTexture(GL_TEXTURE1, GL_RGBA, 256, 1);
+	indexTexture = createTexture(GL_TEXTURE0, GL_LUMINANCE, screen->w, screen->h);
+
+	paletteChanged = true;
+
+	#ifdef RENDER_THREAD
+	startRenderer();
 	#endif
 
+	return true;
+
+}
+
+
+/**
+ * Upload the changed rows of a frame's palette indices, and its palette if
+ * necessary, then draw and present it.
+ *
+ * @param pixels The frame's palette indices, laid out as the screen's
+ * @param top First row which has changed
+ * @param bottom Row after the last row which has changed
+ * @param colors The frame's palette
+ * @param uploadPalette Whether or not the palette has changed
+ * @param shownW Width of the part of the frame to show
+ * @param shownH Height of the part of the frame to show
+ * @param fade The fade to present the frame with
+ */
+void Video::presentIndices (unsigned char* pixels, int top, int bottom, SDL_Color* colors, bool uploadPalette, int shownW, int shownH, PaletteFade* fade) {
+
+	int width, height, scale, y;
+
+	// Only the thread holding the context can change how it waits
+	if (shownInterval != swapInterval) {
+
+		SDL_GL_SetSwapInterval(swapInterval);
+		shownInterval = swapInterval;
+
+	}
+
+	if (uploadPalette) {
+
+		glActiveTexture(GL_TEXTURE1);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 1, GL_RGBA, GL_UNSIGNED_BYTE, colors);
+		glActiveTexture(GL_TEXTURE0);
+
+	}
+
+	if ((bottom > top) && (screen->pitch == screen->w)) {
+
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, top, screen->w, bottom - top, GL_LUMINANCE, GL_UNSIGNED_BYTE,
+			pixels + (screen->pitch * top));
+
+	} else {
+
+		for (y = top; y < bottom; y++)
+			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y, screen->w, 1, GL_LUMINANCE, GL_UNSIGNED_BYTE,
+				pixels + (screen->pitch * y));
+
+	}
+
+	// Let the shader look up the colours while stretching to the window
+	glUniform2f(extentUniform, (GLfloat)shownW / screen->w, (GLfloat)shownH / screen->h);
+	glUniform2f(fadeUniform, (GLfloat)fade->scale / F1, (GLfloat)fade->white / F1);
+	SDL_GL_GetDrawableSize(window, &width, &height);
+
+	if (integerScale) {
+
+		// Centre the largest whole multiple of the screen which fits
+		scale = (width / screen->w < height / screen->h)? width / screen->w: height / screen->h;
+		if (scale < 1) scale = 1;
+
+		glClear(GL_COLOR_BUFFER_BIT);
+		glViewport((width - (screen->w * scale)) >> 1, (height - (screen->h * scale)) >> 1,
+			screen->w * scale, screen->h * scale);
+
+	} else glViewport(0, 0, width, height);
+
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+	SDL_GL_SwapWindow(window);
+
+	return;
+
+}
+
+
+/**
+ * Delete the OpenGL ES 2 context, shader and textures, and their window.
+ */
+void Video::deleteShaderPalette () {
+
+	// The context must be current here to delete anything
+	finishRendering();
+
+	if (indexTexture) glDeleteTextures(1, &indexTexture);
+	if (paletteTexture) glDeleteTextures(1, &paletteTexture);
+	if (shaderProgram) glDeleteProgram(shaderProgram);
+
+	indexTexture = 0;
+	paletteTexture = 0;
+	shaderProgram = 0;
+
+	if (glContext) SDL_GL_DeleteContext(glContext);
+	glContext = NULL;
+
+	if (window) SDL_DestroyWindow(window);
+	window = NULL;
+
+	return;
+
+}
+#endif
+
+
+#ifdef RENDER_THREAD
+/**
+ * Render thread. Presents each frame handed to it, while the main thread
+ * carries on with the next.
+ *
+ * @param data The video output object
+ *
+ * @return Thread exit code
+ */
+int Video::runRenderer (void* data) {
+
+	Video* video;
+
+	video = (Video *)data;
+
+	SDL_GL_MakeCurrent(video->window, video->glContext);
+
+	while (true) {
+
+		SDL_SemWait(video->frameReady);
+
+		if (video->renderQuit) break;
+
+		video->presentIndices(video->shownPixels, video->frameTop, video->frameBottom,
+			video->framePalette, video->framePaletteChanged, video->frameW, video->frameH,
+			&(video->frameFade));
+
+		SDL_SemPost(video->frameFree);
+
+	}
+
+	SDL_GL_MakeCurrent(video->window, NULL);
+
+	return 0;
+
+}
+
+
+/**
+ * Start presenting frames on the render thread, which takes over the OpenGL ES
+ * context. Frames are presented here if the thread cannot be started.
+ */
+void Video::startRenderer () {
+
+	renderQuit = false;
+	frameReady = SDL_CreateSemaphore(0);
+	frameFree = SDL_CreateSemaphore(1);
+
+	if (frameReady && frameFree) {
+
+		// The context can only be current on one thread at a time
+		SDL_GL_MakeCurrent(window, NULL);
+
+		renderThread = SDL_CreateThread(runRenderer, "Render", this);
+
+		if (renderThread) return;
+
+		SDL_GL_MakeCurrent(window, glContext);
+
+	}
+
+	if (frameReady) SDL_DestroySemaphore(frameReady);
+	if (frameFree) SDL_DestroySemaphore(frameFree);
+
+	frameReady = NULL;
+	frameFree = NULL;
+
+	return;
+
+}
+#endif
+
+
+/**
+ * Wait for the last frame to be presented, and stop the render thread, taking
+ * the OpenGL ES context back. Must be done before the window is destroyed.
+ */
+void Video::finishRendering () {
+
+#ifdef RENDER_THREAD
+	if (!renderThread) return;
+
+	SDL_SemWait(frameFree);
+
+	renderQuit = true;
+	SDL_SemPost(frameReady);
+
+	SDL_WaitThread(renderThread, NULL);
+	renderThread = NULL;
+
+	SDL_DestroySemaphore(frameReady);
+	SDL_DestroySemaphore(frameFree);
+
+	frameReady = NULL;
+	frameFree = NULL;
+
+	SDL_GL_MakeCurrent(window, glContext);
+#endif
+
 	return;
 
 }
@@ -551,15 +1786,51 @@ void Video::update (SDL_Event *event) {
 void Video::flip (int mspf, PaletteEffect* paletteEffects, bool effectsStopped) {
 
 	SDL_Color shownPalette[256];
+	PaletteFade fade;
+
+	// Nothing is shown without a window
+	if (headless) return;
+
+	fade.scale = F1;
+	fade.white = 0;
+
+	PROFILE_BEGIN(PZ_FLIP);
 
 #ifdef SCALE
 	if (canvas != screen) {
 
+		bench.enter(BS_SCALE);
+
 		// Copy everything that has been drawn so far
-		scale(scaleFactor,
-			screen->pixels, screen->pitch,
-			canvas->pixels, canvas->pitch,
-			screen->format->BytesPerPixel, canvas->w, canvas->h);
+		if (jobs.getWorkers() && (scaleFactor < 4)) {
+
+			// Split the canvas into bands, and share them between the cores
+			SDL_AtomicSet(&scaleBand, 0);
+
+			jobs.prepare(&scaleDone, NULL, NULL, NULL, false);
+
+			for (int count = 0; (count < MAX_SCALE_THREADS) && (count < jobs.getWorkers()); count++) {
+
+				jobs.prepare(scaleJobs + count, scaleJob, this, &scaleDone, false);
+				jobs.submit(scaleJobs + count);
+
+			}
+
+			scaleBands();
+
+			jobs.submit(&scaleDone);
+			jobs.wait(&scaleDone);
+
+		} else {
+
+			scale(scaleFactor,
+				screen->pixels, screen->pitch,
+				canvas->pixels, canvas->pitch,
+				screen->format->BytesPerPixel, canvas->w, canvas->h);
+
+		}
+
+		bench.leave(BS_SCALE);
 
 	}
 #endif
@@ -567,6 +1838,9 @@ void Video::flip (int mspf, PaletteEffect* paletteEffects, bool effectsStopped)
 	// Apply palette effects
 	if (paletteEffects) {
 
+		bench.enter(BS_PALETTE);
+		PROFILE_BEGIN(PZ_PALETTE);
+
 		/* If the palette is being emulated, compile all palette changes and
 		apply them all at once.
 		If the palette is being used directly, apply all palette effects
@@ -576,11 +1850,12 @@ void Video::flip (int mspf, PaletteEffect* paletteEffects, bool effectsStopped)
 
 			memcpy(shownPalette, currentPalette, sizeof(SDL_Color) * 256);
 
-			paletteEffects->apply(shownPalette, false, mspf, effectsStopped);
-
 			#ifdef SDL2
-			SDL_SetPaletteColors(screen->format->palette, shownPalette, 0, 256);
+			// Fades are left for the frame to be presented with
+			paletteEffects->apply(shownPalette, false, mspf, effectsStopped, &fade);
+			changePalette(shownPalette, 0, 256);
 			#else
+			paletteEffects->apply(shownPalette, false, mspf, effectsStopped);
 			SDL_SetPalette(screen, SDL_PHYSPAL, shownPalette, 0, 256);
 			#endif
 		} else {
@@ -589,38 +1864,193 @@ void Video::flip (int mspf, PaletteEffect* paletteEffects, bool effectsStopped)
 
 		}
 
+		PROFILE_END(PZ_PALETTE);
+		bench.leave(BS_PALETTE);
+
 	}
 
+	// Copy the frame for screenshots and clips, with the palette it is shown
+	// with
+#ifdef SDL2
+	capture.grab(canvas, canvasW, canvasH, screen->format->palette->colors, &fade);
+#endif
+
 	// Show what has been drawn
 
 #ifdef SDL2
-	
-	uint8_t r,g,b;
-	int npixels = screen->w * screen->h;
-	uint8_t index;
-	for (int i = 0; i < npixels; i++) {
-		// Use BGRA, same as the texture format
-		index = ((uint8_t*)screen->pixels)[i];
-		r = screen->format->palette->colors[index].r;
-		g = screen->format->palette->colors[index].g;
-		b = screen->format->palette->colors[index].b;
-		//printf ("r %d g %d b %d\n", r, g, b);
-		uint32_t RGBColor = ((r << 24) | (g << 16) | (b << 8)) | (0xff << 0);
-		//memcpy (((uint32_t*)helper_surface->pixels) + i, &RGBColor, 4);
-		((uint32_t*)(helper_surface->pixels))[i] = RGBColor;
-	}
-    SDL_SetPaletteColors(helper_surface->format->palette, canvas->format->palette->colors, 0, 256);
-	SDL_BlitSurface(helper_surface, NULL, helper_surface, NULL); 	
-    
-	SDL_UpdateTexture(texture, NULL, helper_surface->pixels, helper_surface->pitch); 
-
-	// Rendercopy the texture to the renderer, and present on screen!
-	SDL_RenderCopy(renderer, texture, NULL, NULL);
-	SDL_RenderPresent(renderer); 
+
+	int top, bottom, shownW, shownH;
+
+	// A shrunk canvas only fills part of the screen, and is stretched to
+	// fill the window
+	if (dynamicPercent < 100) {
+
+		shownW = canvasW;
+		shownH = canvasH;
+
+	} else {
+
+		shownW = screen->w;
+		shownH = screen->h;
+
+	}
+
+	#ifdef RENDER_THREAD
+	// The render thread presents from the copy of what was last shown, so
+	// must have finished with it
+	if (renderThread) {
+
+		bench.enter(BS_PRESENT);
+		SDL_SemWait(frameFree);
+		bench.leave(BS_PRESENT);
+
+	}
+	#endif
+
+	bench.enter(BS_CONVERT);
+
+	// Only rows which have changed need to be converted and uploaded
+	findChangedRows(&top, &bottom);
+
+	#ifdef SHADER_PALETTE
+	if (glContext) {
+
+		#ifdef RENDER_THREAD
+		if (renderThread) {
+
+			// Hand the frame over, and carry on while it is presented
+			frameTop = top;
+			frameBottom = bottom;
+			frameW = shownW;
+			frameH = shownH;
+			frameFade = fade;
+			framePaletteChanged = paletteChanged;
+
+			if (paletteChanged)
+				memcpy(framePalette, screen->format->palette->colors, sizeof(SDL_Color) * 256);
+
+			paletteChanged = false;
+
+			bench.leave(BS_CONVERT);
+
+			SDL_SemPost(frameReady);
+
+		} else
+		#endif
+		{
+
+			bench.leave(BS_CONVERT);
+			bench.enter(BS_PRESENT);
+
+			presentIndices((unsigned char *)(screen->pixels), top, bottom,
+				screen->format->palette->colors, paletteChanged, shownW, shownH, &fade);
+
+			paletteChanged = false;
+
+			bench.leave(BS_PRESENT);
+
+		}
+
+	} else
+	#endif
+	{
+
+		SDL_Rect src, dst;
+		void* pixels;
+		int pitch;
+
+		// A new palette changes the colour of every row, as do tiles drawn
+		// into the 32-bit canvas, which is not compared
+		if (paletteChanged || trueFrame) {
+
+			top = 0;
+			bottom = screen->h;
+
+			paletteChanged = false;
+
+		}
+
+		// The next frame may be drawn in 8 bits, so cannot be compared with
+		// this one
+		if (trueFrame) shownValid = false;
+
+		// Rows beyond a shrunk canvas are not shown
+		if (bottom > shownH) bottom = shownH;
+
+		dst.x = 0;
+		dst.y = top;
+		dst.w = shownW;
+		dst.h = bottom - top;
+
+		// Convert the display's palette indices straight into texture pixels
+		if ((bottom > top) && (SDL_LockTexture(texture, &dst, &pixels, &pitch) == 0)) {
+
+			for (int y = top; y < bottom; y++) {
+
+				if (trueFrame) {
+
+					composeRow(((unsigned char *)(screen->pixels)) + (screen->pitch * y),
+						trueCanvas + (screen->pitch * y),
+						(Uint32 *)(((unsigned char *)pixels) + (pitch * (y - top))),
+						shownW, paletteLUT);
+
+				} else {
+
+					expandRow(((unsigned char *)(screen->pixels)) + (screen->pitch * y),
+						(Uint32 *)(((unsigned char *)pixels) + (pitch * (y - top))),
+						shownW, paletteLUT);
+
+				}
+
+			}
+
+			SDL_UnlockTexture(texture);
+
+		}
+
+		trueFrame = false;
+
+		bench.leave(BS_CONVERT);
+		bench.enter(BS_PRESENT);
+
+		// Borders are left around whole multiples
+		if (integerScale) SDL_RenderClear(renderer);
+
+		src.x = 0;
+		src.y = 0;
+		src.w = shownW;
+		src.h = shownH;
+
+		// Darken the texture as it is copied, then add any white over it
+		SDL_SetTextureColorMod(texture, (fade.scale * 255) >> 10,
+			(fade.scale * 255) >> 10, (fade.scale * 255) >> 10);
+
+		// Rendercopy the texture to the renderer, and present on screen!
+		SDL_RenderCopy(renderer, texture, &src, NULL);
+
+		if (fade.white) {
+
+			SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_ADD);
+			SDL_SetRenderDrawColor(renderer, 255, 255, 255, (fade.white * 255) >> 10);
+			SDL_RenderFillRect(renderer, NULL);
+
+			// Borders are cleared to black
+			SDL_SetRenderDrawBlendMode(renderer, SDL_BLENDMODE_NONE);
+			SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
+
+		}
+
+		SDL_RenderPresent(renderer); 
+
+		bench.leave(BS_PRESENT);
+
+	}
 #else
 	SDL_Flip(screen);
 #endif  //SDL2
 
+	PROFILE_END(PZ_FLIP);
+
 	return;
 
 }
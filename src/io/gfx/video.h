@@ -24,6 +24,8 @@
 
 #include "paletteeffects.h"
 
+#include "jobs.h"
+
 #define SDL2
 
 #ifdef SDL2
@@ -32,6 +34,18 @@
 #include <SDL.h>
 #endif
 
+// Expand the palette on the GPU where OpenGL ES 2 is available
+#if defined(SDL2) && defined(__SWITCH__)
+	#define SHADER_PALETTE
+#endif
+
+#ifdef SHADER_PALETTE
+	#include <GLES2/gl2.h>
+
+	// Present frames on their own thread, while the next frame is simulated
+	#define RENDER_THREAD
+#endif
+
 
 // Constants
 
@@ -42,6 +56,10 @@
 #define MIN_SCALE 1
 #ifdef SCALE
 	#define MAX_SCALE 4
+
+	// Scaling is shared between this many jobs, plus the main thread
+	#define MAX_SCALE_THREADS 3
+	#define SCALE_BANDS 8
 #else
 	#define MAX_SCALE 1
 #endif
@@ -105,6 +123,19 @@
 // Time interval
 #define T_MENU_FRAME 20
 
+// Canvas palette index through which the true-colour canvas shows. It is
+// the sprites' colour key, so no sprite ever draws it.
+#define SEE_THROUGH 254
+
+// Dynamic resolution
+#ifndef DYNAMIC_MIN
+	#define DYNAMIC_MIN 60 /* Smallest canvas size, as a percentage of the screen's */
+#endif
+#define DYNAMIC_STEP 10 /* Change in canvas size, as a percentage of the screen's */
+#define DYNAMIC_HIGH 90 /* Share of each frame's interval spent working above which the canvas shrinks */
+#define DYNAMIC_LOW  60 /* Share below which the canvas grows again */
+#define DYNAMIC_HOLD 60 /* Frames after a change before the canvas size can change again */
+
 
 // Class
 
@@ -118,7 +149,6 @@ class Video {
 		SDL_Window* window;
 		SDL_Renderer* renderer;
 		SDL_Texture* texture;
-		SDL_Surface* helper_surface;
 
 		SDL_Surface  *screen;
 		SDL_Surface  *rgb_screen;
@@ -131,6 +161,45 @@ class Video {
 		SDL_Color*   currentPalette; ///< Current palette
 		SDL_Color    logicalPalette[256]; ///< Logical palette (greyscale)
 		bool         fakePalette; ///< Whether or not the palette mode is being emulated
+#ifdef SDL2
+		Uint32       paletteLUT[256]; ///< Display palette as texture pixel values
+		bool         paletteChanged; ///< Whether or not the display palette has changed since the last frame
+		Uint32       paletteEpoch; ///< Incremented whenever the display palette changes
+		SDL_Palette* sharedPalette; ///< Palette of every surface whose colours have not been changed
+		Uint32       sharedEpoch; ///< Palette epoch the shared palette was last synced to
+		SDL_mutex*   paletteLock; ///< Guards the shared palette's references, as surfaces are made and freed on any thread
+		unsigned char* shownPixels; ///< Copy of the screen as last shown
+		bool         shownValid; ///< Whether or not shownPixels can be compared against
+		bool         dynamicResolution; ///< Whether or not the canvas shrinks when frames take too long
+		int          dynamicPercent; ///< Canvas size as a percentage of the screen's
+		int          dynamicHold; ///< Frames before the canvas size can change again
+		Uint32*      trueCanvas; ///< 32-bit pixels shown wherever the canvas is see-through, or NULL until first used
+		bool         trueColour; ///< Whether or not levels draw their tiles into the 32-bit canvas
+		bool         trueFrame; ///< Whether or not the coming frame has been drawn into the 32-bit canvas
+#endif
+#ifdef SHADER_PALETTE
+		SDL_GLContext glContext; ///< Context used for shader palette expansion, or NULL
+		GLuint       shaderProgram; ///< Palette expansion shader
+		GLuint       indexTexture; ///< Screen palette indices
+		GLuint       paletteTexture; ///< Display palette
+		GLint        extentUniform; ///< Share of the screen's palette indices shown
+		GLint        fadeUniform; ///< Fade the frame is presented with
+		int          swapInterval; ///< Swap interval wanted
+		int          shownInterval; ///< Swap interval in use, set by whichever thread presents
+#endif
+#ifdef RENDER_THREAD
+		SDL_Thread*  renderThread; ///< Thread presenting frames, or NULL to present them here
+		SDL_sem*     frameReady; ///< Signalled when a frame has been handed to the render thread
+		SDL_sem*     frameFree; ///< Signalled when the render thread has finished presenting
+		SDL_Color    framePalette[256]; ///< Display palette of the frame being presented
+		bool         framePaletteChanged; ///< Whether or not the frame's palette needs uploading
+		int          frameTop; ///< First row of the frame which has changed
+		int          frameBottom; ///< Row after the last row of the frame which has changed
+		int          frameW; ///< Width of the part of the frame shown
+		int          frameH; ///< Height of the part of the frame shown
+		PaletteFade  frameFade; ///< Fade the frame is presented with
+		bool         renderQuit; ///< Whether or not the render thread should exit
+#endif
 
 		int          maxW; ///< Largest possible width
 		int          maxH; ///< Largest possible height
@@ -138,16 +207,41 @@ class Video {
 		int          screenH; ///< Real height
 #ifdef SCALE
 		int          scaleFactor; ///< Scaling factor
+		Job          scaleJobs[MAX_SCALE_THREADS]; ///< Jobs helping to scale the canvas
+		Job          scaleDone; ///< Done once the whole canvas has been scaled
+		SDL_atomic_t scaleBand; ///< The next band of the canvas to be scaled
 #endif
 		bool         fullscreen; ///< Full-screen mode
+		bool         integerScale; ///< Whether or not the canvas is only enlarged by whole multiples
 
 		void findMaxResolution ();
+#ifdef SCALE
+		static void scaleJob   (void* data);
+		void scaleBands        ();
+#endif
 		void expose            ();
+#ifdef SDL2
+		void applyScaling      ();
+		void updatePaletteLUT  (int first, int amount);
+		void findChangedRows   (int* top, int* bottom);
+		void resizeCanvas      (int percent);
+#endif
+#ifdef SHADER_PALETTE
+		bool createShaderPalette ();
+		void deleteShaderPalette ();
+		void presentIndices      (unsigned char* pixels, int top, int bottom, SDL_Color* colors, bool uploadPalette, int width, int height, PaletteFade* fade);
+#endif
+#ifdef RENDER_THREAD
+		static int runRenderer   (void* data);
+		void startRenderer       ();
+#endif
 
 	public:
 		Video ();
+		~Video ();
 
 		bool       init                  (int width, int height, bool startFullscreen);
+		bool       initHeadless          ();
 
 		bool       reset                (int width, int height);
 
@@ -155,6 +249,13 @@ class Video {
 		SDL_Color* getPalette            ();
 		void       changePalette         (SDL_Color *palette, unsigned char first, unsigned int amount);
 		void       restoreSurfacePalette (SDL_Surface *surface);
+#ifdef SDL2
+		void       syncSurfacePalette    (SDL_Surface *surface);
+		void       forgetSurfacePalette  (SDL_Surface *surface);
+		void       shareSurfacePalette   (SDL_Surface *surface);
+		void       ownSurfacePalette     (SDL_Surface *surface);
+		void       releaseSurface        (SDL_Surface *surface);
+#endif
 
 		int        getMaxWidth           ();
 		int        getMaxHeight          ();
@@ -167,9 +268,24 @@ class Video {
 #ifndef FULLSCREEN_ONLY
 		bool       isFullscreen          ();
 #endif
+		bool       isIntegerScale        ();
+		void       setIntegerScale       (bool enable);
+		void       setVsync              (bool enable);
+#ifdef SDL2
+		bool       isDynamicResolution   ();
+		void       setDynamicResolution  (bool enable);
+		void       adaptResolution       (int load);
+		void       fullResolution        ();
+		bool       isTrueColour          ();
+		void       setTrueColour         (bool enable);
+		Uint32*    getTrueCanvas         ();
+		Uint32*    getPaletteLUT         ();
+		Uint32     getPaletteEpoch       ();
+#endif
 
 		void       update                (SDL_Event *event);
 		void       flip                  (int mspf, PaletteEffect* paletteEffects = NULL, bool effectsStopped = false);
+		void       finishRendering       ();
 
 		void       clearScreen           (int index);
 
@@ -178,6 +294,10 @@ class Video {
 
 // Variables
 
+/* Everything is drawn to the 8-bit canvas, apart from level tiles in
+true-colour mode. Palette indices are only expanded when a frame is shown, on
+the GPU where possible and otherwise only for rows which have changed, so
+palette effects never require anything to be redrawn. */
 EXTERN SDL_Surface* canvas; ///< Surface used for drawing
 EXTERN int          canvasW; ///< Drawing surface width
 EXTERN int          canvasH; ///< Drawing surface height
@@ -188,7 +308,13 @@ EXTERN Video video; ///< Video output
 // Functions
 
 EXTERN SDL_Surface*   createSurface  (unsigned char* pixels, int width, int height);
+EXTERN SDL_Surface*   wrapSurface    (unsigned char* pixels, int width, int height);
+EXTERN void           freeSurface    (SDL_Surface* surface);
 EXTERN void           drawRect       (int x, int y, int width, int height, int index);
+#ifdef SDL2
+EXTERN void           expandRow      (const unsigned char* src, Uint32* dst, int width, const Uint32* lut);
+EXTERN void           composeRow     (const unsigned char* src, const Uint32* under, Uint32* dst, int width, const Uint32* lut);
+#endif
 
 #endif
 
@@ -0,0 +1,831 @@
+
+/**
+ *
+ * @file inflate.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created inflate.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Inflates a zlib stream held wholly in memory. Bits are kept in a 64-bit
+ * buffer, refilled once for each literal or match. Huffman codes are looked
+ * up in a table indexed by the next bits, whose entries can hold two literals
+ * at once, with a subtable for each group of longer codes. Matches are copied
+ * in 16 or 8 byte chunks where they cannot overlap themselves.
+ *
+ * Anything unusual, whether a corrupt stream, a truncated one, or a code
+ * miniz would decode in its own way, is handed back to miniz's tinfl, so the
+ * results are always exactly those tinfl would give.
+ *
+ */
+
+
+#include "inflate.h"
+
+#include "../miniz.h"
+
+#include <string.h>
+
+
+// Kinds of table entry
+#define IE_LITERAL  0x00 /* A literal */
+#define IE_LITERALS 0x10 /* Two literals */
+#define IE_LENGTH   0x20 /* A match length or distance */
+#define IE_END      0x30 /* The end of the block */
+#define IE_SUBTABLE 0x40 /* A longer code, to be found in a subtable */
+#define IE_INVALID  0x50 /* No code, or one left to tinfl */
+#define IE_KIND     0xF0
+
+// Alphabets
+#define IA_LITERALS   0 /* Literals, lengths and the end of the block */
+#define IA_DISTANCES  1 /* Match distances */
+#define IA_CODELENGTH 2 /* Code lengths of the other alphabets */
+
+// Outcomes of inflating a block
+#define IS_END    0 /* Reached the end of the block */
+#define IS_FULL   1 /* Filled the output */
+#define IS_FAILED 2 /* Hit something to be left to tinfl */
+
+// Table sizes. Subtables are sized for the longest code of the alphabet, and
+// there can be at most one for each code longer than the table's bits
+#define LITERAL_TABLE  ((1 << INFLATE_LITERAL_BITS) + (288 << (15 - INFLATE_LITERAL_BITS)))
+#define DISTANCE_TABLE ((1 << INFLATE_DISTANCE_BITS) + (32 << (15 - INFLATE_DISTANCE_BITS)))
+#define LENGTH_BITS    7
+
+#define MASK(bits) ((1U << (bits)) - 1)
+
+
+// Datatype
+
+/// Input being read a bit at a time
+typedef struct {
+
+	const unsigned char* next; ///< The next byte to be added to the buffer
+	const unsigned char* end; ///< The end of the input
+	unsigned long long   bits; ///< Bits read but not yet used, lowest first
+	int                  count; ///< Number of bits in the buffer
+	int                  padding; ///< Bytes of zeros added to the buffer beyond the end of the input
+
+} InflateBits;
+
+
+// Class
+
+/// Huffman tables for inflating a block
+class Inflater {
+
+	private:
+		unsigned int literals[LITERAL_TABLE]; ///< Literal, length and end codes
+		unsigned int distances[DISTANCE_TABLE]; ///< Distance codes
+		unsigned int lengths[1 << LENGTH_BITS]; ///< Code length codes
+
+		bool readTables (InflateBits& in);
+		void readFixed  ();
+
+	public:
+		int run (const unsigned char* input, int inputLength, unsigned char* output, int length);
+
+};
+
+
+static const unsigned short lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const unsigned char lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const unsigned short distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const unsigned char distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+static const unsigned char lengthOrder[19] = {16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15};
+
+
+/**
+ * Top up the bit buffer to at least 56 bits, which covers a literal or a
+ * whole match. Beyond the end of the input, zeros are added.
+ *
+ * @param in The input
+ */
+static inline void refill (InflateBits& in) {
+
+#if INFLATE_WIDE_REFILL
+	unsigned long long word;
+
+	// Bits above the count are the bytes which follow, so loading them again
+	// leaves them unchanged
+	if (in.end - in.next >= 8) {
+
+		memcpy(&word, in.next, 8);
+		in.bits |= word << in.count;
+		in.next += (63 - in.count) >> 3;
+		in.count |= 56;
+
+		return;
+
+	}
+#endif
+
+	while (in.count < 56) {
+
+		if (in.next < in.end) in.bits |= ((unsigned long long)*(in.next++)) << in.count;
+		else in.padding++;
+
+		in.count += 8;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Use bits from the buffer.
+ *
+ * @param in The input
+ * @param bits Number of bits
+ */
+static inline void consume (InflateBits& in, int bits) {
+
+	in.bits >>= bits;
+	in.count -= bits;
+
+	return;
+
+}
+
+
+/**
+ * Take bits from the buffer.
+ *
+ * @param in The input
+ * @param bits Number of bits
+ *
+ * @return The bits
+ */
+static inline unsigned int take (InflateBits& in, int bits) {
+
+	unsigned int value;
+
+	value = in.bits & MASK(bits);
+	consume(in, bits);
+
+	return value;
+
+}
+
+
+/**
+ * Check whether any of the zeros added beyond the end of the input have been
+ * used, in which case the stream was truncated.
+ *
+ * @param in The input
+ *
+ * @return Whether or not the input has been overrun
+ */
+static inline bool overrun (InflateBits& in) {
+
+	return in.count < (in.padding << 3);
+
+}
+
+
+/**
+ * Decode a code, using its table and any subtable.
+ *
+ * @param in The input
+ * @param table The table
+ * @param bits The number of bits the table is indexed by
+ *
+ * @return The code's table entry
+ */
+static inline unsigned int decode (InflateBits& in, const unsigned int* table, int bits) {
+
+	unsigned int entry;
+
+	entry = table[in.bits & MASK(bits)];
+
+	if ((entry & IE_KIND) == IE_SUBTABLE) {
+
+		consume(in, entry & 15);
+		entry = table[(entry >> 16) + (in.bits & MASK((entry >> 8) & 255))];
+
+	}
+
+	consume(in, entry & 15);
+
+	return entry;
+
+}
+
+
+/**
+ * Find the table entry for a symbol, apart from its code length.
+ *
+ * @param alphabet The symbol's alphabet
+ * @param symbol The symbol
+ *
+ * @return The entry
+ */
+static unsigned int getEntry (int alphabet, int symbol) {
+
+	if (alphabet == IA_LITERALS) {
+
+		if (symbol < 256) return IE_LITERAL | (symbol << 8);
+		if (symbol == 256) return IE_END;
+
+		// Symbols 286 and 287 are not meant to appear
+		if (symbol < 286) return IE_LENGTH | (lengthExtra[symbol - 257] << 8) | (lengthBase[symbol - 257] << 16);
+
+		return IE_INVALID;
+
+	}
+
+	if (alphabet == IA_DISTANCES) {
+
+		if (symbol < 30) return IE_LENGTH | (distanceExtra[symbol] << 8) | (distanceBase[symbol] << 16);
+
+		return IE_INVALID;
+
+	}
+
+	return IE_LITERAL | (symbol << 8);
+
+}
+
+
+/**
+ * Build the table for a Huffman code from its code lengths. As in tinfl, an
+ * incomplete code is only accepted if it has at most one symbol.
+ *
+ * @param codeLengths The code length of each symbol, or 0 if it is unused
+ * @param symbols The number of symbols
+ * @param alphabet The alphabet the symbols belong to
+ * @param table The table
+ * @param tableSize The number of entries in the table
+ * @param bits The number of bits the table is indexed by
+ *
+ * @return Whether or not the code is valid
+ */
+static bool buildTable (const unsigned char* codeLengths, int symbols, int alphabet, unsigned int* table, int tableSize, int bits) {
+
+	int counts[16];
+	int codes[16];
+	unsigned int entry;
+	int symbol, length, code, reversed, left, used, longest, subBits, nextSub, sub, count;
+
+	for (length = 0; length < 16; length++) counts[length] = 0;
+	for (symbol = 0; symbol < symbols; symbol++) counts[codeLengths[symbol]]++;
+
+	left = 1;
+	used = 0;
+	longest = 0;
+	code = 0;
+
+	for (length = 1; length < 16; length++) {
+
+		left = (left << 1) - counts[length];
+
+		if (left < 0) return false;
+
+		used += counts[length];
+		if (counts[length]) longest = length;
+
+		code = (code + counts[length - 1]) << 1;
+		codes[length] = code;
+
+	}
+
+	if (left && (used > 1)) return false;
+
+	subBits = (longest > bits)? longest - bits: 0;
+	nextSub = 1 << bits;
+
+	for (count = 0; count < (1 << bits); count++) table[count] = IE_INVALID;
+
+	for (symbol = 0; symbol < symbols; symbol++) {
+
+		length = codeLengths[symbol];
+
+		if (!length) continue;
+
+		// Codes are read from the highest bit down, so are reversed to index
+		// the table by the bits as they are read
+		code = codes[length]++;
+		reversed = 0;
+
+		for (count = 0; count < length; count++) reversed |= ((code >> count) & 1) << (length - 1 - count);
+
+		entry = getEntry(alphabet, symbol);
+
+		if (length <= bits) {
+
+			for (count = reversed; count < (1 << bits); count += 1 << length) table[count] = entry | length;
+
+		} else {
+
+			sub = reversed & MASK(bits);
+
+			if ((table[sub] & IE_KIND) != IE_SUBTABLE) {
+
+				if (nextSub + (1 << subBits) > tableSize) return false;
+
+				table[sub] = IE_SUBTABLE | bits | (subBits << 8) | (nextSub << 16);
+
+				for (count = 0; count < (1 << subBits); count++) table[nextSub + count] = IE_INVALID;
+
+				nextSub += 1 << subBits;
+
+			}
+
+			sub = table[sub] >> 16;
+
+			for (count = reversed >> bits; count < (1 << subBits); count += 1 << (length - bits))
+				table[sub + count] = entry | (length - bits);
+
+		}
+
+	}
+
+	if (alphabet != IA_LITERALS) return true;
+
+	// Where the bits left after a literal hold a whole second literal, the
+	// entry gives both. Entries are combined from the end, so that the ones
+	// each looks at are still single.
+	for (count = (1 << bits) - 1; count >= 0; count--) {
+
+		entry = table[count];
+
+		if ((entry & IE_KIND) != IE_LITERAL) continue;
+
+		length = entry & 15;
+		code = table[count >> length];
+
+		if (((code & IE_KIND) == IE_LITERAL) && (length + (code & 15) <= bits))
+			table[count] = IE_LITERALS | (length + (code & 15)) | (entry & 0xFF00) | ((code & 0xFF00) << 8);
+
+	}
+
+	return true;
+
+}
+
+
+/**
+ * Copy a match, whose length fits in the output.
+ *
+ * @param out Where the match goes
+ * @param distance The distance back to the start of the match
+ * @param length The length of the match
+ * @param end The end of the output
+ */
+static inline void copyMatch (unsigned char* out, int distance, int length, unsigned char* end) {
+
+	const unsigned char* source;
+
+	source = out - distance;
+
+	// Whole chunks are copied, so there must be room beyond the match
+	if (end - out >= length + 16) {
+
+		if (distance >= 16) {
+
+			do {
+
+				memcpy(out, source, 16);
+				out += 16;
+				source += 16;
+				length -= 16;
+
+			} while (length > 0);
+
+			return;
+
+		}
+
+		if (distance >= 8) {
+
+			do {
+
+				memcpy(out, source, 8);
+				out += 8;
+				source += 8;
+				length -= 8;
+
+			} while (length > 0);
+
+			return;
+
+		}
+
+	}
+
+	if (distance == 1) {
+
+		memset(out, *source, length);
+
+		return;
+
+	}
+
+	while (length--) *(out++) = *(source++);
+
+	return;
+
+}
+
+
+/**
+ * Inflate the codes of a compressed block. Like tinfl, decoding carries on
+ * once the output is full, until a literal or match needs room.
+ *
+ * @param input The input
+ * @param literals The literal and length table
+ * @param distances The distance table
+ * @param start The start of the output
+ * @param output Where the block's output goes, advanced past it
+ * @param end The end of the output
+ *
+ * @return The outcome
+ */
+static int inflateCodes (InflateBits& input, const unsigned int* literals, const unsigned int* distances,
+	unsigned char* start, unsigned char*& output, unsigned char* end) {
+
+	InflateBits in;
+	unsigned char* out;
+	unsigned int entry;
+	int length, distance, outcome;
+
+	// Local copies stay in registers, rather than being reloaded after
+	// every byte written
+	in = input;
+	out = output;
+
+	while (true) {
+
+		refill(in);
+
+		entry = decode(in, literals, INFLATE_LITERAL_BITS);
+
+		if ((entry & IE_KIND) == IE_LITERALS) {
+
+			if (out == end) {
+
+				outcome = IS_FULL;
+
+				break;
+
+			}
+
+			*(out++) = entry >> 8;
+
+			if (out == end) {
+
+				outcome = IS_FULL;
+
+				break;
+
+			}
+
+			*(out++) = entry >> 16;
+
+			continue;
+
+		}
+
+		if ((entry & IE_KIND) == IE_LITERAL) {
+
+			if (out == end) {
+
+				outcome = IS_FULL;
+
+				break;
+
+			}
+
+			*(out++) = entry >> 8;
+
+			continue;
+
+		}
+
+		if ((entry & IE_KIND) == IE_END) {
+
+			outcome = IS_END;
+
+			break;
+
+		}
+
+		if ((entry & IE_KIND) != IE_LENGTH) {
+
+			outcome = IS_FAILED;
+
+			break;
+
+		}
+
+		length = (entry >> 16) + take(in, (entry >> 8) & 255);
+
+		entry = decode(in, distances, INFLATE_DISTANCE_BITS);
+
+		if ((entry & IE_KIND) != IE_LENGTH) {
+
+			outcome = IS_FAILED;
+
+			break;
+
+		}
+
+		distance = (entry >> 16) + take(in, (entry >> 8) & 255);
+
+		if (distance > out - start) {
+
+			outcome = IS_FAILED;
+
+			break;
+
+		}
+
+		// A match which does not fit is cut short. One which exactly fills
+		// the output can still be followed by the end of the block.
+		if (length > end - out) {
+
+			copyMatch(out, distance, end - out, end);
+			out = end;
+
+			outcome = IS_FULL;
+
+			break;
+
+		}
+
+		copyMatch(out, distance, length, end);
+		out += length;
+
+	}
+
+	input = in;
+	output = out;
+
+	return outcome;
+
+}
+
+
+
+/**
+ * Build the tables for a block compressed with the fixed codes.
+ */
+void Inflater::readFixed () {
+
+	unsigned char codeLengths[288];
+	int count;
+
+	for (count = 0; count < 144; count++) codeLengths[count] = 8;
+	for (; count < 256; count++) codeLengths[count] = 9;
+	for (; count < 280; count++) codeLengths[count] = 7;
+	for (; count < 288; count++) codeLengths[count] = 8;
+
+	buildTable(codeLengths, 288, IA_LITERALS, literals, LITERAL_TABLE, INFLATE_LITERAL_BITS);
+
+	for (count = 0; count < 32; count++) codeLengths[count] = 5;
+
+	buildTable(codeLengths, 32, IA_DISTANCES, distances, DISTANCE_TABLE, INFLATE_DISTANCE_BITS);
+
+	return;
+
+}
+
+
+/**
+ * Read the codes of a block compressed with its own codes, and build their
+ * tables.
+ *
+ * @param in The input
+ *
+ * @return Whether or not the codes are valid
+ */
+bool Inflater::readTables (InflateBits& in) {
+
+	unsigned char codeLengths[286 + 30];
+	unsigned int entry;
+	int nLiterals, nDistances, nLengths, count, repeat, value;
+
+	refill(in);
+
+	nLiterals = take(in, 5) + 257;
+	nDistances = take(in, 5) + 1;
+	nLengths = take(in, 4) + 4;
+
+	// tinfl accepts more codes than the format allows
+	if ((nLiterals > 286) || (nDistances > 30)) return false;
+
+	for (count = 0; count < 19; count++) codeLengths[count] = 0;
+
+	for (count = 0; count < nLengths; count++) {
+
+		refill(in);
+		codeLengths[lengthOrder[count]] = take(in, 3);
+
+	}
+
+	if (!buildTable(codeLengths, 19, IA_CODELENGTH, lengths, 1 << LENGTH_BITS, LENGTH_BITS)) return false;
+
+	count = 0;
+
+	while (count < nLiterals + nDistances) {
+
+		refill(in);
+
+		entry = decode(in, lengths, LENGTH_BITS);
+
+		if ((entry & IE_KIND) != IE_LITERAL) return false;
+
+		value = (entry >> 8) & 255;
+
+		if (value < 16) {
+
+			codeLengths[count++] = value;
+
+			continue;
+
+		}
+
+		if (value == 16) {
+
+			if (!count) return false;
+
+			repeat = take(in, 2) + 3;
+			value = codeLengths[count - 1];
+
+		} else if (value == 17) {
+
+			repeat = take(in, 3) + 3;
+			value = 0;
+
+		} else {
+
+			repeat = take(in, 7) + 11;
+			value = 0;
+
+		}
+
+		if (count + repeat > nLiterals + nDistances) return false;
+
+		memset(codeLengths + count, value, repeat);
+		count += repeat;
+
+	}
+
+	if (!buildTable(codeLengths, nLiterals, IA_LITERALS, literals, LITERAL_TABLE, INFLATE_LITERAL_BITS)) return false;
+
+	return buildTable(codeLengths + nLiterals, nDistances, IA_DISTANCES, distances, DISTANCE_TABLE, INFLATE_DISTANCE_BITS);
+
+}
+
+
+/**
+ * Inflate a zlib stream, stopping once the output is full.
+ *
+ * @param input The stream
+ * @param inputLength The length of the stream
+ * @param output Buffer to receive the inflated data
+ * @param length The length of the buffer
+ *
+ * @return The number of bytes inflated, or -1 if the stream is left to tinfl
+ */
+int Inflater::run (const unsigned char* input, int inputLength, unsigned char* output, int length) {
+
+	InflateBits in;
+	unsigned char* out;
+	unsigned char* end;
+	unsigned int adler;
+	int last, type, outcome, held, stored, count;
+
+	if ((inputLength < 2) || (length <= 0)) return -1;
+
+	// Compression method 8, no preset dictionary, valid check bits
+	if (((input[0] & 15) != 8) || (input[1] & 32) || (((input[0] << 8) | input[1]) % 31)) return -1;
+
+	in.next = input + 2;
+	in.end = input + inputLength;
+	in.bits = 0;
+	in.count = 0;
+	in.padding = 0;
+
+	out = output;
+	end = output + length;
+
+	do {
+
+		refill(in);
+
+		last = take(in, 1);
+		type = take(in, 2);
+
+		if (type == 0) {
+
+			// Stored blocks start at the next byte, so the whole bytes in the
+			// buffer are handed back
+			consume(in, in.count & 7);
+
+			if (overrun(in)) return -1;
+
+			held = (in.count >> 3) - in.padding;
+			in.next -= held;
+			in.bits = 0;
+			in.count = 0;
+			in.padding = 0;
+
+			if (in.end - in.next < 4) return -1;
+
+			stored = in.next[0] | (in.next[1] << 8);
+
+			if ((stored ^ (in.next[2] | (in.next[3] << 8))) != 0xFFFF) return -1;
+
+			in.next += 4;
+
+			count = (stored > end - out)? end - out: stored;
+
+			if (in.end - in.next < count) return -1;
+
+			memcpy(out, in.next, count);
+			out += count;
+			in.next += count;
+
+			if (count < stored) return length;
+
+			continue;
+
+		}
+
+		if (type == 1) readFixed();
+		else if ((type == 3) || !readTables(in)) return -1;
+
+		outcome = inflateCodes(in, literals, distances, output, out, end);
+
+		if ((outcome == IS_FAILED) || overrun(in)) return -1;
+
+		if (outcome == IS_FULL) return length;
+
+	} while (!last);
+
+
+	// The stream ends with the Adler-32 checksum of its contents
+	consume(in, in.count & 7);
+	refill(in);
+
+	adler = take(in, 8) << 24;
+	adler |= take(in, 8) << 16;
+	adler |= take(in, 8) << 8;
+	adler |= take(in, 8);
+
+	if (overrun(in) || (adler != mz_adler32(MZ_ADLER32_INIT, output, out - output))) return -1;
+
+	return out - output;
+
+}
+
+
+/**
+ * Inflate a zlib stream held wholly in memory, stopping once the output is
+ * full. Gives exactly the results of tinfl, which it falls back on for
+ * anything unusual.
+ *
+ * @param input The stream
+ * @param inputLength The length of the stream
+ * @param output Buffer to receive the inflated data
+ * @param length The length of the buffer
+ *
+ * @return The number of bytes inflated, or -1 if the stream is corrupt
+ */
+int inflateZlib (const unsigned char* input, int inputLength, unsigned char* output, int length) {
+
+	Inflater* inflater;
+	tinfl_decompressor decompressor;
+	size_t inLength, outLength;
+	int inflated;
+
+	// The tables are too big for small thread stacks
+	inflater = new Inflater;
+	inflated = inflater->run(input, inputLength, output, length);
+	delete inflater;
+
+	if (inflated >= 0) return inflated;
+
+	inLength = inputLength;
+	outLength = length;
+
+	tinfl_init(&decompressor);
+
+	if (tinfl_decompress(&decompressor, input, &inLength, output, output, &outLength,
+		TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF) < 0) return -1;
+
+	return outLength;
+
+}
+
@@ -0,0 +1,53 @@
+
+/**
+ *
+ * @file inflate.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created inflate.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Inflates zlib streams which are wholly in memory, faster than miniz.
+ *
+ */
+
+
+#ifndef _INFLATE_H
+#define _INFLATE_H
+
+
+#include "OpenJazz.h"
+
+
+// Constants
+
+// Bits looked up at once when decoding literals and lengths, and distances
+#define INFLATE_LITERAL_BITS  11
+#define INFLATE_DISTANCE_BITS 9
+
+// Whether the bit buffer is refilled a word at a time, which needs fast
+// unaligned little-endian loads
+#ifndef INFLATE_WIDE_REFILL
+	#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86) || \
+		defined(__aarch64__) || (defined(__ARMEL__) && defined(__ARM_FEATURE_UNALIGNED))
+		#define INFLATE_WIDE_REFILL 1
+	#else
+		#define INFLATE_WIDE_REFILL 0
+	#endif
+#endif
+
+
+// Functions
+
+EXTERN int inflateZlib (const unsigned char* input, int inputLength, unsigned char* output, int length);
+
+#endif
+
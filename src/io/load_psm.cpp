@@ -186,6 +186,7 @@ BOOL CSoundFile::ReadPSM(LPCBYTE lpStream, DWORD dwMemLength)
 				if ((pins->nLength > 3) && (len > 3))
 				{
 					ReadSample(pins, RS_PCM8D, (LPCSTR)pdata, len);
+					ConvertSampleTo16Bit(pins);
 				} else
 				{
 					pins->nLength = 0;
@@ -0,0 +1,298 @@
+
+/**
+ *
+ * @file loadprofile.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created loadprofile.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Times the files opened, and the phases of loading. Files are opened and
+ * phases gone through on the preloading and decoding threads as well as the
+ * main thread, so each thread keeps its own stack of the phases it is within,
+ * and adds them to the shared report once done.
+ *
+ */
+
+
+#include "loadprofile.h"
+
+#ifdef PROFILE
+
+#include "util.h"
+
+#include <string.h>
+
+
+static thread_local const char* phaseNames[LOAD_DEPTH]; ///< Phases the current thread is within
+static thread_local Uint64      phaseStarts[LOAD_DEPTH]; ///< When each of those phases began
+static thread_local int         phaseDepth; ///< Number of phases the current thread is within
+
+
+/**
+ * Create an empty report.
+ */
+LoadProfiler::LoadProfiler () {
+
+	nFiles = 0;
+	nPhases = 0;
+	frequency = 0;
+	lock = 0;
+
+	return;
+
+}
+
+
+/**
+ * Find how long ago something started.
+ *
+ * @param start When it started, in performance counter ticks
+ *
+ * @return Number of microseconds
+ */
+unsigned int LoadProfiler::getTime (Uint64 start) {
+
+	if (!frequency) frequency = SDL_GetPerformanceFrequency();
+
+	return ((SDL_GetPerformanceCounter() - start) * 1000000) / frequency;
+
+}
+
+
+/**
+ * Add a file which has been opened and read to the report.
+ *
+ * @param path The file's path
+ * @param bytes Number of bytes read
+ * @param syscalls Number of calls made to the file system
+ * @param start When opening the file started, in performance counter ticks
+ *
+ * @return Index of the file's entry
+ */
+int LoadProfiler::openFile (const char* path, int bytes, int syscalls, Uint64 start) {
+
+	LoadFile* file;
+	unsigned int time;
+	int length, count;
+
+	time = getTime(start);
+
+	// Only the end of the path is kept, which is enough to tell files apart
+	length = strlen(path);
+	if (length > LOAD_NAME) path += length - LOAD_NAME;
+
+	SDL_AtomicLock(&lock);
+
+	for (count = 0; count < nFiles; count++) {
+
+		if (!strcmp(files[count].name, path)) break;
+
+	}
+
+	if (count == nFiles) {
+
+		if (nFiles == LOAD_FILES) {
+
+			count = LOAD_FILES - 1;
+			strcpy(files[count].name, "(others)");
+
+		} else {
+
+			file = files + nFiles++;
+			memset(file, 0, sizeof(LoadFile));
+			strcpy(file->name, path);
+
+		}
+
+	}
+
+	file = files + count;
+	file->opens++;
+	file->bytes += bytes;
+	file->syscalls += syscalls;
+	file->readTime += time;
+
+	SDL_AtomicUnlock(&lock);
+
+	return count;
+
+}
+
+
+/**
+ * Add the time spent decoding part of a file to its entry.
+ *
+ * @param index Index of the file's entry, or -1 if it has none
+ * @param type The way it was decoded
+ * @param start When decoding started, in performance counter ticks
+ */
+void LoadProfiler::decode (int index, LoadDecode type, Uint64 start) {
+
+	unsigned int time;
+
+	if (index < 0) return;
+
+	time = getTime(start);
+
+	SDL_AtomicLock(&lock);
+
+	// The report may have been cleared while the file was open
+	if (index < nFiles) files[index].decodeTimes[type] += time;
+
+	SDL_AtomicUnlock(&lock);
+
+	return;
+
+}
+
+
+/**
+ * Start timing a phase of loading, on the current thread.
+ *
+ * @param name The phase's name, which must not be freed
+ */
+void LoadProfiler::beginPhase (const char* name) {
+
+	if (phaseDepth < LOAD_DEPTH) {
+
+		phaseNames[phaseDepth] = name;
+		phaseStarts[phaseDepth] = SDL_GetPerformanceCounter();
+
+	}
+
+	phaseDepth++;
+
+	return;
+
+}
+
+
+/**
+ * Stop timing the phase of loading the current thread began last.
+ */
+void LoadProfiler::endPhase () {
+
+	unsigned int time;
+	int count;
+
+	if (!phaseDepth) return;
+
+	phaseDepth--;
+
+	if (phaseDepth >= LOAD_DEPTH) return;
+
+	time = getTime(phaseStarts[phaseDepth]);
+
+	SDL_AtomicLock(&lock);
+
+	for (count = 0; count < nPhases; count++) {
+
+		if (!strcmp(phases[count].name, phaseNames[phaseDepth])) break;
+
+	}
+
+	if ((count == nPhases) && (nPhases < LOAD_PHASES)) {
+
+		phases[count].name = phaseNames[phaseDepth];
+		phases[count].count = 0;
+		phases[count].time = 0;
+		nPhases++;
+
+	}
+
+	if (count < nPhases) {
+
+		phases[count].count++;
+		phases[count].time += time;
+
+	}
+
+	SDL_AtomicUnlock(&lock);
+
+	return;
+
+}
+
+
+/**
+ * Log the files opened and phases gone through since the last report,
+ * slowest first, then clear them.
+ *
+ * @param name What was loaded, e.g. the level's file name
+ */
+void LoadProfiler::report (const char* name) {
+
+	const char* decodeNames[LOAD_DECODES] = {"    rle (us)", "    lz (us)", "    pixels (us)"};
+	unsigned int fileTimes[LOAD_FILES];
+	int order[LOAD_FILES];
+	unsigned int time;
+	int count, place, type;
+
+	SDL_AtomicLock(&lock);
+
+	log("Load report", name);
+
+	// Files take as long as reading and decoding them took
+	for (count = 0; count < nFiles; count++) {
+
+		time = files[count].readTime;
+
+		for (type = 0; type < LOAD_DECODES; type++) time += files[count].decodeTimes[type];
+
+		for (place = count; (place > 0) && (fileTimes[place - 1] < time); place--) {
+
+			fileTimes[place] = fileTimes[place - 1];
+			order[place] = order[place - 1];
+
+		}
+
+		fileTimes[place] = time;
+		order[place] = count;
+
+	}
+
+	for (count = 0; count < nFiles; count++) {
+
+		log("  file", files[order[count]].name);
+		log("    opens", files[order[count]].opens);
+		log("    bytes", files[order[count]].bytes);
+		log("    syscalls", files[order[count]].syscalls);
+		log("    read (us)", files[order[count]].readTime);
+
+		for (type = 0; type < LOAD_DECODES; type++) {
+
+			if (files[order[count]].decodeTimes[type])
+				log(decodeNames[type], files[order[count]].decodeTimes[type]);
+
+		}
+
+	}
+
+	for (count = 0; count < nPhases; count++) {
+
+		log("  phase", phases[count].name);
+		log("    count", phases[count].count);
+		log("    total (us)", phases[count].time);
+
+	}
+
+	nFiles = 0;
+	nPhases = 0;
+
+	SDL_AtomicUnlock(&lock);
+
+	return;
+
+}
+
+#endif
+
@@ -0,0 +1,140 @@
+
+/**
+ *
+ * @file loadprofile.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created loadprofile.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Times the files opened, and the phases of loading, for a report logged once
+ * each level has loaded. Only built when PROFILE is defined, otherwise the
+ * macros only raise the clock for each phase of loading.
+ *
+ */
+
+
+#ifndef _LOADPROFILE_H
+#define _LOADPROFILE_H
+
+
+#include "clockboost.h"
+#include "OpenJazz.h"
+
+#ifdef PROFILE
+
+#define SDL2
+
+#ifdef SDL2
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+
+// Constants
+
+#define LOAD_FILES  64 /* Most files in each report, later files being counted with the last */
+#define LOAD_PHASES 32 /* Most phases in each report */
+#define LOAD_DEPTH  8 /* Most phases each thread can be within at once */
+#define LOAD_NAME   40 /* Most characters of each file's name kept */
+
+
+// Enum
+
+/// Ways of decoding a file's contents
+enum LoadDecode {
+
+	LD_RLE = 0, ///< Run-length decoding
+	LD_LZ = 1, ///< Inflating
+	LD_PIXELS = 2 ///< Unscrambling pixels
+
+};
+
+#define LOAD_DECODES 3
+
+
+// Datatypes
+
+/// What it took to load a file
+typedef struct {
+
+	char         name[LOAD_NAME + 1]; ///< The end of the file's path
+	int          opens; ///< Number of times it was opened
+	int          bytes; ///< Number of bytes read
+	int          syscalls; ///< Number of calls made to the file system, including failed opens
+	unsigned int readTime; ///< Microseconds spent opening and reading it
+	unsigned int decodeTimes[LOAD_DECODES]; ///< Microseconds spent decoding its contents each way
+
+} LoadFile;
+
+/// A phase of loading
+typedef struct {
+
+	const char*  name; ///< The phase's name
+	int          count; ///< Number of times it was gone through
+	unsigned int time; ///< Microseconds spent in it
+
+} LoadPhase;
+
+
+// Class
+
+/// The files opened and phases gone through since the last report
+class LoadProfiler {
+
+	private:
+		LoadFile     files[LOAD_FILES]; ///< The files
+		int          nFiles; ///< Number of files
+		LoadPhase    phases[LOAD_PHASES]; ///< The phases
+		int          nPhases; ///< Number of phases
+		Uint64       frequency; ///< Performance counter ticks per second
+		SDL_SpinLock lock; ///< Guards the files and phases
+
+		unsigned int getTime (Uint64 start);
+
+	public:
+		LoadProfiler ();
+
+		int  openFile   (const char* path, int bytes, int syscalls, Uint64 start);
+		void decode     (int index, LoadDecode type, Uint64 start);
+		void beginPhase (const char* name);
+		void endPhase   ();
+		void report     (const char* name);
+
+};
+
+
+// Variable
+
+EXTERN LoadProfiler loadProfiler; ///< Times the files and phases of loading
+
+
+// Macros
+
+#define LOAD_BEGIN(name) (clockBoost.begin(), loadProfiler.beginPhase(name)) ///< Start timing a phase of loading
+#define LOAD_END() (loadProfiler.endPhase(), clockBoost.end()) ///< Stop timing the latest phase begun
+#define LOAD_REPORT(name) loadProfiler.report(name) ///< Log and clear the report
+#define LOAD_DECODE_START() Uint64 loadStart = SDL_GetPerformanceCounter() ///< Start timing a decode, after the function's declarations
+#define LOAD_DECODE_END(index, type) loadProfiler.decode(index, type, loadStart) ///< Add the decode's time to the file's entry
+
+#else
+
+#define LOAD_BEGIN(name) clockBoost.begin()
+#define LOAD_END() clockBoost.end()
+#define LOAD_REPORT(name)
+#define LOAD_DECODE_START()
+#define LOAD_DECODE_END(index, type)
+
+#endif
+
+#endif
+
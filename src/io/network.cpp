@@ -30,15 +30,17 @@
 #include "gfx/video.h"
 #include "network.h"
 
+#include "clock.h"
 #include "loop.h"
 #include "util.h"
 
 #ifdef USE_SOCKETS
 	#ifdef _WIN32
-		#include <winsock.h>
+		#include <winsock2.h>
+		#include <ws2tcpip.h>
 		#define ioctl ioctlsocket
-		#define socklen_t int
 		#define EWOULDBLOCK WSAEWOULDBLOCK
+		#define EINPROGRESS WSAEINPROGRESS
 		#define MSG_NOSIGNAL 0
 	#else
 		#include <sys/types.h>
@@ -47,6 +49,8 @@
 		#include <sys/select.h>
 		#include <sys/ioctl.h>
 		#include <netinet/in.h>
+		#include <netinet/tcp.h>
+		#include <netdb.h>
 		#include <unistd.h>
 		#include <errno.h>
 		#include <string.h>
@@ -54,6 +58,7 @@
 	#ifdef __APPLE__
 		#define MSG_NOSIGNAL 0
 	#endif
+	#include <stdio.h>
 #elif defined(WII)
 	#include <network.h>
 #elif defined(USE_SDL_NET)
@@ -83,6 +88,15 @@ Network::Network () {
 	SDLNet_Init();
 #endif
 
+	thread = NULL;
+	channelLock = SDL_CreateMutex();
+	channels = NULL;
+	channelsChanged = 0;
+	SDL_AtomicSet(&quit, 0);
+	connectAddress = NULL;
+	connectResult = E_N_CONNECT;
+	SDL_AtomicSet(&connectCancelled, 0);
+
 	return;
 
 }
@@ -93,6 +107,17 @@ Network::Network () {
  */
 Network::~Network () {
 
+	finishConnect();
+
+	if (thread) {
+
+		SDL_AtomicSet(&quit, 1);
+		SDL_WaitThread(thread, NULL);
+
+	}
+
+	SDL_DestroyMutex(channelLock);
+
 #ifdef USE_SOCKETS
 	#ifdef _WIN32
 	// Shut down Windows Sockets
@@ -170,104 +195,197 @@ int Network::host () {
 
 
 /**
- * Open a client connection to the specified server.
- *
- * @param address Address of the server
+ * Look up the server and connect to it, trying each of its addresses in turn.
+ * Run in the background, as looking up a host name can take seconds.
  *
- * @return Connection socket or error code
+ * @param data The network
  */
-int Network::join (char *address) {
+void Network::connect (void* data) {
 
 #ifdef USE_SOCKETS
-	sockaddr_in sockAddr;
+	Network* network;
+	addrinfo hints;
+	addrinfo* addresses;
+	addrinfo* address;
 	fd_set writefds;
 	timeval timeouttv;
-	unsigned int timeout;
-	int sock, con;
+	char port[8];
+	unsigned int timeout, tryTimeout;
+	int sock, con, length;
 
-	// Create socket
+	network = (Network*)data;
 
-	sock = socket(AF_INET, SOCK_STREAM, 0);
+	memset(&hints, 0, sizeof(addrinfo));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	snprintf(port, sizeof(port), "%d", NET_PORT);
 
-	if (sock == -1) return E_N_SOCKET;
+	if (getaddrinfo(network->connectAddress, port, &hints, &addresses) || !addresses) {
 
-	// Make socket non-blocking
-	con = 1;
-	ioctl(sock, FIONBIO, (u_long *)&con);
+		network->connectResult = E_N_ADDRESS;
 
+		return;
 
-	// Connect to server
+	}
 
-	memset(&sockAddr, 0, sizeof(sockaddr_in));
-	sockAddr.sin_family = AF_INET;
-	sockAddr.sin_port = htons(NET_PORT);
+	network->connectResult = E_N_CONNECT;
+	timeout = getTicks() + T_TIMEOUT;
 
-	#ifdef _WIN32
-	sockAddr.sin_addr.s_addr = inet_addr(address);
-	#else
-	if (inet_aton(address, &(sockAddr.sin_addr)) == 0) return E_N_ADDRESS;
-	#endif
+	for (address = addresses; address; address = address->ai_next) {
 
-	// Initiate connection
-	con = connect(sock, (sockaddr *)&sockAddr, sizeof(sockAddr));
+		if (SDL_AtomicGet(&(network->connectCancelled))) break;
 
-	// If the connection completed, return
-	if (con == 0) return sock;
+		if (getTicks() > timeout) {
 
+			network->connectResult = E_TIMEOUT;
 
-	// Wait for connection to complete
+			break;
 
-	con = 0;
-	timeout = globalTicks + T_TIMEOUT;
+		}
 
-	while (!con) {
+		sock = socket(address->ai_family, address->ai_socktype, address->ai_protocol);
 
-		if (loop(NORMAL_LOOP) == E_QUIT) {
+		if (sock == -1) continue;
 
-			close(sock);
+		// Make socket non-blocking
+		con = 1;
+		ioctl(sock, FIONBIO, (u_long *)&con);
 
-			return E_QUIT;
+		// Send messages as soon as they are flushed, as they are already batched
+		setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, (char *)&con, sizeof(con));
+
+		// Leave time for the remaining addresses
+		tryTimeout = getTicks() + T_CONNECT_TRY;
+		if (!address->ai_next || (tryTimeout > timeout)) tryTimeout = timeout;
+
+		// Initiate connection
+		con = ::connect(sock, address->ai_addr, address->ai_addrlen);
+
+		if (con && (network->getError() != EINPROGRESS) && (network->getError() != EWOULDBLOCK)) {
+
+			network->close(sock);
+
+			continue;
 
 		}
 
-		if (controls.release(C_ESCAPE)) {
+		// Wait for connection to complete, checking now and then that it is
+		// still wanted
+		while (con) {
 
-			close(sock);
+			if (SDL_AtomicGet(&(network->connectCancelled)) || (getTicks() > tryTimeout)) break;
 
-			return E_RETURN;
+			FD_ZERO(&writefds);
+			FD_SET(sock, &writefds);
+			timeouttv.tv_sec = 0;
+			timeouttv.tv_usec = T_CONNECT_WAIT * 1000;
+
+			// The socket also becomes writable when the connection fails
+			if (select(sock + 1, NULL, &writefds, NULL, &timeouttv) > 0) {
+
+				length = sizeof(int);
+				if (getsockopt(sock, SOL_SOCKET, SO_ERROR, (char *)&con, (socklen_t *)&length)) con = -1;
+
+				break;
+
+			}
 
 		}
 
-		video.clearScreen(0);
-		fontmn2->showString("CONNECTING TO SERVER", canvasW >> 2, (canvasH >> 1) - 16);
+		if (!con) {
+
+			network->connectResult = sock;
+
+			break;
+
+		}
+
+		network->close(sock);
+
+		if (getTicks() > timeout) network->connectResult = E_TIMEOUT;
+
+	}
+
+	freeaddrinfo(addresses);
+
+	if (network->connectResult < 0)
+		log("Could not connect to server", network->connectAddress);
+#else
+	(void)data;
+#endif
+
+	return;
+
+}
+
+
+/**
+ * Wait for any connection job. A connection made after it stopped being
+ * wanted is closed.
+ */
+void Network::finishConnect () {
+
+	if (!connectAddress) return;
+
+	jobs.wait(&connectJob);
+
+	if (SDL_AtomicGet(&connectCancelled) && (connectResult >= 0)) close(connectResult);
+
+	delete[] connectAddress;
+	connectAddress = NULL;
+
+	return;
+
+}
 
-		FD_ZERO(&writefds);
-		FD_SET(sock, &writefds);
-		timeouttv.tv_sec = 0;
-		timeouttv.tv_usec = T_MENU_FRAME;
-		con = select(sock + 1, NULL, &writefds, NULL, &timeouttv);
 
-		if (con == -1) {
+/**
+ * Open a client connection to the specified server. The server is looked up
+ * and connected to in the background, while the screen keeps being drawn.
+ *
+ * @param address Address or host name of the server
+ *
+ * @return Connection socket or error code
+ */
+int Network::join (char *address) {
+
+#ifdef USE_SOCKETS
+	// An abandoned connection job may still be running
+	finishConnect();
 
-			log("Could not connect to server - code", getError());
+	connectAddress = createString(address);
+	connectResult = E_N_CONNECT;
+	SDL_AtomicSet(&connectCancelled, 0);
 
-			close(sock);
+	jobs.prepare(&connectJob, connect, this, NULL, true);
+	jobs.submit(&connectJob);
 
-			return E_N_CONNECT;
+	while (!jobs.isDone(&connectJob)) {
+
+		if (loop(NORMAL_LOOP) == E_QUIT) {
+
+			SDL_AtomicSet(&connectCancelled, 1);
+
+			return E_QUIT;
 
 		}
 
-		if (globalTicks > timeout) {
+		if (controls.release(C_ESCAPE)) {
 
-			close(sock);
+			SDL_AtomicSet(&connectCancelled, 1);
 
-			return E_TIMEOUT;
+			return E_RETURN;
 
 		}
 
+		video.clearScreen(0);
+		fontmn2->showString("CONNECTING TO SERVER", canvasW >> 2, (canvasH >> 1) - 16);
+
 	}
 
-	return sock;
+	finishConnect();
+
+	return connectResult;
 #elif defined USE_SDL_NET
 	video.clearScreen(0);
 	fontmn2->showString("CONNECTING TO SERVER", canvasW >> 2, (canvasH >> 1) - 16);
@@ -309,6 +427,10 @@ int Network::accept (int sock) {
 		length = 1;
 		ioctl(clientSocket, FIONBIO, (u_long *)&length);
 
+		// Send messages as soon as they are flushed, as they are already
+		// batched
+		setsockopt(clientSocket, IPPROTO_TCP, TCP_NODELAY, (char *)&length, sizeof(length));
+
 	}
 
 	return clientSocket;
@@ -368,6 +490,29 @@ int Network::send (int sock, unsigned char *buffer) {
 }
 
 
+/**
+ * Send a block of raw data over the specified connection. As much of the
+ * block is sent as the connection can take without blocking.
+ *
+ * @param sock Connection socket
+ * @param buffer Data to be sent
+ * @param length Amount of data to send, in bytes
+ *
+ * @return Number of bytes sent, or -1 for failure
+ */
+int Network::send (int sock, unsigned char *buffer, int length) {
+
+#ifdef USE_SOCKETS
+	return ::send(sock, (char *)buffer, length, MSG_NOSIGNAL);
+#elif defined USE_SDL_NET
+	return SDLNet_TCP_Send((TCPsocket)sock, (char *)buffer, length);
+#else
+	return 0;
+#endif
+
+}
+
+
 /**
  * Receive data from the specified connection.
  *
@@ -391,51 +536,1137 @@ int Network::recv (int sock, unsigned char *buffer, int length) {
 
 
 /**
- * Check if a given socket is connected.
+ * Find out which of the given connections have data waiting to be received.
  *
- * @param sock The socket
+ * @param socks Connection sockets. Entries of -1 are ignored.
+ * @param nSocks Number of entries in socks
+ * @param readable Set to whether or not each connection has data waiting
+ * @param wait How long to wait for data to arrive, in milliseconds
  *
- * @return True if connected
+ * @return Number of connections with data waiting, or -1 for failure
  */
-bool Network::isConnected (int sock) {
+int Network::ready (int *socks, int nSocks, bool *readable, int wait) {
 
 #ifdef USE_SOCKETS
-	int length;
-	char buffer;
+	fd_set readfds;
+	timeval timeouttv;
+	int count, maxSock, ret;
 
-	// Check for incoming data
-	length = ::recv(sock, &buffer, 1, MSG_PEEK | MSG_NOSIGNAL);
+	FD_ZERO(&readfds);
+	maxSock = -1;
 
-	// Still connected if data was received or if there was no data to receive
-	return (length != -1) || (getError() == EWOULDBLOCK);
+	for (count = 0; count < nSocks; count++) {
+
+		readable[count] = false;
+
+		if (socks[count] == -1) continue;
+
+		FD_SET(socks[count], &readfds);
+		if (socks[count] > maxSock) maxSock = socks[count];
+
+	}
+
+	if (maxSock == -1) return 0;
+
+	timeouttv.tv_sec = wait / 1000;
+	timeouttv.tv_usec = (wait % 1000) * 1000;
+	ret = select(maxSock + 1, &readfds, NULL, NULL, &timeouttv);
+
+	if (ret <= 0) return ret;
+
+	for (count = 0; count < nSocks; count++) {
+
+		if (socks[count] != -1) readable[count] = FD_ISSET(socks[count], &readfds);
+
+	}
+
+	return ret;
 #elif defined USE_SDL_NET
-	return SDLNet_SocketReady((TCPsocket)sock);
+	SDLNet_SocketSet set;
+	int count, ret;
+
+	for (count = 0; count < nSocks; count++) readable[count] = false;
+
+	set = SDLNet_AllocSocketSet(nSocks);
+
+	if (!set) return -1;
+
+	for (count = 0; count < nSocks; count++) {
+
+		if (socks[count] != -1) SDLNet_TCP_AddSocket(set, (TCPsocket)socks[count]);
+
+	}
+
+	ret = SDLNet_CheckSockets(set, wait);
+
+	if (ret > 0) {
+
+		for (count = 0; count < nSocks; count++) {
+
+			if (socks[count] != -1) readable[count] = SDLNet_SocketReady((TCPsocket)socks[count]);
+
+		}
+
+	}
+
+	SDLNet_FreeSocketSet(set);
+
+	return ret;
 #else
-	return false;
+	int count;
+
+	(void)wait;
+
+	for (count = 0; count < nSocks; count++) readable[count] = false;
+
+	return 0;
 #endif
 
 }
 
 
 /**
- * Get the last error code.
+ * Open a socket for datagrams, which are unreliable and unordered, but never
+ * held up by lost data.
  *
- * @return Network library error code
+ * @param port The local port, or 0 for any
+ *
+ * @return Datagram socket, or -1 if datagrams are not available
  */
-int Network::getError () {
+int Network::openDatagram (int port) {
 
 #ifdef USE_SOCKETS
-	#ifdef _WIN32
-	return WSAGetLastError();
-	#else
-	return errno;
-	#endif
+	sockaddr_in sockAddr;
+	int sock, nonblock;
+
+	sock = socket(AF_INET, SOCK_DGRAM, 0);
+
+	if (sock == -1) return -1;
+
+	// Make the socket non-blocking
+	nonblock = 1;
+	ioctl(sock, FIONBIO, (u_long *)&nonblock);
+
+	memset(&sockAddr, 0, sizeof(sockaddr_in));
+	sockAddr.sin_family = AF_INET;
+	sockAddr.sin_addr.s_addr = INADDR_ANY;
+	sockAddr.sin_port = htons(port);
+
+	if (bind(sock, (sockaddr *)&sockAddr, sizeof(sockaddr_in))) {
+
+		close(sock);
+
+		return -1;
+
+	}
+
+	return sock;
+#else
+	(void)port;
+
+	return -1;
+#endif
+
+}
+
+
+/**
+ * Send a datagram.
+ *
+ * @param sock Datagram socket
+ * @param buffer Data to be sent
+ * @param length Amount of data to send, in bytes
+ * @param address Destination IPv4 address, in network byte order
+ * @param port Destination port
+ *
+ * @return Number of bytes sent, or -1 for failure
+ */
+int Network::sendTo (int sock, unsigned char *buffer, int length, unsigned int address, int port) {
+
+#ifdef USE_SOCKETS
+	sockaddr_in sockAddr;
+
+	memset(&sockAddr, 0, sizeof(sockaddr_in));
+	sockAddr.sin_family = AF_INET;
+	sockAddr.sin_addr.s_addr = address;
+	sockAddr.sin_port = htons(port);
+
+	return ::sendto(sock, (char *)buffer, length, MSG_NOSIGNAL,
+		(sockaddr *)&sockAddr, sizeof(sockaddr_in));
+#else
+	(void)sock;
+	(void)buffer;
+	(void)length;
+	(void)address;
+	(void)port;
+
+	return -1;
+#endif
+
+}
+
+
+/**
+ * Receive a datagram, if one has arrived.
+ *
+ * @param sock Datagram socket
+ * @param buffer Buffer to receive the datagram
+ * @param length The size of the buffer, in bytes
+ * @param address Set to the sender's IPv4 address, in network byte order
+ * @param port Set to the sender's port
+ *
+ * @return Number of bytes received, or -1 if there was no datagram
+ */
+int Network::recvFrom (int sock, unsigned char *buffer, int length, unsigned int *address, int *port) {
+
+#ifdef USE_SOCKETS
+	sockaddr_in sockAddr;
+	int ret, addrLength;
+
+	addrLength = sizeof(sockaddr_in);
+
+	ret = ::recvfrom(sock, (char *)buffer, length, MSG_NOSIGNAL,
+		(sockaddr *)&sockAddr, (socklen_t *)&addrLength);
+
+	if (ret >= 0) {
+
+		*address = sockAddr.sin_addr.s_addr;
+		*port = ntohs(sockAddr.sin_port);
+
+	}
+
+	return ret;
+#else
+	(void)sock;
+	(void)buffer;
+	(void)length;
+	(void)address;
+	(void)port;
+
+	return -1;
+#endif
+
+}
+
+
+/**
+ * Get the address at the other end of a connection.
+ *
+ * @param sock Connection socket
+ * @param address Set to the IPv4 address, in network byte order
+ *
+ * @return Whether or not the address is known
+ */
+bool Network::getPeer (int sock, unsigned int *address) {
+
+#ifdef USE_SOCKETS
+	sockaddr_storage sockAddr;
+	int length;
+
+	length = sizeof(sockaddr_storage);
+
+	if (getpeername(sock, (sockaddr *)&sockAddr, (socklen_t *)&length)) return false;
+
+	// Servers reached over IPv6 have no IPv4 address to send datagrams to
+	if (sockAddr.ss_family != AF_INET) return false;
+
+	*address = ((sockaddr_in *)&sockAddr)->sin_addr.s_addr;
+
+	return true;
 #elif defined USE_SDL_NET
-	return (int)SDLNet_GetError();
+	IPaddress* peer;
+
+	peer = SDLNet_TCP_GetPeerAddress((TCPsocket)sock);
+
+	if (!peer) return false;
+
+	*address = peer->host;
+
+	return true;
 #else
-	return 0;
+	(void)sock;
+	(void)address;
+
+	return false;
 #endif
 
 }
 
 
+/**
+ * Check if a given socket is connected.
+ *
+ * @param sock The socket
+ *
+ * @return True if connected
+ */
+bool Network::isConnected (int sock) {
+
+#ifdef USE_SOCKETS
+	int length;
+	char buffer;
+
+	// Check for incoming data
+	length = ::recv(sock, &buffer, 1, MSG_PEEK | MSG_NOSIGNAL);
+
+	// Still connected if data was received or if there was no data to receive
+	return (length != -1) || (getError() == EWOULDBLOCK);
+#elif defined USE_SDL_NET
+	return SDLNet_SocketReady((TCPsocket)sock);
+#else
+	return false;
+#endif
+
+}
+
+
+/**
+ * Get the last error code.
+ *
+ * @return Network library error code
+ */
+int Network::getError () {
+
+#ifdef USE_SOCKETS
+	#ifdef _WIN32
+	return WSAGetLastError();
+	#else
+	return errno;
+	#endif
+#elif defined USE_SDL_NET
+	return (int)SDLNet_GetError();
+#else
+	return 0;
+#endif
+
+}
+
+
+/**
+ * Hand a connection over to the network thread, starting the thread if it is
+ * not yet running.
+ *
+ * @param sock Connection socket
+ *
+ * @return The channel through which to use the connection, or NULL if the
+ * thread could not be started
+ */
+NetChannel* Network::open (int sock) {
+
+	NetChannel* channel;
+
+	if (!thread) {
+
+		thread = SDL_CreateThread(run, "Network", this);
+
+		if (!thread) return NULL;
+
+	}
+
+	channel = new NetChannel(sock);
+
+	SDL_LockMutex(channelLock);
+
+	channel->next = channels;
+	channels = channel;
+	channelsChanged++;
+
+	SDL_UnlockMutex(channelLock);
+
+	return channel;
+
+}
+
+
+/**
+ * Take a connection back from the network thread, and close it. Any data not
+ * yet sent is discarded.
+ *
+ * @param channel The connection's channel, which is deleted
+ */
+void Network::close (NetChannel *channel) {
+
+	NetChannel** link;
+
+	SDL_LockMutex(channelLock);
+
+	for (link = &channels; *link && (*link != channel); link = &((*link)->next));
+
+	if (*link) *link = channel->next;
+
+	channelsChanged++;
+
+	SDL_UnlockMutex(channelLock);
+
+	close(channel->sock);
+
+	delete channel;
+
+	return;
+
+}
+
+
+/**
+ * Service the channels until told to stop. Runs on the network thread.
+ *
+ * @param data The network
+ *
+ * @return Thread exit code
+ */
+int Network::run (void* data) {
+
+	Network* network;
+	NetChannel* channel;
+	int socks[MAX_CLIENTS + 1];
+	bool readable[MAX_CLIENTS + 1];
+	int count, nSocks, waiting, changed;
+
+	network = (Network*)data;
+
+	while (!SDL_AtomicGet(&(network->quit))) {
+
+		// Find the channels with room for more data
+
+		SDL_LockMutex(network->channelLock);
+
+		changed = network->channelsChanged;
+		nSocks = 0;
+		waiting = 0;
+
+		for (channel = network->channels; channel && (nSocks <= MAX_CLIENTS); channel = channel->next) {
+
+			if (channel->canReceive()) {
+
+				socks[nSocks] = channel->sock;
+				waiting++;
+
+			} else socks[nSocks] = -1;
+
+			nSocks++;
+
+		}
+
+		SDL_UnlockMutex(network->channelLock);
+
+		// Wait a little for data to arrive, so that anything handed over
+		// meanwhile is sent soon after
+		if (waiting) network->ready(socks, nSocks, readable, T_NET_WAIT);
+		else {
+
+			for (count = 0; count < nSocks; count++) readable[count] = false;
+
+			SDL_Delay(T_NET_WAIT);
+
+		}
+
+		SDL_LockMutex(network->channelLock);
+
+		// If channels came or went while waiting, the results no longer match
+		// them, so wait again
+		if (network->channelsChanged == changed) {
+
+			count = 0;
+
+			for (channel = network->channels; channel && (count < nSocks); channel = channel->next)
+				channel->service(readable[count++]);
+
+		}
+
+		SDL_UnlockMutex(network->channelLock);
+
+	}
+
+	return 0;
+
+}
+
+
+/**
+ * Create a channel for a connection.
+ *
+ * @param channelSock Connection socket
+ */
+NetChannel::NetChannel (int channelSock) {
+
+	next = NULL;
+	sock = channelSock;
+
+	SDL_AtomicSet(&inEnd, 0);
+	SDL_AtomicSet(&inStart, 0);
+	SDL_AtomicSet(&outEnd, 0);
+	SDL_AtomicSet(&outStart, 0);
+	SDL_AtomicSet(&closed, 0);
+	SDL_AtomicSet(&stalls, 0);
+
+	memset(messagesIn, 0, sizeof(messagesIn));
+	memset(messagesOut, 0, sizeof(messagesOut));
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not there is room for more data to be received. Called
+ * by the network thread.
+ *
+ * @return True if there is room
+ */
+bool NetChannel::canReceive () {
+
+	unsigned int start, end;
+
+	end = SDL_AtomicGet(&inEnd);
+	start = SDL_AtomicGet(&inStart);
+
+	return !SDL_AtomicGet(&closed) && (end - start < NET_BUFFER);
+
+}
+
+
+/**
+ * Send whatever has been handed over, and receive whatever has arrived and
+ * will fit. Called by the network thread.
+ *
+ * @param readable Whether or not the connection has data waiting
+ */
+void NetChannel::service (bool readable) {
+
+	unsigned int start, end;
+	int position, space, ret;
+	bool gone;
+
+	if (SDL_AtomicGet(&closed)) return;
+
+
+	// Send as much as the connection will take
+
+	start = SDL_AtomicGet(&outStart);
+	end = SDL_AtomicGet(&outEnd);
+	SDL_MemoryBarrierAcquire();
+
+	while (start != end) {
+
+		// Send up to the end of the ring, or up to the end of the data if it
+		// has not wrapped around
+		position = start & (NET_QUEUE - 1);
+		space = NET_QUEUE - position;
+
+		if ((unsigned int)space > end - start) space = end - start;
+
+		ret = net->send(sock, outData + position, space);
+
+		if (ret < space) {
+
+			// The connection's own buffer is full
+			SDL_AtomicAdd(&stalls, 1);
+
+			if (ret > 0) start += ret;
+
+			break;
+
+		}
+
+		start += ret;
+
+	}
+
+	// The sent data must have been read before its space can be reused
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&outStart, start);
+
+
+	// Receive as much as has arrived
+
+	if (!readable) return;
+
+	start = SDL_AtomicGet(&inStart);
+	end = SDL_AtomicGet(&inEnd);
+	gone = false;
+
+	while (end - start < NET_BUFFER) {
+
+		// Receive into the free space up to the end of the ring, or up to the
+		// oldest data if the free space has wrapped around
+		position = end & (NET_BUFFER - 1);
+		space = NET_BUFFER - position;
+
+		if ((unsigned int)space > NET_BUFFER - (end - start)) space = NET_BUFFER - (end - start);
+
+		ret = net->recv(sock, inData + position, space);
+
+		if (ret <= 0) {
+
+			// A readable connection with nothing to give has been closed
+			if (!ret || !net->isConnected(sock)) gone = true;
+
+			break;
+
+		}
+
+		end += ret;
+
+		if (ret < space) break;
+
+	}
+
+	// The data must be complete before the game thread can see it
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&inEnd, end);
+
+	if (gone) SDL_AtomicSet(&closed, 1);
+
+	return;
+
+}
+
+
+/**
+ * Get the channel's socket.
+ *
+ * @return The connection socket
+ */
+int NetChannel::getSock () {
+
+	return sock;
+
+}
+
+
+/**
+ * Take the oldest whole message from the received data.
+ *
+ * @param buffer Buffer to receive the message, at least 255 bytes
+ *
+ * @return Whether or not there was a whole message
+ */
+bool NetChannel::getMessage (unsigned char *buffer) {
+
+	unsigned int start, end;
+	int size, count;
+
+	start = SDL_AtomicGet(&inStart);
+	end = SDL_AtomicGet(&inEnd);
+	SDL_MemoryBarrierAcquire();
+
+	while (start != end) {
+
+		size = inData[start & (NET_BUFFER - 1)];
+
+		// Skip length bytes too short to belong to a message
+		if (size < 2) {
+
+			start++;
+
+			continue;
+
+		}
+
+		if (end - start < (unsigned int)size) break;
+
+		for (count = 0; count < size; count++)
+			buffer[count] = inData[(start + count) & (NET_BUFFER - 1)];
+
+		start += size;
+
+		if (buffer[1] < NET_TYPES) messagesIn[buffer[1]]++;
+
+		SDL_MemoryBarrierRelease();
+		SDL_AtomicSet(&inStart, start);
+
+		return true;
+
+	}
+
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&inStart, start);
+
+	return false;
+
+}
+
+
+/**
+ * Take raw data, rather than messages, from the received data.
+ *
+ * @param buffer Buffer to receive the data
+ * @param length The size of the buffer, in bytes
+ *
+ * @return Number of bytes taken
+ */
+int NetChannel::read (unsigned char *buffer, int length) {
+
+	unsigned int start, end;
+	int count;
+
+	start = SDL_AtomicGet(&inStart);
+	end = SDL_AtomicGet(&inEnd);
+	SDL_MemoryBarrierAcquire();
+
+	if ((unsigned int)length > end - start) length = end - start;
+
+	for (count = 0; count < length; count++)
+		buffer[count] = inData[(start + count) & (NET_BUFFER - 1)];
+
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&inStart, start + length);
+
+	return length;
+
+}
+
+
+/**
+ * Hand data to the network thread to be sent, as much as there is room for.
+ *
+ * @param buffer Data to be sent
+ * @param length Amount of data to send, in bytes
+ *
+ * @return Number of bytes handed over
+ */
+int NetChannel::write (unsigned char *buffer, int length) {
+
+	unsigned int start, end;
+	int count;
+
+	end = SDL_AtomicGet(&outEnd);
+	start = SDL_AtomicGet(&outStart);
+	SDL_MemoryBarrierAcquire();
+
+	if ((unsigned int)length > NET_QUEUE - (end - start)) length = NET_QUEUE - (end - start);
+
+	for (count = 0; count < length; count++)
+		outData[(end + count) & (NET_QUEUE - 1)] = buffer[count];
+
+	// The data must be complete before the network thread can see it
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&outEnd, end + length);
+
+	return length;
+
+}
+
+
+/**
+ * Determine whether or not everything handed over has been sent.
+ *
+ * @return True if nothing is waiting to be sent
+ */
+bool NetChannel::isEmpty () {
+
+	return SDL_AtomicGet(&outStart) == SDL_AtomicGet(&outEnd);
+
+}
+
+
+/**
+ * Determine whether or not the connection has been closed by the other side,
+ * or has failed.
+ *
+ * @return True if the connection has gone
+ */
+bool NetChannel::isClosed () {
+
+	return SDL_AtomicGet(&closed) != 0;
+
+}
+
+
+/**
+ * Find how much the network thread has sent over the connection.
+ *
+ * @return Total sent, wrapping around
+ */
+unsigned int NetChannel::getSent () {
+
+	return SDL_AtomicGet(&outStart);
+
+}
+
+
+/**
+ * Find how much has been handed over, but not yet sent.
+ *
+ * @return Amount of data waiting
+ */
+int NetChannel::getBacklog () {
+
+	return (unsigned int)SDL_AtomicGet(&outEnd) - (unsigned int)SDL_AtomicGet(&outStart);
+
+}
+
+
+/**
+ * Add the connection's traffic to the given statistics.
+ *
+ * @param stats The statistics
+ */
+void NetChannel::getStats (NetStats *stats) {
+
+	unsigned int end;
+	int count;
+
+	end = SDL_AtomicGet(&outEnd);
+
+	stats->bytesIn += (unsigned int)SDL_AtomicGet(&inEnd);
+	stats->bytesOut += (unsigned int)SDL_AtomicGet(&outStart);
+	stats->queued += end - (unsigned int)SDL_AtomicGet(&outStart);
+	stats->stalls += SDL_AtomicGet(&stalls);
+
+	for (count = 0; count < NET_TYPES; count++) {
+
+		stats->messagesIn[count] += messagesIn[count];
+		stats->messagesOut[count] += messagesOut[count];
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Create empty statistics.
+ */
+NetStats::NetStats () {
+
+	bytesIn = 0;
+	bytesOut = 0;
+	memset(messagesIn, 0, sizeof(messagesIn));
+	memset(messagesOut, 0, sizeof(messagesOut));
+	queued = 0;
+	stalls = 0;
+	dropped = 0;
+	rtt = -1;
+	levelSent = -1;
+	levelSize = 0;
+	interval = 0;
+	bandwidth = 0;
+
+	return;
+
+}
+
+
+/**
+ * Create an empty send queue.
+ */
+NetQueue::NetQueue () {
+
+	clear();
+	dropped = 0;
+
+	return;
+
+}
+
+
+/**
+ * Discard any queued messages.
+ */
+void NetQueue::clear () {
+
+	length = 0;
+	partial = 0;
+
+	return;
+
+}
+
+
+/**
+ * Queue a message to be sent at the next flush.
+ *
+ * @param message The message. First byte indicates length.
+ * @param supersede Whether or not the message replaces any unsent message with
+ * the same type and subject (the second and third bytes)
+ *
+ * @return Whether or not the message was queued
+ */
+bool NetQueue::add (unsigned char *message, bool supersede) {
+
+	int position;
+
+	if (message[0] < 2) return false;
+
+	if (supersede) {
+
+		// Update the old message in place, rather than sending both
+		for (position = partial; position < length; position += data[position]) {
+
+			if (!memcmp(data + position + 1, message + 1, 2)) {
+
+				if (data[position] == message[0]) {
+
+					memcpy(data + position, message, message[0]);
+
+					return true;
+
+				}
+
+				// Packed messages vary in length, so the old message is
+				// removed and the new one queued behind the rest
+				length -= data[position];
+				memmove(data + position, data + position + data[position], length - position);
+
+				break;
+
+			}
+
+		}
+
+	}
+
+	if (length + message[0] > NET_QUEUE) {
+
+		dropped++;
+
+		return false;
+
+	}
+
+	memcpy(data + length, message, message[0]);
+	length += message[0];
+
+	return true;
+
+}
+
+
+/**
+ * Hand as many of the queued messages to the network thread as it will take.
+ *
+ * @param channel The connection
+ *
+ * @return Number of bytes handed over
+ */
+int NetQueue::flush (NetChannel *channel) {
+
+	return flush(channel, NET_QUEUE);
+
+}
+
+
+/**
+ * Hand queued messages to the network thread, keeping no more than the given
+ * amount waiting there. Messages held back in the queue can still be
+ * superseded, so player state is replaced rather than sent late. Once the
+ * queue is half full, everything is handed over, so that nothing is dropped.
+ *
+ * @param channel The connection
+ * @param backlog Most data to keep waiting in the network thread
+ *
+ * @return Number of bytes handed over
+ */
+int NetQueue::flush (NetChannel *channel, int backlog) {
+
+	int amount, position, ret;
+
+	if (!length) return 0;
+
+	amount = length;
+
+	if (length <= (NET_QUEUE >> 1)) {
+
+		amount = backlog - channel->getBacklog();
+
+		if (amount <= 0) return 0;
+
+		if (amount > length) amount = length;
+
+	}
+
+	ret = channel->write(data, amount);
+
+	if (ret <= 0) return ret;
+
+	// Find the end of the last message to have been sent in part, counting
+	// the messages which have started to go
+	for (position = partial; position < ret; position += data[position]) {
+
+		if (data[position + 1] < NET_TYPES) channel->messagesOut[data[position + 1]]++;
+
+	}
+
+	partial = position - ret;
+
+	length -= ret;
+	memmove(data, data + ret, length);
+
+	return ret;
+
+}
+
+
+/**
+ * Determine whether or not all queued messages have been sent.
+ *
+ * @return True if the queue is empty
+ */
+bool NetQueue::isEmpty () {
+
+	return !length;
+
+}
+
+
+/**
+ * Find how much is queued.
+ *
+ * @return Amount of queued data
+ */
+int NetQueue::getLength () {
+
+	return length;
+
+}
+
+
+/**
+ * Add the queue's contents and losses to the given statistics.
+ *
+ * @param stats The statistics
+ */
+void NetQueue::getStats (NetStats *stats) {
+
+	stats->queued += length;
+	stats->dropped += dropped;
+
+	return;
+
+}
+
+
+/**
+ * Create a send rate, starting at the fastest.
+ *
+ * @param fastestInterval Least milliseconds between player state updates
+ * @param slowestInterval Most milliseconds between player state updates
+ */
+NetRate::NetRate (int fastestInterval, int slowestInterval) {
+
+	lastTime = 0;
+	lastSent = 0;
+	saturated = false;
+	bandwidth = 0;
+	minRtt = -1;
+	fastest = fastestInterval;
+	slowest = slowestInterval;
+	interval = fastest;
+
+	return;
+
+}
+
+
+/**
+ * Measure the connection, and adjust the interval between updates. Called as
+ * each update is sent.
+ *
+ * @param channel The connection
+ * @param queue The connection's send queue
+ * @param rtt Round-trip time in milliseconds, or -1 if not yet measured
+ * @param ticks Current time
+ */
+void NetRate::update (NetChannel *channel, NetQueue *queue, int rtt, unsigned int ticks) {
+
+	unsigned int sent;
+	int backlog, sample;
+	bool congested;
+
+	backlog = channel->getBacklog() + queue->getLength();
+	sent = channel->getSent();
+
+	if ((rtt >= 0) && ((minRtt < 0) || (rtt < minRtt))) minRtt = rtt;
+
+	// Whether data is backed up is only checked at each update
+	if (!backlog) saturated = false;
+
+	if (ticks - lastTime >= T_RATE_SAMPLE) {
+
+		sample = (int)(((Uint64)(sent - lastSent) * 1000) / (ticks - lastTime));
+
+		// While data was backed up, the connection was carrying all it
+		// could, otherwise it could carry at least as much as it did
+		if (saturated) bandwidth = bandwidth? ((bandwidth * 3) + sample) >> 2: sample;
+		else if (bandwidth && (sample > bandwidth)) bandwidth = sample;
+
+		lastTime = ticks;
+		lastSent = sent;
+		saturated = backlog != 0;
+
+	}
+
+	congested = (backlog > getBacklog()) ||
+		((rtt >= 0) && (minRtt >= 0) && (rtt > (minRtt * 2) + T_RATE_JITTER));
+
+	// Back off quickly, and recover slowly
+	if (congested) interval += (interval >> 1) + 1;
+	else interval--;
+
+	if (interval < fastest) interval = fastest;
+	if (interval > slowest) interval = slowest;
+
+	return;
+
+}
+
+
+/**
+ * Find the interval between updates.
+ *
+ * @return Milliseconds between player state updates
+ */
+int NetRate::getInterval () {
+
+	return interval;
+
+}
+
+
+/**
+ * Find how much data to keep waiting in the network thread. Beyond that, data
+ * would only be delivered late.
+ *
+ * @return Amount of data
+ */
+int NetRate::getBacklog () {
+
+	int backlog;
+
+	if (!bandwidth) return NET_QUEUE;
+
+	backlog = (bandwidth * T_RATE_DELAY) / 1000;
+
+	return (backlog < NET_RATE_BACKLOG)? NET_RATE_BACKLOG: backlog;
+
+}
+
+
+/**
+ * Find how much each update can take of the connection's bandwidth.
+ *
+ * @return Amount of data, or 0 if the bandwidth is not yet known
+ */
+int NetRate::getBudget () {
+
+	return (int)(((Uint64)bandwidth * interval) / 1000);
+
+}
+
+
+/**
+ * Add the send rate to the given statistics.
+ *
+ * @param stats The statistics
+ */
+void NetRate::getStats (NetStats *stats) {
+
+	stats->interval = interval;
+	stats->bandwidth = bandwidth;
+
+	return;
+
+}
+
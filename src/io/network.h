@@ -21,8 +21,17 @@
 #define _NETWORK_H
 
 
+#include "jobs.h"
 #include "OpenJazz.h"
 
+#define SDL2
+
+#ifdef SDL2
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
 #ifdef USE_SDL_NET
 #include <SDL_net.h>
 #endif
@@ -40,18 +49,83 @@
 // Timeout interval
 #define T_TIMEOUT 30000
 
-// Client limit
-#define MAX_CLIENTS   31
+// Connecting to a server
+#define T_CONNECT_WAIT 100 /* Longest time spent waiting for a connection before checking whether it is still wanted, in milliseconds */
+#define T_CONNECT_TRY  10000 /* Longest time spent on one of several addresses, in milliseconds */
+
+// Client limits. Player numbers are sent as single bytes, so a server can
+// have at most 254 clients besides its own player.
+#define DEFAULT_CLIENTS 31
+#define MAX_CLIENTS     254
 
 // Level file
 #define LEVEL_FILE  "openjazz.tmp"
 
+// Size of each connection's receive buffer, must be a power of 2
+#define NET_BUFFER  16384
+
+// Size of each connection's send queue, and of the data handed to the network
+// thread for sending, must be a power of 2
+#define NET_QUEUE   8192
+
+// Longest time the network thread waits for data to arrive, in milliseconds,
+// before sending whatever has been handed to it
+#define T_NET_WAIT  1
+
+// Number of message types counted separately, covering every MT_* type
+#define NET_TYPES   0x30
+
+// Send rate adaptation
+#define T_RATE_SAMPLE   100 /* Shortest time over which bandwidth is measured, in milliseconds */
+#define T_RATE_DELAY    50 /* Data kept handed to the network thread, in milliseconds of its bandwidth */
+#define T_RATE_JITTER   30 /* Round-trip time above twice the lowest seen taken to mean congestion, in milliseconds */
+#define NET_RATE_BACKLOG 1024 /* Least data kept handed to the network thread */
+
+
+// Classes
+
+class NetChannel;
 
-// Class
+/// Traffic over a connection, gathered for display and for sizing servers
+class NetStats {
+
+	public:
+		unsigned int bytesIn; ///< Total received
+		unsigned int bytesOut; ///< Total sent
+		unsigned int messagesIn[NET_TYPES]; ///< Messages received, by type
+		unsigned int messagesOut[NET_TYPES]; ///< Messages sent, by type
+		int          queued; ///< Amount of data waiting to be sent
+		int          stalls; ///< Number of times the connection would not take everything waiting to be sent
+		int          dropped; ///< Number of messages dropped because the send queue was full
+		int          rtt; ///< Round-trip time in milliseconds, or -1 if not yet measured
+		int          levelSent; ///< Amount of the compressed level transferred, or -1 if no transfer is in progress
+		int          levelSize; ///< Size of the compressed level being transferred
+		int          interval; ///< Milliseconds between player state updates, or 0 if not paced
+		int          bandwidth; ///< Estimated bytes per second the connection carries, or 0 if not yet known
+
+		NetStats ();
+
+};
 
 /// Networking
 class Network {
 
+	private:
+		SDL_Thread   *thread; ///< Thread servicing the channels, or NULL if not yet started
+		SDL_mutex    *channelLock; ///< Guards the list of channels
+		NetChannel   *channels; ///< Connections serviced by the thread
+		int           channelsChanged; ///< Incremented whenever a channel is added or removed
+		SDL_atomic_t  quit; ///< Set to stop the thread
+		Job           connectJob; ///< Job looking up the server and connecting to it
+		char         *connectAddress; ///< Address being connected to, or NULL if no job has been submitted
+		int           connectResult; ///< Connection socket or error code, once the job is done
+		SDL_atomic_t  connectCancelled; ///< Set once the connection is no longer wanted
+
+		static int  run     (void* data);
+		static void connect (void* data);
+
+		void finishConnect ();
+
 	public:
 #ifdef USE_SDL_NET
 		TCPsocket socket;
@@ -60,17 +134,117 @@ class Network {
 		SDLNet_SocketSet socketset;
 #endif
 
-		Network          ();
-		~Network         ();
-
-		int  host        ();
-		int  join        (char *address);
-		int  accept      (int sock);
-		void close       (int sock);
-		int  send        (int sock, unsigned char *buffer);
-		int  recv        (int sock, unsigned char *buffer, int length);
-		bool isConnected (int sock);
-		int  getError    ();
+		Network           ();
+		~Network          ();
+
+		int  host         ();
+		int  join         (char *address);
+		int  accept       (int sock);
+		void close        (int sock);
+		void close        (NetChannel *channel);
+		int  send         (int sock, unsigned char *buffer);
+		int  send         (int sock, unsigned char *buffer, int length);
+		int  recv         (int sock, unsigned char *buffer, int length);
+		int  ready        (int *socks, int nSocks, bool *readable, int wait = 0);
+		int  openDatagram (int port);
+		int  sendTo       (int sock, unsigned char *buffer, int length, unsigned int address, int port);
+		int  recvFrom     (int sock, unsigned char *buffer, int length, unsigned int *address, int *port);
+		bool getPeer      (int sock, unsigned int *address);
+		bool isConnected  (int sock);
+		int  getError     ();
+
+		NetChannel* open  (int sock);
+
+};
+
+
+/// Connection whose socket is read and written by the network thread. Data
+/// passes between the threads through a ring in each direction, each with one
+/// thread adding to it and the other taking from it, so no locking is needed.
+class NetChannel {
+
+	private:
+		NetChannel    *next; ///< Next channel serviced by the network thread
+		int            sock; ///< Connection socket
+		unsigned char  inData[NET_BUFFER]; ///< Received data, wrapping around to the start
+		SDL_atomic_t   inEnd; ///< Total received, only written by the network thread
+		SDL_atomic_t   inStart; ///< Total taken by the game thread, only written by it
+		unsigned char  outData[NET_QUEUE]; ///< Data to send, wrapping around to the start
+		SDL_atomic_t   outEnd; ///< Total handed over by the game thread, only written by it
+		SDL_atomic_t   outStart; ///< Total sent by the network thread, only written by it
+		SDL_atomic_t   closed; ///< Set by the network thread once the connection has gone
+		SDL_atomic_t   stalls; ///< Times the connection would not take everything, only written by the network thread
+		unsigned int   messagesIn[NET_TYPES]; ///< Messages taken by the game thread, by type
+		unsigned int   messagesOut[NET_TYPES]; ///< Messages handed over by the game thread, by type
+
+		NetChannel (int channelSock);
+
+		bool canReceive ();
+		void service    (bool readable);
+
+		friend class Network;
+		friend class NetQueue;
+
+	public:
+		int  getSock    ();
+		bool getMessage (unsigned char *buffer);
+		int  read       (unsigned char *buffer, int length);
+		int  write      (unsigned char *buffer, int length);
+		bool         isEmpty    ();
+		bool         isClosed   ();
+		unsigned int getSent    ();
+		int          getBacklog ();
+		void         getStats   (NetStats *stats);
+
+};
+
+
+/// Messages waiting to be sent over a connection
+class NetQueue {
+
+	private:
+		unsigned char data[NET_QUEUE]; ///< Queued messages
+		int           length; ///< Amount of queued data
+		int           partial; ///< Amount of queued data left from a partly-sent message
+		int           dropped; ///< Number of messages which did not fit in the queue
+
+	public:
+		NetQueue ();
+
+		void clear     ();
+		bool add       (unsigned char *message, bool supersede);
+		int  flush     (NetChannel *channel);
+		int  flush     (NetChannel *channel, int backlog);
+		bool isEmpty   ();
+		int  getLength ();
+		void getStats  (NetStats *stats);
+
+};
+
+
+/// Paces player state over a connection. The connection's bandwidth is
+/// estimated while it is full, and updates are sent less often while data
+/// backs up or the round-trip time grows, and more often again once it clears.
+class NetRate {
+
+	private:
+		unsigned int lastTime; ///< When the bandwidth was last measured
+		unsigned int lastSent; ///< Data the network thread had sent by then
+		bool         saturated; ///< Whether or not data was backed up throughout the measurement
+		int          bandwidth; ///< Estimated bytes per second, or 0 if not yet known
+		int          minRtt; ///< Lowest round-trip time seen, or -1 if not yet measured
+		int          interval; ///< Milliseconds between player state updates
+		int          fastest; ///< Least milliseconds between updates
+		int          slowest; ///< Most milliseconds between updates
+
+	public:
+		NetRate (int fastestInterval, int slowestInterval);
+
+		void update      (NetChannel *channel, NetQueue *queue, int rtt, unsigned int ticks);
+		int  getInterval ();
+		int  getBacklog  ();
+		int  getBudget   ();
+		void getStats    (NetStats *stats);
 
 };
 
@@ -32,10 +32,12 @@ namespace ModPlug
 		0,
 		0,
 		0,
+		0,
 		0
 	};
 
 	int gSampleSize;
+	bool gSettingsChanged = true;
 
 	void UpdateSettings(bool updateBasicConfig)
 	{
@@ -78,13 +80,21 @@ namespace ModPlug
 		                            gSettings.mFlags & MODPLUG_ENABLE_NOISE_REDUCTION,
 		                            false);
 		CSoundFile::SetResamplingMode(gSettings.mResamplingMode);
+		CSoundFile::SetCullingConfig(gSettings.mFlags & MODPLUG_ENABLE_CULLING,
+		                             gSettings.mCullVolume);
 	}
 }
 
 ModPlugFile* ModPlug_Load(const void* data, int size)
 {
 	ModPlugFile* result = new ModPlugFile;
-	ModPlug::UpdateSettings(true);
+	// Only apply new settings, as doing so resets the mixer's DSP state
+	// under any other file being played
+	if (ModPlug::gSettingsChanged)
+	{
+		ModPlug::UpdateSettings(true);
+		ModPlug::gSettingsChanged = false;
+	}
 	if(result->mSoundFile.Create((const BYTE*)data, size))
 	{
 		result->mSoundFile.SetRepeatCount(ModPlug::gSettings.mLoopCount);
@@ -183,6 +193,19 @@ int ModPlug_GetPlayingChannels(ModPlugFile* file)
 	return ( file->mSoundFile.m_nMixChannels < file->mSoundFile.m_nMaxMixChannels ? file->mSoundFile.m_nMixChannels : file->mSoundFile.m_nMaxMixChannels );
 }
 
+void ModPlug_SetPlayOnce(ModPlugFile* file, int once)
+{
+	if (once)
+	{
+		file->mSoundFile.SetRepeatCount(0);
+		file->mSoundFile.m_dwSongFlags |= SONG_NOFADE;
+	} else
+	{
+		file->mSoundFile.SetRepeatCount(ModPlug::gSettings.mLoopCount);
+		file->mSoundFile.m_dwSongFlags &= ~SONG_NOFADE;
+	}
+}
+
 void ModPlug_SeekOrder(ModPlugFile* file,int order)
 {
 	file->mSoundFile.SetCurrentOrder(order);
@@ -263,4 +286,5 @@ void ModPlug_SetSettings(const ModPlug_Settings* settings)
 {
 	memcpy(&ModPlug::gSettings, settings, sizeof(ModPlug_Settings));
 	ModPlug::UpdateSettings(false); // do not update basic config.
+	ModPlug::gSettingsChanged = true;
 }
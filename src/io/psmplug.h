@@ -59,7 +59,8 @@ enum _ModPlug_Flags
 	MODPLUG_ENABLE_NOISE_REDUCTION  = 1 << 1,  /* Enable noise reduction */
 	MODPLUG_ENABLE_REVERB           = 1 << 2,  /* Enable reverb */
 	MODPLUG_ENABLE_MEGABASS         = 1 << 3,  /* Enable megabass */
-	MODPLUG_ENABLE_SURROUND         = 1 << 4   /* Enable surround sound. */
+	MODPLUG_ENABLE_SURROUND         = 1 << 4,  /* Enable surround sound. */
+	MODPLUG_ENABLE_CULLING          = 1 << 5   /* Skip channels too quiet to hear, and silent mixes */
 };
 
 enum _ModPlug_ResamplingMode
@@ -92,6 +93,8 @@ typedef struct _ModPlug_Settings
 	int mSurroundDelay;    /* Surround delay in ms, usually 5-40ms */
 	int mLoopCount;        /* Number of times to loop.  Zero prevents looping.
 	                        * -1 loops forever. */
+	int mCullVolume;       /* With culling, channel volume below which nothing is mixed,
+	                        * 0-65535 of full volume */
 } ModPlug_Settings;
 
 /* Get and set the mod decoder settings.  All options, except for channels, bits-per-sample,
@@ -117,6 +120,11 @@ int ModPlug_GetCurrentPattern(ModPlugFile* file);
 int ModPlug_GetCurrentRow(ModPlugFile* file);
 int ModPlug_GetPlayingChannels(ModPlugFile* file);
 
+/* Play the song through once, ending exactly where it would loop instead of
+ * fading out, so ModPlug_Read() returns less than was asked for at the end.
+ * Passing 0 goes back to looping as set by ModPlug_SetSettings(). */
+void ModPlug_SetPlayOnce(ModPlugFile* file, int once);
+
 void ModPlug_SeekOrder(ModPlugFile* file,int order);
 int ModPlug_GetModuleType(ModPlugFile* file);
 char* ModPlug_GetMessage(ModPlugFile* file);
@@ -128,6 +136,28 @@ unsigned int ModPlug_NumChannels(ModPlugFile* file);
 unsigned int ModPlug_SampleName(ModPlugFile* file, unsigned int qual, char* buff);
 unsigned int ModPlug_InstrumentName(ModPlugFile* file, unsigned int qual, char* buff);
 
+/* Mixer kernels which have NEON versions */
+enum _ModPlug_Kernel
+{
+	MODPLUG_KERNEL_CONVERT16    = 0,  /* Clip and convert mixed samples to 16 bits */
+	MODPLUG_KERNEL_STEREOFILL   = 1,  /* Fill the mix with decaying offsets */
+	MODPLUG_KERNEL_FIR_MONO8    = 2,  /* 8-tap fir filter resampling, 8-bit mono */
+	MODPLUG_KERNEL_FIR_MONO16   = 3,  /* 8-tap fir filter resampling, 16-bit mono */
+	MODPLUG_KERNEL_FIR_STEREO8  = 4,  /* 8-tap fir filter resampling, 8-bit stereo */
+	MODPLUG_KERNEL_FIR_STEREO16 = 5,  /* 8-tap fir filter resampling, 16-bit stereo */
+	MODPLUG_KERNELS             = 6
+};
+
+/* Run one of the mixer's kernels on [samples] output samples, using either its
+ * NEON version or its plain C version, so the two can be compared.  [input]
+ * holds 32-bit mixed samples for MODPLUG_KERNEL_CONVERT16, the two 32-bit
+ * starting offsets for MODPLUG_KERNEL_STEREOFILL, or at least 2 * [samples] + 8
+ * sample frames for the fir filters.  [output] receives everything the kernel
+ * produces, including the state it leaves behind, in at most 8 * [samples] + 8
+ * bytes.  Returns the number of bytes produced, or 0 if the kernel has no NEON
+ * version in this build. */
+int ModPlug_RunKernel(int kernel, int neon, const void* input, int samples, void* output);
+
 /*
  * Retrieve pattern note-data
  */
@@ -425,6 +425,17 @@ BOOL CSoundFile::SetMixConfig(UINT nStereoSeparation, UINT nMaxMixChannels)
 }
 
 
+BOOL CSoundFile::SetCullingConfig(BOOL bCull, UINT nVolume)
+//---------------------------------------------------------
+{
+	if (nVolume > 0xFFFF) nVolume = 0xFFFF;
+	gnCullVolume = nVolume;
+	if (bCull) gdwSoundSetup |= SNDMIX_CULLSILENT;
+	else gdwSoundSetup &= ~SNDMIX_CULLSILENT;
+	return TRUE;
+}
+
+
 BOOL CSoundFile::SetResamplingMode(UINT nMode)
 //--------------------------------------------
 {
@@ -1101,6 +1112,36 @@ void CSoundFile::AdjustSampleLoop(MODINSTRUMENT *pIns)
 }
 
 
+// Converts an 8-bit mono sample to 16-bit once, as it is loaded, so that
+// the mixer only ever runs its 16-bit mono kernels. Forward loops are
+// unrolled past their end, so each interpolation mode reads the samples
+// after the loop point without checking where the loop is.
+BOOL CSoundFile::ConvertSampleTo16Bit(MODINSTRUMENT *pIns)
+//--------------------------------------------------------
+{
+	if ((!pIns) || (!pIns->pSample) || (!pIns->nLength)) return FALSE;
+	if (pIns->uFlags & (CHN_16BIT|CHN_STEREO)) return TRUE;
+	UINT len = pIns->nLength;
+	int16_t *pNew = (int16_t *)AllocateSample((len+SAMPLE_LOOPPAD+1)*2);
+	if (!pNew) return FALSE;
+	const signed char *pOld = pIns->pSample;
+	for (UINT j=0; j<len; j++) pNew[j] = (int16_t)(pOld[j] << 8);
+	FreeSample(pIns->pSample);
+	pIns->pSample = (signed char *)pNew;
+	pIns->uFlags |= CHN_16BIT;
+	AdjustSampleLoop(pIns);
+	if ((pIns->uFlags & (CHN_LOOP|CHN_PINGPONGLOOP)) == CHN_LOOP)
+	{
+		// Copied in order, so loops shorter than the padding repeat
+		for (UINT k=0; k<SAMPLE_LOOPPAD; k++)
+		{
+			pNew[pIns->nLoopEnd+k] = pNew[pIns->nLoopStart+k];
+		}
+	}
+	return TRUE;
+}
+
+
 /////////////////////////////////////////////////////////////
 // Transpose <-> Frequency conversions
 
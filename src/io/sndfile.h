@@ -18,6 +18,7 @@ typedef const BYTE * LPCBYTE;
 
 #define MOD_AMIGAC2			0x1AB
 #define MAX_SAMPLE_LENGTH	16000000
+#define SAMPLE_LOOPPAD		5	// Samples copied past loop ends for interpolation
 #define MAX_SAMPLE_RATE		192000
 #define MAX_ORDERS			256
 #define MAX_PATTERNS		240
@@ -250,6 +251,7 @@ typedef const BYTE * LPCBYTE;
 #define SONG_SURROUNDPAN	0x4000
 #define SONG_EXFILTERRANGE	0x8000
 #define SONG_AMIGALIMITS	0x10000
+#define SONG_NOFADE			0x20000
 
 // Global Options (Renderer)
 #define SNDMIX_REVERSESTEREO	0x0001
@@ -263,6 +265,7 @@ typedef const BYTE * LPCBYTE;
 #define SNDMIX_EQ				0x0100
 #define SNDMIX_SOFTPANNING		0x0200
 #define SNDMIX_ULTRAHQSRCMODE	0x0400
+#define SNDMIX_CULLSILENT		0x0800	// Skip channels below gnCullVolume, and silent mixes
 // Misc Flags (can safely be turned on or off)
 #define SNDMIX_DIRECTTODISK		0x10000
 #define SNDMIX_ENABLEMMX		0x20000
@@ -547,6 +550,7 @@ public:	// Static Members
 	static DWORD gnChannels;
 	static UINT gnAGC;
 	static UINT gnVolumeRampSamples;
+	static UINT gnCullVolume;
 	static UINT gnVUMeter;
 	static UINT gnCPUUsage;
 	static LPSNDMIXHOOKPROC gpSndMixHook;
@@ -637,6 +641,7 @@ public:
 
 	UINT Read(LPVOID lpBuffer, UINT cbBuffer);
 	UINT CreateStereoMix(int count);
+	BOOL IsMixSilent() const;
 	BOOL FadeSong(UINT msec);
 	BOOL GlobalFadeSong(UINT msec);
 	UINT GetTotalTickCount() const { return m_nTotalCount; }
@@ -648,6 +653,8 @@ public:
 	static BOOL SetMixConfig(UINT nStereoSeparation, UINT nMaxMixChannels);
 	static BOOL SetWaveConfig(UINT nRate,UINT nBits,UINT nChannels,BOOL bMMX=FALSE);
 	static BOOL SetResamplingMode(UINT nMode); // SRCMODE_XXXX
+	// [Cull channels quieter than nVolume, 0-65535 of full volume]
+	static BOOL SetCullingConfig(BOOL bCull, UINT nVolume);
 	static BOOL IsStereo() { return (gnChannels > 1) ? TRUE : FALSE; }
 	static DWORD GetSampleRate() { return gdwMixingFreq; }
 	static DWORD GetBitsPerSample() { return gnBitsPerSample; }
@@ -721,6 +728,7 @@ public:
 	UINT DetectUnusedSamples(BOOL *);
 	BOOL RemoveSelectedSamples(BOOL *);
 	void AdjustSampleLoop(MODINSTRUMENT *pIns);
+	BOOL ConvertSampleTo16Bit(MODINSTRUMENT *pIns);
 	// I/O from another sound file
 	BOOL ReadInstrumentFromSong(UINT nInstr, CSoundFile *, UINT nSrcInstrument);
 	BOOL ReadSampleFromSong(UINT nSample, CSoundFile *, UINT nSrcSample);
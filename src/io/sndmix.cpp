@@ -10,6 +10,7 @@
 
 // Volume ramp length, in 1/10 ms
 #define VOLUMERAMPLEN	146	// 1.46ms = 64 samples at 44.1kHz
+#define CULLDSPTAIL		1000	// ms of silence after which the DSP effects' tails are dropped
 
 // VU-Meter
 #define VUMETER_DECAY		4
@@ -27,6 +28,7 @@ DWORD CSoundFile::gnBitsPerSample = 16;
 // Mixing data initialized in
 UINT CSoundFile::gnAGC = AGC_UNITY;
 UINT CSoundFile::gnVolumeRampSamples = 64;
+UINT CSoundFile::gnCullVolume = 0;
 UINT CSoundFile::gnVUMeter = 0;
 UINT CSoundFile::gnCPUUsage = 0;
 LPSNDMIXHOOKPROC CSoundFile::gpSndMixHook = NULL;
@@ -35,6 +37,7 @@ LONG gnDryROfsVol = 0;
 LONG gnDryLOfsVol = 0;
 LONG gnRvbROfsVol = 0;
 LONG gnRvbLOfsVol = 0;
+UINT gnSilentSamples = 0;	// Samples mixed since anything could last be heard
 int gbInitPlugins = 0;
 
 typedef DWORD (MPPASMCALL * LPCONVERTPROC)(LPVOID, int *, DWORD, LPLONG, LPLONG);
@@ -145,6 +148,21 @@ BOOL CSoundFile::GlobalFadeSong(UINT msec)
 }
 
 
+BOOL CSoundFile::IsMixSilent() const
+//----------------------------------
+{
+	// Nothing is heard while every channel is at zero volume, not ramping,
+	// and the click removal offsets have decayed
+	if ((gpSndMixHook) || (gnDryROfsVol) || (gnDryLOfsVol)) return FALSE;
+	for (UINT noff=0; noff < m_nMixChannels; noff++)
+	{
+		const MODCHANNEL *pChn = &Chn[ChnMix[noff]];
+		if ((pChn->pCurrentSample) && ((pChn->nRampLength) || (pChn->nLeftVol) || (pChn->nRightVol))) return FALSE;
+	}
+	return TRUE;
+}
+
+
 UINT CSoundFile::Read(LPVOID lpDestBuffer, UINT cbBuffer)
 //-------------------------------------------------------
 {
@@ -179,10 +197,10 @@ UINT CSoundFile::Read(LPVOID lpDestBuffer, UINT cbBuffer)
 			} else
 			if (!ReadNote())
 			{
-				if (!FadeSong(FADESONGDELAY))
+				if ((m_dwSongFlags & SONG_NOFADE) || (!FadeSong(FADESONGDELAY)))
 				{
 					m_dwSongFlags |= SONG_ENDREACHED;
-					if (lRead == lMax) goto MixDone;
+					if ((lRead == lMax) || (m_dwSongFlags & SONG_NOFADE)) goto MixDone;
 					m_nBufferCount = lRead;
 				}
 			}
@@ -195,6 +213,26 @@ UINT CSoundFile::Read(LPVOID lpDestBuffer, UINT cbBuffer)
 #ifndef MODPLUG_NO_REVERB
 		gnReverbSend = 0;
 #endif
+		// Skipping silent mixes, once any DSP effects have died away
+		if ((gdwSoundSetup & SNDMIX_CULLSILENT) && (IsMixSilent()))
+		{
+			if ((!(gdwSoundSetup & (SNDMIX_REVERB|SNDMIX_MEGABASS|SNDMIX_SURROUND|SNDMIX_NOISEREDUCTION|SNDMIX_EQ)))
+			 || (gnSilentSamples >= (gdwMixingFreq * CULLDSPTAIL) / 1000))
+			{
+				// Starting again from silence when anything can be heard
+				if (gnSilentSamples != 0xFFFFFFFF) InitializeDSP(TRUE);
+				gnSilentSamples = 0xFFFFFFFF;
+				// Only the channels' positions move on
+				m_nMixStat += CreateStereoMix(lCount);
+				memset(lpBuffer, (gnBitsPerSample == 8) ? 0x80 : 0, lCount * lSampleSize);
+				lpBuffer += lCount * lSampleSize;
+				nStat++;
+				lRead -= lCount;
+				m_nBufferCount -= lCount;
+				continue;
+			}
+			gnSilentSamples += lCount;
+		} else gnSilentSamples = 0;
 		// Resetting sound buffer
 		X86_StereoFill(MixSoundBuffer, lSampleCount, &gnDryROfsVol, &gnDryLOfsVol);
 		if (gnChannels >= 2)
@@ -997,6 +1035,12 @@ BOOL CSoundFile::ReadNote()
 					}
 				}
 			}
+			// Culling channels too quiet to hear, ramping them down to silence
+			if ((gdwSoundSetup & SNDMIX_CULLSILENT)
+			 && (pChn->nNewRightVol < (LONG)gnCullVolume) && (pChn->nNewLeftVol < (LONG)gnCullVolume))
+			{
+				pChn->nNewRightVol = pChn->nNewLeftVol = 0;
+			}
 			pChn->nNewRightVol >>= MIXING_ATTENUATION;
 			pChn->nNewLeftVol >>= MIXING_ATTENUATION;
 			pChn->nRightRamp = pChn->nLeftRamp = 0;
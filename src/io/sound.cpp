@@ -23,12 +23,24 @@
 
 #include "file.h"
 #include "sound.h"
+#include "jobs.h"
+#include "memtrack.h"
+#include "profile.h"
+#include "residency.h"
 #include "util.h"
+#include "loop.h"
 
 //#include "SDL_audio.h"
 #include <SDL2/SDL_audio.h>
 #include "psmplug.h"
 
+#include <string.h>
+
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	#include <arm_neon.h>
+#endif
+
 #if defined(__SYMBIAN32__) || defined(_3DS) || defined(PSP)
 	#define SOUND_FREQ 22050
 #else
@@ -52,70 +64,1384 @@
 	#define MUSIC_FLAGS MODPLUG_ENABLE_NOISE_REDUCTION | MODPLUG_ENABLE_REVERB | MODPLUG_ENABLE_MEGABASS | MODPLUG_ENABLE_SURROUND
 #endif
 
-ModPlugFile *musicFile;
+// Channel volume, out of 65535, below which music channels are not mixed
+#define MUSIC_CULL_VOLUME 64
+
+#define AUDIO_COMMANDS 64 /* Must be a power of 2 */
+
+#ifndef MAX_VOICES
+	#define MAX_VOICES 16 /* Sound clips which may play at once */
+#endif
+
+#define SOUND_INSTANCES 4 /* Default limit on voices playing the same clip */
+
+#ifndef MUSIC_LOOKAHEAD
+	#define MUSIC_LOOKAHEAD 3 /* Output buffers' worth of music to render ahead */
+#endif
+
+#ifndef MUSIC_CACHE_SIZE
+	#define MUSIC_CACHE_SIZE (8 << 20) /* Most bytes of compressed music kept for one track */
+#endif
+
+
+/// Kinds of audio command
+enum AudioCommandType {
+
+	AC_PLAY, ///< Start a sound clip
+	AC_SOUND_VOLUME, ///< Change the sound effect volume
+	AC_MUSIC, ///< Change the music being played
+	AC_MUSIC_VOLUME, ///< Change the music volume
+	AC_MUSIC_TEMPO, ///< Change the music tempo
+	AC_PAUSE_MUSIC ///< Pause or unpause the music
+
+};
+
+/// State of one channel of IMA ADPCM coding
+typedef struct {
+
+	int sample; ///< Last decoded sample
+	int index; ///< Position in the step table
+
+} AdpcmChannel;
+
+/// Track recorded the first time it plays, so it can loop without ModPlug
+typedef struct MusicCache {
+
+	struct MusicCache *next; ///< Another track
+	char              *name; ///< The music file's name
+	unsigned char     *data; ///< IMA ADPCM frames, left channel in the low nibble, only used by the music thread
+	int                size; ///< Bytes allocated
+	int                frames; ///< Frames recorded
+	AdpcmChannel       start[2]; ///< Coder state at the first frame
+	SDL_atomic_t       complete; ///< Set by the music thread once the whole track is recorded
+
+} MusicCache;
+
+/// Change for the audio callback or the music thread to make
+typedef struct {
+
+	AudioCommandType type;
+	ModPlugFile*     music; ///< New music, for AC_MUSIC
+	MusicCache*      cache; ///< Track to record the new music into or to play instead, for AC_MUSIC
+	int              index; ///< Sound clip, for AC_PLAY
+	int              gainLeft; ///< Left channel gain, for AC_PLAY
+	int              gainRight; ///< Right channel gain, for AC_PLAY
+	int              value; ///< New volume, tempo or paused state
+
+} AudioCommand;
+
+/// Sound clip being played
+typedef struct {
+
+	const short int* data; ///< The clip's samples
+	int              clip; ///< Index of the clip, or -1 when the voice is free
+	int              length; ///< Number of samples
+	int              position; ///< Next sample to play
+	int              gainLeft; ///< Left channel gain, out of MIX_UNITY
+	int              gainRight; ///< Right channel gain, out of MIX_UNITY
+	unsigned int     started; ///< When the voice was started, relative to the others
+
+} Voice;
+
+/// Ring of commands passed from the game thread to one other thread
+typedef struct {
+
+	AudioCommand commands[AUDIO_COMMANDS];
+	SDL_atomic_t sent; ///< Only written by the game thread
+	SDL_atomic_t done; ///< Only written by the receiving thread
+
+} AudioQueue;
+
+
+ModPlugFile *musicFile; ///< Only used by the music thread while it runs
 SDL_AudioSpec  audioSpec;
+SDL_AudioDeviceID audioDevice = 0;
+int audioSamples = SOUND_SAMPLES; ///< Requested buffer size, in sample frames
+int audioRate = SOUND_FREQ; ///< Preferred output rate
+SDL_atomic_t callbackAverage; ///< Smoothed time taken by the audio callback, in microseconds
+SDL_atomic_t callbackPeak; ///< Longest time taken by the audio callback, in microseconds
 bool musicPaused = false;
 int musicVolume = MAX_VOLUME >> 1; // 50%
 int soundVolume = MAX_VOLUME >> 2; // 25%
 char *currentMusic = NULL;
 int musicTempo = MUSIC_NORMAL;
+Job resampleJob; ///< Background job resampling the sound clips at start-up
+bool resampling = false; ///< Whether or not the resampling job has been submitted
+char *rawSoundsFile = NULL; ///< Name of the file the raw clips were loaded from
+int rawSoundsResident = -1; ///< Residency of the raw clips' samples, which are only needed for resampling
+int *mixBuffer = NULL;
+int mixLength = 0;
+int mixVolume = MAX_VOLUME >> 2; ///< The audio callback's copy of soundVolume
+
+Voice voices[MAX_VOICES]; ///< Only used by the audio callback while audio is open
+unsigned int voicesStarted = 0;
+fixed listenerX = 0;
+fixed listenerY = 0;
+bool soundsHeld = false; ///< Whether or not new sound effects are ignored
+AudioQueue soundQueue; ///< Commands for the audio callback
+AudioQueue musicQueue; ///< Commands for the music thread
+SDL_Thread *musicThread = NULL;
+SDL_atomic_t musicQuit;
+unsigned char *musicRing = NULL; ///< Music rendered ahead of the audio callback
+int musicRingSize = 0;
+int musicChunk = 0; ///< Bytes of music rendered at a time
+int musicRingRead = 0; ///< Only used by the audio callback
+SDL_atomic_t musicRingFill; ///< Bytes rendered but not yet played
+MusicCache *musicCaches = NULL; ///< Tracks to record, only used by the game thread
+MusicCache *musicCache = NULL; ///< Recorded track being played, only used by the music thread
+MusicCache *musicRecording = NULL; ///< Track musicFile is being recorded into, only used by the music thread
+AdpcmChannel musicCoder[2]; ///< State of recording or playing a track
+int musicFrame = 0; ///< Next frame of the recorded track to play
+int musicGain = MAX_VOLUME >> 1; ///< The music thread's copy of musicVolume
+SDL_mutex *prefetchLock = NULL; ///< Guards the prefetched music and currentMusic against the preloading thread
+ModPlugFile *prefetchedMusic = NULL; ///< Music loaded ahead of being played
+char *prefetchedName = NULL; ///< Name of the prefetched music's file
+
+const short int adpcmSteps[89] = {
+	7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+	50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173, 190, 209, 230,
+	253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963,
+	1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327,
+	3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132, 7845, 8630, 9493, 10442,
+	11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794,
+	32767};
+const signed char adpcmIndices[16] = {-1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8};
+
+
+/**
+ * Add a voice's samples to the mix.
+ *
+ * @param mix The mix, with left and right channels interleaved
+ * @param samples The voice's mono samples
+ * @param count Number of samples
+ * @param gainLeft Gain on the left channel, out of MIX_UNITY
+ * @param gainRight Gain on the right channel, out of MIX_UNITY
+ */
+static void mixVoice (int* mix, const Sint16* samples, int count, int gainLeft, int gainRight) {
+
+	int sample;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	int32x4_t voice;
+	int32x4x2_t pairs;
+
+	for (sample = 0; sample + 4 <= count; sample += 4) {
+
+		voice = vmovl_s16(vld1_s16(samples + sample));
+
+		// Split the mix into its channels, and put it back together afterwards
+		pairs = vld2q_s32(mix + (sample << 1));
+		pairs.val[0] = vaddq_s32(pairs.val[0], vshrq_n_s32(vmulq_n_s32(voice, gainLeft), 8));
+		pairs.val[1] = vaddq_s32(pairs.val[1], vshrq_n_s32(vmulq_n_s32(voice, gainRight), 8));
+		vst2q_s32(mix + (sample << 1), pairs);
+
+	}
+#else
+	sample = 0;
+#endif
+
+	for (; sample < count; sample++) {
+
+		mix[sample << 1] += (samples[sample] * gainLeft) >> 8;
+		mix[(sample << 1) + 1] += (samples[sample] * gainRight) >> 8;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Clamp the mix into the output stream.
+ *
+ * @param stream The output stream
+ * @param mix The mix
+ * @param count Number of samples
+ */
+static void outputMix (Sint16* stream, const int* mix, int count) {
+
+	int sample;
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	for (sample = 0; sample + 4 <= count; sample += 4)
+		vst1_s16(stream + sample, vqmovn_s32(vld1q_s32(mix + sample)));
+#else
+	sample = 0;
+#endif
+
+	for (; sample < count; sample++) {
+
+		if (mix[sample] > 32767) stream[sample] = 32767;
+		else if (mix[sample] < -32768) stream[sample] = -32768;
+		else stream[sample] = mix[sample];
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Start playing a sound clip. If the clip is already playing as many times
+ * as it may, its oldest voice is restarted. Otherwise a free voice is used,
+ * or failing that the oldest voice of the lowest priority clip is stolen.
+ *
+ * @param clip The clip to play
+ * @param gainLeft Left channel gain, out of MIX_UNITY
+ * @param gainRight Right channel gain, out of MIX_UNITY
+ */
+static void startVoice (int clip, int gainLeft, int gainRight) {
+
+	Voice* voice;
+	int count, instances, priority;
+
+	if (!sounds[clip].data) return;
+
+	voice = NULL;
+	instances = 0;
+
+	for (count = 0; count < MAX_VOICES; count++) {
+
+		if (voices[count].clip == clip) {
+
+			instances++;
+
+			if (!voice || ((int)(voices[count].started - voice->started) < 0))
+				voice = voices + count;
+
+		}
+
+	}
+
+	if (instances < sounds[clip].maxVoices) {
+
+		voice = voices;
+
+		for (count = 0; count < MAX_VOICES; count++) {
+
+			if (voices[count].clip < 0) {
+
+				voice = voices + count;
+
+				break;
+
+			}
+
+			priority = sounds[voices[count].clip].priority - sounds[voice->clip].priority;
+
+			if ((priority < 0) || (!priority && ((int)(voices[count].started - voice->started) < 0)))
+				voice = voices + count;
+
+		}
+
+		// Never interrupt a more important clip
+		if ((voice->clip >= 0) && (sounds[voice->clip].priority > sounds[clip].priority))
+			return;
+
+	}
+
+	if (voice->clip >= 0) sounds[voice->clip].playing--;
+
+	voice->data = sounds[clip].data;
+	voice->clip = clip;
+	voice->length = sounds[clip].length;
+	voice->position = 0;
+	voice->gainLeft = gainLeft;
+	voice->gainRight = gainRight;
+	voice->started = voicesStarted++;
+
+	sounds[clip].playing++;
+
+	return;
+
+}
+
+
+/**
+ * Stop the voices playing a sound clip. Only called by the audio callback or
+ * while it is locked out.
+ *
+ * @param clip The clip to stop, or -1 to stop every clip
+ */
+static void stopVoices (int clip) {
+
+	int count;
+
+	for (count = 0; count < MAX_VOICES; count++) {
+
+		if ((voices[count].clip >= 0) && ((clip < 0) || (voices[count].clip == clip))) {
+
+			sounds[voices[count].clip].playing--;
+			voices[count].clip = -1;
+
+		}
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Decode one channel's sample from a recorded track.
+ *
+ * @param channel The channel's coder state
+ * @param code The sample's 4-bit code
+ *
+ * @return The sample
+ */
+static int decodeAdpcm (AdpcmChannel* channel, int code) {
+
+	int step, difference;
+
+	step = adpcmSteps[channel->index];
+
+	difference = step >> 3;
+	if (code & 4) difference += step;
+	if (code & 2) difference += step >> 1;
+	if (code & 1) difference += step >> 2;
+
+	if (code & 8) channel->sample -= difference;
+	else channel->sample += difference;
+
+	if (channel->sample > 32767) channel->sample = 32767;
+	else if (channel->sample < -32768) channel->sample = -32768;
+
+	channel->index += adpcmIndices[code];
+
+	if (channel->index < 0) channel->index = 0;
+	else if (channel->index > 88) channel->index = 88;
+
+	return channel->sample;
+
+}
+
+
+/**
+ * Encode one channel's sample for a recorded track.
+ *
+ * @param channel The channel's coder state
+ * @param sample The sample
+ *
+ * @return The sample's 4-bit code
+ */
+static int encodeAdpcm (AdpcmChannel* channel, int sample) {
+
+	int step, difference, code;
+
+	step = adpcmSteps[channel->index];
+	difference = sample - channel->sample;
+	code = 0;
+
+	if (difference < 0) {
+
+		code = 8;
+		difference = -difference;
+
+	}
+
+	if (difference >= step) {
+
+		code |= 4;
+		difference -= step;
+
+	}
+
+	if (difference >= (step >> 1)) {
+
+		code |= 2;
+		difference -= step >> 1;
+
+	}
+
+	if (difference >= (step >> 2)) code |= 1;
+
+	// Keep in step with what the decoder will make of the code
+	decodeAdpcm(channel, code);
+
+	return code;
+
+}
+
+
+/**
+ * Add rendered music to the track being recorded.
+ *
+ * @param samples The music, with left and right channels interleaved
+ * @param frames Number of frames
+ *
+ * @return Whether or not there was room for the music
+ */
+static bool recordMusic (const Sint16* samples, int frames) {
+
+	unsigned char* data;
+	int size, count;
+
+	if (musicRecording->frames + frames > musicRecording->size) {
+
+		// Make room for more, up to the limit
+
+		size = musicRecording->size? musicRecording->size << 1: audioSpec.freq * 16;
+		if (size > MUSIC_CACHE_SIZE) size = MUSIC_CACHE_SIZE;
+		if (musicRecording->frames + frames > size) return false;
+
+		data = new unsigned char[size];
+		memcpy(data, musicRecording->data, musicRecording->frames);
+		delete[] musicRecording->data;
+
+		musicRecording->data = data;
+		musicRecording->size = size;
+
+	}
+
+	if (!musicRecording->frames && frames) {
+
+		// Start the coder at the first frame, so the track opens cleanly
+
+		for (count = 0; count < 2; count++) {
+
+			musicRecording->start[count].sample = samples[count];
+			musicRecording->start[count].index = 0;
+			musicCoder[count] = musicRecording->start[count];
+
+		}
+
+	}
+
+	data = musicRecording->data + musicRecording->frames;
+
+	for (count = 0; count < frames; count++) {
+
+		data[count] = encodeAdpcm(musicCoder, samples[count << 1]) |
+			(encodeAdpcm(musicCoder + 1, samples[(count << 1) + 1]) << 4);
+
+	}
+
+	musicRecording->frames += frames;
+
+	return true;
+
+}
+
+
+/**
+ * Give up recording the current music, and let it loop as normal.
+ */
+static void stopRecording () {
+
+	musicRecording->frames = 0;
+	musicRecording = NULL;
+
+	if (musicFile) {
+
+		ModPlug_SetPlayOnce(musicFile, 0);
+		ModPlug_SetMasterVolume(musicFile, musicGain * 2.56);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Decode music from the recorded track being played, looping at its end.
+ *
+ * @param samples Space for the music, with left and right channels interleaved
+ * @param frames Number of frames
+ */
+static void playRecording (Sint16* samples, int frames) {
+
+	int count, code;
+
+	for (count = 0; count < frames; count++) {
+
+		if (musicFrame == musicCache->frames) {
+
+			musicFrame = 0;
+			musicCoder[0] = musicCache->start[0];
+			musicCoder[1] = musicCache->start[1];
+
+		}
+
+		code = musicCache->data[musicFrame++];
+
+		samples[count << 1] = decodeAdpcm(musicCoder, code & 15);
+		samples[(count << 1) + 1] = decodeAdpcm(musicCoder + 1, code >> 4);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Apply the music volume to music recorded at half volume.
+ *
+ * @param samples The music
+ * @param count Number of samples
+ */
+static void scaleMusic (Sint16* samples, int count) {
+
+	int sample;
+
+	if ((musicGain << 1) == MAX_VOLUME) return;
+
+	while (count--) {
+
+		sample = (*samples * musicGain * 2) / MAX_VOLUME;
+
+		if (sample > 32767) sample = 32767;
+		else if (sample < -32768) sample = -32768;
+
+		*(samples++) = sample;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Carry out a command from the game thread.
+ *
+ * @param command The command
+ */
+static void runAudioCommand (AudioCommand* command) {
+
+	switch (command->type) {
+
+		case AC_PLAY:
+
+			startVoice(command->index, command->gainLeft, command->gainRight);
+
+			break;
+
+		case AC_SOUND_VOLUME:
+
+			mixVolume = command->value;
+
+			break;
+
+		case AC_MUSIC:
+
+			if (musicRecording) stopRecording();
+
+			if (musicFile) ModPlug_Unload(musicFile);
+			musicFile = command->music;
+			musicCache = NULL;
+
+			if (command->cache && musicFile) {
+
+				// Record the music as it plays
+				musicRecording = command->cache;
+				musicRecording->frames = 0;
+
+			} else if (command->cache) {
+
+				// Play the recording instead
+				musicCache = command->cache;
+				musicFrame = musicCache->frames;
+
+			}
+
+			break;
+
+		case AC_MUSIC_VOLUME:
+
+			musicGain = command->value;
+
+			// Recorded music has the volume applied afterwards
+			if (musicFile && !musicRecording) ModPlug_SetMasterVolume(musicFile, musicGain * 2.56);
+
+			break;
+
+		case AC_MUSIC_TEMPO:
+
+			// Tracks are only recorded at the normal tempo, and recordings
+			// always play at it
+			if (musicRecording && (command->value != 128)) stopRecording();
+
+			if (musicFile) ModPlug_SetMusicTempoFactor(musicFile, command->value);
+
+			break;
+
+		case AC_PAUSE_MUSIC:
+
+			musicPaused = command->value;
+
+			break;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Carry out every command the game thread has sent. Only called by the
+ * receiving thread, or while it cannot run.
+ *
+ * @param queue The commands
+ */
+static void runAudioCommands (AudioQueue* queue) {
+
+	int done;
+
+	done = SDL_AtomicGet(&(queue->done));
+
+	while (done != SDL_AtomicGet(&(queue->sent))) {
+
+		SDL_MemoryBarrierAcquire();
+
+		runAudioCommand(queue->commands + (done & (AUDIO_COMMANDS - 1)));
+
+		done++;
+		SDL_AtomicSet(&(queue->done), done);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Send a command to the audio callback or the music thread. Only called by
+ * the game thread.
+ *
+ * @param queue The receiving thread's commands
+ * @param command The command
+ */
+static void sendAudioCommand (AudioQueue* queue, AudioCommand* command) {
+
+	int sent;
+
+	sent = SDL_AtomicGet(&(queue->sent));
+
+	while (sent - SDL_AtomicGet(&(queue->done)) >= AUDIO_COMMANDS) {
+
+		// The ring is full (or its thread is not running), so catch up
+
+		if (queue != &musicQueue) {
+
+			SDL_LockAudioDevice(audioDevice);
+			runAudioCommands(queue);
+			SDL_UnlockAudioDevice(audioDevice);
+
+		} else if (musicThread) SDL_Delay(1);
+		else runAudioCommands(queue);
+
+	}
+
+	queue->commands[sent & (AUDIO_COMMANDS - 1)] = *command;
+
+	// The command must be complete before the other thread can see it
+	SDL_MemoryBarrierRelease();
+
+	SDL_AtomicSet(&(queue->sent), sent + 1);
+
+	return;
+
+}
+
+
+/**
+ * Render music ahead of the audio callback, so that heavy patterns cannot
+ * make the callback miss its deadline.
+ *
+ * @param data N/A
+ *
+ * @return 0
+ */
+static int renderMusic (void* data) {
+
+	Sint16* samples;
+	int position, length, delay;
+	bool recorded;
+
+	(void)data;
+
+	position = 0;
+
+	// Wait for roughly half an output buffer when there is nothing to do
+	delay = (audioSpec.samples * 500) / audioSpec.freq;
+	if (delay < 1) delay = 1;
+
+	while (!SDL_AtomicGet(&musicQuit)) {
+
+		runAudioCommands(&musicQueue);
+
+		if ((!musicFile && !musicCache) || (musicRingSize - SDL_AtomicGet(&musicRingFill) < musicChunk)) {
+
+			SDL_Delay(delay);
+
+			continue;
+
+		}
+
+		samples = (Sint16 *)(musicRing + position);
+		recorded = (musicRecording != NULL);
+		length = 0;
+
+		if (musicFile) {
+
+			length = ModPlug_Read(musicFile, samples, musicChunk);
+			if (length < 0) length = 0;
+
+		}
+
+		if (musicRecording) {
+
+			if (!recordMusic(samples, length >> 2)) {
+
+				stopRecording();
+
+			} else if (length < musicChunk) {
+
+				if (musicRecording->frames) {
+
+					// The track has reached its end, so loop the recording
+					// from now on
+					SDL_AtomicSet(&(musicRecording->complete), 1);
+
+					musicCache = musicRecording;
+					musicFrame = musicCache->frames;
+
+					ModPlug_Unload(musicFile);
+					musicFile = NULL;
+					musicRecording = NULL;
+
+				} else stopRecording();
+
+			}
+
+		}
+
+		if (musicCache) {
+
+			playRecording(samples + (length >> 1), (musicChunk - length) >> 2);
+
+			length = musicChunk;
+
+		} else if (length < musicChunk) memset(musicRing + position + length, audioSpec.silence, musicChunk - length);
+
+		if (recorded || musicCache) scaleMusic(samples, musicChunk >> 1);
+
+		position = (position + musicChunk) % musicRingSize;
+
+		// Also makes the rendered music visible to the audio callback
+		SDL_AtomicAdd(&musicRingFill, musicChunk);
+
+	}
+
+	return 0;
+
+}
+
+
+/**
+ * Fill the audio stream with music and sound effects.
+ *
+ * @param stream Output stream
+ * @param len Length of data to be placed in the output stream
+ */
+static void fillAudio (unsigned char * stream, int len) {
+
+	Voice* voice;
+	int count, length, samples, sample, gain, gainLeft, gainRight, remaining;
+
+	// Make any changes the game thread has asked for
+	runAudioCommands(&soundQueue);
+
+	// SDL does not clear the stream, so whatever no music is copied into
+	// has to be silenced
+	length = 0;
+
+	if (!musicPaused && musicRingSize) {
+
+		// Copy the next portion of rendered music into the audio stream
+
+		length = SDL_AtomicGet(&musicRingFill);
+		if (length > len) length = len;
+
+		count = musicRingSize - musicRingRead;
+		if (count > length) count = length;
+
+		memcpy(stream, musicRing + musicRingRead, count);
+		memcpy(stream + count, musicRing, length - count);
+
+		musicRingRead = (musicRingRead + length) % musicRingSize;
+		SDL_AtomicAdd(&musicRingFill, -length);
+
+	}
+
+	if (length < len) memset(stream + length, audioSpec.silence, len - length);
+
+	if (!sounds) return;
+
+	gain = mixVolume * MIX_UNITY / MAX_VOLUME;
+
+	samples = len >> 1;
+
+	if (!mixBuffer || (samples > mixLength)) return;
+
+	// Mix the music and every voice together at 32 bits, then clamp once
+
+	for (sample = 0; sample < samples; sample++) mixBuffer[sample] = ((Sint16 *)stream)[sample];
+
+	for (count = 0; count < MAX_VOICES; count++) {
+
+		voice = voices + count;
+
+		if (voice->clip < 0) continue;
+
+		remaining = voice->length - voice->position;
+
+		// The output is stereo, so has two samples for each voice sample
+		length = remaining;
+		if (length > (samples >> 1)) length = samples >> 1;
+
+		gainLeft = (voice->gainLeft * gain) / MIX_UNITY;
+		gainRight = (voice->gainRight * gain) / MIX_UNITY;
+
+		// Silent voices only need to keep their place
+		if (gainLeft || gainRight)
+			mixVoice(mixBuffer, voice->data + voice->position, length, gainLeft, gainRight);
+
+		if (length < remaining) {
+
+			voice->position += length;
+
+		} else {
+
+			sounds[voice->clip].playing--;
+			voice->clip = -1;
+
+		}
+
+	}
+
+	outputMix((Sint16 *)stream, mixBuffer, samples);
+
+	return;
+
+}
+
+
+/**
+ * Callback used to provide data to the audio subsystem. Keeps track of how
+ * long it takes, to help choose the smallest buffer a device can cope with.
+ *
+ * @param userdata N/A
+ * @param stream Output stream
+ * @param len Length of data to be placed in the output stream
+ */
+void audioCallback (void * userdata, unsigned char * stream, int len) {
+
+	Uint64 start;
+	int time, average;
+
+	(void)userdata;
+
+	PROFILE_BEGIN(PZ_AUDIO);
+
+	start = SDL_GetPerformanceCounter();
+
+	fillAudio(stream, len);
+
+	time = ((SDL_GetPerformanceCounter() - start) * 1000000) / SDL_GetPerformanceFrequency();
+
+	average = SDL_AtomicGet(&callbackAverage);
+	SDL_AtomicSet(&callbackAverage, average + ((time - average) >> 4));
+
+	if (time > SDL_AtomicGet(&callbackPeak)) SDL_AtomicSet(&callbackPeak, time);
+
+	PROFILE_END(PZ_AUDIO);
+
+	return;
+
+}
+
+
+/**
+ * Get a raw sound clip resampled to the output rate, resampling it only the
+ * first time it is used at the given rate.
+ *
+ * @param raw The raw clip
+ * @param rate The clip's sample rate
+ *
+ * @return The resampled clip
+ */
+static ResampledSound* getResampledSound (RawSound* raw, int rate) {
+
+	ResampledSound* clip;
+	unsigned int position, step;
+	int sample, current, next;
+
+	for (clip = raw->resampled; clip; clip = clip->next) {
+
+		if (clip->rate == rate) return clip;
+
+	}
+
+	// The raw samples may have been released while a level runs
+	if (!raw->data && ((residency.use(rawSoundsResident) < 0) || !raw->data))
+		return NULL;
+
+	clip = new ResampledSound;
+	clip->rate = rate;
+	clip->length = ((long long int)raw->length * audioSpec.freq) / rate;
+	clip->data = new short int[clip->length? clip->length: 1];
+
+	// Step through the raw clip in 16.16 fixed point, interpolating between
+	// neighbouring samples
+	step = ((unsigned int)rate << 16) / audioSpec.freq;
+	position = 0;
+
+	for (sample = 0; sample < clip->length; sample++) {
+
+		current = (signed char)(raw->data[position >> 16]);
+
+		if ((int)(position >> 16) + 1 < raw->length) next = (signed char)(raw->data[(position >> 16) + 1]);
+		else next = current;
+
+		clip->data[sample] = (current << 8) + (((next - current) * (int)(position & 0xFFFF)) >> 8);
+
+		position += step;
+
+	}
+
+	clip->next = raw->resampled;
+	raw->resampled = clip;
+
+	return clip;
+
+}
+
+
+/**
+ * Resample sound clip data. Must not be called while the clips are being
+ * resampled at start-up.
+ *
+ * @param index The number of the sound to replace
+ * @param name The name of the clip to resample
+ * @param rate The clip's sample rate
+ */
+static void resample (int index, const char* name, int rate) {
+
+	ResampledSound* clip;
+	int count;
+
+	clip = NULL;
+
+	// Search for matching sound
+
+	if (rate > 0) {
+
+		for (count = 0; count < nRawSounds; count++) {
+
+			if (!strcmp(name, rawSounds[count].name)) {
+
+				clip = getResampledSound(rawSounds + count, rate);
+
+				break;
+
+			}
+
+		}
+
+	}
+
+	// The clip's samples belong to the cache, so nothing needs freeing
+
+	if (!sounds) return;
+
+	SDL_LockAudioDevice(audioDevice);
+
+	stopVoices(index);
+
+	sounds[index].data = clip? clip->data: NULL;
+	sounds[index].length = clip? clip->length: 0;
+
+	SDL_UnlockAudioDevice(audioDevice);
+
+	return;
+
+}
+
+
+/**
+ * Resample every sound clip. Run as a background job at start-up.
+ *
+ * @param data Unused
+ */
+static void resampleAll (void* data) {
+
+	int count;
+
+	MEMORY_SCOPE(MEM_SOUND);
+
+	(void)data;
+
+	for (count = 0; (count < 32) && (count < nRawSounds); count++) {
+
+		resample(count, rawSounds[count].name, 11025);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Wait for the sound clips being resampled at start-up.
+ */
+static void finishResampling () {
+
+	if (resampling) {
+
+		jobs.wait(&resampleJob);
+		resampling = false;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Free the raw clips' samples, keeping the clips already resampled.
+ *
+ * @param data Unused
+ */
+static void releaseRawSounds (void* data) {
+
+	int count;
+
+	(void)data;
+
+	finishResampling();
+
+	for (count = 0; count < nRawSounds; count++) {
+
+		delete[] rawSounds[count].data;
+		rawSounds[count].data = NULL;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Load the raw clips' samples again, so that they can be resampled at a new
+ * rate.
+ *
+ * @param data Unused
+ *
+ * @return Error code
+ */
+static int reloadRawSounds (void* data) {
+
+	File *file;
+	int count, offset, headerOffset;
+
+	MEMORY_SCOPE(MEM_SOUND);
+
+	(void)data;
+
+	try {
+
+		file = new File(rawSoundsFile, false);
+
+	} catch (int e) {
+
+		return e;
+
+	}
+
+	file->seek(file->getSize() - 4, true);
+	headerOffset = file->loadInt();
+
+	for (count = 0; count < nRawSounds; count++) {
+
+		// Skip the clip's name, which was kept
+		file->seek(headerOffset + (count * 18) + 12, true);
+		offset = file->loadInt();
+
+		file->seek(offset, true);
+		rawSounds[count].data = file->loadBlock(rawSounds[count].length);
+
+	}
+
+	delete file;
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Initialise audio.
+ */
+void openAudio () {
+
+	SDL_AudioSpec asDesired;
+	ModPlug_Settings settings;
+	int count;
+
+	musicFile = NULL;
+	prefetchLock = SDL_CreateMutex();
+
+	for (count = 0; count < MAX_VOICES; count++) voices[count].clip = -1;
+
+	// Set up SDL audio
+
+	asDesired.freq = audioRate;
+	asDesired.format = AUDIO_S16SYS;
+	asDesired.channels = 2;
+	asDesired.samples = audioSamples;
+	asDesired.callback = audioCallback;
+	asDesired.userdata = NULL;
+
+	// Mix at whatever rate and buffer size the device prefers, so SDL only
+	// has to convert if it cannot take 16-bit stereo
+	audioDevice = SDL_OpenAudioDevice(NULL, 0, &asDesired, &audioSpec,
+		SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
+
+	if (!audioDevice) {
+
+		logError("Unable to open audio", SDL_GetError());
+
+		audioSpec = asDesired;
+		audioSpec.size = 0;
+
+	} else {
+
+		log("Audio rate (Hz)", audioSpec.freq);
+		log("Audio buffer (samples)", audioSpec.samples);
+
+	}
+
+	SDL_AtomicSet(&callbackAverage, 0);
+	SDL_AtomicSet(&callbackPeak, 0);
+
+	// Space to mix 16-bit samples in
+	mixLength = audioSpec.size >> 1;
+	mixBuffer = new int[mixLength? mixLength: 1];
+
+
+	// Set up libpsmplug
+
+	settings.mFlags = MUSIC_FLAGS | MODPLUG_ENABLE_CULLING;
+	settings.mChannels = audioSpec.channels;
+
+	if ((audioSpec.format == AUDIO_U8) || (audioSpec.format == AUDIO_S8))
+		settings.mBits = 8;
+	else settings.mBits = 16;
+
+	settings.mFrequency = audioSpec.freq;
+	settings.mResamplingMode = MUSIC_RESAMPLEMODE;
+	settings.mReverbDepth = 25;
+	settings.mReverbDelay = 40;
+	settings.mBassAmount = 50;
+	settings.mBassRange = 10;
+	settings.mSurroundDepth = 50;
+	settings.mSurroundDelay = 40;
+
+	// unlimited looping
+	settings.mLoopCount = -1;
+
+	// Muted and faded channels cost nothing, and neither do silent passages
+	settings.mCullVolume = MUSIC_CULL_VOLUME;
+
+	ModPlug_SetSettings(&settings);
+
+
+	// Start rendering music ahead of the audio callback
+
+	musicChunk = audioSpec.size;
+	musicRingSize = musicChunk * MUSIC_LOOKAHEAD;
+	musicRing = new unsigned char[musicRingSize? musicRingSize: 1];
+	musicRingRead = 0;
+	SDL_AtomicSet(&musicRingFill, 0);
+	SDL_AtomicSet(&musicQuit, 0);
+
+	if (musicChunk) musicThread = SDL_CreateThread(renderMusic, "Music", NULL);
+
+
+	// Load sounds
+
+	if (loadSounds("SOUNDS.000") != E_NONE) sounds = NULL;
+
+	// Start audio for sfx to work
+
+	SDL_PauseAudioDevice(audioDevice, 0);
+
+	return;
+
+}
+
+
+/**
+ * Stop audio.
+ */
+void closeAudio () {
+
+	ResampledSound* clip;
+	MusicCache* cache;
+	int count;
+
+	finishResampling();
+
+	stopMusic();
+
+	if (audioDevice) {
+
+		log("Audio callback average (us)", SDL_AtomicGet(&callbackAverage));
+		log("Audio callback peak (us)", SDL_AtomicGet(&callbackPeak));
+
+		SDL_CloseAudioDevice(audioDevice);
+		audioDevice = 0;
+
+	}
+
+	if (musicThread) {
+
+		SDL_AtomicSet(&musicQuit, 1);
+		SDL_WaitThread(musicThread, NULL);
+		musicThread = NULL;
+
+	}
+
+	// With the callback and music thread gone, finish off anything they had
+	// not got to
+	runAudioCommands(&soundQueue);
+	runAudioCommands(&musicQueue);
+
+	if (musicFile) {
+
+		ModPlug_Unload(musicFile);
+		musicFile = NULL;
+
+	}
+
+	if (prefetchedMusic) {
+
+		ModPlug_Unload(prefetchedMusic);
+		prefetchedMusic = NULL;
+
+	}
+
+	if (prefetchedName) {
+
+		delete[] prefetchedName;
+		prefetchedName = NULL;
+
+	}
+
+	SDL_DestroyMutex(prefetchLock);
+	prefetchLock = NULL;
+
+	musicCache = NULL;
+	musicRecording = NULL;
+
+	while (musicCaches) {
+
+		cache = musicCaches->next;
+		delete[] musicCaches->data;
+		delete[] musicCaches->name;
+		delete musicCaches;
+		musicCaches = cache;
+
+	}
+
+	delete[] musicRing;
+	musicRing = NULL;
+	musicRingSize = 0;
+
+	delete[] mixBuffer;
+	mixBuffer = NULL;
 
+	residency.remove(rawSoundsResident);
+	rawSoundsResident = -1;
 
-/**
- * Callback used to provide data to the audio subsystem.
- *
- * @param userdata N/A
- * @param stream Output stream
- * @param len Length of data to be placed in the output stream
- */
-void audioCallback (void * userdata, unsigned char * stream, int len) {
+	delete[] rawSoundsFile;
+	rawSoundsFile = NULL;
 
-	(void)userdata;
+	if (rawSounds) {
 
-	int count;
+		for (count = 0; count < nRawSounds; count++) {
 
-	if (!musicPaused) {
+			while (rawSounds[count].resampled) {
 
-		// Read the next portion of music into the audio stream
+				clip = rawSounds[count].resampled->next;
+				delete[] rawSounds[count].resampled->data;
+				delete rawSounds[count].resampled;
+				rawSounds[count].resampled = clip;
 
-		if (musicFile) ModPlug_Read(musicFile, stream, len);
+			}
 
-	}
+			delete[] rawSounds[count].data;
+			delete[] rawSounds[count].name;
 
-	if (!sounds) return;
+		}
 
-	for (count = 0; count < 32; count++) {
+		delete[] rawSounds;
 
-		if (sounds[count].data && (sounds[count].position >= 0)) {
+	}
 
-			// Add the next portion of the sound clip to the audio stream
+	if (sounds) {
 
-			if (len < sounds[count].length - sounds[count].position) {
+		freeSounds();
+		delete[] sounds;
 
-				// Play as much of the clip as possible
+	}
 
-				SDL_MixAudio(stream,
-					sounds[count].data + sounds[count].position, len,
-					soundVolume * SDL_MIX_MAXVOLUME / MAX_VOLUME);
+	return;
 
-				sounds[count].position += len;
+}
 
-			} else {
 
-				// Play the remainder of the clip
+/**
+ * Choose the audio buffer size and output rate. Must be called before audio
+ * is opened.
+ *
+ * @param samples Buffer size in sample frames, or 0 to leave it unchanged
+ * @param rate Preferred output rate, or 0 to leave it unchanged. The device's
+ * own rate is used if it differs.
+ */
+void setAudioFormat (int samples, int rate) {
 
-				SDL_MixAudio(stream,
-					sounds[count].data + sounds[count].position,
-					sounds[count].length - sounds[count].position,
-					soundVolume * SDL_MIX_MAXVOLUME / MAX_VOLUME);
+	if (samples > 0) audioSamples = samples;
+	if (rate > 0) audioRate = rate;
 
-				sounds[count].position = -1;
+	return;
 
-			}
+}
 
-		}
 
-	}
+/**
+ * Get how long the audio callback takes, compared to how long it may take.
+ *
+ * @param average Smoothed time taken, in microseconds
+ * @param peak Longest time taken, in microseconds
+ * @param budget The time one buffer lasts, in microseconds
+ */
+void getAudioTimes (int* average, int* peak, int* budget) {
+
+	*average = SDL_AtomicGet(&callbackAverage);
+	*peak = SDL_AtomicGet(&callbackPeak);
+	*budget = audioSpec.freq? (int)(((long long int)audioSpec.samples * 1000000) / audioSpec.freq): 0;
 
 	return;
 
@@ -123,69 +1449,88 @@ void audioCallback (void * userdata, unsigned char * stream, int len) {
 
 
 /**
- * Initialise audio.
+ * Load music from the specified file into libpsmplug.
+ *
+ * @param fileName Name of a file containing music data
+ *
+ * @return The loaded music, or NULL if it could not be loaded
  */
-void openAudio () {
+static ModPlugFile* loadMusic (const char* fileName) {
 
-	SDL_AudioSpec asDesired;
-	musicFile = NULL;
+	File *file;
+	unsigned char *psmData;
+	ModPlugFile *music;
+	int size;
 
-	// Set up SDL audio
+	try {
 
-	asDesired.freq = SOUND_FREQ;
-	asDesired.format = AUDIO_S16;
-	asDesired.channels = 2;
-	asDesired.samples = SOUND_SAMPLES;
-	asDesired.callback = audioCallback;
-	asDesired.userdata = NULL;
+		file = new File(fileName, false);
 
-	if (SDL_OpenAudio(&asDesired, &audioSpec) < 0)
-		logError("Unable to open audio", SDL_GetError());
+	} catch (int e) {
 
+		return NULL;
 
-	// Load sounds
+	}
 
-	if (loadSounds("SOUNDS.000") != E_NONE) sounds = NULL;
+	// Find the size of the file
+	size = file->getSize();
 
-	// Start audio for sfx to work
+	// Read the entire file into memory
+	file->seek(0, true);
+	psmData = file->loadBlock(size);
 
-	SDL_PauseAudio(0);
+	delete file;
 
-	return;
+	// Load the file into libmodplug
+	music = ModPlug_Load(psmData, size);
+
+	delete[] psmData;
+
+	if (!music) logError("Could not play music file", fileName);
+
+	return music;
 
 }
 
 
 /**
- * Stop audio.
+ * Load music ahead of it being played, such as the next level's while the
+ * level statistics are shown. Used by level preloaders, so may be called from
+ * the preloading thread. Music which is already playing is not loaded again.
+ *
+ * @param fileName Name of a file containing music data
  */
-void closeAudio () {
+void prefetchMusic (const char* fileName) {
 
-	int count;
+	ModPlugFile *music;
+	bool loaded;
 
-	stopMusic();
+	// A dedicated server has no audio
+	if (headless) return;
 
-	SDL_CloseAudio();
+	SDL_LockMutex(prefetchLock);
 
-	if (rawSounds) {
+	loaded = (currentMusic && !strcmp(fileName, currentMusic)) ||
+		(prefetchedName && !strcmp(fileName, prefetchedName));
 
-		for (count = 0; count < nRawSounds; count++) {
+	SDL_UnlockMutex(prefetchLock);
 
-			delete[] rawSounds[count].data;
-			delete[] rawSounds[count].name;
+	if (loaded) return;
 
-		}
+	music = loadMusic(fileName);
 
-		delete[] rawSounds;
+	if (!music) return;
 
-	}
+	SDL_LockMutex(prefetchLock);
 
-	if (sounds) {
+	// Only the most recently prefetched music is kept
+	if (prefetchedMusic) ModPlug_Unload(prefetchedMusic);
+	if (prefetchedName) delete[] prefetchedName;
 
-		freeSounds();
-		delete[] sounds;
+	prefetchedMusic = music;
+	prefetchedName = createString(fileName);
 
-	}
+	SDL_UnlockMutex(prefetchLock);
 
 	return;
 
@@ -200,11 +1545,14 @@ void closeAudio () {
  */
 void playMusic (const char * fileName, bool restart) {
 
-	File *file;
-	unsigned char *psmData;
-	int size;
-	bool loadOk = false;
-	ModPlug_Settings settings;
+	ModPlugFile *newMusic;
+	MusicCache *cache;
+	AudioCommand command;
+
+	MEMORY_SCOPE(MEM_SOUND);
+
+	// A dedicated server has no audio
+	if (headless) return;
 
 	/* Only stop any existing music playing, if a different file
 	   should be played or a restart has been requested. */
@@ -213,75 +1561,125 @@ void playMusic (const char * fileName, bool restart) {
 
 	stopMusic();
 
-	// Load the music file
+	// Find out whether the track has been, or is to be, recorded
 
-	try {
+	cache = musicCaches;
 
-		file = new File(fileName, false);
+	while (cache && strcmp(fileName, cache->name)) cache = cache->next;
 
-	} catch (int e) {
+	// Recording needs the music thread, and 16-bit stereo
+	if (!musicThread || (audioSpec.format != AUDIO_S16SYS) || (audioSpec.channels != 2))
+		cache = NULL;
+
+	if (cache && SDL_AtomicGet(&(cache->complete))) {
+
+		// Play the recording, without loading the file again
+
+		SDL_LockMutex(prefetchLock);
+
+		if (currentMusic) delete[] currentMusic;
+		currentMusic = createString(fileName);
+
+		SDL_UnlockMutex(prefetchLock);
+
+		command.type = AC_MUSIC;
+		command.music = NULL;
+		command.cache = cache;
+		sendAudioCommand(&musicQueue, &command);
+
+		command.type = AC_PAUSE_MUSIC;
+		command.value = false;
+		sendAudioCommand(&soundQueue, &command);
 
 		return;
 
 	}
 
+	// Use the music the level preloader fetched, if it is this file
+
+	newMusic = NULL;
+
+	SDL_LockMutex(prefetchLock);
+
+	if (prefetchedName && !strcmp(fileName, prefetchedName)) {
+
+		newMusic = prefetchedMusic;
+		prefetchedMusic = NULL;
+		delete[] prefetchedName;
+		prefetchedName = NULL;
+
+	}
+
+	SDL_UnlockMutex(prefetchLock);
+
+	if (!newMusic) newMusic = loadMusic(fileName);
+
+	if (!newMusic) return;
+
 	// Save current music filename
 
+	SDL_LockMutex(prefetchLock);
+
 	if (currentMusic) delete[] currentMusic;
 	currentMusic = createString(fileName);
 
-	// Find the size of the file
-	size = file->getSize();
+	SDL_UnlockMutex(prefetchLock);
 
-	// Read the entire file into memory
-	file->seek(0, true);
-	psmData = file->loadBlock(size);
+	if (cache) {
 
-	delete file;
+		// Record one pass through the track at half volume, leaving the
+		// music thread to apply the music volume
+		ModPlug_SetPlayOnce(newMusic, 1);
+		ModPlug_SetMasterVolume(newMusic, (MAX_VOLUME >> 1) * 2.56);
 
-	// Set up libpsmplug
+	} else {
 
-	settings.mFlags = MUSIC_FLAGS;
-	settings.mChannels = audioSpec.channels;
+		// Re-apply volume setting, before the audio callback can see the music
+		ModPlug_SetMasterVolume(newMusic, musicVolume * 2.56);
 
-	if ((audioSpec.format == AUDIO_U8) || (audioSpec.format == AUDIO_S8))
-		settings.mBits = 8;
-	else settings.mBits = 16;
+	}
 
-	settings.mFrequency = audioSpec.freq;
-	settings.mResamplingMode = MUSIC_RESAMPLEMODE;
-	settings.mReverbDepth = 25;
-	settings.mReverbDelay = 40;
-	settings.mBassAmount = 50;
-	settings.mBassRange = 10;
-	settings.mSurroundDepth = 50;
-	settings.mSurroundDelay = 40;
+	// Start the music playing
+	command.type = AC_MUSIC;
+	command.music = newMusic;
+	command.cache = cache;
+	sendAudioCommand(&musicQueue, &command);
 
-	// unlimited looping
-	settings.mLoopCount = -1;
+	command.type = AC_PAUSE_MUSIC;
+	command.value = false;
+	sendAudioCommand(&soundQueue, &command);
 
-	ModPlug_SetSettings(&settings);
+	return;
 
-	// Load the file into libmodplug
-	musicFile = ModPlug_Load(psmData, size);
-	loadOk = (musicFile != NULL);
+}
 
-	delete[] psmData;
 
-	if (!loadOk) {
+/**
+ * Mark a track to be recorded the first time it plays through, so that it
+ * loops from memory afterwards instead of being decoded again. Only suits
+ * tracks which loop back to their start, such as the menu music.
+ *
+ * @param fileName Name of a file containing music data
+ */
+void cacheMusic (const char* fileName) {
+
+	MusicCache* cache;
 
-		logError("Could not play music file", fileName);
+	for (cache = musicCaches; cache; cache = cache->next) {
 
-		return;
+		if (!strcmp(fileName, cache->name)) return;
 
 	}
 
-	// Re-apply volume setting
-	setMusicVolume(musicVolume);
+	cache = new MusicCache;
+	cache->next = musicCaches;
+	cache->name = createString(fileName);
+	cache->data = NULL;
+	cache->size = 0;
+	cache->frames = 0;
+	SDL_AtomicSet(&(cache->complete), 0);
 
-	// Start the audio playing
-	SDL_PauseAudio(0);
-	musicPaused = false;
+	musicCaches = cache;
 
 	return;
 
@@ -294,7 +1692,15 @@ void playMusic (const char * fileName, bool restart) {
  * @param pause set to true to pause
  */
 void pauseMusic (bool pause) {
-	musicPaused = pause;
+
+	AudioCommand command;
+
+	command.type = AC_PAUSE_MUSIC;
+	command.value = pause;
+	sendAudioCommand(&soundQueue, &command);
+
+	return;
+
 }
 
 
@@ -303,12 +1709,23 @@ void pauseMusic (bool pause) {
  */
 void stopMusic () {
 
+	AudioCommand command;
+
 	// Stop the music playing
 
-	SDL_PauseAudio(~0);
+	if (currentMusic) {
+
+		command.type = AC_MUSIC;
+		command.music = NULL;
+		command.cache = NULL;
+		sendAudioCommand(&musicQueue, &command);
+
+	}
 
 	// Cleanup
 
+	SDL_LockMutex(prefetchLock);
+
 	if (currentMusic) {
 
 		delete[] currentMusic;
@@ -316,14 +1733,7 @@ void stopMusic () {
 
 	}
 
-	if (musicFile) {
-
-		ModPlug_Unload(musicFile);
-		musicFile = NULL;
-
-	}
-
-	SDL_PauseAudio(0);
+	SDL_UnlockMutex(prefetchLock);
 
 	return;
 
@@ -349,13 +1759,17 @@ int getMusicVolume () {
  */
 void setMusicVolume (int volume) {
 
+	AudioCommand command;
+
 	musicVolume = volume;
 	if (volume < 1) musicVolume = 0;
 	if (volume > MAX_VOLUME) musicVolume = MAX_VOLUME;
 
-	// do not access music player settings when not playing
+	// The music thread applies it to whatever music is playing
 
-	if (musicFile) ModPlug_SetMasterVolume(musicFile, musicVolume * 2.56);
+	command.type = AC_MUSIC_VOLUME;
+	command.value = musicVolume;
+	sendAudioCommand(&musicQueue, &command);
 
 }
 
@@ -380,21 +1794,18 @@ int getMusicTempo () {
 void ModPlug_SetMusicTempoFactor(ModPlugFile* file, unsigned int ctemp);
 void setMusicTempo (int tempo) {
 
+	AudioCommand command;
+
 	if ((tempo != MUSIC_FAST) && (tempo != MUSIC_NORMAL))
 		musicTempo = MUSIC_NORMAL;
 	else
 		musicTempo = tempo;
 
-	// do not access music player settings when not playing
-
-	if (musicFile) {
-
-		if (musicTempo == MUSIC_FAST)
-			ModPlug_SetMusicTempoFactor(musicFile, 80);
-		else
-			ModPlug_SetMusicTempoFactor(musicFile, 128);
+	// The music thread applies it to whatever music is playing
 
-	}
+	command.type = AC_MUSIC_TEMPO;
+	command.value = (musicTempo == MUSIC_FAST)? 80: 128;
+	sendAudioCommand(&musicQueue, &command);
 
 }
 
@@ -409,6 +1820,8 @@ int loadSounds (const char *fileName) {
 	File *file;
 	int count, offset, headerOffset;
 
+	MEMORY_SCOPE(MEM_SOUND);
+
 	try {
 
 		file = new File(fileName, false);
@@ -424,6 +1837,10 @@ int loadSounds (const char *fileName) {
 	for (count = 0; count < 32; count++) {
 
 		sounds[count].data = NULL;
+		sounds[count].length = 0;
+		sounds[count].maxVoices = SOUND_INSTANCES;
+		sounds[count].priority = 0;
+		sounds[count].playing = 0;
 
 	}
 
@@ -454,12 +1871,21 @@ int loadSounds (const char *fileName) {
 		// Read the clip
 		file->seek(offset, true);
 		rawSounds[count].data = file->loadBlock(rawSounds[count].length);
+		rawSounds[count].resampled = NULL;
 
 	}
 
 	delete file;
 
-	resampleSounds();
+	// The raw clips are only needed again for resampling at new rates
+	rawSoundsFile = createString(fileName);
+	rawSoundsResident = residency.add("sound clips", releaseRawSounds, reloadRawSounds, NULL);
+
+	// Resample the clips in the background, rather than holding up start-up
+	// Without worker threads, they are resampled now
+	jobs.prepare(&resampleJob, resampleAll, NULL, NULL, true);
+	jobs.submit(&resampleJob);
+	resampling = true;
 
 	return E_NONE;
 
@@ -468,61 +1894,71 @@ int loadSounds (const char *fileName) {
 
 /**
  * Resample sound clip data.
+ *
+ * @param index The number of the sound to replace
+ * @param name The name of the clip to resample
+ * @param rate The clip's sample rate
  */
 void resampleSound (int index, const char* name, int rate) {
 
-	int count, rsFactor, sample;
+	finishResampling();
 
-    if (sounds[index].data) {
+	resample(index, name, rate);
 
-		delete[] sounds[index].data;
-		sounds[index].data = NULL;
+	return;
 
-	}
+}
 
-	// Search for matching sound
 
-	for (count = 0; count < nRawSounds; count++) {
+/**
+ * Resample all sound clip data.
+ */
+void resampleSounds () {
+
+	finishResampling();
 
-		if (!strcmp(name, rawSounds[count].name)) {
+	resampleAll(NULL);
+
+	return;
 
-			// Calculate the resampling factor
-			if ((audioSpec.format == AUDIO_U8) || (audioSpec.format == AUDIO_S8))
-				rsFactor = (F2 * audioSpec.freq) / rate;
-			else rsFactor = (F4 * audioSpec.freq) / rate;
+}
 
-			sounds[index].length = MUL(rawSounds[count].length, rsFactor);
 
-			// Allocate the buffer for the resampled clip
-			sounds[index].data = new unsigned char[sounds[index].length];
+/**
+ * Stop using resampled sound clip data. The data itself stays cached with the
+ * raw clips until audio is closed.
+ */
+void freeSounds () {
 
-			// Resample the clip
-			for (sample = 0; sample < sounds[index].length; sample++)
-				sounds[index].data[sample] = rawSounds[count].data[DIV(sample, rsFactor)];
+	int count;
 
-			sounds[index].position = -1;
+	finishResampling();
 
-			return;
+	if (sounds) {
 
-		}
+		SDL_LockAudioDevice(audioDevice);
+
+		stopVoices(-1);
+
+		for (count = 0; count < 32; count++) sounds[count].data = NULL;
+
+		SDL_UnlockAudioDevice(audioDevice);
 
 	}
 
+	return;
+
 }
 
 
 /**
- * Resample all sound clips to matching indices.
+ * Set the sound clip to be played.
+ *
+ * @param index Number of the sound to play plus one (0 to play no sound)
  */
-void resampleSounds () {
-
-	int count;
-
-	for (count = 0; (count < 32) && (count < nRawSounds); count++) {
-
-		resampleSound(count, rawSounds[count].name, 11025);
+void playSound (char index) {
 
-	}
+	playSound(index, MAX_VOLUME, 0);
 
 	return;
 
@@ -530,19 +1966,32 @@ void resampleSounds () {
 
 
 /**
- * Delete resampled sound clip data.
+ * Set the sound clip to be played, at a given volume and position.
+ *
+ * @param index Number of the sound to play plus one (0 to play no sound)
+ * @param gain Volume of the sound (0-100), on top of the sound effect volume
+ * @param pan Position of the sound, from -100 (left) to 100 (right)
  */
-void freeSounds () {
+void playSound (char index, int gain, int pan) {
 
-	int count;
+	AudioCommand command;
 
-	if (sounds) {
+	finishResampling();
 
-		for (count = 0; count < 32; count++) {
+	if (sounds && !soundsHeld && (index > 0) && (index <= 32)) {
 
-			if (sounds[count].data) delete[] sounds[count].data;
+		if (gain < 0) gain = 0;
+		else if (gain > MAX_VOLUME) gain = MAX_VOLUME;
 
-		}
+		if (pan < -MAX_VOLUME) pan = -MAX_VOLUME;
+		else if (pan > MAX_VOLUME) pan = MAX_VOLUME;
+
+		// Panning only ever turns down the far channel
+		command.type = AC_PLAY;
+		command.index = index - 1;
+		command.gainLeft = gain * (MAX_VOLUME - ((pan > 0)? pan: 0)) * MIX_UNITY / (MAX_VOLUME * MAX_VOLUME);
+		command.gainRight = gain * (MAX_VOLUME + ((pan < 0)? pan: 0)) * MIX_UNITY / (MAX_VOLUME * MAX_VOLUME);
+		sendAudioCommand(&soundQueue, &command);
 
 	}
 
@@ -552,13 +2001,14 @@ void freeSounds () {
 
 
 /**
- * Set the sound clip to be played.
+ * Ignore new sound effects, or stop ignoring them. Steps which are taken again
+ * have already been heard.
  *
- * @param index Number of the sound to play plus one (0 to play no sound)
+ * @param hold Whether or not to ignore new sound effects
  */
-void playSound (char index) {
+void holdSounds (bool hold) {
 
-	if (sounds && (index > 0) && (index <= 32)) sounds[index - 1].position = 0;
+	soundsHeld = hold;
 
 	return;
 
@@ -577,7 +2027,71 @@ bool isSoundPlaying (char index) {
 	if (!sounds || (index <= 0) || (index > 32))
 		return false;
 
-	return (sounds[index - 1].position > 0);
+	return (sounds[index - 1].playing > 0);
+
+}
+
+
+/**
+ * Play a sound clip made by something at the given position, quieter and
+ * panned the further it is from the listener. Sounds out of earshot are not
+ * played at all.
+ *
+ * @param index Number of the sound to play plus one (0 to play no sound)
+ * @param x The x-coordinate of the sound's source
+ * @param y The y-coordinate of the sound's source
+ */
+void playSoundAt (char index, fixed x, fixed y) {
+
+	int dx, dy, distance;
+
+	dx = x - listenerX;
+	dy = y - listenerY;
+
+	distance = (dx < 0)? -dx: dx;
+	if (distance < ((dy < 0)? -dy: dy)) distance = (dy < 0)? -dy: dy;
+
+	if (distance >= SOUND_RANGE) return;
+
+	playSound(index, MAX_VOLUME - ((distance * MAX_VOLUME) / SOUND_RANGE), (dx * MAX_VOLUME) / SOUND_RANGE);
+
+	return;
+
+}
+
+
+/**
+ * Set how many voices may play a sound clip at once, and how important it is
+ * when there are not enough voices to go round. Should be set while loading.
+ *
+ * @param index Number of the sound plus one
+ * @param maxVoices Most voices which may play the clip at once
+ * @param priority The clip's priority, higher being more important
+ */
+void setSoundLimit (char index, int maxVoices, int priority) {
+
+	if (!sounds || (index <= 0) || (index > 32)) return;
+
+	sounds[index - 1].maxVoices = (maxVoices < 1)? 1: maxVoices;
+	sounds[index - 1].priority = priority;
+
+	return;
+
+}
+
+
+/**
+ * Set where positioned sounds are heard from.
+ *
+ * @param x The listener's x-coordinate
+ * @param y The listener's y-coordinate
+ */
+void setSoundListener (fixed x, fixed y) {
+
+	listenerX = x;
+	listenerY = y;
+
+	return;
 
 }
 
@@ -601,8 +2115,14 @@ int getSoundVolume () {
  */
 void setSoundVolume (int volume) {
 
+	AudioCommand command;
+
 	soundVolume = volume;
 	if (volume < 1) soundVolume = 0;
 	if (volume > MAX_VOLUME) soundVolume = MAX_VOLUME;
 
+	command.type = AC_SOUND_VOLUME;
+	command.value = soundVolume;
+	sendAudioCommand(&soundQueue, &command);
+
 }
@@ -50,18 +50,33 @@
 #define S_BLOCK   21
 
 #define MAX_VOLUME   100
+#define SOUND_SAMPLES_LOW 256 /* Audio buffer size for the low-latency mode */
+#define MIX_UNITY    256 /* Voice gain at which sounds play at their recorded level */
+#define SOUND_RANGE  ITOF(480) /* Distance at which positioned sounds become inaudible */
 #define MUSIC_NORMAL   0
 #define MUSIC_FAST     1
 
 
 // Datatype
 
+/// Sound effect resampled to the output rate from one clip rate
+typedef struct ResampledSound {
+
+	struct ResampledSound *next; ///< The clip resampled from another rate
+	short int             *data; ///< 16-bit mono samples
+	int                    length; ///< Number of samples
+	int                    rate; ///< The rate the clip was resampled from
+
+} ResampledSound;
+
+
 /// Raw sound effect data
 typedef struct {
 
-	unsigned char *data;
-	char          *name;
-	int            length;
+	unsigned char  *data; ///< 8-bit signed mono samples
+	char           *name;
+	int             length;
+	ResampledSound *resampled; ///< The clip at each rate it has been used at
 
 } RawSound;
 
@@ -69,9 +84,11 @@ typedef struct {
 /// Resampled sound effect data
 typedef struct {
 
-	unsigned char *data;
-	int            length;
-	int            position;
+	short int     *data; ///< 16-bit mono samples, owned by a raw clip
+	int            length; ///< Number of samples
+	int            maxVoices; ///< Most voices which may play the clip at once
+	int            priority; ///< Voices playing lower priority clips are stolen first
+	int            playing; ///< Number of voices playing the clip, only written by the audio callback
 
 } Sound;
 
@@ -91,8 +108,13 @@ EXTERN int volume_direction;
 // Functions
 
 EXTERN void openAudio      ();
+EXTERN void audioCallback  (void* userdata, unsigned char* stream, int len);
 EXTERN void closeAudio     ();
+EXTERN void setAudioFormat (int samples, int rate);
+EXTERN void getAudioTimes  (int* average, int* peak, int* budget);
 EXTERN void playMusic      (const char *fileName, bool restart = false);
+EXTERN void cacheMusic     (const char *fileName);
+EXTERN void prefetchMusic  (const char *fileName);
 EXTERN void pauseMusic     (bool pause);
 EXTERN void stopMusic      ();
 EXTERN int  getMusicVolume ();
@@ -104,6 +126,11 @@ EXTERN void resampleSound  (int index, const char* name, int rate);
 EXTERN void resampleSounds ();
 EXTERN void freeSounds     ();
 EXTERN void playSound      (char index);
+EXTERN void playSound      (char index, int gain, int pan);
+EXTERN void playSoundAt    (char index, fixed x, fixed y);
+EXTERN void holdSounds     (bool hold);
+EXTERN void setSoundLimit  (char index, int maxVoices, int priority);
+EXTERN void setSoundListener (fixed x, fixed y);
 EXTERN bool isSoundPlaying (char index);
 EXTERN int  getSoundVolume ();
 EXTERN void setSoundVolume (int volume);
@@ -25,6 +25,7 @@
 #include "jj1bonuslevelplayer/jj1bonuslevelplayer.h"
 #include "jj1bonuslevel.h"
 
+#include "fixedmath.h"
 #include "game/game.h"
 #include "game/gamemode.h"
 #include "io/controls.h"
@@ -33,11 +34,74 @@
 #include "io/gfx/paletteeffects.h"
 #include "io/gfx/sprite.h"
 #include "io/gfx/video.h"
+#include "io/loadprofile.h"
 #include "io/sound.h"
+#include "level/replay.h"
+#include "memtrack.h"
+#include "profile.h"
 #include "util.h"
 
+#include <stdlib.h>
 #include <string.h>
 
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	#include <arm_neon.h>
+#endif
+
+
+/**
+ * Find the colour used most in a square of a tile. Colours are picked rather
+ * than blended, so that palette effects still apply to lower levels of
+ * detail.
+ *
+ * @param pixels The top-left pixel of the square
+ * @param size The width and height of the square
+ *
+ * @return The colour used most, or the lowest of those used most
+ */
+static unsigned char findCommonColour (unsigned char* pixels, int size) {
+
+	int uses[256];
+	int x, y, colour;
+
+	memset(uses, 0, sizeof(uses));
+
+	for (y = 0; y < size; y++) {
+
+		for (x = 0; x < size; x++) uses[pixels[(y << 5) + x]]++;
+
+	}
+
+	colour = 0;
+
+	for (x = 1; x < 256; x++) {
+
+		if (uses[x] > uses[colour]) colour = x;
+
+	}
+
+	return colour;
+
+}
+
+
+/**
+ * Find where a texel of a whole-ground level of detail is kept. The texture is
+ * stored in blocks 32 texels square, so that nearby texels share cache lines
+ * whichever way the ground is crossed.
+ *
+ * @param x The x-coordinate of the texel
+ * @param y The y-coordinate of the texel
+ * @param mip The level of detail
+ *
+ * @return The texel's index
+ */
+static int findGroundTexel (unsigned int x, unsigned int y, int mip) {
+
+	return ((((y >> 5) * ((BLW << 5) >> (mip + 5))) + (x >> 5)) << 10) + ((y & 31) << 5) + (x & 31);
+
+}
+
 
 /**
  * Load sprites.
@@ -52,6 +116,8 @@ int JJ1BonusLevel::loadSprites () {
 	int width, height;
 	int count;
 
+	MEMORY_SCOPE(MEM_SPRITES);
+
 	try {
 
 		file = new File("BONUS.000", false);
@@ -134,6 +200,8 @@ int JJ1BonusLevel::loadTiles (char *fileName) {
 	unsigned char *sorted;
 	int count, x, y;
 
+	MEMORY_SCOPE(MEM_TILES);
+
 	try {
 
 		file = new File(fileName, false);
@@ -151,6 +219,7 @@ int JJ1BonusLevel::loadTiles (char *fileName) {
 	for (count = 0; count < 20; count++) memcpy(sorted + (count * 512), pixels + (count * 832), 512);
 
 	background = createSurface(sorted, 512, 20);
+	sky = NULL;
 
 	delete[] sorted;
 	delete[] pixels;
@@ -161,6 +230,7 @@ int JJ1BonusLevel::loadTiles (char *fileName) {
 	// Load tile graphics
 	pixels = file->loadRLE(1024 * 60);
 	tileSet = createSurface(pixels, 32, 32 * 60);
+	createTileMips(pixels);
 
 	// Create mask
 	for (count = 0; count < 60; count++) {
@@ -189,6 +259,88 @@ int JJ1BonusLevel::loadTiles (char *fileName) {
 }
 
 
+/**
+ * Make the lower levels of detail of each tile, and room for those of the
+ * whole ground.
+ *
+ * @param pixels The tiles' pixels, 32 by 32 for each tile
+ */
+void JJ1BonusLevel::createTileMips (unsigned char* pixels) {
+
+	unsigned char* mipPixels;
+	int mip, size, count, x, y;
+
+	tileMips[0] = NULL;
+	groundMips[0] = NULL;
+
+	for (mip = 1; mip < GROUND_MIPS; mip++) {
+
+		size = 32 >> mip;
+		tileMips[mip] = new unsigned char[60 * size * size];
+
+		for (count = 0; count < 60; count++) {
+
+			mipPixels = tileMips[mip] + (count * size * size);
+
+			for (y = 0; y < size; y++) {
+
+				for (x = 0; x < size; x++) {
+
+					mipPixels[(y * size) + x] = findCommonColour(
+						pixels + (count << 10) + ((y << mip) << 5) + (x << mip), 1 << mip);
+
+				}
+
+			}
+
+		}
+
+		// Filled in as the grid is loaded
+		if (mip >= GROUND_FLAT) groundMips[mip] = new unsigned char[(BLW * size) * (BLH * size)];
+		else groundMips[mip] = NULL;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Copy a cell's tile into the whole-ground levels of detail. Must be done
+ * whenever a cell's tile changes.
+ *
+ * @param x The x-coordinate of the cell
+ * @param y The y-coordinate of the cell
+ */
+void JJ1BonusLevel::setGroundCell (int x, int y) {
+
+	unsigned char* mipPixels;
+	int mip, size, tX, tY;
+
+	for (mip = GROUND_FLAT; mip < GROUND_MIPS; mip++) {
+
+		size = 32 >> mip;
+		mipPixels = tileMips[mip] + (grid[y][x].tile * size * size);
+
+		for (tY = 0; tY < size; tY++) {
+
+			for (tX = 0; tX < size; tX++) {
+
+				groundMips[mip][findGroundTexel((x * size) + tX, (y * size) + tY, mip)] =
+					mipPixels[(tY * size) + tX];
+
+			}
+
+		}
+
+	}
+
+	return;
+
+}
+
+
 /**
  * Create a JJ1 bonus level.
  *
@@ -202,8 +354,11 @@ JJ1BonusLevel::JJ1BonusLevel (Game* owner, char * fileName, bool multi) : Level(
 	File *file;
 	unsigned char *buffer;
 	char *string, *fileString;
+	char name[FILE_NAME_LENGTH];
 	int count, x, y;
 
+	MEMORY_SCOPE(MEM_LEVEL);
+
 
 	try {
 
@@ -227,11 +382,15 @@ JJ1BonusLevel::JJ1BonusLevel (Game* owner, char * fileName, bool multi) : Level(
 
 	}
 
+	LOAD_BEGIN("JJ1BonusLevel::load");
+
 	// Load sprites
 	count = loadSprites();
 
 	if (count < 0) {
 
+		LOAD_END();
+
 		delete file;
 		delete font;
 
@@ -244,12 +403,17 @@ JJ1BonusLevel::JJ1BonusLevel (Game* owner, char * fileName, bool multi) : Level(
 
 	file->seek(90, true);
 	string = file->loadString();
-	fileString = createFileName(string, 0);
-	x = loadTiles(fileString);
+	if (writeFileName(name, FILE_NAME_LENGTH, string, 0)) x = loadTiles(name);
+	else x = E_FILE;
 	delete[] string;
-	delete[] fileString;
 
-	if (x != E_NONE) throw x;
+	if (x != E_NONE) {
+
+		LOAD_END();
+
+		throw x;
+
+	}
 
 
 	// Load music
@@ -304,6 +468,8 @@ JJ1BonusLevel::JJ1BonusLevel (Game* owner, char * fileName, bool multi) : Level(
 
 			if (grid[y][x].tile > 59) grid[y][x].tile = 59;
 
+			setGroundCell(x, y);
+
 		}
 
 	}
@@ -371,9 +537,12 @@ JJ1BonusLevel::JJ1BonusLevel (Game* owner, char * fileName, bool multi) : Level(
 	// Adjust panelBigFont to use bonus level palette
 	panelBigFont->mapPalette(0, 32, 15, -16);
 
+	LOAD_END();
 
-	multiplayer = multi;
+	LOAD_REPORT(fileName);
+	PROFILE_LEVEL(fileName);
 
+	multiplayer = multi;
 
 	return;
 
@@ -385,10 +554,21 @@ JJ1BonusLevel::JJ1BonusLevel (Game* owner, char * fileName, bool multi) : Level(
  */
 JJ1BonusLevel::~JJ1BonusLevel () {
 
+	int count;
+
 	// Restore panelBigFont palette
 	panelBigFont->restorePalette();
 
-	SDL_FreeSurface(tileSet);
+	freeSurface(tileSet);
+	freeSurface(background);
+	if (sky) freeSurface(sky);
+
+	for (count = 1; count < GROUND_MIPS; count++) {
+
+		delete[] tileMips[count];
+		delete[] groundMips[count];
+
+	}
 
 	delete[] spriteSet;
 
@@ -460,8 +640,12 @@ void JJ1BonusLevel::receive (unsigned char* buffer) {
 
 		case MT_L_GRID:
 
-			if (buffer[4] == 0) grid[buffer[3]][buffer[2]].tile = buffer[5];
-			else if (buffer[4] == 2)
+			if (buffer[4] == 0) {
+
+				grid[buffer[3]][buffer[2]].tile = (buffer[5] > 59)? 59: buffer[5];
+				setGroundCell(buffer[2], buffer[3]);
+
+			} else if (buffer[4] == 2)
 				grid[buffer[3]][buffer[2]].event = buffer[5];
 
 			break;
@@ -495,10 +679,6 @@ int JJ1BonusLevel::step () {
 	if (ticks > endTime) return LOST;
 
 
-	// Apply controls to local player
-	for (count = 0; count < PCONTROLS; count++)
-		localPlayer->setControl(count, controls.getState(count));
-
 	// Process players
 	for (count = 0; count < nPlayers; count++) {
 
@@ -563,18 +743,187 @@ int JJ1BonusLevel::step () {
 }
 
 
+/**
+ * Ground-drawing job. Draws bands of the ground until none are left.
+ *
+ * @param data The JJ1 bonus level
+ */
+void JJ1BonusLevel::groundJob (void* data) {
+
+	((JJ1BonusLevel *)data)->drawGroundBands();
+
+	return;
+
+}
+
+
+/**
+ * Draw one row of the ground.
+ *
+ * @param y The row, counting up from the bottom of the canvas
+ */
+void JJ1BonusLevel::drawGroundRow (int y) {
+
+	JJ1BonusLevelGridElement* cells;
+	unsigned char* row;
+	unsigned char* tiles;
+	fixed distance, sideX, sideY;
+	unsigned int levelX, levelY, stepX, stepY, tileX, tileY;
+	int x, mip, size, length;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	uint32x4_t vLevelX, vLevelY, vStepX, vStepY, vTileX, vTileY, vPitch, vWrap, vTile;
+	uint32_t start[4], cell[4], texel[4];
+	int count;
+#endif
+
+	distance = DIV(ITOF(800), ITOF(92) - (ITOF(y * 84) / ((canvasH >> 1) - 16)));
+	sideX = MUL(distance, groundCos);
+	sideY = MUL(distance, groundSin);
+
+	// Step across the row with 6 more bits of precision than fixed. Only the
+	// bottom 13 bits of the integer part are used (the level wraps every 256
+	// tiles), so overflow does no harm.
+	levelX = ((unsigned int)(groundX + MUL(distance - F16, groundSin) - (sideX >> 1))) << 6;
+	levelY = ((unsigned int)(groundY - MUL(distance - F16, groundCos) - (sideY >> 1))) << 6;
+	stepX = (unsigned int)((sideX * 64) / canvasW);
+	stepY = (unsigned int)((sideY * 64) / canvasW);
+
+	cells = &(grid[0][0]);
+	tiles = (unsigned char *)(tileSet->pixels);
+	row = ((unsigned char *)(canvas->pixels)) + (canvas->pitch * (canvasH - y));
+
+	// Towards the horizon, each pixel steps over several texels, so a smaller
+	// level of detail is read instead of skipping across the whole tile set
+	length = abs((int)stepX);
+	if (abs((int)stepY) > length) length = abs((int)stepY);
+
+	for (mip = 0; (mip < GROUND_MIPS - 1) && (length >= (0x20000 << mip)); mip++);
+
+	if (mip >= GROUND_FLAT) {
+
+		for (x = 0; x < canvasW; x++) {
+
+			row[x] = groundMips[mip][findGroundTexel((levelX >> (16 + mip)) & (8191 >> mip),
+				(levelY >> (16 + mip)) & (8191 >> mip), mip)];
+
+			levelX += stepX;
+			levelY += stepY;
+
+		}
+
+		return;
+
+	} else if (mip) {
+
+		size = 32 >> mip;
+		tiles = tileMips[mip];
+
+		for (x = 0; x < canvasW; x++) {
+
+			tileX = (levelX >> (16 + mip)) & (8191 >> mip);
+			tileY = (levelY >> (16 + mip)) & (8191 >> mip);
+
+			row[x] = tiles[(cells[((tileY >> (5 - mip)) << 8) + (tileX >> (5 - mip))].tile * size * size) +
+				((tileY & (size - 1)) * size) + (tileX & (size - 1))];
+
+			levelX += stepX;
+			levelY += stepY;
+
+		}
+
+		return;
+
+	}
+
+	x = 0;
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	// Find the cell and texel of four pixels at a time
+	for (count = 0; count < 4; count++) start[count] = levelX + (stepX * count);
+	vLevelX = vld1q_u32(start);
+	for (count = 0; count < 4; count++) start[count] = levelY + (stepY * count);
+	vLevelY = vld1q_u32(start);
+
+	vStepX = vdupq_n_u32(stepX << 2);
+	vStepY = vdupq_n_u32(stepY << 2);
+	vPitch = vdupq_n_u32(tileSet->pitch);
+	vWrap = vdupq_n_u32(8191);
+	vTile = vdupq_n_u32(31);
+
+	for (; x + 4 <= canvasW; x += 4) {
+
+		vTileX = vandq_u32(vshrq_n_u32(vLevelX, 16), vWrap);
+		vTileY = vandq_u32(vshrq_n_u32(vLevelY, 16), vWrap);
+
+		vst1q_u32(cell, vaddq_u32(vshlq_n_u32(vshrq_n_u32(vTileY, 5), 8), vshrq_n_u32(vTileX, 5)));
+		vst1q_u32(texel, vmlaq_u32(vandq_u32(vTileX, vTile), vandq_u32(vTileY, vTile), vPitch));
+
+		row[x] = tiles[(cells[cell[0]].tile << 10) + texel[0]];
+		row[x + 1] = tiles[(cells[cell[1]].tile << 10) + texel[1]];
+		row[x + 2] = tiles[(cells[cell[2]].tile << 10) + texel[2]];
+		row[x + 3] = tiles[(cells[cell[3]].tile << 10) + texel[3]];
+
+		vLevelX = vaddq_u32(vLevelX, vStepX);
+		vLevelY = vaddq_u32(vLevelY, vStepY);
+
+	}
+
+	levelX += stepX * x;
+	levelY += stepY * x;
+#endif
+
+	for (; x < canvasW; x++) {
+
+		tileX = (levelX >> 16) & 8191;
+		tileY = (levelY >> 16) & 8191;
+
+		row[x] = tiles[(cells[((tileY >> 5) << 8) + (tileX >> 5)].tile << 10) +
+			((tileY & 31) * tileSet->pitch) + (tileX & 31)];
+
+		levelX += stepX;
+		levelY += stepY;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Draw bands of the ground until none are left.
+ */
+void JJ1BonusLevel::drawGroundBands () {
+
+	int band, rows, first, last, y;
+
+	rows = (canvasH >> 1) - 15;
+
+	while ((band = SDL_AtomicAdd(&groundBand, 1)) < GROUND_BANDS) {
+
+		first = 1 + ((rows * band) / GROUND_BANDS);
+		last = 1 + ((rows * (band + 1)) / GROUND_BANDS);
+
+		for (y = first; y < last; y++) drawGroundRow(y);
+
+	}
+
+	return;
+
+}
+
+
 /**
  * Draw the level.
  */
 void JJ1BonusLevel::draw () {
 
 	JJ1BonusLevelPlayer *bonusPlayer;
-	unsigned char* row;
 	Sprite* sprite;
+	SDL_Surface* target;
 	SDL_Rect dst;
 	fixed playerX, playerY, playerSin, playerCos;
-	fixed distance, fwdX, fwdY, nX, sideX, sideY;
-	int levelX, levelY;
+	fixed nX;
 	int x, y;
 
 
@@ -588,11 +937,31 @@ void JJ1BonusLevel::draw () {
 
 	}
 
-	x = 171;
+	// The sky only needs rendering again when the canvas changes size
+	if (!sky || (sky->w != canvasW) || (sky->h != (canvasH >> 1) - 4)) {
+
+		if (sky) freeSurface(sky);
+
+		sky = createSurface(NULL, canvasW, (canvasH >> 1) - 4);
+
+		// Draw to the sky in place of the canvas
+		target = canvas;
+		canvas = sky;
+
+		x = 171;
+
+		for (y = (canvasH >> 1) - 5; (y >= 0) && (x > 128); y--) drawRect(0, y, canvasW, 1, x--);
+
+		if (y > 0) drawRect(0, 0, canvasW, y + 1, 128);
 
-	for (y = (canvasH >> 1) - 5; (y >= 0) && (x > 128); y--) drawRect(0, y, canvasW, 1, x--);
+		canvas = target;
 
-	if (y > 0) drawRect(0, 0, canvasW, y + 1, 128);
+	}
+
+	dst.x = 0;
+	dst.y = 0;
+	video.syncSurfacePalette(sky);
+	SDL_BlitSurface(sky, NULL, canvas, &dst);
 
 
 	bonusPlayer = localPlayer->getJJ1BonusLevelPlayer();
@@ -605,32 +974,29 @@ void JJ1BonusLevel::draw () {
 	playerSin = fSin(direction);
 	playerCos = fCos(direction);
 
-	if (SDL_MUSTLOCK(canvas)) SDL_LockSurface(canvas);
-
-	for (y = 1; y <= (canvasH >> 1) - 15; y++) {
+	groundX = playerX;
+	groundY = playerY;
+	groundSin = playerSin;
+	groundCos = playerCos;
 
-		distance = DIV(ITOF(800), ITOF(92) - (ITOF(y * 84) / ((canvasH >> 1) - 16)));
-		sideX = MUL(distance, playerCos);
-		sideY = MUL(distance, playerSin);
-		fwdX = playerX + MUL(distance - F16, playerSin) - (sideX >> 1);
-		fwdY = playerY - MUL(distance - F16, playerCos) - (sideY >> 1);
+	if (SDL_MUSTLOCK(canvas)) SDL_LockSurface(canvas);
 
-		row = ((unsigned char *)(canvas->pixels)) + (canvas->pitch * (canvasH - y));
+	// Split the ground into bands, and share them between the cores
+	SDL_AtomicSet(&groundBand, 0);
 
-		for (x = 0; x < canvasW; x++) {
+	jobs.prepare(&groundDone, NULL, NULL, NULL, false);
 
-			nX = ITOF(x) / canvasW;
+	for (x = 0; (x < MAX_GROUND_THREADS) && (x < jobs.getWorkers()); x++) {
 
-			levelX = FTOI(fwdX + MUL(nX, sideX));
-			levelY = FTOI(fwdY + MUL(nX, sideY));
+		jobs.prepare(groundJobs + x, groundJob, this, &groundDone, false);
+		jobs.submit(groundJobs + x);
 
-			row[x] = ((unsigned char *)(tileSet->pixels))
-				[(grid[ITOT(levelY) & 255][ITOT(levelX) & 255].tile << 10) +
-					((levelY & 31) * tileSet->pitch) + (levelX & 31)];
+	}
 
-		}
+	drawGroundBands();
 
-	}
+	jobs.submit(&groundDone);
+	jobs.wait(&groundDone);
 
 	if (SDL_MUSTLOCK(canvas)) SDL_UnlockSurface(canvas);
 
@@ -787,9 +1153,17 @@ int JJ1BonusLevel::play () {
 
 		// Process frame-by-frame activity
 
-		while ((getTimeChange() >= T_STEP) && (stage == LS_NORMAL)) {
+		while ((stage == LS_NORMAL) && takeStep()) {
+
+			// Apply controls to local player, recorded or played back
+			// A followed player is controlled by the server
+			ret = (game && game->isSpectating())? E_NONE: replay.control(localPlayer);
+
+			if (ret < 0) return ret;
 
+			PROFILE_BEGIN(PZ_STEP);
 			ret = step();
+			PROFILE_END(PZ_STEP);
 			steps++;
 
 			if (ret < 0) return ret;
@@ -808,7 +1182,9 @@ int JJ1BonusLevel::play () {
 
 		if ((ticks < returnTime) && !paused) direction += (ticks - prevTicks) * T_BONUS_END / (returnTime - ticks);
 
+		PROFILE_BEGIN(PZ_DRAW);
 		draw();
+		PROFILE_END(PZ_DRAW);
 
 
 		// If paused, draw "PAUSE"
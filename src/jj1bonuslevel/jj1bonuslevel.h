@@ -22,6 +22,7 @@
 #define _BONUS_H
 
 #include "io/gfx/anim.h"
+#include "jobs.h"
 #include "level/level.h"
 
 
@@ -32,6 +33,12 @@
 #define BLH    256 /* Bonus level height */
 #define BANIMS  32
 
+// Drawing the ground
+#define GROUND_BANDS        8 /* Number of bands the ground is divided into */
+#define MAX_GROUND_THREADS  3
+#define GROUND_MIPS         6 /* Levels of detail of the ground, each half the size of the last */
+#define GROUND_FLAT         3 /* The first level of detail kept as a texture of the whole ground */
+
 #define T_BONUS_END 2000
 
 
@@ -56,18 +63,34 @@ class JJ1BonusLevel : public Level {
 	private:
 		SDL_Surface*             tileSet; ///< Tile images
 		SDL_Surface*             background; ///< Background image
+		SDL_Surface*             sky; ///< Sky gradient above the background, rendered for the current canvas size
 		Font*                    font; ///< On-screen message font
 		Sprite*                  spriteSet; ///< Sprite images
 		Anim                     animSet[BANIMS]; ///< Animations
 		JJ1BonusLevelGridElement grid[BLH][BLW]; ///< Level grid
 		char                     mask[60][64]; ///< Tile masks (at most 60 tiles, all with 8 * 8 masks)
 		fixed                    direction; ///< Player's direction
-
-		int  loadSprites ();
-		int  loadTiles   (char* fileName);
-		bool isEvent     (fixed x, fixed y);
-		int  step        ();
-		void draw        ();
+		fixed                    groundX; ///< X-coordinate from which the ground is drawn
+		fixed                    groundY; ///< Y-coordinate from which the ground is drawn
+		fixed                    groundSin; ///< Sine of the direction in which the ground is drawn
+		fixed                    groundCos; ///< Cosine of the direction in which the ground is drawn
+		Job                      groundJobs[MAX_GROUND_THREADS]; ///< Jobs helping to draw the ground
+		Job                      groundDone; ///< Done once the whole ground has been drawn
+		SDL_atomic_t             groundBand; ///< The next band of the ground to be drawn
+		unsigned char*           tileMips[GROUND_MIPS]; ///< Each tile at each lower level of detail (the first is unused)
+		unsigned char*           groundMips[GROUND_MIPS]; ///< The whole ground at each level of detail from GROUND_FLAT, in blocks 32 texels square
+
+		static void groundJob   (void* data);
+
+		int  loadSprites     ();
+		int  loadTiles       (char* fileName);
+		void createTileMips  (unsigned char* pixels);
+		void setGroundCell   (int x, int y);
+		bool isEvent         (fixed x, fixed y);
+		int  step            ();
+		void drawGroundRow   (int y);
+		void drawGroundBands ();
+		void draw            ();
 
 	public:
 		JJ1BonusLevel  (Game* owner, char* fileName, bool multi);
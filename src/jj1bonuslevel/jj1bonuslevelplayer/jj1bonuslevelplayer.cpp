@@ -31,6 +31,7 @@
 #include "../jj1bonuslevel.h"
 #include "jj1bonuslevelplayer.h"
 
+#include "fixedmath.h"
 #include "game/game.h"
 #include "io/controls.h"
 #include "io/gfx/sprite.h"
@@ -28,6 +28,7 @@
 #include "jj1levelplayer/jj1levelplayer.h"
 
 #include "game/game.h"
+#include "io/file.h"
 #include "io/gfx/sprite.h"
 #include "io/gfx/video.h"
 #include "io/sound.h"
@@ -83,6 +84,37 @@ JJ1Bullet::JJ1Bullet (JJ1Bullet* nextBullet, JJ1LevelPlayer* sourcePlayer, fixed
 }
 
 
+Pool JJ1Bullet::pool("bul", sizeof(JJ1Bullet));
+
+
+/**
+ * Allocate memory for a bullet from the pool.
+ *
+ * @param size The size of the bullet
+ *
+ * @return Memory for the bullet
+ */
+void* JJ1Bullet::operator new (size_t size) {
+
+	return pool.take(size);
+
+}
+
+
+/**
+ * Give a bullet's memory back to the pool.
+ *
+ * @param bullet The bullet's memory
+ */
+void JJ1Bullet::operator delete (void* bullet) {
+
+	pool.give(bullet);
+
+	return;
+
+}
+
+
 /**
  * Delete all bullets.
  */
@@ -113,6 +145,18 @@ JJ1Bullet* JJ1Bullet::remove () {
 }
 
 
+/**
+ * Get the next bullet.
+ *
+ * @return The next bullet
+ */
+JJ1Bullet* JJ1Bullet::getNext () {
+
+	return next;
+
+}
+
+
 /**
  * Get the player responsible for this bullet.
  *
@@ -125,6 +169,44 @@ JJ1LevelPlayer* JJ1Bullet::getSource () {
 }
 
 
+/**
+ * Recursively write the bullets to a file, the last first, so that they are in
+ * the same order once read back. Each bullet's source, type and direction,
+ * from which it is created again, come first.
+ *
+ * @param file The file
+ */
+void JJ1Bullet::save (File* file) {
+
+	if (next) next->save(file);
+
+	file->storeChar(source? source->player - players: 255);
+	file->storeChar((set - level->bulletSet[0]) / BLENGTH);
+	file->storeChar(direction);
+	storePosition(file);
+	file->storeInt(time);
+
+	return;
+
+}
+
+
+/**
+ * Read the rest of the bullet from a file, having been created again from its
+ * source, type and direction.
+ *
+ * @param file The file
+ */
+void JJ1Bullet::load (File* file) {
+
+	loadPosition(file);
+	time = file->loadInt();
+
+	return;
+
+}
+
+
 /**
  * Bullet iteration.
  *
@@ -134,12 +216,16 @@ JJ1LevelPlayer* JJ1Bullet::getSource () {
  */
 JJ1Bullet* JJ1Bullet::step (unsigned int ticks) {
 
-	JJ1Event* event;
-	int count;
+	JJ1Event* events[EQUERY];
+	unsigned int shotStep;
+	int count, found;
+	bool lagged, touching;
 
 	// Process the next bullet
 	if (next) next = next->step(ticks);
 
+	savePosition();
+
 
 	if (level->getStage() != LS_END) {
 
@@ -147,11 +233,21 @@ JJ1Bullet* JJ1Bullet::step (unsigned int ticks) {
 		if (ticks > time) return remove();
 
 
+		// A server judges a remote player's shots against where the other
+		// players were when the shooter saw them
+		lagged = source && level->getShotStep(source->player, shotStep);
+
 		// Check if a player has been hit
 		for (count = 0; count < nPlayers; count++) {
 
-			if (players[count].getJJ1LevelPlayer()->overlap(x, y,
-				ITOF(sprite->getWidth()), ITOF(sprite->getHeight()))) {
+			if (lagged && (players[count].getJJ1LevelPlayer() != source))
+				touching = players[count].getJJ1LevelPlayer()->overlapPast(x, y,
+					ITOF(sprite->getWidth()), ITOF(sprite->getHeight()), shotStep);
+			else
+				touching = players[count].getJJ1LevelPlayer()->overlap(x, y,
+					ITOF(sprite->getWidth()), ITOF(sprite->getHeight()));
+
+			if (touching) {
 
 				// If the hit was successful, destroy the bullet
 				if (players[count].getJJ1LevelPlayer()->hit(source? source->player: NULL, ticks)) return remove();
@@ -165,20 +261,13 @@ JJ1Bullet* JJ1Bullet::step (unsigned int ticks) {
 
 			// Check if an event has been hit
 
-			event = level->getEvents();
-
-			while (event) {
-
-				// Check if the event has been hit
-				if (event->overlap(x, y,
-					ITOF(sprite->getWidth()), ITOF(sprite->getHeight()))) {
+			found = level->findEvents(x, y,
+				ITOF(sprite->getWidth()), ITOF(sprite->getHeight()), events);
 
-					// If the event is hittable, hit it and destroy the bullet
-					if (event->hit(source, 1, ticks)) return remove();
+			for (count = 0; count < found; count++) {
 
-				}
-
-				event = event->getNext();
+				// If the event is hittable, hit it and destroy the bullet
+				if (events[count]->hit(source, 1, ticks)) return remove();
 
 			}
 
@@ -191,7 +280,7 @@ JJ1Bullet* JJ1Bullet::step (unsigned int ticks) {
 	// If the scenery has been hit and this is not a bouncer, destroy the bullet
 	if (level->checkMaskUp(x, y) && (set[B_BEHAVIOUR] != 4)) {
 
-		playSound(set[B_FINISHSOUND]);
+		playSoundAt(set[B_FINISHSOUND], x, y);
 
 		return remove();
 
@@ -252,14 +341,20 @@ JJ1Bullet* JJ1Bullet::step (unsigned int ticks) {
 /**
  * Draw the bullet.
  *
- * @param change Time since last iteration
+ * @param alpha How far drawing is between the last step and the next, out of F1
  */
-void JJ1Bullet::draw (int change) {
+void JJ1Bullet::draw (fixed alpha) {
+
+	fixed drawX, drawY;
+
+	if (next) next->draw(alpha);
 
-	if (next) next->draw(change);
+	drawX = getDrawX(alpha);
+	drawY = getDrawY(alpha);
 
-	// Show the bullet
-	sprite->draw(FTOI(getDrawX(change)), FTOI(getDrawY(change)), false);
+	// Show the bullet, if it is in view
+	if (isInView(drawX, drawY, ITOF(sprite->getWidth()), ITOF(sprite->getHeight())))
+		sprite->draw(FTOI(drawX), FTOI(drawY), false);
 
 	return;
 
@@ -26,6 +26,7 @@
 
 
 #include "level/movable.h"
+#include "level/pool.h"
 
 #include "OpenJazz.h"
 
@@ -47,9 +48,14 @@
 #define T_BULLET 1000
 #define T_TNT    300
 
+// Pooled bullets
+#define PLAYER_BULLETS 32 /* Per player */
+#define EVENT_BULLETS  64 /* For all events */
+
 
 // Classes
 
+class File;
 class JJ1Bird;
 class JJ1Event;
 class JJ1LevelPlayer;
@@ -69,12 +75,20 @@ class JJ1Bullet : public Movable {
 		JJ1Bullet* remove ();
 
 	public:
+		static Pool pool; ///< Memory for bullets
+
+		static void* operator new    (size_t size);
+		static void  operator delete (void* bullet);
+
 		JJ1Bullet  (JJ1Bullet* nextBullet, JJ1LevelPlayer* sourcePlayer, fixed startX, fixed startY, signed char *bullet, int newDirection, unsigned int ticks);
 		~JJ1Bullet ();
 
+		JJ1Bullet*      getNext   ();
 		JJ1LevelPlayer* getSource ();
+		void            save      (File* file);
+		void            load      (File* file);
 		JJ1Bullet*      step      (unsigned int ticks);
-		void            draw      (int change);
+		void            draw      (fixed alpha);
 
 };
 
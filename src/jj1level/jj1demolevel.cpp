@@ -35,8 +35,10 @@
 #include "io/file.h"
 #include "io/gfx/font.h"
 #include "io/gfx/video.h"
+#include "io/loadprofile.h"
 #include "io/sound.h"
 #include "loop.h"
+#include "profile.h"
 #include "util.h"
 
 
@@ -86,12 +88,24 @@ JJ1DemoLevel::JJ1DemoLevel (Game* owner, const char* fileName) : JJ1Level(owner)
 
 	// Load level data
 
+	LOAD_BEGIN("JJ1Level::load");
 	ret = load(levelFile, false);
+	LOAD_END();
+
+	if (ret >= 0) {
+
+		LOAD_REPORT(levelFile);
+		PROFILE_LEVEL(levelFile);
+
+	}
 
 	delete[] levelFile;
 
 	if (ret < 0) throw ret;
 
+	// Kept so that the demo can be played again without being loaded again
+	keepState();
+
 	return;
 
 }
@@ -109,6 +123,37 @@ JJ1DemoLevel::~JJ1DemoLevel () {
 }
 
 
+/**
+ * Put the demo back to its state when it was loaded, so that it can be played
+ * again.
+ *
+ * @return Whether or not the state was put back
+ */
+bool JJ1DemoLevel::restart () {
+
+	return returnToState();
+
+}
+
+
+/**
+ * Stop the demo's music and give the whole canvas back to the menus, as
+ * deleting the level would, while keeping it to be played again.
+ */
+void JJ1DemoLevel::suspend () {
+
+	stopMusic();
+	ownsMusic = false;
+
+#ifdef SDL2
+	video.fullResolution();
+#endif
+
+	return;
+
+}
+
+
 /**
  * Play the demo.
  *
@@ -127,6 +172,7 @@ int JJ1DemoLevel::play () {
 	video.setPalette(palette);
 
 	playMusic(musicFile);
+	ownsMusic = true;
 
 	while (true) {
 
@@ -140,6 +186,8 @@ int JJ1DemoLevel::play () {
 
 		timeCalcs();
 
+		// Positioned sounds are heard from the local player
+		setSoundListener(localPlayer->getJJ1LevelPlayer()->getX(), localPlayer->getJJ1LevelPlayer()->getY());
 
 
 		// Use macro
@@ -177,7 +225,7 @@ int JJ1DemoLevel::play () {
 		// Process frame-by-frame activity
 
 		// Process step
-		while (getTimeChange() >= T_STEP) {
+		while (takeStep()) {
 
 			ret = step();
 			steps++;
@@ -30,6 +30,8 @@
 #include "../jj1levelplayer/jj1levelplayer.h"
 #include "jj1event.h"
 
+#include "io/file.h"
+
 
 /**
  * Create bridge.
@@ -56,6 +58,39 @@ JJ1Bridge::JJ1Bridge (unsigned char gX, unsigned char gY) : JJ1Event(gX, gY) {
 }
 
 
+/**
+ * Write the bridge to a file.
+ *
+ * @param file The file
+ */
+void JJ1Bridge::store (File* file) {
+
+	file->storeChar(JJ1EK_BRIDGE);
+	JJ1Event::store(file);
+	file->storeInt(leftDipX);
+	file->storeInt(rightDipX);
+
+	return;
+
+}
+
+
+/**
+ * Read the rest of the bridge from a file.
+ *
+ * @param file The file
+ */
+void JJ1Bridge::load (File* file) {
+
+	JJ1Event::load(file);
+	leftDipX = file->loadInt();
+	rightDipX = file->loadInt();
+
+	return;
+
+}
+
+
 /**
  * Bridge iteration.
  *
@@ -119,16 +154,16 @@ JJ1Event* JJ1Bridge::step (unsigned int ticks) {
  * Draw bridge.
  *
  * @param ticks Time
- * @param change Time since last iteration
+ * @param alpha How far drawing is between the last step and the next, out of F1
  */
-void JJ1Bridge::draw (unsigned int ticks, int change) {
+void JJ1Bridge::draw (unsigned int ticks, fixed alpha) {
 
 	unsigned char frame;
 	int count;
 	fixed bridgeLength, anchorY, leftDipY, rightDipY;
 
 
-	if (next) next->draw(ticks, change);
+	if (next) next->draw(ticks, alpha);
 
 
 	// If the event has been removed from the grid, do not show it
@@ -147,7 +182,10 @@ void JJ1Bridge::draw (unsigned int ticks, int change) {
 	// Draw the bridge
 
 	bridgeLength = set->multiA * set->pieceSize * F4;
-	anchorY = getDrawY(change) - F10 - anim->getOffset();
+	anchorY = getDrawY(alpha) - F10 - anim->getOffset();
+
+	// The bridge sags by at most a sixteenth of its length
+	if (!isInView(getDrawX(alpha), anchorY, bridgeLength, F32 + (bridgeLength >> 4))) return;
 
 	if (rightDipX >= leftDipX) {
 
@@ -157,11 +195,11 @@ void JJ1Bridge::draw (unsigned int ticks, int change) {
 		for (count = 0; count < bridgeLength; count += F4 * set->pieceSize) {
 
 			if (count < leftDipX)
-				anim->draw(getDrawX(change) + count, anchorY + (count * leftDipY / leftDipX));
+				anim->draw(getDrawX(alpha) + count, anchorY + (count * leftDipY / leftDipX));
 			else if (count < rightDipX)
-				anim->draw(getDrawX(change) + count, anchorY + leftDipY + ((count - leftDipX) * (rightDipY - leftDipY) / (rightDipX - leftDipX)));
+				anim->draw(getDrawX(alpha) + count, anchorY + leftDipY + ((count - leftDipX) * (rightDipY - leftDipY) / (rightDipX - leftDipX)));
 			else
-				anim->draw(getDrawX(change) + count, anchorY + ((bridgeLength - count) * rightDipY / (bridgeLength - rightDipX)));
+				anim->draw(getDrawX(alpha) + count, anchorY + ((bridgeLength - count) * rightDipY / (bridgeLength - rightDipX)));
 
 		}
 
@@ -178,9 +216,9 @@ void JJ1Bridge::draw (unsigned int ticks, int change) {
 		for (count = 0; count < bridgeLength; count += F4 * set->pieceSize) {
 
 			if (count < leftDipY)
-				anim->draw(getDrawX(change) + count, anchorY + (count * rightDipY / leftDipY));
+				anim->draw(getDrawX(alpha) + count, anchorY + (count * rightDipY / leftDipY));
 			else
-				anim->draw(getDrawX(change) + count, anchorY + ((bridgeLength - count) * rightDipY / (bridgeLength - leftDipY)));
+				anim->draw(getDrawX(alpha) + count, anchorY + ((bridgeLength - count) * rightDipY / (bridgeLength - leftDipY)));
 
 		}
 
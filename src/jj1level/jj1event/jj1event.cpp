@@ -37,10 +37,45 @@
 #include "jj1event.h"
 
 #include "io/gfx/video.h"
+#include "io/file.h"
 #include "io/sound.h"
 #include "util.h"
 
 
+// Slots fit standard events and bridges, the events which come and go as the
+// view moves
+Pool JJ1Event::pool("evt", (sizeof(JJ1StandardEvent) > sizeof(JJ1Bridge))?
+	sizeof(JJ1StandardEvent): sizeof(JJ1Bridge));
+
+
+/**
+ * Allocate memory for an event from the pool.
+ *
+ * @param size The size of the event
+ *
+ * @return Memory for the event
+ */
+void* JJ1Event::operator new (size_t size) {
+
+	return pool.take(size);
+
+}
+
+
+/**
+ * Give an event's memory back to the pool.
+ *
+ * @param event The event's memory
+ */
+void JJ1Event::operator delete (void* event) {
+
+	pool.give(event);
+
+	return;
+
+}
+
+
 /**
  * Create event
  *
@@ -70,6 +105,9 @@ JJ1Event::JJ1Event (unsigned char gX, unsigned char gY) {
 	width = F32;
 	height = F32;
 
+	cell = NULL;
+	placeInCell();
+
 	return;
 
 }
@@ -100,6 +138,8 @@ JJ1Event* JJ1Event::remove (bool permanently) {
 
 	if (permanently) level->clearEvent(gridX, gridY);
 
+	leaveCell();
+
 	oldNext = next;
 	next = NULL;
 	delete this;
@@ -121,6 +161,129 @@ JJ1Event * JJ1Event::getNext () {
 }
 
 
+/**
+ * Get the next event in the same collision cell
+ *
+ * @return The next event in the cell
+ */
+JJ1Event * JJ1Event::getCellNext () {
+
+	return cellNext;
+
+}
+
+
+/**
+ * Recursively write the events to a file, the last first, so that they are in
+ * the same order once read back.
+ *
+ * @param file The file
+ */
+void JJ1Event::save (File* file) {
+
+	if (next) next->save(file);
+
+	store(file);
+
+	return;
+
+}
+
+
+/**
+ * Write the event to a file. Kinds of event first write their kind, which
+ * with the grid position and type is all that is needed to create the event
+ * again.
+ *
+ * @param file The file
+ */
+void JJ1Event::store (File* file) {
+
+	file->storeChar(gridX);
+	file->storeChar(gridY);
+	file->storeChar(set - level->eventSet);
+	storePosition(file);
+	file->storeInt(drawnX);
+	file->storeInt(drawnY);
+	file->storeChar(animType);
+	file->storeInt(flashTime);
+
+	return;
+
+}
+
+
+/**
+ * Read the rest of the event from a file, having been created again from its
+ * kind, grid position and type.
+ *
+ * @param file The file
+ */
+void JJ1Event::load (File* file) {
+
+	unsigned char type;
+
+	loadPosition(file);
+	drawnX = file->loadInt();
+	drawnY = file->loadInt();
+	type = file->loadChar();
+	flashTime = file->loadInt();
+
+	if (type > E_NOANIM) type = E_NOANIM;
+
+	// Find the animation and dimensions afresh
+	animType = (type == E_NOANIM)? E_LEFTANIM: E_NOANIM;
+	setAnimType(type);
+
+	return;
+
+}
+
+
+/**
+ * Move the event into the collision cell holding its drawing co-ordinates.
+ * Must be called whenever those co-ordinates change.
+ */
+void JJ1Event::placeInCell () {
+
+	JJ1Event** newCell;
+
+	newCell = level->getEventCell(drawnX, drawnY, width, height);
+
+	if (newCell == cell) return;
+
+	leaveCell();
+
+	cellNext = *newCell;
+	*newCell = this;
+	cell = newCell;
+
+	return;
+
+}
+
+
+/**
+ * Take the event out of its collision cell
+ */
+void JJ1Event::leaveCell () {
+
+	JJ1Event** link;
+
+	if (!cell) return;
+
+	link = cell;
+
+	while (*link != this) link = &((*link)->cellNext);
+
+	*link = cellNext;
+	cell = NULL;
+
+	return;
+
+}
+
+
 /**
  * Initiate the destruction of the event
  *
@@ -132,7 +295,7 @@ void JJ1Event::destroy (unsigned int ticks) {
 
 	level->setEventTime(gridX, gridY, ticks);
 
-	playSound(set->sound);
+	playSoundAt(set->sound, x, y);
 
 	return;
 
@@ -221,6 +384,9 @@ void JJ1Event::calcDimensions () {
 
 	}
 
+	// Larger events reach further into neighbouring cells
+	placeInCell();
+
 	return;
 
 }
@@ -299,6 +465,8 @@ JJ1EventType* JJ1Event::prepareStep (unsigned int ticks) {
 	// Process the next event
 	if (next) next = next->step(ticks);
 
+	savePosition();
+
 	// If the event has been removed from the grid, destroy it
 	if (!set) return NULL;
 
@@ -345,11 +513,8 @@ void JJ1Event::drawEnergy (unsigned int ticks) {
 		miscAnim = level->getMiscAnim(MA_DEVHEAD);
 		miscAnim->setFrame(0, true);
 
-		if (ticks < flashTime) miscAnim->flashPalette(0);
-
-		miscAnim->draw(ITOF(canvasW - 44), ITOF(hits + 48));
-
-		if (ticks < flashTime) miscAnim->restorePalette();
+		if (ticks < flashTime) miscAnim->drawFlashed(ITOF(canvasW - 44), ITOF(hits + 48), 0);
+		else miscAnim->draw(ITOF(canvasW - 44), ITOF(hits + 48));
 
 
 		// Bar
@@ -32,6 +32,7 @@
 
 #include "io/gfx/anim.h"
 #include "level/movable.h"
+#include "level/pool.h"
 #include "OpenJazz.h"
 
 
@@ -49,21 +50,42 @@
 // Delays
 #define T_FLASH  100
 
+// Most pooled events
+#define EVENT_POOL 256
+
 // Speed factors
 #define ES_SLOW ITOF(80)
 #define ES_FAST ITOF(240)
 
 
+// Enum
+
+/// Kinds of JJ1 level event, as written to saved level states
+enum JJ1EventKind {
+
+	JJ1EK_STANDARD, ///< Standard event
+	JJ1EK_BRIDGE, ///< Bridge
+	JJ1EK_DECKGUARDIAN, ///< Episode B guardian
+	JJ1EK_MEDGUARDIAN ///< Episode 1 guardian
+
+};
+
+
 // Classes
 
 class Anim;
+class File;
 class JJ1LevelPlayer;
 
 /// JJ1 level event
 class JJ1Event : public Movable {
 
 	private:
+		JJ1Event** cell; ///< Collision cell holding the event, or NULL
+		JJ1Event*  cellNext; ///< Next event in the same collision cell
+
 		void calcDimensions ();
+		void leaveCell      ();
 
 	protected:
 		JJ1Event*     next; ///< Next event
@@ -83,20 +105,31 @@ class JJ1Event : public Movable {
 
 		void setAnimType  (unsigned char type);
 		void setAnimFrame (int frame, bool looping);
+		void placeInCell  ();
 
 		JJ1EventType* prepareStep (unsigned int ticks);
 
+		virtual void store (File* file);
+
 	public:
+		static Pool pool; ///< Memory for events
+
+		static void* operator new    (size_t size);
+		static void  operator delete (void* event);
+
 		virtual ~JJ1Event ();
 
 		JJ1Event*      getNext        ();
+		JJ1Event*      getCellNext    ();
 		bool           hit            (JJ1LevelPlayer *source, int hits, unsigned int ticks);
 		bool           isEnemy        ();
 		bool           isFrom         (unsigned char gX, unsigned char gY);
 		bool           overlap        (fixed areaX, fixed areaY, fixed areaWidth, fixed areaHeight);
+		void           save           (File* file);
 
+		virtual void      load        (File* file);
 		virtual JJ1Event* step        (unsigned int ticks) = 0;
-		virtual void      draw        (unsigned int ticks, int change) = 0;
+		virtual void      draw        (unsigned int ticks, fixed alpha) = 0;
 		void              drawEnergy  (unsigned int ticks);
 
 };
@@ -105,17 +138,45 @@ class JJ1Event : public Movable {
 class JJ1StandardEvent : public JJ1Event {
 
 	private:
-		fixed node; ///< Current event path node
-		bool  onlyLAnimOffset;
-		bool  onlyRAnimOffset;
+		int           node; ///< Current step along the event path
+		bool          onlyLAnimOffset;
+		bool          onlyRAnimOffset;
+		bool          (JJ1StandardEvent::*movement) (unsigned int ticks); ///< Moves the event the way its type does
+		JJ1EventPath* path; ///< Path followed, for movement types 6 and 7
+		int           radius; ///< Distance from the origin, for movement types 29 and 30
+		fixed         baseAngle; ///< Angle at time 0, for movement types 29 and 30
+		fixed         acrossSpeed; ///< Horizontal speed, for movement type 16
+
+		bool moveStill          (unsigned int ticks);
+		bool moveSink           (unsigned int ticks);
+		bool moveWalk           (unsigned int ticks);
+		bool moveSeek           (unsigned int ticks);
+		bool moveWalkDown       (unsigned int ticks);
+		bool moveFollowPath     (unsigned int ticks);
+		bool moveSinkToGround   (unsigned int ticks);
+		bool moveBackAndForth   (unsigned int ticks);
+		bool moveUpAndDown      (unsigned int ticks);
+		bool moveAcross         (unsigned int ticks);
+		bool moveBlock          (unsigned int ticks);
+		bool moveRotate         (unsigned int ticks);
+		bool moveSwing          (unsigned int ticks);
+		bool moveHorizontally   (unsigned int ticks);
+		bool moveFollow         (unsigned int ticks);
+		bool moveLaunch         (unsigned int ticks);
+		bool moveFollowOnGround (unsigned int ticks);
+		bool moveWalkOnScreen   (unsigned int ticks);
+		bool moveSwim           (unsigned int ticks);
+		void move               (unsigned int ticks);
 
-		void move (unsigned int ticks);
+	protected:
+		void store (File* file);
 
 	public:
 		JJ1StandardEvent (JJ1EventType* event, unsigned char gX, unsigned char gY, fixed startX, fixed startY);
 
+		void      load (File* file);
 		JJ1Event* step (unsigned int ticks);
-		void   draw (unsigned int ticks, int change);
+		void   draw (unsigned int ticks, fixed alpha);
 
 };
 
@@ -126,11 +187,15 @@ class JJ1Bridge : public JJ1Event {
 		fixed leftDipX;
 		fixed rightDipX;
 
+	protected:
+		void store (File* file);
+
 	public:
 		JJ1Bridge (unsigned char gX, unsigned char gY);
 
+		void      load (File* file);
 		JJ1Event* step (unsigned int ticks);
-		void   draw (unsigned int ticks, int change);
+		void   draw (unsigned int ticks, fixed alpha);
 
 };
 
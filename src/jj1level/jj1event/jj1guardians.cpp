@@ -30,6 +30,8 @@
 #include "../jj1level.h"
 #include "jj1guardians.h"
 
+#include "fixedmath.h"
+#include "io/file.h"
 #include "io/gfx/video.h"
 #include "util.h"
 
@@ -53,6 +55,36 @@ Guardian::Guardian(unsigned char gX, unsigned char gY) : JJ1Event(gX, gY) {
 }
 
 
+/**
+ * Write the guardian to a file, after its kind.
+ *
+ * @param file The file
+ */
+void Guardian::store (File* file) {
+
+	JJ1Event::store(file);
+	file->storeChar(stage);
+
+	return;
+
+}
+
+
+/**
+ * Read the rest of the guardian from a file.
+ *
+ * @param file The file
+ */
+void Guardian::load (File* file) {
+
+	JJ1Event::load(file);
+	stage = file->loadChar();
+
+	return;
+
+}
+
+
 /**
  * Create episode B guardian.
  *
@@ -66,6 +98,21 @@ DeckGuardian::DeckGuardian (unsigned char gX, unsigned char gY) : Guardian(gX, g
 }
 
 
+/**
+ * Write the episode B guardian to a file.
+ *
+ * @param file The file
+ */
+void DeckGuardian::store (File* file) {
+
+	file->storeChar(JJ1EK_DECKGUARDIAN);
+	Guardian::store(file);
+
+	return;
+
+}
+
+
 /**
  * Episode B guardian iteration.
  *
@@ -124,14 +171,15 @@ JJ1Event* DeckGuardian::step (unsigned int ticks) {
  * Draw episode B guardian.
  *
  * @param ticks Time
- * @param change Time since last iteration
+ * @param alpha How far drawing is between the last step and the next, out of F1
  */
-void DeckGuardian::draw (unsigned int ticks, int change) {
+void DeckGuardian::draw (unsigned int ticks, fixed alpha) {
 
 	Anim* unitAnim;
+	fixed unitX;
 
 
-	if (next) next->draw(ticks, change);
+	if (next) next->draw(ticks, alpha);
 
 
 	// If the event has been removed from the grid, do not show it
@@ -165,14 +213,14 @@ void DeckGuardian::draw (unsigned int ticks, int change) {
 
 		drawnY = y + F32;
 		height = F32;
+		placeInCell();
 
-		if (ticks < flashTime) unitAnim->flashPalette(0);
-
-		if (stage == 0) unitAnim->draw(getDrawX(change) - F64, getDrawY(change) + F32);
-		else if (stage == 1) unitAnim->draw(getDrawX(change) + F32 - F8 - F4, getDrawY(change) + F32);
-		else unitAnim->draw(getDrawX(change) + F8 - F64, getDrawY(change) + F32);
+		if (stage == 0) unitX = getDrawX(alpha) - F64;
+		else if (stage == 1) unitX = getDrawX(alpha) + F32 - F8 - F4;
+		else unitX = getDrawX(alpha) + F8 - F64;
 
-		if (ticks < flashTime) unitAnim->restorePalette();
+		if (ticks < flashTime) unitAnim->drawFlashed(unitX, getDrawY(alpha) + F32, 0);
+		else unitAnim->draw(unitX, getDrawY(alpha) + F32);
 
 	}
 
@@ -198,6 +246,39 @@ MedGuardian::MedGuardian(unsigned char gX, unsigned char gY) : Guardian(gX, gY)
 }
 
 
+/**
+ * Write the episode 1 guardian to a file.
+ *
+ * @param file The file
+ */
+void MedGuardian::store (File* file) {
+
+	file->storeChar(JJ1EK_MEDGUARDIAN);
+	Guardian::store(file);
+	file->storeChar(direction);
+	file->storeChar(shoot);
+
+	return;
+
+}
+
+
+/**
+ * Read the rest of the episode 1 guardian from a file.
+ *
+ * @param file The file
+ */
+void MedGuardian::load (File* file) {
+
+	Guardian::load(file);
+	direction = file->loadChar();
+	shoot = file->loadChar();
+
+	return;
+
+}
+
+
 /**
  * Episode 1 guardian iteration.
  *
@@ -415,17 +496,17 @@ JJ1Event* MedGuardian::step(unsigned int ticks) {
  * Draw episode 1 guardian.
  *
  * @param ticks Time
- * @param change Time since last iteration
+ * @param alpha How far drawing is between the last step and the next, out of F1
  */
-void MedGuardian::draw(unsigned int ticks, int change) {
+void MedGuardian::draw(unsigned int ticks, fixed alpha) {
 
 	Anim *stageAnim;
 	unsigned char frame;
 
-	if (next) next->draw(ticks, change);
+	if (next) next->draw(ticks, alpha);
 
-	fixed xChange = getDrawX(change);
-	fixed yChange = getDrawY(change);
+	fixed xChange = getDrawX(alpha);
+	fixed yChange = getDrawY(alpha);
 
 
 	frame = ticks / (set->animSpeed << 5);
@@ -439,14 +520,12 @@ void MedGuardian::draw(unsigned int ticks, int change) {
 
 	stageAnim->setFrame(frame + gridX + gridY, true);
 
-	if (ticks < flashTime) stageAnim->flashPalette(0);
-
 	drawnX = x + anim->getXOffset();
 	drawnY = y + anim->getYOffset() + stageAnim->getOffset();
+	placeInCell();
 
-	stageAnim->draw(xChange, yChange);
-
-	if (ticks < flashTime) stageAnim->restorePalette();
+	if (ticks < flashTime) stageAnim->drawFlashed(xChange, yChange, 0);
+	else stageAnim->draw(xChange, yChange);
 
 
 	return;
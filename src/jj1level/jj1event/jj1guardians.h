@@ -39,17 +39,25 @@ class Guardian : public JJ1Event {
 
 		Guardian (unsigned char gX, unsigned char gY);
 
+		void store (File* file);
+
+	public:
+		void load (File* file);
+
 };
 
 /// Episode B guardian
 class DeckGuardian : public Guardian {
 
+	protected:
+		void store (File* file);
+
 	public:
 		DeckGuardian (unsigned char gX, unsigned char gY);
 
 		bool      overlap (fixed left, fixed top, fixed width, fixed height);
 		JJ1Event* step    (unsigned int ticks);
-		void      draw    (unsigned int ticks, int change);
+		void      draw    (unsigned int ticks, fixed alpha);
 
 };
 
@@ -60,12 +68,17 @@ class MedGuardian : public Guardian {
 		unsigned char direction;
 		bool shoot;
 
+	protected:
+		void store (File* file);
+
 	public:
 		MedGuardian (unsigned char gX, unsigned char gY);
 
+		void      load    (File* file);
+
 		//bool   overlap (fixed left, fixed top, fixed width, fixed height);
 		JJ1Event* step    (unsigned int ticks);
-		void      draw    (unsigned int ticks, int change);
+		void      draw    (unsigned int ticks, fixed alpha);
 
 };
 
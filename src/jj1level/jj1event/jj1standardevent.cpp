@@ -33,8 +33,10 @@
 #include "../jj1levelplayer/jj1levelplayer.h"
 #include "jj1event.h"
 
+#include "fixedmath.h"
 #include "io/gfx/sprite.h"
 #include "io/gfx/video.h"
+#include "io/file.h"
 #include "io/sound.h"
 #include "util.h"
 
@@ -107,465 +109,610 @@ JJ1StandardEvent::JJ1StandardEvent (JJ1EventType* event, unsigned char gX, unsig
 
 	}
 
-	return;
 
-}
+	// The way the event moves never changes, so is found now
 
+	path = NULL;
+	radius = 0;
+	baseAngle = 0;
+	acrossSpeed = 0;
 
-/**
- * Move standard event.
- *
- * @param ticks Time
- */
-void JJ1StandardEvent::move (unsigned int ticks) {
+	switch (set->movement) {
 
-	JJ1LevelPlayer* levelPlayer;
-	int length;
-	fixed angle;
+		case 1: movement = &JJ1StandardEvent::moveSink; break;
+		case 2: movement = &JJ1StandardEvent::moveWalk; break;
+		case 3: movement = &JJ1StandardEvent::moveSeek; break;
+		case 4: movement = &JJ1StandardEvent::moveWalkDown; break;
 
+		case 6:
+		case 7:
 
-	if ((animType & ~1) == E_LSHOOTANIM) {
+			path = level->path + set->multiA;
+			movement = &JJ1StandardEvent::moveFollowPath;
 
-		dx = 0;
-		dy = 0;
+			break;
 
-		return;
+		case 11: movement = &JJ1StandardEvent::moveSinkToGround; break;
+		case 12: movement = &JJ1StandardEvent::moveBackAndForth; break;
+		case 13: movement = &JJ1StandardEvent::moveUpAndDown; break;
 
-	}
+		case 16:
 
+			if (set->magnitude == 0) acrossSpeed = -ES_SLOW;
+			else acrossSpeed = set->magnitude * ES_SLOW;
 
-	levelPlayer = localPlayer->getJJ1LevelPlayer();
+			movement = &JJ1StandardEvent::moveAcross;
 
+			break;
 
-	// Handle movement
+		case 21: movement = &JJ1StandardEvent::moveBlock; break;
 
-	switch (set->movement) {
+		case 29:
+		case 30:
 
-		case 1:
+			radius = set->pieceSize * set->pieces;
+			baseAngle = set->angle << 2;
 
-			// Sink down
-			dy = ES_FAST;
+			if (set->movement == 29) movement = &JJ1StandardEvent::moveRotate;
+			else movement = &JJ1StandardEvent::moveSwing;
 
 			break;
 
-		case 2:
+		case 31:
+		case 32: movement = &JJ1StandardEvent::moveHorizontally; break;
+		case 33: movement = &JJ1StandardEvent::moveFollow; break;
+		case 34: movement = &JJ1StandardEvent::moveLaunch; break;
+		case 35: movement = &JJ1StandardEvent::moveFollowOnGround; break;
+		case 36: movement = &JJ1StandardEvent::moveWalkOnScreen; break;
+		case 53: movement = &JJ1StandardEvent::moveSwim; break;
 
-			// Walk from side to side
-			if (animType == E_LEFTANIM) dx = -ES_FAST;
-			else if (animType == E_RIGHTANIM) dx = ES_FAST;
-			else dx = 0;
+		default:
+
+			// 0: Static
+			// 25: Float up / Belt
+			// 37/38: Repel
+			/// @todo 5, 8 (bird-esque following), 9, 10, 14 (move back and
+			/// forth rapidly), 15 (rise or lower to meet jazz), 17-20, 22 (fall
+			/// down in random spot and repeat), 23, 24 (crawl along ground and
+			/// go downstairs), 26, 27 (face jazz), 39 (collapsing floor), 40-43,
+			/// 44 (leap to greet Jazz very quickly), 45, 46 ("final" boss)
+			movement = &JJ1StandardEvent::moveStill;
 
 			break;
 
-		case 3:
+	}
 
-			// Seek jazz
-			if (levelPlayer->getX() + PXO_R < x) dx = -ES_FAST;
-			else if (levelPlayer->getX() + PXO_L > x + width) dx = ES_FAST;
-			else dx = 0;
+	return;
 
-			break;
+}
 
-		case 4:
 
-			// Walk from side to side and down hills
+/**
+ * Stay put, or keep drifting as before. Used by movement types which do not
+ * move the event, or whose behaviour is not known.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveStill (unsigned int ticks) {
 
-			if (!level->checkMaskDown(x + (width >> 1), y)) {
+	(void)ticks;
 
-				// Fall downwards
-				dx = 0;
-				dy = ES_FAST;
+	return true;
 
-			} else {
+}
 
-				// Walk from side to side
-				if (animType == E_LEFTANIM) dx = -ES_FAST;
-				else if (animType == E_RIGHTANIM) dx = ES_FAST;
 
-				dy = 0;
+/**
+ * Sink down.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveSink (unsigned int ticks) {
 
-			}
+	(void)ticks;
 
-			break;
+	dy = ES_FAST;
 
-		case 5:
+	return true;
 
-			/// @todo Find out what behaviour 5 is
+}
 
-			break;
 
-		case 6:
-		case 7:
+/**
+ * Walk from side to side.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveWalk (unsigned int ticks) {
 
-			node = (node + FH) % ITOF(level->path[set->multiA].length);
+	(void)ticks;
 
-			// Use the path from the level file
-			dx = TTOF(gridX) + ITOF(level->path[set->multiA].x[FTOI(node)]) - x;
-			dy = TTOF(gridY) + ITOF(level->path[set->multiA].y[FTOI(node)]) - y;
+	if (animType == E_LEFTANIM) dx = -ES_FAST;
+	else if (animType == E_RIGHTANIM) dx = ES_FAST;
+	else dx = 0;
 
-			x += dx;
-			y += dy;
-			dx = dx << 6;
-			dy = dy << 6;
+	return true;
 
-			return;
+}
 
-		case 8:
 
-			/// @todo Bird-esque following
+/**
+ * Seek jazz.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveSeek (unsigned int ticks) {
 
-			break;
+	JJ1LevelPlayer* levelPlayer;
 
-		case 9:
+	(void)ticks;
 
-			/// @todo Find out what behaviour 9 is
+	levelPlayer = localPlayer->getJJ1LevelPlayer();
 
-			break;
+	if (levelPlayer->getX() + PXO_R < x) dx = -ES_FAST;
+	else if (levelPlayer->getX() + PXO_L > x + width) dx = ES_FAST;
+	else dx = 0;
 
-		case 10:
+	return true;
 
-			/// @todo Find out what behaviour 10 is
+}
 
-			break;
 
-		case 11:
+/**
+ * Walk from side to side and down hills.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveWalkDown (unsigned int ticks) {
 
-			// Sink to ground
-			if (!level->checkMaskDown(x + (width >> 1), y)) dy = ES_FAST;
-			else dy = 0;
+	(void)ticks;
 
-			break;
+	if (!level->checkMaskDown(x + (width >> 1), y)) {
 
-		case 12:
+		// Fall downwards
+		dx = 0;
+		dy = ES_FAST;
 
-			// Move back and forth horizontally
-			if (animType == E_LEFTANIM) dx = -ES_SLOW;
-			else if (animType == E_RIGHTANIM) dx = ES_SLOW;
-			else dx = 0;
+	} else {
 
-			break;
+		// Walk from side to side
+		if (animType == E_LEFTANIM) dx = -ES_FAST;
+		else if (animType == E_RIGHTANIM) dx = ES_FAST;
 
-		case 13:
+		dy = 0;
 
-			// Move up and down
-			if (animType == E_LEFTANIM) dy = -ES_SLOW;
-			else if (animType == E_RIGHTANIM) dy = ES_SLOW;
-			else dy = 0;
+	}
 
-			break;
+	return true;
 
-		case 14:
+}
 
-			/// @todo Move back and forth rapidly
 
-			break;
+/**
+ * Use the path from the level file.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveFollowPath (unsigned int ticks) {
 
-		case 15:
+	(void)ticks;
 
-			/// @todo Rise or lower to meet jazz
+	if (++node == path->length) node = 0;
 
-			break;
+	dx = TTOF(gridX) + path->steps[node].x - x;
+	dy = TTOF(gridY) + path->steps[node].y - y;
 
-		case 16:
+	x += dx;
+	y += dy;
+	dx = dx << 6;
+	dy = dy << 6;
 
-			// Move across level to the left or right
-			if (set->magnitude == 0) dx = -ES_SLOW;
-			else dx = set->magnitude * ES_SLOW;
+	return false;
 
-			break;
+}
 
-		case 17:
 
-			/// @todo Find out what behaviour 17 is
+/**
+ * Sink to ground.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveSinkToGround (unsigned int ticks) {
 
-			break;
+	(void)ticks;
 
-		case 18:
+	if (!level->checkMaskDown(x + (width >> 1), y)) dy = ES_FAST;
+	else dy = 0;
 
-			/// @todo Find out what behaviour 18 is
+	return true;
 
-			break;
+}
 
-		case 19:
 
-			/// @todo Find out what behaviour 19 is
+/**
+ * Move back and forth horizontally.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveBackAndForth (unsigned int ticks) {
 
-			break;
+	(void)ticks;
 
-		case 20:
+	if (animType == E_LEFTANIM) dx = -ES_SLOW;
+	else if (animType == E_RIGHTANIM) dx = ES_SLOW;
+	else dx = 0;
 
-			/// @todo Find out what behaviour 20 is
+	return true;
 
-			break;
+}
 
-		case 21:
 
-			// Destructible block
-			if (level->getEventHits(gridX, gridY) >= set->strength)
-				level->setTile(gridX, gridY, set->multiA);
+/**
+ * Move up and down.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveUpAndDown (unsigned int ticks) {
 
-			break;
+	(void)ticks;
 
-		case 22:
+	if (animType == E_LEFTANIM) dy = -ES_SLOW;
+	else if (animType == E_RIGHTANIM) dy = ES_SLOW;
+	else dy = 0;
 
-			/// @todo Fall down in random spot and repeat
+	return true;
 
-			break;
+}
 
-		case 23:
 
-			/// @todo Find out what behaviour 23 is
+/**
+ * Move across level to the left or right.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveAcross (unsigned int ticks) {
 
-			break;
+	(void)ticks;
 
-		case 24:
+	dx = acrossSpeed;
 
-			/// @todo Crawl along ground and go downstairs
+	return true;
 
-			break;
+}
 
-		case 26:
 
-			/// @todo Find out what behaviour 26 is
+/**
+ * Destructible block.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveBlock (unsigned int ticks) {
 
-			break;
+	(void)ticks;
 
-		case 27:
+	if (level->getEventHits(gridX, gridY) >= set->strength)
+		level->setTile(gridX, gridY, set->multiA);
 
-			/// @todo Face jazz
+	return true;
 
-			break;
+}
 
-		case 29:
 
-			// Rotate
+/**
+ * Rotate.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveRotate (unsigned int ticks) {
 
-			length = set->pieceSize * set->pieces;
-			angle = (set->angle << 2) + (set->magnitude * ticks / 13);
+	fixed angle;
 
-			dx = TTOF(gridX) + (fSin(angle) * length) - x;
-			dy = TTOF(gridY) + ((fCos(angle) + F1) * length) - y;
+	angle = baseAngle + (set->magnitude * ticks / 13);
 
-			x += dx;
-			y += dy;
-			dx = dx << 6;
-			dy = dy << 6;
+	dx = TTOF(gridX) + (fSin(angle) * radius) - x;
+	dy = TTOF(gridY) + ((fCos(angle) + F1) * radius) - y;
 
-			return;
+	x += dx;
+	y += dy;
+	dx = dx << 6;
+	dy = dy << 6;
 
-		case 30:
+	return false;
 
-			// Swing
+}
 
-			length = set->pieceSize * set->pieces;
-			angle = (set->angle << 2) + (set->magnitude * ticks / 13);
 
-			dx = TTOF(gridX) + (fSin(angle) * length) - x;
-			dy = TTOF(gridY) + ((abs(fCos(angle)) + F1) * length) - y;
+/**
+ * Swing.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveSwing (unsigned int ticks) {
 
-			x += dx;
-			y += dy;
-			dx = dx << 6;
-			dy = dy << 6;
+	fixed angle;
 
-			return;
+	angle = baseAngle + (set->magnitude * ticks / 13);
 
-		case 31:
+	dx = TTOF(gridX) + (fSin(angle) * radius) - x;
+	dy = TTOF(gridY) + ((abs(fCos(angle)) + F1) * radius) - y;
 
-			// Move horizontally
-			if (animType == E_LEFTANIM) dx = -ES_FAST;
-			else dx = ES_FAST;
+	x += dx;
+	y += dy;
+	dx = dx << 6;
+	dy = dy << 6;
 
-			break;
+	return false;
 
-		case 32:
+}
 
-			// Move horizontally
-			if (animType == E_LEFTANIM) dx = -ES_FAST;
-			else dx = ES_FAST;
 
-			break;
+/**
+ * Move horizontally.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveHorizontally (unsigned int ticks) {
 
-		case 33:
+	(void)ticks;
 
-			// Sparks-esque following
+	if (animType == E_LEFTANIM) dx = -ES_FAST;
+	else dx = ES_FAST;
 
-			if (levelPlayer->getFacing() && (x + width < levelPlayer->getX())) {
+	return true;
 
-				dx = ES_FAST;
+}
 
-				if (y + height < levelPlayer->getY() + PYO_TOP) dy = ES_SLOW;
-				else if (y > levelPlayer->getY()) dy = -ES_SLOW;
-				else dy = 0;
 
-			} else if (!levelPlayer->getFacing() && (x > levelPlayer->getX() + F32)) {
+/**
+ * Sparks-esque following.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveFollow (unsigned int ticks) {
 
-				dx = -ES_FAST;
+	JJ1LevelPlayer* levelPlayer;
 
-				if (y + height < levelPlayer->getY() + PYO_TOP) dy = ES_SLOW;
-				else if (y > levelPlayer->getY()) dy = -ES_SLOW;
-				else dy = 0;
+	(void)ticks;
 
-			} else {
+	levelPlayer = localPlayer->getJJ1LevelPlayer();
 
-				dx = 0;
-				dy = 0;
+	if (levelPlayer->getFacing() && (x + width < levelPlayer->getX())) {
 
-			}
+		dx = ES_FAST;
 
-			break;
+		if (y + height < levelPlayer->getY() + PYO_TOP) dy = ES_SLOW;
+		else if (y > levelPlayer->getY()) dy = -ES_SLOW;
+		else dy = 0;
 
-		case 34:
+	} else if (!levelPlayer->getFacing() && (x > levelPlayer->getX() + F32)) {
 
-			// Launching event
+		dx = -ES_FAST;
 
-			if (ticks > level->getEventTime(gridX, gridY)) {
+		if (y + height < levelPlayer->getY() + PYO_TOP) dy = ES_SLOW;
+		else if (y > levelPlayer->getY()) dy = -ES_SLOW;
+		else dy = 0;
 
-				if (animType == E_LEFTANIM)
-					dy = -(F16 + y - (TTOF(gridY) - (set->multiA * F12))) * 10;
-				else
-					dy = (F16 + y - (TTOF(gridY) - (set->multiA * F12))) * 10;
+	} else {
 
-			} else {
+		dx = 0;
+		dy = 0;
 
-				dy = TTOF(gridY) + F16 - y;
+	}
 
-				y += dy;
-				dy = dy << 6;
+	return true;
 
-				return;
+}
 
-			}
 
-			break;
+/**
+ * Launching event.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveLaunch (unsigned int ticks) {
 
-		case 35:
+	if (ticks > level->getEventTime(gridX, gridY)) {
 
-			// Non-floating Sparks-esque following
+		if (animType == E_LEFTANIM)
+			dy = -(F16 + y - (TTOF(gridY) - (set->multiA * F12))) * 10;
+		else
+			dy = (F16 + y - (TTOF(gridY) - (set->multiA * F12))) * 10;
 
-			if (levelPlayer->getFacing() && (x + width < levelPlayer->getX() + PXO_L - F4)) {
+		return true;
 
-				if (level->checkMaskDown(x + width, y + F4) &&
-					!level->checkMaskDown(x + width + F4, y - (height >> 1)))
-					dx = ES_FAST;
-				else
-					dx = 0;
+	}
 
-			} else if (!levelPlayer->getFacing() && (x > levelPlayer->getX() + PXO_R + F4)) {
+	dy = TTOF(gridY) + F16 - y;
 
-				if (level->checkMaskDown(x, y + F4) &&
-				    !level->checkMaskDown(x - F4, y - (height >> 1)))
-			    	dx = -ES_FAST;
-			    else
-			    	dx = 0;
+	y += dy;
+	dy = dy << 6;
 
-			} else dx = 0;
+	return false;
 
-			break;
+}
+
+
+/**
+ * Non-floating Sparks-esque following.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveFollowOnGround (unsigned int ticks) {
 
-		case 36:
+	JJ1LevelPlayer* levelPlayer;
 
-			// Walk from side to side and down hills, staying on-screen
+	(void)ticks;
 
-			if (!level->checkMaskDown(x + (width >> 1), y)) {
+	levelPlayer = localPlayer->getJJ1LevelPlayer();
 
-				// Fall downwards
-				dx = 0;
-				dy = ES_FAST;
+	if (levelPlayer->getFacing() && (x + width < levelPlayer->getX() + PXO_L - F4)) {
 
-			} else {
+		if (level->checkMaskDown(x + width, y + F4) &&
+			!level->checkMaskDown(x + width + F4, y - (height >> 1)))
+			dx = ES_FAST;
+		else
+			dx = 0;
 
-				// Walk from side to side, staying on-screen
-				if (animType == E_LEFTANIM) dx = -ES_FAST;
-				else if (animType == E_RIGHTANIM) dx = ES_FAST;
-				else dx = 0;
+	} else if (!levelPlayer->getFacing() && (x > levelPlayer->getX() + PXO_R + F4)) {
 
-				dy = 0;
+		if (level->checkMaskDown(x, y + F4) &&
+			!level->checkMaskDown(x - F4, y - (height >> 1)))
+			dx = -ES_FAST;
+		else
+			dx = 0;
 
-			}
+	} else dx = 0;
 
-			break;
+	return true;
 
-		case 39:
+}
 
-			/// @todo Collapsing floor
 
-			break;
+/**
+ * Walk from side to side and down hills, staying on-screen.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveWalkOnScreen (unsigned int ticks) {
 
-		case 40:
+	(void)ticks;
 
-			/// @todo Find out what behaviour 40 is
+	if (!level->checkMaskDown(x + (width >> 1), y)) {
 
-			break;
+		// Fall downwards
+		dx = 0;
+		dy = ES_FAST;
 
-		case 41:
+	} else {
 
-			/// @todo Switch left & right anim periodically
+		// Walk from side to side, staying on-screen
+		if (animType == E_LEFTANIM) dx = -ES_FAST;
+		else if (animType == E_RIGHTANIM) dx = ES_FAST;
+		else dx = 0;
 
-			break;
+		dy = 0;
 
-		case 42:
+	}
 
-			/// @todo Find out what behaviour 42 is
+	return true;
 
-			break;
+}
 
-		case 43:
 
-			/// @todo Find out what behaviour 43 is
+/**
+ * Dreempipes turtles.
+ *
+ * @param ticks Time
+ *
+ * @return Whether or not the event is then moved at its speed
+ */
+bool JJ1StandardEvent::moveSwim (unsigned int ticks) {
 
-			break;
+	(void)ticks;
 
-		case 44:
+	if (y > level->getWaterLevel()) {
 
-			/// @todo Leap to greet Jazz very quickly
+		if (animType == E_LEFTANIM) dx = -ES_SLOW;
+		else if (animType == E_RIGHTANIM) dx = ES_SLOW;
+		else dx = 0;
 
-			break;
+	} else dx = 0;
 
-		case 45:
+	return true;
 
-			/// @todo Find out what behaviour 45 is
+}
 
-			break;
 
-		case 46:
+/**
+ * Move standard event.
+ *
+ * @param ticks Time
+ */
+void JJ1StandardEvent::move (unsigned int ticks) {
 
-			/// @todo "Final" boss
+	if ((animType & ~1) == E_LSHOOTANIM) {
 
-			break;
+		dx = 0;
+		dy = 0;
 
-		case 53:
+		return;
 
-			// Dreempipes turtles
+	}
 
-			if (y > level->getWaterLevel()) {
+	// Movement types which place the event themselves are done
+	if (!(this->*movement)(ticks)) return;
 
-				if (animType == E_LEFTANIM) dx = -ES_SLOW;
-				else if (animType == E_RIGHTANIM) dx = ES_SLOW;
-				else dx = 0;
+	dx /= set->speed;
+	dy /= set->speed;
+	x += dx >> 6;
+	y += dy >> 6;
 
-			} else dx = 0;
+	return;
 
-			break;
+}
 
-		default:
 
-			// Do nothing for the following:
-			// 0: Static
-			// 25: Float up / Belt
-			// 37/38: Repel
+/**
+ * Write the event to a file.
+ *
+ * @param file The file
+ */
+void JJ1StandardEvent::store (File* file) {
 
-			/// @todo Remaining event behaviours
+	file->storeChar(JJ1EK_STANDARD);
+	JJ1Event::store(file);
+	file->storeShort(node);
 
-			break;
+	return;
 
-	}
+}
 
 
-	dx /= set->speed;
-	dy /= set->speed;
-	x += dx >> 6;
-	y += dy >> 6;
+/**
+ * Read the rest of the event from a file.
+ *
+ * @param file The file
+ */
+void JJ1StandardEvent::load (File* file) {
+
+	JJ1Event::load(file);
+	node = file->loadShort();
 
 	return;
 
@@ -692,9 +839,7 @@ JJ1Event* JJ1StandardEvent::step (unsigned int ticks) {
 
 				// Use the path from the level file
 				// Check movement direction
-				if ((FTOI(node) < 3) ||
-					(level->path[set->multiA].x[FTOI(node)] <= level->path[set->multiA].x[FTOI(node) - 3]))
-					setAnimType(E_LEFTANIM);
+				if (path->steps[node].left) setAnimType(E_LEFTANIM);
 				else
 					setAnimType(E_RIGHTANIM);
 
@@ -1014,19 +1159,19 @@ JJ1Event* JJ1StandardEvent::step (unsigned int ticks) {
  * Draw standard event.
  *
  * @param ticks Time
- * @param change Time since last iteration
+ * @param alpha How far drawing is between the last step and the next, out of F1
  */
-void JJ1StandardEvent::draw (unsigned int ticks, int change) {
+void JJ1StandardEvent::draw (unsigned int ticks, fixed alpha) {
 
 	Anim* miscAnim;
 
 
-	if (next) next->draw(ticks, change);
+	if (next) next->draw(ticks, alpha);
 
 
 	// Uncomment the following to see the raw location
-	/*drawRect(FTOI(getDrawX(change)),
-		FTOI(getDrawY(change) - height), FTOI(width),
+	/*drawRect(FTOI(getDrawX(alpha)),
+		FTOI(getDrawY(alpha) - height), FTOI(width),
 		FTOI(height), 88);*/
 
 
@@ -1040,6 +1185,7 @@ void JJ1StandardEvent::draw (unsigned int ticks, int change) {
 		drawnY = y - F32;
 		width = F32;
 		height = F32;
+		placeInCell();
 
 		return;
 
@@ -1063,8 +1209,8 @@ void JJ1StandardEvent::draw (unsigned int ticks, int change) {
 
 
 	// Calculate new positions
-	fixed changeX = getDrawX(change);
-	fixed changeY = getDrawY(change);
+	fixed changeX = getDrawX(alpha);
+	fixed changeY = getDrawY(alpha);
 
 
 	// Draw the event
@@ -1080,13 +1226,18 @@ void JJ1StandardEvent::draw (unsigned int ticks, int change) {
 
 		int val = gridX + gridY;
 
-		// Draw the animation in six different positions
-		anim->draw(changeX - yOffset, changeY - xOffset);
-		anim->draw(changeX + yOffset, changeY - xOffset);
-		anim->draw(changeX + ITOF(val % 32) - yOffset, changeY - ITOF(val % 8) - xOffset);
-		anim->draw(changeX - ITOF(val % 16) + yOffset, changeY - ITOF(val % 16) - xOffset);
-		anim->draw(changeX + ITOF(val % 24) - yOffset, changeY + ITOF(val % 12) - xOffset);
-		anim->draw(changeX - ITOF(val % 48) + yOffset, changeY + ITOF(val % 24) - xOffset);
+		// Draw the animation in six different positions, which are never
+		// more than 100 pixels from the event
+		if (isInView(changeX - F100, changeY - F100, width + (F100 << 1), height + (F100 << 1))) {
+
+			anim->draw(changeX - yOffset, changeY - xOffset);
+			anim->draw(changeX + yOffset, changeY - xOffset);
+			anim->draw(changeX + ITOF(val % 32) - yOffset, changeY - ITOF(val % 8) - xOffset);
+			anim->draw(changeX - ITOF(val % 16) + yOffset, changeY - ITOF(val % 16) - xOffset);
+			anim->draw(changeX + ITOF(val % 24) - yOffset, changeY + ITOF(val % 12) - xOffset);
+			anim->draw(changeX - ITOF(val % 48) + yOffset, changeY + ITOF(val % 24) - xOffset);
+
+		}
 
 	} else {
 
@@ -1094,8 +1245,6 @@ void JJ1StandardEvent::draw (unsigned int ticks, int change) {
 
 		fixed offset;
 
-		if ((ticks < flashTime) && ((ticks >> 4) & 3)) anim->flashPalette(0);
-
 		// Determine the corect vertical offset
 		// Most animations need a default offset of 1 tile (32 pixels)
 
@@ -1129,13 +1278,21 @@ void JJ1StandardEvent::draw (unsigned int ticks, int change) {
 
 		drawnX = x + anim->getXOffset() + F1;
 		drawnY = y + anim->getYOffset() + offset + F1;
+		placeInCell();
 
 		// Uncomment the following line to see the draw area
 		//drawRect(FTOI(changeX - x + drawnX), FTOI(changeY - y + drawnY), FTOI(width), FTOI(height), 88);
 
-		anim->draw(changeX + F1, changeY + offset + F1 - anim->getOffset());
+		// The event's position in the grid is still needed for collisions,
+		// but there is no need to draw it
+		if (isInView(changeX - x + drawnX, changeY - y + drawnY, width, height)) {
 
-		if ((ticks < flashTime) && ((ticks >> 4) & 3)) anim->restorePalette();
+			if ((ticks < flashTime) && ((ticks >> 4) & 3))
+				anim->drawFlashed(changeX + F1, changeY + offset + F1 - anim->getOffset(), 0);
+			else
+				anim->draw(changeX + F1, changeY + offset + F1 - anim->getOffset());
+
+		}
 
 	}
 
@@ -36,17 +36,23 @@
 #include "jj1bullet.h"
 #include "jj1event/jj1event.h"
 #include "jj1level.h"
+#include "jj1levelplayer/jj1bird.h"
 #include "jj1levelplayer/jj1levelplayer.h"
 
 #include "game/game.h"
 #include "game/gamemode.h"
 #include "io/controls.h"
 #include "io/file.h"
+#include "io/gfx/blitter.h"
 #include "io/gfx/font.h"
 #include "io/gfx/paletteeffects.h"
 #include "io/gfx/sprite.h"
 #include "io/gfx/video.h"
+#include "io/loadprofile.h"
 #include "io/sound.h"
+#include "level/replay.h"
+#include "pressure.h"
+#include "profile.h"
 #include "util.h"
 
 #include <string.h>
@@ -59,7 +65,11 @@
  */
 JJ1Level::JJ1Level (Game* owner) : Level(owner) {
 
-	// Do nothing
+	chunksReliever = -1;
+#ifdef SDL2
+	expandedTiles = NULL;
+	trueCanvas = NULL;
+#endif
 
 	return;
 
@@ -79,12 +89,23 @@ JJ1Level::JJ1Level (Game* owner, char* fileName, bool checkpoint, bool multi) :
 
 	int ret;
 
+	chunksReliever = -1;
+#ifdef SDL2
+	expandedTiles = NULL;
+	trueCanvas = NULL;
+#endif
+
 	// Load level data
 
+	LOAD_BEGIN("JJ1Level::load");
 	ret = load(fileName, checkpoint);
+	LOAD_END();
 
 	if (ret < 0) throw ret;
 
+	LOAD_REPORT(fileName);
+	PROFILE_LEVEL(fileName);
+
 	multiplayer = multi;
 
 	return;
@@ -97,13 +118,48 @@ JJ1Level::JJ1Level (Game* owner, char* fileName, bool checkpoint, bool multi) :
  */
 void JJ1Level::deletePanel () {
 
-	SDL_FreeSurface(panel);
-	SDL_FreeSurface(panelAmmo[0]);
-	SDL_FreeSurface(panelAmmo[1]);
-	SDL_FreeSurface(panelAmmo[2]);
-	SDL_FreeSurface(panelAmmo[3]);
-	SDL_FreeSurface(panelAmmo[4]);
-	SDL_FreeSurface(panelAmmo[5]);
+	freeSurface(hud);
+	freeSurface(panel);
+	freeSurface(panelAmmo[0]);
+	freeSurface(panelAmmo[1]);
+	freeSurface(panelAmmo[2]);
+	freeSurface(panelAmmo[3]);
+	freeSurface(panelAmmo[4]);
+	freeSurface(panelAmmo[5]);
+
+	return;
+
+}
+
+
+/**
+ * Delete the tile set.
+ */
+JJ1TilesAsset::~JJ1TilesAsset () {
+
+	delete[] tileImages;
+	if (tileSet) freeSurface(tileSet);
+	delete[] pixels;
+
+	return;
+
+}
+
+
+/**
+ * Make the tile set's surface, which draws on the decoded pixels in place.
+ */
+void JJ1TilesAsset::finish () {
+
+	if (tileSet) return;
+
+	tileSet = wrapSurface(pixels, TTOI(1), TTOI(tiles));
+
+	#ifdef SDL2
+	SDL_SetColorKey(tileSet, SDL_TRUE, TKEY);
+	#else
+	SDL_SetColorKey(tileSet, SDL_SRCCOLORKEY, TKEY);
+	#endif
 
 	return;
 
@@ -115,7 +171,7 @@ void JJ1Level::deletePanel () {
  */
 JJ1Level::~JJ1Level () {
 
-	int count;
+	int x, y;
 
 	// Free events
 	if (events) delete events;
@@ -123,19 +179,38 @@ JJ1Level::~JJ1Level () {
 	// Free bullets
 	if (bullets) delete bullets;
 
-	for (count = 0; count < PATHS; count++) {
+	// Release the pools' slots, which are sized for the next level as it loads
+	JJ1Event::pool.setCapacity(0);
+	JJ1Bullet::pool.setCapacity(0);
+	JJ1Bird::pool.setCapacity(0);
 
-		delete[] path[count].x;
-		delete[] path[count].y;
-
-	}
+	// The event paths are freed along with the arena
 
 	delete[] sceneFile;
 	delete[] musicFile;
 
 	delete[] spriteSet;
 
-	SDL_FreeSurface(tileSet);
+	// The tile set stays cached for later levels
+	assetCache.release(tilesAsset);
+
+	memoryPressure.remove(chunksReliever);
+
+	for (y = 0; y < LH / CHUNK_H; y++) {
+
+		for (x = 0; x < LW / CHUNK_W; x++) {
+
+			if (chunks[y][x]) freeSurface(chunks[y][x]);
+
+		}
+
+	}
+
+	if (skyStrip) freeSurface(skyStrip);
+
+#ifdef SDL2
+	if (expandedTiles) delete expandedTiles;
+#endif
 
 	deletePanel();
 
@@ -170,7 +245,7 @@ bool JJ1Level::checkMaskUp (fixed x, fixed y) {
 	if (ge->event == 122) return false;
 
 	// Check the mask in the tile in question
-	return mask[ge->tile][((y >> 9) & 56) + ((x >> 12) & 7)];
+	return (mask[ge->tile][(y >> 12) & 7] >> ((x >> 12) & 7)) & 1;
 
 }
 
@@ -190,7 +265,7 @@ bool JJ1Level::checkMaskDown (fixed x, fixed y) {
 		return true;
 
 	// Check the mask in the tile in question
-	return mask[grid[FTOT(y)][FTOT(x)].tile][((y >> 9) & 56) + ((x >> 12) & 7)];
+	return (mask[grid[FTOT(y)][FTOT(x)].tile][(y >> 12) & 7] >> ((x >> 12) & 7)) & 1;
 
 }
 
@@ -217,7 +292,281 @@ bool JJ1Level::checkSpikes (fixed x, fixed y) {
 	if (ge->event != 126) return false;
 
 	// Check the mask in the tile in question
-	return mask[ge->tile][((y >> 9) & 56) + ((x >> 12) & 7)];
+	return (mask[ge->tile][(y >> 12) & 7] >> ((x >> 12) & 7)) & 1;
+
+}
+
+
+/**
+ * Find how far below the given point the first mask cell which is solid when
+ * travelling downwards lies, a tile at a time rather than a cell at a time.
+ *
+ * @param x X-coordinate
+ * @param y Y-coordinate
+ * @param range The furthest distance to look, in mask cells (4 pixels)
+ *
+ * @return The distance in mask cells, or range + 1 if there is no solid cell in range
+ */
+int JJ1Level::findFloorAt (fixed x, fixed y, int range) {
+
+	unsigned char column;
+	int tX, cell, distance;
+
+	// Anything off the edge of the map is solid
+	if ((x < 0) || (y < 0) || (x >= TTOF(LW))) return 0;
+
+	tX = FTOT(x);
+	cell = y >> 12;
+	distance = 0;
+
+	while (distance <= range) {
+
+		if (cell >= LH << 3) return distance;
+
+		column = maskColumns[grid[cell >> 3][tX].tile][(x >> 12) & 7] >> (cell & 7);
+
+		if (column) {
+
+			distance += __builtin_ctz(column);
+
+			return (distance <= range)? distance: range + 1;
+
+		}
+
+		// Move on to the top of the next tile down
+		distance += 8 - (cell & 7);
+		cell = (cell | 7) + 1;
+
+	}
+
+	return range + 1;
+
+}
+
+
+/**
+ * Find how far above the given point the first mask cell which is solid when
+ * travelling upwards lies, a tile at a time rather than a cell at a time.
+ *
+ * @param x X-coordinate
+ * @param y Y-coordinate
+ * @param range The furthest distance to look, in mask cells (4 pixels)
+ *
+ * @return The distance in mask cells, or range + 1 if there is no solid cell in range
+ */
+int JJ1Level::findCeilingAt (fixed x, fixed y, int range) {
+
+	GridElement *ge;
+	unsigned char column;
+	int tX, cell, distance;
+
+	// Anything off the edge of the map is solid
+	if ((x < 0) || (y < 0) || (x >= TTOF(LW)) || (y >= TTOF(LH))) return 0;
+
+	tX = FTOT(x);
+	cell = y >> 12;
+	distance = 0;
+
+	while (distance <= range) {
+
+		if (cell < 0) return distance;
+
+		ge = grid[cell >> 3] + tX;
+
+		// JJ1Event 122 is one-way
+		if (ge->event != 122) {
+
+			// Keep the cells at and above this one
+			column = maskColumns[ge->tile][(x >> 12) & 7] & ((2 << (cell & 7)) - 1);
+
+			if (column) {
+
+				distance += (cell & 7) - (31 - __builtin_clz(column));
+
+				return (distance <= range)? distance: range + 1;
+
+			}
+
+		}
+
+		// Move on to the bottom of the next tile up
+		distance += (cell & 7) + 1;
+		cell = (cell & ~7) - 1;
+
+	}
+
+	return range + 1;
+
+}
+
+
+/**
+ * Find how far below a horizontal span the first mask cell which is solid when
+ * travelling downwards lies. The span is probed at its ends and its centre,
+ * like the player's own mask checks.
+ *
+ * @param left X-coordinate of the left of the span
+ * @param right X-coordinate of the right of the span
+ * @param y Y-coordinate
+ * @param range The furthest distance to look, in mask cells (4 pixels)
+ *
+ * @return The distance in mask cells, or range + 1 if there is no solid cell in range
+ */
+int JJ1Level::findFloor (fixed left, fixed right, fixed y, int range) {
+
+	int distance, nearest;
+
+	nearest = findFloorAt(left, y, range);
+
+	if (right == left) return nearest;
+
+	distance = findFloorAt((left + right) >> 1, y, nearest);
+	if (distance < nearest) nearest = distance;
+
+	distance = findFloorAt(right, y, nearest);
+	if (distance < nearest) nearest = distance;
+
+	return nearest;
+
+}
+
+
+/**
+ * Find how far above a horizontal span the first mask cell which is solid when
+ * travelling upwards lies. The span is probed at its ends and its centre, like
+ * the player's own mask checks.
+ *
+ * @param left X-coordinate of the left of the span
+ * @param right X-coordinate of the right of the span
+ * @param y Y-coordinate
+ * @param range The furthest distance to look, in mask cells (4 pixels)
+ *
+ * @return The distance in mask cells, or range + 1 if there is no solid cell in range
+ */
+int JJ1Level::findCeiling (fixed left, fixed right, fixed y, int range) {
+
+	int distance, nearest;
+
+	nearest = findCeilingAt(left, y, range);
+
+	if (right == left) return nearest;
+
+	distance = findCeilingAt((left + right) >> 1, y, nearest);
+	if (distance < nearest) nearest = distance;
+
+	distance = findCeilingAt(right, y, nearest);
+	if (distance < nearest) nearest = distance;
+
+	return nearest;
+
+}
+
+
+/**
+ * Find how far to the left of the given point the first mask cell which is
+ * solid when travelling upwards lies, a tile at a time rather than a cell at a
+ * time.
+ *
+ * @param x X-coordinate
+ * @param y Y-coordinate
+ * @param range The furthest distance to look, in mask cells (4 pixels)
+ *
+ * @return The distance in mask cells, or range + 1 if there is no solid cell in range
+ */
+int JJ1Level::findWallLeft (fixed x, fixed y, int range) {
+
+	GridElement *row;
+	unsigned char cells;
+	int cell, distance;
+
+	// Anything off the edge of the map is solid
+	if ((x < 0) || (y < 0) || (x >= TTOF(LW)) || (y >= TTOF(LH))) return 0;
+
+	row = grid[FTOT(y)];
+	cell = x >> 12;
+	distance = 0;
+
+	while (distance <= range) {
+
+		if (cell < 0) return distance;
+
+		// JJ1Event 122 is one-way
+		if (row[cell >> 3].event != 122) {
+
+			// Keep the cells at and to the left of this one
+			cells = mask[row[cell >> 3].tile][(y >> 12) & 7] & ((2 << (cell & 7)) - 1);
+
+			if (cells) {
+
+				distance += (cell & 7) - (31 - __builtin_clz(cells));
+
+				return (distance <= range)? distance: range + 1;
+
+			}
+
+		}
+
+		// Move on to the right of the next tile to the left
+		distance += (cell & 7) + 1;
+		cell = (cell & ~7) - 1;
+
+	}
+
+	return range + 1;
+
+}
+
+
+/**
+ * Find how far to the right of the given point the first mask cell which is
+ * solid when travelling upwards lies, a tile at a time rather than a cell at a
+ * time.
+ *
+ * @param x X-coordinate
+ * @param y Y-coordinate
+ * @param range The furthest distance to look, in mask cells (4 pixels)
+ *
+ * @return The distance in mask cells, or range + 1 if there is no solid cell in range
+ */
+int JJ1Level::findWallRight (fixed x, fixed y, int range) {
+
+	GridElement *row;
+	unsigned char cells;
+	int cell, distance;
+
+	// Anything off the edge of the map is solid
+	if ((x < 0) || (y < 0) || (x >= TTOF(LW)) || (y >= TTOF(LH))) return 0;
+
+	row = grid[FTOT(y)];
+	cell = x >> 12;
+	distance = 0;
+
+	while (distance <= range) {
+
+		if (cell >= LW << 3) return distance;
+
+		// JJ1Event 122 is one-way
+		if (row[cell >> 3].event != 122) {
+
+			cells = mask[row[cell >> 3].tile][(y >> 12) & 7] >> (cell & 7);
+
+			if (cells) {
+
+				distance += __builtin_ctz(cells);
+
+				return (distance <= range)? distance: range + 1;
+
+			}
+
+		}
+
+		// Move on to the left of the next tile to the right
+		distance += 8 - (cell & 7);
+		cell = (cell | 7) + 1;
+
+	}
+
+	return range + 1;
 
 }
 
@@ -273,20 +622,215 @@ void JJ1Level::setNext (int nextLevel, int nextWorld) {
  */
 void JJ1Level::setTile (unsigned char gridX, unsigned char gridY, unsigned char tile) {
 
-	unsigned char buffer[MTL_L_GRID];
-
 	grid[gridY][gridX].tile = tile;
+	invalidateChunk(gridX, gridY);
 
-	if (multiplayer) {
+	markChange(gridX, gridY, GV_TILE);
 
-		buffer[0] = MTL_L_GRID;
-		buffer[1] = MT_L_GRID;
-		buffer[2] = gridX;
-		buffer[3] = gridY;
-		buffer[4] = 0; // tile variable
-		buffer[5] = tile;
+	return;
 
-		game->send(buffer);
+}
+
+
+/**
+ * Discard every cached background chunk, as memory is running short. They are
+ * rendered again as they are seen. Only called by the main thread, between
+ * frames.
+ *
+ * @param data The level
+ *
+ * @return Whether or not any chunks were discarded
+ */
+bool JJ1Level::relieveChunks (void* data) {
+
+	JJ1Level* level;
+	int x, y;
+	bool discarded;
+
+	level = (JJ1Level *)data;
+	discarded = false;
+
+	for (y = 0; y < LH / CHUNK_H; y++) {
+
+		for (x = 0; x < LW / CHUNK_W; x++) {
+
+			if (level->chunks[y][x]) {
+
+				freeSurface(level->chunks[y][x]);
+				level->chunks[y][x] = NULL;
+				discarded = true;
+
+			}
+
+		}
+
+	}
+
+	return discarded;
+
+}
+
+
+/**
+ * Discard the cached background chunk containing the given tile, so that it
+ * is rendered again with the tile's new contents.
+ *
+ * @param gridX X-coordinate of the tile
+ * @param gridY Y-coordinate of the tile
+ */
+void JJ1Level::invalidateChunk (unsigned char gridX, unsigned char gridY) {
+
+	SDL_Surface** chunk;
+
+	chunk = chunks[gridY / CHUNK_H] + (gridX / CHUNK_W);
+
+	if (*chunk) {
+
+		freeSurface(*chunk);
+		*chunk = NULL;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Note that a grid element has changed, so that the change is sent at the end
+ * of the step. Repeated changes to the same variable are only sent once.
+ *
+ * @param gridX X-coordinate of the tile
+ * @param gridY Y-coordinate of the tile
+ * @param variable The variable which has changed (GV_TILE, etc.)
+ */
+void JJ1Level::markChange (unsigned char gridX, unsigned char gridY, int variable) {
+
+	if (!multiplayer) return;
+
+	gridChanges[gridY][gridX] |= 1 << variable;
+
+	if (gridY < changedTop) changedTop = gridY;
+	if (gridY > changedBottom) changedBottom = gridY;
+
+	return;
+
+}
+
+
+/**
+ * Get the value of one of a grid element's variables.
+ *
+ * @param gridX X-coordinate of the tile
+ * @param gridY Y-coordinate of the tile
+ * @param variable The variable (GV_TILE, etc.)
+ * @param loaded Whether to get the value as loaded, rather than as it is now
+ *
+ * @return The value
+ */
+int JJ1Level::getGridValue (int gridX, int gridY, int variable, bool loaded) {
+
+	if (variable == GV_HITS) return loaded? 0: eventHits[gridY][gridX];
+
+	if (loaded) return baseGrid[gridY][gridX][variable];
+
+	return (variable == GV_TILE)? grid[gridY][gridX].tile: grid[gridY][gridX].event;
+
+}
+
+
+/**
+ * Send grid elements as runs of elements in the same row sharing the same
+ * value, packed into as few MT_L_GRIDS messages as possible.
+ *
+ * @param queue Queue to receive the messages, or NULL to send them to the rest
+ * of the game
+ * @param loaded Whether to send every element which differs from the level as
+ * loaded, rather than those which have changed this step
+ */
+void JJ1Level::sendGrid (NetQueue* queue, bool loaded) {
+
+	unsigned char buffer[BUFFER_LENGTH];
+	int top, bottom, x, y, variable, value, length;
+
+	if (loaded) {
+
+		top = 0;
+		bottom = LH - 1;
+
+	} else {
+
+		top = changedTop;
+		bottom = changedBottom;
+
+	}
+
+	buffer[0] = MTL_L_GRIDS;
+	buffer[1] = MT_L_GRIDS;
+
+	for (y = top; y <= bottom; y++) {
+
+		for (variable = GV_TILE; variable <= GV_HITS; variable++) {
+
+			for (x = 0; x < LW; x += length) {
+
+				value = getGridValue(x, y, variable, false);
+
+				if (loaded? (value == getGridValue(x, y, variable, true)):
+					!(gridChanges[y][x] & (1 << variable))) {
+
+					length = 1;
+
+					continue;
+
+				}
+
+				// Extend the run over the following elements with the same
+				// value
+				for (length = 1; (x + length < LW) && (length < 255); length++) {
+
+					if (getGridValue(x + length, y, variable, false) != value) break;
+
+					if (loaded? (value == getGridValue(x + length, y, variable, true)):
+						!(gridChanges[y][x + length] & (1 << variable))) break;
+
+				}
+
+				if (buffer[0] + MTL_L_RUN > BUFFER_LENGTH) {
+
+					if (queue) queue->add(buffer, false);
+					else game->send(buffer);
+
+					buffer[0] = MTL_L_GRIDS;
+
+				}
+
+				buffer[buffer[0]] = x;
+				buffer[buffer[0] + 1] = y;
+				buffer[buffer[0] + 2] = variable;
+				buffer[buffer[0] + 3] = length;
+				buffer[buffer[0] + 4] = value;
+				buffer[0] += MTL_L_RUN;
+
+			}
+
+		}
+
+		if (!loaded) memset(gridChanges[y], 0, LW);
+
+	}
+
+	if (buffer[0] > MTL_L_GRIDS) {
+
+		if (queue) queue->add(buffer, false);
+		else game->send(buffer);
+
+	}
+
+	if (!loaded) {
+
+		changedTop = LH;
+		changedBottom = -1;
 
 	}
 
@@ -295,6 +839,21 @@ void JJ1Level::setTile (unsigned char gridX, unsigned char gridY, unsigned char
 }
 
 
+/**
+ * Queue messages bringing another copy of the level, as loaded, up to date with
+ * this one.
+ *
+ * @param queue Queue to receive the messages
+ */
+void JJ1Level::sendChanges (NetQueue* queue) {
+
+	sendGrid(queue, true);
+
+	return;
+
+}
+
+
 /**
  * Get the active events.
  *
@@ -307,6 +866,103 @@ JJ1Event* JJ1Level::getEvents () {
 }
 
 
+/**
+ * Get the collision cell for an event at the given position. Events are kept
+ * in the cell holding their top left corner.
+ *
+ * @param x The x-coordinate of the left of the event
+ * @param y The y-coordinate of the top of the event
+ * @param width The width of the event
+ * @param height The height of the event
+ *
+ * @return The first event in the cell
+ */
+JJ1Event** JJ1Level::getEventCell (fixed x, fixed y, fixed width, fixed height) {
+
+	int cellX, cellY;
+
+	if (width > eventReach) eventReach = width;
+	if (height > eventReach) eventReach = height;
+
+	cellX = FTOT(x) >> 2;
+	cellY = FTOT(y) >> 2;
+
+	if (cellX < 0) cellX = 0;
+	else if (cellX >= ECW) cellX = ECW - 1;
+
+	if (cellY < 0) cellY = 0;
+	else if (cellY >= ECH) cellY = ECH - 1;
+
+	return eventCells[cellY] + cellX;
+
+}
+
+
+/**
+ * Find the active events overlapping the given area, looking only in the
+ * collision cells near it.
+ *
+ * @param areaX The x-coordinate of the left of the area
+ * @param areaY The y-coordinate of the top of the area
+ * @param areaWidth The width of the area
+ * @param areaHeight The height of the area
+ * @param found Array of EQUERY events, to receive those found
+ *
+ * @return The number of events found
+ */
+int JJ1Level::findEvents (fixed areaX, fixed areaY, fixed areaWidth, fixed areaHeight, JJ1Event** found) {
+
+	JJ1Event* event;
+	int left, right, top, bottom;
+	int cellX, cellY, count;
+
+	// Events in cells up to eventReach above and to the left may extend into the area
+	left = FTOT(areaX - eventReach) >> 2;
+	right = FTOT(areaX + areaWidth) >> 2;
+	top = FTOT(areaY - eventReach) >> 2;
+	bottom = FTOT(areaY + areaHeight) >> 2;
+
+	// Events beyond the edges of the level are kept in the edge cells
+	if (left < 0) left = 0;
+	else if (left >= ECW) left = ECW - 1;
+	if (right < 0) right = 0;
+	else if (right >= ECW) right = ECW - 1;
+	if (top < 0) top = 0;
+	else if (top >= ECH) top = ECH - 1;
+	if (bottom < 0) bottom = 0;
+	else if (bottom >= ECH) bottom = ECH - 1;
+
+	count = 0;
+
+	for (cellY = top; cellY <= bottom; cellY++) {
+
+		for (cellX = left; cellX <= right; cellX++) {
+
+			event = eventCells[cellY][cellX];
+
+			while (event) {
+
+				if (event->overlap(areaX, areaY, areaWidth, areaHeight)) {
+
+					found[count++] = event;
+
+					if (count == EQUERY) return count;
+
+				}
+
+				event = event->getCellNext();
+
+			}
+
+		}
+
+	}
+
+	return count;
+
+}
+
+
 /**
  * Get the event data for the event from the given tile.
  *
@@ -336,7 +992,7 @@ JJ1EventType* JJ1Level::getEvent (unsigned char gridX, unsigned char gridY) {
  */
 unsigned char JJ1Level::getEventHits (unsigned char gridX, unsigned char gridY) {
 
-	return grid[gridY][gridX].hits;
+	return eventHits[gridY][gridX];
 
 }
 
@@ -351,7 +1007,33 @@ unsigned char JJ1Level::getEventHits (unsigned char gridX, unsigned char gridY)
  */
 unsigned int JJ1Level::getEventTime (unsigned char gridX, unsigned char gridY) {
 
-	return grid[gridY][gridX].time;
+	return eventTimes[gridY][gridX];
+
+}
+
+
+/**
+ * Find how the given tile is drawn, from its event.
+ *
+ * @param gridX X-coordinate of the tile
+ * @param gridY Y-coordinate of the tile
+ */
+void JJ1Level::setFlags (unsigned char gridX, unsigned char gridY) {
+
+	GridElement* ge;
+
+	ge = grid[gridY] + gridX;
+
+	ge->flags &= GF_BLACK;
+
+	if (ge->event == 123) ge->flags |= GF_ANIMATED;
+
+	if ((ge->event == 124) ||
+		(ge->event == 125) ||
+		(eventSet[ge->event].movement == 37) ||
+		(eventSet[ge->event].movement == 38)) ge->flags |= GF_FORE;
+
+	return;
 
 }
 
@@ -364,26 +1046,15 @@ unsigned int JJ1Level::getEventTime (unsigned char gridX, unsigned char gridY) {
  */
 void JJ1Level::clearEvent (unsigned char gridX, unsigned char gridY) {
 
-	unsigned char buffer[MTL_L_GRID];
-
 	// Ignore if the event has been un-destroyed
-	if (!grid[gridY][gridX].hits &&
+	if (!eventHits[gridY][gridX] &&
 		eventSet[grid[gridY][gridX].event].strength) return;
 
 	grid[gridY][gridX].event = 0;
+	setFlags(gridX, gridY);
+	invalidateChunk(gridX, gridY);
 
-	if (multiplayer) {
-
-		buffer[0] = MTL_L_GRID;
-		buffer[1] = MT_L_GRID;
-		buffer[2] = gridX;
-		buffer[3] = gridY;
-		buffer[4] = 2; // event variable
-		buffer[5] = 0;
-
-		game->send(buffer);
-
-	}
+	markChange(gridX, gridY, GV_EVENT);
 
 	return;
 
@@ -403,54 +1074,42 @@ void JJ1Level::clearEvent (unsigned char gridX, unsigned char gridY) {
  */
 int JJ1Level::hitEvent (unsigned char gridX, unsigned char gridY, int hits, JJ1LevelPlayer* source, unsigned int time) {
 
-	GridElement* ge;
-	unsigned char buffer[MTL_L_GRID];
+	unsigned char* shot;
 	int hitsToKill;
 
-	ge = grid[gridY] + gridX;
+	shot = eventHits[gridY] + gridX;
 
-	hitsToKill = eventSet[ge->event].strength;
+	hitsToKill = eventSet[grid[gridY][gridX].event].strength;
 
 	// If the event cannot be hit, return negative
-	if (!hitsToKill || (ge->hits == 255)) return -1;
+	if (!hitsToKill || (*shot == 255)) return -1;
 
 	// If the event has already been destroyed, do nothing
-	if (ge->hits >= hitsToKill) return 0;
+	if (*shot >= hitsToKill) return 0;
 
 	// Check if the event has been killed
-	if (ge->hits + hits >= hitsToKill) {
+	if (*shot + hits >= hitsToKill) {
 
 		// Notify the player that shot the bullet
 		// If this returns false, ignore the hit
-		if (!source->takeEvent(eventSet + ge->event, gridX, gridY, ticks)) {
+		if (!source->takeEvent(eventSet + grid[gridY][gridX].event, gridX, gridY, ticks)) {
 
-			return hitsToKill - ge->hits;
+			return hitsToKill - *shot;
 
 		}
 
-		ge->hits = (hits == 255)? 255: hitsToKill;
-		ge->time = time;
+		*shot = (hits == 255)? 255: hitsToKill;
+		eventTimes[gridY][gridX] = time;
 
 	} else {
 
-		ge->hits += hits;
+		*shot += hits;
 
 	}
 
-	if (multiplayer) {
+	markChange(gridX, gridY, GV_HITS);
 
-		buffer[0] = MTL_L_GRID;
-		buffer[1] = MT_L_GRID;
-		buffer[2] = gridX;
-		buffer[3] = gridY;
-		buffer[4] = 3; // hits variable
-		buffer[5] = ge->hits;
-
-		game->send(buffer);
-
-	}
-
-	return hitsToKill - ge->hits;
+	return hitsToKill - *shot;
 
 }
 
@@ -464,7 +1123,7 @@ int JJ1Level::hitEvent (unsigned char gridX, unsigned char gridY, int hits, JJ1L
  */
 void JJ1Level::setEventTime (unsigned char gridX, unsigned char gridY, unsigned int time) {
 
-	grid[gridY][gridX].time = time;
+	eventTimes[gridY][gridX] = time;
 
 	return;
 
@@ -642,6 +1301,26 @@ void JJ1Level::flash (unsigned char red, unsigned char green, unsigned char blue
 }
 
 
+/**
+ * Move on to the next level.
+ *
+ * @return Error code
+ */
+int JJ1Level::advance () {
+
+	char string[FILE_NAME_LENGTH];
+	int ret;
+
+	writeFileName(string, FILE_NAME_LENGTH, "LEVEL", nextLevelNum, nextWorldNum);
+	ret = game->setLevel(string);
+
+	if (ret < 0) return ret;
+
+	return WON;
+
+}
+
+
 /**
  * Play the bonus level.
  *
@@ -679,6 +1358,8 @@ int JJ1Level::playBonus () {
  */
 void JJ1Level::receive (unsigned char* buffer) {
 
+	int position, x, y;
+
 	switch (buffer[1]) {
 
 		case MT_L_PROP:
@@ -701,13 +1382,38 @@ void JJ1Level::receive (unsigned char* buffer) {
 
 			break;
 
-		case MT_L_GRID:
+		case MT_L_GRIDS:
+
+			// Each run gives a row, the first element, the variable, the
+			// number of elements and their value
+			for (position = MTL_L_GRIDS; position + MTL_L_RUN <= buffer[0]; position += MTL_L_RUN) {
+
+				y = buffer[position + 1];
+
+				if (y >= LH) continue;
+
+				for (x = buffer[position]; (x < buffer[position] + buffer[position + 3]) && (x < LW); x++) {
+
+					if (buffer[position + 2] == GV_TILE) {
 
-			if (buffer[4] == 0) grid[buffer[3]][buffer[2]].tile = buffer[5];
-			else if (buffer[4] == 2)
-				grid[buffer[3]][buffer[2]].event = buffer[5];
-			else if (buffer[4] == 3)
-				grid[buffer[3]][buffer[2]].hits = buffer[5];
+						grid[y][x].tile = buffer[position + 4];
+						invalidateChunk(x, y);
+
+					} else if (buffer[position + 2] == GV_EVENT) {
+
+						grid[y][x].event = buffer[position + 4];
+						setFlags(x, y);
+						invalidateChunk(x, y);
+
+					} else if (buffer[position + 2] == GV_HITS) {
+
+						eventHits[y][x] = buffer[position + 4];
+
+					}
+
+				}
+
+			}
 
 			break;
 
@@ -724,6 +1430,81 @@ void JJ1Level::receive (unsigned char* buffer) {
 }
 
 
+/**
+ * Add the level's state to a rewind. Events and bullets live in their pools,
+ * so the pools are captured whole, along with the players.
+ *
+ * @param target The rewind
+ *
+ * @return Whether or not the level can be rolled back
+ */
+bool JJ1Level::prepareRewind (Rewind* target) {
+
+	int count;
+
+	target->clear();
+
+	target->add(&events, sizeof(events));
+	target->add(eventCells, sizeof(eventCells));
+	target->add(&bullets, sizeof(bullets));
+	target->add(grid, sizeof(grid));
+	target->add(eventHits, sizeof(eventHits));
+	target->add(eventTimes, sizeof(eventTimes));
+	target->add(&enemies, sizeof(enemies));
+	target->add(&items, sizeof(items));
+	target->add(&waterLevel, sizeof(waterLevel));
+	target->add(&waterLevelTarget, sizeof(waterLevelTarget));
+	target->add(&waterLevelSpeed, sizeof(waterLevelSpeed));
+
+	JJ1Event::pool.addTo(target);
+	JJ1Bullet::pool.addTo(target);
+	JJ1Bird::pool.addTo(target);
+
+	target->add(players, sizeof(Player) * nPlayers);
+
+	for (count = 0; count < nPlayers; count++)
+		target->add(players[count].getJJ1LevelPlayer(), sizeof(JJ1LevelPlayer));
+
+	return true;
+
+}
+
+
+/**
+ * Determine whether or not the whole of the level's state is currently held
+ * in the memory added to the rewind.
+ *
+ * @return Whether or not the state can be captured
+ */
+bool JJ1Level::canCapture () {
+
+	// Events, bullets and birds which did not fit in their pools are on the
+	// heap
+	return JJ1Event::pool.isContained() && JJ1Bullet::pool.isContained() &&
+		JJ1Bird::pool.isContained();
+
+}
+
+
+/**
+ * Redraw the background from the grid as it now stands, after the level has
+ * been put back to an earlier state.
+ */
+void JJ1Level::stateRestored () {
+
+	int x, y;
+
+	for (y = 0; y < LH / CHUNK_H; y++) {
+
+		for (x = 0; x < LW / CHUNK_W; x++) invalidateChunk(x * CHUNK_W, y * CHUNK_H);
+
+	}
+
+	return;
+
+}
+
+
 /**
  * Play the level.
  *
@@ -732,7 +1513,7 @@ void JJ1Level::receive (unsigned char* buffer) {
 int JJ1Level::play () {
 
 	JJ1LevelPlayer* levelPlayer;
-	char *string;
+	char string[FILE_NAME_LENGTH];
 	bool pmessage, pmenu;
 	int option;
 	unsigned int returnTime;
@@ -747,6 +1528,8 @@ int JJ1Level::play () {
 	ticks = T_STEP;
 	steps = 0;
 
+	startRollback();
+
 	pmessage = pmenu = false;
 	option = 0;
 
@@ -760,6 +1543,9 @@ int JJ1Level::play () {
 
 	while (true) {
 
+		// Positioned sounds are heard from the local player
+		setSoundListener(levelPlayer->getX(), levelPlayer->getY());
+
 		ret = loop(pmenu, option, pmessage);
 
 		if (ret < 0) return ret;
@@ -791,33 +1577,43 @@ int JJ1Level::play () {
 			}
 
 			// Advance to next level
-
-			string = createFileName("LEVEL", nextLevelNum, nextWorldNum);
-			ret = game->setLevel(string);
-			delete[] string;
-
-			if (ret < 0) return ret;
-
-			return WON;
+			return advance();
 
 		}
 
 
 		// Process frame-by-frame activity
 
-		while (getTimeChange() >= T_STEP) {
+		while (takeStep()) {
 
 			bool playerWasAlive = (localPlayer->getJJ1LevelPlayer()->getEnergy() != 0);
 
-			// Apply controls to local player
-			for (count = 0; count < PCONTROLS; count++)
-				localPlayer->setControl(count, controls.getState(count));
+			// Take again any steps which other players' late controls changed
+			ret = rollBack();
+
+			if (ret) return ret;
+
+			// Apply controls to local player, recorded or played back
+			// A followed player is controlled by the server
+			ret = (game && game->isSpectating())? E_NONE: replay.control(localPlayer);
+
+			if (ret < 0) return ret;
+
+			controlSecond();
 
+			recordStep();
+
+			PROFILE_BEGIN(PZ_STEP);
 			ret = step();
+			PROFILE_END(PZ_STEP);
 			steps++;
 
 			if (ret) return ret;
 
+			ret = checkState();
+
+			if (ret < 0) return ret;
+
 			if (!multiplayer && playerWasAlive && (localPlayer->getJJ1LevelPlayer()->getEnergy() == 0))
 				flash(0, 0, 0, T_END << 1);
 
@@ -826,7 +1622,9 @@ int JJ1Level::play () {
 
 		// Draw the graphics
 
+		PROFILE_BEGIN(PZ_DRAW);
 		draw();
+		PROFILE_END(PZ_DRAW);
 
 
 		// If paused, draw "PAUSE"
@@ -861,6 +1659,15 @@ int JJ1Level::play () {
 
 				if (timeBonus == -1) {
 
+					// Decode the next level's tile set and load its music
+					// while the statistics and any cutscene are shown
+					if (game) {
+
+						writeFileName(string, FILE_NAME_LENGTH, "LEVEL", nextLevelNum, nextWorldNum);
+						assetCache.preload(preload, string);
+
+					}
+
 					if (ticks < endTime) timeBonus = ((endTime - ticks) / 60000) * 100;
 					else timeBonus = 0;
 
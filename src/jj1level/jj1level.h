@@ -33,7 +33,9 @@
 
 
 #include "level/level.h"
+#include "io/assetcache.h"
 #include "io/gfx/anim.h"
+#include "jobs.h"
 #include "OpenJazz.h"
 
 
@@ -49,6 +51,15 @@
 #define ANIMS     128
 #define PATHS      16
 #define TKEY      127 /* Tileset colour key */
+#define HUDSTATE    7 /* Number of values the HUD's appearance depends on */
+
+// Grid element flags
+#define GF_BLACK    1 /* Black background, rather than the effect background */
+#define GF_FORE     2 /* Foreground tile */
+#define GF_ANIMATED 4 /* Animated foreground tile */
+#define ECW   (LW >> 2) /* Width of the event collision grid, in 4 * 4 tile cells */
+#define ECH   (LH >> 2) /* Height of the event collision grid */
+#define EQUERY     64 /* Most events found by one collision query */
 
 // Player animations
 #define PA_LWALK    0
@@ -109,21 +120,32 @@
 // Black palette index
 #define LEVEL_BLACK 31
 
+// Background chunk dimensions, in tiles
+#define CHUNK_W 8
+#define CHUNK_H 8
+
 // Fade delays
 #define T_START 500
 #define T_END   1000
 
+// Grid element variables, as identified in MT_L_GRIDS messages
+#define GV_TILE  0
+#define GV_EVENT 1
+#define GV_HITS  2
+
+// Jobs helping to decode sprites
+#define SPRITE_JOBS 3
+
 
 // Datatypes
 
-/// JJ1 level grid element
+/// JJ1 level grid element. The state of the element's event is kept apart, so
+/// that drawing and collision checks only read what they need.
 typedef struct {
 
 	unsigned char tile; ///< Indexes the tile set
-	unsigned char bg; ///< 0 = Effect background, 1 = Black background
 	unsigned char event; ///< Indexes the event set
-	unsigned char hits; ///< Number of times the event has been shot
-	int           time; ///< Point at which the event will do something, e.g. terminate
+	unsigned char flags; ///< How the tile is drawn (GF_BLACK, etc.)
 
 } GridElement;
 
@@ -151,31 +173,80 @@ typedef struct {
 
 } JJ1EventType;
 
-/// Pre-defined JJ1 event movement path
+/// JJ1 sprite waiting to be decoded
+typedef struct {
+
+	unsigned char* block; ///< The sprite's scrambled pixels, and mask if it has one, or NULL if it is blank
+	int            length; ///< Length of the block
+	int            width; ///< Width of the sprite
+	int            height; ///< Height of the sprite
+	bool           masked; ///< Whether or not the block starts with a mask
+	unsigned char* pixels; ///< The decoded pixels, once decoded
+
+} JJ1SpriteLoad;
+
+/// A step along a pre-defined JJ1 event movement path
+typedef struct {
+
+	fixed x; ///< X-coordinate, relative to the event's origin
+	fixed y; ///< Y-coordinate, relative to the event's origin
+	bool  left; ///< Whether or not the event is heading left
+
+} JJ1PathStep;
+
+/// Pre-defined JJ1 event movement path, with each node lasting two steps
 typedef struct {
 
-	short int*    x; ///< X-coordinates for each node
-	short int*    y; ///< Y-coordinates for each node
-	unsigned char length; ///< Number of nodes
+	JJ1PathStep* steps; ///< Position at each step
+	int          length; ///< Number of steps
 
 } JJ1EventPath;
 
 
 // Classes
 
+class BlitImage;
+class ExpandedSet;
 class Font;
 class JJ1Bullet;
 class JJ1Event;
 class JJ1LevelPlayer;
 
+/// JJ1 tile set, decoded from a BLOCKS file
+class JJ1TilesAsset : public Asset {
+
+	public:
+		SDL_Color    palette[256]; ///< Tile set palette
+		SDL_Color    skyPalette[256]; ///< Full palette for sky background
+		unsigned char* pixels; ///< Tile images' pixels
+		SDL_Surface* tileSet; ///< Tile images, or NULL until the asset is finished
+		BlitImage*   tileImages; ///< Tile images prepared for drawing
+		int          tiles; ///< Number of tiles
+
+		~JJ1TilesAsset ();
+
+		void finish ();
+
+};
+
 /// JJ1 level
 class JJ1Level : public Level {
 
 	private:
+		JJ1TilesAsset* tilesAsset; ///< Tile set, shared with other levels
 		SDL_Surface*  tileSet; ///< Tile images
+		BlitImage*    tileImages; ///< Tile images prepared for drawing
+#ifdef SDL2
+		ExpandedSet*  expandedTiles; ///< Tile images expanded for the 32-bit canvas, or NULL if not in true-colour mode
+		Uint32*       trueCanvas; ///< The 32-bit canvas tiles are drawn into this frame, or NULL
+#endif
 		SDL_Surface*  panel; ///< HUD background image
 		SDL_Surface*  panelAmmo[6]; ///< HUD ammo type images
+		SDL_Surface*  hud; ///< HUD, as last composed
+		int           hudState[HUDSTATE]; ///< Values shown by the HUD when it was last composed
 		JJ1Event*     events; ///< Active events
+		JJ1Event*     eventCells[ECH][ECW]; ///< Active events, by the cell holding their top left corner
+		fixed         eventReach; ///< Largest dimension of any event, so how far into neighbouring cells to look
 		JJ1Bullet*    bullets; ///< Active bullets
 		char*         sceneFile; ///< File name of cutscene to play when level has been completed
 		Sprite*       spriteSet; ///< Sprites
@@ -184,9 +255,19 @@ class JJ1Level : public Level {
 		char          playerAnims[JJ1PANIMS]; ///< Default player animations
 		signed char   bulletSet[BULLETS][BLENGTH]; ///< Bullet types
 		JJ1EventType  eventSet[EVENTS]; ///< Event types
-		char          mask[240][64]; ///< Tile masks. At most 240 tiles, all with 8 * 8 masks
+		unsigned char mask[240][8]; ///< Tile masks. At most 240 tiles, all with 8 * 8 masks, a bit per cell
+		unsigned char maskColumns[240][8]; ///< Tile masks, a byte per column of cells, the top cell in the lowest bit
 		GridElement   grid[LH][LW]; ///< Level grid. All levels are the same size
+		unsigned char eventHits[LH][LW]; ///< Number of times each grid element's event has been shot
+		unsigned char baseGrid[LH][LW][2]; ///< Tile and event of each grid element as loaded
+		unsigned char gridChanges[LH][LW]; ///< Variables of each grid element changed this step, a bit for each
+		int           changedTop; ///< First row changed this step, or LH if none
+		int           changedBottom; ///< Last row changed this step
+		unsigned int  eventTimes[LH][LW]; ///< Point at which each grid element's event will do something, e.g. terminate
+		SDL_Surface*  chunks[LH / CHUNK_H][LW / CHUNK_W]; ///< Cached background tiles, rendered as needed
+		int           chunksReliever; ///< Index of the background tiles among the caches emptied when memory runs short, or -1
 		SDL_Color     skyPalette[256]; ///< Full palette for sky background
+		SDL_Surface*  skyStrip; ///< Sky background gradient, rendered for the current view size
 		bool          sky; ///< Whether or not to use sky background
 		unsigned char skyOrb; ///< The tile to use as the background sun/moon/etc.
 		int           levelNum; ///< Number of current level
@@ -201,12 +282,33 @@ class JJ1Level : public Level {
 		int           ammoType; ///< HUD ammo type
 		fixed         ammoOffset; ///< HUD ammo offset
 
-		void deletePanel  ();
-		int  loadPanel    ();
-		void loadSprite   (File* file, Sprite* sprite);
-		int  loadSprites  (char* fileName);
-		int  loadTiles    (char* fileName);
-		int  playBonus    ();
+		JJ1SpriteLoad* spriteLoads; ///< Sprites being decoded, or NULL
+		SDL_atomic_t   nextSpriteLoad; ///< The next sprite to be decoded
+		Job            spriteJobs[SPRITE_JOBS]; ///< Jobs helping to decode sprites
+		Job            spritesDone; ///< Done once every sprite has been decoded
+
+		static JJ1TilesAsset* decodeTiles   (const char* fileName);
+		static void           spriteJob     (void* data);
+		static bool           relieveChunks (void* data);
+
+		void         deletePanel     ();
+		int          findCeilingAt   (fixed x, fixed y, int range);
+		int          findFloorAt     (fixed x, fixed y, int range);
+		void         setFlags        (unsigned char gridX, unsigned char gridY);
+		SDL_Surface* getChunk        (int chunkX, int chunkY);
+		void         drawTile        (int tile, int x, int y);
+		void         drawBackground  (int vX, int vY, int viewH);
+		void         invalidateChunk (unsigned char gridX, unsigned char gridY);
+		void         markChange      (unsigned char gridX, unsigned char gridY, int variable);
+		int          getGridValue    (int gridX, int gridY, int variable, bool loaded);
+		void         sendGrid        (NetQueue* queue, bool loaded);
+		int          loadPanel       ();
+		void         indexSprite     (File* file, JJ1SpriteLoad* load);
+		void         decodeSprites   ();
+		int          startSprites    (char* fileName);
+		void         finishSprites   ();
+		int          loadTiles       (char* fileName);
+		int          playBonus       ();
 
 	protected:
 		Font* font; ///< On-screen message font
@@ -215,8 +317,16 @@ class JJ1Level : public Level {
 		JJ1Level (Game* owner);
 
 		int  load (char* fileName, bool checkpoint);
-		int  step ();
-		void draw ();
+		bool prepareRewind (Rewind* target);
+		bool canCapture    ();
+		void stateRestored ();
+		bool writeState    (File* file);
+		bool readState     (File* file);
+		int  step     ();
+		void calcView (fixed alpha);
+		void drawView (fixed alpha);
+		void draw     ();
+		int  advance  ();
 
 	public:
 		JJ1EventPath path[PATHS]; ///< Pre-defined event movement paths
@@ -224,13 +334,21 @@ class JJ1Level : public Level {
 		JJ1Level          (Game* owner, char* fileName, bool checkpoint, bool multi);
 		virtual ~JJ1Level ();
 
+		static void preload (const char* fileName);
+
 		bool          checkMaskUp   (fixed x, fixed y);
 		bool          checkMaskDown (fixed x, fixed y);
 		bool          checkSpikes   (fixed x, fixed y);
+		int           findFloor     (fixed left, fixed right, fixed y, int range);
+		int           findCeiling   (fixed left, fixed right, fixed y, int range);
+		int           findWallLeft  (fixed x, fixed y, int range);
+		int           findWallRight (fixed x, fixed y, int range);
 		int           getWorld      ();
 		void          setNext       (int nextLevel, int nextWorld);
 		void          setTile       (unsigned char gridX, unsigned char gridY, unsigned char tile);
 		JJ1Event*     getEvents     ();
+		JJ1Event**    getEventCell  (fixed x, fixed y, fixed width, fixed height);
+		int           findEvents    (fixed areaX, fixed areaY, fixed areaWidth, fixed areaHeight, JJ1Event** found);
 		JJ1EventType* getEvent      (unsigned char gridX, unsigned char gridY);
 		unsigned char getEventHits  (unsigned char gridX, unsigned char gridY);
 		unsigned int  getEventTime  (unsigned char gridX, unsigned char gridY);
@@ -246,8 +364,12 @@ class JJ1Level : public Level {
 		fixed         getWaterLevel ();
 		void          flash         (unsigned char red, unsigned char green, unsigned char blue, int duration);
 		void          receive       (unsigned char* buffer);
+		void          sendChanges   (NetQueue* queue);
 		virtual int   play          ();
 
+		friend class JJ1Bullet;
+		friend class JJ1Event;
+
 };
 
 /// JJ1 level played as a demo
@@ -260,7 +382,9 @@ class JJ1DemoLevel : public JJ1Level {
 		JJ1DemoLevel  (Game* owner, const char* fileName);
 		~JJ1DemoLevel ();
 
-		int play   ();
+		bool restart ();
+		void suspend ();
+		int  play    ();
 
 };
 
@@ -35,8 +35,10 @@
 #include "game/game.h"
 #include "game/gamemode.h"
 #include "io/controls.h"
+#include "io/gfx/blitter.h"
 #include "io/gfx/font.h"
 #include "io/gfx/video.h"
+#include "level/benchmark.h"
 #include "util.h"
 
 
@@ -56,6 +58,8 @@ int JJ1Level::step () {
 	if (canvasW > SW) viewH = canvasH;
 	else viewH = canvasH - 33;
 
+	bench.enter(BS_EVENTS);
+
 	// Search for active events
 	for (y = FTOT(viewY) - 5; y < ITOT(FTOI(viewY) + viewH) + 5; y++) {
 
@@ -116,18 +120,36 @@ int JJ1Level::step () {
 	}
 
 
+	bench.leave(BS_EVENTS);
+
+
 	// Process bullets
+	bench.enter(BS_BULLETS);
 	if (bullets) bullets = bullets->step(ticks);
+	bench.leave(BS_BULLETS);
 
 	// Determine the players' trajectories
+	bench.enter(BS_PLAYERS);
 	for (x = 0; x < nPlayers; x++) players[x].getJJ1LevelPlayer()->control(ticks);
+	bench.leave(BS_PLAYERS);
 
 	// Process active events
+	bench.enter(BS_EVENTS);
 	if (events) events = events->step(ticks);
+	bench.leave(BS_EVENTS);
 
 	// Apply as much of those trajectories as possible, without going into the
 	// scenery
+	bench.enter(BS_COLLISION);
 	for (x = 0; x < nPlayers; x++) players[x].getJJ1LevelPlayer()->move(ticks);
+	bench.leave(BS_COLLISION);
+
+	// Keep where each player was, for judging remote players' shots
+	if (multiplayer) {
+
+		for (x = 0; x < nPlayers; x++) players[x].getJJ1LevelPlayer()->recordPosition(steps);
+
+	}
 
 
 	// Check if time has run out
@@ -186,7 +208,8 @@ int JJ1Level::step () {
 
 			players[x].clearAmmo();
 
-			if (!multiplayer) return LOST;
+			// A second local player goes back to the checkpoint instead
+			if (!multiplayer && (players + x == localPlayer)) return LOST;
 
 			game->resetPlayer(players + x);
 
@@ -195,6 +218,10 @@ int JJ1Level::step () {
 	}
 
 
+	// Send the grid elements changed this step
+	if (multiplayer && (changedTop < LH)) sendGrid(NULL, false);
+
+
 	return E_NONE;
 
 }
@@ -202,25 +229,184 @@ int JJ1Level::step () {
 
 
 /**
- * Draw the level.
+ * Get a chunk of background tiles, rendering it if it is not already cached.
+ *
+ * Transparent areas of the chunk use the tile set's colour key, so the sky
+ * still shows through.
+ *
+ * @param chunkX X-coordinate of the chunk
+ * @param chunkY Y-coordinate of the chunk
+ *
+ * @return The chunk
  */
-void JJ1Level::draw () {
+SDL_Surface* JJ1Level::getChunk (int chunkX, int chunkY) {
 
-	GridElement *ge;
-	SDL_Rect src, dst;
-	int viewH;
-	int vX, vY;
-	int x, y, bgScale;
-	unsigned int change;
+	SDL_Surface* chunk;
+	GridElement* ge;
+	unsigned char* src;
+	unsigned char* dst;
+	int x, y, row, pixel;
+
+	chunk = chunks[chunkY][chunkX];
+
+	if (chunk) return chunk;
+
+	chunk = createSurface(NULL, TTOI(CHUNK_W), TTOI(CHUNK_H));
+
+	#ifdef SDL2
+	SDL_SetColorKey(chunk, SDL_TRUE, TKEY);
+	#else
+	SDL_SetColorKey(chunk, SDL_SRCCOLORKEY, TKEY);
+	#endif
+
+	if (SDL_MUSTLOCK(chunk)) SDL_LockSurface(chunk);
+
+	for (y = 0; y < CHUNK_H; y++) {
+
+		for (x = 0; x < CHUNK_W; x++) {
+
+			ge = grid[(chunkY * CHUNK_H) + y] + (chunkX * CHUNK_W) + x;
+
+			for (row = 0; row < TTOI(1); row++) {
 
+				dst = ((unsigned char *)(chunk->pixels)) + (chunk->pitch * (TTOI(y) + row)) + TTOI(x);
 
-	// Calculate change since last step
-	change = getTimeChange();
+				// If this tile uses a black background, draw it
+				memset(dst, (ge->flags & GF_BLACK)? LEVEL_BLACK: TKEY, TTOI(1));
 
+				// If this is not a foreground tile, draw it
+				if (!(ge->flags & GF_FORE)) {
 
-	// Calculate viewport
-	if (game && (stage == LS_END)) game->view(paused? 0: ((ticks - prevTicks) * 160));
-	else localPlayer->getJJ1LevelPlayer()->view(ticks, paused? 0: (ticks - prevTicks), change);
+					src = ((unsigned char *)(tileSet->pixels)) + (tileSet->pitch * (TTOI(ge->tile) + row));
+
+					for (pixel = 0; pixel < TTOI(1); pixel++) {
+
+						if (src[pixel] != TKEY) dst[pixel] = src[pixel];
+
+					}
+
+				}
+
+			}
+
+		}
+
+	}
+
+	if (SDL_MUSTLOCK(chunk)) SDL_UnlockSurface(chunk);
+
+	chunks[chunkY][chunkX] = chunk;
+
+	return chunk;
+
+}
+
+
+/**
+ * Draw a tile, into the 32-bit canvas if it is being used, respecting the
+ * canvas's clipping rectangle.
+ *
+ * @param tile The tile
+ * @param x The x-coordinate at which to draw the tile
+ * @param y The y-coordinate at which to draw the tile
+ */
+void JJ1Level::drawTile (int tile, int x, int y) {
+
+#ifdef SDL2
+	if (trueCanvas) {
+
+		if (SDL_MUSTLOCK(canvas)) SDL_LockSurface(canvas);
+
+		tileImages[tile].drawTrue(trueCanvas, expandedTiles->getColours(tile),
+			x, y, &(canvas->clip_rect), false);
+
+		if (SDL_MUSTLOCK(canvas)) SDL_UnlockSurface(canvas);
+
+		return;
+
+	}
+#endif
+
+	tileImages[tile].draw(x, y);
+
+	return;
+
+}
+
+
+/**
+ * Draw the background tiles in view. In 8 bits they are drawn a chunk at a
+ * time, from the chunk caches. In true colour they are drawn a tile at a
+ * time, from the expanded tiles.
+ *
+ * @param vX The x-coordinate of the view
+ * @param vY The y-coordinate of the view
+ * @param viewH The height of the view
+ */
+void JJ1Level::drawBackground (int vX, int vY, int viewH) {
+
+	SDL_Surface* chunk;
+	SDL_Rect dst;
+	int x, y;
+
+#ifdef SDL2
+	GridElement* ge;
+
+	if (trueCanvas) {
+
+		for (y = ITOT(vY); (y <= ITOT(vY + viewH - 1)) && (y < LH); y++) {
+
+			for (x = ITOT(vX); (x <= ITOT(vX + canvasW - 1)) && (x < LW); x++) {
+
+				ge = grid[y] + x;
+
+				// If this tile uses a black background, draw it
+				if (ge->flags & GF_BLACK) drawRect(TTOI(x) - vX, TTOI(y) - vY, TTOI(1), TTOI(1), LEVEL_BLACK);
+
+				// If this is not a foreground tile, draw it
+				if (!(ge->flags & GF_FORE)) drawTile(ge->tile, TTOI(x) - vX, TTOI(y) - vY);
+
+			}
+
+		}
+
+		return;
+
+	}
+#endif
+
+	for (y = ITOT(vY) / CHUNK_H; (y <= ITOT(vY + viewH - 1) / CHUNK_H) && (y < LH / CHUNK_H); y++) {
+
+		for (x = ITOT(vX) / CHUNK_W; (x <= ITOT(vX + canvasW - 1) / CHUNK_W) && (x < LW / CHUNK_W); x++) {
+
+			chunk = getChunk(x, y);
+
+			dst.x = TTOI(x * CHUNK_W) - vX;
+			dst.y = TTOI(y * CHUNK_H) - vY;
+			video.syncSurfacePalette(chunk);
+			SDL_BlitSurface(chunk, NULL, canvas, &dst);
+
+		}
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Calculate the viewport, keeping it within the level.
+ *
+ * @param alpha Progress towards the next step
+ */
+void JJ1Level::calcView (fixed alpha) {
+
+	int viewH;
+
+	if (bench.isSweeping()) bench.sweep(TTOI(LW), TTOI(LH));
+	else if (game && (stage == LS_END)) game->view(paused? 0: ((ticks - prevTicks) * 160));
+	else getViewer()->getJJ1LevelPlayer()->view(ticks, paused? 0: (ticks - prevTicks), alpha);
 
 	// Can we see below the panel?
 	if (canvasW > SW) viewH = canvasH;
@@ -232,6 +418,31 @@ void JJ1Level::draw () {
 	if (FTOI(viewY) + viewH >= TTOI(LH)) viewY = ITOF(TTOI(LH) - viewH);
 	if (viewY < 0) viewY = 0;
 
+	return;
+
+}
+
+
+/**
+ * Draw one player's view of the level, filling the canvas apart from the
+ * panel.
+ *
+ * @param alpha Progress towards the next step
+ */
+void JJ1Level::drawView (fixed alpha) {
+
+	SDL_Surface* target;
+	GridElement *ge;
+	SDL_Rect dst;
+	int viewH;
+	int vX, vY;
+	int x, y, bgScale;
+
+
+	// Can we see below the panel?
+	if (canvasW > SW) viewH = canvasH;
+	else viewH = canvasH - 33;
+
 	// Use the viewport
 	dst.x = 0;
 	dst.y = 0;
@@ -242,31 +453,45 @@ void JJ1Level::draw () {
 	SDL_SetClipRect(canvas, &dst);
 
 
-	// Set tile drawing dimensions
-	src.w = TTOI(1);
-	src.h = TTOI(1);
-	src.x = 0;
-
-
 	// If there is a sky, draw it
 	if (sky) {
 
-		// Background scale
-		if (canvasW > 320) bgScale = ((canvasH - 1) / 100) + 1;
-		else bgScale = ((canvasH - 34) / 100) + 1;
+		/* The gradient is made of fixed palette indices, so it only needs
+		rendering again when the view changes size */
+		if (!skyStrip || (skyStrip->w != canvasW) || (skyStrip->h != viewH)) {
+
+			if (skyStrip) freeSurface(skyStrip);
 
-		for (y = 0; y < viewH; y += bgScale)
-			drawRect(0, y, canvasW, bgScale, 156 + (y / bgScale));
+			skyStrip = createSurface(NULL, canvasW, viewH);
+
+			// Background scale
+			if (canvasW > 320) bgScale = ((canvasH - 1) / 100) + 1;
+			else bgScale = ((canvasH - 34) / 100) + 1;
+
+			// Draw to the sky strip in place of the canvas
+			target = canvas;
+			canvas = skyStrip;
+
+			for (y = 0; y < viewH; y += bgScale)
+				drawRect(0, y, canvasW, bgScale, 156 + (y / bgScale));
+
+			canvas = target;
+
+		}
+
+		dst.x = 0;
+		dst.y = 0;
+		video.syncSurfacePalette(skyStrip);
+		SDL_BlitSurface(skyStrip, NULL, canvas, &dst);
 
 
 		// Show sun / moon / etc.
 		if (skyOrb) {
 
-			dst.x = ((canvasW * 4) / 5) - (vX & 3);
-			dst.y = ((canvasH - 33) * 3) / 25;
-			src.y = TTOI(skyOrb + (vX & 3));
-			SDL_SetPaletteColors(tileSet->format->palette, canvas->format->palette->colors, 0, 256);
-			SDL_BlitSurface(tileSet, &src, canvas, &dst);
+			x = skyOrb + (vX & 3);
+
+			if (x < 256)
+				drawTile(x, ((canvasW * 4) / 5) - (vX & 3), ((canvasH - 33) * 3) / 25);
 
 		}
 
@@ -281,56 +506,26 @@ void JJ1Level::draw () {
 
 
 	// Show background tiles
+	drawBackground(vX, vY, viewH);
 
-	for (y = 0; y <= ITOT(viewH - 1) + 1; y++) {
-
-		for (x = 0; x <= ITOT(canvasW - 1) + 1; x++) {
+	// Anything beyond the edges of the level is black
+	if (vX + canvasW > TTOI(LW))
+		drawRect(TTOI(LW) - vX, 0, vX + canvasW - TTOI(LW), viewH, LEVEL_BLACK);
 
-			if ((x + ITOT(vX) >= 256) || (y + ITOT(vY) >= 64)) {
-
-				drawRect(TTOI(x) - (vX & 31), TTOI(y) - (vY & 31), 32, 32, LEVEL_BLACK);
-
-				continue;
-
-			}
-
-			// Get the grid element from the given coordinates
-			ge = grid[y + ITOT(vY)] + x + ITOT(vX);
-
-			// If this tile uses a black background, draw it
-			if (ge->bg)
-				drawRect(TTOI(x) - (vX & 31), TTOI(y) - (vY & 31), 32, 32, LEVEL_BLACK);
-
-
-			// If this is not a foreground tile, draw it
-			if ((ge->event != 124) &&
-				(ge->event != 125) &&
-				(eventSet[ge->event].movement != 37) &&
-				(eventSet[ge->event].movement != 38)) {
-
-				dst.x = TTOI(x) - (vX & 31);
-				dst.y = TTOI(y) - (vY & 31);
-				src.y = TTOI(ge->tile);
-				SDL_SetPaletteColors(tileSet->format->palette, canvas->format->palette->colors, 0, 256);
-				SDL_BlitSurface(tileSet, &src, canvas, &dst);
-
-			}
-
-		}
-
-	}
+	if (vY + viewH > TTOI(LH))
+		drawRect(0, TTOI(LH) - vY, canvasW, vY + viewH - TTOI(LH), LEVEL_BLACK);
 
 
 	// Show active events
-	if (events) events->draw(ticks, change);
+	if (events) events->draw(ticks, alpha);
 
 
 	// Show the players
-	for (x = 0; x < nPlayers; x++) players[x].getJJ1LevelPlayer()->draw(ticks, change);
+	for (x = 0; x < nPlayers; x++) players[x].getJJ1LevelPlayer()->draw(ticks, alpha);
 
 
 	// Show bullets
-	if (bullets) bullets->draw(change);
+	if (bullets) bullets->draw(alpha);
 
 
 
@@ -346,28 +541,17 @@ void JJ1Level::draw () {
 			ge = grid[y + ITOT(vY)] + x + ITOT(vX);
 
 			// If this is an "animated" foreground tile, draw it
-			if (ge->event == 123) {
+			if (ge->flags & GF_ANIMATED) {
 
-				dst.x = TTOI(x) - (vX & 31);
-				dst.y = TTOI(y) - (vY & 31);
-				if (ticks & 64) src.y = TTOI(eventSet[ge->event].multiB);
-				else src.y = TTOI(eventSet[ge->event].multiA);
-				SDL_SetPaletteColors(tileSet->format->palette, canvas->format->palette->colors, 0, 256);
-				SDL_BlitSurface(tileSet, &src, canvas, &dst);
+				drawTile((unsigned char)((ticks & 64)? eventSet[ge->event].multiB: eventSet[ge->event].multiA),
+					TTOI(x) - (vX & 31), TTOI(y) - (vY & 31));
 
 			}
 
 			// If this is a foreground tile, draw it
-			if ((ge->event == 124) ||
-				(ge->event == 125) ||
-				(eventSet[ge->event].movement == 37) ||
-				(eventSet[ge->event].movement == 38)) {
+			if (ge->flags & GF_FORE) {
 
-				dst.x = TTOI(x) - (vX & 31);
-				dst.y = TTOI(y) - (vY & 31);
-				src.y = TTOI(ge->tile);
-				SDL_SetPaletteColors(tileSet->format->palette, canvas->format->palette->colors, 0, 256);
-				SDL_BlitSurface(tileSet, &src, canvas, &dst);
+				drawTile(ge->tile, TTOI(x) - (vX & 31), TTOI(y) - (vY & 31));
 
 			}
 
@@ -389,133 +573,213 @@ void JJ1Level::draw () {
 	if (multiplayer) game->getMode()->drawScore(font);
 
 
+	return;
+
+}
+
+
+/**
+ * Draw the level.
+ */
+void JJ1Level::draw () {
+
+	SDL_Surface* target;
+	SDL_Rect src, dst;
+	int x, y, count;
+	int hudChange[HUDSTATE], remaining;
+	fixed alpha;
+
+
+	// Calculate progress towards the next step
+	alpha = getAlpha();
+
+
+#ifdef SDL2
+	// Tiles are drawn into the 32-bit canvas, if there is one this frame.
+	// Palette effects are applied as the frame is shown, so the tiles take on
+	// their colours the frame after.
+	trueCanvas = expandedTiles? video.getTrueCanvas(): NULL;
+	if (trueCanvas) expandedTiles->refresh();
+#endif
+
+	// Draw each view, sharing the chunk caches and sky strip between them
+	for (count = 0; count < getViews(); count++) {
+
+		beginView(count);
+		calcView(alpha);
+		drawView(alpha);
+		endView(count);
+
+	}
+
+
 	// Show panel
 
 	SDL_SetClipRect(canvas, NULL);
 
-	if (ammoOffset != 0) {
 
-		if (ammoOffset < 0) {
+	// Update the health bar
 
-			// Finished descending
-			ammoOffset = 0;
+	x = localPlayer->getJJ1LevelPlayer()->getEnergy();
+	y = (ticks - prevTicks) * 40;
 
-		}
+	if (FTOI(energyBar) < (x << 4)) {
+
+		if ((x << 14) - energyBar < y) energyBar = x << 14;
+		else energyBar += y;
 
-		src.x = 0;
-		src.y = FTOI(ammoOffset);
-		src.w = 64;
-		src.h = 26 - src.y;
-		dst.x = 248;
-		dst.y = 3;
-		SDL_SetPaletteColors(panelAmmo[ammoType]->format->palette, canvas->format->palette->colors, 0, 256);
-		SDL_BlitSurface(panelAmmo[ammoType], &src, panel, &dst);
+	} else if (FTOI(energyBar) > (x << 4)) {
+
+		if (energyBar - (x << 14) < y) energyBar = x << 14;
+		else energyBar -= y;
 
 	}
 
-	dst.x = 0;
-	dst.y = canvasH - 33;
-	SDL_SetPaletteColors(panel->format->palette, canvas->format->palette->colors, 0, 256);
-	SDL_BlitSurface(panel, NULL, canvas, &dst);
-	drawRect(0, canvasH - 1, SW, 1, LEVEL_BLACK);
+	// Choose energy bar colour
+	if (x == 4) x = 24;
+	else if (x == 3) x = 17;
+	else if (x == 2) x = 80;
+	else if (x <= 1) x = 32 + (((ticks / 75) * 4) & 15);
 
 
-	// Show panel data
+	// Only compose the HUD again if something it shows has changed
 
-	// Show score
-	panelSmallFont->setPalette(palette);
-	panelSmallFont->showNumber(localPlayer->getScore(), 84, canvasH - 27);
+	if (endTime > ticks) y = (endTime - ticks) / 100;
+	else y = 0;
 
-	// Show time remaining
-	if (endTime > ticks) x = endTime - ticks;
-	else x = 0;
-	y = x / (60 * 1000);
-	panelSmallFont->showNumber(y, 116, canvasH - 27);
-	x -= (y * 60 * 1000);
-	y = x / 1000;
-	panelSmallFont->showNumber(y, 136, canvasH - 27);
-	x -= (y * 1000);
-	y = x / 100;
-	panelSmallFont->showNumber(y, 148, canvasH - 27);
+	hudChange[0] = ammoOffset;
+	hudChange[1] = localPlayer->getScore();
+	hudChange[2] = y;
+	hudChange[3] = localPlayer->getLives();
+	hudChange[4] = (localPlayer->getAmmoType() == -1)? -1: localPlayer->getAmmo();
+	hudChange[5] = (energyBar > F1)? FTOI(energyBar) - 1: 0;
+	hudChange[6] = x;
 
-	// Show lives
-	panelSmallFont->showNumber(localPlayer->getLives(), 124, canvasH - 13);
+	video.syncSurfacePalette(hud);
 
-	// Show planet number
+	if (memcmp(hudChange, hudState, sizeof(hudState))) {
 
+		memcpy(hudState, hudChange, sizeof(hudState));
 
-	if (worldNum <= 41) // Main game levels
-		panelSmallFont->showNumber((worldNum % 3) + 1, 184, canvasH - 13);
-	else if ((worldNum >= 50) && (worldNum <= 52)) // Christmas levels
-		panelSmallFont->showNumber(worldNum - 49, 184, canvasH - 13);
-	else panelSmallFont->showNumber(worldNum, 184, canvasH - 13);
+		if (ammoOffset != 0) {
 
-	// Show level number
-	panelSmallFont->showNumber(levelNum + 1, 196, canvasH - 13);
+			if (ammoOffset < 0) {
 
-	// Show ammo
-	if (localPlayer->getAmmoType() == -1) {
+				// Finished descending
+				ammoOffset = 0;
 
-		panelSmallFont->showString(":", 225, canvasH - 13);
-		panelSmallFont->showString(";", 233, canvasH - 13);
-		panelSmallFont->setPalette(palette);
+			}
 
-	} else {
+			src.x = 0;
+			src.y = FTOI(ammoOffset);
+			src.w = 64;
+			src.h = 26 - src.y;
+			dst.x = 248;
+			dst.y = 3;
+			video.syncSurfacePalette(panelAmmo[ammoType]);
+			SDL_BlitSurface(panelAmmo[ammoType], &src, panel, &dst);
 
-		x = localPlayer->getAmmo();
+		}
 
-		// Trailing 0s
-		if (x < 100) {
+		dst.x = 0;
+		dst.y = 0;
+		video.syncSurfacePalette(panel);
+		SDL_BlitSurface(panel, NULL, hud, &dst);
 
-			panelSmallFont->showNumber(0, 229, canvasH - 13);
-			if (x < 10) panelSmallFont->showNumber(0, 237, canvasH - 13);
+		/* The HUD's characters keep their palette indices, rather than being
+		matched to the colours currently shown, so the HUD stays correct as
+		palette effects change the display palette */
+		panelSmallFont->setPalette(canvas->format->palette->colors);
 
-		}
+		// Draw to the HUD in place of the canvas
+		target = canvas;
+		canvas = hud;
 
-		panelSmallFont->showNumber(x > 999? 999: x, 245, canvasH - 13);
+		drawRect(0, 32, SW, 1, LEVEL_BLACK);
 
-	}
 
+		// Show panel data
 
-	// Draw the health bar
+		// Show score
+		panelSmallFont->showNumber(localPlayer->getScore(), 84, 6);
 
-	dst.x = 20;
-	x = localPlayer->getJJ1LevelPlayer()->getEnergy();
-	y = (ticks - prevTicks) * 40;
+		// Show time remaining
+		if (endTime > ticks) remaining = endTime - ticks;
+		else remaining = 0;
+		y = remaining / (60 * 1000);
+		panelSmallFont->showNumber(y, 116, 6);
+		remaining -= (y * 60 * 1000);
+		y = remaining / 1000;
+		panelSmallFont->showNumber(y, 136, 6);
+		remaining -= (y * 1000);
+		y = remaining / 100;
+		panelSmallFont->showNumber(y, 148, 6);
 
-	if (FTOI(energyBar) < (x << 4)) {
+		// Show lives
+		panelSmallFont->showNumber(localPlayer->getLives(), 124, 20);
 
-		if ((x << 14) - energyBar < y) energyBar = x << 14;
-		else energyBar += y;
+		// Show planet number
 
-	} else if (FTOI(energyBar) > (x << 4)) {
 
-		if (energyBar - (x << 14) < y) energyBar = x << 14;
-		else energyBar -= y;
+		if (worldNum <= 41) // Main game levels
+			panelSmallFont->showNumber((worldNum % 3) + 1, 184, 20);
+		else if ((worldNum >= 50) && (worldNum <= 52)) // Christmas levels
+			panelSmallFont->showNumber(worldNum - 49, 184, 20);
+		else panelSmallFont->showNumber(worldNum, 184, 20);
 
-	}
+		// Show level number
+		panelSmallFont->showNumber(levelNum + 1, 196, 20);
 
-	if (energyBar > F1) {
+		// Show ammo
+		if (localPlayer->getAmmoType() == -1) {
 
-		dst.w = FTOI(energyBar) - 1;
+			panelSmallFont->showString(":", 225, 20);
+			panelSmallFont->showString(";", 233, 20);
 
-		// Choose energy bar colour
-		if (x == 4) x = 24;
-		else if (x == 3) x = 17;
-		else if (x == 2) x = 80;
-		else if (x <= 1) x = 32 + (((ticks / 75) * 4) & 15);
+		} else {
+
+			y = localPlayer->getAmmo();
 
-		// Draw energy bar
-		drawRect(dst.x, canvasH - 13, dst.w, 7, x);
+			// Trailing 0s
+			if (y < 100) {
 
-		dst.x += dst.w;
-		dst.w = 64 - dst.w;
+				panelSmallFont->showNumber(0, 229, 20);
+				if (y < 10) panelSmallFont->showNumber(0, 237, 20);
+
+			}
+
+			panelSmallFont->showNumber(y > 999? 999: y, 245, 20);
+
+		}
 
-	} else dst.w = 64;
 
+		// Draw the health bar
 
-	// Fill in remaining energy bar space with black
-	drawRect(dst.x, canvasH - 13, dst.w, 7, LEVEL_BLACK);
+		dst.x = 20;
+
+		if (energyBar > F1) {
+
+			dst.w = FTOI(energyBar) - 1;
+
+			// Draw energy bar
+			drawRect(dst.x, 20, dst.w, 7, x);
+
+			dst.x += dst.w;
+			dst.w = 64 - dst.w;
+
+		} else dst.w = 64;
+
+
+		// Fill in remaining energy bar space with black
+		drawRect(dst.x, 20, dst.w, 7, LEVEL_BLACK);
+
+		canvas = target;
+
+	}
+
+	dst.x = 0;
+	dst.y = canvasH - 33;
+	SDL_BlitSurface(hud, NULL, canvas, &dst);
 
 
 	return;
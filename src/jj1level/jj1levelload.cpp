@@ -30,15 +30,21 @@
 #include "jj1bullet.h"
 #include "jj1event/jj1event.h"
 #include "jj1level.h"
+#include "jj1levelplayer/jj1bird.h"
 #include "jj1levelplayer/jj1levelplayer.h"
 
 #include "game/game.h"
 #include "io/file.h"
+#include "io/gfx/blitter.h"
 #include "io/gfx/font.h"
 #include "io/gfx/sprite.h"
 #include "io/gfx/video.h"
+#include "io/loadprofile.h"
 #include "io/sound.h"
+#include "jobs.h"
 #include "loop.h"
+#include "memtrack.h"
+#include "pressure.h"
 #include "util.h"
 
 #include <string.h>
@@ -78,6 +84,11 @@ int JJ1Level::loadPanel () {
 	// Create the panel background
 	panel = createSurface(pixels, SW, 32);
 
+	// Create the surface the HUD is composed on, and make sure it is composed
+	// before it is first shown
+	hud = createSurface(NULL, SW, 33);
+	memset(hudState, 0xFF, sizeof(hudState));
+
 
 	// De-scramble the panel's ammo graphics
 
@@ -106,20 +117,23 @@ int JJ1Level::loadPanel () {
 
 
 /**
- * Load a sprite.
+ * Find a sprite's data, leaving it to be decoded later, and skip past it.
  *
  * @param file File from which to load the sprite data
- * @param sprite Sprite that will receive the loaded data
+ * @param load Sprite that will receive the sprite's data
  */
-void JJ1Level::loadSprite (File* file, Sprite* sprite) {
+void JJ1Level::indexSprite (File* file, JJ1SpriteLoad* load) {
 
-	unsigned char* pixels;
 	int pos, maskOffset;
-	int width, height;
+
+	// A sprite in the level's own file replaces one in mainchar.000
+	if (load->block) delete[] load->block;
+
+	load->block = NULL;
 
 	// Load dimensions
-	width = file->loadShort() << 2;
-	height = file->loadShort();
+	load->width = file->loadShort() << 2;
+	load->height = file->loadShort();
 
 	file->seek(2, false);
 
@@ -132,34 +146,79 @@ void JJ1Level::loadSprite (File* file, Sprite* sprite) {
 
 		// Masked
 
-		height++;
+		load->height++;
 
 		// Skip to mask
 		file->seek(maskOffset, false);
 
 		// Find the end of the data
-		pos += file->tell() + ((width >> 2) * height);
-
-		// Read scrambled, masked pixel data
-		pixels = file->loadPixels(width * height, SKEY);
-		sprite->setPixels(pixels, width, height, SKEY);
+		pos += file->tell() + ((load->width >> 2) * load->height);
 
-		delete[] pixels;
+		// Keep the scrambled, masked pixel data
+		load->masked = true;
+		load->length = pos - file->tell();
+		load->block = file->loadBlock(load->length);
 
 		file->seek(pos, true);
 
-	} else if (width) {
+	} else if (load->width) {
 
 		// Not masked
 
-		// Read scrambled pixel data
-		pixels = file->loadPixels(width * height);
-		sprite->setPixels(pixels, width, height, SKEY);
+		// Keep the scrambled pixel data
+		load->masked = false;
+		load->length = load->width * load->height;
+		load->block = file->loadBlock(load->length);
+
+	}
+
+
+	return;
+
+}
+
+
+/**
+ * Decode sprites until none are left. Each sprite's pixels are decoded
+ * independently of the others, so several jobs can share the work.
+ */
+void JJ1Level::decodeSprites () {
+
+	JJ1SpriteLoad* load;
+	File* file;
+	int count;
+
+	while ((count = SDL_AtomicAdd(&nextSpriteLoad, 1)) < sprites) {
+
+		load = spriteLoads + count;
+
+		if (!load->block) continue;
+
+		file = new File(load->block, load->length);
 
-		delete[] pixels;
+		// Read scrambled pixel data, masked or not
+		if (load->masked) load->pixels = file->loadPixels(load->width * load->height, SKEY);
+		else load->pixels = file->loadPixels(load->width * load->height);
+
+		delete file;
 
 	}
 
+	return;
+
+}
+
+
+/**
+ * Sprite decoding job.
+ *
+ * @param data The JJ1 level
+ */
+void JJ1Level::spriteJob (void* data) {
+
+	MEMORY_SCOPE(MEM_SPRITES);
+
+	((JJ1Level *)data)->decodeSprites();
 
 	return;
 
@@ -167,19 +226,21 @@ void JJ1Level::loadSprite (File* file, Sprite* sprite) {
 
 
 /**
- * Load sprites.
+ * Find the sprites, and start decoding them on the available cores. The
+ * level must call finishSprites() before the sprites are used.
  *
  * @param fileName Name of the file containing the level-specific sprites
  *
  * @return Error code
  */
-int JJ1Level::loadSprites (char * fileName) {
+int JJ1Level::startSprites (char * fileName) {
 
 	File* mainFile = NULL;
 	File* specFile = NULL;
 	unsigned char* buffer;
 	int count;
-	bool loaded;
+
+	MEMORY_SCOPE(MEM_SPRITES);
 
 
 	// Open fileName
@@ -212,13 +273,19 @@ int JJ1Level::loadSprites (char * fileName) {
 
 	// Include space in the sprite set for the blank sprite at the end
 	spriteSet = new Sprite[sprites + 1];
+	spriteLoads = new JJ1SpriteLoad[sprites];
 
 
 	// Read offsets
 	buffer = specFile->loadBlock(sprites * 2);
 
-	for (count = 0; count < sprites; count++)
+	for (count = 0; count < sprites; count++) {
+
 		spriteSet[count].setOffset(buffer[count] << 2, buffer[sprites + count]);
+		spriteLoads[count].block = NULL;
+		spriteLoads[count].pixels = NULL;
+
+	}
 
 	delete[] buffer;
 
@@ -227,11 +294,9 @@ int JJ1Level::loadSprites (char * fileName) {
 	mainFile->seek(2, true);
 
 
-	// Loop through all the sprites to be loaded
+	// Loop through all the sprites to be loaded, only finding their data
 	for (count = 0; count < sprites; count++) {
 
-		loaded = false;
-
 		if (mainFile->loadChar() == 0xFF) {
 
 			// Go to the next sprite/file indicator
@@ -242,10 +307,8 @@ int JJ1Level::loadSprites (char * fileName) {
 			// Return to the start of the sprite
 			mainFile->seek(-1, false);
 
-			// Load the individual sprite data
-			loadSprite(mainFile, spriteSet + count);
-
-			loaded = true;
+			// Find the individual sprite data
+			indexSprite(mainFile, spriteLoads + count);
 
 		}
 
@@ -259,58 +322,104 @@ int JJ1Level::loadSprites (char * fileName) {
 			// Return to the start of the sprite
 			specFile->seek(-1, false);
 
-			// Load the individual sprite data
-			loadSprite(specFile, spriteSet + count);
-
-			loaded = true;
+			// Find the individual sprite data
+			indexSprite(specFile, spriteLoads + count);
 
 		}
 
-		/* If both fileName and mainchar.000 have file indicators, create a
-		blank sprite */
-		if (!loaded) spriteSet[count].clearPixels();
-
 
 		// Check if the next sprite exists
-		// If not, create blank sprites for the remainder
-		if (specFile->tell() >= specFile->getSize()) {
+		// If not, the remainder are left blank
+		if (specFile->tell() >= specFile->getSize()) break;
 
-			for (count++; count < sprites; count++) {
+	}
 
-				spriteSet[count].clearPixels();
+	delete mainFile;
+	delete specFile;
 
-			}
 
-		}
+	// Decode the sprites while the rest of the level loads
+
+	SDL_AtomicSet(&nextSpriteLoad, 0);
+
+	jobs.prepare(&spritesDone, NULL, NULL, NULL, false);
+
+	for (count = 0; (count < SPRITE_JOBS) && (count < jobs.getWorkers()); count++) {
+
+		jobs.prepare(spriteJobs + count, spriteJob, this, &spritesDone, false);
+		jobs.submit(spriteJobs + count);
 
 	}
 
-	delete mainFile;
-	delete specFile;
+	jobs.submit(&spritesDone);
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Help decode the sprites, wait for them to be decoded, then give them their
+ * pixels. Surfaces share a palette, so are only created on this thread.
+ */
+void JJ1Level::finishSprites () {
+
+	int count;
+
+	MEMORY_SCOPE(MEM_SPRITES);
+
+	// Without worker threads, the sprites are decoded now
+	decodeSprites();
+
+	jobs.wait(&spritesDone);
+
+	for (count = 0; count < sprites; count++) {
+
+		/* If both fileName and mainchar.000 have file indicators, create a
+		blank sprite */
+		if (spriteLoads[count].pixels) {
+
+			spriteSet[count].setPixels(spriteLoads[count].pixels,
+				spriteLoads[count].width, spriteLoads[count].height, SKEY);
+
+			delete[] spriteLoads[count].pixels;
+
+		} else spriteSet[count].clearPixels();
+
+		if (spriteLoads[count].block) delete[] spriteLoads[count].block;
+
+	}
+
+	delete[] spriteLoads;
+	spriteLoads = NULL;
 
 
 	// Include a blank sprite at the end
 	spriteSet[sprites].clearPixels();
 
-	return E_NONE;
+	return;
 
 }
 
 
 /**
- * Load the tileset.
+ * Decode a tile set. Any thread may decode one, so its surface is left to be
+ * made when the main thread finishes it.
  *
  * @param fileName Name of the file containing the tileset
  *
- * @return The number of tiles loaded
+ * @return The tile set, or NULL if the file could not be opened
  */
-int JJ1Level::loadTiles (char* fileName) {
+JJ1TilesAsset* JJ1Level::decodeTiles (const char* fileName) {
 
+	JJ1TilesAsset* asset;
 	File* file;
 	unsigned char* buffer;
 	int rle, pos, index, count, fileSize;
 	int tiles;
 
+	MEMORY_SCOPE(MEM_TILES);
+
 
 	try {
 
@@ -318,17 +427,19 @@ int JJ1Level::loadTiles (char* fileName) {
 
 	} catch (int e) {
 
-		return e;
+		return NULL;
 
 	}
 
+	asset = new JJ1TilesAsset;
+
 
 	// Load the palette
-	file->loadPalette(palette);
+	file->loadPalette(asset->palette);
 
 
 	// Load the background palette
-	file->loadPalette(skyPalette);
+	file->loadPalette(asset->skyPalette);
 
 
 	// Skip the second, identical, background palette
@@ -385,17 +496,179 @@ int JJ1Level::loadTiles (char* fileName) {
 	// Should be a multiple of 60
 	tiles = pos >> 10;
 
-	tileSet = createSurface(buffer, TTOI(1), TTOI(tiles));
+	asset->pixels = buffer;
+	asset->tileSet = NULL;
+	asset->tileImages = createBlitImages(buffer, TTOI(1), tiles, 256, TKEY);
+	asset->tiles = tiles;
 
-	#ifdef SDL2
-	SDL_SetColorKey(tileSet, SDL_TRUE, TKEY);
-	#else
-	SDL_SetColorKey(tileSet, SDL_SRCCOLORKEY, TKEY);
-	#endif
+	return asset;
 
-	delete[] buffer;
+}
+
+
+/**
+ * Find the name of the tile set used by a level.
+ *
+ * @param file The level file
+ * @param levelNumber Receives the level's number
+ * @param worldNumber Receives the level's world number
+ *
+ * @return The name of the tile set's file
+ */
+static char* findTileSet (File* file, int* levelNumber, int* worldNumber) {
+
+	char* ext;
+	char* string;
+
+	// Skip past all level data
+	file->seek(39, true);
+	file->skipRLE();
+	file->skipRLE();
+	file->skipRLE();
+	file->skipRLE();
+	file->skipRLE();
+	file->skipRLE();
+	file->skipRLE();
+	file->skipRLE();
+	file->seek(598, false);
+	file->skipRLE();
+	file->seek(4, false);
+	file->skipRLE();
+	file->skipRLE();
+	file->seek(25, false);
+	file->skipRLE();
+	file->seek(3, false);
+
+	// Load the level number
+	*levelNumber = file->loadChar() ^ 210;
+
+	// Load the world number
+	*worldNumber = file->loadChar() ^ 4;
+
+	// Load tile set extension
+	file->seek(8, false);
+	ext = file->loadString();
+
+	// Create tile set file name
+	if (!strcmp(ext, "999")) string = createFileName("BLOCKS", *worldNumber);
+	else string = createFileName("BLOCKS", ext);
+
+	delete[] ext;
+
+	return string;
+
+}
+
+
+/**
+ * Find the name of the music file used by a level.
+ *
+ * @param file The level file
+ *
+ * @return The name of the music file
+ */
+static char* findMusic (File* file) {
+
+	int count;
+
+	// Skip past all level data
+	file->seek(39, true);
+
+	for (count = 0; count < 8; count++) file->skipRLE();
 
-	return tiles;
+	// Skip level block names and the sound map
+	file->seek(505, false);
+
+	return file->loadString();
+
+}
+
+
+/**
+ * Decode the tile set used by a level, if it is not already cached, and load
+ * the level's music. This is run in the background, by the asset cache's
+ * preloading thread.
+ *
+ * @param fileName Name of the level file
+ */
+void JJ1Level::preload (const char* fileName) {
+
+	JJ1TilesAsset* asset;
+	File* file;
+	char* string;
+	int levelNumber, worldNumber;
+
+	try {
+
+		file = new File(fileName, false);
+
+	} catch (int e) {
+
+		return;
+
+	}
+
+	string = findTileSet(file, &levelNumber, &worldNumber);
+
+	if (!assetCache.isCancelled() && !assetCache.contains(string)) {
+
+		asset = decodeTiles(string);
+
+		if (asset) {
+
+			assetCache.add(string, asset, (asset->tiles << 10) + (256 * sizeof(BlitImage)));
+			assetCache.release(asset);
+
+		}
+
+	}
+
+	delete[] string;
+
+	string = findMusic(file);
+
+	delete file;
+
+	if (!assetCache.isCancelled()) prefetchMusic(string);
+
+	delete[] string;
+
+	return;
+
+}
+
+
+/**
+ * Load the tileset.
+ *
+ * @param fileName Name of the file containing the tileset
+ *
+ * @return The number of tiles loaded
+ */
+int JJ1Level::loadTiles (char* fileName) {
+
+	// Use the tile set decoded for an earlier level, if possible
+	tilesAsset = (JJ1TilesAsset *)assetCache.find(fileName);
+
+	if (!tilesAsset) {
+
+		tilesAsset = decodeTiles(fileName);
+
+		if (!tilesAsset) return E_FILE;
+
+		tilesAsset->finish();
+
+		// Keep the tile set for later levels
+		assetCache.add(fileName, tilesAsset, (tilesAsset->tiles << 10) + (256 * sizeof(BlitImage)));
+
+	}
+
+	memcpy(palette, tilesAsset->palette, sizeof(palette));
+	memcpy(skyPalette, tilesAsset->skyPalette, sizeof(skyPalette));
+	tileSet = tilesAsset->tileSet;
+	tileImages = tilesAsset->tileImages;
+
+	return tilesAsset->tiles;
 
 }
 
@@ -416,10 +689,14 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 	unsigned char* buffer;
 	const char* ext;
 	char* string = NULL;
+	char name[FILE_NAME_LENGTH];
 	int tiles;
-	int count, x, y, type;
+	int count, x, y, type, pooled;
+	int nodes, node;
 	unsigned char startX, startY;
 
+	MEMORY_SCOPE(MEM_LEVEL);
+
 
 	// Load font
 
@@ -461,11 +738,11 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 		// Load the planet's name from the planet.### file
 
-		string = createFileName("PLANET", fileName + strlen(fileName) - 3);
+		writeFileName(name, FILE_NAME_LENGTH, "PLANET", fileName + strlen(fileName) - 3);
 
 		try {
 
-			file = new File(string, false);
+			file = new File(name, false);
 
 		} catch (int e) {
 
@@ -473,8 +750,6 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 		}
 
-		delete[] string;
-
 		if (file) {
 
 			file->seek(2, true);
@@ -533,6 +808,9 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 	if (::loop(NORMAL_LOOP) == E_QUIT) return E_QUIT;
 
+	// The tile set and music are decoded while the loading screen is shown
+	if (preloadAssets(preload, fileName) == E_QUIT) return E_QUIT;
+
 
 
 	// Open level file
@@ -552,79 +830,55 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 
 	// Load the blocks.### extension
+	string = findTileSet(file, &levelNum, &worldNum);
 
-	// Skip past all level data
-	file->seek(39, true);
-	file->skipRLE();
-	file->skipRLE();
-	file->skipRLE();
-	file->skipRLE();
-	file->skipRLE();
-	file->skipRLE();
-	file->skipRLE();
-	file->skipRLE();
-	file->seek(598, false);
-	file->skipRLE();
-	file->seek(4, false);
-	file->skipRLE();
-	file->skipRLE();
-	file->seek(25, false);
-	file->skipRLE();
-	file->seek(3, false);
 
-	// Load the level number
-	levelNum = file->loadChar() ^ 210;
+	// Load sprite set from corresponding Sprites.###, decoding it on other
+	// cores while the tile set and the level's own data are loaded
 
-	// Load the world number
-	worldNum = file->loadChar() ^ 4;
+	writeFileName(name, FILE_NAME_LENGTH, "SPRITES", worldNum);
 
+	LOAD_BEGIN("JJ1Level::startSprites");
+	count = startSprites(name);
+	LOAD_END();
 
-	// Load tile set from appropriate blocks.###
-
-	// Load tile set extension
-	file->seek(8, false);
-	ext = file->loadString();
-
-	// Create tile set file name
-	if (!strcmp(ext, "999")) string = createFileName("BLOCKS", worldNum);
-	else string = createFileName("BLOCKS", ext);
-
-	delete[] ext;
-
-	tiles = loadTiles(string);
-
-	delete[] string;
-
-	if (tiles < 0) {
+	if (count < 0) {
 
+		delete[] string;
 		delete file;
 		deletePanel();
 		delete font;
 
-		return tiles;
+		return count;
 
 	}
 
 
-	// Load sprite set from corresponding Sprites.###
-
-	string = createFileName("SPRITES", worldNum);
-
-	count = loadSprites(string);
+	LOAD_BEGIN("JJ1Level::loadTiles");
+	tiles = loadTiles(string);
+	LOAD_END();
 
 	delete[] string;
 
-	if (count < 0) {
+	if (tiles < 0) {
 
-		SDL_FreeSurface(tileSet);
+		finishSprites();
+		delete[] spriteSet;
 		delete file;
 		deletePanel();
 		delete font;
 
-		return count;
+		return tiles;
 
 	}
 
+#ifdef SDL2
+	// In true-colour mode, the tiles are expanded to the level's colours as
+	// they are first drawn
+	if (video.isTrueColour() && !headless)
+		expandedTiles = new ExpandedSet(tilesAsset->pixels, 1 << 10, tiles);
+#endif
+
 
 	// Skip to tile and event reference data
 	file->seek(39, true);
@@ -634,15 +888,21 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 	buffer = file->loadRLE(LW * LH * 2);
 
 	// Create grid from data
+	pooled = 0;
+
 	for (x = 0; x < LW; x++) {
 
 		for (y = 0; y < LH; y++) {
 
 			grid[y][x].tile = buffer[(y + (x * LH)) << 1];
-			grid[y][x].bg = buffer[((y + (x * LH)) << 1) + 1] >> 7;
 			grid[y][x].event = buffer[((y + (x * LH)) << 1) + 1] & 127;
-			grid[y][x].hits = 0;
-			grid[y][x].time = 0;
+			grid[y][x].flags = (buffer[((y + (x * LH)) << 1) + 1] & 128)? GF_BLACK: 0;
+
+			// Keep the grid as loaded, so that changes to it can be found
+			baseGrid[y][x][GV_TILE] = grid[y][x].tile;
+			baseGrid[y][x][GV_EVENT] = grid[y][x].event;
+
+			if (grid[y][x].event) pooled++;
 
 		}
 
@@ -650,6 +910,25 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 	delete[] buffer;
 
+	memset(eventHits, 0, sizeof(eventHits));
+	memset(eventTimes, 0, sizeof(eventTimes));
+
+	memset(gridChanges, 0, sizeof(gridChanges));
+	changedTop = LH;
+	changedBottom = -1;
+
+	// Size the pools from the number of events and players
+	JJ1Event::pool.setCapacity((pooled < EVENT_POOL)? pooled: EVENT_POOL);
+	JJ1Bullet::pool.setCapacity((nPlayers * PLAYER_BULLETS) + EVENT_BULLETS);
+	JJ1Bird::pool.setCapacity(nPlayers * PLAYER_BIRDS);
+
+	// Background chunks are rendered when first seen
+	for (y = 0; y < LH / CHUNK_H; y++) {
+
+		for (x = 0; x < LW / CHUNK_W; x++) chunks[y][x] = NULL;
+
+	}
+
 	// Ignore tile transparency settings (FIXME: needed for sun tiles at least)
 	file->skipRLE();
 
@@ -658,13 +937,21 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 	buffer = file->loadRLE(tiles * 8);
 
-	// Unpack bits
+	// Each row of a tile's mask is already packed into a byte
+	memcpy(mask, buffer, tiles << 3);
+
+	// Turn the rows around into columns, for finding floors and ceilings
+	memset(maskColumns, 0, sizeof(maskColumns));
+
 	for (count = 0; count < tiles; count++) {
 
 		for (y = 0; y < 8; y++) {
 
-			for (x = 0; x < 8; x++)
-				mask[count][(y << 3) + x] = (buffer[(count << 3) + y] >> x) & 1;
+			for (x = 0; x < 8; x++) {
+
+				if ((mask[count][y] >> x) & 1) maskColumns[count][x] |= 1 << y;
+
+			}
 
 		}
 
@@ -683,7 +970,7 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 			for (x = 0; x < 32; x++) {
 
-				if (mask[count][((y >> 2) << 3) + (x >> 2)] == 1)
+				if ((mask[count][y >> 2] >> (x >> 2)) & 1)
 					((char *)(tileSet->pixels))
 						[(count * 1024) + (y * 32) + x] = 88;
 
@@ -702,15 +989,24 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 	for (type = 0; type < PATHS; type++) {
 
-		path[type].length = buffer[type << 9] + (buffer[(type << 9) + 1] << 8);
-		if (path[type].length < 1) path[type].length = 1;
-		path[type].x = new short int[path[type].length];
-		path[type].y = new short int[path[type].length];
+		// Only the lowest byte of the number of nodes was ever used
+		nodes = buffer[type << 9];
+		if (nodes < 1) nodes = 1;
+
+		// Events move along a node every two steps
+		path[type].length = nodes << 1;
+		path[type].steps = (JJ1PathStep *)(arena.allocate(path[type].length * sizeof(JJ1PathStep)));
 
 		for (count = 0; count < path[type].length; count++) {
 
-			path[type].x[count] = ((signed char *)buffer)[(type << 9) + (count << 1) + 3] << 2;
-			path[type].y[count] = ((signed char *)buffer)[(type << 9) + (count << 1) + 2];
+			node = count >> 1;
+
+			path[type].steps[count].x = ITOF(((signed char *)buffer)[(type << 9) + (node << 1) + 3] << 2);
+			path[type].steps[count].y = ITOF(((signed char *)buffer)[(type << 9) + (node << 1) + 2]);
+
+			// Heading left unless right of the node three before
+			path[type].steps[count].left = (node < 3) ||
+				(path[type].steps[count].x <= path[type].steps[count - 6].x);
 
 		}
 
@@ -760,6 +1056,9 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 		for (y = 0; y < LH; y++) {
 
+			// Find how the tile is drawn, now that the event types are known
+			setFlags(x, y);
+
 			type = grid[y][x].event;
 
 			if (type) {
@@ -782,6 +1081,13 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 	file->skipRLE();
 
 
+	// The animations need the sprites
+
+	LOAD_BEGIN("JJ1Level::finishSprites");
+	finishSprites();
+	LOAD_END();
+
+
 	// Load animation set
 
 	buffer = file->loadRLE(ANIMS << 6);
@@ -809,6 +1115,10 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 	}
 
+	// Accessories are other animations in the set, so are found once they
+	// all have their data
+	for (count = 0; count < ANIMS; count++) animSet[count].setAccessory(animSet, ANIMS);
+
 	delete[] buffer;
 
 	// Skip (usually empty) animation names
@@ -835,6 +1145,10 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 	}
 
+	// The player's loops should neither layer nor be cut off by other sounds
+	setSoundLimit(S_INVULN, 1, 1);
+	setSoundLimit(S_UPLOOP, 1, 1);
+
 	file->seek(x + 288, true);
 
 	// Music file
@@ -934,6 +1248,7 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 	type = file->loadChar();
 
 	sky = false;
+	skyStrip = NULL;
 
 	switch (type) {
 
@@ -1050,12 +1365,17 @@ int JJ1Level::load (char* fileName, bool checkpoint) {
 
 
 	events = NULL;
+	memset(eventCells, 0, sizeof(eventCells));
+	eventReach = F32;
 	bullets = NULL;
 
 	energyBar = 0;
 	ammoType = 0;
 	ammoOffset = -1;
 
+	// Background tiles can be rendered again if memory runs short
+	chunksReliever = memoryPressure.add("background chunks", RP_RENDERED, relieveChunks, this, false);
+
 	return E_NONE;
 
 }
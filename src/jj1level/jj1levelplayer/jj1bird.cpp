@@ -28,6 +28,38 @@
 #include "jj1levelplayer.h"
 
 #include "io/gfx/video.h"
+#include "io/file.h"
+
+
+Pool JJ1Bird::pool("brd", sizeof(JJ1Bird));
+
+
+/**
+ * Allocate memory for a bird from the pool.
+ *
+ * @param size The size of the bird
+ *
+ * @return Memory for the bird
+ */
+void* JJ1Bird::operator new (size_t size) {
+
+	return pool.take(size);
+
+}
+
+
+/**
+ * Give a bird's memory back to the pool.
+ *
+ * @param bird The bird's memory
+ */
+void JJ1Bird::operator delete (void* bird) {
+
+	pool.give(bird);
+
+	return;
+
+}
 
 
 /**
@@ -151,6 +183,41 @@ JJ1Bird* JJ1Bird::setFlockSize (int size) {
 }
 
 
+/**
+ * Recursively write the birds to a file, the last first, so that they are in
+ * the same order once read back.
+ *
+ * @param file The file
+ */
+void JJ1Bird::save (File* file) {
+
+	if (next) next->save(file);
+
+	storePosition(file);
+	file->storeChar(fleeing);
+	file->storeInt(fireTime);
+
+	return;
+
+}
+
+
+/**
+ * Read the bird from a file, as written by save().
+ *
+ * @param file The file
+ */
+void JJ1Bird::load (File* file) {
+
+	loadPosition(file);
+	fleeing = file->loadChar();
+	fireTime = file->loadInt();
+
+	return;
+
+}
+
+
 /**
  * JJ1Bird iteration.
  *
@@ -161,12 +228,15 @@ JJ1Bird* JJ1Bird::setFlockSize (int size) {
 JJ1Bird* JJ1Bird::step (unsigned int ticks) {
 
 	Movable* leader;
-	JJ1Event* event;
+	JJ1Event* events[EQUERY];
+	int count, found;
 	bool target;
 
 	// Process the next bird
 	if (next) next = next->step(ticks);
 
+	savePosition();
+
 	if (next) leader = next;
 	else leader = player;
 
@@ -242,30 +312,13 @@ JJ1Bird* JJ1Bird::step (unsigned int ticks) {
 
 			// Check for nearby targets
 
-			target = false;
-			event = level->getEvents();
-
-			if (player->getFacing()) {
-
-				while (event && !target) {
-
-					target = event->isEnemy() && event->overlap(x, y, F160, F100);
-
-					event = event->getNext();
-
-				}
-
-			} else {
-
-				while (event && !target) {
-
-					target = event->isEnemy() && event->overlap(x - F160, y, F160, F100);
-
-					event = event->getNext();
+			if (player->getFacing()) found = level->findEvents(x, y, F160, F100, events);
+			else found = level->findEvents(x - F160, y, F160, F100, events);
 
-				}
+			target = false;
 
-			}
+			for (count = 0; (count < found) && !target; count++)
+				target = events[count]->isEnemy();
 
 			// If there is a target in the vicinity, generate bullets
 			if (target) {
@@ -300,18 +353,23 @@ JJ1Bird* JJ1Bird::step (unsigned int ticks) {
  * Draw the bird.
  *
  * @param ticks Time
- * @param change Time since last step
+ * @param alpha How far drawing is between the last step and the next, out of F1
  */
-void JJ1Bird::draw (unsigned int ticks, int change) {
+void JJ1Bird::draw (unsigned int ticks, fixed alpha) {
 
 	Anim *anim;
+	fixed drawX, drawY;
 
-	if (next) next->draw(ticks, change);
+	if (next) next->draw(ticks, alpha);
 
 	anim = level->getMiscAnim((player->getFacing() || fleeing)? MA_RBIRD: MA_LBIRD);
 	anim->setFrame(ticks / 80, true);
 
-	anim->draw(getDrawX(change), getDrawY(change));
+	drawX = getDrawX(alpha);
+	drawY = getDrawY(alpha);
+
+	if (isInView(drawX, drawY, ITOF(anim->getWidth()), ITOF(anim->getHeight())))
+		anim->draw(drawX, drawY);
 
 	return;
 
@@ -26,6 +26,7 @@
 
 
 #include "level/movable.h"
+#include "level/pool.h"
 #include "OpenJazz.h"
 
 
@@ -34,9 +35,13 @@
 // Time interval
 #define T_BIRD_FIRE 500
 
+// Pooled birds
+#define PLAYER_BIRDS 8 /* Per player */
+
 
 // Classes
 
+class File;
 class JJ1LevelPlayer;
 
 /// JJ1 bird companion
@@ -51,6 +56,11 @@ class JJ1Bird : public Movable {
 		JJ1Bird* remove ();
 
 	public:
+		static Pool pool; ///< Memory for birds
+
+		static void* operator new    (size_t size);
+		static void  operator delete (void* bird);
+
 		JJ1Bird  (JJ1Bird* birds, JJ1LevelPlayer* player, unsigned char gX, unsigned char gY);
 		~JJ1Bird ();
 
@@ -58,9 +68,11 @@ class JJ1Bird : public Movable {
 		JJ1LevelPlayer* getPlayer    ();
 		void            hit          ();
 		JJ1Bird*        setFlockSize (int size);
+		void            save         (File* file);
+		void            load         (File* file);
 
 		JJ1Bird*     step      (unsigned int ticks);
-		void         draw      (unsigned int ticks, int change);
+		void         draw      (unsigned int ticks, fixed alpha);
 
 };
 
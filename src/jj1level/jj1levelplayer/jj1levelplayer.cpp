@@ -34,6 +34,7 @@
 #include "jj1levelplayer.h"
 
 #include "game/game.h"
+#include "io/file.h"
 #include "io/sound.h"
 #include "setup.h"
 
@@ -399,6 +400,31 @@ bool JJ1LevelPlayer::overlap (fixed left, fixed top, fixed width, fixed height)
 }
 
 
+/**
+ * Determine whether or not the player overlapped the given area at the end of
+ * a recent step. If the player's position then is no longer known, the
+ * current position is used.
+ *
+ * @param left The x-coordinate of the left of the area
+ * @param top The y-coordinate of the top of the area
+ * @param width The width of the area
+ * @param height The height of the area
+ * @param step The step
+ *
+ * @return Whether or not there was an overlap
+ */
+bool JJ1LevelPlayer::overlapPast (fixed left, fixed top, fixed width, fixed height, unsigned int step) {
+
+	fixed stepX, stepY;
+
+	if (!getPastPosition(step, stepX, stepY)) return overlap(left, top, width, height);
+
+	return (stepX + PXO_R >= left) && (stepX + PXO_L < left + width) &&
+		(stepY >= top) && (stepY + PYO_TOP < top + height);
+
+}
+
+
 /**
  * Handle the player's reaction.
  *
@@ -911,8 +937,8 @@ void JJ1LevelPlayer::receive (unsigned char *buffer) {
 			facing = buffer[27];
 			jumpHeight = (buffer[29] << 24) + (buffer[30] << 16) + (buffer[31] << 8) + buffer[32];
 			targetY = (buffer[33] << 24) + (buffer[34] << 16) + (buffer[35] << 8) + buffer[36];
-			x = (buffer[37] << 24) + (buffer[38] << 16) + (buffer[39] << 8) + buffer[40];
-			y = (buffer[41] << 24) + (buffer[42] << 16) + (buffer[43] << 8) + buffer[44];
+			correctPosition((buffer[37] << 24) + (buffer[38] << 16) + (buffer[39] << 8) + buffer[40],
+				(buffer[41] << 24) + (buffer[42] << 16) + (buffer[43] << 8) + buffer[44]);
 
 			break;
 
@@ -922,3 +948,93 @@ void JJ1LevelPlayer::receive (unsigned char *buffer) {
 
 }
 
+
+/**
+ * Write the player's state in the level, and the player's birds, to a file.
+ *
+ * @param file The file
+ */
+void JJ1LevelPlayer::save (File* file) {
+
+	storePosition(file);
+	file->storeChar(energy);
+	file->storeChar(shield);
+	file->storeChar(flying);
+	file->storeChar(facing);
+	file->storeInt(udx);
+	file->storeChar(animType);
+	file->storeChar(eventX);
+	file->storeChar(eventY);
+	file->storeChar(eventType);
+	file->storeInt(lookTime);
+	file->storeChar(reaction);
+	file->storeInt(reactionTime);
+	file->storeInt(fireTime);
+	file->storeInt(fireAnimTime);
+	file->storeInt(jumpHeight);
+	file->storeInt(targetY);
+	file->storeInt(fastFeetTime);
+	file->storeChar(warpX);
+	file->storeChar(warpY);
+	file->storeInt(warpTime);
+	file->storeShort(enemies);
+	file->storeShort(items);
+	file->storeChar(gem);
+
+	file->storeShort(countBirds());
+	if (birds) birds->save(file);
+
+	return;
+
+}
+
+
+/**
+ * Read the player's state in the level, and the player's birds, from a file,
+ * as written by save().
+ *
+ * @param file The file
+ */
+void JJ1LevelPlayer::load (File* file) {
+
+	int count;
+
+	loadPosition(file);
+	energy = file->loadChar();
+	shield = file->loadChar();
+	flying = file->loadChar();
+	facing = file->loadChar();
+	udx = file->loadInt();
+	animType = file->loadChar();
+	eventX = file->loadChar();
+	eventY = file->loadChar();
+	eventType = JJ1PlayerEvent(file->loadChar());
+	lookTime = file->loadInt();
+	reaction = JJ1PlayerReaction(file->loadChar());
+	reactionTime = file->loadInt();
+	fireTime = file->loadInt();
+	fireAnimTime = file->loadInt();
+	jumpHeight = file->loadInt();
+	targetY = file->loadInt();
+	fastFeetTime = file->loadInt();
+	warpX = file->loadChar();
+	warpY = file->loadChar();
+	warpTime = file->loadInt();
+	enemies = file->loadShort();
+	items = file->loadShort();
+	gem = file->loadChar();
+
+	if (birds) delete birds;
+	birds = NULL;
+
+	for (count = file->loadShort(); count && (file->tell() < file->getSize()); count--) {
+
+		birds = new JJ1Bird(birds, this, 0, 0);
+		birds->load(file);
+
+	}
+
+	return;
+
+}
+
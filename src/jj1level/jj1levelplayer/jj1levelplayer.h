@@ -124,6 +124,7 @@ enum JJ1PlayerReaction {
 // Classes
 
 class Anim;
+class File;
 class JJ1Bird;
 
 /// JJ1 level player
@@ -180,6 +181,7 @@ class JJ1LevelPlayer : public LevelPlayer {
 		bool              hit         (Player* source, unsigned int ticks);
 		void              kill        (Player* source, unsigned int ticks);
 		bool              overlap     (fixed left, fixed top, fixed width, fixed height);
+		bool              overlapPast (fixed left, fixed top, fixed width, fixed height, unsigned int step);
 		JJ1PlayerReaction reacted     (unsigned int ticks);
 		void              setPlatform (unsigned char gridX, unsigned char gridY, fixed shiftX, fixed newY);
 		bool              takeEvent   (JJ1EventType* set, unsigned char gridX, unsigned char gridY, unsigned int ticks);
@@ -187,12 +189,14 @@ class JJ1LevelPlayer : public LevelPlayer {
 
 		void           send        (unsigned char* buffer);
 		void           receive     (unsigned char* buffer);
+		void           save        (File* file);
+		void           load        (File* file);
 
 		void           changeAmmo  (int type, bool fallback = false);
 		void           control     (unsigned int ticks);
 		void           move        (unsigned int ticks);
-		void           view        (unsigned int ticks, int mspf, int change);
-		void           draw        (unsigned int ticks, int change);
+		void           view        (unsigned int ticks, int mspf, fixed alpha);
+		void           draw        (unsigned int ticks, fixed alpha);
 
 };
 
@@ -35,6 +35,7 @@
 #include "jj1bird.h"
 #include "jj1levelplayer.h"
 
+#include "fixedmath.h"
 #include "io/controls.h"
 #include "io/gfx/font.h"
 #include "io/gfx/video.h"
@@ -129,6 +130,9 @@ void JJ1LevelPlayer::control (unsigned int ticks) {
 	int count;
 
 
+	// Remember where the player was, to draw them between steps
+	savePosition();
+
 	// If the player has been killed, drop but otherwise do not move
 	if (!energy) {
 
@@ -428,24 +432,15 @@ void JJ1LevelPlayer::control (unsigned int ticks) {
 
 			if (player->ammoType == 4) {
 
-				JJ1Event* event;
+				JJ1Event* events[EQUERY];
+				int count, found;
 
 				// TNT
 
-				event = level->getEvents();
-
-				while (event) {
-
-					// If the event is within range, hit it
-					if (event->overlap(x - F160, y - F100, 2 * F160, 2 * F100)) {
-
-						event->hit(this, 2, ticks);
-
-					}
-
-					event = event->getNext();
+				// Hit every event within range
+				found = level->findEvents(x - F160, y - F100, 2 * F160, 2 * F100, events);
 
-				}
+				for (count = 0; count < found; count++) events[count]->hit(this, 2, ticks);
 
 				// Red flash
 				level->flash(255, 0, 0, T_TNT);
@@ -536,7 +531,7 @@ void JJ1LevelPlayer::move (unsigned int ticks) {
 
 	fixed pdx, pdy;
 	bool grounded = false;
-	int count;
+	int count, distance;
 
 	if (warpTime && (ticks > warpTime)) {
 
@@ -574,19 +569,18 @@ void JJ1LevelPlayer::move (unsigned int ticks) {
 
 		count = (-pdy) >> 12;
 
-		while (count > 0) {
+		if (count > 0) {
+
+			// Rise to just below the first ceiling in the way
+			distance = level->findCeiling(x + PXO_ML + F1, x + PXO_MR - F1, y + PYO_TOP - F4, count - 1);
 
-			if (checkMaskUp(PYO_TOP - F4)) {
+			if (distance < count) {
 
+				y -= distance * F4;
 				y &= ~4095;
 				dy = 0;
 
-				break;
-
-			}
-
-			y -= F4;
-			count--;
+			} else y -= count * F4;
 
 		}
 
@@ -607,19 +601,18 @@ void JJ1LevelPlayer::move (unsigned int ticks) {
 
 			count = pdy >> 12;
 
-			while (count > 0) {
+			if (count > 0) {
+
+				// Fall to just above the first floor in the way
+				distance = level->findFloor(x + PXO_ML + F1, x + PXO_MR - F1, y + F4, count - 1);
 
-				if (checkMaskDown(F4)) {
+				if (distance < count) {
 
+					y += distance * F4;
 					y |= 4095;
 					dy = 0;
 
-					break;
-
-				}
-
-				y += F4;
-				count--;
+				} else y += count * F4;
 
 			}
 
@@ -665,6 +658,26 @@ void JJ1LevelPlayer::move (unsigned int ticks) {
 
 		count = (-pdx) >> 12;
 
+		if (!grounded && (count > 0)) {
+
+			// In the air, so go straight to the first obstacle in the way
+			distance = level->findWallLeft(x + PXO_L - F4, y + PYO_MID, count - 1);
+
+			if (distance < count) {
+
+				x -= distance * F4;
+				x &= ~4095;
+				dx = 0;
+
+				if (udx < -PXS_RUN) udx = -PXS_RUN;
+
+			} else x -= count * F4;
+
+			count = 0;
+
+		}
+
+		// On the ground, each step may follow a slope
 		while (count > 0) {
 
 			// If there is an obstacle, stop
@@ -682,7 +695,7 @@ void JJ1LevelPlayer::move (unsigned int ticks) {
 			x -= F4;
 			count--;
 
-			if (grounded) ground();
+			ground();
 
 		}
 
@@ -705,6 +718,26 @@ void JJ1LevelPlayer::move (unsigned int ticks) {
 
 		count = pdx >> 12;
 
+		if (!grounded && (count > 0)) {
+
+			// In the air, so go straight to the first obstacle in the way
+			distance = level->findWallRight(x + PXO_R + F4, y + PYO_MID, count - 1);
+
+			if (distance < count) {
+
+				x += distance * F4;
+				x |= 4095;
+				dx = 0;
+
+				if (udx > PXS_RUN) udx = PXS_RUN;
+
+			} else x += count * F4;
+
+			count = 0;
+
+		}
+
+		// On the ground, each step may follow a slope
 		while (count > 0) {
 
 			// If there is an obstacle, stop
@@ -722,7 +755,7 @@ void JJ1LevelPlayer::move (unsigned int ticks) {
 			x += F4;
 			count--;
 
-			if (grounded) ground();
+			ground();
 
 		}
 
@@ -835,9 +868,9 @@ void JJ1LevelPlayer::move (unsigned int ticks) {
  *
  * @param ticks Time
  * @param mspf Ticks per frame
- * @param change Time since last step
+ * @param alpha How far drawing is between the last step and the next, out of F1
  */
-void JJ1LevelPlayer::view (unsigned int ticks, int mspf, int change) {
+void JJ1LevelPlayer::view (unsigned int ticks, int mspf, fixed alpha) {
 
 	int oldViewX, oldViewY, speed;
 
@@ -847,8 +880,8 @@ void JJ1LevelPlayer::view (unsigned int ticks, int mspf, int change) {
 
 	// Find new position
 
-	viewX = x + ((dx * change) >> 10) + F8 - (canvasW << 9);
-	viewY = y + ((dy * change) >> 10) - F24 - ((canvasH - 33) << 9);
+	viewX = getInterpolatedX(alpha) + F8 - (canvasW << 9);
+	viewY = getInterpolatedY(alpha) - F24 - ((canvasH - 33) << 9);
 
 	if ((lookTime > 0) && ((int)ticks > 1000 + lookTime)) {
 
@@ -884,15 +917,16 @@ void JJ1LevelPlayer::view (unsigned int ticks, int mspf, int change) {
  * Draw the player.
  *
  * @param ticks Time
- * @param change Time since last step
+ * @param alpha How far drawing is between the last step and the next, out of F1
  */
-void JJ1LevelPlayer::draw (unsigned int ticks, int change) {
+void JJ1LevelPlayer::draw (unsigned int ticks, fixed alpha) {
 
 	Anim *an;
 	int frame;
 	fixed drawX, drawY;
 	fixed xOffset, yOffset;
 	fixed angle;
+	bool flashed;
 
 	// The current frame for animations
 	if (reaction == PR_KILLED) frame = (ticks + PRT_KILLED - reactionTime) / 75;
@@ -901,8 +935,8 @@ void JJ1LevelPlayer::draw (unsigned int ticks, int change) {
 
 	// Get position
 
-	drawX = getDrawX(change);
-	drawY = getDrawY(change);
+	drawX = getDrawX(alpha);
+	drawY = getDrawY(alpha);
 
 
 	// Choose sprite
@@ -914,10 +948,9 @@ void JJ1LevelPlayer::draw (unsigned int ticks, int change) {
 	// Show the player
 
 	// Flash red if hurt, otherwise use player colour
-	if ((reaction == PR_HURT) && (!((ticks / 30) & 3)))
-		an->flashPalette(36);
+	flashed = (reaction == PR_HURT) && (!((ticks / 30) & 3));
 
-	else {
+	if (!flashed) {
 
 		an->setPalette(palette, 23, 41);
 		an->setPalette(palette, 88, 8);
@@ -926,14 +959,20 @@ void JJ1LevelPlayer::draw (unsigned int ticks, int change) {
 
 
 	// Draw "motion blur"
-	if (fastFeetTime > ticks) an->draw(drawX - (dx >> 6), drawY);
+	if (fastFeetTime > ticks) {
+
+		if (flashed) an->drawFlashed(drawX - (dx >> 6), drawY, 36);
+		else an->draw(drawX - (dx >> 6), drawY);
+
+	}
 
 	// Draw player
-	an->draw(drawX, drawY);
+	if (flashed) an->drawFlashed(drawX, drawY, 36);
+	else an->draw(drawX, drawY);
 
 
-	// Remove red flash or player colour from sprite
-	an->restorePalette();
+	// Remove player colour from sprite
+	if (!flashed) an->restorePalette();
 
 
 	// Uncomment the following to see the area of the player
@@ -1046,7 +1085,7 @@ void JJ1LevelPlayer::draw (unsigned int ticks, int change) {
 
 
 	// Show the bird
-	if (birds) birds->draw(ticks, change);
+	if (birds) birds->draw(ticks, alpha);
 
 
 	// Show the player's name
@@ -0,0 +1,300 @@
+/**
+ *
+ * @file jj1levelstate.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created jj1levelstate.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Writes the state of a level as it is being played to a file, and reads it
+ * back. Grid elements are written where they differ from the level as loaded,
+ * then the players, events and bullets.
+ *
+ */
+
+
+#include "jj1bullet.h"
+#include "jj1event/jj1event.h"
+#include "jj1event/jj1guardians.h"
+#include "jj1level.h"
+#include "jj1levelplayer/jj1levelplayer.h"
+
+#include "io/file.h"
+#include "player/player.h"
+
+#include <string.h>
+
+
+/**
+ * Write the state of the level to a file.
+ *
+ * @param file The file
+ *
+ * @return Whether or not the state was written
+ */
+bool JJ1Level::writeState (File* file) {
+
+	JJ1Event* event;
+	JJ1Bullet* bullet;
+	int count, x, y, variable, value, length;
+
+	file->storeChar(LT_JJ1);
+	file->storeShort(worldNum);
+	file->storeChar(levelNum);
+	file->storeShort(nextWorldNum);
+	file->storeChar(nextLevelNum);
+
+
+	// Runs of grid elements in the same row sharing the same value, each
+	// giving the row, the first element, the variable, the number of elements
+	// and their value, ending with a row beyond the grid
+
+	for (y = 0; y < LH; y++) {
+
+		for (variable = GV_TILE; variable <= GV_HITS; variable++) {
+
+			for (x = 0; x < LW; x += length) {
+
+				value = getGridValue(x, y, variable, false);
+				length = 1;
+
+				if (value == getGridValue(x, y, variable, true)) continue;
+
+				while ((x + length < LW) && (length < 255) &&
+					(getGridValue(x + length, y, variable, false) == value) &&
+					(getGridValue(x + length, y, variable, true) != value)) length++;
+
+				file->storeChar(y);
+				file->storeChar(x);
+				file->storeChar(variable);
+				file->storeChar(length);
+				file->storeChar(value);
+
+			}
+
+		}
+
+	}
+
+	file->storeChar(LH);
+
+
+	// Grid elements whose events will do something, ending the same way
+
+	for (y = 0; y < LH; y++) {
+
+		for (x = 0; x < LW; x++) {
+
+			if (!eventTimes[y][x]) continue;
+
+			file->storeChar(y);
+			file->storeChar(x);
+			file->storeInt(eventTimes[y][x]);
+
+		}
+
+	}
+
+	file->storeChar(LH);
+
+
+	file->storeShort(enemies);
+	file->storeShort(items);
+	file->storeInt(waterLevel);
+	file->storeInt(waterLevelTarget);
+	file->storeInt(waterLevelSpeed);
+
+	for (count = 0; count < nPlayers; count++) {
+
+		players[count].save(file);
+		players[count].getJJ1LevelPlayer()->save(file);
+
+	}
+
+	count = 0;
+
+	for (event = events; event; event = event->getNext()) count++;
+
+	file->storeShort(count);
+	if (events) events->save(file);
+
+	count = 0;
+
+	for (bullet = bullets; bullet; bullet = bullet->getNext()) count++;
+
+	file->storeShort(count);
+	if (bullets) bullets->save(file);
+
+	return true;
+
+}
+
+
+/**
+ * Read the state of the level from a file, if it is of this level.
+ *
+ * @param file The file
+ *
+ * @return Whether or not the state was read
+ */
+bool JJ1Level::readState (File* file) {
+
+	int count, source, type, direction, x, y, variable, value, length;
+
+	if ((file->loadChar() != LT_JJ1) || (file->loadShort() != worldNum) ||
+		(file->loadChar() != levelNum)) return false;
+
+	nextWorldNum = file->loadShort();
+	nextLevelNum = file->loadChar();
+
+
+	// Start again from the grid as loaded
+
+	for (y = 0; y < LH; y++) {
+
+		for (x = 0; x < LW; x++) {
+
+			grid[y][x].tile = baseGrid[y][x][GV_TILE];
+			grid[y][x].event = baseGrid[y][x][GV_EVENT];
+
+		}
+
+	}
+
+	memset(eventHits, 0, sizeof(eventHits));
+	memset(eventTimes, 0, sizeof(eventTimes));
+
+	memset(gridChanges, 0, sizeof(gridChanges));
+	changedTop = LH;
+	changedBottom = -1;
+
+	while ((y = file->loadChar()) < LH) {
+
+		x = file->loadChar();
+		variable = file->loadChar();
+		length = file->loadChar();
+		value = file->loadChar();
+
+		for (; length && (x < LW); x++, length--) {
+
+			if (variable == GV_TILE) grid[y][x].tile = value;
+			else if ((variable == GV_EVENT) && (value < EVENTS)) grid[y][x].event = value;
+			else if (variable == GV_HITS) eventHits[y][x] = value;
+
+		}
+
+	}
+
+	for (y = 0; y < LH; y++) {
+
+		for (x = 0; x < LW; x++) setFlags(x, y);
+
+	}
+
+	while ((y = file->loadChar()) < LH) {
+
+		x = file->loadChar();
+		eventTimes[y][x] = file->loadInt();
+
+	}
+
+
+	enemies = file->loadShort();
+	items = file->loadShort();
+	waterLevel = file->loadInt();
+	waterLevelTarget = file->loadInt();
+	waterLevelSpeed = file->loadInt();
+
+	for (count = 0; count < nPlayers; count++) {
+
+		players[count].load(file);
+		players[count].getJJ1LevelPlayer()->load(file);
+
+	}
+
+
+	// Create the events and bullets again from their kinds and types, then
+	// read the rest of each
+
+	if (events) delete events;
+	events = NULL;
+	memset(eventCells, 0, sizeof(eventCells));
+
+	for (count = file->loadShort(); count && (file->tell() < file->getSize()); count--) {
+
+		type = file->loadChar();
+		x = file->loadChar();
+		y = file->loadChar();
+		value = file->loadChar();
+
+		if ((x >= LW) || (y >= LH) || !value || (value >= EVENTS)) return false;
+
+		// Bridges and guardians take their type from the grid
+		if ((type != JJ1EK_STANDARD) && !getEvent(x, y)) return false;
+
+		switch (type) {
+
+			case JJ1EK_STANDARD:
+
+				events = new JJ1StandardEvent(eventSet + value, x, y, TTOF(x), TTOF(y + 1));
+
+				break;
+
+			case JJ1EK_BRIDGE:
+
+				events = new JJ1Bridge(x, y);
+
+				break;
+
+			case JJ1EK_DECKGUARDIAN:
+
+				events = new DeckGuardian(x, y);
+
+				break;
+
+			case JJ1EK_MEDGUARDIAN:
+
+				events = new MedGuardian(x, y);
+
+				break;
+
+			default:
+
+				return false;
+
+		}
+
+		events->load(file);
+
+	}
+
+	if (bullets) delete bullets;
+	bullets = NULL;
+
+	for (count = file->loadShort(); count && (file->tell() < file->getSize()); count--) {
+
+		source = file->loadChar();
+		type = file->loadChar();
+		direction = file->loadChar();
+
+		if (((source >= nPlayers) && (source != 255)) || (type >= BULLETS) ||
+			(direction > 3)) return false;
+
+		bullets = new JJ1Bullet(bullets,
+			(source == 255)? NULL: players[source].getJJ1LevelPlayer(), 0, 0,
+			bulletSet[type], direction, 0);
+		bullets->load(file);
+
+	}
+
+	return true;
+
+}
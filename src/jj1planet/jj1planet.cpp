@@ -31,6 +31,7 @@
 #include "io/gfx/video.h"
 #include "io/sound.h"
 #include "loop.h"
+#include "pacer.h"
 #include "util.h"
 
 #include <string.h>
@@ -143,7 +144,7 @@ int JJ1Planet::play () {
 
 		if (controls.release(C_ESCAPE) || controls.wasCursorReleased()) return E_NONE;
 
-		SDL_Delay(T_MENU_FRAME);
+		pacer.idle(false);
 
 		video.clearScreen(0);
 
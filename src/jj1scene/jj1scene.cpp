@@ -30,8 +30,11 @@
 #include "io/gfx/font.h"
 #include "io/gfx/paletteeffects.h"
 #include "io/gfx/video.h"
+#include "io/loadprofile.h"
 #include "io/sound.h"
 #include "loop.h"
+#include "memtrack.h"
+#include "pacer.h"
 #include "util.h"
 
 #include <string.h>
@@ -48,6 +51,8 @@ JJ1SceneFrame::JJ1SceneFrame(int newFrameType, unsigned char* newFrameData, int
 
 	soundId = 0;
 	frameData = newFrameData;
+	keyframe = NULL;
+	index = 0;
 	frameType = newFrameType;
 	frameSize = newFrameSize;
 	prev = NULL;
@@ -62,6 +67,7 @@ JJ1SceneFrame::JJ1SceneFrame(int newFrameType, unsigned char* newFrameData, int
 JJ1SceneFrame::~JJ1SceneFrame() {
 
 	delete [] frameData;
+	if (keyframe) delete[] keyframe;
 
 }
 
@@ -89,6 +95,7 @@ void JJ1SceneAnimation::addFrame(int frameType, unsigned char* frameData, int fr
 	}
 
 	lastFrame = frame;
+	frame->index = frames;
 	frames++;
 
 }
@@ -103,10 +110,12 @@ JJ1SceneAnimation::JJ1SceneAnimation  (JJ1SceneAnimation* newNext) {
 
 	next = newNext;
 	background = NULL;
+	firstPicture = NULL;
 	lastFrame = NULL;
 	sceneFrames = NULL;
 	frames = 0;
 	reverseAnimation = 0;
+	keyframeMemory = 0;
 
 }
 
@@ -130,7 +139,8 @@ JJ1SceneAnimation::~JJ1SceneAnimation () {
 			}
 		}
 
-	if (background) SDL_FreeSurface(background);
+	if (background) freeSurface(background);
+	if (firstPicture) delete[] firstPicture;
 
 }
 
@@ -155,7 +165,7 @@ JJ1SceneImage::~JJ1SceneImage () {
 
 	if (next) delete next;
 
-	if (image) SDL_FreeSurface(image);
+	if (image) freeSurface(image);
 
 }
 
@@ -194,6 +204,9 @@ JJ1SceneText::JJ1SceneText() {
 		extraLineHeight = -1;
 		text = NULL;
 		shadowColour = 0;
+		font = NULL;
+		layoutX = 0;
+		layoutY = 0;
 
 }
 
@@ -222,6 +235,7 @@ JJ1ScenePage::JJ1ScenePage() {
 	stopMusic = 0;
 	animIndex = -1; // no anim
 	backgroundFade = 255;
+	laidOut = false;
 }
 
 
@@ -242,9 +256,10 @@ JJ1ScenePage::~JJ1ScenePage() {
  */
 JJ1Scene::JJ1Scene (const char * fileName) {
 
-	File *file;
     int loop;
 
+	MEMORY_SCOPE(MEM_SCENE);
+
     nFonts = 0;
     LOG("\nScene", fileName);
 
@@ -261,6 +276,10 @@ JJ1Scene::JJ1Scene (const char * fileName) {
 	images = NULL;
 	palettes = NULL;
 	animations = NULL;
+	lookingAhead = false;
+	imageLock = SDL_CreateMutex();
+	pageSurface = NULL;
+	composedPage = -1;
 
 	file->seek(0x13, true); // Skip Digital Dimensions header
 	signed long int dataOffset = file->loadInt(); //get offset pointer to first data block
@@ -291,12 +310,15 @@ JJ1Scene::JJ1Scene (const char * fileName) {
 
 	}
 
+	LOAD_BEGIN("JJ1Scene::load");
 	loadData(file);
 	loadScripts(file);
+	LOAD_END();
 
 	delete[] scriptStarts;
 	delete[] dataOffsets;
-	delete file;
+
+	// The file stays open, for images to be decoded from as they are needed
 
 	return;
 
@@ -308,6 +330,12 @@ JJ1Scene::JJ1Scene (const char * fileName) {
  */
 JJ1Scene::~JJ1Scene () {
 
+	if (lookingAhead) jobs.wait(&lookaheadJob);
+	if (imageLock) SDL_DestroyMutex(imageLock);
+	if (pageSurface) freeSurface(pageSurface);
+
+	delete file;
+
 	delete[] pages;
 
 	if (images) delete images;
@@ -317,6 +345,344 @@ JJ1Scene::~JJ1Scene () {
 }
 
 
+/**
+ * Get a background image, decoding it if it has not been used before.
+ *
+ * @param id The image's data index
+ *
+ * @return The image, or NULL if there is no such image
+ */
+SDL_Surface* JJ1Scene::getImage (int id) {
+
+	JJ1SceneImage* image;
+	SDL_Surface* surface;
+
+	if (imageLock) SDL_LockMutex(imageLock);
+
+	image = images;
+
+	while (image && (image->id != id)) image = image->next;
+
+	if (image) {
+
+		if (!image->image) {
+
+			file->seek(image->offset, true);
+			image->image = file->loadSurface(image->width, image->height);
+
+		}
+
+		surface = image->image;
+
+	} else surface = NULL;
+
+	if (imageLock) SDL_UnlockMutex(imageLock);
+
+	return surface;
+
+}
+
+
+/**
+ * Apply an animation frame to the animation's picture. Every
+ * SCENE_KEYFRAME_INTERVAL frames, the resulting picture is kept as a keyframe,
+ * while the animation's keyframe budget allows.
+ *
+ * @param animation The animation
+ * @param frame The frame to apply
+ */
+void JJ1Scene::applyFrame (JJ1SceneAnimation* animation, JJ1SceneFrame* frame) {
+
+	unsigned char* pixels;
+
+	if (SDL_MUSTLOCK(animation->background)) SDL_LockSurface(animation->background);
+
+	pixels = (unsigned char *)(animation->background->pixels);
+
+	switch (frame->frameType) {
+
+		case ESquareAniHeader:
+
+			loadCompactedMem(frame->frameSize, frame->frameData, pixels);
+
+			break;
+
+		case EFFAniHeader:
+
+			loadFFMem(frame->frameSize, frame->frameData, pixels);
+
+			break;
+
+		default:
+
+			LOG("Scene::Play unknown type", frame->frameType);
+
+			break;
+
+	}
+
+	if (!frame->keyframe && ((frame->index % SCENE_KEYFRAME_INTERVAL) == SCENE_KEYFRAME_INTERVAL - 1) &&
+		(animation->keyframeMemory + (SW * SH) <= SCENE_KEYFRAME_BUDGET)) {
+
+		frame->keyframe = new unsigned char[SW * SH];
+		memcpy(frame->keyframe, pixels, SW * SH);
+		animation->keyframeMemory += SW * SH;
+
+	}
+
+	if (SDL_MUSTLOCK(animation->background)) SDL_UnlockSurface(animation->background);
+
+	return;
+
+}
+
+
+/**
+ * Bring an animation's picture to the state just before the given frame,
+ * starting from the nearest earlier keyframe.
+ *
+ * @param animation The animation
+ * @param frame The index of the frame
+ *
+ * @return The given frame, or NULL if the animation has no such frame
+ */
+JJ1SceneFrame* JJ1Scene::seekAnimation (JJ1SceneAnimation* animation, int frame) {
+
+	JJ1SceneFrame* sceneFrame;
+	JJ1SceneFrame* keyframe;
+
+	if (SDL_MUSTLOCK(animation->background)) SDL_LockSurface(animation->background);
+
+	// The picture is only known to be at the start on the first playthrough
+	if (!animation->firstPicture) {
+
+		animation->firstPicture = new unsigned char[SW * SH];
+		memcpy(animation->firstPicture, animation->background->pixels, SW * SH);
+
+	}
+
+	// Find the last keyframe before the frame
+	keyframe = NULL;
+
+	for (sceneFrame = animation->sceneFrames; sceneFrame && (sceneFrame->index < frame); sceneFrame = sceneFrame->next) {
+
+		if (sceneFrame->keyframe) keyframe = sceneFrame;
+
+	}
+
+	if (keyframe) memcpy(animation->background->pixels, keyframe->keyframe, SW * SH);
+	else memcpy(animation->background->pixels, animation->firstPicture, SW * SH);
+
+	if (SDL_MUSTLOCK(animation->background)) SDL_UnlockSurface(animation->background);
+
+	// Apply the frames between the keyframe and the frame
+	sceneFrame = keyframe? keyframe->next: animation->sceneFrames;
+
+	while (sceneFrame && (sceneFrame->index < frame)) {
+
+		applyFrame(animation, sceneFrame);
+		sceneFrame = sceneFrame->next;
+
+	}
+
+	return sceneFrame;
+
+}
+
+
+/**
+ * Image lookahead job. Decodes the images of the page after the one being
+ * shown.
+ *
+ * @param data The JJ1 cutscene
+ */
+void JJ1Scene::lookahead (void* data) {
+
+	JJ1Scene* scene;
+	JJ1ScenePage* page;
+	int bg;
+
+	scene = (JJ1Scene *)data;
+	page = scene->pages + scene->lookaheadPage;
+
+	for (bg = 0; bg < page->backgrounds; bg++) scene->getImage(page->bgIndex[bg]);
+
+	return;
+
+}
+
+
+/**
+ * Find the font and position of each of a page's texts, which stay the same
+ * for as long as the page is shown.
+ *
+ * @param page The page
+ */
+void JJ1Scene::layOutPage (JJ1ScenePage* page) {
+
+	JJ1SceneText* text;
+	SDL_Rect textRect = {0, 0, SW, SH};
+	int count, index, x, y, extraLineHeight;
+
+	x = 0;
+	y = 0;
+	extraLineHeight = 0;
+
+	for (count = 0; count < page->nTexts; count++) {
+
+		text = page->texts + count;
+		text->font = NULL;
+
+		for (index = 0; index < nFonts; index++) {
+
+			if (text->fontId == fonts[index].id) text->font = fonts[index].font;
+
+		}
+
+		if (text->x != -1) {
+
+			x = text->x;
+			y = text->y;
+
+		}
+
+		if (text->textRect.x != -1) {
+
+			textRect = text->textRect;
+			x = 0;
+			y = 0;
+
+		}
+
+		if (text->extraLineHeight != -1) {
+
+			extraLineHeight = text->extraLineHeight;
+
+		}
+
+		// Texts in fonts the scene does not define are not drawn
+		if (!text->font) continue;
+
+		text->layoutX = textRect.x + x;
+		text->layoutY = textRect.y + y;
+
+		switch (text->alignment) {
+
+			case 0: // left
+
+				break;
+
+			case 1: // right
+
+				text->layoutX += textRect.w - text->font->getSceneStringWidth(text->text);
+
+				break;
+
+			case 2: // center
+
+				text->layoutX += (textRect.w - text->font->getSceneStringWidth(text->text)) >> 1;
+
+				break;
+
+		}
+
+		y += extraLineHeight + text->font->getHeight() / 2;
+
+	}
+
+	page->laidOut = true;
+
+	return;
+
+}
+
+
+/**
+ * Draw a page's texts, with their drop shadows.
+ *
+ * @param page The page, which must have been laid out
+ * @param x The x-coordinate of the scene's top-left corner
+ * @param y The y-coordinate of the scene's top-left corner
+ */
+void JJ1Scene::drawTexts (JJ1ScenePage* page, int x, int y) {
+
+	JJ1SceneText* text;
+	int count;
+
+	for (count = 0; count < page->nTexts; count++) {
+
+		text = page->texts + count;
+
+		if (!text->font) continue;
+
+		// Drop shadow
+		text->font->mapPalette(0, 256, 0, 1);
+		text->font->showSceneString(text->text, x + text->layoutX + 1, y + text->layoutY + 1);
+		text->font->setPalette(canvas->format->palette->colors);
+
+		// Text itself
+		text->font->showSceneString(text->text, x + text->layoutX, y + text->layoutY);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Draw a page without an animation, its backgrounds and texts, on the page
+ * surface. Nothing on such a page moves, so each of its frames is just a copy
+ * of the page surface.
+ *
+ * @param index The page's position in the scene
+ */
+void JJ1Scene::composePage (int index) {
+
+	JJ1ScenePage* page;
+	SDL_Surface* screen;
+	SDL_Surface* image;
+	SDL_Rect dst;
+	int bg;
+
+	page = pages + index;
+
+	if (!page->laidOut) layOutPage(page);
+
+	if (!pageSurface) pageSurface = createSurface(NULL, SW, SH);
+
+	video.syncSurfacePalette(pageSurface);
+	SDL_FillRect(pageSurface, NULL, 0);
+
+	// The fonts draw to the canvas, so the page surface stands in for it
+	screen = canvas;
+	canvas = pageSurface;
+
+	for (bg = 0; bg < page->backgrounds; bg++) {
+
+		image = getImage(page->bgIndex[bg]);
+
+		if (image) {
+
+			dst.x = page->bgX[bg];
+			dst.y = page->bgY[bg];
+			video.syncSurfacePalette(image);
+			SDL_BlitSurface(image, NULL, pageSurface, &dst);
+
+		}
+
+	}
+
+	drawTexts(page, 0, 0);
+
+	canvas = screen;
+	composedPage = index;
+
+	return;
+
+}
+
+
 /**
  * Play the JJ1 cutscene.
  *
@@ -326,7 +692,6 @@ int JJ1Scene::play () {
 
 	SDL_Rect dst;
 	unsigned int sceneIndex = 0;
-	JJ1SceneImage *image;
 	JJ1SceneAnimation* animation = NULL;
 	JJ1SceneFrame* currentFrame = NULL;
 	PaletteEffect* paletteEffect = NULL;
@@ -337,7 +702,6 @@ int JJ1Scene::play () {
 	unsigned int pageTime = pages[sceneIndex].pageTime;
 	unsigned int lastTicks = globalTicks;
 	int newpage = true;
-	SDL_Rect textRect = {0, 0, SW, SH};
 
 	video.clearScreen(0);
 
@@ -372,7 +736,7 @@ int JJ1Scene::play () {
 
 		}
 
-		SDL_Delay(T_MENU_FRAME);
+		pacer.idle(false);
 
 
 		if(pages[sceneIndex].askForYesNo) {
@@ -414,10 +778,6 @@ int JJ1Scene::play () {
 			//if (paletteEffect) delete paletteEffect;
 			//paletteEffect = new FadeOutPaletteEffect(250, NULL);
 
-			textRect.x = 0;
-			textRect.y = 0;
-			textRect.w = SW;
-			textRect.h = SH;
 			JJ1ScenePalette *palette = palettes;
 
 			while (palette && (palette->id != pages[sceneIndex].paletteIndex)) palette = palette->next;
@@ -436,192 +796,100 @@ int JJ1Scene::play () {
 				playMusic(pages[sceneIndex].musicFile);
 			}
 
-			newpage = 0;
-
-		}
+			// Decode the next page's images while this page is shown
+			if (lookingAhead) jobs.wait(&lookaheadJob);
+			lookingAhead = false;
 
-		// First draw the backgrounds associated with this page
-		if (pages[sceneIndex].backgrounds > 0) {
+			// Without worker threads, images are decoded when first shown
+			if (imageLock && jobs.getWorkers() && (sceneIndex + 1 < scriptItems)) {
 
-			for (int bg = 0; bg < pages[sceneIndex].backgrounds; bg++) {
-
-				image = images;
-
-				while (image && (image->id != pages[sceneIndex].bgIndex[bg]))
-					image = image->next;
-
-				if (image) {
-
-					dst.x = pages[sceneIndex].bgX[bg] + ((canvasW - SW) >> 1);
-					dst.y = pages[sceneIndex].bgY[bg] + ((canvasH - SH) >> 1);
-					SDL_SetPaletteColors(image->image->format->palette, canvas->format->palette->colors, 0, 256);
-					SDL_BlitSurface(image->image, NULL, canvas, &dst);
-
-				}
+				lookaheadPage = sceneIndex + 1;
+				jobs.prepare(&lookaheadJob, lookahead, this, NULL, true);
+				jobs.submit(&lookaheadJob);
+				lookingAhead = true;
 
 			}
 
-		} else if (pages[sceneIndex].animIndex != -1) {
-
-			if (currentFrame == NULL) {
-
-				animation = animations;
-
-				while (animation && (animation->id != pages[sceneIndex].animIndex))
-					animation = animation->next;
-
-				if (animation && animation->background) {
-
-					dst.x = (canvasW - SW) >> 1;
-					dst.y = (canvasH - SH) >> 1;
-					frameDelay = 1000 / (pages[sceneIndex].animSpeed >> 8);
-					SDL_SetPaletteColors(animation->background->format->palette, canvas->format->palette->colors, 0, 256);
-					SDL_BlitSurface(animation->background, NULL, canvas, &dst);
-					currentFrame = animation->sceneFrames;
-					SDL_Delay(frameDelay);
-
-				}
-
-			} else {
+			newpage = 0;
 
-				// Upload pixel data to the surface
-				if (SDL_MUSTLOCK(animation->background)) SDL_LockSurface(animation->background);
+		}
 
-				switch (currentFrame->frameType) {
+		// Pages without animations are drawn once, then copied every frame
+		if ((pages[sceneIndex].backgrounds > 0) || (pages[sceneIndex].animIndex == -1)) {
 
-					case ESquareAniHeader:
+			if (composedPage != (int)sceneIndex) composePage(sceneIndex);
 
-						loadCompactedMem(currentFrame->frameSize, currentFrame->frameData, (unsigned char*)animation->background->pixels);
+			if (!pages[sceneIndex].backgrounds) video.clearScreen(0);
 
-						break;
+			dst.x = (canvasW - SW) >> 1;
+			dst.y = (canvasH - SH) >> 1;
+			video.syncSurfacePalette(pageSurface);
+			SDL_BlitSurface(pageSurface, NULL, canvas, &dst);
 
-					case EFFAniHeader:
+			continue;
 
-						loadFFMem(currentFrame->frameSize, currentFrame->frameData, (unsigned char*)animation->background->pixels);
+		}
 
-						break;
+		if (!pages[sceneIndex].laidOut) layOutPage(pages + sceneIndex);
 
-					default:
+		if (currentFrame == NULL) {
 
-						LOG("Scene::Play unknown type", currentFrame->frameType);
+			animation = animations;
 
-						break;
+			while (animation && (animation->id != pages[sceneIndex].animIndex))
+				animation = animation->next;
 
-				}
+			if (animation && animation->background) {
 
-				if (SDL_MUSTLOCK(animation->background)) SDL_UnlockSurface(animation->background);
+				// Start from the first frame, even when looping
+				currentFrame = seekAnimation(animation, 0);
 
 				dst.x = (canvasW - SW) >> 1;
 				dst.y = (canvasH - SH) >> 1;
-				
-				SDL_SetPaletteColors(animation->background->format->palette, canvas->format->palette->colors, 0, 256);
+				frameDelay = 1000 / (pages[sceneIndex].animSpeed >> 8);
+				video.syncSurfacePalette(animation->background);
 				SDL_BlitSurface(animation->background, NULL, canvas, &dst);
-
-				playSound(currentFrame->soundId);
-
-				if (prevFrame) currentFrame = currentFrame->prev;
-				else currentFrame = currentFrame->next;
-
 				SDL_Delay(frameDelay);
 
-				if (currentFrame == NULL && animation->reverseAnimation) {
-
-					//prevFrame = 1 - prevFrame;
-
-					/*if(prevFrame) currentFrame = lastFrame->prev;
-					else currentFrame = lastFrame->next;*/
-					currentFrame = NULL;//animation->sceneFrames;
-
-				} else if (currentFrame == NULL && !pageTime && !pages[sceneIndex].askForYesNo && pages[sceneIndex].nextPageAfterAnim) {
-
-					continueToNextPage = 1;
-
-				}
-
-			}
-
-		} else video.clearScreen(0);
-
-
-		// Draw the texts associated with this page
-		x = 0;
-		y = 0;
-		int extraLineHeight = 0;
-
-		for (int count = 0; count < pages[sceneIndex].nTexts; count++) {
-
-			JJ1SceneText *text = pages[sceneIndex].texts + count;
-			Font *font = NULL;
-			int xOffset, yOffset;
-
-			for (int index = 0; index < nFonts; index++) {
-
-				if (text->fontId == fonts[index].id) {
-
-					font = fonts[index].font;
-
-					continue;
-
-				}
-
-			}
-
-			if (text->x != -1) {
-
-				x = text->x;
-				y = text->y;
-
-			}
-
-			if (text->textRect.x != -1) {
-
-				textRect = text->textRect;
-				x = 0;
-				y = 0;
-
 			}
 
-			if (text->extraLineHeight != -1) {
-
-				extraLineHeight = text->extraLineHeight;
-
-			}
+		} else {
 
-			xOffset = ((canvasW - SW) >> 1) + textRect.x + x;
-			yOffset = ((canvasH - SH) >> 1) + textRect.y + y;
+			// Upload pixel data to the surface
+			applyFrame(animation, currentFrame);
 
-			switch (text->alignment) {
+			dst.x = (canvasW - SW) >> 1;
+			dst.y = (canvasH - SH) >> 1;
+			
+			video.syncSurfacePalette(animation->background);
+			SDL_BlitSurface(animation->background, NULL, canvas, &dst);
 
-				case 0: // left
+			playSound(currentFrame->soundId);
 
-					break;
+			if (prevFrame) currentFrame = currentFrame->prev;
+			else currentFrame = currentFrame->next;
 
-				case 1: // right
+			SDL_Delay(frameDelay);
 
-					xOffset += textRect.w - font->getSceneStringWidth(text->text);
+			if (currentFrame == NULL && animation->reverseAnimation) {
 
-					break;
+				//prevFrame = 1 - prevFrame;
 
-				case 2: // center
+				/*if(prevFrame) currentFrame = lastFrame->prev;
+				else currentFrame = lastFrame->next;*/
+				currentFrame = NULL;//animation->sceneFrames;
 
-					xOffset += (textRect.w - font->getSceneStringWidth(text->text)) >> 1;
+			} else if (currentFrame == NULL && !pageTime && !pages[sceneIndex].askForYesNo && pages[sceneIndex].nextPageAfterAnim) {
 
-					break;
+				continueToNextPage = 1;
 
 			}
 
-			// Drop shadow
-			font->mapPalette(0, 256, 0, 1);
-			font->showSceneString(text->text, xOffset + 1, yOffset + 1);
-			font->setPalette(canvas->format->palette->colors);
-
-			// Text itself
-			font->showSceneString(text->text, xOffset, yOffset);
-
-			y += extraLineHeight + font->getHeight() / 2;
-
 		}
 
+		// Draw the texts associated with this page over the animation
+		drawTexts(pages + sceneIndex, (canvasW - SW) >> 1, (canvasH - SH) >> 1);
+
 	}
 
 	return E_NONE;
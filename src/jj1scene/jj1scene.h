@@ -24,6 +24,18 @@
 
 
 #include "io/file.h"
+#include "jobs.h"
+
+
+// Constants
+
+#ifndef SCENE_KEYFRAME_INTERVAL
+	#define SCENE_KEYFRAME_INTERVAL 16 /* Animation frames between keyframes */
+#endif
+
+#ifndef SCENE_KEYFRAME_BUDGET
+	#define SCENE_KEYFRAME_BUDGET (1 << 20) /* Memory each animation may spend on keyframes */
+#endif
 
 
 // Enums
@@ -113,6 +125,9 @@ class JJ1SceneText {
 		SDL_Rect       textRect;
 		int            extraLineHeight;
 		int			   shadowColour;
+		Font*          font; ///< The font, or NULL if the page has not been laid out
+		int            layoutX; ///< Position of the text, within the scene
+		int            layoutY; ///< Position of the text, within the scene
 
 		JJ1SceneText  ();
 		~JJ1SceneText ();
@@ -142,6 +157,7 @@ class JJ1ScenePage {
 		int				   askForYesNo;
 		int				   stopMusic;
 		int					backgroundFade;
+		bool               laidOut; ///< Whether or not the texts' fonts and positions have been found
 		JJ1ScenePage  ();
 		~JJ1ScenePage ();
 
@@ -152,8 +168,11 @@ class JJ1SceneImage {
 
 	public:
 		JJ1SceneImage* next;
-		SDL_Surface* image;
+		SDL_Surface* image; ///< The decoded image, or NULL if not yet decoded
 		int id;
+		int offset; ///< Position of the image data in the cutscene file
+		int width;
+		int height;
 
 		JJ1SceneImage  (JJ1SceneImage* newNext);
 		~JJ1SceneImage ();
@@ -189,8 +208,10 @@ class JJ1SceneFrame {
 		JJ1SceneFrame* next;
 		JJ1SceneFrame* prev;
 		unsigned char* frameData;
+		unsigned char* keyframe; ///< The whole picture once the frame has been applied, or NULL
 		int            frameSize;
 		unsigned int   frameType;
+		int            index; ///< Position of the frame in the animation
 		unsigned char  soundId;
 
 		JJ1SceneFrame  (int frameType, unsigned char* frameData, int frameSize);
@@ -207,9 +228,11 @@ class JJ1SceneAnimation {
 		JJ1SceneFrame*      lastFrame;
 
 		SDL_Surface*       background;
+		unsigned char*     firstPicture; ///< The background before any frames have been applied, once played
 		int id;
 		int frames;
 		int reverseAnimation;
+		int keyframeMemory; ///< Memory used by keyframes
 
 		JJ1SceneAnimation  (JJ1SceneAnimation* newNext);
 		~JJ1SceneAnimation ();
@@ -235,6 +258,22 @@ class JJ1Scene {
 		/// Scripts all information needed to render script pages, text etc
 		JJ1ScenePage*      pages;
 
+		File*              file; ///< Cutscene file, kept open to decode images as they are needed
+		SDL_mutex*         imageLock; ///< Guards the file and the images while images are decoded
+		Job                lookaheadJob; ///< Job decoding the next page's images
+		bool               lookingAhead; ///< Whether or not the lookahead job has been submitted
+		int                lookaheadPage; ///< The page whose images are being decoded ahead of time
+		SDL_Surface*       pageSurface; ///< A page's backgrounds and texts, drawn once for all its frames
+		int                composedPage; ///< The page drawn on the page surface, or -1
+
+		static void        lookahead        (void* data);
+
+		void               layOutPage       (JJ1ScenePage* page);
+		void               drawTexts        (JJ1ScenePage* page, int x, int y);
+		void               composePage      (int index);
+		void               applyFrame       (JJ1SceneAnimation* animation, JJ1SceneFrame* frame);
+		SDL_Surface*       getImage         (int id);
+		JJ1SceneFrame*     seekAnimation    (JJ1SceneAnimation* animation, int frame);
 		void               loadScripts      (File* f);
 		void               loadData         (File* f);
 		void               loadAni          (File* f, int dataIndex);
@@ -481,8 +481,12 @@ void JJ1Scene::loadData (File *f) {
 						else height = f->loadShort(SH); // Get height
 
 						f->seek(-2, false);
+
+						// The image is decoded when it is first needed
 						images = new JJ1SceneImage(images);
-						images->image = f->loadSurface(width, height);
+						images->offset = f->tell();
+						images->width = width;
+						images->height = height;
 						images->id = loop;
 
 					}
@@ -30,6 +30,9 @@
 #include "level/level.h"
 
 
+bool JJ2Event::deferContacts = false;
+
+
 /**
  * Create event
  *
@@ -55,6 +58,8 @@ JJ2Event::JJ2Event (JJ2Event* newNext, int gridX, int gridY, unsigned char newTy
 
 	flipped = false;
 
+	contactDue = false;
+
 	return;
 
 }
@@ -102,6 +107,18 @@ PickupJJ2Event::~PickupJJ2Event () {
 }
 
 
+/**
+ * Pickups only fall onto the ground, so are independent.
+ *
+ * @return True
+ */
+bool PickupJJ2Event::isIndependent () {
+
+	return true;
+
+}
+
+
 /**
  * Create ammo pickup event
  *
@@ -209,6 +226,18 @@ SpringJJ2Event::~SpringJJ2Event () {
 }
 
 
+/**
+ * Springs only fall onto the ground, so are independent.
+ *
+ * @return True
+ */
+bool SpringJJ2Event::isIndependent () {
+
+	return true;
+
+}
+
+
 /**
  * Create placeholder event
  *
@@ -238,6 +267,18 @@ OtherJJ2Event::~OtherJJ2Event () {
 }
 
 
+/**
+ * Unimplemented events do nothing, so are independent.
+ *
+ * @return True
+ */
+bool OtherJJ2Event::isIndependent () {
+
+	return true;
+
+}
+
+
 /**
  * Initiate the destruction of the event
  *
@@ -264,6 +305,43 @@ unsigned char JJ2Event::getType () {
 }
 
 
+/**
+ * Determine whether or not the event's steps change nothing but the event
+ * itself, besides its contact with players. Events which do can be stepped
+ * alongside others, with contact being handled afterwards by applyContacts.
+ * Event types which affect other events, or the level, in their steps
+ * override this.
+ *
+ * @return Whether or not the event is independent
+ */
+bool JJ2Event::isIndependent () {
+
+	return false;
+
+}
+
+
+/**
+ * Determine whether or not this event and all the events after it are
+ * independent.
+ *
+ * @return Whether or not all the events are independent
+ */
+bool JJ2Event::allIndependent () {
+
+	JJ2Event* event;
+
+	for (event = this; event; event = event->next) {
+
+		if (!event->isIndependent()) return false;
+
+	}
+
+	return true;
+
+}
+
+
 /**
  * Delete this event
  *
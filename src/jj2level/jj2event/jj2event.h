@@ -36,6 +36,11 @@ class JJ2Event : public Movable {
 
 	private:
 		JJ2Event* next;
+		bool      contactDue; ///< Whether or not contact with players is still to be handled this step
+		fixed     contactX; ///< X-coordinate at which to handle contact with players
+		fixed     contactY; ///< Y-coordinate at which to handle contact with players
+
+		void touchPlayers (fixed touchX, fixed touchY, unsigned int ticks, int msps);
 
 	protected:
 		unsigned char type;
@@ -47,16 +52,21 @@ class JJ2Event : public Movable {
 
 		void      destroy     (unsigned int ticks);
 		bool      prepareStep (unsigned int ticks, int msps);
-		bool      prepareDraw (unsigned int ticks, int change);
+		bool      prepareDraw (unsigned int ticks, fixed alpha);
 		JJ2Event* remove      ();
 
 	public:
+		static bool deferContacts; ///< Whether or not contact with players is left for applyContacts
+
 		virtual ~JJ2Event ();
 
-		unsigned char     getType ();
+		unsigned char     getType         ();
+		bool              allIndependent  ();
+		void              applyContacts   (unsigned int ticks, int msps);
 
-		virtual JJ2Event* step    (unsigned int ticks, int msps) = 0;
-		virtual void      draw    (unsigned int ticks, int change) = 0;
+		virtual bool      isIndependent   ();
+		virtual JJ2Event* step            (unsigned int ticks, int msps) = 0;
+		virtual void      draw            (unsigned int ticks, fixed alpha) = 0;
 
 };
 
@@ -74,6 +84,9 @@ class PickupJJ2Event : public JJ2Event {
 
 		JJ2Event* step (unsigned int ticks, int msps);
 
+	public:
+		bool isIndependent ();
+
 };
 
 /// JJ2 level ammo
@@ -83,7 +96,7 @@ class AmmoJJ2Event : public PickupJJ2Event {
 		AmmoJJ2Event  (JJ2Event* newNext, int gridX, int gridY, unsigned char newType, bool TSF);
 		~AmmoJJ2Event ();
 
-		void      draw (unsigned int ticks, int change);
+		void      draw (unsigned int ticks, fixed alpha);
 
 };
 
@@ -97,7 +110,7 @@ class CoinGemJJ2Event : public PickupJJ2Event {
 		CoinGemJJ2Event  (JJ2Event* newNext, int gridX, int gridY, unsigned char newType, bool TSF);
 		~CoinGemJJ2Event ();
 
-		void      draw (unsigned int ticks, int change);
+		void      draw (unsigned int ticks, fixed alpha);
 
 };
 
@@ -108,7 +121,7 @@ class FoodJJ2Event : public PickupJJ2Event {
 		FoodJJ2Event  (JJ2Event* newNext, int gridX, int gridY, unsigned char newType, bool TSF);
 		~FoodJJ2Event ();
 
-		void      draw (unsigned int ticks, int change);
+		void      draw (unsigned int ticks, fixed alpha);
 
 };
 
@@ -122,8 +135,9 @@ class SpringJJ2Event : public JJ2Event {
 		SpringJJ2Event  (JJ2Event* newNext, int gridX, int gridY, unsigned char newType, bool TSF, int newProperties);
 		~SpringJJ2Event ();
 
+		bool      isIndependent ();
 		JJ2Event* step (unsigned int ticks, int msps);
-		void      draw (unsigned int ticks, int change);
+		void      draw (unsigned int ticks, fixed alpha);
 
 };
 
@@ -138,8 +152,9 @@ class OtherJJ2Event : public JJ2Event {
 		OtherJJ2Event  (JJ2Event* newNext, int gridX, int gridY, unsigned char newType, bool TSF, int newProperties);
 		~OtherJJ2Event ();
 
+		bool      isIndependent ();
 		JJ2Event* step (unsigned int ticks, int msps);
-		void      draw (unsigned int ticks, int change);
+		void      draw (unsigned int ticks, fixed alpha);
 
 };
 
@@ -29,6 +29,8 @@
 #include "../jj2level.h"
 #include "../jj2levelplayer/jj2levelplayer.h"
 
+#include "game/game.h"
+#include "game/gamemode.h"
 #include "io/gfx/anim.h"
 #include "io/gfx/font.h"
 #include "io/gfx/video.h"
@@ -283,13 +285,11 @@ const unsigned char pickupAnims[] = {
  */
 bool JJ2Event::prepareStep (unsigned int ticks, int msps) {
 
-	JJ2LevelPlayer *levelPlayer;
-	int count;
-
-
 	// Process next event(s)
 	if (next) next = next->step(ticks, msps);
 
+	savePosition();
+
 
 	// If the reaction time has expired
 	if (endTime && (ticks > endTime)) {
@@ -302,23 +302,86 @@ bool JJ2Event::prepareStep (unsigned int ticks, int msps) {
 	if (endTime) return false;
 
 
-	// Handle contact with player
+	// Contact changes players, so while events are being stepped alongside
+	// each other it is left until they are done, as it was at this point
+	if (deferContacts) {
+
+		contactDue = true;
+		contactX = x;
+		contactY = y;
+
+		return false;
+
+	}
+
+	touchPlayers(x, y, ticks, msps);
+
+	return false;
+
+}
 
-	for (count = 0; count < nPlayers; count++) {
 
-		levelPlayer = players[count].getJJ2LevelPlayer();
+/**
+ * Handle contact with players.
+ *
+ * @param touchX X-coordinate of the event
+ * @param touchY Y-coordinate of the event
+ * @param ticks Time
+ * @param msps Ticks per step
+ */
+void JJ2Event::touchPlayers (fixed touchX, fixed touchY, unsigned int ticks, int msps) {
+
+	JJ2LevelPlayer *levelPlayer;
+	int found[MAX_PLAYERS];
+	int count, nFound;
+	bool picked;
+
+	// Only players whose extents overlap the event's can touch it
+	nFound = jj2Level->findPlayers(touchX, F32, found);
+
+	for (count = 0; count < nFound; count++) {
+
+		levelPlayer = players[found[count]].getJJ2LevelPlayer();
 
 		// Check if the player is touching the event
-		if (levelPlayer->overlap(x, y, F32, F32)) {
+		if (levelPlayer->overlap(touchX, touchY, F32, F32)) {
+
+			picked = levelPlayer->touchEvent(this, ticks, msps);
+
+			// Touching may have moved the player, such as through a warp
+			jj2Level->sortPlayers();
 
 			// If the player picks up the event, destroy it
-			if (levelPlayer->touchEvent(this, ticks, msps)) destroy(ticks);
+			if (picked) destroy(ticks);
 
 		}
 
 	}
 
-	return false;
+	return;
+
+}
+
+
+/**
+ * Handle the contact with players left over from stepping this event and
+ * those after it, in the order the steps would have handled it.
+ *
+ * @param ticks Time
+ * @param msps Ticks per step
+ */
+void JJ2Event::applyContacts (unsigned int ticks, int msps) {
+
+	// Later events were stepped first
+	if (next) next->applyContacts(ticks, msps);
+
+	if (!contactDue) return;
+
+	contactDue = false;
+
+	touchPlayers(contactX, contactY, ticks, msps);
+
+	return;
 
 }
 
@@ -327,18 +390,17 @@ bool JJ2Event::prepareStep (unsigned int ticks, int msps) {
  * Functionality required by all event types on each draw
  *
  * @param ticks Time
- * @param change Time since last iteration
+ * @param alpha How far drawing is between the last step and the next, out of F1
  *
  * @return Whether or not the event shouldn't be drawn
  */
-bool JJ2Event::prepareDraw (unsigned int ticks, int change) {
+bool JJ2Event::prepareDraw (unsigned int ticks, fixed alpha) {
 
 	// Draw next event(s)
-	if (next) next->draw(ticks, change);
+	if (next) next->draw(ticks, alpha);
 
 	// Don't draw if too far off-screen
-	if ((x < viewX - F64) || (y < viewY - F64) ||
-		(x > viewX + ITOF(canvasW) + F64) || (y > viewY + ITOF(canvasH) + F64)) return true;
+	if (!isInView(getDrawX(alpha) - F32, getDrawY(alpha) - F32, F64, F64)) return true;
 
 	return false;
 
@@ -385,17 +447,17 @@ JJ2Event* PickupJJ2Event::step (unsigned int ticks, int msps) {
  * Draw ammo pickup event.
  *
  * @param ticks Time
- * @param change Time since last iteration
+ * @param alpha How far drawing is between the last step and the next, out of F1
  */
-void AmmoJJ2Event::draw (unsigned int ticks, int change) {
+void AmmoJJ2Event::draw (unsigned int ticks, fixed alpha) {
 
 	Anim* an;
 	int drawX, drawY;
 
-	if (prepareDraw(ticks, change)) return;
+	if (prepareDraw(ticks, alpha)) return;
 
-	drawX = getDrawX(change);
-	drawY = getDrawY(change);
+	drawX = getDrawX(alpha);
+	drawY = getDrawY(alpha);
 
 	/// @todo Check if ammo is powered up
 	if (!endTime) an = jj2Level->getAnim(0, ammoAnims[type - 33], flipped);
@@ -436,17 +498,17 @@ void CoinGemJJ2Event::mapPalette (Anim* anim, int start) {
  * Draw coin/gem pickup event.
  *
  * @param ticks Time
- * @param change Time since last iteration
+ * @param alpha How far drawing is between the last step and the next, out of F1
  */
-void CoinGemJJ2Event::draw (unsigned int ticks, int change) {
+void CoinGemJJ2Event::draw (unsigned int ticks, fixed alpha) {
 
 	Anim* an;
 	int drawX, drawY;
 
-	if (prepareDraw(ticks, change)) return;
+	if (prepareDraw(ticks, alpha)) return;
 
-	drawX = getDrawX(change);
-	drawY = getDrawY(change);
+	drawX = getDrawX(alpha);
+	drawY = getDrawY(alpha);
 
 	if (endTime) {
 
@@ -508,17 +570,17 @@ void CoinGemJJ2Event::draw (unsigned int ticks, int change) {
  * Draw food pickup event.
  *
  * @param ticks Time
- * @param change Time since last iteration
+ * @param alpha How far drawing is between the last step and the next, out of F1
  */
-void FoodJJ2Event::draw (unsigned int ticks, int change) {
+void FoodJJ2Event::draw (unsigned int ticks, fixed alpha) {
 
 	Anim* an;
 	int drawX, drawY;
 
-	if (prepareDraw(ticks, change)) return;
+	if (prepareDraw(ticks, alpha)) return;
 
-	drawX = getDrawX(change);
-	drawY = getDrawY(change);
+	drawX = getDrawX(alpha);
+	drawY = getDrawY(alpha);
 
 	// Use look-up table
 	if (!endTime) an = jj2Level->getAnim(animSet, pickupAnims[type], flipped);
@@ -555,17 +617,17 @@ JJ2Event* SpringJJ2Event::step (unsigned int ticks, int msps) {
  * Draw spring event.
  *
  * @param ticks Time
- * @param change Time since last iteration
+ * @param alpha How far drawing is between the last step and the next, out of F1
  */
-void SpringJJ2Event::draw (unsigned int ticks, int change) {
+void SpringJJ2Event::draw (unsigned int ticks, fixed alpha) {
 
 	Anim* an;
 	int drawX, drawY;
 
-	if (prepareDraw(ticks, change)) return;
+	if (prepareDraw(ticks, alpha)) return;
 
-	drawX = getDrawX(change);
-	drawY = getDrawY(change);
+	drawX = getDrawX(alpha);
+	drawY = getDrawY(alpha);
 
 	switch (type) {
 
@@ -634,17 +696,17 @@ JJ2Event* OtherJJ2Event::step (unsigned int ticks, int msps) {
  * Draw placeholder event.
  *
  * @param ticks Time
- * @param change Time since last iteration
+ * @param alpha How far drawing is between the last step and the next, out of F1
  */
-void OtherJJ2Event::draw (unsigned int ticks, int change) {
+void OtherJJ2Event::draw (unsigned int ticks, fixed alpha) {
 
 	Anim* an;
 	int drawX, drawY;
 
-	if (prepareDraw(ticks, change)) return;
+	if (prepareDraw(ticks, alpha)) return;
 
-	drawX = getDrawX(change);
-	drawY = getDrawY(change);
+	drawX = getDrawX(alpha);
+	drawY = getDrawY(alpha);
 
 	switch (type) {
 
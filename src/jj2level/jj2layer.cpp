@@ -26,20 +26,75 @@
 
 #include "jj2level.h"
 
+#include "io/gfx/blitter.h"
 #include "io/gfx/video.h"
+#include "util.h"
+
+#include <string.h>
+
+
+/**
+ * Find the first occupied cell in part of a row of a layer.
+ *
+ * @param bits The row's occupancy bitmap
+ * @param from The first column to look at
+ * @param end The column after the last to look at
+ *
+ * @return The column of the occupied cell, or end if there is none
+ */
+static int findOccupied (const unsigned int* bits, int from, int end) {
+
+	unsigned int word;
+	int index;
+
+	if (from >= end) return end;
+
+	index = from >> 5;
+	word = bits[index] & (0xFFFFFFFF << (from & 31));
+
+	// Whole words of empty cells are passed over at once
+	while (!word) {
+
+		if (++index << 5 >= end) return end;
+
+		word = bits[index];
+
+	}
+
+	from = (index << 5) + __builtin_ctz(word);
+
+	return (from < end)? from: end;
+
+}
 
 
 /**
  * Create a blank 1-by-1 layer.
+ *
+ * @param newArena The level's arena, from which to allocate the grid
  */
-JJ2Layer::JJ2Layer () {
+JJ2Layer::JJ2Layer (Arena* newArena) {
 
+	arena = newArena;
 	width = height = 1;
 
-	grid = new JJ2Tile *[1];
-	*grid = new JJ2Tile[1];
+	blocksW = blocksH = 1;
+	blocks = (unsigned short int **)(arena->allocate(sizeof(unsigned short int *)));
+	*blocks = (unsigned short int *)(arena->allocate(sizeof(unsigned short int)));
+	**blocks = 0;
+
+	// Nothing is left to expand
+	words = NULL;
+	dictionary = NULL;
 
-	(*grid)->tile = 0;
+	occupancyPitch = 1;
+	occupancy = (unsigned int *)(arena->allocate(sizeof(unsigned int)));
+	*occupancy = 0;
+	occupied = 0;
+
+	animFrames = NULL;
+	animOffset = 0;
+	nAnimTiles = 0;
 
 	return;
 
@@ -54,18 +109,34 @@ JJ2Layer::JJ2Layer () {
  * @param newXSpeed The relative horizontal speed of the layer
  * @param newYSpeed The relative vertical speed of the layer
  * @param flags Layer flags
+ * @param newArena The level's arena, from which to allocate the grid
  */
-JJ2Layer::JJ2Layer (int flags, int newWidth, int newHeight, fixed newXSpeed, fixed newYSpeed) {
+JJ2Layer::JJ2Layer (int flags, int newWidth, int newHeight, fixed newXSpeed, fixed newYSpeed, Arena* newArena) {
 
-	int row;
+	int count;
 
+	arena = newArena;
 	width = newWidth;
 	height = newHeight;
 
-	grid = new JJ2Tile *[height];
-	*grid = new JJ2Tile[width * height];
+	// Blocks are allocated as they are expanded
+	blocksW = ((width - 1) >> LAYER_BLOCK) + 1;
+	blocksH = ((height - 1) >> LAYER_BLOCK) + 1;
+	blocks = (unsigned short int **)(arena->allocate(blocksW * blocksH * sizeof(unsigned short int *)));
+
+	for (count = 0; count < blocksW * blocksH; count++) blocks[count] = NULL;
 
-	for (row = 0; row < height; row++) grid[row] = *grid + (row * width);
+	words = NULL;
+	dictionary = NULL;
+	wordPitch = 0;
+	TSF = false;
+	tiles = 0;
+
+	// Cells are marked as their blocks are expanded
+	occupancyPitch = (width + 31) >> 5;
+	occupancy = (unsigned int *)(arena->allocate(occupancyPitch * height * sizeof(unsigned int)));
+	memset(occupancy, 0, occupancyPitch * height * sizeof(unsigned int));
+	occupied = 0;
 
 	tileX = flags & 1;
 	tileY = flags & 2;
@@ -75,6 +146,10 @@ JJ2Layer::JJ2Layer (int flags, int newWidth, int newHeight, fixed newXSpeed, fix
 	xSpeed = newXSpeed;
 	ySpeed = newYSpeed;
 
+	animFrames = NULL;
+	animOffset = 0;
+	nAnimTiles = 0;
+
 	return;
 
 }
@@ -85,14 +160,104 @@ JJ2Layer::JJ2Layer (int flags, int newWidth, int newHeight, fixed newXSpeed, fix
  */
 JJ2Layer::~JJ2Layer () {
 
-	delete[] *grid;
-	delete[] grid;
+	// The blocks are freed along with the level's arena
+
+	return;
+
+}
+
+
+/**
+ * Expand a block of the layer from the dictionary words, marking its occupied
+ * cells. Only ever done on the main thread, as the blocks are allocated from
+ * the level's arena.
+ *
+ * @param blockX The x-coordinate of the block (in blocks)
+ * @param blockY The y-coordinate of the block (in blocks)
+ */
+void JJ2Layer::expandBlock (int blockX, int blockY) {
+
+	unsigned short int* ge;
+	unsigned short int tile;
+	int x, y, firstX, firstY, lastX, lastY;
+
+	firstX = blockX << LAYER_BLOCK;
+	firstY = blockY << LAYER_BLOCK;
+	lastX = firstX + (1 << LAYER_BLOCK);
+	lastY = firstY + (1 << LAYER_BLOCK);
+	if (lastX > width) lastX = width;
+	if (lastY > height) lastY = height;
+
+	// Blocks at the edges are only as big as the layer
+	ge = (unsigned short int *)(arena->allocate((lastX - firstX) * (lastY - firstY) * sizeof(unsigned short int)));
+	blocks[(blockY * blocksW) + blockX] = ge;
+
+	for (y = firstY; y < lastY; y++) {
+
+		for (x = firstX; x < lastX; x++) {
+
+			tile = createShort(dictionary + (words[(y * wordPitch) + (x >> 2)] << 3) + ((x & 3) << 1));
+
+			if (TSF) *ge = (tile & 0xFFF) | ((tile & 0x1000)? JJ2_FLIPPED: 0);
+			else *ge = (tile & 0x3FF) | ((tile & 0x400)? JJ2_FLIPPED: 0);
+
+			if (((*ge & JJ2_TILE) > tiles) &&
+				(((*ge & JJ2_TILE) < animOffset) || ((*ge & JJ2_TILE) >= animOffset + nAnimTiles))) *ge = 0;
+
+			// Keep the occupancy bitmap up to date
+			if (*ge & JJ2_TILE) {
+
+				occupancy[(y * occupancyPitch) + (x >> 5)] |= 1u << (x & 31);
+				occupied++;
+
+			}
+
+			ge++;
+
+		}
+
+	}
 
 	return;
 
 }
 
 
+/**
+ * Find the grid entry at the given co-ordinates, expanding its block first if
+ * need be.
+ *
+ * @param x The x-coordinate of the tile (in tiles), which must be within the
+ * layer
+ * @param y The y-coordinate of the tile (in tiles), which must be within the
+ * layer
+ *
+ * @return The grid entry
+ */
+unsigned short int* JJ2Layer::getCell (int x, int y) {
+
+	unsigned short int* block;
+	int blockX, blockWidth;
+
+	blockX = x >> LAYER_BLOCK;
+	block = blocks[((y >> LAYER_BLOCK) * blocksW) + blockX];
+
+	if (!block) {
+
+		expandBlock(blockX, y >> LAYER_BLOCK);
+		block = blocks[((y >> LAYER_BLOCK) * blocksW) + blockX];
+
+	}
+
+	// Blocks at the right edge are only as wide as the layer
+	if (blockX == blocksW - 1) blockWidth = width - (blockX << LAYER_BLOCK);
+	else blockWidth = 1 << LAYER_BLOCK;
+
+	return block + ((y & ((1 << LAYER_BLOCK) - 1)) * blockWidth) + (x & ((1 << LAYER_BLOCK) - 1));
+
+}
+
+
 /**
  * Get flipped. We aim to offend!
  *
@@ -105,7 +270,25 @@ bool JJ2Layer::getFlipped (int x, int y) {
 
 	if ((x < 0) || (y < 0) || (x >= width) || (y >= height)) return false;
 
-	return grid[y][x].flipped;
+	return getFrame(*getCell(x, y)) & JJ2_FLIPPED;
+
+}
+
+
+/**
+ * Get the tile currently shown for a grid entry. Animated tiles give their
+ * current frame, flipped if either the frame or the grid entry is flipped.
+ *
+ * @param tile The grid entry
+ *
+ * @return The tile shown
+ */
+unsigned short int JJ2Layer::getFrame (unsigned short int tile) {
+
+	if (((tile & JJ2_TILE) >= animOffset) && ((tile & JJ2_TILE) < animOffset + nAnimTiles))
+		return animFrames[(tile & JJ2_TILE) - animOffset] ^ (tile & JJ2_FLIPPED);
+
+	return tile;
 
 }
 
@@ -137,7 +320,7 @@ int JJ2Layer::getTile (int x, int y) {
 	if ((x >= width) && !tileX) return 0;
 	if ((y >= height) && !tileY) return 0;
 
-	return grid[y % height][x % width].tile;
+	return getFrame(*getCell(x % width, y % height)) & JJ2_TILE;
 
 }
 
@@ -155,15 +338,19 @@ int JJ2Layer::getWidth () {
 
 
 /**
- * Set the frame of the tile at the given co-ordinates.
+ * Use the level's animated tiles. Grid cells holding an animated tile are
+ * resolved to its current frame whenever they are read, so animation never
+ * rewrites the grid.
  *
- * @param x The x-coordinate of the tile (in tiles)
- * @param y The y-coordinate of the tile (in tiles)
- * @param frame The new frame
+ * @param frames The current frame of each animated tile
+ * @param offset The number of the first animated tile
+ * @param count The number of animated tiles
  */
-void JJ2Layer::setFrame (int x, int y, unsigned char frame) {
+void JJ2Layer::setAnimatedTiles (unsigned short int* frames, int offset, int count) {
 
-	grid[y][x].frame = frame;
+	animFrames = frames;
+	animOffset = offset;
+	nAnimTiles = count;
 
 	return;
 
@@ -171,35 +358,81 @@ void JJ2Layer::setFrame (int x, int y, unsigned char frame) {
 
 
 /**
- * Set the tile at the given co-ordinates.
+ * Set the layer's tiles, as dictionary words of four tiles each. Lazy layers
+ * keep the words, and only expand each block as it first comes into view, or
+ * is first looked at. The animated tiles must already have been set.
  *
- * @param x The x-coordinate of the tile (in tiles)
- * @param y The y-coordinate of the tile (in tiles)
- * @param tile The number of the tile
- * @param TSF Whether or not this is a TSF tile
- * @param tiles The total number of tiles
+ * @param newWords The word of each group of four tiles, row by row
+ * @param pitch Words per row
+ * @param newDictionary The level's dictionary of groups of four tiles, which
+ * must last as long as the layer if it is lazy
+ * @param newTSF Whether or not these are TSF tiles
+ * @param newTiles The total number of tiles
+ * @param lazy Whether or not to expand blocks only as they are needed
  */
-void JJ2Layer::setTile (int x, int y, unsigned short int tile, bool TSF, int tiles) {
+void JJ2Layer::setWords (unsigned short int* newWords, int pitch, unsigned char* newDictionary, bool newTSF, int newTiles, bool lazy) {
+
+	int x, y;
+
+	wordPitch = pitch;
+	dictionary = newDictionary;
+	TSF = newTSF;
+	tiles = newTiles;
+
+	if (lazy) {
 
-	JJ2Tile* ge;
+		// The words are a quarter of the size of the grid
+		words = (unsigned short int *)(arena->allocate(height * pitch * sizeof(unsigned short int)));
+		memcpy(words, newWords, height * pitch * sizeof(unsigned short int));
 
-	ge = grid[y] + x;
+		return;
 
-	if (TSF) {
+	}
 
-		ge->flipped = tile & 0x1000;
-		ge->tile = tile & 0xFFF;
+	words = newWords;
 
-	} else {
+	for (y = 0; y < blocksH; y++) {
 
-		ge->flipped = tile & 0x400;
-		ge->tile = tile & 0x3FF;
+		for (x = 0; x < blocksW; x++) expandBlock(x, y);
 
 	}
 
-	if (ge->tile > tiles) ge->tile = 0;
+	// Nothing is left to expand
+	words = NULL;
+	dictionary = NULL;
+
+	return;
+
+}
+
+
+/**
+ * Find the position of the layer's view, from the position of the level's.
+ *
+ * @param vX Set to the x-coordinate of the view (in pixels)
+ * @param vY Set to the y-coordinate of the view (in pixels)
+ */
+void JJ2Layer::getView (int* vX, int* vY) {
+
+	*vX = FTOI(FTOI(viewX) * xSpeed);
+	*vY = FTOI(FTOI(viewY) * ySpeed);
+
+	if (limit) {
+
+		if (!tileX) {
+
+			if (*vX + canvasW > TTOI(width)) *vX = TTOI(width) - canvasW;
+
+		}
+
+		if (!tileY) {
+
+			*vY -= canvasH - SH;
+			if (*vY + canvasH > TTOI(height)) *vY = TTOI(height) - canvasH;
 
-	ge->frame = 0;
+		}
+
+	}
 
 	return;
 
@@ -207,52 +440,306 @@ void JJ2Layer::setTile (int x, int y, unsigned short int tile, bool TSF, int til
 
 
 /**
- * Draw the layer.
+ * Expand the blocks of the layer which the view overlaps, so that they can be
+ * drawn. Must be called on the main thread before the layer is drawn.
+ */
+void JJ2Layer::reveal () {
+
+	int vX, vY;
+	int x, y, gridX, gridY, edge;
+	int lastX, lastY;
+
+	// Layers which have been expanded entirely keep no words
+	if (!words) return;
+
+	getView(&vX, &vY);
+
+	// Include the tiles partly overlapping the canvas's last cells
+	lastX = ITOT(vX + canvasW + 31) + 1;
+	lastY = ITOT(vY + canvasH + 31) + 1;
+
+	y = ITOT(vY);
+
+	if (y < 0) y = 0;
+
+	while (y <= lastY) {
+
+		gridY = y;
+
+		if (gridY >= height) {
+
+			if (!tileY) break;
+
+			gridY %= height;
+
+		}
+
+		x = ITOT(vX);
+
+		if (x < 0) x = 0;
+
+		while (x <= lastX) {
+
+			gridX = x;
+
+			if (gridX >= width) {
+
+				if (!tileX) break;
+
+				gridX %= width;
+
+			}
+
+			if (!blocks[((gridY >> LAYER_BLOCK) * blocksW) + (gridX >> LAYER_BLOCK)])
+				expandBlock(gridX >> LAYER_BLOCK, gridY >> LAYER_BLOCK);
+
+			// Step to the next block, or to the layer's edge
+			edge = (gridX | ((1 << LAYER_BLOCK) - 1)) + 1;
+			if (edge > width) edge = width;
+
+			x += edge - gridX;
+
+		}
+
+		edge = (gridY | ((1 << LAYER_BLOCK) - 1)) + 1;
+		if (edge > height) edge = height;
+
+		y += edge - gridY;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Mark the cells of the canvas which the layer covers entirely with opaque
+ * tiles, unless a layer in front already covers them. Cells are 32 pixels
+ * square and aligned to the canvas, so each overlaps up to four of the
+ * layer's tiles.
  *
- * @param tileSet The tile set to use for non-flipped tiles
- * @param flippedTileSet The tile set to use for flipped tiles
+ * @param opaqueTiles Whether or not each tile is drawn fully opaque
+ * @param occlusion The foremost layer covering each cell, or LAYERS
+ * @param depth The number of this layer
  */
-void JJ2Layer::draw (SDL_Surface* tileSet, SDL_Surface* flippedTileSet) {
+void JJ2Layer::occlude (bool* opaqueTiles, unsigned char* occlusion, int depth) {
 
-	SDL_Rect src, dst;
+	unsigned char* cell;
 	int vX, vY;
-	int x, y;
+	int cellsW, cellsH;
+	int x, y, gridX, gridY;
+
+	getView(&vX, &vY);
+
+	cellsW = ITOT(canvasW + 31);
+	cellsH = ITOT(canvasH + 31);
+
+	for (y = 0; y < cellsH; y++) {
+
+		cell = occlusion + (y * cellsW);
+		gridY = ITOT(TTOI(y) + vY);
+
+		for (x = 0; x < cellsW; x++) {
+
+			if (cell[x] < LAYERS) continue;
 
-	// Set tile drawing dimensions
-	src.w = TTOI(1);
-	src.h = TTOI(1);
-	src.x = 0;
+			gridX = ITOT(TTOI(x) + vX);
+
+			// Cells only line up with tiles where the view is on a tile edge
+			if (!opaqueTiles[getTile(gridX, gridY)]) continue;
+
+			if ((vX & 31) && !opaqueTiles[getTile(gridX + 1, gridY)]) continue;
+
+			if (vY & 31) {
+
+				if (!opaqueTiles[getTile(gridX, gridY + 1)]) continue;
+				if ((vX & 31) && !opaqueTiles[getTile(gridX + 1, gridY + 1)]) continue;
+
+			}
+
+			cell[x] = depth;
+
+		}
+
+	}
+
+	return;
+
+}
 
 
+/**
+ * Make sure the tiles of the layer within the view are decompressed, ready to
+ * be drawn. Must be called on the main thread once the layer has been
+ * revealed, before the layer is drawn.
+ *
+ * @param tileCache The decompressed tiles
+ */
+void JJ2Layer::cacheTiles (JJ2TileCache* tileCache) {
+
+	int vX, vY;
+	int x, y, lastX, lastY;
+
+	if (!occupied) return;
+
+	getView(&vX, &vY);
+
+	lastX = ITOT(vX + canvasW - 1);
+	lastY = ITOT(vY + canvasH - 1);
+
+	for (y = ITOT(vY); y <= lastY; y++) {
+
+		for (x = ITOT(vX); x <= lastX; x++) tileCache->fetch(getTile(x, y));
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Draw the part of the layer within the given band of the canvas. The canvas
+ * must already be locked, if it needs to be. Bands which do not overlap may
+ * be drawn on different threads at once, once the layer has been revealed.
+ *
+ * @param tileImages The tiles, which are mirrored where flipped, or NULL if
+ * the tiles are kept compressed
+ * @param tileCache The decompressed tiles, if the tiles are kept compressed
+ * @param band The band, which must be within the canvas
+ * @param occlusion The foremost layer covering each cell of the canvas, or
+ * NULL to draw every tile
+ * @param depth The number of this layer
+ * @param trueCanvas The 32-bit canvas into which to draw the tile images, or
+ * NULL to draw into the canvas
+ * @param expandedTiles The tile images expanded for the 32-bit canvas, if it
+ * is used
+ */
+void JJ2Layer::draw (BlitImage* tileImages, JJ2TileCache* tileCache, SDL_Rect* band, unsigned char* occlusion, int depth, Uint32* trueCanvas, ExpandedSet* expandedTiles) {
+
+	BlitImage* image;
+	unsigned short int tile;
+	unsigned int* bits;
+	unsigned char* cells;
+	int vX, vY;
+	int x, y, gridX, gridY;
+	int firstY, lastY, lastX;
+	int column, end, tX;
+	int cellsW, cellX, cellY, lastCellX, lastCellY;
+
+
+	// Layers with nothing in them cost nothing
+	if (!occupied) return;
+
 	// Calculate the layer view
-	vX = FTOI(FTOI(viewX) * xSpeed);
-	vY = FTOI(FTOI(viewY) * ySpeed);
+	getView(&vX, &vY);
 
-	if (limit) {
+	lastX = ITOT(canvasW - 1) + 1;
 
-		if (!tileX) {
+	cellsW = ITOT(canvasW + 31);
 
-			if (vX + canvasW > TTOI(width)) vX = TTOI(width) - canvasW;
+	// Only the rows of tiles overlapping the band are drawn
+	firstY = ITOT(band->y + (vY & 31));
+	lastY = ITOT(band->y + band->h - 1 + (vY & 31));
+
+	if (lastY > ITOT(canvasH - 1) + 1) lastY = ITOT(canvasH - 1) + 1;
+
+	for (y = firstY; y <= lastY; y++) {
+
+		// Find the row, wrapping if the layer repeats vertically
+		gridY = y + ITOT(vY);
+
+		if (gridY < 0) continue;
+
+		if (gridY >= height) {
+
+			if (!tileY) break;
+
+			gridY %= height;
 
 		}
 
-		if (!tileY) {
+		// The rows of cells which the row of tiles overlaps
+		cellY = y - ((vY & 31)? 1: 0);
+		lastCellY = y;
+		if (cellY < 0) cellY = 0;
+		if (lastCellY > ITOT(canvasH - 1)) lastCellY = ITOT(canvasH - 1);
+
+		bits = occupancy + (gridY * occupancyPitch);
+
+		// Step along the row, wrapping if the layer repeats horizontally
+		gridX = ITOT(vX);
+
+		if (gridX < 0) {
+
+			x = -gridX;
+			gridX = 0;
+
+		} else x = 0;
+
+		if (gridX >= width) {
 
-			vY -= canvasH - SH;
-			if (vY + canvasH > TTOI(height)) vY = TTOI(height) - canvasH;
+			if (!tileX) continue;
+
+			gridX %= width;
 
 		}
 
-	}
+		while (x <= lastX) {
+
+			// Jump between the occupied cells before the layer's edge
+			end = gridX + lastX + 1 - x;
+			if (end > width) end = width;
+
+			for (column = findOccupied(bits, gridX, end); column < end;
+				column = findOccupied(bits, column + 1, end)) {
+
+				// Only expanded blocks have occupied cells
+				tile = getFrame(*getCell(column, gridY));
+				tX = x + column - gridX;
+
+				// Animated tiles may have empty frames
+				if (!(tile & JJ2_TILE)) continue;
+
+				// Skip tiles hidden behind opaque tiles of the layers in front
+				if (occlusion) {
+
+					cellX = tX - ((vX & 31)? 1: 0);
+					lastCellX = tX;
+					if (cellX < 0) cellX = 0;
+					if (lastCellX > ITOT(canvasW - 1)) lastCellX = ITOT(canvasW - 1);
+
+					cells = occlusion + (cellY * cellsW);
+
+					if ((cells[cellX] < depth) && (cells[lastCellX] < depth) &&
+						((cellY == lastCellY) ||
+						((cells[cellX + cellsW] < depth) && (cells[lastCellX + cellsW] < depth))))
+						continue;
+
+				}
+
+				// Tiles which did not fit in the cache are left out
+				if (tileImages) image = tileImages + (tile & JJ2_TILE);
+				else if (!(image = tileCache->getImage(tile & JJ2_TILE))) continue;
+
+#ifdef SDL2
+				if (trueCanvas && tileImages)
+					image->drawTrue(trueCanvas, expandedTiles->getColours(tile & JJ2_TILE),
+						TTOI(tX) - (vX & 31), TTOI(y) - (vY & 31), band, tile & JJ2_FLIPPED);
+				else
+#endif
+				if (tile & JJ2_FLIPPED)
+					image->drawMirrored(TTOI(tX) - (vX & 31), TTOI(y) - (vY & 31), band);
+				else
+					image->draw(TTOI(tX) - (vX & 31), TTOI(y) - (vY & 31), band);
 
-	for (y = 0; y <= ITOT(canvasH - 1) + 1; y++) {
+			}
 
-		for (x = 0; x <= ITOT(canvasW - 1) + 1; x++) {
+			if (!tileX) break;
 
-			dst.x = TTOI(x) - (vX & 31);
-			dst.y = TTOI(y) - (vY & 31);
-			src.y = TTOI(getTile(x + ITOT(vX), y + ITOT(vY)));
-			if (src.y) SDL_BlitSurface(getFlipped(x + ITOT(vX), y + ITOT(vY))? flippedTileSet: tileSet, &src, canvas, &dst);
+			x += end - gridX;
+			gridX = 0;
 
 		}
 
@@ -34,10 +34,14 @@
 #include "game/gamemode.h"
 #include "io/controls.h"
 #include "io/file.h"
+#include "io/gfx/blitter.h"
 #include "io/gfx/font.h"
 #include "io/gfx/sprite.h"
 #include "io/gfx/video.h"
+#include "io/loadprofile.h"
 #include "io/sound.h"
+#include "level/replay.h"
+#include "profile.h"
 #include "util.h"
 
 #include <string.h>
@@ -56,12 +60,29 @@ JJ2Level::JJ2Level (Game* owner, char* fileName, bool checkpoint, bool multi) :
 
 	int ret;
 
+	// The occlusion mask is made once the canvas size is known
+	occlusion = NULL;
+	occlusionSize = 0;
+
+	tileCache = NULL;
+	expandedTiles = NULL;
+	trueCanvas = NULL;
+
 	// Load level data
 
+	LOAD_BEGIN("JJ2Level::load");
 	ret = load(fileName, checkpoint);
+	LOAD_END();
 
 	if (ret < 0) throw ret;
 
+	// Players are sorted as soon as events are processed
+	playerOrder = new int[MAX_PLAYERS];
+	nSorted = 0;
+
+	LOAD_REPORT(fileName);
+	PROFILE_LEVEL(fileName);
+
 	multiplayer = multi;
 
 	return;
@@ -70,35 +91,127 @@ JJ2Level::JJ2Level (Game* owner, char* fileName, bool checkpoint, bool multi) :
 
 
 /**
- * Delete the JJ2 level.
+ * Delete the animation sets and sprites.
  */
-JJ2Level::~JJ2Level () {
+JJ2AnimsAsset::~JJ2AnimsAsset () {
 
 	int count;
 
-	if (events) delete events;
-	delete[] *mods;
-	delete[] mods;
+	for (count = 0; count < nAnimSets; count++) {
 
-	for (count = 0; count < LAYERS; count++) delete layers[count];
+		if (animSets[count]) delete[] animSets[count];
+		if (flippedAnimSets[count]) delete[] flippedAnimSets[count];
+		if (spritePixels[count]) delete[] spritePixels[count];
+
+	}
+
+	delete[] animSets;
+	delete[] flippedAnimSets;
+	delete[] spritePixels;
+	delete[] flippedSpriteSet;
+	delete[] spriteSet;
+
+	return;
+
+}
+
+
+/**
+ * Delete the tile set.
+ */
+JJ2TilesAsset::~JJ2TilesAsset () {
+
+	int count;
 
-	delete[] flippedMask;
 	delete[] mask;
+	delete[] maskColumns;
+	delete[] opaque;
 
-	delete[] musicFile;
-	delete[] nextLevel;
+	if (packedBlocks) {
 
-	for (count = 0; count < nAnimSets; count++) {
+		for (count = 0; count < ((tiles & 0xFFFF) + TILECACHE_BLOCK - 1) / TILECACHE_BLOCK; count++)
+			delete[] packedBlocks[count];
 
-		if (animSets[count]) delete[] animSets[count];
+		delete[] packedBlocks;
+		delete[] packedLengths;
+
+	} else {
+
+		delete[] tileImages;
+		if (tileSet) freeSurface(tileSet);
+		delete[] pixels;
 
 	}
 
-	delete[] animSets;
-	delete[] spriteSet;
+	return;
+
+}
+
+
+/**
+ * Make the tile set's surface, which draws on the decoded pixels in place.
+ * Compressed tile sets have none.
+ */
+void JJ2TilesAsset::finish () {
+
+	if (!pixels || tileSet) return;
+
+	tileSet = wrapSurface(pixels, TTOI(1), TTOI(tiles & 0xFFFF));
+
+	#ifdef SDL2
+	SDL_SetColorKey(tileSet, SDL_TRUE, 0);
+	#else
+	SDL_SetColorKey(tileSet, SDL_SRCCOLORKEY, 0);
+	#endif
+
+	return;
+
+}
 
-	SDL_FreeSurface(flippedTileSet);
-	SDL_FreeSurface(tileSet);
+
+/**
+ * Find how much memory the tile set takes.
+ *
+ * @return The size of the tile set
+ */
+int JJ2TilesAsset::getSize () {
+
+	int nTiles;
+
+	nTiles = tiles & 0xFFFF;
+
+	// Masks are kept as rows and as columns
+	if (packedBlocks) return packedSize + (nTiles << 8) + (nTiles * sizeof(bool));
+
+	return (nTiles << 10) + (nTiles << 8) + (nTiles * (sizeof(BlitImage) + sizeof(bool)));
+
+}
+
+
+/**
+ * Delete the JJ2 level.
+ */
+JJ2Level::~JJ2Level () {
+
+	int count;
+
+	deleteEvents();
+
+	for (count = 0; count < LAYERS; count++) delete layers[count];
+
+	delete[] musicFile;
+	delete[] nextLevel;
+	delete[] occlusion;
+	delete[] playerOrder;
+
+	if (tileCache) delete tileCache;
+#ifdef SDL2
+	if (expandedTiles) delete expandedTiles;
+#endif
+
+	// The tile set and sprites stay cached for later levels
+	assetCache.release(animsAsset);
+	assetCache.release(tilesAsset);
 
 	delete font;
 
@@ -111,6 +224,24 @@ JJ2Level::~JJ2Level () {
 }
 
 
+/**
+ * Delete the events in every region.
+ */
+void JJ2Level::deleteEvents () {
+
+	int count;
+
+	for (count = 0; count < regionsW * regionsH; count++) {
+
+		if (regions[count]) delete regions[count];
+
+	}
+
+	return;
+
+}
+
+
 /**
  * Determine whether or not the given point is solid when travelling upwards.
  *
@@ -135,8 +266,11 @@ bool JJ2Level::checkMaskUp (fixed x, fixed y) {
 	// Event 4 is hook
 	if ((mods[tY][tX].type == 1) || (mods[tY][tX].type == 3) || (mods[tY][tX].type == 4)) return false;
 
-	// Check the mask in the tile in question
-	return (layer->getFlipped(tX, tY)? flippedMask: mask)[(layer->getTile(tX, tY) << 10) + ((y >> 5) & 992) + ((x >> 10) & 31)];
+	// Check the mask in the tile in question, mirrored if the tile is flipped
+	if (layer->getFlipped(tX, tY))
+		return (mask[(layer->getTile(tX, tY) << 5) + ((y >> 10) & 31)] >> (31 - ((x >> 10) & 31))) & 1;
+
+	return (mask[(layer->getTile(tX, tY) << 5) + ((y >> 10) & 31)] >> ((x >> 10) & 31)) & 1;
 
 }
 
@@ -165,64 +299,390 @@ bool JJ2Level::checkMaskDown (fixed x, fixed y, bool drop) {
 	// Event 4 is hook
 	if (drop && ((mods[tY][tX].type == 3) || (mods[tY][tX].type == 4))) return false;
 
-	// Check the mask in the tile in question
-	return (layer->getFlipped(tX, tY)? flippedMask: mask)[(layer->getTile(tX, tY) << 10) + ((y >> 5) & 992) + ((x >> 10) & 31)];
+	// Check the mask in the tile in question, mirrored if the tile is flipped
+	if (layer->getFlipped(tX, tY))
+		return (mask[(layer->getTile(tX, tY) << 5) + ((y >> 10) & 31)] >> (31 - ((x >> 10) & 31))) & 1;
+
+	return (mask[(layer->getTile(tX, tY) << 5) + ((y >> 10) & 31)] >> ((x >> 10) & 31)) & 1;
 
 }
 
 
 /**
- * Set which level will come next.
+ * Get a column of the mask of the tile at the given grid position, mirrored if
+ * the tile is flipped.
  *
- * @param fileName Next level's file name
+ * @param tX Grid x-coordinate of the tile
+ * @param tY Grid y-coordinate of the tile
+ * @param x X-coordinate of the column
+ *
+ * @return The column, the top pixel in the lowest bit
  */
-void JJ2Level::setNext (char* fileName) {
+unsigned int JJ2Level::getMaskColumn (int tX, int tY, fixed x) {
 
-	unsigned char buffer[MTL_L_PROP];
+	if (layer->getFlipped(tX, tY))
+		return maskColumns[(layer->getTile(tX, tY) << 5) + (31 - ((x >> 10) & 31))];
 
-	delete[] nextLevel;
-	nextLevel = createString(fileName);
+	return maskColumns[(layer->getTile(tX, tY) << 5) + ((x >> 10) & 31)];
 
-	if (multiplayer) {
+}
 
-		buffer[0] = MTL_L_PROP;
-		buffer[1] = MT_L_PROP;
-		buffer[2] = 0; // set next level
-		buffer[3] = 0;
-		buffer[4] = 0;
 
-		game->send(buffer);
+/**
+ * Find how far below the given point the first pixel which is solid when
+ * travelling downwards lies, a tile at a time rather than a pixel at a time.
+ *
+ * @param x X-coordinate
+ * @param y Y-coordinate
+ * @param range The furthest distance to look, in pixels
+ * @param drop Whether or not the player is dropping
+ *
+ * @return The distance in pixels, or range + 1 if there is no solid pixel in range
+ */
+int JJ2Level::findFloorAt (fixed x, fixed y, int range, bool drop) {
+
+	unsigned int column;
+	int tX, tY, pixel, distance;
+
+	tX = FTOT(x);
+
+	// Anything off the edge of the map is solid
+	if ((x < 0) || (y < 0) || (tX >= layer->getWidth())) return 0;
+
+	pixel = FTOI(y);
+	distance = 0;
+
+	while (distance <= range) {
+
+		tY = pixel >> 5;
+
+		if (tY >= layer->getHeight()) return distance;
+
+		// Event 3 is vine
+		// Event 4 is hook
+		if (!drop || ((mods[tY][tX].type != 3) && (mods[tY][tX].type != 4))) {
+
+			column = getMaskColumn(tX, tY, x) >> (pixel & 31);
+
+			if (column) {
+
+				distance += __builtin_ctz(column);
+
+				return (distance <= range)? distance: range + 1;
+
+			}
+
+		}
+
+		// Move on to the top of the next tile down
+		distance += 32 - (pixel & 31);
+		pixel = (pixel | 31) + 1;
 
 	}
 
-	return;
+	return range + 1;
 
 }
 
 
 /**
- * Set the frame of the animated tile at the given location.
+ * Find how far above the given point the first pixel which is solid when
+ * travelling upwards lies, a tile at a time rather than a pixel at a time.
  *
- * @param gridX X-coordinate of the tile
- * @param gridY Y-coordinate of the tile
- * @param frame The new frame
+ * @param x X-coordinate
+ * @param y Y-coordinate
+ * @param range The furthest distance to look, in pixels
+ *
+ * @return The distance in pixels, or range + 1 if there is no solid pixel in range
+ */
+int JJ2Level::findCeilingAt (fixed x, fixed y, int range) {
+
+	unsigned int column;
+	int tX, tY, pixel, distance;
+
+	tX = FTOT(x);
+
+	// Anything off the edge of the map is solid
+	if ((x < 0) || (y < 0) || (tX >= layer->getWidth())) return 0;
+
+	pixel = FTOI(y);
+	distance = 0;
+
+	while (distance <= range) {
+
+		if (pixel < 0) return distance;
+
+		tY = pixel >> 5;
+
+		if (tY >= layer->getHeight()) return distance;
+
+		// Event 1 is one-way
+		// Event 3 is vine
+		// Event 4 is hook
+		if ((mods[tY][tX].type != 1) && (mods[tY][tX].type != 3) && (mods[tY][tX].type != 4)) {
+
+			// Keep the pixels at and above this one
+			column = getMaskColumn(tX, tY, x) & ((2u << (pixel & 31)) - 1);
+
+			if (column) {
+
+				distance += (pixel & 31) - (31 - __builtin_clz(column));
+
+				return (distance <= range)? distance: range + 1;
+
+			}
+
+		}
+
+		// Move on to the bottom of the next tile up
+		distance += (pixel & 31) + 1;
+		pixel = (pixel & ~31) - 1;
+
+	}
+
+	return range + 1;
+
+}
+
+
+/**
+ * Find how far below a horizontal span the first pixel which is solid when
+ * travelling downwards lies. The span is probed at its ends and its centre,
+ * like the player's own mask checks.
+ *
+ * @param left X-coordinate of the left of the span
+ * @param right X-coordinate of the right of the span
+ * @param y Y-coordinate
+ * @param range The furthest distance to look, in pixels
+ * @param drop Whether or not the player is dropping
+ *
+ * @return The distance in pixels, or range + 1 if there is no solid pixel in range
  */
-void JJ2Level::setFrame (int gridX, int gridY, unsigned char frame) {
+int JJ2Level::findFloor (fixed left, fixed right, fixed y, int range, bool drop) {
+
+	int distance, nearest;
+
+	nearest = findFloorAt(left, y, range, drop);
+
+	if (right == left) return nearest;
+
+	distance = findFloorAt((left + right) >> 1, y, nearest, drop);
+	if (distance < nearest) nearest = distance;
+
+	distance = findFloorAt(right, y, nearest, drop);
+	if (distance < nearest) nearest = distance;
+
+	return nearest;
+
+}
+
+
+/**
+ * Find how far above a horizontal span the first pixel which is solid when
+ * travelling upwards lies. The span is probed at its ends and its centre, like
+ * the player's own mask checks.
+ *
+ * @param left X-coordinate of the left of the span
+ * @param right X-coordinate of the right of the span
+ * @param y Y-coordinate
+ * @param range The furthest distance to look, in pixels
+ *
+ * @return The distance in pixels, or range + 1 if there is no solid pixel in range
+ */
+int JJ2Level::findCeiling (fixed left, fixed right, fixed y, int range) {
+
+	int distance, nearest;
 
-	unsigned char buffer[MTL_L_GRID];
+	nearest = findCeilingAt(left, y, range);
 
-	layer->setFrame(gridX, gridY, frame);
+	if (right == left) return nearest;
+
+	distance = findCeilingAt((left + right) >> 1, y, nearest);
+	if (distance < nearest) nearest = distance;
+
+	distance = findCeilingAt(right, y, nearest);
+	if (distance < nearest) nearest = distance;
+
+	return nearest;
+
+}
+
+
+/**
+ * Find how far to the left of the given point the first pixel which is solid
+ * when travelling upwards lies, a tile at a time rather than a pixel at a time.
+ *
+ * @param x X-coordinate
+ * @param y Y-coordinate
+ * @param range The furthest distance to look, in pixels
+ *
+ * @return The distance in pixels, or range + 1 if there is no solid pixel in range
+ */
+int JJ2Level::findWallLeft (fixed x, fixed y, int range) {
+
+	unsigned int row;
+	int tX, tY, pixel, distance;
+
+	tY = FTOT(y);
+
+	// Anything off the edge of the map is solid
+	if ((x < 0) || (y < 0) || (tY >= layer->getHeight())) return 0;
+
+	pixel = FTOI(x);
+	distance = 0;
+
+	while (distance <= range) {
+
+		if (pixel < 0) return distance;
+
+		tX = pixel >> 5;
+
+		if (tX >= layer->getWidth()) return distance;
+
+		// Event 1 is one-way
+		// Event 3 is vine
+		// Event 4 is hook
+		if ((mods[tY][tX].type != 1) && (mods[tY][tX].type != 3) && (mods[tY][tX].type != 4)) {
+
+			row = mask[(layer->getTile(tX, tY) << 5) + ((y >> 10) & 31)];
+
+			// Flipped tiles hold the pixels at and to the left of this one in
+			// the upper bits, and others in the lower bits
+			if (layer->getFlipped(tX, tY)) {
+
+				row >>= 31 - (pixel & 31);
+
+				if (row) {
+
+					distance += __builtin_ctz(row);
+
+					return (distance <= range)? distance: range + 1;
+
+				}
+
+			} else {
+
+				row &= (2u << (pixel & 31)) - 1;
+
+				if (row) {
+
+					distance += (pixel & 31) - (31 - __builtin_clz(row));
+
+					return (distance <= range)? distance: range + 1;
+
+				}
+
+			}
+
+		}
+
+		// Move on to the right of the next tile to the left
+		distance += (pixel & 31) + 1;
+		pixel = (pixel & ~31) - 1;
+
+	}
+
+	return range + 1;
+
+}
+
+
+/**
+ * Find how far to the right of the given point the first pixel which is solid
+ * when travelling upwards lies, a tile at a time rather than a pixel at a time.
+ *
+ * @param x X-coordinate
+ * @param y Y-coordinate
+ * @param range The furthest distance to look, in pixels
+ *
+ * @return The distance in pixels, or range + 1 if there is no solid pixel in range
+ */
+int JJ2Level::findWallRight (fixed x, fixed y, int range) {
+
+	unsigned int row;
+	int tX, tY, pixel, distance;
+
+	tY = FTOT(y);
+
+	// Anything off the edge of the map is solid
+	if ((x < 0) || (y < 0) || (tY >= layer->getHeight())) return 0;
+
+	pixel = FTOI(x);
+	distance = 0;
+
+	while (distance <= range) {
+
+		tX = pixel >> 5;
+
+		if (tX >= layer->getWidth()) return distance;
+
+		// Event 1 is one-way
+		// Event 3 is vine
+		// Event 4 is hook
+		if ((mods[tY][tX].type != 1) && (mods[tY][tX].type != 3) && (mods[tY][tX].type != 4)) {
+
+			row = mask[(layer->getTile(tX, tY) << 5) + ((y >> 10) & 31)];
+
+			// Flipped tiles hold the pixels at and to the right of this one in
+			// the lower bits, and others in the upper bits
+			if (layer->getFlipped(tX, tY)) {
+
+				row &= (2u << (31 - (pixel & 31))) - 1;
+
+				if (row) {
+
+					distance += (31 - (pixel & 31)) - (31 - __builtin_clz(row));
+
+					return (distance <= range)? distance: range + 1;
+
+				}
+
+			} else {
+
+				row >>= pixel & 31;
+
+				if (row) {
+
+					distance += __builtin_ctz(row);
+
+					return (distance <= range)? distance: range + 1;
+
+				}
+
+			}
+
+		}
+
+		// Move on to the left of the next tile to the right
+		distance += 32 - (pixel & 31);
+		pixel = (pixel | 31) + 1;
+
+	}
+
+	return range + 1;
+
+}
+
+
+/**
+ * Set which level will come next.
+ *
+ * @param fileName Next level's file name
+ */
+void JJ2Level::setNext (char* fileName) {
+
+	unsigned char buffer[MTL_L_PROP];
+
+	delete[] nextLevel;
+	nextLevel = createString(fileName);
 
 	if (multiplayer) {
 
-		buffer[0] = MTL_L_GRID;
-		buffer[1] = MT_L_GRID;
-		buffer[2] = gridX & 0xFF;
-		buffer[3] = gridY & 0xFF;
-		buffer[4] = 0; // tile variable
-		buffer[5] = frame;
-		buffer[6] = (gridX >> 8) & 0xFF;
-		buffer[7] = (gridY >> 8) & 0xFF;
+		buffer[0] = MTL_L_PROP;
+		buffer[1] = MT_L_PROP;
+		buffer[2] = 0; // set next level
+		buffer[3] = 0;
+		buffer[4] = 0;
 
 		game->send(buffer);
 
@@ -353,31 +813,109 @@ fixed JJ2Level::getWaterLevel () {
 
 
 /**
- * Move a player to a warp target.
+ * Keep the players in order of x-coordinate. Players only move a little
+ * between steps, so the order from the last time is nearly right already.
+ */
+void JJ2Level::sortPlayers () {
+
+	fixed playerX;
+	int count, place, index;
+
+	// Players joining or leaving upset the order
+	if (nSorted != nPlayers) {
+
+		for (count = 0; count < nPlayers; count++) playerOrder[count] = count;
+
+		nSorted = nPlayers;
+
+	}
+
+	for (count = 1; count < nSorted; count++) {
+
+		index = playerOrder[count];
+		playerX = players[index].getJJ2LevelPlayer()->getX();
+
+		for (place = count; (place > 0) &&
+			(players[playerOrder[place - 1]].getJJ2LevelPlayer()->getX() > playerX); place--)
+			playerOrder[place] = playerOrder[place - 1];
+
+		playerOrder[place] = index;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Find the players who may be touching an area, from the extents of the
+ * players sorted by x-coordinate. Their y-coordinates are left to be checked.
+ * Players who move must be sorted again before this is next used.
  *
- * @param player The player to move
- * @param id The warp target ID
+ * @param left The x-coordinate of the left of the area
+ * @param width The width of the area
+ * @param found Set to the numbers of the players found, in order of number
+ *
+ * @return The number of players found
  */
-void JJ2Level::warp (JJ2LevelPlayer *player, int id) {
+int JJ2Level::findPlayers (fixed left, fixed width, int* found) {
 
-	int x, y;
+	int first, last, middle, count, place, index, nFound;
 
-	for (y = 0; y < layer->getHeight(); y++) {
+	// Find the first player whose right edge reaches the area
+	first = 0;
+	last = nSorted;
 
-		for (x = 0; x < layer->getWidth(); x++) {
+	while (first < last) {
 
-			if ((mods[y][x].type == 240) && ((mods[y][x].properties & 255) == id)) {
+		middle = (first + last) >> 1;
 
-				player->setPosition(TTOF(x), TTOF(y));
+		if (players[playerOrder[middle]].getJJ2LevelPlayer()->getX() + JJ2PXO_R < left) first = middle + 1;
+		else last = middle;
 
-				return;
+	}
 
-			}
+	// Take players until their left edges pass the area
+	nFound = 0;
 
-		}
+	for (count = first; (count < nSorted) &&
+		(players[playerOrder[count]].getJJ2LevelPlayer()->getX() + JJ2PXO_L < left + width); count++) {
+
+		// Players touch in order of number, as they always have
+		index = playerOrder[count];
+
+		for (place = nFound; (place > 0) && (found[place - 1] > index); place--)
+			found[place] = found[place - 1];
+
+		found[place] = index;
+		nFound++;
 
 	}
 
+	return nFound;
+
+}
+
+
+/**
+ * Move a player to a warp target.
+ *
+ * @param player The player to move
+ * @param id The warp target ID
+ */
+void JJ2Level::warp (JJ2LevelPlayer *player, int id) {
+
+	int target;
+
+	// Targets were found when the level was loaded
+	target = warpTargets[id & 255];
+
+	if (target >= 0)
+		player->setPosition(TTOF(target % layer->getWidth()), TTOF(target / layer->getWidth()));
+
+	return;
+
 }
 
 
@@ -405,12 +943,6 @@ void JJ2Level::receive (unsigned char* buffer) {
 
 			break;
 
-		case MT_L_GRID:
-
-			if (buffer[4] == 0) layer->setFrame(buffer[2] + (buffer[6] << 8), buffer[3] + (buffer[7] << 8), buffer[5]);
-
-			break;
-
 		case MT_L_STAGE:
 
 			stage = LevelStage(buffer[2]);
@@ -424,6 +956,24 @@ void JJ2Level::receive (unsigned char* buffer) {
 }
 
 
+/**
+ * Move on to the next level.
+ *
+ * @return Error code
+ */
+int JJ2Level::advance () {
+
+	int ret;
+
+	ret = game->setLevel(nextLevel);
+
+	if (ret < 0) return ret;
+
+	return WON;
+
+}
+
+
 /**
  * Play the level.
  *
@@ -435,7 +985,7 @@ int JJ2Level::play () {
 	bool pmessage, pmenu;
 	int option;
 	unsigned int returnTime;
-	int count, ret;
+	int ret;
 
 
 	jj2LevelPlayer = localPlayer->getJJ2LevelPlayer();
@@ -461,36 +1011,40 @@ int JJ2Level::play () {
 
 
 		// Check if level has been won
-		if (game && returnTime && (ticks > returnTime)) {
+		if (game && returnTime && (ticks > returnTime)) return advance();
 
-			ret = game->setLevel(nextLevel);
 
-			if (ret < 0) return ret;
-
-			return WON;
-
-		}
+		// Process frame-by-frame activity
 
+		while (takeStep()) {
 
-		// Process frame-by-frame activity
+			// Apply controls to local player, recorded or played back
+			// A followed player is controlled by the server
+			ret = (game && game->isSpectating())? E_NONE: replay.control(localPlayer);
 
-		while (getTimeChange() >= T_STEP) {
+			if (ret < 0) return ret;
 
-			// Apply controls to local player
-			for (count = 0; count < PCONTROLS; count++)
-				localPlayer->setControl(count, controls.getState(count));
+			controlSecond();
 
+			PROFILE_BEGIN(PZ_STEP);
 			ret = step();
+			PROFILE_END(PZ_STEP);
 			steps++;
 
 			if (ret) return ret;
 
+			ret = checkState();
+
+			if (ret < 0) return ret;
+
 		}
 
 
 		// Draw the graphics
 
+		PROFILE_BEGIN(PZ_DRAW);
 		draw();
+		PROFILE_END(PZ_DRAW);
 
 
 		// If paused, draw "PAUSE"
@@ -513,6 +1067,10 @@ int JJ2Level::play () {
 				returnTime = ticks + 3000;
 				playSound(S_UPLOOP);
 
+				// Decode the next level's tile set and load its music while the
+				// statistics are shown
+				if (game) assetCache.preload(preload, nextLevel);
+
 			}
 
 			// Display statistics
@@ -30,6 +30,7 @@
 
 
 #include "level/level.h"
+#include "io/assetcache.h"
 #include "io/gfx/anim.h"
 #include "OpenJazz.h"
 
@@ -39,6 +40,27 @@
 // Number of layers
 #define LAYERS 8
 
+// Animated tiles
+#define JJ2ANIMTILES 128 /* Maximum number of animated tiles */
+#define JJ2WARPS 256 /* Number of possible warp IDs */
+#define JJ2REGION 4 /* Event regions are (1 << JJ2REGION) tiles square */
+#define JJ2ACTIVE 1 /* Events are processed in regions up to this many regions from a player's */
+#define JJ2ANIMFRAMES 64 /* Maximum number of frames in an animated tile */
+
+#define MAX_SPRITE_THREADS 3 /* Jobs helping to decode animation sets */
+#define MAX_TILE_THREADS 3 /* Jobs helping to prepare tiles */
+#define TILE_CHUNK 64 /* Tiles prepared by a job at a time */
+#define MAX_EVENT_THREADS 3 /* Jobs helping to step independent events */
+#define EVENT_CHUNK 4 /* Regions of events stepped by a job at a time */
+#define MAX_LAYER_THREADS 7 /* Jobs helping to draw layers */
+#define LAYER_BAND 64 /* Height of the bands of the canvas in which layers are drawn */
+#define LAYER_BLOCK 6 /* Layers are expanded in blocks (1 << LAYER_BLOCK) tiles square */
+
+// Tile sets kept compressed
+#define TILECACHE_MIN   1024 /* Tile sets with more tiles than this are kept compressed */
+#define TILECACHE_BLOCK 16 /* Tiles compressed together */
+#define TILECACHE_SLOTS 1024 /* Tiles kept decompressed at once */
+
 // Player animations
 #define JJ2PA_BOARD        0
 #define JJ2PA_BOARDSW      1
@@ -124,17 +146,37 @@
 // Black palette index
 #define JJ2_BLACK 0
 
+// Layer tiles, packed into 16 bits
+#define JJ2_TILE    0x0FFF /* Number of the tile in the tile set, or of the animated tile */
+#define JJ2_FLIPPED 0x8000 /* Whether or not the tile image and mask are flipped */
+
 
 // Datatypes
 
-/// JJ2 level tile
+/// JJ2 level animated tile
+typedef struct {
+
+	unsigned short int frames[JJ2ANIMFRAMES]; ///< Tiles shown in turn
+	int                nFrames;      ///< Number of frames
+	int                speed;        ///< Frames per second
+	int                frameWait;    ///< Frames for which the last frame is held at the end of each cycle
+	int                pingPongWait; ///< Frames for which the last frame is held before playing backwards
+	bool               pingPong;     ///< Whether or not the frames are played backwards after playing forwards
+
+} JJ2AnimatedTile;
+
+/// JJ2 animation set waiting to be decoded
 typedef struct {
 
-	unsigned short int tile;    ///< Indexes the tile set
-	unsigned char      frame;   ///< Current frame being used (for animated tiles)
-	bool               flipped; ///< Whether or not the tile image and mask are flipped
+	unsigned char* blocks[3]; ///< Compressed animation, frame and pixel data
+	int            compressedLengths[3]; ///< Lengths of the compressed blocks
+	int            lengths[3]; ///< Lengths of the blocks once decompressed
+	int            anims; ///< Number of animations
+	int            firstSprite; ///< Index of the set's first sprite
+	int            sprites; ///< Number of sprites
+	int            atlasSize; ///< Number of bytes in the set's packed pixels
 
-} JJ2Tile;
+} JJ2AnimSetLoad;
 
 /// JJ2 level tile modifier event
 typedef struct {
@@ -147,38 +189,145 @@ typedef struct {
 
 // Classes
 
+class BlitImage;
+class ExpandedSet;
 class Font;
+class JJ2TileCache;
 
 ///< JJ2 level parallaxing layer
 class JJ2Layer {
 
 	private:
-		JJ2Tile** grid; ///< Layer tiles
-		int       width; ///< Width (in tiles)
-		int       height; ///< Height (in tiles)
-		bool      tileX; ///< Repeat horizontally
-		bool      tileY; ///< Repeat vertically
-		bool      limit; ///< Do not view beyond edges
-		bool      warp; ///< Warp effect
-		fixed     xSpeed; ///< Relative horizontal speed
-		fixed     ySpeed; ///< Relative vertical speed
+		unsigned short int** blocks; ///< Layer tiles, in blocks of rows, or NULL for each block not yet expanded (allocated from the level's arena)
+		unsigned short int*  words; ///< The dictionary word of each group of four tiles, row by row (allocated from the level's arena)
+		unsigned char*       dictionary; ///< The level's dictionary of groups of four tiles (allocated from the level's arena)
+		int                  wordPitch; ///< Words per row
+		int                  blocksW; ///< Width (in blocks)
+		int                  blocksH; ///< Height (in blocks)
+		unsigned int*        occupancy; ///< A bit for each cell of the expanded blocks holding a tile, row by row (allocated from the level's arena)
+		int                  occupancyPitch; ///< Words of the occupancy bitmap per row
+		int                  occupied; ///< Number of cells of the expanded blocks holding a tile
+		unsigned short int*  animFrames; ///< Current frame of each animated tile (owned by the level)
+		int                  animOffset; ///< Number of the first animated tile
+		int                  nAnimTiles; ///< Number of animated tiles
+		int                  tiles; ///< The total number of tiles
+		bool                 TSF; ///< Whether or not the tiles are TSF tiles
+		Arena*               arena; ///< The level's arena, from which to allocate blocks
+		int                  width; ///< Width (in tiles)
+		int                  height; ///< Height (in tiles)
+		bool                 tileX; ///< Repeat horizontally
+		bool                 tileY; ///< Repeat vertically
+		bool                 limit; ///< Do not view beyond edges
+		bool                 warp; ///< Warp effect
+		fixed                xSpeed; ///< Relative horizontal speed
+		fixed                ySpeed; ///< Relative vertical speed
+
+		void                expandBlock (int blockX, int blockY);
+		unsigned short int* getCell     (int x, int y);
+		unsigned short int  getFrame    (unsigned short int tile);
+		void                getView     (int* vX, int* vY);
 
 	public:
-		JJ2Layer  ();
-		JJ2Layer  (int flags, int newWidth, int newHeight, fixed newXSpeed, fixed newYSpeed);
+		JJ2Layer  (Arena* newArena);
+		JJ2Layer  (int flags, int newWidth, int newHeight, fixed newXSpeed, fixed newYSpeed, Arena* newArena);
 		~JJ2Layer ();
 
-		bool getFlipped (int x, int y);
-		int  getHeight  ();
-		int  getTile    (int x, int y);
-		int  getWidth   ();
-		void setFrame   (int x, int y, unsigned char frame);
-		void setTile    (int x, int y, unsigned short int tile, bool TSF, int tiles);
+		bool getFlipped       (int x, int y);
+		int  getHeight        ();
+		int  getTile          (int x, int y);
+		int  getWidth         ();
+		void setAnimatedTiles (unsigned short int* frames, int offset, int count);
+		void setWords         (unsigned short int* newWords, int pitch, unsigned char* newDictionary, bool newTSF, int newTiles, bool lazy);
+
+		void reveal           ();
+		void occlude          (bool* opaqueTiles, unsigned char* occlusion, int depth);
+		void cacheTiles       (JJ2TileCache* tileCache);
+		void draw             (BlitImage* tileImages, JJ2TileCache* tileCache, SDL_Rect* band, unsigned char* occlusion, int depth, Uint32* trueCanvas, ExpandedSet* expandedTiles);
+
+};
+
+/// JJ2 animation sets and sprites, decoded from anims.j2a
+class JJ2AnimsAsset : public Asset {
+
+	public:
+		Sprite*         spriteSet; ///< Sprite images
+		Sprite*         flippedSpriteSet; ///< Sprite images (flipped)
+		unsigned char** spritePixels; ///< Pixels of each animation set's sprites, packed together
+		Anim**          animSets; ///< Animation sets
+		Anim**          flippedAnimSets; ///< Animation sets (flipped)
+		int             nAnimSets; ///< Number of animation sets
+
+		~JJ2AnimsAsset ();
+
+};
+
+/// JJ2 tile set, decoded from a .j2t file
+class JJ2TilesAsset : public Asset {
 
-		void draw       (SDL_Surface* tileSet, SDL_Surface* flippedTileSet);
+	public:
+		SDL_Color       palette[256]; ///< Tile set palette
+		unsigned char*  pixels; ///< Tile images' pixels, or NULL if the tiles are kept compressed
+		SDL_Surface*    tileSet; ///< Tile images, or NULL if the tiles are kept compressed or until the asset is finished
+		BlitImage*      tileImages; ///< Tile images prepared for drawing, or NULL if the tiles are kept compressed
+		unsigned char** packedBlocks; ///< Tile images compressed in blocks of TILECACHE_BLOCK, or NULL if the tiles are kept whole
+		int*            packedLengths; ///< Length of each compressed block
+		int             packedSize; ///< Total length of the compressed blocks
+		bool*           opaque; ///< Whether or not each tile is drawn fully opaque
+		unsigned int*   mask; ///< Tile masks, a bit per pixel and 32 bits per row
+		unsigned int*   maskColumns; ///< Tile masks, a bit per pixel and 32 bits per column
+		int             tiles; ///< The number of tiles and the maximum possible number of tiles
+
+		~JJ2TilesAsset ();
+
+		void finish  ();
+		int  getSize ();
+
+};
+
+/// Tiles of a compressed tile set, decompressed as they are first drawn and
+/// kept until others need their room, least recently drawn first. Used only
+/// on the main thread, except that images found are drawn on any.
+class JJ2TileCache {
+
+	private:
+		JJ2TilesAsset* asset; ///< The tile set
+		unsigned char* pixels; ///< Pixels of the tile in each slot
+		BlitImage*     images; ///< Image of the tile in each slot
+		short int*     slotTiles; ///< The tile in each slot, or -1
+		short int*     tileSlots; ///< The slot holding each tile, or -1
+		short int*     newer; ///< The slot drawn next after each slot, or -1
+		short int*     older; ///< The slot drawn last before each slot, or -1
+		unsigned int*  slotFrames; ///< The frame in which each slot was last drawn
+		short int      newest; ///< The slot drawn most recently
+		short int      oldest; ///< The slot drawn least recently
+		unsigned char* block; ///< A decompressed block of tiles
+		int            blockNumber; ///< The block held decompressed, or -1
+		unsigned int   frame; ///< Number of the current frame
+
+		void unlink  (int slot);
+		bool unpack  (int tile, int slot);
+
+	public:
+		JJ2TileCache  (JJ2TilesAsset* tilesAsset);
+		~JJ2TileCache ();
+
+		void       startFrame ();
+		void       fetch      (int tile);
+		BlitImage* getImage   (int tile);
 
 };
 
+/// JJ2 tile set being prepared, shared between the jobs preparing it
+typedef struct {
+
+	JJ2TilesAsset* asset; ///< The tile set
+	unsigned char* tileBuffer; ///< Tile images, as stored in the file
+	unsigned char* maskBuffer; ///< Tile masks, as stored in the file
+	int            tiles; ///< Number of tiles
+	SDL_atomic_t   nextChunk; ///< The next chunk of tiles to be prepared
+
+} JJ2TilesLoad;
+
 class JJ2Event;
 class JJ2LevelPlayer;
 
@@ -186,51 +335,113 @@ class JJ2LevelPlayer;
 class JJ2Level : public Level {
 
 	private:
+		JJ2TilesAsset* tilesAsset; ///< Tile set, shared with other levels
+		JJ2AnimsAsset* animsAsset; ///< Animation sets and sprites, shared with other levels
 		SDL_Surface*  tileSet; ///< Tile images
-		SDL_Surface*  flippedTileSet; ///< Tile images (flipped)
-		JJ2Event*     events; ///< "Movable" events
+		BlitImage*    tileImages; ///< Tile images prepared for drawing, or NULL if the tiles are kept compressed
+		JJ2TileCache* tileCache; ///< Tiles decompressed as they are drawn, or NULL if the tiles are kept whole
+		ExpandedSet*  expandedTiles; ///< Tile images expanded for the 32-bit canvas, or NULL if not in true-colour mode or the tiles are kept compressed
+		Uint32*       trueCanvas; ///< The 32-bit canvas tiles are drawn into this frame, or NULL
+		bool*         opaqueTiles; ///< Whether or not each tile is drawn fully opaque
+		unsigned char* occlusion; ///< The foremost layer covering each 32-pixel cell of the canvas with opaque tiles, or LAYERS
+		int           occlusionSize; ///< Number of cells occlusion has room for
+		JJ2Event**    regions; ///< "Movable" events, by the region of the level they are in (allocated from the arena)
+		unsigned int* regionSteps; ///< The step on which each region's events were last processed (allocated from the arena)
+		unsigned int  regionStep; ///< Number of the current step, for regionSteps
+		int*          activeRegions; ///< Regions being processed this step, in order, less 1 and negated if not independent (allocated from the arena)
+		int           nActiveRegions; ///< Number of regions being processed this step
+		SDL_atomic_t  nextActive; ///< The next chunk of active regions to be stepped
+		unsigned int  eventTicks; ///< Time at which events are being stepped
+		int           eventMsps; ///< Ticks per step at which events are being stepped
+		SDL_atomic_t  nextBand; ///< The next band of the canvas in which to draw layers
+		int           nBands; ///< Number of bands of the canvas
+		int           bandBack; ///< Rearmost layer being drawn in the bands
+		int           bandFront; ///< Foremost layer being drawn in the bands
+		int           regionsW; ///< Width of the level, in regions
+		int           regionsH; ///< Height of the level, in regions
 		Font*         font; ///< On-screen message font
-		char*         mask; ///< Tile masks
-		char*         flippedMask; ///< Tile masks (flipped)
+		unsigned int* mask; ///< Tile masks, a bit per pixel and 32 bits per row
+		unsigned int* maskColumns; ///< Tile masks, a bit per pixel and 32 bits per column
 		char*         musicFile; ///< Music file name
 		char*         nextLevel; ///< Next level file name
 		Sprite*       spriteSet; ///< Sprite images
 		Sprite*       flippedSpriteSet; ///< Sprite images (flipped)
+		unsigned char** spritePixels; ///< Pixels of each animation set's sprites, packed together
 		Anim**        animSets; ///< Animation sets
 		Anim**        flippedAnimSets; ///< Animation sets (flipped)
 		char          playerAnims[JJ2PANIMS]; ///< Player animations
 		JJ2Layer*     layers[LAYERS]; ///< All layers
 		JJ2Layer*     layer; ///< Layer 4
-		JJ2Modifier** mods; ///< Modifier events for each tile in layer 4
+		JJ2Modifier** mods; ///< Modifier events for each tile in layer 4 (allocated from the arena)
+		int           warpTargets[JJ2WARPS]; ///< Grid index (y * width + x) of each warp ID's target, or -1 if none
+		JJ2AnimatedTile animTiles[JJ2ANIMTILES]; ///< Animated tiles
+		unsigned short int animFrames[JJ2ANIMTILES]; ///< Current frame of each animated tile
+		int           animOffset; ///< Number of the first animated tile
+		int           nAnimTiles; ///< Number of animated tiles
 		int           nAnimSets; ///< Number of animation sets
 		bool          TSF; ///< 1.24 level
 		fixed         waterLevel; ///< Height of water
 		fixed         waterLevelTarget; ///< Future height of water
 		fixed         waterLevelSpeed; ///< Rate of water level change
-
-		void createEvent (int x, int y, unsigned char* data);
-		int  load        (char* fileName, bool checkpoint);
-		void loadSprite  (unsigned char* parameters, unsigned char* compressedPixels, Sprite* sprite, Sprite* flippedSprite);
-		int  loadSprites ();
-		int  loadTiles   (char* fileName);
-
-		int  step        ();
-		void draw        ();
+		JJ2AnimSetLoad* setLoads; ///< Animation sets being decoded
+		SDL_atomic_t  nextSetLoad; ///< The next animation set to be decoded
+		int*          playerOrder; ///< Players in order of x-coordinate
+		int           nSorted; ///< Number of players in playerOrder
+
+		static JJ2TilesAsset* decodeTiles  (const char* fileName);
+		static void           prepareTiles (JJ2TilesLoad* load);
+		static void           tileJob      (void* data);
+		static void           spriteJob    (void* data);
+		static void           eventJob     (void* data);
+		static void           layerJob     (void* data);
+
+		unsigned int getMaskColumn (int tX, int tY, fixed x);
+		int          findFloorAt   (fixed x, fixed y, int range, bool drop);
+		int          findCeilingAt (fixed x, fixed y, int range);
+
+		void animateTiles      ();
+		void deleteEvents      ();
+		void stepIndependent   ();
+		void drawBands         ();
+		void occludeLayers     ();
+		void drawLayers        (int back, int front);
+		void processEvents     (unsigned int ticks, int msps);
+		void createEvent       (int x, int y, unsigned char* data);
+		int  load              (char* fileName, bool checkpoint);
+		void loadAnimatedTiles (unsigned char* buffer, int length, int tiles);
+		void loadAnimSet       (int set);
+		void loadAnimSets      ();
+		int  loadSprites       ();
+		int  loadTiles         (char* fileName);
+
+		int  step              ();
+		void calcView          (fixed alpha);
+		void drawView          (fixed alpha);
+		void draw              ();
+		int  advance           ();
 
 	public:
 		JJ2Level  (Game* owner, char* fileName, bool checkpoint, bool multi);
 		~JJ2Level ();
 
+		static void preload    (const char* fileName);
+		static void loadSprite (unsigned char* parameters, unsigned char* compressedPixels, unsigned char* pixels, Sprite* sprite, Sprite* flippedSprite);
+
 		bool         checkMaskDown (fixed x, fixed y, bool drop);
 		bool         checkMaskUp   (fixed x, fixed y);
+		int          findFloor     (fixed left, fixed right, fixed y, int range, bool drop);
+		int          findCeiling   (fixed left, fixed right, fixed y, int range);
+		int          findPlayers   (fixed left, fixed width, int* found);
+		int          findWallLeft  (fixed x, fixed y, int range);
+		int          findWallRight (fixed x, fixed y, int range);
 		Anim*        getAnim       (int set, int anim, bool flipped);
 		Anim*        getPlayerAnim (int character, int anim, bool flipped);
 		JJ2Modifier* getModifier   (int gridX, int gridY);
 		Sprite*      getSprite     (unsigned char sprite);
 		fixed        getWaterLevel ();
-		void         setFrame      (int gridX, int gridY, unsigned char frame);
 		void         setNext       (char* fileName);
 		void         setWaterLevel (int gridY, bool instant);
+		void         sortPlayers   ();
 		void         warp          (JJ2LevelPlayer *player, int id);
 
 		void         receive       (unsigned char* buffer);
@@ -31,10 +31,252 @@
 #include "game/game.h"
 #include "game/gamemode.h"
 #include "io/controls.h"
+#include "io/gfx/blitter.h"
 #include "io/gfx/font.h"
 #include "io/gfx/video.h"
+#include "jobs.h"
+#include "level/benchmark.h"
 #include "util.h"
 
+#include <string.h>
+
+
+/**
+ * Find the current frame of each animated tile from the level tick.
+ */
+void JJ2Level::animateTiles () {
+
+	JJ2AnimatedTile* animTile;
+	unsigned short int* frame;
+	int count, depth, length, position;
+
+	for (count = 0; count < nAnimTiles; count++) {
+
+		animTile = animTiles + count;
+
+		if (!animTile->nFrames) continue;
+
+		/* A cycle plays the frames forwards, then holds the last frame. If the
+		tile ping-pongs, the frames are then played backwards and the first
+		frame held instead */
+		length = animTile->nFrames + animTile->frameWait;
+		if (animTile->pingPong) length += animTile->pingPongWait + animTile->nFrames - 1;
+
+		position = (((ticks / 1000) * animTile->speed) + (((ticks % 1000) * animTile->speed) / 1000)) % length;
+
+		if (position >= animTile->nFrames) {
+
+			position -= animTile->nFrames;
+
+			if (animTile->pingPong && (position >= animTile->pingPongWait)) {
+
+				position -= animTile->pingPongWait;
+
+				if (position < animTile->nFrames - 1) position = animTile->nFrames - 2 - position;
+				else position = 0;
+
+			} else position = animTile->nFrames - 1;
+
+		}
+
+		animFrames[count] = animTile->frames[position];
+
+	}
+
+	// Frames may themselves be animated tiles
+	for (depth = 0; depth < 4; depth++) {
+
+		for (count = 0; count < nAnimTiles; count++) {
+
+			frame = animFrames + count;
+
+			if (((*frame & JJ2_TILE) >= animOffset) && ((*frame & JJ2_TILE) < animOffset + nAnimTiles))
+				*frame = animFrames[(*frame & JJ2_TILE) - animOffset] ^ (*frame & JJ2_FLIPPED);
+
+		}
+
+	}
+
+	// Give up on any that still refer to other animated tiles
+	for (count = 0; count < nAnimTiles; count++) {
+
+		frame = animFrames + count;
+
+		if (((*frame & JJ2_TILE) >= animOffset) && ((*frame & JJ2_TILE) < animOffset + nAnimTiles))
+			*frame = 0;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Independent event stepping job.
+ *
+ * @param data The JJ2 level
+ */
+void JJ2Level::eventJob (void* data) {
+
+	((JJ2Level *)data)->stepIndependent();
+
+	return;
+
+}
+
+
+/**
+ * Step the active regions whose events are all independent, a chunk at a
+ * time, until there are none left. Run on any number of threads at once.
+ */
+void JJ2Level::stepIndependent () {
+
+	JJ2Event** region;
+	int chunk, count;
+
+	while ((chunk = SDL_AtomicAdd(&nextActive, 1) * EVENT_CHUNK) < nActiveRegions) {
+
+		for (count = chunk; (count < chunk + EVENT_CHUNK) && (count < nActiveRegions); count++) {
+
+			if (activeRegions[count] < 0) continue;
+
+			region = regions + activeRegions[count];
+			if (*region) *region = (*region)->step(eventTicks, eventMsps);
+
+		}
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Process the events in regions near any player. Events elsewhere sleep, and
+ * as they never move from their regions, they cannot come into contact with a
+ * player while asleep.
+ * Regions whose events are all independent are stepped alongside each other
+ * when there are cores to spare, leaving contact with players until they are
+ * all done. Contact, then the regions which are not independent, are then
+ * handled region by region in the same order as they would otherwise be, so
+ * the outcome is the same however many cores there are.
+ *
+ * @param ticks Time
+ * @param msps Ticks per step
+ */
+void JJ2Level::processEvents (unsigned int ticks, int msps) {
+
+	Job eventJobs[MAX_EVENT_THREADS];
+	Job eventsDone;
+	JJ2LevelPlayer* levelPlayer;
+	JJ2Event** region;
+	int left, right, top, bottom;
+	int count, x, y, index;
+
+	regionStep++;
+	nActiveRegions = 0;
+
+	// Players have moved since events were last processed
+	sortPlayers();
+
+	for (count = 0; count < nPlayers; count++) {
+
+		levelPlayer = players[count].getJJ2LevelPlayer();
+
+		left = (FTOT(levelPlayer->getX()) >> JJ2REGION) - JJ2ACTIVE;
+		right = (FTOT(levelPlayer->getX()) >> JJ2REGION) + JJ2ACTIVE;
+		top = (FTOT(levelPlayer->getY()) >> JJ2REGION) - JJ2ACTIVE;
+		bottom = (FTOT(levelPlayer->getY()) >> JJ2REGION) + JJ2ACTIVE;
+
+		if (left < 0) left = 0;
+		if (right >= regionsW) right = regionsW - 1;
+		if (top < 0) top = 0;
+		if (bottom >= regionsH) bottom = regionsH - 1;
+
+		for (y = top; y <= bottom; y++) {
+
+			for (x = left; x <= right; x++) {
+
+				index = (y * regionsW) + x;
+
+				// Regions near more than one player are only processed once
+				if (regionSteps[index] == regionStep) continue;
+
+				regionSteps[index] = regionStep;
+
+				// Empty regions have nothing to do
+				if (!regions[index]) continue;
+
+				if (regions[index]->allIndependent()) activeRegions[nActiveRegions++] = index;
+				else activeRegions[nActiveRegions++] = -1 - index;
+
+			}
+
+		}
+
+	}
+
+
+	// A single chunk is not worth sharing out
+	if (jobs.getWorkers() && (nActiveRegions > EVENT_CHUNK)) {
+
+		eventTicks = ticks;
+		eventMsps = msps;
+		SDL_AtomicSet(&nextActive, 0);
+		JJ2Event::deferContacts = true;
+
+		jobs.prepare(&eventsDone, NULL, NULL, NULL, false);
+
+		for (count = 0; (count < MAX_EVENT_THREADS) && (count < jobs.getWorkers()) &&
+			(count * EVENT_CHUNK < nActiveRegions); count++) {
+
+			jobs.prepare(eventJobs + count, eventJob, this, &eventsDone, false);
+			jobs.submit(eventJobs + count);
+
+		}
+
+		stepIndependent();
+
+		jobs.submit(&eventsDone);
+		jobs.wait(&eventsDone);
+
+		JJ2Event::deferContacts = false;
+
+		for (count = 0; count < nActiveRegions; count++) {
+
+			if (activeRegions[count] < 0) {
+
+				region = regions - 1 - activeRegions[count];
+				if (*region) *region = (*region)->step(ticks, msps);
+
+			} else {
+
+				region = regions + activeRegions[count];
+				if (*region) (*region)->applyContacts(ticks, msps);
+
+			}
+
+		}
+
+	} else {
+
+		for (count = 0; count < nActiveRegions; count++) {
+
+			if (activeRegions[count] < 0) region = regions - 1 - activeRegions[count];
+			else region = regions + activeRegions[count];
+
+			if (*region) *region = (*region)->step(ticks, msps);
+
+		}
+
+	}
+
+	return;
+
+}
+
 
 /**
  * JJ2 level iteration.
@@ -51,17 +293,27 @@ int JJ2Level::step () {
 	msps = T_STEP;
 
 
+	// Animate tiles
+	animateTiles();
+
+
 	// Determine the players' trajectories
+	bench.enter(BS_PLAYERS);
 	for (x = 0; x < nPlayers; x++) players[x].getJJ2LevelPlayer()->control(ticks, msps);
+	bench.leave(BS_PLAYERS);
 
 
-	// Process events
-	if (events) events = events->step(ticks, msps);
+	// Process the events near players, leaving the others asleep
+	bench.enter(BS_EVENTS);
+	processEvents(ticks, msps);
+	bench.leave(BS_EVENTS);
 
 
 	// Apply as much of those trajectories as possible, without going into the
 	// scenery
+	bench.enter(BS_COLLISION);
 	for (x = 0; x < nPlayers; x++) players[x].getJJ2LevelPlayer()->move(ticks, msps);
+	bench.leave(BS_COLLISION);
 
 
 
@@ -79,7 +331,8 @@ int JJ2Level::step () {
 
 		if (players[x].getJJ2LevelPlayer()->reacted(ticks) == JJ2PR_KILLED) {
 
-			if (!multiplayer) return LOST;
+			// A second local player goes back to the checkpoint instead
+			if (!multiplayer && (players + x == localPlayer)) return LOST;
 
 			game->resetPlayer(players + x);
 
@@ -94,26 +347,20 @@ int JJ2Level::step () {
 
 
 /**
- * Draw the JJ2 level.
+ * Calculate the viewport, keeping it within the level.
+ *
+ * @param alpha Progress towards the next step
  */
-void JJ2Level::draw () {
+void JJ2Level::calcView (fixed alpha) {
 
 	int width, height;
-	int x, y;
-	unsigned int change;
-
 
 	width = layer->getWidth();
 	height = layer->getHeight();
 
-
-	// Calculate change since last step
-	change = getTimeChange();
-
-
-	// Calculate viewport
-	if (game && (stage == LS_END)) game->view(paused? 0: ((ticks - prevTicks) * 160));
-	else localPlayer->getJJ2LevelPlayer()->view(ticks, paused? 0: (ticks - prevTicks), change);
+	if (bench.isSweeping()) bench.sweep(TTOI(width), TTOI(height));
+	else if (game && (stage == LS_END)) game->view(paused? 0: ((ticks - prevTicks) * 160));
+	else getViewer()->getJJ2LevelPlayer()->view(ticks, paused? 0: (ticks - prevTicks), alpha);
 
 	// Ensure the new viewport is within the level
 	if (FTOI(viewX) + canvasW >= TTOI(width)) viewX = ITOF(TTOI(width) - canvasW);
@@ -121,21 +368,195 @@ void JJ2Level::draw () {
 	if (FTOI(viewY) + canvasH >= TTOI(height)) viewY = ITOF(TTOI(height) - canvasH);
 	if (viewY < 0) viewY = 0;
 
+	return;
+
+}
+
+
+/**
+ * Layer drawing job.
+ *
+ * @param data The JJ2 level
+ */
+void JJ2Level::layerJob (void* data) {
+
+	((JJ2Level *)data)->drawBands();
+
+	return;
+
+}
+
+
+/**
+ * Draw the layers in bands of the canvas, all the layers in a band at a time,
+ * until there are no bands left. Run on any number of threads at once, as
+ * each band is drawn by only one of them.
+ */
+void JJ2Level::drawBands () {
+
+	SDL_Rect band;
+	int index, count, bottom;
+
+	bottom = canvas->clip_rect.y + canvas->clip_rect.h;
+
+	while ((index = SDL_AtomicAdd(&nextBand, 1)) < nBands) {
+
+		band.x = canvas->clip_rect.x;
+		band.w = canvas->clip_rect.w;
+		band.y = canvas->clip_rect.y + (index * LAYER_BAND);
+		band.h = (band.y + LAYER_BAND > bottom)? bottom - band.y: LAYER_BAND;
+
+		for (count = bandBack; count >= bandFront; count--)
+			layers[count]->draw(tileImages, tileCache, &band, occlusion, count, trueCanvas, expandedTiles);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Find, for each 32-pixel cell of the canvas, the foremost layer which covers
+ * it entirely with opaque tiles, front to back, so that the layers behind need
+ * not draw there. The rearmost layer has nothing behind it to hide.
+ */
+void JJ2Level::occludeLayers () {
+
+	int count, size;
+
+	size = ITOT(canvasW + 31) * ITOT(canvasH + 31);
+
+	// The canvas only changes size when the video mode does
+	if (size > occlusionSize) {
+
+		delete[] occlusion;
+		occlusion = new unsigned char[size];
+		occlusionSize = size;
+
+	}
+
+	memset(occlusion, LAYERS, size);
+
+	for (count = 0; count < LAYERS - 1; count++)
+		layers[count]->occlude(opaqueTiles, occlusion, count);
+
+	return;
+
+}
+
+
+/**
+ * Draw a range of layers, back to front. Tall canvases are split into bands
+ * shared between the available cores.
+ *
+ * @param back The rearmost layer
+ * @param front The foremost layer
+ */
+void JJ2Level::drawLayers (int back, int front) {
+
+	Job layerJobs[MAX_LAYER_THREADS];
+	Job layersDone;
+	int count;
+
+	bandBack = back;
+	bandFront = front;
+	nBands = (canvas->clip_rect.h + LAYER_BAND - 1) / LAYER_BAND;
+	SDL_AtomicSet(&nextBand, 0);
+
+	if (SDL_MUSTLOCK(canvas)) SDL_LockSurface(canvas);
 
-	// Show background layers
-	for (x = 7; x >= 3; x--) layers[x]->draw(tileSet, flippedTileSet);
+	if (jobs.getWorkers() && (nBands > 1)) {
 
+		jobs.prepare(&layersDone, NULL, NULL, NULL, false);
 
-	// Show the events
-	if (events) events->draw(ticks, change);
+		for (count = 0; (count < MAX_LAYER_THREADS) && (count < jobs.getWorkers()) &&
+			(count < nBands - 1); count++) {
+
+			jobs.prepare(layerJobs + count, layerJob, this, &layersDone, false);
+			jobs.submit(layerJobs + count);
+
+		}
+
+		drawBands();
+
+		jobs.submit(&layersDone);
+		jobs.wait(&layersDone);
+
+	} else {
+
+		for (count = back; count >= front; count--)
+			layers[count]->draw(tileImages, tileCache, &(canvas->clip_rect), occlusion, count, trueCanvas, expandedTiles);
+
+	}
+
+	if (SDL_MUSTLOCK(canvas)) SDL_UnlockSurface(canvas);
+
+	return;
+
+}
+
+
+/**
+ * Draw one player's view of the JJ2 level, with that player's panel data.
+ *
+ * @param alpha Progress towards the next step
+ */
+void JJ2Level::drawView (fixed alpha) {
+
+	Player* player;
+	int x, y;
+	int left, right, top, bottom;
+
+
+	player = getViewer();
+
+
+	// Expand the parts of the layers coming into view
+	for (x = 0; x < LAYERS; x++) layers[x]->reveal();
+
+	// Decompress the tiles coming into view, before the layers are drawn
+	if (tileCache) {
+
+		tileCache->startFrame();
+
+		for (x = 0; x < LAYERS; x++) layers[x]->cacheTiles(tileCache);
+
+	}
+
+	// Show background layers, skipping what the layers in front will hide
+	occludeLayers();
+	drawLayers(7, 3);
+
+
+	// Show the events in regions which may be on-screen
+	left = FTOT(viewX - F64) >> JJ2REGION;
+	right = FTOT(viewX + ITOF(canvasW) + F64) >> JJ2REGION;
+	top = FTOT(viewY - F64) >> JJ2REGION;
+	bottom = FTOT(viewY + ITOF(canvasH) + F64) >> JJ2REGION;
+
+	if (left < 0) left = 0;
+	if (right >= regionsW) right = regionsW - 1;
+	if (top < 0) top = 0;
+	if (bottom >= regionsH) bottom = regionsH - 1;
+
+	for (y = top; y <= bottom; y++) {
+
+		for (x = left; x <= right; x++) {
+
+			if (regions[(y * regionsW) + x]) regions[(y * regionsW) + x]->draw(ticks, alpha);
+
+		}
+
+	}
 
 
 	// Show the players
-	for (x = 0; x < nPlayers; x++) players[x].getJJ2LevelPlayer()->draw(ticks, change);
+	for (x = 0; x < nPlayers; x++) players[x].getJJ2LevelPlayer()->draw(ticks, alpha);
 
 
 	// Show foreground layers
-	for (x = 2; x >= 0; x--) layers[x]->draw(tileSet, flippedTileSet);
+	drawLayers(2, 0);
 
 
 	// Temporary lines showing the water level
@@ -160,12 +581,12 @@ void JJ2Level::draw () {
 
 	// Show score
 	if (multiplayer) game->getMode()->drawScore(font);
-	else panelSmallFont->showNumber(localPlayer->getScore(), 64, 8);
+	else panelSmallFont->showNumber(player->getScore(), 64, 8);
 
 
 	// Draw hearts
 
-	x = localPlayer->getJJ2LevelPlayer()->getEnergy();
+	x = player->getJJ2LevelPlayer()->getEnergy();
 
 	for (y = 1; y <= x; y++) {
 
@@ -175,17 +596,17 @@ void JJ2Level::draw () {
 
 
 	// Show lives
-	panelSmallFont->showNumber(localPlayer->getLives(), 16, canvasH - 16);
+	panelSmallFont->showNumber(player->getLives(), 16, canvasH - 16);
 
 
 	// Show ammo
-	if (localPlayer->getAmmoType() == -1) {
+	if (player->getAmmoType() == -1) {
 
 		panelSmallFont->showString(":", canvasW - 24, canvasH - 16);
 		panelSmallFont->showString(";", canvasW - 16, canvasH - 16);
 		panelSmallFont->setPalette(palette);
 
-	} else panelSmallFont->showNumber(localPlayer->getAmmo(), canvasW - 8, canvasH - 16);
+	} else panelSmallFont->showNumber(player->getAmmo(), canvasW - 8, canvasH - 16);
 
 
 	return;
@@ -193,3 +614,39 @@ void JJ2Level::draw () {
 }
 
 
+/**
+ * Draw the JJ2 level.
+ */
+void JJ2Level::draw () {
+
+	int count;
+	fixed alpha;
+
+
+	// Calculate progress towards the next step
+	alpha = getAlpha();
+
+
+#ifdef SDL2
+	// Tiles are drawn into the 32-bit canvas, if there is one this frame.
+	// Palette effects are applied as the frame is shown, so the tiles take on
+	// their colours the frame after.
+	trueCanvas = expandedTiles? video.getTrueCanvas(): NULL;
+	if (trueCanvas) expandedTiles->refresh();
+#endif
+
+	// Draw each view, sharing the tile images and occlusion map between them
+	for (count = 0; count < getViews(); count++) {
+
+		beginView(count);
+		calcView(alpha);
+		drawView(alpha);
+		endView(count);
+
+	}
+
+
+	return;
+
+}
+
@@ -29,34 +29,44 @@
 #include "jj2levelplayer/jj2levelplayer.h"
 
 #include "game/game.h"
+#include "io/diskcache.h"
 #include "io/file.h"
+#include "io/gfx/blitter.h"
 #include "io/gfx/font.h"
 #include "io/gfx/sprite.h"
 #include "io/gfx/video.h"
+#include "io/inflate.h"
+#include "io/loadprofile.h"
 #include "io/sound.h"
+#include "jobs.h"
 #include "loop.h"
+#include "memtrack.h"
 #include "util.h"
 
 #include <string.h>
+#include "../miniz.h"
 
 
 #define SKEY 254 /* Sprite colour key */
 
+#define ANIMTILE_SIZE 137 /* Bytes per animated tile in the level info block */
+
+#define TILECACHE_HEADER 784 /* Bytes before the tile pixels in a tile set's disk cache, after the cache header */
+
 
 /**
  * Load a sprite.
  *
  * @param parameters Sprite parameters
  * @param compressedPixels Compressed data from which to obtain the sprite data
+ * @param pixels Space in the animation set's atlas for the sprite's pixels
  * @param sprite Sprite that will receive the loaded data
  * @param flippedSprite Sprite that will receive the flipped loaded data
  */
-void JJ2Level::loadSprite (unsigned char* parameters, unsigned char* compressedPixels, Sprite* sprite, Sprite* flippedSprite) {
+void JJ2Level::loadSprite (unsigned char* parameters, unsigned char* compressedPixels, unsigned char* pixels, Sprite* sprite, Sprite* flippedSprite) {
 
-	unsigned char* pixels;
 	int width, height;
 	int srcPos, dstPos, rle;
-	int x, y;
 
 	// Load dimensions
 	width = createShort(parameters);
@@ -65,6 +75,7 @@ void JJ2Level::loadSprite (unsigned char* parameters, unsigned char* compressedP
 	if ((width == 0) || (height == 0)) {
 
 		sprite->clearPixels();
+		flippedSprite->setMirror(sprite);
 
 		return;
 
@@ -73,7 +84,6 @@ void JJ2Level::loadSprite (unsigned char* parameters, unsigned char* compressedP
 
 	// Decompress pixels
 
-	pixels = new unsigned char[width * height];
 	memset(pixels, 0, width * height);
 
 	srcPos = createInt(parameters + 16);
@@ -112,27 +122,138 @@ void JJ2Level::loadSprite (unsigned char* parameters, unsigned char* compressedP
 	// Set sprite data
 	sprite->setOffset(createShort(parameters + 8),
 		createShort(parameters + 10));
-	sprite->setPixels(pixels, width, height, 0);
+	sprite->setAtlasPixels(pixels, width, height, 0);
+
+	// Set flipped sprite data, mirroring the sprite's pixels as it is drawn
+	flippedSprite->setOffset(-createShort(parameters + 8) - width,
+		createShort(parameters + 10));
+	flippedSprite->setMirror(sprite);
+
+	return;
+
+}
+
+
+/**
+ * Decode an animation set whose compressed blocks have been read, creating
+ * its animations and sprites. Only the set's own animations, sprites and
+ * pixels are touched, so different sets can be decoded at the same time.
+ *
+ * @param set The number of the animation set
+ */
+void JJ2Level::loadAnimSet (int set) {
+
+	JJ2AnimSetLoad* setLoad;
+	unsigned char* buffers[3];
+	unsigned char* atlas;
+	int anim, sprite, setSprite, animSprites, length, count;
+
+	setLoad = setLoads + set;
+
+	for (count = 0; count < 3; count++) {
+
+		buffers[count] = new unsigned char[setLoad->lengths[count]];
+
+		length = inflateZlib(setLoad->blocks[count], setLoad->compressedLengths[count], buffers[count], setLoad->lengths[count]);
+
+		if (length < 0) length = 0;
+		if (length < setLoad->lengths[count]) memset(buffers[count] + length, 0, setLoad->lengths[count] - length);
+
+		delete[] setLoad->blocks[count];
+		setLoad->blocks[count] = NULL;
+
+	}
 
-	// Flip sprite
-	for (y = 0; y < height; y++) {
 
-		for (x = 0; x < (width >> 1); x++) {
+	// Pack the set's sprites into one block of pixels
 
-			rle = pixels[(y * width) + x];
-			pixels[(y * width) + x] = pixels[(y * width) + (width - 1) - x];
-			pixels[(y * width) + (width - 1) - x] = rle;
+	setLoad->atlasSize = 0;
+	setSprite = 0;
+
+	for (anim = 0; anim < setLoad->anims; anim++) {
+
+		animSprites = createShort(buffers[0] + (anim * 8));
+		if (animSprites == 224) animSprites = 1;
+
+		for (sprite = 0; (sprite < animSprites) && (setSprite < setLoad->sprites); sprite++) {
+
+			setLoad->atlasSize += createShort(buffers[1] + (setSprite * 24)) *
+				createShort(buffers[1] + (setSprite * 24) + 2);
+			setSprite++;
 
 		}
 
 	}
 
-	// Set flipped sprite data
-	flippedSprite->setOffset(-createShort(parameters + 8) - width,
-		createShort(parameters + 10));
-	flippedSprite->setPixels(pixels, width, height, 0);
+	if (setLoad->atlasSize) spritePixels[set] = new unsigned char[setLoad->atlasSize];
+	else spritePixels[set] = NULL;
+
+	atlas = spritePixels[set];
+	setSprite = 0;
+
+	for (anim = 0; anim < setLoad->anims; anim++) {
+
+		animSprites = createShort(buffers[0] + (anim * 8));
+
+		// Fonts are loaded separately
+		if (animSprites == 224) animSprites = 1;
+
+		// Never stray into the next set's sprites
+		if (animSprites > setLoad->sprites - setSprite) animSprites = setLoad->sprites - setSprite;
+
+		animSets[set][anim].setData(animSprites, 0, 0, 0, 0, 0, 0);
+		flippedAnimSets[set][anim].setData(animSprites, 0, 0, 0, 0, 0, 0);
 
-	delete[] pixels;
+		for (sprite = 0; sprite < animSprites; sprite++) {
+
+			count = setLoad->firstSprite + setSprite;
+
+			loadSprite(buffers[1] + (setSprite * 24), buffers[2], atlas, spriteSet + count, flippedSpriteSet + count);
+			atlas += createShort(buffers[1] + (setSprite * 24)) *
+				createShort(buffers[1] + (setSprite * 24) + 2);
+
+			animSets[set][anim].setFrame(sprite, false);
+			animSets[set][anim].setFrameData(spriteSet + count, 0, 0);
+			flippedAnimSets[set][anim].setFrame(sprite, false);
+			flippedAnimSets[set][anim].setFrameData(flippedSpriteSet + count, 0, 0);
+
+			setSprite++;
+
+		}
+
+	}
+
+	for (count = 0; count < 3; count++) delete[] buffers[count];
+
+	return;
+
+}
+
+
+/**
+ * Decode animation sets until none are left.
+ */
+void JJ2Level::loadAnimSets () {
+
+	int set;
+
+	while ((set = SDL_AtomicAdd(&nextSetLoad, 1)) < nAnimSets) loadAnimSet(set);
+
+	return;
+
+}
+
+
+/**
+ * Animation set decoding job.
+ *
+ * @param data The JJ2 level
+ */
+void JJ2Level::spriteJob (void* data) {
+
+	MEMORY_SCOPE(MEM_SPRITES);
+
+	((JJ2Level *)data)->loadAnimSets();
 
 	return;
 
@@ -147,14 +268,29 @@ void JJ2Level::loadSprite (unsigned char* parameters, unsigned char* compressedP
 int JJ2Level::loadSprites () {
 
 	File* file;
-	unsigned char* aBuffer;
-	unsigned char* bBuffer;
-	unsigned char* cBuffer;
+	Job setJobs[MAX_SPRITE_THREADS];
+	Job setsDone;
 	int* setOffsets;
-	int aCLength, bCLength, cCLength;
-	int aLength, bLength, cLength;
-	int setAnims, nSprites, animSprites;
-	int set, anim, sprite, setSprite;
+	int nSprites;
+	int set, count, size;
+
+	MEMORY_SCOPE(MEM_SPRITES);
+
+	// Use the sprites decoded for an earlier level, if possible
+	animsAsset = (JJ2AnimsAsset *)assetCache.find("anims.j2a");
+
+	if (animsAsset) {
+
+		spriteSet = animsAsset->spriteSet;
+		flippedSpriteSet = animsAsset->flippedSpriteSet;
+		spritePixels = animsAsset->spritePixels;
+		animSets = animsAsset->animSets;
+		flippedAnimSets = animsAsset->flippedAnimSets;
+		nAnimSets = animsAsset->nAnimSets;
+
+		return E_NONE;
+
+	}
 
 	// Thanks to Neobeo for working out the .j2a format
 
@@ -178,126 +314,266 @@ int JJ2Level::loadSprites () {
 	for (set = 0; set < nAnimSets; set++) setOffsets[set] = file->loadInt();
 
 
-	// Count number of sprites
+	// Read each set's header and compressed blocks, leaving them to be
+	// decoded in parallel
+
+	setLoads = new JJ2AnimSetLoad[nAnimSets];
+	animSets = new Anim *[nAnimSets];
+	flippedAnimSets = new Anim *[nAnimSets];
+	spritePixels = new unsigned char *[nAnimSets];
 
 	nSprites = 0;
 
 	for (set = 0; set < nAnimSets; set++) {
 
-		file->seek(setOffsets[set] + 6, true);
+		file->seek(setOffsets[set] + 4, true);
+
+		setLoads[set].anims = file->loadChar();
 
-		nSprites += file->loadShort();
+		if (setLoads[set].anims) {
+
+			animSets[set] = new Anim[setLoads[set].anims];
+			flippedAnimSets[set] = new Anim[setLoads[set].anims];
+
+		} else {
+
+			animSets[set] = NULL;
+			flippedAnimSets[set] = NULL;
+
+		}
+
+		file->seek(1, false);
+
+		setLoads[set].firstSprite = nSprites;
+		setLoads[set].sprites = file->loadShort();
+		nSprites += setLoads[set].sprites;
+
+		file->seek(4, false);
+
+		for (count = 0; count < 3; count++) {
+
+			setLoads[set].compressedLengths[count] = file->loadInt();
+			setLoads[set].lengths[count] = file->loadInt();
+
+		}
+
+		file->loadInt(); // Don't need this compressed block length
+		file->loadInt(); // Don't need this block length
+
+		for (count = 0; count < 3; count++)
+			setLoads[set].blocks[count] = file->loadBlock(setLoads[set].compressedLengths[count]);
 
 	}
 
+	delete[] setOffsets;
+
+	delete file;
+
 	spriteSet = new Sprite[nSprites];
 	flippedSpriteSet = new Sprite[nSprites];
-	animSets = new Anim *[nAnimSets];
-	flippedAnimSets = new Anim *[nAnimSets];
 
 
-	// Load animations and sprites
+	// Decode the sets, sharing them between the available cores
 
-	nSprites = 0;
+	SDL_AtomicSet(&nextSetLoad, 0);
 
-	for (set = 0; set < nAnimSets; set++) {
+	jobs.prepare(&setsDone, NULL, NULL, NULL, false);
 
-		file->seek(setOffsets[set] + 4, true);
+	for (count = 0; (count < MAX_SPRITE_THREADS) && (count < jobs.getWorkers()); count++) {
 
-		setAnims = file->loadChar();
+		jobs.prepare(setJobs + count, spriteJob, this, &setsDone, false);
+		jobs.submit(setJobs + count);
 
-		if (setAnims) {
+	}
 
-			animSets[set] = new Anim[setAnims];
-			flippedAnimSets[set] = new Anim[setAnims];
+	loadAnimSets();
 
-		} else {
+	jobs.submit(&setsDone);
+	jobs.wait(&setsDone);
 
-			animSets[set] = NULL;
-			flippedAnimSets[set] = NULL;
+	size = nSprites * sizeof(Sprite) * 2;
 
-		}
+	for (set = 0; set < nAnimSets; set++) size += setLoads[set].atlasSize;
 
-		file->seek(7, false);
+	delete[] setLoads;
+	setLoads = NULL;
 
-		aCLength = file->loadInt();
-		aLength = file->loadInt();
-		bCLength = file->loadInt();
-		bLength = file->loadInt();
-		cCLength = file->loadInt();
-		cLength = file->loadInt();
-		file->loadInt(); // Don't need this compressed block length
-		file->loadInt(); // Don't need this block length
 
-		aBuffer = file->loadLZ(aCLength, aLength);
-		bBuffer = file->loadLZ(bCLength, bLength);
-		cBuffer = file->loadLZ(cCLength, cLength);
+	// Keep the sprites for later levels
+	animsAsset = new JJ2AnimsAsset;
+	animsAsset->spriteSet = spriteSet;
+	animsAsset->flippedSpriteSet = flippedSpriteSet;
+	animsAsset->spritePixels = spritePixels;
+	animsAsset->animSets = animSets;
+	animsAsset->flippedAnimSets = flippedAnimSets;
+	animsAsset->nAnimSets = nAnimSets;
+
+	assetCache.add("anims.j2a", animsAsset, size);
+
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Compress a block of a tile set's tiles.
+ *
+ * @param asset The tile set
+ * @param tileBuffer The tile set's tile images
+ * @param first The block's first tile
+ * @param count The number of tiles in the block
+ */
+static void packBlock (JJ2TilesAsset* asset, unsigned char* tileBuffer, int first, int count) {
+
+	unsigned char* buffer;
+	mz_ulong length;
+	int block;
+
+	block = first / TILECACHE_BLOCK;
+	length = mz_compressBound(count << 10);
+	buffer = new unsigned char[length];
+
+	if (mz_compress2(buffer, &length, tileBuffer + (first << 10), count << 10, MZ_BEST_SPEED) != MZ_OK) length = 0;
+
+	// Only as much as the block needs is kept
+	asset->packedBlocks[block] = new unsigned char[length? length: 1];
+	memcpy(asset->packedBlocks[block], buffer, length);
+	asset->packedLengths[block] = length;
+
+	delete[] buffer;
+
+	return;
+
+}
+
+
+/**
+ * Prepare chunks of a tile set's tiles for drawing and collisions, until none
+ * are left. Each tile is prepared independently of the others, so several
+ * jobs can share the work.
+ *
+ * @param load The tile set being prepared
+ */
+void JJ2Level::prepareTiles (JJ2TilesLoad* load) {
+
+	JJ2TilesAsset* asset;
+	unsigned int* rows;
+	unsigned int* columns;
+	int first, last, count, x, y;
+
+	asset = load->asset;
+
+	while (true) {
+
+		first = SDL_AtomicAdd(&load->nextChunk, 1) * TILE_CHUNK;
+
+		if (first >= load->tiles) break;
+
+		last = first + TILE_CHUNK;
+		if (last > load->tiles) last = load->tiles;
 
-		setSprite = 0;
+		for (count = first; count < last; count++) {
 
-		for (anim = 0; anim < setAnims; anim++) {
+			if (asset->packedBlocks) {
 
-			animSprites = createShort(aBuffer + (anim * 8));
+				// Tiles without a single transparent pixel hide the layers
+				// behind them
+				asset->opaque[count] = !memchr(load->tileBuffer + (count << 10), 0, 1024);
 
-			// Fonts are loaded separately
-			if (animSprites == 224) animSprites = 1;
+			} else {
 
-			animSets[set][anim].setData(animSprites, 0, 0, 0, 0, 0, 0);
-			flippedAnimSets[set][anim].setData(animSprites, 0, 0, 0, 0, 0, 0);
+				// A dedicated server never draws tiles
+				if (!headless) {
 
-			for (sprite = 0; sprite < animSprites; sprite++) {
+					asset->tileImages[count].setPixels(asset->pixels + (count << 10), TTOI(1), TTOI(1), TTOI(1), 0);
 
-				loadSprite(bBuffer + (setSprite * 24), cBuffer, spriteSet + nSprites, flippedSpriteSet + nSprites);
+				}
+
+				asset->opaque[count] = (asset->tileImages[count].getType() == BT_OPAQUE);
+
+			}
+
+			// The mask is already packed a bit per pixel, and is turned
+			// around into columns for finding floors and ceilings
+			rows = asset->mask + (count << 5);
+			columns = asset->maskColumns + (count << 5);
+
+			for (y = 0; y < 32; y++) {
 
-				animSets[set][anim].setFrame(sprite, false);
-				animSets[set][anim].setFrameData(spriteSet + nSprites, 0, 0);
-				flippedAnimSets[set][anim].setFrame(sprite, false);
-				flippedAnimSets[set][anim].setFrameData(flippedSpriteSet + nSprites, 0, 0);
+				rows[y] = createInt(load->maskBuffer + (((count << 5) + y) << 2));
 
-				setSprite++;
-				nSprites++;
+				for (x = 0; x < 32; x++) {
+
+					if ((rows[y] >> x) & 1) columns[x] |= 1u << y;
+
+				}
 
 			}
 
 		}
 
-		delete[] cBuffer;
-		delete[] bBuffer;
-		delete[] aBuffer;
+		// Chunks hold whole blocks, so each block is compressed by one job
+		if (asset->packedBlocks) {
+
+			for (count = first; count < last; count += TILECACHE_BLOCK)
+				packBlock(asset, load->tileBuffer, count, (last - count < TILECACHE_BLOCK)? last - count: TILECACHE_BLOCK);
+
+		}
 
 	}
 
+	return;
 
-	delete[] setOffsets;
+}
 
-	delete file;
 
+/**
+ * Tile preparing job.
+ *
+ * @param data The tile set being prepared
+ */
+void JJ2Level::tileJob (void* data) {
+
+	MEMORY_SCOPE(MEM_TILES);
 
-	return E_NONE;
+	prepareTiles((JJ2TilesLoad *)data);
+
+	return;
 
 }
 
 
 /**
- * Load the tileset.
+ * Decode a tile set, or read it from the disk cache if it has been decoded
+ * before. Any thread may decode one, so its surface is left to be made when
+ * the main thread finishes it.
  *
  * @param fileName Name of the file containing the tileset
  *
- * @return The number of tiles loaded and the maximum possible number of tiles
+ * @return The tile set, or NULL if the file could not be opened
  */
-int JJ2Level::loadTiles (char* fileName) {
+JJ2TilesAsset* JJ2Level::decodeTiles (const char* fileName) {
 
+	JJ2TilesAsset* asset;
 	File* file;
+	File* cache;
 	unsigned char* aBuffer;
 	unsigned char* bBuffer;
 	unsigned char* dBuffer;
 	unsigned char* tileBuffer;
+	unsigned char* maskBuffer;
 	int aCLength, bCLength, cCLength, dCLength;
 	int aLength, bLength, dLength;
-	int count, x, y;
+	JJ2TilesLoad load;
+	Job tileJobs[MAX_TILE_THREADS];
+	Job tilesDone;
+	int count;
 	int maxTiles;
 	int tiles;
 
+	MEMORY_SCOPE(MEM_TILES);
+
 	// Thanks to Neobeo for working out the most of the .j2t format
 
 
@@ -307,155 +583,368 @@ int JJ2Level::loadTiles (char* fileName) {
 
 	} catch (int e) {
 
-		return e;
+		return NULL;
 
 	}
 
-	// Skip to version indicator
-	file->seek(220, true);
+	asset = new JJ2TilesAsset;
+	tileBuffer = NULL;
+	maskBuffer = NULL;
 
-	maxTiles = file->loadShort();
 
-	if (maxTiles == 0x201) maxTiles = 4096;
-	else maxTiles = 1024;
+	// Use the tile set decoded on an earlier run, if possible
 
+	LOAD_BEGIN("JJ2Level::decodeTiles cache");
 
-	// Skip to compressed block lengths
-	file->seek(8, false);
-	aCLength = file->loadInt();
-	aLength = file->loadInt();
-	bCLength = file->loadInt();
-	bLength = file->loadInt();
-	cCLength = file->loadInt();
-	file->loadInt(); // Don't need this block length
-	dCLength = file->loadInt();
-	dLength = file->loadInt();
+	cache = openDiskCache(file, fileName);
 
-	aBuffer = file->loadLZ(aCLength, aLength);
-	bBuffer = file->loadLZ(bCLength, bLength);
-	file->seek(cCLength, false); // Don't need this block
-	dBuffer = file->loadLZ(dCLength, dLength);
+	if (cache) {
 
-	delete file;
+		tiles = cache->loadInt();
+		maxTiles = cache->loadInt();
+
+		if ((tiles >= 0) && (tiles <= maxTiles) &&
+			(cache->getSize() == DISKCACHE_ALIGN + TILECACHE_HEADER + (tiles << 10) + (tiles << 7))) {
+
+			for (count = 0; count < 256; count++) {
+
+				asset->palette[count].r = cache->loadChar();
+				asset->palette[count].g = cache->loadChar();
+				asset->palette[count].b = cache->loadChar();
+
+			}
+
+			alignDiskCache(cache, false);
 
+			tileBuffer = cache->loadBlock(tiles << 10);
+			maskBuffer = cache->loadBlock(tiles << 7);
 
-	// Load the palette
-	for (count = 0; count < 256; count++) {
+		}
 
-		palette[count].r = aBuffer[count << 2];
-		palette[count].g = aBuffer[(count << 2) + 1];
-		palette[count].b = aBuffer[(count << 2) + 2];
+		delete cache;
 
 	}
 
+	LOAD_END();
 
-	// Load tiles
 
-	tiles = createShort(aBuffer + 1024);
-	tileBuffer = new unsigned char[tiles << 10];
+	if (!tileBuffer) {
 
-	for (count = 0; count < tiles; count++) {
+		// Skip to version indicator
+		file->seek(220, true);
 
-		memcpy(tileBuffer + (count << 10), bBuffer + createInt(aBuffer + 1028 + (maxTiles << 1) + (count << 2)), 1024);
+		maxTiles = file->loadShort();
 
-	}
+		if (maxTiles == 0x201) maxTiles = 4096;
+		else maxTiles = 1024;
+
+
+		// Skip to compressed block lengths
+		file->seek(8, false);
+		aCLength = file->loadInt();
+		aLength = file->loadInt();
+		bCLength = file->loadInt();
+		bLength = file->loadInt();
+		cCLength = file->loadInt();
+		file->loadInt(); // Don't need this block length
+		dCLength = file->loadInt();
+		dLength = file->loadInt();
 
-	tileSet = createSurface(tileBuffer, TTOI(1), TTOI(tiles));
-	
-	#ifdef SDL2
-	SDL_SetColorKey(tileSet, SDL_TRUE, 0);
-	#else
-	SDL_SetColorKey(tileSet, SDL_SRCCOLORKEY, 0);
-	#endif
+		LOAD_BEGIN("JJ2Level::decodeTiles inflate");
 
-	// Flip tiles
-	for (count = 0; count < TTOI(tiles); count++) {
+		aBuffer = file->loadLZ(aCLength, aLength);
+		bBuffer = file->loadLZ(bCLength, bLength);
+		file->seek(cCLength, false); // Don't need this block
+		dBuffer = file->loadLZ(dCLength, dLength);
+
+		LOAD_END();
 
-		for (x = 0; x < 16; x++) {
 
-			y = tileBuffer[(count * 32) + x];
-			tileBuffer[(count * 32) + x] = tileBuffer[(count * 32) + 31 - x];
-			tileBuffer[(count * 32) + 31 - x] = y;
+		// Load the palette
+		for (count = 0; count < 256; count++) {
+
+			asset->palette[count].r = aBuffer[count << 2];
+			asset->palette[count].g = aBuffer[(count << 2) + 1];
+			asset->palette[count].b = aBuffer[(count << 2) + 2];
 
 		}
 
-	}
 
-	flippedTileSet = createSurface(tileBuffer, TTOI(1), TTOI(tiles));
+		// Load tiles
+
+		tiles = createShort(aBuffer + 1024);
+		tileBuffer = new unsigned char[tiles << 10];
 
-	#ifdef SDL2
-	SDL_SetColorKey(flippedTileSet, SDL_TRUE, 0);
-	#else
-	SDL_SetColorKey(flippedTileSet, SDL_SRCCOLORKEY, 0);
-	#endif
+		for (count = 0; count < tiles; count++) {
 
-	delete[] tileBuffer;
+			memcpy(tileBuffer + (count << 10), bBuffer + createInt(aBuffer + 1028 + (maxTiles << 1) + (count << 2)), 1024);
 
+		}
 
-	// Load mask
 
-	mask = new char[tiles << 10];
+		// Load mask, already packed a bit per pixel and 4 bytes per row
 
-	// Unpack bits
-	for (count = 0; count < tiles; count++) {
+		maskBuffer = new unsigned char[tiles << 7];
 
-		for (y = 0; y < 32; y++) {
+		for (count = 0; count < tiles; count++)
+			memcpy(maskBuffer + (count << 7), dBuffer + createInt(aBuffer + 1028 + (maxTiles * 18) + (count << 2)), 128);
+
+		delete[] dBuffer;
+		delete[] bBuffer;
+		delete[] aBuffer;
+
+
+		// Keep the decoded tile set for later runs
+
+		LOAD_BEGIN("JJ2Level::decodeTiles store");
+
+		cache = createDiskCache(file, fileName);
+
+		if (cache) {
+
+			cache->storeInt(tiles);
+			cache->storeInt(maxTiles);
+
+			for (count = 0; count < 256; count++) {
+
+				cache->storeChar(asset->palette[count].r);
+				cache->storeChar(asset->palette[count].g);
+				cache->storeChar(asset->palette[count].b);
+
+			}
+
+			alignDiskCache(cache, true);
+
+			cache->storeBlock(tileBuffer, tiles << 10);
+			cache->storeBlock(maskBuffer, tiles << 7);
 
-			for (x = 0; x < 32; x++)
-				mask[(count << 10) + (y << 5) + x] = (dBuffer[createInt(aBuffer + 1028 + (maxTiles * 18) + (count << 2)) + (y << 2) + (x >> 3)] >> (x & 7)) & 1;
+			delete cache;
 
 		}
 
+		LOAD_END();
+
 	}
 
-	flippedMask = new char[tiles << 10];
+	delete file;
 
-	// Unpack bits
-	for (count = 0; count < tiles; count++) {
 
-		for (y = 0; y < 32; y++) {
+	LOAD_BEGIN("JJ2Level::decodeTiles prepare");
 
-			for (x = 0; x < 32; x++)
-				flippedMask[(count << 10) + (y << 5) + x] = (dBuffer[createInt(aBuffer + 1028 + (maxTiles * 22) + (count << 2)) + (y << 2) + (x >> 3)] >> (x & 7)) & 1;
+	// Large tile sets are kept compressed, and their tiles decompressed as
+	// they are drawn. A dedicated server never draws tiles.
+	if ((tiles > TILECACHE_MIN) && !headless) {
 
-		}
+		asset->pixels = NULL;
+		asset->tileSet = NULL;
+		asset->tileImages = NULL;
+		asset->packedBlocks = new unsigned char*[(tiles + TILECACHE_BLOCK - 1) / TILECACHE_BLOCK];
+		asset->packedLengths = new int[(tiles + TILECACHE_BLOCK - 1) / TILECACHE_BLOCK];
+
+	} else {
+
+		// The tile images draw on the decoded pixels in place
+		asset->pixels = tileBuffer;
+		asset->tileSet = NULL;
+		tileBuffer = NULL;
+
+		// Tile indices may be one beyond the end of the tile set, so that tile is
+		// left empty, with its mask clear
+		// Flipped tiles are mirrored as they are drawn
+		asset->tileImages = new BlitImage[tiles + 1];
+		asset->packedBlocks = NULL;
+		asset->packedLengths = NULL;
 
 	}
 
-	delete[] dBuffer;
-	delete[] bBuffer;
-	delete[] aBuffer;
+	asset->opaque = new bool[tiles + 1];
+	asset->mask = new unsigned int[(tiles + 1) << 5];
+	asset->maskColumns = new unsigned int[(tiles + 1) << 5];
+	memset(asset->mask + (tiles << 5), 0, 32 * sizeof(unsigned int));
+	memset(asset->maskColumns, 0, ((tiles + 1) << 5) * sizeof(unsigned int));
+
+
+	// Prepare the tiles, sharing them between the available cores
+
+	load.asset = asset;
+	load.tileBuffer = tileBuffer;
+	load.maskBuffer = maskBuffer;
+	load.tiles = tiles;
+	SDL_AtomicSet(&load.nextChunk, 0);
+
+	jobs.prepare(&tilesDone, NULL, NULL, NULL, false);
+
+	for (count = 0; (count < MAX_TILE_THREADS) && (count < jobs.getWorkers()) &&
+		((count + 1) * TILE_CHUNK < tiles); count++) {
+
+		jobs.prepare(tileJobs + count, tileJob, &load, &tilesDone, false);
+		jobs.submit(tileJobs + count);
+
+	}
+
+	prepareTiles(&load);
+
+	jobs.submit(&tilesDone);
+	jobs.wait(&tilesDone);
+
+	if (tileBuffer) delete[] tileBuffer;
+	delete[] maskBuffer;
+
+	asset->packedSize = 0;
+
+	if (asset->packedBlocks) {
+
+		for (count = 0; count < (tiles + TILECACHE_BLOCK - 1) / TILECACHE_BLOCK; count++)
+			asset->packedSize += asset->packedLengths[count];
+
+	}
+
+	// Tile 0 is never drawn
+	asset->opaque[0] = asset->opaque[tiles] = false;
+
+	LOAD_END();
 
 
 	/* Uncomment the code below if you want to see the mask instead of the tile
 	graphics during gameplay */
 
-	/*if (SDL_MUSTLOCK(tileSet)) SDL_LockSurface(tileSet);
-	if (SDL_MUSTLOCK(flippedTileSet)) SDL_LockSurface(flippedTileSet);
-
-	for (count = 0; count < tiles; count++) {
+	/*for (count = 0; count < tiles; count++) {
 
 		for (y = 0; y < 32; y++) {
 
 			for (x = 0; x < 32; x++) {
 
-				if (mask[(count << 10) + (y << 5) + x] == 1)
-					((char *)(tileSet->pixels))[(count << 10) + (y << 5) + x] = 43;
-
-				if (flippedMask[(count << 10) + (y << 5) + x] == 1)
-					((char *)(flippedTileSet->pixels))[(count << 10) + (y << 5) + x] = 88;
+				if ((asset->mask[(count << 5) + y] >> x) & 1)
+					asset->pixels[(count << 10) + (y << 5) + x] = 43;
 
 			}
 
 		}
 
+	}*/
+
+
+	asset->tiles = tiles | (maxTiles << 16);
+
+	return asset;
+
+}
+
+
+/**
+ * Decode the tile set used by a level, if it is not already cached, and load
+ * the level's music. This is run in the background, by the asset cache's
+ * preloading thread.
+ *
+ * @param fileName Name of the level file
+ */
+void JJ2Level::preload (const char* fileName) {
+
+	JJ2TilesAsset* asset;
+	File* file;
+	unsigned char aBuffer[212];
+	char* string;
+	char name[PATH_LENGTH];
+	int aCLength, aLength;
+
+	try {
+
+		file = new File(fileName, false);
+
+	} catch (int e) {
+
+		return;
+
+	}
+
+	// The tile set and music are named in the first compressed block
+	file->seek(230, true);
+	aCLength = file->loadInt();
+	file->seek(28, false);
+
+	// Only inflate as far as the end of the music file's name
+	aLength = file->loadLZ(aCLength, aBuffer, 211);
+	aBuffer[211] = 0;
+
+	delete file;
+
+	if ((aLength < 211) || assetCache.isCancelled()) return;
+
+	aBuffer[83] = 0;
+	string = (char *)aBuffer + 51;
+
+	if (!assetCache.contains(string)) {
+
+		asset = decodeTiles(string);
+
+		if (asset) {
+
+			assetCache.add(string, asset, asset->getSize());
+			assetCache.release(asset);
+
+		}
+
+	}
+
+	if (assetCache.isCancelled()) return;
+
+	string = (char *)aBuffer + 179;
+
+	if (fileExists(string)) prefetchMusic(string);
+	else {
+
+		if (writeString(name, PATH_LENGTH, string, ".j2b")) prefetchMusic(name);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Load the tileset.
+ *
+ * @param fileName Name of the file containing the tileset
+ *
+ * @return The number of tiles loaded and the maximum possible number of tiles
+ */
+int JJ2Level::loadTiles (char* fileName) {
+
+	// Use the tile set decoded for an earlier level, if possible
+	tilesAsset = (JJ2TilesAsset *)assetCache.find(fileName);
+
+	if (!tilesAsset) {
+
+		tilesAsset = decodeTiles(fileName);
+
+		if (!tilesAsset) return E_FILE;
+
+		tilesAsset->finish();
+
+		// Keep the tile set for later levels
+		assetCache.add(fileName, tilesAsset, tilesAsset->getSize());
+
 	}
 
-	if (SDL_MUSTLOCK(tileSet)) SDL_UnlockSurface(tileSet);
-	if (SDL_MUSTLOCK(flippedTileSet)) SDL_UnlockSurface(flippedTileSet);*/
+	memcpy(palette, tilesAsset->palette, sizeof(palette));
+	tileSet = tilesAsset->tileSet;
+	tileImages = tilesAsset->tileImages;
+	opaqueTiles = tilesAsset->opaque;
 
+	// Each level keeps its own decompressed tiles of a compressed tile set
+	if (tilesAsset->packedBlocks) tileCache = new JJ2TileCache(tilesAsset);
 
-	return tiles | (maxTiles << 16);
+#ifdef SDL2
+	// In true-colour mode, whole tile sets are expanded to the level's colours
+	// as they are first drawn. Compressed tile sets are still drawn in 8 bits.
+	if (tileImages && video.isTrueColour() && !headless)
+		expandedTiles = new ExpandedSet(tilesAsset->pixels, 1 << 10, tilesAsset->tiles);
+#endif
+	mask = tilesAsset->mask;
+	maskColumns = tilesAsset->maskColumns;
+
+	return tilesAsset->tiles;
 
 }
 
@@ -469,6 +958,7 @@ int JJ2Level::loadTiles (char* fileName) {
  */
 void JJ2Level::createEvent (int x, int y, unsigned char* data) {
 
+	JJ2Event** region;
 	unsigned char type;
 	int properties;
 
@@ -486,49 +976,113 @@ void JJ2Level::createEvent (int x, int y, unsigned char* data) {
 
 	mods[y][x].type = 0;
 
+	region = regions + ((y >> JJ2REGION) * regionsW) + (x >> JJ2REGION);
+
 	if (type <= 40) {
 
-		events = new AmmoJJ2Event(events, x, y, type, TSF);
+		*region = new AmmoJJ2Event(*region, x, y, type, TSF);
 
 	} else if ((type >= 44) && (type <= 45)) {
 
-		events = new CoinGemJJ2Event(events, x, y, type, TSF);
+		*region = new CoinGemJJ2Event(*region, x, y, type, TSF);
 
 	} else if (type == 60) {
 
-		events = new SpringJJ2Event(events, x, y, type, TSF, properties);
+		*region = new SpringJJ2Event(*region, x, y, type, TSF, properties);
 
 	} else if (type == 62) {
 
-		events = new SpringJJ2Event(events, x, y, type, TSF, properties);
+		*region = new SpringJJ2Event(*region, x, y, type, TSF, properties);
 
 	} else if ((type >= 63) && (type <= 66)) {
 
-		events = new CoinGemJJ2Event(events, x, y, type, TSF);
+		*region = new CoinGemJJ2Event(*region, x, y, type, TSF);
 
 	} else if ((type >= 72) && (type <= 73)) {
 
-		events = new FoodJJ2Event(events, x, y, type, TSF);
+		*region = new FoodJJ2Event(*region, x, y, type, TSF);
 
 	} else if (type == 80) {
 
-		events = new FoodJJ2Event(events, x, y, type, TSF);
+		*region = new FoodJJ2Event(*region, x, y, type, TSF);
 
 	} else if ((type >= 85) && (type <= 87)) {
 
-		events = new SpringJJ2Event(events, x, y, type, TSF, properties);
+		*region = new SpringJJ2Event(*region, x, y, type, TSF, properties);
 
 	} else if ((type >= 141) && (type <= 147)) {
 
-		events = new FoodJJ2Event(events, x, y, type, TSF);
+		*region = new FoodJJ2Event(*region, x, y, type, TSF);
 
 	} else if ((type >= 154) && (type <= 182)) {
 
-		events = new FoodJJ2Event(events, x, y, type, TSF);
+		*region = new FoodJJ2Event(*region, x, y, type, TSF);
 
 	} else {
 
-		events = new OtherJJ2Event(events, x, y, type, TSF, properties);
+		*region = new OtherJJ2Event(*region, x, y, type, TSF, properties);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Load the animated tiles from the level's info block.
+ *
+ * @param buffer The level's info block
+ * @param length The length of the info block
+ * @param tiles The total number of tiles
+ */
+void JJ2Level::loadAnimatedTiles (unsigned char* buffer, int length, int tiles) {
+
+	JJ2AnimatedTile* animTile;
+	unsigned short int* frame;
+	unsigned char* data;
+	unsigned short int tile;
+	int count, position;
+
+	nAnimTiles = createShort(buffer + 11);
+	animOffset = createShort(buffer + 8811);
+
+	// The animated tiles are at the end of the block, followed by padding
+	if ((nAnimTiles > JJ2ANIMTILES) ||
+		(length < 8813 + (JJ2ANIMTILES * ANIMTILE_SIZE) + 512)) nAnimTiles = 0;
+
+	data = buffer + length - 512 - (JJ2ANIMTILES * ANIMTILE_SIZE);
+
+	for (count = 0; count < nAnimTiles; count++) {
+
+		animTile = animTiles + count;
+
+		// The random wait is not used, as it would differ between players
+		animTile->frameWait = createShort(data);
+		animTile->pingPongWait = createShort(data + 4);
+		animTile->pingPong = data[6];
+		animTile->speed = data[7];
+		animTile->nFrames = data[8];
+
+		if (animTile->nFrames > JJ2ANIMFRAMES) animTile->nFrames = JJ2ANIMFRAMES;
+
+		for (position = 0; position < animTile->nFrames; position++) {
+
+			tile = createShort(data + 9 + (position << 1));
+			frame = animTile->frames + position;
+
+			if (TSF) *frame = (tile & 0xFFF) | ((tile & 0x1000)? JJ2_FLIPPED: 0);
+			else *frame = (tile & 0x3FF) | ((tile & 0x400)? JJ2_FLIPPED: 0);
+
+			if (((*frame & JJ2_TILE) > tiles) &&
+				(((*frame & JJ2_TILE) < animOffset) || ((*frame & JJ2_TILE) >= animOffset + nAnimTiles))) *frame = 0;
+
+		}
+
+		// Start on the first frame
+		animFrames[count] = animTile->nFrames? animTile->frames[0]: 0;
+
+		data += ANIMTILE_SIZE;
 
 	}
 
@@ -559,12 +1113,14 @@ int JJ2Level::load (char *fileName, bool checkpoint) {
 	int aLength, bLength, cLength, dLength;
 	int tiles;
 	int count, x, y, ret;
-	unsigned char tileQuad[8];
-	short int* quadRefs;
+	unsigned char* dictionary;
+	unsigned short int* quadRefs;
 	int flags, width, pitch, height;
 	fixed xSpeed, ySpeed;
 	unsigned char startX, startY;
 
+	MEMORY_SCOPE(MEM_LEVEL);
+
 	// Thanks to Neobeo for working out the most of the .j2l format
 
 
@@ -614,6 +1170,9 @@ int JJ2Level::load (char *fileName, bool checkpoint) {
 
 	if (::loop(NORMAL_LOOP) == E_QUIT) return E_QUIT;
 
+	// The tile set and music are decoded while the loading screen is shown
+	if (preloadAssets(preload, fileName) == E_QUIT) return E_QUIT;
+
 
 	// Skip to compressed block lengths
 	file->seek(230, true);
@@ -635,7 +1194,9 @@ int JJ2Level::load (char *fileName, bool checkpoint) {
 
 	// Load tile set from given file
 
+	LOAD_BEGIN("JJ2Level::loadTiles");
 	ret = loadTiles((char *)aBuffer + 51);
+	LOAD_END();
 
 	if (ret < 0) {
 
@@ -653,6 +1214,8 @@ int JJ2Level::load (char *fileName, bool checkpoint) {
 	TSF = ret >> 28;
 	tiles = ret & 0xFFFF;
 
+	loadAnimatedTiles(aBuffer, aLength, tiles);
+
 
 	// Next level
 	string = (char *)aBuffer + 115;
@@ -670,7 +1233,11 @@ int JJ2Level::load (char *fileName, bool checkpoint) {
 
 	// Create layers
 
-	quadRefs = (short int *)dBuffer;
+	quadRefs = (unsigned short int *)dBuffer;
+
+	// Only the layer players are in is expanded now. The others keep their
+	// words, and expand each block as it first comes into view.
+	dictionary = NULL;
 
 	for (count = 0; count < LAYERS; count++) {
 
@@ -685,27 +1252,33 @@ int JJ2Level::load (char *fileName, bool checkpoint) {
 
 		if (aBuffer[8403 + 40 + count]) {
 
-			layers[count] = new JJ2Layer(flags, width, height, xSpeed, ySpeed);
+			layers[count] = new JJ2Layer(flags, width, height, xSpeed, ySpeed, &arena);
+			layers[count]->setAnimatedTiles(animFrames, animOffset, nAnimTiles);
 
-			for (y = 0; y < height; y++) {
+			if (count == 3) {
 
-				for (x = 0; x < width; x++) {
+				layers[count]->setWords(quadRefs, pitch, cBuffer, TSF, tiles, false);
 
-					if ((x & 3) == 0) memcpy(tileQuad, cBuffer + (quadRefs[x >> 2] << 3), 8);
+			} else {
 
-					layers[count]->setTile(x, y, createShort(tileQuad + ((x & 3) << 1)), TSF, tiles);
+				if (!dictionary) {
+
+					dictionary = (unsigned char *)(arena.allocate(cLength));
+					memcpy(dictionary, cBuffer, cLength);
 
 				}
 
-				quadRefs += pitch;
+				layers[count]->setWords(quadRefs, pitch, dictionary, TSF, tiles, true);
 
 			}
 
+			quadRefs += pitch * height;
+
 		} else {
 
 			// No tile data
 
-			layers[count] = new JJ2Layer();
+			layers[count] = new JJ2Layer(&arena);
 
 		}
 
@@ -720,10 +1293,26 @@ int JJ2Level::load (char *fileName, bool checkpoint) {
 	startX = 1;
 	startY = 1;
 
-	mods = new JJ2Modifier *[height];
-	*mods = new JJ2Modifier[width * height];
+	mods = (JJ2Modifier **)(arena.allocate(height * sizeof(JJ2Modifier *)));
+	*mods = (JJ2Modifier *)(arena.allocate(width * height * sizeof(JJ2Modifier)));
+
+	// Events are kept by region, so that only those near players need processing
+	regionsW = ((width - 1) >> JJ2REGION) + 1;
+	regionsH = ((height - 1) >> JJ2REGION) + 1;
+	regions = (JJ2Event **)(arena.allocate(regionsW * regionsH * sizeof(JJ2Event *)));
+	regionSteps = (unsigned int *)(arena.allocate(regionsW * regionsH * sizeof(unsigned int)));
+	regionStep = 0;
+	activeRegions = (int *)(arena.allocate(regionsW * regionsH * sizeof(int)));
+	nActiveRegions = 0;
 
-	events = NULL;
+	for (count = 0; count < regionsW * regionsH; count++) {
+
+		regions[count] = NULL;
+		regionSteps[count] = 0;
+
+	}
+
+	for (count = 0; count < JJ2WARPS; count++) warpTargets[count] = -1;
 
 	for (y = 0; y < height; y++) {
 
@@ -741,6 +1330,11 @@ int JJ2Level::load (char *fileName, bool checkpoint) {
 				startX = x;
 				startY = y;
 
+			} else if ((mods[y][x].type == 240) && (warpTargets[mods[y][x].properties & 255] < 0)) {
+
+				// Warp target, the first for its ID
+				warpTargets[mods[y][x].properties & 255] = (y * width) + x;
+
 			}
 
 		}
@@ -755,26 +1349,24 @@ int JJ2Level::load (char *fileName, bool checkpoint) {
 
 	// Load anims from anims.j2a
 
+	LOAD_BEGIN("JJ2Level::loadSprites");
 	ret = loadSprites();
+	LOAD_END();
 
 	if (ret < 0) {
 
-		delete file;
-
-		if (events) delete events;
-		delete[] *mods;
-		delete[] mods;
+		deleteEvents();
 
 		for (x = 0; x < LAYERS; x++) delete layers[x];
 
-		delete[] flippedMask;
-		delete[] mask;
-
 		delete[] musicFile;
 		delete[] nextLevel;
 
-		SDL_FreeSurface(flippedTileSet);
-		SDL_FreeSurface(tileSet);
+		if (tileCache) delete tileCache;
+#ifdef SDL2
+		if (expandedTiles) delete expandedTiles;
+#endif
+		assetCache.release(tilesAsset);
 
 		delete font;
 
@@ -725,8 +725,8 @@ void JJ2LevelPlayer::receive (unsigned char *buffer) {
 			facing = buffer[27];
 			jumpHeight = (buffer[29] << 24) + (buffer[30] << 16) + (buffer[31] << 8) + buffer[32];
 			throwY = (buffer[33] << 24) + (buffer[34] << 16) + (buffer[35] << 8) + buffer[36];
-			x = (buffer[37] << 24) + (buffer[38] << 16) + (buffer[39] << 8) + buffer[40];
-			y = (buffer[41] << 24) + (buffer[42] << 16) + (buffer[43] << 8) + buffer[44];
+			correctPosition((buffer[37] << 24) + (buffer[38] << 16) + (buffer[39] << 8) + buffer[40],
+				(buffer[41] << 24) + (buffer[42] << 16) + (buffer[43] << 8) + buffer[44]);
 
 			break;
 
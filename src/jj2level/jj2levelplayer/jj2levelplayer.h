@@ -214,8 +214,8 @@ class JJ2LevelPlayer : public LevelPlayer {
 
 		void              control     (unsigned int ticks, int msps);
 		void              move        (unsigned int ticks, int msps);
-		void              view        (unsigned int ticks, int mspf, int change);
-		void              draw        (unsigned int ticks, int change);
+		void              view        (unsigned int ticks, int mspf, fixed alpha);
+		void              draw        (unsigned int ticks, fixed alpha);
 
 };
 
@@ -248,6 +248,9 @@ void JJ2LevelPlayer::control (unsigned int ticks, int msps) {
 	bool drop, platform;
 
 
+	// Remember where the player was, to draw them between steps
+	savePosition();
+
 	// If the player has been killed, do not move
 	if (!energy) {
 
@@ -609,7 +612,7 @@ void JJ2LevelPlayer::move (unsigned int ticks, int msps) {
 
 	fixed pdx, pdy;
 	bool grounded = false;
-	int count;
+	int count, distance;
 	bool drop;
 
 
@@ -642,19 +645,18 @@ void JJ2LevelPlayer::move (unsigned int ticks, int msps) {
 
 		count = (-pdy) >> 10;
 
-		while (count > 0) {
+		if (count > 0) {
 
-			if (jj2Level->checkMaskUp(x + JJ2PXO_MID, y + JJ2PYO_TOP - F1)) {
+			// Rise to just below the first ceiling in the way
+			distance = jj2Level->findCeiling(x + JJ2PXO_MID, x + JJ2PXO_MID, y + JJ2PYO_TOP - F1, count - 1);
 
+			if (distance < count) {
+
+				y -= ITOF(distance);
 				y &= ~1023;
 				dy = 0;
 
-				break;
-
-			}
-
-			y -= F1;
-			count--;
+			} else y -= ITOF(count);
 
 		}
 
@@ -675,19 +677,18 @@ void JJ2LevelPlayer::move (unsigned int ticks, int msps) {
 
 			count = pdy >> 10;
 
-			while (count > 0) {
+			if (count > 0) {
 
-				if (checkMaskDown(F1, drop)) {
+				// Fall to just above the first floor in the way
+				distance = jj2Level->findFloor(x + JJ2PXO_ML, x + JJ2PXO_MR, y + F1, count - 1, drop);
 
+				if (distance < count) {
+
+					y += ITOF(distance);
 					y |= 1023;
 					dy = 0;
 
-					break;
-
-				}
-
-				y += F1;
-				count--;
+				} else y += ITOF(count);
 
 			}
 
@@ -726,6 +727,24 @@ void JJ2LevelPlayer::move (unsigned int ticks, int msps) {
 
 		count = (-pdx) >> 10;
 
+		if (!grounded && (count > 0)) {
+
+			// In the air, so go straight to the first obstacle in the way
+			distance = jj2Level->findWallLeft(x + JJ2PXO_L - F1, y + JJ2PYO_MID, count - 1);
+
+			if (distance < count) {
+
+				x -= ITOF(distance);
+				x &= ~1023;
+				dx = 0;
+
+			} else x -= ITOF(count);
+
+			count = 0;
+
+		}
+
+		// On the ground, each step may follow a slope
 		while (count > 0) {
 
 			// If there is an obstacle, stop
@@ -741,7 +760,7 @@ void JJ2LevelPlayer::move (unsigned int ticks, int msps) {
 			x -= F1;
 			count--;
 
-			if (grounded) ground();
+			ground();
 
 		}
 
@@ -762,6 +781,24 @@ void JJ2LevelPlayer::move (unsigned int ticks, int msps) {
 
 		count = pdx >> 10;
 
+		if (!grounded && (count > 0)) {
+
+			// In the air, so go straight to the first obstacle in the way
+			distance = jj2Level->findWallRight(x + JJ2PXO_R + F1, y + JJ2PYO_MID, count - 1);
+
+			if (distance < count) {
+
+				x += ITOF(distance);
+				x |= 1023;
+				dx = 0;
+
+			} else x += ITOF(count);
+
+			count = 0;
+
+		}
+
+		// On the ground, each step may follow a slope
 		while (count > 0) {
 
 			// If there is an obstacle, stop
@@ -777,7 +814,7 @@ void JJ2LevelPlayer::move (unsigned int ticks, int msps) {
 			x += F1;
 			count--;
 
-			if (grounded) ground();
+			ground();
 
 		}
 
@@ -817,9 +854,9 @@ void JJ2LevelPlayer::move (unsigned int ticks, int msps) {
  *
  * @param ticks Time
  * @param mspf Ticks per frame
- * @param change Time since last step
+ * @param alpha How far drawing is between the last step and the next, out of F1
  */
-void JJ2LevelPlayer::view (unsigned int ticks, int mspf, int change) {
+void JJ2LevelPlayer::view (unsigned int ticks, int mspf, fixed alpha) {
 
 	int oldViewX, oldViewY, speed;
 
@@ -830,8 +867,8 @@ void JJ2LevelPlayer::view (unsigned int ticks, int mspf, int change) {
 
 	// Find new position
 
-	viewX = x + ((dx * change) >> 10) + F8 - (canvasW << 9);
-	viewY = y + ((dy * change) >> 10) - F24 - (canvasH << 9);
+	viewX = getInterpolatedX(alpha) + F8 - (canvasW << 9);
+	viewY = getInterpolatedY(alpha) - F24 - (canvasH << 9);
 
 	if ((lookTime > 0) && ((int)ticks > 1000 + lookTime)) {
 
@@ -867,9 +904,9 @@ void JJ2LevelPlayer::view (unsigned int ticks, int mspf, int change) {
  * Draw the player.
  *
  * @param ticks Time
- * @param change Time since last step
+ * @param alpha How far drawing is between the last step and the next, out of F1
  */
-void JJ2LevelPlayer::draw (unsigned int ticks, int change) {
+void JJ2LevelPlayer::draw (unsigned int ticks, fixed alpha) {
 
 	Anim *an;
 	int frame;
@@ -882,8 +919,8 @@ void JJ2LevelPlayer::draw (unsigned int ticks, int change) {
 
 	// Get position
 
-	drawX = getDrawX(stopTime? 0: change);
-	drawY = getDrawY(stopTime? 0: change);
+	drawX = getDrawX(stopTime? F1: alpha);
+	drawY = getDrawY(stopTime? F1: alpha);
 
 
 	// Choose sprite
@@ -962,7 +999,7 @@ void JJ2LevelPlayer::draw (unsigned int ticks, int change) {
 
 
 	// Show the bird
-	//if (birds) birds->draw(ticks, change);
+	//if (birds) birds->draw(ticks, alpha);
 
 
 	// Show the player's name
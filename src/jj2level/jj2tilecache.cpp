@@ -0,0 +1,230 @@
+
+/**
+ *
+ * @file jj2tilecache.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created jj2tilecache.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Decompresses the tiles of large JJ2 tile sets as they are first drawn. Each
+ * frame, the tiles about to be drawn are fetched on the main thread, so the
+ * layers can then be drawn on any number of threads without the cache
+ * changing beneath them.
+ *
+ */
+
+
+#include "jj2level.h"
+
+#include "io/gfx/blitter.h"
+#include "io/inflate.h"
+#include "memtrack.h"
+
+#include <string.h>
+
+
+/**
+ * Create an empty cache for the tiles of a compressed tile set.
+ *
+ * @param tilesAsset The tile set
+ */
+JJ2TileCache::JJ2TileCache (JJ2TilesAsset* tilesAsset) {
+
+	int count;
+
+	MEMORY_SCOPE(MEM_TILES);
+
+	asset = tilesAsset;
+
+	pixels = new unsigned char[TILECACHE_SLOTS << 10];
+	images = new BlitImage[TILECACHE_SLOTS];
+	slotTiles = new short int[TILECACHE_SLOTS];
+	newer = new short int[TILECACHE_SLOTS];
+	older = new short int[TILECACHE_SLOTS];
+	slotFrames = new unsigned int[TILECACHE_SLOTS];
+	tileSlots = new short int[(asset->tiles & 0xFFFF) + 1];
+	block = new unsigned char[TILECACHE_BLOCK << 10];
+
+	// Every slot starts empty, in order of use
+	for (count = 0; count < TILECACHE_SLOTS; count++) {
+
+		slotTiles[count] = -1;
+		newer[count] = (count > 0)? count - 1: -1;
+		older[count] = (count < TILECACHE_SLOTS - 1)? count + 1: -1;
+		slotFrames[count] = 0;
+
+	}
+
+	newest = 0;
+	oldest = TILECACHE_SLOTS - 1;
+
+	for (count = 0; count <= (asset->tiles & 0xFFFF); count++) tileSlots[count] = -1;
+
+	blockNumber = -1;
+	frame = 1;
+
+	return;
+
+}
+
+
+/**
+ * Delete the cache.
+ */
+JJ2TileCache::~JJ2TileCache () {
+
+	delete[] block;
+	delete[] tileSlots;
+	delete[] slotFrames;
+	delete[] older;
+	delete[] newer;
+	delete[] slotTiles;
+	delete[] images;
+	delete[] pixels;
+
+	return;
+
+}
+
+
+/**
+ * Take a slot out of the order of use.
+ *
+ * @param slot The slot
+ */
+void JJ2TileCache::unlink (int slot) {
+
+	if (newer[slot] >= 0) older[newer[slot]] = older[slot];
+	else newest = older[slot];
+
+	if (older[slot] >= 0) newer[older[slot]] = newer[slot];
+	else oldest = newer[slot];
+
+	return;
+
+}
+
+
+/**
+ * Decompress a tile into a slot.
+ *
+ * @param tile The tile
+ * @param slot The slot
+ *
+ * @return Whether or not the tile could be decompressed
+ */
+bool JJ2TileCache::unpack (int tile, int slot) {
+
+	// Neighbouring tiles tend to be drawn together, so the last block
+	// decompressed is kept
+	if (tile / TILECACHE_BLOCK != blockNumber) {
+
+		blockNumber = tile / TILECACHE_BLOCK;
+
+		if (inflateZlib(asset->packedBlocks[blockNumber], asset->packedLengths[blockNumber], block, TILECACHE_BLOCK << 10) < 0) {
+
+			blockNumber = -1;
+
+			return false;
+
+		}
+
+	}
+
+	memcpy(pixels + (slot << 10), block + ((tile % TILECACHE_BLOCK) << 10), 1024);
+	images[slot].setPixels(pixels + (slot << 10), 32, 32, 32, 0);
+
+	return true;
+
+}
+
+
+/**
+ * Start a new frame. Tiles fetched from now on are kept until the frame has
+ * been drawn.
+ */
+void JJ2TileCache::startFrame () {
+
+	frame++;
+
+	return;
+
+}
+
+
+/**
+ * Make sure a tile is decompressed, ready to be drawn this frame. Must be
+ * called on the main thread, before any layers are drawn.
+ *
+ * @param tile The tile
+ */
+void JJ2TileCache::fetch (int tile) {
+
+	int slot;
+
+	// Tile 0, and the tile beyond the end of the set, are never drawn
+	if ((tile <= 0) || (tile >= (asset->tiles & 0xFFFF))) return;
+
+	slot = tileSlots[tile];
+
+	if (slot < 0) {
+
+		// Tiles already drawn this frame must stay where they are, so when
+		// every slot holds one, the rest of the frame's new tiles are not drawn
+		slot = oldest;
+
+		if (slotFrames[slot] == frame) return;
+
+		if (!unpack(tile, slot)) return;
+
+		if (slotTiles[slot] >= 0) tileSlots[slotTiles[slot]] = -1;
+
+		slotTiles[slot] = tile;
+		tileSlots[tile] = slot;
+
+	}
+
+	slotFrames[slot] = frame;
+
+	// Move the slot to the front of the order of use
+	if (slot != newest) {
+
+		unlink(slot);
+
+		newer[slot] = -1;
+		older[slot] = newest;
+		newer[newest] = slot;
+		newest = slot;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Find a tile's image, if it has been decompressed. Can be called on any
+ * thread while layers are being drawn.
+ *
+ * @param tile The tile
+ *
+ * @return The tile's image, or NULL if it is not decompressed
+ */
+BlitImage* JJ2TileCache::getImage (int tile) {
+
+	if ((tile < 0) || (tile > (asset->tiles & 0xFFFF)) || (tileSlots[tile] < 0)) return NULL;
+
+	return images + tileSlots[tile];
+
+}
+
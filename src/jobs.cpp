@@ -0,0 +1,535 @@
+
+/**
+ *
+ * @file jobs.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created jobs.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Shares work between the cores. Each thread has its own queue of jobs, and
+ * takes the newest job from it. A thread with nothing left in its queue
+ * steals the oldest job from another's. A thread waiting for a job to be done
+ * runs other jobs in the meantime, so the main thread helps rather than
+ * sitting idle.
+ *
+ */
+
+
+#include "jobs.h"
+
+#include <string.h>
+
+
+/**
+ * Create the job system, without any worker threads.
+ */
+JobSystem::JobSystem () {
+
+	nWorkers = 0;
+	available = NULL;
+	quit = false;
+
+	SDL_AtomicSet(&started, 0);
+
+	memset(queues, 0, sizeof(queues));
+	memset(&backgroundQueue, 0, sizeof(backgroundQueue));
+
+	return;
+
+}
+
+
+/**
+ * Stop the worker threads, and destroy the job system.
+ */
+JobSystem::~JobSystem () {
+
+	stop();
+
+	return;
+
+}
+
+
+/**
+ * Start a worker thread for each spare core.
+ */
+void JobSystem::start () {
+
+	int cores;
+
+	if (nWorkers) return;
+
+	available = SDL_CreateSemaphore(0);
+
+	if (!available) return;
+
+	quit = false;
+	SDL_AtomicSet(&started, 0);
+
+	cores = SDL_GetCPUCount();
+
+	while ((nWorkers < JOB_WORKERS) && (nWorkers < cores - 1)) {
+
+		workerIDs[nWorkers] = 0;
+		workers[nWorkers] = SDL_CreateThread(runWorker, "Jobs", this);
+
+		if (!workers[nWorkers]) break;
+
+		nWorkers++;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Finish the background jobs, and stop the worker threads.
+ */
+void JobSystem::stop () {
+
+	Job* job;
+	int count;
+
+	if (!available) return;
+
+	quit = true;
+
+	for (count = 0; count < nWorkers; count++) SDL_SemPost(available);
+
+	for (count = 0; count < nWorkers; count++) SDL_WaitThread(workers[count], NULL);
+
+	nWorkers = 0;
+
+	// Anything left over is run here
+	while ((job = find(0, true))) execute(job);
+
+	SDL_DestroySemaphore(available);
+	available = NULL;
+
+	return;
+
+}
+
+
+/**
+ * Get the number of worker threads, besides the main thread.
+ *
+ * @return Number of worker threads
+ */
+int JobSystem::getWorkers () {
+
+	return nWorkers;
+
+}
+
+
+/**
+ * Worker thread. Runs jobs whenever there are any.
+ *
+ * @param data The job system
+ *
+ * @return Thread exit code
+ */
+int JobSystem::runWorker (void* data) {
+
+	JobSystem* system;
+	Job* job;
+	int index;
+
+	system = (JobSystem *)data;
+
+	index = SDL_AtomicAdd(&system->started, 1) + 1;
+	system->workerIDs[index - 1] = SDL_ThreadID();
+
+	while (!system->quit) {
+
+		job = system->find(index, true);
+
+		if (job) system->execute(job);
+		else SDL_SemWait(system->available);
+
+	}
+
+	return 0;
+
+}
+
+
+/**
+ * Add a job to the newest end of a queue.
+ *
+ * @param queue The queue
+ * @param job The job
+ *
+ * @return Whether or not there was room for the job
+ */
+bool JobSystem::push (JobQueue* queue, Job* job) {
+
+	SDL_AtomicLock(&queue->lock);
+
+	if (queue->bottom - queue->top >= JOB_QUEUE) {
+
+		SDL_AtomicUnlock(&queue->lock);
+
+		return false;
+
+	}
+
+	queue->jobs[queue->bottom & (JOB_QUEUE - 1)] = job;
+	queue->bottom++;
+
+	SDL_AtomicUnlock(&queue->lock);
+
+	return true;
+
+}
+
+
+/**
+ * Take the newest job from a queue.
+ *
+ * @param queue The queue
+ *
+ * @return The job, or NULL if the queue is empty
+ */
+Job* JobSystem::pop (JobQueue* queue) {
+
+	Job* job;
+
+	SDL_AtomicLock(&queue->lock);
+
+	if (queue->bottom == queue->top) job = NULL;
+	else job = queue->jobs[--queue->bottom & (JOB_QUEUE - 1)];
+
+	SDL_AtomicUnlock(&queue->lock);
+
+	return job;
+
+}
+
+
+/**
+ * Take the oldest job from a queue.
+ *
+ * @param queue The queue
+ *
+ * @return The job, or NULL if the queue is empty
+ */
+Job* JobSystem::steal (JobQueue* queue) {
+
+	Job* job;
+
+	SDL_AtomicLock(&queue->lock);
+
+	if (queue->bottom == queue->top) job = NULL;
+	else job = queue->jobs[queue->top++ & (JOB_QUEUE - 1)];
+
+	SDL_AtomicUnlock(&queue->lock);
+
+	return job;
+
+}
+
+
+/**
+ * Find the queue belonging to the current thread.
+ *
+ * @return Index of the queue
+ */
+int JobSystem::getIndex () {
+
+	SDL_threadID id;
+	int count;
+
+	id = SDL_ThreadID();
+
+	for (count = 0; count < nWorkers; count++) {
+
+		if (workerIDs[count] == id) return count + 1;
+
+	}
+
+	// The main thread, or any other, uses the first queue
+	return 0;
+
+}
+
+
+/**
+ * Find a job to run, first in the thread's own queue, then in the others'.
+ *
+ * @param index Index of the thread's own queue
+ * @param background Whether or not background jobs may be run
+ *
+ * @return The job, or NULL if there is none
+ */
+Job* JobSystem::find (int index, bool background) {
+
+	Job* job;
+	int count;
+
+	job = pop(queues + index);
+
+	if (job) return job;
+
+	for (count = 1; count <= nWorkers; count++) {
+
+		job = steal(queues + ((index + count) % (nWorkers + 1)));
+
+		if (job) return job;
+
+	}
+
+	if (background) return steal(&backgroundQueue);
+
+	return NULL;
+
+}
+
+
+/**
+ * Add a job which is ready to run to a queue.
+ *
+ * @param job The job
+ */
+void JobSystem::schedule (Job* job) {
+
+	bool queued;
+
+	// Without worker threads, background jobs would never be run
+	if (job->background && !nWorkers) {
+
+		execute(job);
+
+		return;
+
+	}
+
+	if (job->background) queued = push(&backgroundQueue, job);
+	else queued = push(queues + getIndex(), job);
+
+	if (!queued) {
+
+		execute(job);
+
+		return;
+
+	}
+
+	if (available) SDL_SemPost(available);
+
+	return;
+
+}
+
+
+/**
+ * Run a job.
+ *
+ * @param job The job
+ */
+void JobSystem::execute (Job* job) {
+
+	if (job->function) job->function(job->data);
+
+	finish(job);
+
+	return;
+
+}
+
+
+/**
+ * Note that a job, or one of its children, is done. Once the job and all its
+ * children are, the jobs waiting for it are scheduled, and its parent is told.
+ *
+ * @param job The job
+ */
+void JobSystem::finish (Job* job) {
+
+	Job* parent;
+	int count;
+
+	if (SDL_AtomicAdd(&job->unfinished, -1) != 1) return;
+
+	SDL_AtomicLock(&job->lock);
+
+	for (count = 0; count < job->nDependents; count++) {
+
+		if (SDL_AtomicAdd(&job->dependents[count]->dependencies, -1) == 1)
+			schedule(job->dependents[count]);
+
+	}
+
+	SDL_AtomicUnlock(&job->lock);
+
+	// Once done, the job may no longer exist
+	parent = job->parent;
+
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&job->done, 1);
+
+	if (parent) finish(parent);
+
+	return;
+
+}
+
+
+/**
+ * Set up a job, before it is submitted.
+ *
+ * @param job The job
+ * @param function What to do, or NULL to do nothing but wait for children
+ * @param data What to do it to
+ * @param parent Job which is not done until this one is, or NULL. Must not be
+ * done yet.
+ * @param background Whether or not only worker threads may run the job. Long
+ * jobs which nothing waits for straight away should be run in the background,
+ * so that a thread waiting for other work does not take them on.
+ */
+void JobSystem::prepare (Job* job, JobFunction function, void* data, Job* parent, bool background) {
+
+	job->function = function;
+	job->data = data;
+	job->parent = parent;
+	job->nDependents = 0;
+	job->lock = 0;
+	job->background = background;
+
+	SDL_AtomicSet(&job->unfinished, 1);
+	SDL_AtomicSet(&job->dependencies, 1);
+	SDL_AtomicSet(&job->done, 0);
+
+	if (parent) SDL_AtomicAdd(&parent->unfinished, 1);
+
+	return;
+
+}
+
+
+/**
+ * Make a job wait for another to be done before it runs. Must be called
+ * before the job is submitted.
+ *
+ * @param job The job
+ * @param dependency The job to wait for
+ */
+void JobSystem::depend (Job* job, Job* dependency) {
+
+	SDL_AtomicLock(&dependency->lock);
+
+	if (!SDL_AtomicGet(&dependency->unfinished)) {
+
+		SDL_AtomicUnlock(&dependency->lock);
+
+		return;
+
+	}
+
+	if (dependency->nDependents < JOB_DEPENDENTS) {
+
+		dependency->dependents[dependency->nDependents++] = job;
+		SDL_AtomicAdd(&job->dependencies, 1);
+
+		SDL_AtomicUnlock(&dependency->lock);
+
+		return;
+
+	}
+
+	SDL_AtomicUnlock(&dependency->lock);
+
+	// No room to wait in turn, so wait now
+	wait(dependency);
+
+	return;
+
+}
+
+
+/**
+ * Let a job run, once all the jobs it depends on are done.
+ *
+ * @param job The job
+ */
+void JobSystem::submit (Job* job) {
+
+	if (SDL_AtomicAdd(&job->dependencies, -1) == 1) schedule(job);
+
+	return;
+
+}
+
+
+/**
+ * Wait for a job, and its children, to be done, running other jobs in the
+ * meantime.
+ *
+ * @param job The job
+ */
+void JobSystem::wait (Job* job) {
+
+	Job* other;
+	int index, spins;
+
+	index = getIndex();
+	spins = 0;
+
+	while (!SDL_AtomicGet(&job->done)) {
+
+		other = find(index, index != 0);
+
+		if (other) {
+
+			execute(other);
+			spins = 0;
+
+		} else if (++spins < JOB_SPINS) {
+
+			SDL_Delay(0);
+
+		} else {
+
+			SDL_Delay(1);
+
+		}
+
+	}
+
+	SDL_MemoryBarrierAcquire();
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not a job, and its children, are done.
+ *
+ * @param job The job
+ *
+ * @return Whether or not the job is done
+ */
+bool JobSystem::isDone (Job* job) {
+
+	if (!SDL_AtomicGet(&job->done)) return false;
+
+	SDL_MemoryBarrierAcquire();
+
+	return true;
+
+}
+
@@ -0,0 +1,127 @@
+
+/**
+ *
+ * @file jobs.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created jobs.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _JOBS_H
+#define _JOBS_H
+
+
+#include "OpenJazz.h"
+
+#define SDL2
+
+#ifdef SDL2
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+
+// Constants
+
+#define JOB_WORKERS    7 /* Most threads running jobs, besides the main thread */
+#define JOB_QUEUE      256 /* Most jobs waiting in each queue, must be a power of 2 */
+#define JOB_DEPENDENTS 4 /* Most jobs waiting for any one job to finish */
+#define JOB_SPINS      64 /* Times to look for work before sleeping while waiting */
+
+
+// Datatypes
+
+/// Function carrying out a job
+typedef void (*JobFunction) (void* data);
+
+class Job;
+
+/// Jobs waiting to be run. The thread owning the queue takes the newest job,
+/// other threads steal the oldest.
+typedef struct {
+
+	Job*         jobs[JOB_QUEUE]; ///< The jobs, in a ring
+	int          top; ///< Position of the oldest job
+	int          bottom; ///< Position after the newest job
+	SDL_SpinLock lock; ///< Guards the queue
+
+} JobQueue;
+
+
+// Classes
+
+/// Work to be done by whichever thread is free. Set up by JobSystem::prepare,
+/// and must be kept until it is done.
+class Job {
+
+	public:
+		JobFunction  function; ///< What to do, or NULL to do nothing but wait for children
+		void*        data; ///< What to do it to
+		Job*         parent; ///< Job which is not done until this one is, or NULL
+		Job*         dependents[JOB_DEPENDENTS]; ///< Jobs waiting for this one to be done
+		int          nDependents; ///< Number of jobs waiting for this one
+		SDL_atomic_t unfinished; ///< 1 until this job has run, plus its unfinished children
+		SDL_atomic_t dependencies; ///< Jobs still to be done before this one can run, plus 1 until submitted
+		SDL_atomic_t done; ///< Whether or not this job, and its children, are done
+		SDL_SpinLock lock; ///< Guards the dependents
+		bool         background; ///< Whether or not only worker threads run this job
+
+};
+
+/// Threads, one for each spare core, sharing jobs between them
+class JobSystem {
+
+	private:
+		SDL_Thread*  workers[JOB_WORKERS]; ///< Threads running jobs
+		SDL_threadID workerIDs[JOB_WORKERS]; ///< Each worker's thread ID
+		int          nWorkers; ///< Number of worker threads
+		SDL_atomic_t started; ///< Number of worker threads which have started
+		JobQueue     queues[JOB_WORKERS + 1]; ///< Each thread's jobs, the main thread's first
+		JobQueue     backgroundQueue; ///< Background jobs, never run by a thread waiting for other work
+		SDL_sem*     available; ///< Signalled for each job added
+		bool         quit; ///< Whether or not the worker threads should exit
+
+		static int runWorker (void* data);
+
+		bool push     (JobQueue* queue, Job* job);
+		Job* pop      (JobQueue* queue);
+		Job* steal    (JobQueue* queue);
+		int  getIndex ();
+		Job* find     (int index, bool background);
+		void schedule (Job* job);
+		void execute  (Job* job);
+		void finish   (Job* job);
+
+	public:
+		JobSystem  ();
+		~JobSystem ();
+
+		void start      ();
+		void stop       ();
+		int  getWorkers ();
+		void prepare    (Job* job, JobFunction function, void* data, Job* parent, bool background);
+		void depend     (Job* job, Job* dependency);
+		void submit     (Job* job);
+		void wait       (Job* job);
+		bool isDone     (Job* job);
+
+};
+
+
+// Variable
+
+EXTERN JobSystem jobs; ///< Threads sharing work between the cores
+
+#endif
+
@@ -0,0 +1,135 @@
+
+/**
+ *
+ * @file arena.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created arena.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Hands out memory from a few large blocks, all freed together, rather than
+ * from many small heap allocations which each need freeing.
+ *
+ */
+
+
+#include "arena.h"
+
+#include <stddef.h>
+
+
+// The header is padded so that block contents stay aligned
+#define ARENA_HEADER ((sizeof(ArenaBlock) + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1))
+
+
+/**
+ * Create an empty arena.
+ */
+Arena::Arena () {
+
+	blocks = NULL;
+	used = 0;
+
+	return;
+
+}
+
+
+/**
+ * Delete the arena, and everything allocated from it.
+ */
+Arena::~Arena () {
+
+	reset();
+
+	return;
+
+}
+
+
+/**
+ * Allocate memory from the arena. The memory is not cleared.
+ *
+ * @param size Number of bytes to allocate
+ *
+ * @return The memory, which stays valid until the arena is reset
+ */
+void* Arena::allocate (int size) {
+
+	ArenaBlock* block;
+
+	size = (size + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+	if (blocks && (used + size <= blocks->size)) {
+
+		used += size;
+
+		return ((unsigned char *)blocks) + ARENA_HEADER + used - size;
+
+	}
+
+	if (size > ARENA_BLOCK >> 2) {
+
+		// Large allocations get a block each, leaving the current block to be
+		// filled by smaller allocations
+		block = (ArenaBlock *)(new unsigned char[ARENA_HEADER + size]);
+		block->size = size;
+
+		if (blocks) {
+
+			block->next = blocks->next;
+			blocks->next = block;
+
+		} else {
+
+			block->next = NULL;
+			blocks = block;
+			used = size;
+
+		}
+
+		return ((unsigned char *)block) + ARENA_HEADER;
+
+	}
+
+	block = (ArenaBlock *)(new unsigned char[ARENA_HEADER + ARENA_BLOCK]);
+	block->next = blocks;
+	block->size = ARENA_BLOCK;
+	blocks = block;
+	used = size;
+
+	return ((unsigned char *)block) + ARENA_HEADER;
+
+}
+
+
+/**
+ * Free everything allocated from the arena at once.
+ */
+void Arena::reset () {
+
+	ArenaBlock* block;
+
+	while (blocks) {
+
+		block = blocks;
+		blocks = block->next;
+
+		delete[] (unsigned char *)block;
+
+	}
+
+	used = 0;
+
+	return;
+
+}
+
@@ -0,0 +1,61 @@
+
+/**
+ *
+ * @file arena.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created arena.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _ARENA_H
+#define _ARENA_H
+
+
+// Constants
+
+#define ARENA_BLOCK (256 << 10) /* Usual size of the blocks memory is taken from */
+#define ARENA_ALIGN 16 /* Allocations start at multiples of this */
+
+
+// Datatype
+
+/// Block of memory belonging to an arena
+typedef struct ArenaBlock {
+
+	struct ArenaBlock* next; ///< The next block
+	int                size; ///< Number of bytes in the block, after the header
+
+} ArenaBlock;
+
+
+// Class
+
+/// Memory for plain data which lives until the arena is reset, such as a
+/// level's grids. Allocations are never freed individually.
+class Arena {
+
+	private:
+		ArenaBlock* blocks; ///< The blocks, the one being filled first
+		int         used; ///< Bytes used in the block being filled
+
+	public:
+		Arena  ();
+		~Arena ();
+
+		void* allocate (int size);
+		void  reset    ();
+
+};
+
+#endif
+
@@ -0,0 +1,807 @@
+
+/**
+ *
+ * @file benchmark.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created benchmark.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Times level steps or frames and the parts of them, and reports the
+ * results.
+ *
+ * Each benchmark can be run several times, and the median and median absolute
+ * deviation of each result kept in a file. Results are compared with those of
+ * an earlier build, and count as a regression when they are worse by more than
+ * both BENCH_NOISE deviations and BENCH_FLOOR percent. Results only ever get
+ * compared with those of a build with the same options on the same platform.
+ *
+ */
+
+
+#include "benchmark.h"
+
+#include "io/file.h"
+#include "io/gfx/video.h"
+#include "level/level.h"
+#include "clock.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+// The platform, which results must match to be compared
+#if defined(__SWITCH__)
+	#define BENCH_PLATFORM "switch"
+#elif defined(PSP)
+	#define BENCH_PLATFORM "psp"
+#elif defined(_3DS)
+	#define BENCH_PLATFORM "3ds"
+#elif defined(WII)
+	#define BENCH_PLATFORM "wii"
+#elif defined(__HAIKU__)
+	#define BENCH_PLATFORM "haiku"
+#elif defined(_WIN32)
+	#define BENCH_PLATFORM "windows"
+#elif defined(__APPLE__)
+	#define BENCH_PLATFORM "macos"
+#else
+	#define BENCH_PLATFORM "unix"
+#endif
+
+#define BENCH_IDENTIFIER "OpenJazz benchmark" /* First line of a results file */
+
+
+/// Names of the sections, as logged
+static const char* sectionNames[BENCH_SECTIONS] = {"events", "players",
+	"bullets", "collision", "level draw", "palette effects", "conversion",
+	"scaling", "present"};
+
+/// Names of the sections, as kept in results files
+static const char* sectionKeys[BENCH_SECTIONS] = {"events", "players",
+	"bullets", "collision", "draw", "palette", "convert", "scale", "present"};
+
+
+/**
+ * Create a benchmark which has not been requested.
+ */
+Benchmark::Benchmark () {
+
+	levels = NULL;
+	replayFile = NULL;
+	label = NULL;
+	baselineFile = NULL;
+	resultsFile = NULL;
+	metrics = NULL;
+	nMetrics = 0;
+	runs = 0;
+	stepTimes = NULL;
+	mode = BM_OFF;
+	running = false;
+	steps = 0;
+	sweepFrames = 0;
+
+	return;
+
+}
+
+
+/**
+ * Delete the benchmark.
+ */
+Benchmark::~Benchmark () {
+
+	if (stepTimes) delete[] stepTimes;
+	if (metrics) delete[] metrics;
+
+	return;
+
+}
+
+
+/**
+ * Get the time from a microsecond counter.
+ *
+ * @return The time
+ */
+unsigned int Benchmark::getTime () {
+
+	return (unsigned int)getClock();
+
+}
+
+
+/**
+ * Benchmark level steps instead of playing levels.
+ *
+ * @param replay The replay to play back, which must outlive the benchmark
+ */
+void Benchmark::requestSteps (const char* replay) {
+
+	mode = BM_STEPS;
+	replayFile = replay;
+
+	return;
+
+}
+
+
+/**
+ * Benchmark drawing the given levels instead of playing them.
+ *
+ * @param levelList Comma-separated level file names, which must outlive the benchmark
+ */
+void Benchmark::requestFrames (const char* levelList) {
+
+	mode = BM_FRAMES;
+	levels = levelList;
+
+	return;
+
+}
+
+
+/**
+ * Benchmark the hot kernels instead of playing the game.
+ */
+void Benchmark::requestKernels () {
+
+	mode = BM_KERNELS;
+
+	return;
+
+}
+
+
+/**
+ * Run the benchmark the given number of times.
+ *
+ * @param count Number of runs
+ */
+void Benchmark::requestRuns (int count) {
+
+	if (count < 1) count = 1;
+	else if (count > BENCH_MOST_RUNS) count = BENCH_MOST_RUNS;
+
+	runs = count;
+
+	return;
+
+}
+
+
+/**
+ * Compare the results with those kept in the given file by an earlier build.
+ *
+ * @param fileName The file, which must outlive the benchmark
+ */
+void Benchmark::requestBaseline (const char* fileName) {
+
+	baselineFile = fileName;
+
+	return;
+
+}
+
+
+/**
+ * Keep the results in the given file, for later builds to be compared with.
+ *
+ * @param fileName The file, which must outlive the benchmark
+ */
+void Benchmark::requestResults (const char* fileName) {
+
+	resultsFile = fileName;
+
+	return;
+
+}
+
+
+/**
+ * Determine what should be benchmarked instead of playing levels.
+ *
+ * @return The benchmark mode (BM_OFF if levels should be played)
+ */
+BenchMode Benchmark::getMode () {
+
+	return mode;
+
+}
+
+
+/**
+ * Get the levels to draw.
+ *
+ * @return Comma-separated level file names, or NULL if not benchmarking frames
+ */
+const char* Benchmark::getLevels () {
+
+	return (mode == BM_FRAMES)? levels: NULL;
+
+}
+
+
+/**
+ * Get the replay to play back.
+ *
+ * @return The replay file name, or NULL if not benchmarking steps
+ */
+const char* Benchmark::getReplay () {
+
+	return (mode == BM_STEPS)? replayFile: NULL;
+
+}
+
+
+/**
+ * Find how many times the benchmark should be run. Results are only compared
+ * or kept after several runs, unless told otherwise.
+ *
+ * @return Number of runs
+ */
+int Benchmark::getRuns () {
+
+	if ((mode != BM_STEPS) && (mode != BM_FRAMES)) return 1;
+
+	if (runs) return runs;
+
+	return (baselineFile || resultsFile)? BENCH_RUNS: 1;
+
+}
+
+
+/**
+ * Set the level whose results are reported next.
+ *
+ * @param level The level's file name, which must outlive its results being
+ * reported
+ */
+void Benchmark::setLabel (const char* level) {
+
+	label = level;
+
+	return;
+
+}
+
+
+/**
+ * Start timing steps.
+ */
+void Benchmark::start () {
+
+	if (!stepTimes) stepTimes = new unsigned int[BENCH_BUCKETS];
+
+	memset(stepTimes, 0, sizeof(unsigned int) * BENCH_BUCKETS);
+	memset(sectionTimes, 0, sizeof(sectionTimes));
+
+	steps = 0;
+	running = true;
+	startTime = getTime();
+
+	return;
+
+}
+
+
+/**
+ * Note the start of a step.
+ */
+void Benchmark::startStep () {
+
+	stepStart = getTime();
+
+	return;
+
+}
+
+
+/**
+ * Note the end of a step, and count its time.
+ */
+void Benchmark::endStep () {
+
+	unsigned int time;
+
+	time = getTime() - stepStart;
+
+	if (time >= BENCH_BUCKETS) time = BENCH_BUCKETS - 1;
+
+	stepTimes[time]++;
+	steps++;
+
+	return;
+
+}
+
+
+/**
+ * Note the start of a section of a step.
+ *
+ * @param section The section
+ */
+void Benchmark::enter (BenchSection section) {
+
+	if (running) sectionStarts[section] = getTime();
+
+	return;
+
+}
+
+
+/**
+ * Note the end of a section of a step, and count its time.
+ *
+ * @param section The section
+ */
+void Benchmark::leave (BenchSection section) {
+
+	if (running) sectionTimes[section] += getTime() - sectionStarts[section];
+
+	return;
+
+}
+
+
+/**
+ * Start or stop moving the view along a sweep of the level, instead of
+ * following the player.
+ *
+ * @param frames Number of frames to take over the sweep, or 0 to stop
+ */
+void Benchmark::setSweep (int frames) {
+
+	sweepFrames = frames;
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not the view is sweeping the level.
+ *
+ * @return Whether or not the view is sweeping
+ */
+bool Benchmark::isSweeping () {
+
+	return sweepFrames != 0;
+
+}
+
+
+/**
+ * Move the view to where the sweep has reached. The view goes back and forth
+ * along rows half a canvas apart, so every part of the level is seen.
+ *
+ * @param width Width of the level, in pixels
+ * @param height Height of the level, in pixels
+ */
+void Benchmark::sweep (int width, int height) {
+
+	int span, rows, row, column;
+	long long position;
+
+	span = width - canvasW;
+	if (span < 0) span = 0;
+	span++;
+
+	rows = ((height - canvasH) / (canvasH >> 1)) + 2;
+	if (rows < 1) rows = 1;
+
+	position = ((long long)steps * span * rows) / sweepFrames;
+	row = position / span;
+	column = position % span;
+
+	if (row & 1) column = span - 1 - column;
+
+	viewX = ITOF(column);
+	viewY = ITOF(row * (canvasH >> 1));
+
+	return;
+
+}
+
+
+/**
+ * Find the time within which the given percentage of steps were taken.
+ *
+ * @param percentile The percentage of steps
+ *
+ * @return The time, in microseconds
+ */
+unsigned int Benchmark::getStepTime (int percentile) {
+
+	int count, bucket;
+
+	count = 0;
+
+	for (bucket = 0; bucket < BENCH_BUCKETS - 1; bucket++) {
+
+		count += stepTimes[bucket];
+
+		if (count * 100 >= steps * percentile) break;
+
+	}
+
+	return bucket;
+
+}
+
+
+/**
+ * Add the result of a run.
+ *
+ * @param prefix The level and what was timed
+ * @param measure The measure
+ * @param value The result
+ * @param higherBetter Whether higher results are better, rather than lower
+ */
+void Benchmark::record (const char* prefix, const char* measure, int value, bool higherBetter) {
+
+	BenchMetric* metric;
+	char name[BENCH_NAME];
+	int count;
+
+	snprintf(name, BENCH_NAME, "%s/%s", prefix, measure);
+
+	if (!metrics) metrics = new BenchMetric[BENCH_METRICS];
+
+	for (count = 0; (count < nMetrics) && strcmp(metrics[count].name, name); count++);
+
+	metric = metrics + count;
+
+	if (count == nMetrics) {
+
+		if (nMetrics == BENCH_METRICS) return;
+
+		strcpy(metric->name, name);
+		metric->nValues = 0;
+		metric->higherBetter = higherBetter;
+		nMetrics++;
+
+	}
+
+	if (metric->nValues < BENCH_MOST_RUNS) metric->values[metric->nValues++] = value;
+
+	return;
+
+}
+
+
+/**
+ * Stop timing, and log the results.
+ *
+ * @param name What was timed, e.g. "steps"
+ */
+void Benchmark::report (const char* name) {
+
+	char prefix[BENCH_NAME];
+	unsigned int time;
+	int count, value;
+
+	running = false;
+	time = getTime() - startTime;
+
+	log("Benchmark", name);
+	log("  count", steps);
+
+	if (!steps) return;
+
+	// Results are named after the level, what was timed, and the scale
+	// factor it was drawn at
+#ifdef SCALE
+	if (mode == BM_FRAMES) snprintf(prefix, BENCH_NAME, "%s/%s/x%d", label? label: "level", name, video.getScaleFactor());
+	else snprintf(prefix, BENCH_NAME, "%s/%s", label? label: "level", name);
+#else
+	snprintf(prefix, BENCH_NAME, "%s/%s", label? label: "level", name);
+#endif
+
+	value = time? (int)((steps * 1000000LL) / time): 0;
+	log("  per second", value);
+	record(prefix, "rate", value, true);
+
+	value = getStepTime(50);
+	log("  p50 (us)", value);
+	record(prefix, "p50", value, false);
+
+	value = getStepTime(99);
+	log("  p99 (us)", value);
+	record(prefix, "p99", value, false);
+
+	// Only the sections which were timed are shown
+	for (count = 0; count < BENCH_SECTIONS; count++) {
+
+		if (!sectionTimes[count]) continue;
+
+		value = (int)((sectionTimes[count] * 100LL) / steps);
+		log("  section", sectionNames[count]);
+		log("    each (us x 100)", value);
+		record(prefix, sectionKeys[count], value, false);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Describe the build options which affect timings.
+ *
+ * @param build Where to write the description
+ * @param size Space for the description
+ */
+void Benchmark::getBuild (char* build, int size) {
+
+	snprintf(build, size, "%s%s%s%s%s", BENCH_PLATFORM,
+#ifdef SDL2
+		"-sdl2",
+#else
+		"-sdl1",
+#endif
+#ifdef SCALE
+		"-scale",
+#else
+		"",
+#endif
+#ifdef PROFILE
+		"-profile",
+#else
+		"",
+#endif
+#ifdef TRACK_MEMORY
+		"-memtrack"
+#else
+		""
+#endif
+		);
+
+	return;
+
+}
+
+
+/**
+ * Find the median of some results.
+ *
+ * @param values The results, which are put in order
+ * @param count Number of results
+ *
+ * @return The median
+ */
+int Benchmark::getMedian (int* values, int count) {
+
+	int value, place, index;
+
+	// Insertion sort, as there are few runs
+	for (index = 1; index < count; index++) {
+
+		value = values[index];
+
+		for (place = index; (place > 0) && (values[place - 1] > value); place--)
+			values[place] = values[place - 1];
+
+		values[place] = value;
+
+	}
+
+	if (count & 1) return values[count >> 1];
+
+	return (values[(count >> 1) - 1] + values[count >> 1]) >> 1;
+
+}
+
+
+/**
+ * Keep the results, for later builds to be compared with.
+ *
+ * @param build Description of the build options
+ */
+void Benchmark::saveResults (const char* build) {
+
+	File* file;
+	char line[BENCH_NAME + 32];
+	int count, length;
+
+	try {
+
+		file = new File(resultsFile, true);
+
+	} catch (int e) {
+
+		logError("Could not write benchmark results", resultsFile);
+
+		return;
+
+	}
+
+	length = snprintf(line, sizeof(line), "%s\nbuild %s\n", BENCH_IDENTIFIER, build);
+	file->storeBlock((unsigned char *)line, length);
+
+	for (count = 0; count < nMetrics; count++) {
+
+		length = snprintf(line, sizeof(line), "%s %d %d\n", metrics[count].name,
+			metrics[count].median, metrics[count].spread);
+		file->storeBlock((unsigned char *)line, length);
+
+	}
+
+	delete file;
+
+	log("Benchmark results saved", resultsFile);
+
+	return;
+
+}
+
+
+/**
+ * Compare the results with those of an earlier build, and log the changes.
+ *
+ * @param build Description of the build options
+ *
+ * @return Error code (E_REGRESSION if any result got worse)
+ */
+int Benchmark::compare (const char* build) {
+
+	File* file;
+	BenchMetric* metric;
+	unsigned char* block;
+	char* text;
+	char* line;
+	char* next;
+	char name[BENCH_NAME];
+	char change[BENCH_NAME + 64];
+	int size, count, median, spread, difference, threshold, regressions;
+
+	try {
+
+		file = new File(baselineFile, false);
+
+	} catch (int e) {
+
+		logError("Could not read benchmark baseline", baselineFile);
+
+		return e;
+
+	}
+
+	size = file->getSize();
+	block = file->loadBlock(size);
+
+	delete file;
+
+	text = new char[size + 1];
+	memcpy(text, block, size);
+	text[size] = 0;
+
+	delete[] block;
+
+	// The identifier and build options come first
+	line = text;
+	next = strchr(line, '\n');
+
+	if (!next || (next - line != (int)strlen(BENCH_IDENTIFIER)) ||
+		strncmp(line, BENCH_IDENTIFIER, next - line)) {
+
+		delete[] text;
+
+		logError("Not a benchmark results file", baselineFile);
+
+		return E_DATA;
+
+	}
+
+	line = next + 1;
+	next = strchr(line, '\n');
+	if (next) *next = 0;
+
+	if (strncmp(line, "build ", 6) || strcmp(line + 6, build)) {
+
+		logError("Benchmark baseline is from a different build", line);
+
+		delete[] text;
+
+		return E_VERSION;
+
+	}
+
+	regressions = 0;
+
+	while (next) {
+
+		line = next + 1;
+		next = strchr(line, '\n');
+		if (next) *next = 0;
+
+		if (sscanf(line, "%63s %d %d", name, &median, &spread) != 3) continue;
+
+		for (count = 0; (count < nMetrics) && strcmp(metrics[count].name, name); count++);
+
+		if (count == nMetrics) continue;
+
+		metric = metrics + count;
+
+		// Positive differences are worse, whichever way the result goes
+		difference = metric->median - median;
+		if (metric->higherBetter) difference = -difference;
+
+		// A change must stand out from the noise of both sets of runs
+		threshold = BENCH_NOISE * (metric->spread + spread);
+		if (threshold < (abs(median) * BENCH_FLOOR) / 100) threshold = (abs(median) * BENCH_FLOOR) / 100;
+
+		snprintf(change, sizeof(change), "  %s: %d -> %d (%+d%%)", name, median,
+			metric->median, median? (int)(((metric->median - median) * 100LL) / median): 0);
+
+		if (difference > threshold) {
+
+			log(change, "regression");
+			regressions++;
+
+		} else if (difference < -threshold) {
+
+			log(change, "improvement");
+
+		} else log(change, "within noise");
+
+	}
+
+	delete[] text;
+
+	log("Benchmark regressions", regressions);
+
+	return regressions? E_REGRESSION: E_NONE;
+
+}
+
+
+/**
+ * Find the median and spread of each result over the runs, keep them if asked
+ * to, and compare them with the baseline if there is one.
+ *
+ * @return Error code (E_REGRESSION if any result got worse than the baseline)
+ */
+int Benchmark::finish () {
+
+	int deviations[BENCH_MOST_RUNS];
+	char build[BENCH_NAME];
+	int count, run;
+
+	if (!nMetrics) return E_NONE;
+
+	getBuild(build, BENCH_NAME);
+
+	for (count = 0; count < nMetrics; count++) {
+
+		metrics[count].median = getMedian(metrics[count].values, metrics[count].nValues);
+
+		for (run = 0; run < metrics[count].nValues; run++)
+			deviations[run] = abs(metrics[count].values[run] - metrics[count].median);
+
+		metrics[count].spread = getMedian(deviations, metrics[count].nValues);
+
+	}
+
+	log("Benchmark runs", getRuns());
+	log("Benchmark build", build);
+
+	if (resultsFile) saveResults(build);
+
+	if (!baselineFile) return E_NONE;
+
+	return compare(build);
+
+}
+
@@ -0,0 +1,185 @@
+
+/**
+ *
+ * @file benchmark.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created benchmark.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _BENCHMARK_H
+#define _BENCHMARK_H
+
+
+#include "OpenJazz.h"
+
+#define SDL2
+
+#ifdef SDL2
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+
+// Constants
+
+// Number of microseconds covered by the step time histogram. Longer steps are
+// counted in the last bucket.
+#ifndef BENCH_BUCKETS
+	#define BENCH_BUCKETS 10000
+#endif
+
+// Number of frames drawn for each scale factor when benchmarking drawing
+#ifndef BENCH_FRAMES
+	#define BENCH_FRAMES 600
+#endif
+
+// Largest scale factor used when benchmarking drawing
+#ifndef BENCH_SCALES
+	#define BENCH_SCALES 3
+#endif
+
+// Number of times each benchmark is run when comparing results
+#ifndef BENCH_RUNS
+	#define BENCH_RUNS 5
+#endif
+
+// Median absolute deviations a result must move by to count as a change
+#ifndef BENCH_NOISE
+	#define BENCH_NOISE 3
+#endif
+
+// Percentage a result must move by to count as a change, however steady
+#ifndef BENCH_FLOOR
+	#define BENCH_FLOOR 2
+#endif
+
+#define BENCH_SECTIONS  9
+#define BENCH_METRICS   256 /* Most results kept for comparison */
+#define BENCH_MOST_RUNS 31 /* Most runs whose results are kept */
+#define BENCH_NAME      64 /* Longest name of a result, including the terminator */
+
+
+// Enums
+
+/// What is being benchmarked
+enum BenchMode {
+
+	BM_OFF = 0, ///< Nothing, levels are played
+	BM_STEPS = 1, ///< Level steps, played back from a replay
+	BM_FRAMES = 2, ///< Drawing and showing frames, along a sweep of each level
+	BM_KERNELS = 3 ///< Hot kernels in isolation
+
+};
+
+/// Parts of a step or frame which are timed separately
+enum BenchSection {
+
+	BS_EVENTS = 0, ///< Creating and processing events
+	BS_PLAYERS = 1, ///< Players' controls and reactions
+	BS_BULLETS = 2, ///< Processing bullets
+	BS_COLLISION = 3, ///< Moving players without going into the scenery
+	BS_DRAW = 4, ///< Drawing the level to the canvas
+	BS_PALETTE = 5, ///< Applying palette effects
+	BS_CONVERT = 6, ///< Converting palette indices for display
+	BS_SCALE = 7, ///< Scaling the canvas to the screen
+	BS_PRESENT = 8 ///< Presenting the frame
+
+};
+
+
+// Datatype
+
+/// A result, from each run of a benchmark
+typedef struct {
+
+	char name[BENCH_NAME]; ///< The level, what was timed, and the measure
+	int  values[BENCH_MOST_RUNS]; ///< The result of each run
+	int  nValues; ///< Number of runs
+	int  median; ///< Median of the runs, once finished
+	int  spread; ///< Median absolute deviation of the runs, once finished
+	bool higherBetter; ///< Whether higher results are better, rather than lower
+
+} BenchMetric;
+
+
+// Class
+
+/// Timing of level steps, played back from a replay as fast as possible, or
+/// of frames drawn while the view sweeps across each level
+class Benchmark {
+
+	private:
+		const char*   levels; ///< Comma-separated levels to draw, when benchmarking frames
+		const char*   replayFile; ///< Replay to play back, when benchmarking steps
+		const char*   label; ///< The level being benchmarked, or NULL
+		const char*   baselineFile; ///< Earlier results to compare with, or NULL
+		const char*   resultsFile; ///< Where to keep the results, or NULL
+		BenchMetric*  metrics; ///< Results of every run, or NULL until the first finishes
+		int           nMetrics; ///< Number of results
+		int           runs; ///< Number of runs requested, or 0 if not requested
+		unsigned int* stepTimes; ///< Histogram of step or frame times, in microseconds
+		unsigned int  sectionTimes[BENCH_SECTIONS]; ///< Total time spent in each section
+		unsigned int  sectionStarts[BENCH_SECTIONS]; ///< Time each section was entered
+		unsigned int  startTime; ///< Time the benchmark started
+		unsigned int  stepStart; ///< Time the current step started
+		int           steps; ///< Number of steps or frames timed
+		int           sweepFrames; ///< Number of frames the view takes to sweep the level, or 0
+		BenchMode     mode; ///< What is being benchmarked
+		bool          running; ///< Whether or not steps are being timed
+
+		static void getBuild  (char* build, int size);
+		static int  getMedian (int* values, int count);
+
+		unsigned int getTime         ();
+		unsigned int getStepTime     (int percentile);
+		void         record          (const char* prefix, const char* measure, int value, bool higherBetter);
+		void         saveResults     (const char* build);
+		int          compare         (const char* build);
+
+	public:
+		Benchmark  ();
+		~Benchmark ();
+
+		void        requestSteps    (const char* replay);
+		void        requestFrames   (const char* levelList);
+		void        requestKernels  ();
+		void        requestRuns     (int count);
+		void        requestBaseline (const char* fileName);
+		void        requestResults  (const char* fileName);
+		BenchMode   getMode         ();
+		const char* getLevels       ();
+		const char* getReplay       ();
+		int         getRuns         ();
+		void        setLabel        (const char* level);
+		void        start          ();
+		void        startStep      ();
+		void        endStep        ();
+		void        enter          (BenchSection section);
+		void        leave          (BenchSection section);
+		void        setSweep       (int frames);
+		bool        isSweeping     ();
+		void        sweep          (int width, int height);
+		void        report         (const char* name);
+		int         finish         ();
+
+};
+
+
+// Variable
+
+EXTERN Benchmark bench;
+
+#endif
+
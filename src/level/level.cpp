@@ -31,8 +31,12 @@
 
 
 #include "level.h"
+#include "benchmark.h"
+#include "pool.h"
+#include "replay.h"
 
 #include "game/game.h"
+#include "io/assetcache.h"
 #include "io/controls.h"
 #include "io/gfx/font.h"
 #include "io/gfx/sprite.h"
@@ -40,8 +44,18 @@
 #include "io/sound.h"
 #include "player/player.h"
 #include "jj1scene/jj1scene.h"
+#include "clock.h"
 #include "loop.h"
+#include "memtrack.h"
+#include "pacer.h"
+#include "profile.h"
+#include "residency.h"
+#include "scratch.h"
 #include "setup.h"
+#include "util.h"
+
+#include <new>
+#include <string.h>
 
 
 /**
@@ -49,6 +63,13 @@
  */
 Level::Level (Game* owner) {
 
+	int ret;
+
+	// The panel fonts are loaded when the first level is played
+	ret = loadPanelFonts();
+
+	if (ret < 0) throw ret;
+
 	game = owner;
 
 	menuOptions[0] = "continue game";
@@ -60,15 +81,28 @@ Level::Level (Game* owner) {
 	// Arbitrary initial value
 	smoothfps = 50.0f;
 
+	prevFraction = 0;
+	tickFraction = 0;
+
 	paletteEffects = NULL;
 
 	paused = false;
+	ownsMusic = true;
+	frameSteps = 0;
 
 	// Set the level stage
 	stage = LS_NORMAL;
 
 	stats = 0;
 
+	rewindLog = NULL;
+	saved = NULL;
+	rollback = false;
+	resimulating = false;
+
+	nViewers = 0;
+	viewer = NULL;
+
 	return;
 
 }
@@ -79,9 +113,19 @@ Level::Level (Game* owner) {
  */
 Level::~Level () {
 
-	stopMusic();
+	if (ownsMusic) stopMusic();
 
 	if (paletteEffects) delete paletteEffects;
+	if (rewindLog) delete[] rewindLog;
+	if (saved) delete saved;
+
+#ifdef SDL2
+	// Menus and scenes are drawn to the whole canvas
+	video.fullResolution();
+#endif
+
+	PROFILE_LEAVE();
+	MEMORY_LOG();
 
 	return;
 
@@ -151,14 +195,73 @@ int Level::playScene (const char* file) {
 }
 
 
+/**
+ * Decode the level's tile set and music in the background, while the loading
+ * screen carries on being shown, with a row of blocks lit in turn beneath it
+ * to show that the game has not stalled. The level's own loading then finds
+ * them already decoded.
+ *
+ * @param preloader The function that decodes the assets
+ * @param fileName Name of the file containing the level data
+ *
+ * @return Error code
+ */
+int Level::preloadAssets (AssetPreloader preloader, const char* fileName) {
+
+	bool started;
+	int count;
+
+	started = false;
+
+	while (true) {
+
+		// Anything already being preloaded, most likely for this level, is
+		// left to finish first
+		if (!started && !assetCache.isPreloading()) {
+
+			// Without worker threads, the assets are decoded now
+			assetCache.preload(preloader, fileName);
+			started = true;
+
+		}
+
+		if (started && !assetCache.isPreloading()) break;
+
+		for (count = 0; count < LOAD_BLOCKS; count++) {
+
+			drawRect((canvasW >> 1) + ((count - (LOAD_BLOCKS >> 1)) * 12) - 4,
+				(canvasH >> 1) + 8, 8, 8,
+				(count == (int)((getTicks() / 150) % LOAD_BLOCKS))? 79: 0);
+
+		}
+
+		if (::loop(NORMAL_LOOP) == E_QUIT) {
+
+			assetCache.cancelPreload();
+
+			return E_QUIT;
+
+		}
+
+	}
+
+	assetCache.finishPreload();
+
+	return E_NONE;
+
+}
+
+
 /**
  * Perform timing calculations.
  */
 void Level::timeCalcs () {
 
-	// Calculate smoothed fps
+	int lag;
+
+	// Calculate smoothed fps, from the time between frames to the microsecond
 	smoothfps = smoothfps + 1.0f -
-		(smoothfps * ((float)(ticks - prevTicks)) / 1000.0f);
+		(smoothfps * (((float)(ticks - prevTicks)) + ((tickFraction - prevFraction) / 1000.0f)) / 1000.0f);
 	/* This equation is a simplified version of
 	(fps * c) + (smoothfps * (1 - c))
 	where c = (1 / fps)
@@ -180,20 +283,371 @@ void Level::timeCalcs () {
 
 		tickOffset = globalTicks - ticks;
 
-	} else if (globalTicks - tickOffset > ticks + 100) {
+	} else if (replay.isActive()) {
 
+		// Every frame takes exactly one step, however long it took
 		prevTicks = ticks;
-		ticks += 100;
-
+		ticks = getStepTicks(steps + 1);
 		tickOffset = globalTicks - ticks;
 
+		prevFraction = tickFraction;
+		tickFraction = 0;
+
 	} else {
 
 		prevTicks = ticks;
 		ticks = globalTicks - tickOffset;
 
+		// The offset is in whole milliseconds, so the level's time has the
+		// same fraction as the frame's
+		prevFraction = tickFraction;
+		tickFraction = globalClock % (CLOCK_RATE / 1000);
+
+		// Steps not taken are made up over the next few frames, unless so
+		// many are waiting that catching up would be noticeable
+		lag = ticks - getStepTicks(steps);
+
+		if (lag > T_MAX_LAG) {
+
+			ticks -= lag - T_MAX_LAG;
+			tickOffset = globalTicks - ticks;
+
+		}
+
+	}
+
+	frameSteps = 0;
+
+	return;
+
+}
+
+
+/**
+ * Calculate the time at which a step is taken.
+ *
+ * @param step The number of the step
+ *
+ * @return The step's time
+ */
+unsigned int Level::getStepTicks (unsigned int step) {
+
+	return (step * ((setup.slowMotion && !replay.isActive())? 100: 50)) / 3;
+
+}
+
+
+/**
+ * Calculate the exact time at which a step is taken. Steps are taken by
+ * their time in whole milliseconds, but drawn between by this.
+ *
+ * @param step The number of the step
+ *
+ * @return The step's time, in microseconds
+ */
+Uint64 Level::getStepClock (unsigned int step) {
+
+	return ((Uint64)step * (((setup.slowMotion && !replay.isActive())? 100: 50) * (CLOCK_RATE / 1000))) / 3;
+
+}
+
+
+/**
+ * Calculate the viewport. Levels which follow the player override this.
+ *
+ * @param alpha Progress towards the next step
+ */
+void Level::calcView (fixed alpha) {
+
+	(void)alpha;
+
+	return;
+
+}
+
+
+/**
+ * Move on once the level is over. Levels which lead to other levels override
+ * this.
+ *
+ * @return Error code
+ */
+int Level::advance () {
+
+	return WON;
+
+}
+
+
+/**
+ * Queue messages bringing another copy of the level, as loaded, up to date with
+ * this one. Levels which change as they are played override this.
+ *
+ * @param queue Queue to receive the messages
+ */
+void Level::sendChanges (NetQueue* queue) {
+
+	(void)queue;
+
+	return;
+
+}
+
+
+/**
+ * Benchmark the level, as requested, instead of playing it.
+ *
+ * @return Error code
+ */
+int Level::benchmark () {
+
+	if (bench.getMode() == BM_FRAMES) return benchFrames();
+
+	return benchSteps();
+
+}
+
+
+/**
+ * Play the level back from the replay as fast as possible, without drawing,
+ * and report how long the steps took.
+ *
+ * @return Error code
+ */
+int Level::benchSteps () {
+
+	int width, height;
+	int ret;
+
+	ret = E_NONE;
+
+	// Events appear where the recording's view could see them
+	width = canvasW;
+	height = canvasH;
+	canvasW = replay.getCanvasWidth();
+	canvasH = replay.getCanvasHeight();
+
+	tickOffset = globalTicks;
+	ticks = T_STEP;
+	steps = 0;
+
+	bench.start();
+
+	while (replay.isActive() && (stage != LS_END)) {
+
+		prevTicks = ticks;
+		ticks = getStepTicks(steps + 1);
+
+		ret = replay.control(localPlayer);
+
+		if (ret < 0) break;
+
+		bench.startStep();
+		ret = step();
+		steps++;
+		bench.endStep();
+
+		// Steps are taken without going through the main loop
+		resetFrameScratch();
+
+		if (ret) break;
+
+		ret = checkState();
+
+		if (ret < 0) break;
+
+		calcView(getAlpha());
+
+	}
+
+	bench.report("steps");
+
+	canvasW = width;
+	canvasH = height;
+
+	return (ret == E_DATA)? E_DATA: E_NONE;
+
+}
+
+
+/**
+ * Run the level for a dedicated server, taking steps at a fixed rate without
+ * drawing anything, until it is over or the server is stopped.
+ *
+ * @return Error code
+ */
+int Level::serve () {
+
+	unsigned int returnTime;
+	int wait, ret;
+
+	tickOffset = globalTicks;
+	ticks = T_STEP;
+	steps = 0;
+	returnTime = 0;
+
+	while (true) {
+
+		ret = game->step(ticks);
+
+		if (ret < 0) return ret;
+
+		// Sleep until the next step is due
+		wait = getStepTicks(steps + 1) - (getTicks() - tickOffset);
+
+		if (wait > 0) SDL_Delay(wait);
+
+		if (::loop(NORMAL_LOOP) == E_QUIT) return E_QUIT;
+
+		timeCalcs();
+
+		if (returnTime && (ticks > returnTime)) return advance();
+
+		while (takeStep()) {
+
+			ret = step();
+			steps++;
+
+			if (ret) return ret;
+
+		}
+
+		// Events are activated by the view
+		calcView(getAlpha());
+
+		if ((stage == LS_END) && !returnTime) returnTime = ticks + T_SERVER_END;
+
+	}
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Draw and show frames while the view sweeps across the level, at each scale
+ * factor, and report how long the frames took.
+ *
+ * @return Error code
+ */
+int Level::benchFrames () {
+
+	int count;
+#ifdef SCALE
+	int scale, original;
+#endif
+
+	video.setPalette(palette);
+
+	ticks = T_STEP;
+	steps = 0;
+
+#ifdef SCALE
+	original = video.getScaleFactor();
+
+	for (scale = 1; scale <= BENCH_SCALES; scale++) {
+
+		if (video.setScaleFactor(scale) != scale) break;
+#endif
+
+		bench.start();
+		bench.setSweep(BENCH_FRAMES);
+
+		for (count = 0; count < BENCH_FRAMES; count++) {
+
+			// Let animations run as they would during play
+			prevTicks = ticks;
+			ticks = getStepTicks(count + 1);
+
+			bench.startStep();
+
+			bench.enter(BS_DRAW);
+			draw();
+			bench.leave(BS_DRAW);
+
+			video.flip(ticks - prevTicks, paletteEffects);
+
+			bench.endStep();
+
+			// Frames are shown without going through the main loop
+			resetFrameScratch();
+
+		}
+
+		bench.setSweep(0);
+
+		log("Benchmark canvas width", canvasW);
+		log("Benchmark canvas height", canvasH);
+		bench.report("frames");
+
+#ifdef SCALE
+	}
+
+	video.setScaleFactor(original);
+#endif
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Calculate a hash of the players' states, which follow from everything else
+ * in the level.
+ *
+ * @return The hash
+ */
+unsigned int Level::getStateHash () {
+
+	unsigned char buffer[MTL_P_TEMP];
+	unsigned int hash;
+	int count, byte;
+
+	hash = 2166136261u ^ ticks;
+
+	for (count = 0; count < nPlayers; count++) {
+
+		memset(buffer, 0, MTL_P_TEMP);
+		players[count].send(buffer);
+
+		for (byte = 0; byte < MTL_P_TEMP; byte++)
+			hash = (hash ^ buffer[byte]) * 16777619u;
+
 	}
 
+	return hash;
+
+}
+
+
+/**
+ * Compare the level's state with the replay being played back, or record it,
+ * when a check is due.
+ *
+ * @return Error code
+ */
+int Level::checkState () {
+
+	if (!replay.isActive() || (steps % REPLAY_CHECK)) return E_NONE;
+
+	return replay.check(steps, getStateHash());
+
+}
+
+
+/**
+ * Apply the second set of controls to the second player, when two local
+ * players share the screen.
+ */
+void Level::controlSecond () {
+
+	int count;
+
+	if (multiplayer || (nPlayers < 2)) return;
+
+	for (count = 0; count < PCONTROLS; count++)
+		players[1].setControl(count, secondControls.getState(count));
+
 	return;
 
 }
@@ -206,7 +660,147 @@ void Level::timeCalcs () {
  */
 int Level::getTimeChange () {
 
-	return paused? 0: ticks - ((steps * (setup.slowMotion? 100: 50)) / 3);
+	return paused? 0: ticks - getStepTicks(steps);
+
+}
+
+
+/**
+ * Determine whether or not another step is due. Each frame takes at most
+ * MAX_CATCH_UP steps, so a hitch is caught up with over several frames rather
+ * than by stalling the next one.
+ *
+ * @return Whether or not to take a step
+ */
+bool Level::takeStep () {
+
+	if (paused || (frameSteps >= MAX_CATCH_UP)) return false;
+
+	if ((int)(ticks - getStepTicks(steps + 1)) < 0) return false;
+
+	frameSteps++;
+
+	return true;
+
+}
+
+
+/**
+ * Calculate how far the level's time is between the last step and the next,
+ * for drawing objects between their positions either side of the last step.
+ *
+ * @return Progress towards the next step, from 0 to F1
+ */
+fixed Level::getAlpha () {
+
+	Uint64 now, start, end;
+
+	if (paused) return F1;
+
+	// Measured in microseconds, so that motion does not judder from frames
+	// and steps falling on whole milliseconds
+	now = ((Uint64)ticks * (CLOCK_RATE / 1000)) + tickFraction;
+	start = getStepClock(steps);
+	end = getStepClock(steps + 1);
+
+	if (now >= end) return F1;
+	if (now <= start) return 0;
+
+	return DIV((int)(now - start), (int)(end - start));
+
+}
+
+
+/**
+ * Choose the players whose views are shown side by side. Each view is drawn
+ * into its own part of the canvas, using the same caches.
+ *
+ * @param newViewers The players, which must outlive the level
+ * @param count The number of players, or 0 to show only the local player's view
+ */
+void Level::setViewers (Player** newViewers, int count) {
+
+	int index;
+
+	if (count > MAX_VIEWPORTS) count = MAX_VIEWPORTS;
+
+	for (index = 0; index < count; index++) viewers[index] = newViewers[index];
+
+	nViewers = count;
+
+	return;
+
+}
+
+
+/**
+ * Get the number of views to draw.
+ *
+ * @return The number of views
+ */
+int Level::getViews () {
+
+	return nViewers? nViewers: 1;
+
+}
+
+
+/**
+ * Start drawing a view. While there is more than one view, the canvas is
+ * narrowed to the view's part of it.
+ *
+ * @param index The view
+ */
+void Level::beginView (int index) {
+
+	SDL_Rect area;
+
+	if (nViewers < 2) {
+
+		viewer = nViewers? viewers[0]: NULL;
+
+		return;
+
+	}
+
+	// Each view is as tall as the canvas
+	area.w = canvasW / nViewers;
+	area.h = canvasH;
+	area.x = area.w * index;
+	area.y = 0;
+
+	viewer = viewers[index];
+	viewports[index].begin(&area);
+
+	return;
+
+}
+
+
+/**
+ * Finish drawing a view, going back to the whole canvas.
+ *
+ * @param index The view
+ */
+void Level::endView (int index) {
+
+	if (nViewers >= 2) viewports[index].end();
+
+	viewer = NULL;
+
+	return;
+
+}
+
+
+/**
+ * Get the player whose view is being calculated or drawn.
+ *
+ * @return The player
+ */
+Player* Level::getViewer () {
+
+	return viewer? viewer: localPlayer;
 
 }
 
@@ -226,18 +820,35 @@ void Level::drawOverlay (unsigned char bg, bool menu, int option,
 	int textPalSpan) {
 
 	const char* difficultyOptions[4] = {"easy", "medium", "hard", "turbo"};
-	int count, width;
+	const char* trafficLabels[4] = {"rtt", "kb in", "kb out", "queue"};
+	const char* paceTargets[PACE_TARGETS] = {"vsync", "30 fps", "60 fps", "120 fps", "uncapped"};
+	Pool* pool;
+	NetStats* traffic;
+	int count, width, pools, poolY;
+	int left, top, netWidth, column, y;
+	int audioAverage, audioPeak, audioBudget;
 
 	// Draw graphics statistics
 
 	if (stats & S_SCREEN) {
 
+		// Pools in use get a row each, below the others
+		pools = 0;
+
+		for (pool = Pool::getPools(); pool; pool = pool->getNext())
+			if (pool->getCapacity()) pools++;
+
+		poolY = 98;
+
 #ifdef SCALE
-		if (video.getScaleFactor() > 1)
-			drawRect(canvasW - 84, 11, 80, 37, bg);
-		else
+		if (video.getScaleFactor() > 1) {
+
+			drawRect(canvasW - 84, 11, 80, 97 + (pools * 12), bg);
+			poolY = 110;
+
+		} else
 #endif
-			drawRect(canvasW - 84, 11, 80, 25, bg);
+			drawRect(canvasW - 84, 11, 80, 85 + (pools * 12), bg);
 
 		panelBigFont->showNumber(video.getWidth(), canvasW - 52, 14);
 		panelBigFont->showString("x", canvasW - 48, 14);
@@ -245,12 +856,86 @@ void Level::drawOverlay (unsigned char bg, bool menu, int option,
 		panelBigFont->showString("fps", canvasW - 76, 26);
 		panelBigFont->showNumber((int)smoothfps, canvasW - 12, 26);
 
+		// The frame rate target, then how late frames are shown on average
+		// and at worst, in microseconds
+		panelBigFont->showString(paceTargets[pacer.getTarget()], canvasW - 76, 38);
+		panelBigFont->showString("jit", canvasW - 76, 50);
+		panelBigFont->showNumber(pacer.getJitter(), canvasW - 12, 50);
+		panelBigFont->showString("max", canvasW - 76, 62);
+		panelBigFont->showNumber(pacer.getWorstJitter(), canvasW - 12, 62);
+
+		// How long the audio callback takes, as percentages of how long each
+		// buffer lasts on average and at worst, then how long that is, in
+		// microseconds
+		getAudioTimes(&audioAverage, &audioPeak, &audioBudget);
+
+		panelBigFont->showString("aud", canvasW - 76, 74);
+		panelBigFont->showNumber(audioBudget? (audioAverage * 100) / audioBudget: 0, canvasW - 36, 74);
+		panelBigFont->showNumber(audioBudget? (audioPeak * 100) / audioBudget: 0, canvasW - 12, 74);
+		panelBigFont->showString("buf", canvasW - 76, 86);
+		panelBigFont->showNumber(audioBudget, canvasW - 12, 86);
+
 #ifdef SCALE
 		if (video.getScaleFactor() > 1) {
 
-			panelBigFont->showNumber(canvasW, canvasW - 52, 38);
-			panelBigFont->showString("x", canvasW - 48, 39);
-			panelBigFont->showNumber(canvasH, canvasW - 12, 38);
+			panelBigFont->showNumber(canvasW, canvasW - 52, poolY - 12);
+			panelBigFont->showString("x", canvasW - 48, poolY - 11);
+			panelBigFont->showNumber(canvasH, canvasW - 12, poolY - 12);
+
+		}
+#endif
+
+		// Most slots used, then objects which did not fit
+		for (pool = Pool::getPools(); pool; pool = pool->getNext()) {
+
+			if (!pool->getCapacity()) continue;
+
+			panelBigFont->showString(pool->getName(), canvasW - 76, poolY);
+			panelBigFont->showNumber(pool->getHighWater(), canvasW - 36, poolY);
+			panelBigFont->showNumber(pool->getOverflows(), canvasW - 12, poolY);
+
+			poolY += 12;
+
+		}
+
+#ifdef TRACK_MEMORY
+		// Kilobytes allocated for each part of the game, then the most at once
+		drawRect(canvasW - 164, poolY + 2, 160, 3 + (MEMORY_TAGS * 12), bg);
+
+		for (count = 0; count < MEMORY_TAGS; count++) {
+
+			y = poolY + 5 + (count * 12);
+
+			panelBigFont->showString(getMemoryName((MemoryTag)count), canvasW - 156, y);
+			panelBigFont->showNumber(getMemoryCurrent((MemoryTag)count), canvasW - 60, y);
+			panelBigFont->showNumber(getMemoryPeak((MemoryTag)count), canvasW - 12, y);
+
+		}
+#endif
+
+#ifdef PROFILE
+		// Time spent in each zone per frame, then the length of frame 99% of
+		// frames are within, in microseconds, then a graph of recent frames,
+		// full height at two frames of 60 per second
+		drawRect(4, 11, 80, 139, bg);
+
+		for (count = 0; count < PROFILE_ZONES; count++) {
+
+			panelBigFont->showString(profiler.getZoneName((ProfileZone)count), 12, 14 + (count * 12));
+			panelBigFont->showNumber(profiler.getZoneTime((ProfileZone)count), 76, 14 + (count * 12));
+
+		}
+
+		panelBigFont->showString("p99", 12, 110);
+		panelBigFont->showNumber(profiler.getPercentile(99), 76, 110);
+
+		for (count = 0; count < 72; count++) {
+
+			y = (profiler.getFrameTime(71 - count) * 24) / 33333;
+
+			if (y > 24) y = 24;
+
+			if (y) drawRect(8 + count, 146 - y, 1, y, textPalIndex + (textPalSpan >> 1));
 
 		}
 #endif
@@ -267,16 +952,46 @@ void Level::drawOverlay (unsigned char bg, bool menu, int option,
 			if (panelBigFont->getStringWidth(players[count].getName()) > width)
 				width = panelBigFont->getStringWidth(players[count].getName());
 
-		drawRect((canvasW >> 1) - 48, 11, width + 57, (nPlayers * 12) + 1, bg);
+		// In multiplayer games, each connection's traffic is shown beside its
+		// players, under a row of headings
+		netWidth = multiplayer? SP_COLUMN * 4: 0;
+		top = multiplayer? 26: 14;
+		left = (canvasW >> 1) - 48 - (netWidth >> 1);
+
+		drawRect(left, 11, width + 57 + netWidth, (nPlayers * 12) + top - 13, bg);
+
+		if (multiplayer) {
+
+			for (column = 0; column < 4; column++)
+				panelBigFont->showString(trafficLabels[column],
+					left + width + 49 + ((column + 1) * SP_COLUMN) -
+					panelBigFont->getStringWidth(trafficLabels[column]), 14);
+
+		}
 
 		for (count = 0; count < nPlayers; count++) {
 
-			panelBigFont->showNumber(count + 1,
-				(canvasW >> 1) - 24, 14 + (count * 12));
-			panelBigFont->showString(players[count].getName(),
-				(canvasW >> 1) - 16, 14 + (count * 12));
+			y = top + (count * 12);
+
+			panelBigFont->showNumber(count + 1, left + 24, y);
+			panelBigFont->showString(players[count].getName(), left + 32, y);
 			panelBigFont->showNumber(players[count].teamScore,
-				(canvasW >> 1) + width + 1, 14 + (count * 12));
+				left + width + 49, y);
+
+			if (!multiplayer) continue;
+
+			traffic = new(frameAllocate(sizeof(NetStats))) NetStats();
+
+			if (game->getStats(players + count, traffic)) {
+
+				column = left + width + 49 + SP_COLUMN;
+
+				if (traffic->rtt >= 0) panelBigFont->showNumber(traffic->rtt, column, y);
+				panelBigFont->showNumber(traffic->bytesIn >> 10, column + SP_COLUMN, y);
+				panelBigFont->showNumber(traffic->bytesOut >> 10, column + (SP_COLUMN * 2), y);
+				panelBigFont->showNumber(traffic->queued, column + (SP_COLUMN * 3), y);
+
+			}
 
 		}
 
@@ -340,10 +1055,14 @@ int Level::select (bool& menu, int option) {
 
 		case 2: // Save
 
+			if (saveState()) menu = false;
+
 			break;
 
 		case 3: // Load
 
+			if (loadState()) menu = false;
+
 			break;
 
 		case 4: // Setup
@@ -387,10 +1106,18 @@ int Level::loop (bool& menu, int& option, bool& message) {
 
 	int ret, x, y;
 
+	PROFILE_BEGIN(PZ_LOOP);
+
+	// The menus' images and the raw sound clips are not needed while a level
+	// runs, and nothing is done once they have been released
+	residency.release();
+
 	// Networking
 	if (multiplayer) {
 
+		PROFILE_BEGIN(PZ_NETWORK);
 		ret = game->step(ticks);
+		PROFILE_END(PZ_NETWORK);
 
 		if (ret < 0) return ret;
 
@@ -400,6 +1127,12 @@ int Level::loop (bool& menu, int& option, bool& message) {
 	// Main loop
 	if (::loop(NORMAL_LOOP, paletteEffects) == E_QUIT) return E_QUIT;
 
+#ifdef SDL2
+	// Resize the canvas between frames. Where events appear depends on the
+	// view, so it stays as it is when that needs to match elsewhere.
+	if (!multiplayer && !replay.isActive()) video.adaptResolution(pacer.getLoad());
+#endif
+
 
 	if (controls.release(C_ESCAPE)) {
 
@@ -467,6 +1200,9 @@ int Level::loop (bool& menu, int& option, bool& message) {
 
 	timeCalcs();
 
+	// Leaving the level or opening the setup menu are not timed
+	PROFILE_END(PZ_LOOP);
+
 	return E_NONE;
 
 }
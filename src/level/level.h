@@ -24,6 +24,10 @@
 #define _BASELEVEL_H
 
 
+#include "arena.h"
+#include "rewind.h"
+#include "viewport.h"
+#include "io/assetcache.h"
 #include "menu/menu.h"
 
 
@@ -45,6 +49,38 @@
 // Time interval
 #define T_STEP 16
 
+// Most steps one frame may take to catch up after a hitch
+#ifndef MAX_CATCH_UP
+	#define MAX_CATCH_UP 4
+#endif
+
+// Most gameplay time which may be waiting to be stepped through. Any more,
+// such as after loading, is dropped.
+#define T_MAX_LAG 250
+
+// Time a dedicated server waits after a level ends before moving on
+#define T_SERVER_END 3000
+
+// Width of each column of connection traffic in the player list
+#define SP_COLUMN 32
+
+// Blocks lit in turn on the loading screen while assets are decoded
+#define LOAD_BLOCKS 5
+
+// Most players in a game which rolls back for late inputs
+#define ROLLBACK_PLAYERS 4
+
+// Messages from elsewhere remembered for re-simulation, and the longest
+#define REWIND_LOG     64
+#define REWIND_MESSAGE 256
+
+// The file holding the level state saved by the player, and its layout
+#define STATE_FILE        "openjazz.sav"
+#define STATE_TEMP_SUFFIX ".tmp" /* Added to the name of the file written before it replaces the old one */
+#define STATE_MAGIC       "OJSV"
+#define STATE_VERSION     1
+#define STATE_LENGTH      5 /* Offset of the file's length, after the magic and version */
+
 
 // Enums
 
@@ -75,12 +111,26 @@ enum LevelStage {
 };
 
 
+// Datatype
+
+/// Message from elsewhere which changed the level's state, to be applied
+/// again when the steps since are re-simulated
+typedef struct {
+
+	unsigned int  step; ///< Step at which the message arrived
+	unsigned char data[REWIND_MESSAGE]; ///< The message
+
+} RewindMessage;
+
+
 // Classes
 
 class Anim;
 class File;
 class Game;
+class NetQueue;
 class PaletteEffect;
+class Player;
 class Sprite;
 
 /// Base class for all level classes
@@ -90,43 +140,109 @@ class Level {
 		const char* menuOptions[6];
 		SetupMenu   setupMenu; ///< Setup menu to run on the player's command
 
-		int select (bool& menu, int option);
+		int select      (bool& menu, int option);
+		int benchSteps  ();
+		int benchFrames ();
 
 	protected:
 		Game*          game;
+		Arena          arena; ///< Memory for the level's grids, all freed with the level
 		PaletteEffect* paletteEffects; ///< Palette effects in use while playing the level
 		SDL_Color      palette[256]; ///< Palette in use while playing the level
 		int            sprites; ///< The number of sprite that have been loaded
 		unsigned int   tickOffset; ///< Level time offset from system time
 		unsigned int   steps; ///< Number of steps taken
+		unsigned int   frameSteps; ///< Number of steps taken during the current frame
 		unsigned int   prevTicks; ///< Time the last visual update started
 		unsigned int   ticks; ///< Current time
+		int            prevFraction; ///< Microseconds beyond prevTicks
+		int            tickFraction; ///< Microseconds beyond ticks, for drawing between steps
 		unsigned int   endTime; ///< Tick at which the level will end
 		float          smoothfps; ///< Smoothed FPS counter
 		int            items; ///< Number of items to be collected
 		bool           multiplayer; ///< Whether or not this is a multiplayer game
 		bool           paused; ///< Whether or not the level is paused
+		bool           ownsMusic; ///< Whether or not the music playing is the level's, to be stopped along with it
 		LevelStage     stage; ///< Level stage
 		int            stats; ///< Which statistics to display on-screen, see #LevelStats
+		Rewind         rewind; ///< The level's state at each of the last few steps
+		RewindMessage* rewindLog; ///< Messages which changed the state in those steps
+		int            logNext; ///< Next entry of the log to be used
+		unsigned int   logLost; ///< Latest step of any log entry overwritten
+		unsigned char  inputs[REWIND_STEPS][ROLLBACK_PLAYERS]; ///< Each player's controls at each of the last few steps
+		int            inputOffsets[ROLLBACK_PLAYERS]; ///< Difference between the level's steps and each player's
+		bool           offsetKnown[ROLLBACK_PLAYERS]; ///< Whether or not each player's offset is known
+		int            sentInput; ///< The local player's controls as last sent, or -1
+		unsigned int   rollbackStep; ///< Earliest step whose inputs have changed
+		int            rewindPlayers; ///< Number of players in the state
+		bool           rollbackDue; ///< Whether or not any inputs have changed
+		bool           rollback; ///< Whether or not late inputs are applied by rolling back
+		bool           resimulating; ///< Whether or not steps are being taken again
+		Rewind*        saved; ///< The level's state when last kept in memory
+		int            savedPlayers; ///< Number of players in the kept state
+		Viewport       viewports[MAX_VIEWPORTS]; ///< Parts of the canvas showing each view
+		Player*        viewers[MAX_VIEWPORTS]; ///< The players whose views are shown side by side
+		int            nViewers; ///< Number of players whose views are shown, or 0 for only the local player's
+		Player*        viewer; ///< The player whose view is being drawn, or NULL for the local player
 
 		void createLevelPlayers (LevelType levelType, Anim** anims, Anim** flippedAnims, bool checkpoint, unsigned char x, unsigned char y);
 
+		virtual int  step     () = 0;
+		virtual void calcView (fixed alpha);
+		virtual void draw     () = 0;
+		virtual int  advance  ();
+
 		int  playScene     (const char* file);
-		void timeCalcs     ();
-		int  getTimeChange ();
+		int  preloadAssets (AssetPreloader preloader, const char* fileName);
+		void         timeCalcs     ();
+		unsigned int getStepTicks  (unsigned int step);
+		Uint64       getStepClock  (unsigned int step);
+		unsigned int getStateHash  ();
+		int          checkState    ();
+		void         controlSecond ();
+		int          getTimeChange ();
+		bool         takeStep      ();
+		fixed        getAlpha      ();
+		int          getViews      ();
+		void         beginView     (int index);
+		void         endView       (int index);
+		Player*      getViewer     ();
 		void drawOverlay   (unsigned char bg, bool menu, int option,
 			unsigned char textPalIndex, unsigned char selectedTextPalIndex,
 			int textPalSpan);
 		int  loop          (bool& menu, int& option, bool& message);
 
+		virtual bool prepareRewind  (Rewind* target);
+		virtual bool canCapture     ();
+		virtual void stateRestored  ();
+		virtual bool writeState     (File* file);
+		virtual bool readState      (File* file);
+		void         startRollback  ();
+		void         recordStep     ();
+		int          rollBack       ();
+		void         replayMessages (unsigned int step);
+		int          getInputDelay  (Player* player);
+		bool         keepState      ();
+		bool         returnToState  ();
+		bool         saveState      ();
+		bool         loadState      ();
+
 	public:
 		Level          (Game* owner);
 		virtual ~Level ();
 
-		void         addTimer (int seconds);
-		LevelStage   getStage ();
-		void         setStage (LevelStage stage);
-		virtual void receive  (unsigned char* buffer) = 0;
+		int          benchmark    ();
+		int          serve        ();
+		void         addTimer     (int seconds);
+		void         setViewers   (Player** newViewers, int count);
+		LevelStage   getStage     ();
+		void         setStage     (LevelStage stage);
+		virtual void receive      (unsigned char* buffer) = 0;
+		virtual void sendChanges  (NetQueue* queue);
+		void         logMessage   (unsigned char* buffer);
+		void         receiveInput (unsigned char* buffer);
+		bool         isResimulating ();
+		bool         getShotStep  (Player* shooter, unsigned int& step);
 
 };
 
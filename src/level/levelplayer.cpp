@@ -18,12 +18,30 @@
  * Deals with the creation and destruction of players in levels, and their
  * interactions with other level objects.
  *
+ * Each player's positions at the last few steps are kept, so that a server can
+ * judge a remote player's shots against where the other players were when the
+ * shooter saw them.
+ *
  */
 
 
 #include "levelplayer.h"
 
 
+/**
+ * Create a level player with no past positions.
+ */
+LevelPlayer::LevelPlayer () {
+
+	int count;
+
+	for (count = 0; count < LAG_STEPS; count++) pastSteps[count] = 0;
+
+	return;
+
+}
+
+
 /**
  * Delete the level player.
  */
@@ -31,3 +49,40 @@ LevelPlayer::~LevelPlayer () {
 
 }
 
+
+/**
+ * Remember the player's position at the end of a step.
+ *
+ * @param step The step
+ */
+void LevelPlayer::recordPosition (unsigned int step) {
+
+	pastX[step % LAG_STEPS] = x;
+	pastY[step % LAG_STEPS] = y;
+	pastSteps[step % LAG_STEPS] = step + 1;
+
+	return;
+
+}
+
+
+/**
+ * Find the player's position at the end of a recent step.
+ *
+ * @param step The step
+ * @param stepX Set to the x-coordinate at the step
+ * @param stepY Set to the y-coordinate at the step
+ *
+ * @return Whether or not the position at the step is still known
+ */
+bool LevelPlayer::getPastPosition (unsigned int step, fixed& stepX, fixed& stepY) {
+
+	if (pastSteps[step % LAG_STEPS] != step + 1) return false;
+
+	stepX = pastX[step % LAG_STEPS];
+	stepY = pastY[step % LAG_STEPS];
+
+	return true;
+
+}
+
@@ -32,6 +32,12 @@
 #include "level/movable.h"
 
 
+// Constant
+
+// Steps of each player's positions kept for judging hits from remote players
+#define LAG_STEPS 16
+
+
 // Classes
 
 class Player;
@@ -39,14 +45,23 @@ class Player;
 /// Level player
 class LevelPlayer : public Movable {
 
+	private:
+		fixed        pastX[LAG_STEPS]; ///< X-coordinate at each of the last few steps
+		fixed        pastY[LAG_STEPS]; ///< Y-coordinate at each of the last few steps
+		unsigned int pastSteps[LAG_STEPS]; ///< The step each position was recorded at, plus one, or 0 if none
+
 	protected:
 		SDL_Color palette[256]; ///< Palette (for custom colours)
 
 	public:
 		Player* player; ///< Corresponding game player
 
+		LevelPlayer          ();
 		virtual ~LevelPlayer ();
 
+		void recordPosition  (unsigned int step);
+		bool getPastPosition (unsigned int step, fixed& stepX, fixed& stepY);
+
 		virtual void reset   (int startX, int startY) = 0;
 
 		virtual int  countBirds () = 0;
@@ -0,0 +1,531 @@
+
+/**
+ *
+ * @file levelrollback.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created levelrollback.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Rolls small battles and races back when other players' controls arrive
+ * late. Each player's controls are sent with the step at which they took
+ * effect. Until they arrive, other players are assumed to keep their last
+ * known controls. When controls arrive for a step already taken, the level is
+ * put back to its state at that step, and the steps since are taken again
+ * within the same frame.
+ * The same states let demos be played again from the start.
+ *
+ */
+
+
+#include "level.h"
+
+#include "game/game.h"
+#include "io/gfx/paletteeffects.h"
+#include "io/network.h"
+#include "io/sound.h"
+#include "level/levelplayer.h"
+#include "player/player.h"
+#include "clock.h"
+#include "loop.h"
+
+#include <string.h>
+
+
+/**
+ * Gather the controls of a player into one byte.
+ *
+ * @param player The player
+ *
+ * @return The controls, a bit for each
+ */
+static unsigned char getInput (Player* player) {
+
+	unsigned char held;
+	int count;
+
+	held = 0;
+
+	for (count = 0; count < PCONTROLS; count++) {
+
+		if (player->getControl(count)) held |= 1 << count;
+
+	}
+
+	return held;
+
+}
+
+
+/**
+ * Set the controls of a player from one byte.
+ *
+ * @param player The player
+ * @param held The controls, a bit for each
+ */
+static void setInput (Player* player, unsigned char held) {
+
+	int count;
+
+	for (count = 0; count < PCONTROLS; count++)
+		player->setControl(count, held & (1 << count));
+
+	return;
+
+}
+
+
+/**
+ * Add the level's state to a rewind. Levels which can be rolled back override
+ * this.
+ *
+ * @param target The rewind
+ *
+ * @return Whether or not the level can be rolled back
+ */
+bool Level::prepareRewind (Rewind* target) {
+
+	(void)target;
+
+	return false;
+
+}
+
+
+/**
+ * Determine whether or not the whole of the level's state is currently held
+ * in the memory added to the rewind. Levels which can be rolled back override
+ * this.
+ *
+ * @return Whether or not the state can be captured
+ */
+bool Level::canCapture () {
+
+	return false;
+
+}
+
+
+/**
+ * Bring anything derived from the level's state up to date after it has been
+ * put back to an earlier state. Levels which can be rolled back override this.
+ */
+void Level::stateRestored () {
+
+	return;
+
+}
+
+
+/**
+ * Decide whether or not to roll back for late inputs, just before the level
+ * starts.
+ */
+void Level::startRollback () {
+
+	int count;
+
+	rollback = game && (nPlayers <= ROLLBACK_PLAYERS) && game->canRollBack() &&
+		prepareRewind(&rewind);
+
+	if (!rollback) return;
+
+	rewindPlayers = nPlayers;
+
+	if (!rewindLog) rewindLog = new RewindMessage[REWIND_LOG];
+
+	for (count = 0; count < REWIND_LOG; count++) {
+
+		rewindLog[count].step = 0;
+		rewindLog[count].data[0] = 0;
+
+	}
+
+	logNext = 0;
+	logLost = 0;
+
+	memset(inputs, 0, sizeof(inputs));
+	memset(offsetKnown, 0, sizeof(offsetKnown));
+
+	sentInput = -1;
+	rollbackDue = false;
+	resimulating = false;
+
+	return;
+
+}
+
+
+/**
+ * Capture the state before a step is taken, note the controls each player is
+ * taking it with, and tell the other players of any change to the local
+ * player's controls.
+ */
+void Level::recordStep () {
+
+	unsigned char buffer[MTL_P_INPUT];
+	unsigned char held;
+	int count;
+
+	if (!rollback) return;
+
+	// Players have come or gone, so the state is no longer the same shape
+	if ((nPlayers != rewindPlayers) &&
+		((nPlayers > ROLLBACK_PLAYERS) || !prepareRewind(&rewind))) {
+
+		rollback = false;
+
+		return;
+
+	}
+
+	rewindPlayers = nPlayers;
+
+	if (canCapture()) rewind.capture(steps);
+	else rewind.forget(steps);
+
+	for (count = 0; count < nPlayers; count++)
+		inputs[steps & (REWIND_STEPS - 1)][count] = getInput(players + count);
+
+	held = getInput(localPlayer);
+
+	if (held != sentInput) {
+
+		buffer[0] = MTL_P_INPUT;
+		buffer[1] = MT_P_INPUT;
+		buffer[2] = 0;
+		buffer[3] = steps >> 24;
+		buffer[4] = (steps >> 16) & 255;
+		buffer[5] = (steps >> 8) & 255;
+		buffer[6] = steps & 255;
+		buffer[7] = held;
+		game->send(buffer);
+
+		sentInput = held;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * If any step already taken has had its inputs changed, put the level back to
+ * its state at that step and take the steps since again.
+ *
+ * @return Error code
+ */
+int Level::rollBack () {
+
+	int teamScores[ROLLBACK_PLAYERS];
+	unsigned int target, frameTicks;
+	int count, ret;
+
+	if (!rollback || !rollbackDue) return E_NONE;
+
+	rollbackDue = false;
+
+	// Objects outside the captured memory, or messages which have been
+	// forgotten, would be lost
+	if (((int)(rollbackStep - logLost) < 0) || (nPlayers != rewindPlayers) ||
+		!canCapture())
+		return E_NONE;
+
+	// Team scores only ever come from the server, so are kept as they are
+	for (count = 0; count < nPlayers; count++) teamScores[count] = players[count].teamScore;
+
+	if (!rewind.restore(rollbackStep)) return E_NONE;
+
+	for (count = 0; count < nPlayers; count++) players[count].teamScore = teamScores[count];
+
+	stateRestored();
+
+	target = steps;
+	frameTicks = ticks;
+	steps = rollbackStep;
+	ret = E_NONE;
+
+	// Steps taken again are not heard again, and tell no-one anything
+	resimulating = true;
+	holdSounds(true);
+
+	while (steps != target) {
+
+		for (count = 0; count < nPlayers; count++)
+			setInput(players + count, inputs[steps & (REWIND_STEPS - 1)][count]);
+
+		if (canCapture()) rewind.capture(steps);
+		else rewind.forget(steps);
+
+		ticks = getStepTicks(steps + 1);
+
+		ret = step();
+		steps++;
+
+		replayMessages(steps);
+
+		if (ret) break;
+
+	}
+
+	holdSounds(false);
+	resimulating = false;
+
+	ticks = frameTicks;
+
+	return ret;
+
+}
+
+
+/**
+ * Apply again the messages which arrived at the given step.
+ *
+ * @param step The step
+ */
+void Level::replayMessages (unsigned int step) {
+
+	RewindMessage* message;
+	int count;
+
+	// Oldest first
+	for (count = 0; count < REWIND_LOG; count++) {
+
+		message = rewindLog + ((logNext + count) % REWIND_LOG);
+
+		if ((message->step != step) || !message->data[0]) continue;
+
+		switch (message->data[1] & MCMASK) {
+
+			case MC_LEVEL:
+
+				receive(message->data);
+
+				break;
+
+			case MC_PLAYER:
+
+				if (message->data[2] < nPlayers) players[message->data[2]].receive(message->data);
+
+				break;
+
+		}
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Estimate how many steps another player's controls take to arrive.
+ *
+ * @param player The player
+ *
+ * @return Number of steps
+ */
+int Level::getInputDelay (Player* player) {
+
+	NetStats stats;
+
+	// A server knows each client's round trip, so its controls took half of
+	// that. A client only knows its own round trip to the server, which
+	// stands in for the other client's half as well.
+	if (game->getStats(player, &stats)) {
+
+		if (stats.rtt > 0) return (stats.rtt * 3) / 100;
+
+	} else if (game->getStats(localPlayer, &stats)) {
+
+		if (stats.rtt > 0) return (stats.rtt * 3) / 50;
+
+	}
+
+	return 0;
+
+}
+
+
+/**
+ * Find the step at which a remote player saw the other players, so that the
+ * player's shots can be judged against where they were then. A client sees the
+ * others as they were half a round trip ago, after waiting for their next
+ * update, and its shots reach the server half a round trip later.
+ *
+ * @param shooter The shooting player
+ * @param step Set to the step
+ *
+ * @return Whether or not the shots need judging at an earlier step
+ */
+bool Level::getShotStep (Player* shooter, unsigned int& step) {
+
+	NetStats stats;
+	unsigned int lag;
+
+	// Rolling back already takes each late shot at the step it was fired
+	if (!game || rollback || !game->getStats(shooter, &stats) || (stats.rtt <= 0)) return false;
+
+	lag = (stats.rtt + (stats.interval >> 1)) / T_STEP;
+
+	// Positions are only kept for so long
+	if (lag >= LAG_STEPS) lag = LAG_STEPS - 1;
+
+	if (!lag || (steps <= lag)) return false;
+
+	// Each position is recorded at the end of its step
+	step = steps - 1 - lag;
+
+	return true;
+
+}
+
+
+/**
+ * Remember a message which changed the level's state, so that it can be
+ * applied again if the level is rolled back to before it arrived.
+ *
+ * @param buffer The message
+ */
+void Level::logMessage (unsigned char* buffer) {
+
+	RewindMessage* message;
+
+	if (!rollback || resimulating) return;
+
+	message = rewindLog + logNext;
+
+	if (message->data[0] && ((int)(message->step - logLost) > 0)) logLost = message->step;
+
+	message->step = steps;
+	memcpy(message->data, buffer, buffer[0]);
+	if (!buffer[0]) message->data[0] = 0;
+
+	logNext = (logNext + 1) % REWIND_LOG;
+
+	return;
+
+}
+
+
+/**
+ * Apply another player's controls at the step they took effect, rolling the
+ * level back if that step has already been taken.
+ *
+ * @param buffer The MT_P_INPUT message
+ */
+void Level::receiveInput (unsigned char* buffer) {
+
+	unsigned int senderStep, step;
+	int player, offset;
+
+	player = buffer[2];
+
+	if (!rollback || resimulating || (player >= nPlayers) || (players + player == localPlayer))
+		return;
+
+	senderStep = (buffer[3] << 24) + (buffer[4] << 16) + (buffer[5] << 8) + buffer[6];
+
+	// The players started at different times, so their steps are matched
+	// up from the quickest any of their controls have arrived
+	offset = (int)(steps - senderStep) - getInputDelay(players + player);
+
+	if (!offsetKnown[player] || (offset < inputOffsets[player])) {
+
+		inputOffsets[player] = offset;
+		offsetKnown[player] = true;
+
+	}
+
+	step = senderStep + inputOffsets[player];
+
+	setInput(players + player, buffer[7]);
+
+	if ((int)(step - steps) >= 0) return;
+
+	// Correct as much as is remembered
+	if (steps - step >= REWIND_STEPS) step = steps + 1 - REWIND_STEPS;
+
+	if (!rollbackDue || ((int)(step - rollbackStep) < 0)) rollbackStep = step;
+	rollbackDue = true;
+
+	for (; step != steps; step++)
+		inputs[step & (REWIND_STEPS - 1)][player] = buffer[7];
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not steps are being taken again.
+ *
+ * @return True if re-simulating
+ */
+bool Level::isResimulating () {
+
+	return resimulating;
+
+}
+
+
+/**
+ * Keep the level's whole state in memory, so that it can be gone back to
+ * without loading the level again, as demos are. Only one state is kept, and
+ * only in single-player games, as other players would not go back with it.
+ *
+ * @return Whether or not the state was kept
+ */
+bool Level::keepState () {
+
+	if (multiplayer) return false;
+
+	if (!saved) saved = new Rewind(1);
+
+	// The shape of the state is taken afresh, as objects outside the level's
+	// memory may have come or gone
+	if (!prepareRewind(saved) || !canCapture()) return false;
+
+	saved->add(&steps, sizeof(steps));
+	saved->add(&endTime, sizeof(endTime));
+	saved->add(&stage, sizeof(stage));
+	if (paletteEffects) paletteEffects->addTo(saved);
+
+	savedPlayers = nPlayers;
+
+	return saved->capture(0);
+
+}
+
+
+/**
+ * Put the level back to its state when last kept.
+ *
+ * @return Whether or not the state was put back
+ */
+bool Level::returnToState () {
+
+	// Anything outside the level's memory now would be lost
+	if (!saved || (nPlayers != savedPlayers) || !canCapture()) return false;
+
+	if (!saved->restore(0)) return false;
+
+	// Carry on from the kept time
+	ticks = prevTicks = getStepTicks(steps);
+	tickOffset = globalTicks - ticks;
+	tickFraction = prevFraction = globalClock % (CLOCK_RATE / 1000);
+
+	stateRestored();
+
+	return true;
+
+}
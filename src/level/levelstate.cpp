@@ -0,0 +1,210 @@
+/**
+ *
+ * @file levelstate.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created levelstate.cpp from parts of levelrollback.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Saves the whole of a level as it is being played to a file, and loads it
+ * back, even after the game has been started again. Objects are written as
+ * their values, with the objects they refer to written as indices, so the
+ * file does not depend on where anything was in memory.
+ *
+ */
+
+
+#include "level.h"
+
+#include "game/game.h"
+#include "io/file.h"
+#include "player/player.h"
+#include "clock.h"
+#include "loop.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/**
+ * Write the parts of the state particular to the type of level. Levels which
+ * can be saved override this.
+ *
+ * @param file The file
+ *
+ * @return Whether or not the state was written
+ */
+bool Level::writeState (File* file) {
+
+	(void)file;
+
+	return false;
+
+}
+
+
+/**
+ * Read the parts of the state particular to the type of level, if they are of
+ * this level. Levels which can be saved override this.
+ *
+ * @param file The file
+ *
+ * @return Whether or not the state was read
+ */
+bool Level::readState (File* file) {
+
+	(void)file;
+
+	return false;
+
+}
+
+
+/**
+ * Save the level's whole state, so that the player can come back to it, even
+ * after the game has been started again. Only one state is kept, and only in
+ * single-player games, as other players would not go back with it.
+ *
+ * @return Whether or not the state was saved
+ */
+bool Level::saveState () {
+
+	File* file;
+	char* tempPath;
+	char* filePath;
+	int checkX, checkY, length;
+	bool written;
+
+	if (multiplayer) return false;
+
+	try {
+
+		file = new File(STATE_FILE STATE_TEMP_SUFFIX, true);
+
+	} catch (int e) {
+
+		return false;
+
+	}
+
+	file->storeBlock((const unsigned char *)STATE_MAGIC, 4);
+	file->storeChar(STATE_VERSION);
+	file->storeInt(0);
+	file->storeChar(game->getDifficulty());
+	file->storeChar(nPlayers);
+	file->storeInt(steps);
+	file->storeInt(endTime);
+	file->storeChar(stage);
+	game->getCheckpoint(checkX, checkY);
+	file->storeShort(checkX);
+	file->storeShort(checkY);
+
+	written = writeState(file);
+
+	// The length lets a file which was cut short be turned away before any of
+	// it is used
+	length = file->tell();
+	file->seek(STATE_LENGTH, true);
+	file->storeInt(length);
+
+	tempPath = createString(file->getPath());
+
+	delete file;
+
+	filePath = createString(tempPath);
+	filePath[strlen(filePath) - strlen(STATE_TEMP_SUFFIX)] = 0;
+
+	// The last state saved is only replaced by a whole one
+	if (!written) {
+
+		remove(tempPath);
+
+	} else if (rename(tempPath, filePath)) {
+
+		remove(filePath);
+
+		written = !rename(tempPath, filePath);
+
+	}
+
+	delete[] filePath;
+	delete[] tempPath;
+
+	return written;
+
+}
+
+
+/**
+ * Put the level back to its state when last saved, if that was this level.
+ *
+ * @return Whether or not the state was put back
+ */
+bool Level::loadState () {
+
+	File* file;
+	unsigned char* magic;
+	unsigned int savedSteps, savedEndTime;
+	int difficulty, checkX, checkY;
+	LevelStage savedStage;
+	bool valid;
+
+	if (multiplayer) return false;
+
+	try {
+
+		file = new File(STATE_FILE, false);
+
+	} catch (int e) {
+
+		return false;
+
+	}
+
+	magic = file->loadBlock(4);
+	valid = !memcmp(magic, STATE_MAGIC, 4) &&
+		(file->loadChar() == STATE_VERSION) &&
+		(file->loadInt() == file->getSize());
+	delete[] magic;
+
+	difficulty = file->loadChar();
+	valid = valid && (file->loadChar() == nPlayers);
+
+	savedSteps = file->loadInt();
+	savedEndTime = file->loadInt();
+	savedStage = LevelStage(file->loadChar());
+	checkX = short(file->loadShort());
+	checkY = short(file->loadShort());
+
+	// The rest is only used if it is of this level
+	valid = valid && readState(file);
+
+	delete file;
+
+	if (!valid) return false;
+
+	steps = savedSteps;
+	endTime = savedEndTime;
+	stage = savedStage;
+	game->setDifficulty(difficulty);
+	game->setCheckpoint(checkX, checkY);
+
+	// Carry on from the saved step
+	ticks = prevTicks = getStepTicks(steps);
+	tickOffset = globalTicks - ticks;
+	tickFraction = prevFraction = globalClock % (CLOCK_RATE / 1000);
+
+	stateRestored();
+
+	return true;
+
+}
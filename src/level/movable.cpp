@@ -23,18 +23,168 @@
 #include "level.h"
 #include "movable.h"
 
+#include "io/gfx/video.h"
+#include "io/file.h"
+
+
+/**
+ * Create a Movable, which is drawn where it is until it has taken a step.
+ */
+Movable::Movable () {
+
+	stepped = false;
+	errorX = 0;
+	errorY = 0;
+
+	return;
+
+}
+
+
+/**
+ * Remember where the Movable is before it takes a step, so it can be drawn
+ * between the two positions.
+ */
+void Movable::savePosition () {
+
+	prevX = x;
+	prevY = y;
+	stepped = true;
+
+	// Show a little more of any correction with each step
+	errorX = (errorX * 3) / 4;
+	errorY = (errorY * 3) / 4;
+
+	return;
+
+}
+
+
+/**
+ * Move the Movable to a position received from elsewhere, e.g. over the
+ * network. Small corrections are shown gradually over the next few steps,
+ * rather than all at once.
+ *
+ * @param newX The new x-coordinate
+ * @param newY The new y-coordinate
+ */
+void Movable::correctPosition (fixed newX, fixed newY) {
+
+	if ((newX - x > MAX_CORRECTION) || (x - newX > MAX_CORRECTION) ||
+		(newY - y > MAX_CORRECTION) || (y - newY > MAX_CORRECTION)) {
+
+		errorX = 0;
+		errorY = 0;
+
+	} else {
+
+		errorX += x - newX;
+		errorY += y - newY;
+
+	}
+
+	// Keep drawing the latest step's movement
+	if (stepped) {
+
+		prevX += newX - x;
+		prevY += newY - y;
+
+	}
+
+	x = newX;
+	y = newY;
+
+	return;
+
+}
+
+
+/**
+ * Write the Movable's position and speed to a file.
+ *
+ * @param file The file
+ */
+void Movable::storePosition (File* file) {
+
+	file->storeInt(x);
+	file->storeInt(y);
+	file->storeInt(dx);
+	file->storeInt(dy);
+
+	return;
+
+}
+
+
+/**
+ * Read the Movable's position and speed from a file, as written by
+ * storePosition(). The Movable is drawn where it is until it takes a step.
+ *
+ * @param file The file
+ */
+void Movable::loadPosition (File* file) {
+
+	x = file->loadInt();
+	y = file->loadInt();
+	dx = file->loadInt();
+	dy = file->loadInt();
+
+	errorX = 0;
+	errorY = 0;
+	savePosition();
+
+	return;
+
+}
+
+
+/**
+ * Interpolate the x-coordinate of the Movable between its positions before and
+ * after the latest step.
+ *
+ * @param alpha How far drawing is between the last step and the next, out of F1
+ *
+ * @return The x-coordinate
+ */
+fixed Movable::getInterpolatedX (fixed alpha) {
+
+	if (!stepped || (x - prevX > MAX_INTERPOLATION) || (prevX - x > MAX_INTERPOLATION))
+		return x;
+
+	return prevX + MUL(x - prevX, alpha);
+
+}
+
+
+/**
+ * Interpolate the y-coordinate of the Movable between its positions before and
+ * after the latest step.
+ *
+ * @param alpha How far drawing is between the last step and the next, out of F1
+ *
+ * @return The y-coordinate
+ */
+fixed Movable::getInterpolatedY (fixed alpha) {
+
+	if (!stepped || (y - prevY > MAX_INTERPOLATION) || (prevY - y > MAX_INTERPOLATION))
+		return y;
+
+	return prevY + MUL(y - prevY, alpha);
+
+}
+
 
 /**
  * Derive the x-coordinate of the Movable relative to the view coordinates for
  * the current time.
  *
- * @param change Time since last step
+ * @param alpha How far drawing is between the last step and the next, out of F1
  *
  * @return The x-coordinate
  */
-fixed Movable::getDrawX (int change) {
+fixed Movable::getDrawX (fixed alpha) {
 
-	return x + ((dx * change) >> 10) - viewX;
+	return getInterpolatedX(alpha) + errorX - viewX;
 
 }
 
@@ -43,13 +193,34 @@ fixed Movable::getDrawX (int change) {
  * Derive the y-coordinate of the Movable relative to the view coordinates for
  * the current time.
  *
- * @param change Time since last step
+ * @param alpha How far drawing is between the last step and the next, out of F1
  *
  * @return The y-coordinate
  */
-fixed Movable::getDrawY (int change) {
+fixed Movable::getDrawY (fixed alpha) {
+
+	return getInterpolatedY(alpha) + errorY - viewY;
+
+}
+
+
+/**
+ * Determine whether or not an area relative to the view coordinates overlaps
+ * the view, so that drawing it is worthwhile.
+ *
+ * @param drawX The x-coordinate of the area's left edge
+ * @param drawY The y-coordinate of the area's top edge
+ * @param width The area's width
+ * @param height The area's height
+ *
+ * @return Whether or not the area is in view
+ */
+bool Movable::isInView (fixed drawX, fixed drawY, fixed width, fixed height) {
 
-	return y + ((dy * change) >> 10) - viewY;
+	return (drawX + width + DRAW_MARGIN > 0) &&
+		(drawX - DRAW_MARGIN < ITOF(canvasW)) &&
+		(drawY + height + DRAW_MARGIN > 0) &&
+		(drawY - DRAW_MARGIN < ITOF(canvasH));
 
 }
 
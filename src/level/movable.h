@@ -24,18 +24,47 @@
 #include "OpenJazz.h"
 
 
-// Class
+// Constant
+
+// Movement in one step beyond which an object has jumped, so is not
+// interpolated
+#define MAX_INTERPOLATION F32
+
+// Correction to a position received from elsewhere beyond which an object has
+// jumped, so is not smoothed
+#define MAX_CORRECTION F64
+
+// Distance beyond the edges of the view within which an object is still drawn,
+// allowing for animation offsets and accessories
+#define DRAW_MARGIN F32
+
+
+// Classes
+
+class File;
 
 /// Base class for all movable objects (players, events, bullets, birds)
 class Movable {
 
 	protected:
 		fixed x, y, dx, dy;
+		fixed prevX, prevY; ///< Position before the latest step
+		bool  stepped; ///< Whether or not the position before the latest step is known
+		fixed errorX, errorY; ///< Corrections to the position yet to be shown
 
-		fixed getDrawX (int change);
-		fixed getDrawY (int change);
+		void  savePosition     ();
+		void  correctPosition  (fixed newX, fixed newY);
+		void  storePosition    (File* file);
+		void  loadPosition     (File* file);
+		fixed getInterpolatedX (fixed alpha);
+		fixed getInterpolatedY (fixed alpha);
+		fixed getDrawX         (fixed alpha);
+		fixed getDrawY         (fixed alpha);
+		bool  isInView         (fixed drawX, fixed drawY, fixed width, fixed height);
 
 	public:
+		Movable ();
+
 		fixed getX ();
 		fixed getY ();
 
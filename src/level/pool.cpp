@@ -0,0 +1,283 @@
+
+/**
+ *
+ * @file pool.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created pool.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Keeps slots for short-lived objects on a free list, so creating and
+ * deleting them does not go through the heap.
+ *
+ */
+
+
+#include "pool.h"
+#include "rewind.h"
+
+#include <new>
+
+
+Pool* Pool::pools = NULL;
+
+
+/**
+ * Create a pool with no slots. Slots are made when the capacity is set.
+ *
+ * @param poolName Short name shown with the statistics
+ * @param objectSize Size of the objects the pool holds
+ */
+Pool::Pool (const char* poolName, int objectSize) {
+
+	name = poolName;
+	slots = NULL;
+	freeSlots = NULL;
+	slotSize = (objectSize + POOL_ALIGN - 1) & ~(POOL_ALIGN - 1);
+	capacity = 0;
+	used = 0;
+	highWater = 0;
+	overflows = 0;
+	outside = 0;
+
+	next = pools;
+	pools = this;
+
+	return;
+
+}
+
+
+/**
+ * Delete the pool.
+ */
+Pool::~Pool () {
+
+	Pool** link;
+
+	if (slots) delete[] slots;
+
+	link = &pools;
+
+	while (*link) {
+
+		if (*link == this) {
+
+			*link = next;
+
+			break;
+
+		}
+
+		link = &((*link)->next);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Get the first pool.
+ *
+ * @return The first pool
+ */
+Pool* Pool::getPools () {
+
+	return pools;
+
+}
+
+
+/**
+ * Make the given number of slots, and reset the statistics. Slots cannot be
+ * remade while any are taken, so the old slots are kept if so.
+ *
+ * @param newCapacity The number of slots
+ */
+void Pool::setCapacity (int newCapacity) {
+
+	int count;
+
+	highWater = used;
+	overflows = 0;
+
+	if (used || (newCapacity == capacity)) return;
+
+	if (slots) delete[] slots;
+
+	capacity = newCapacity;
+	slots = capacity? new unsigned char[slotSize * capacity]: NULL;
+
+	// Thread the free list through the slots, first slot first
+	freeSlots = NULL;
+
+	for (count = capacity - 1; count >= 0; count--) {
+
+		*((void **)(slots + (slotSize * count))) = freeSlots;
+		freeSlots = slots + (slotSize * count);
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Take a slot for an object. If none are free, or the object is too large,
+ * the memory comes from the heap instead.
+ *
+ * @param size The size of the object
+ *
+ * @return Memory for the object
+ */
+void* Pool::take (size_t size) {
+
+	void* slot;
+
+	if (!freeSlots || (size > (size_t)slotSize)) {
+
+		overflows++;
+		outside++;
+
+		return ::operator new(size);
+
+	}
+
+	slot = freeSlots;
+	freeSlots = *((void **)slot);
+
+	used++;
+	if (used > highWater) highWater = used;
+
+	return slot;
+
+}
+
+
+/**
+ * Give back an object's memory, whether it came from a slot or from the heap.
+ *
+ * @param object The object's memory
+ */
+void Pool::give (void* object) {
+
+	if (!object) return;
+
+	if ((object < (void *)slots) || (object >= (void *)(slots + (slotSize * capacity)))) {
+
+		::operator delete(object);
+		outside--;
+
+		return;
+
+	}
+
+	*((void **)object) = freeSlots;
+	freeSlots = object;
+	used--;
+
+	return;
+
+}
+
+
+/**
+ * Determine whether or not every object currently held came from a slot, so
+ * that the slots hold the whole of the pool's contents.
+ *
+ * @return True if no objects are from the heap
+ */
+bool Pool::isContained () {
+
+	return !outside;
+
+}
+
+
+/**
+ * Add the slots, and the record of which are free, to a level's state.
+ *
+ * @param rewind The level's state
+ */
+void Pool::addTo (Rewind* rewind) {
+
+	rewind->add(&freeSlots, sizeof(freeSlots));
+	rewind->add(&used, sizeof(used));
+	rewind->add(slots, slotSize * capacity);
+
+	return;
+
+}
+
+
+/**
+ * Get the next pool.
+ *
+ * @return The next pool
+ */
+Pool* Pool::getNext () {
+
+	return next;
+
+}
+
+
+/**
+ * Get the pool's name.
+ *
+ * @return The name
+ */
+const char* Pool::getName () {
+
+	return name;
+
+}
+
+
+/**
+ * Get the number of slots.
+ *
+ * @return The number of slots
+ */
+int Pool::getCapacity () {
+
+	return capacity;
+
+}
+
+
+/**
+ * Get the most slots taken at once since the capacity was set.
+ *
+ * @return The number of slots
+ */
+int Pool::getHighWater () {
+
+	return highWater;
+
+}
+
+
+/**
+ * Get the number of objects which came from the heap since the capacity was
+ * set.
+ *
+ * @return The number of objects
+ */
+int Pool::getOverflows () {
+
+	return overflows;
+
+}
+
@@ -0,0 +1,74 @@
+
+/**
+ *
+ * @file pool.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created pool.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _POOL_H
+#define _POOL_H
+
+
+#include <stddef.h>
+
+
+// Constants
+
+#define POOL_ALIGN 16 /* Slots start at multiples of this */
+
+
+// Class
+
+class Rewind;
+
+/// Fixed number of equally-sized slots for objects which come and go often,
+/// such as bullets. When every slot is taken, objects come from the heap.
+class Pool {
+
+	private:
+		static Pool*   pools; ///< Every pool, for statistics
+
+		Pool*          next; ///< The next pool
+		const char*    name; ///< Short name shown with the statistics
+		unsigned char* slots; ///< The slots
+		void*          freeSlots; ///< First free slot, each holding the address of the next
+		int            slotSize; ///< Number of bytes in each slot
+		int            capacity; ///< Number of slots
+		int            used; ///< Number of slots taken
+		int            highWater; ///< Most slots taken at once
+		int            overflows; ///< Number of objects which came from the heap
+		int            outside; ///< Number of objects currently from the heap
+
+	public:
+		Pool  (const char* poolName, int objectSize);
+		~Pool ();
+
+		static Pool* getPools     ();
+
+		void         setCapacity  (int newCapacity);
+		void*        take         (size_t size);
+		void         give         (void* object);
+		bool         isContained  ();
+		void         addTo        (Rewind* rewind);
+		Pool*        getNext      ();
+		const char*  getName      ();
+		int          getCapacity  ();
+		int          getHighWater ();
+		int          getOverflows ();
+
+};
+
+#endif
+
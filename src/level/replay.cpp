@@ -0,0 +1,397 @@
+
+/**
+ *
+ * @file replay.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created replay.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Records the local player's controls, step by step, and plays them back.
+ *
+ * A replay file begins with "OJR", the version, the level's file name, the
+ * difficulty and the canvas size, which decides where JJ1 events appear. Records follow, each starting with its type: runs of steps with
+ * the same controls, and every REPLAY_CHECK steps a hash of the level's state.
+ *
+ */
+
+
+#include "replay.h"
+
+#include "io/controls.h"
+#include "io/file.h"
+#include "io/gfx/video.h"
+#include "player/player.h"
+#include "util.h"
+
+#include <string.h>
+
+
+/**
+ * Create a replay which neither records nor plays back.
+ */
+Replay::Replay () {
+
+	file = NULL;
+	fileName = NULL;
+	levelFile = NULL;
+	difficulty = 0;
+	canvasWidth = 0;
+	canvasHeight = 0;
+	mode = RM_OFF;
+	held = 0;
+	run = 0;
+
+	return;
+
+}
+
+
+/**
+ * Delete the replay, finishing any recording.
+ */
+Replay::~Replay () {
+
+	stop();
+
+	if (fileName) delete[] fileName;
+	if (levelFile) delete[] levelFile;
+
+	return;
+
+}
+
+
+/**
+ * Record the next level played.
+ *
+ * @param replayFile Name of the file to record to
+ */
+void Replay::record (const char* replayFile) {
+
+	if (fileName) delete[] fileName;
+
+	fileName = createString(replayFile);
+	mode = RM_RECORD;
+
+	return;
+
+}
+
+
+/**
+ * Prepare to play back a replay.
+ *
+ * @param replayFile Name of the file to play back
+ *
+ * @return Error code
+ */
+int Replay::play (const char* replayFile) {
+
+	unsigned char* identifier;
+
+	stop();
+
+	try {
+
+		file = new File(replayFile, false);
+
+	} catch (int e) {
+
+		return e;
+
+	}
+
+	identifier = file->loadBlock(4);
+
+	if (memcmp(identifier, "OJR", 3) || (identifier[3] != REPLAY_VERSION)) {
+
+		delete[] identifier;
+		delete file;
+		file = NULL;
+
+		return E_VERSION;
+
+	}
+
+	delete[] identifier;
+
+	if (levelFile) delete[] levelFile;
+
+	levelFile = file->loadString();
+	difficulty = file->loadChar();
+	canvasWidth = file->loadShort();
+	canvasHeight = file->loadShort();
+
+	mode = RM_PLAY;
+	run = 0;
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Get the name of the level being played back.
+ *
+ * @return The level's file name, or NULL if not playing back
+ */
+const char* Replay::getLevel () {
+
+	return (mode == RM_PLAY)? levelFile: NULL;
+
+}
+
+
+/**
+ * Get the difficulty setting the replay was recorded with.
+ *
+ * @return The difficulty setting
+ */
+int Replay::getDifficulty () {
+
+	return difficulty;
+
+}
+
+
+/**
+ * Get the width of the canvas the replay was recorded with.
+ *
+ * @return The width
+ */
+int Replay::getCanvasWidth () {
+
+	return canvasWidth;
+
+}
+
+
+/**
+ * Get the height of the canvas the replay was recorded with.
+ *
+ * @return The height
+ */
+int Replay::getCanvasHeight () {
+
+	return canvasHeight;
+
+}
+
+
+/**
+ * Determine whether or not the level must be played deterministically.
+ *
+ * @return Whether or not recording or playing back
+ */
+bool Replay::isActive () {
+
+	return file && (mode != RM_OFF);
+
+}
+
+
+/**
+ * Start recording or playing back, as the level starts.
+ *
+ * @param level File name of the level
+ * @param levelDifficulty Difficulty setting of the game
+ */
+void Replay::start (const char* level, int levelDifficulty) {
+
+	unsigned char identifier[4] = {'O', 'J', 'R', REPLAY_VERSION};
+
+	if (mode == RM_PLAY) {
+
+		// Only the recorded level can be played back
+		if (strcmp(level, levelFile)) stop();
+
+		return;
+
+	}
+
+	if ((mode != RM_RECORD) || file) return;
+
+	try {
+
+		file = new File(fileName, true);
+
+	} catch (int e) {
+
+		mode = RM_OFF;
+
+		return;
+
+	}
+
+	file->storeBlock(identifier, 4);
+	file->storeChar(strlen(level));
+	file->storeBlock((const unsigned char *)level, strlen(level));
+	file->storeChar(levelDifficulty);
+	file->storeShort(canvasW);
+	file->storeShort(canvasH);
+
+	run = 0;
+
+	return;
+
+}
+
+
+/**
+ * Finish recording or playing back. Further levels are played normally.
+ */
+void Replay::stop () {
+
+	if (file) {
+
+		if (mode == RM_RECORD) {
+
+			storeRun();
+			file->storeChar(RR_END);
+
+		}
+
+		delete file;
+		file = NULL;
+
+	}
+
+	mode = RM_OFF;
+
+	return;
+
+}
+
+
+/**
+ * Store the current run of steps.
+ */
+void Replay::storeRun () {
+
+	if (!run) return;
+
+	file->storeChar(RR_CONTROLS);
+	file->storeChar(run);
+	file->storeChar(held);
+
+	run = 0;
+
+	return;
+
+}
+
+
+/**
+ * Apply controls to the player for the next step, either from the controls,
+ * recording them, or from the replay.
+ *
+ * @param player The local player
+ *
+ * @return Error code (E_RETURN once the replay has been played back)
+ */
+int Replay::control (Player* player) {
+
+	unsigned char state;
+	int count;
+
+	if (mode == RM_PLAY) {
+
+		if (!run) {
+
+			if (file->loadChar() != RR_CONTROLS) {
+
+				stop();
+
+				return E_RETURN;
+
+			}
+
+			run = file->loadChar();
+			held = file->loadChar();
+
+		}
+
+		run--;
+
+		for (count = 0; count < PCONTROLS; count++)
+			player->setControl(count, held & (1 << count));
+
+		return E_NONE;
+
+	}
+
+	state = 0;
+
+	for (count = 0; count < PCONTROLS; count++) {
+
+		player->setControl(count, controls.getState(count));
+
+		if (controls.getState(count)) state |= 1 << count;
+
+	}
+
+	if (!isActive()) return E_NONE;
+
+	if (run && ((state != held) || (run == 255))) storeRun();
+
+	held = state;
+	run++;
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Record the state of the level after a step, or compare it with the
+ * recorded state.
+ *
+ * @param step The number of steps taken
+ * @param hash Hash of the level's state
+ *
+ * @return Error code (E_DATA if the level has played out differently)
+ */
+int Replay::check (unsigned int step, unsigned int hash) {
+
+	if (!isActive() || (step % REPLAY_CHECK)) return E_NONE;
+
+	if (mode == RM_RECORD) {
+
+		storeRun();
+		file->storeChar(RR_CHECK);
+		file->storeInt(hash);
+
+		return E_NONE;
+
+	}
+
+	if (file->loadChar() != RR_CHECK) {
+
+		stop();
+
+		return E_RETURN;
+
+	}
+
+	if ((unsigned int)(file->loadInt()) != hash) {
+
+		log("Replay differs from recording at step", step);
+		stop();
+
+		return E_DATA;
+
+	}
+
+	return E_NONE;
+
+}
+
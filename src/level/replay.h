@@ -0,0 +1,101 @@
+
+/**
+ *
+ * @file replay.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created replay.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _REPLAY_H
+#define _REPLAY_H
+
+
+#include "OpenJazz.h"
+
+
+// Constants
+
+#define REPLAY_VERSION 1
+
+// Steps between checks of the level's state
+#ifndef REPLAY_CHECK
+	#define REPLAY_CHECK 60
+#endif
+
+// Record types
+#define RR_END      0 /* End of the replay */
+#define RR_CONTROLS 1 /* + number of steps, controls held during them */
+#define RR_CHECK    2 /* + hash of the level's state */
+
+
+// Enum
+
+/// What the replay is doing
+enum ReplayMode {
+
+	RM_OFF = 0, ///< Neither recording nor playing back
+	RM_RECORD = 1, ///< Recording the next level played
+	RM_PLAY = 2 ///< Playing back
+
+};
+
+
+// Classes
+
+class File;
+class Player;
+
+/// Recording of the local player's controls for every step of a level. While
+/// recording or playing back, each frame takes exactly one step, so the level
+/// plays out identically from the same controls.
+class Replay {
+
+	private:
+		File*         file; ///< The replay file, while open
+		char*         fileName; ///< Name of the replay file
+		char*         levelFile; ///< Name of the level, when playing back
+		int           difficulty; ///< Difficulty setting, when playing back
+		int           canvasWidth; ///< Canvas width during recording, when playing back
+		int           canvasHeight; ///< Canvas height during recording, when playing back
+		ReplayMode    mode; ///< What the replay is doing
+		unsigned char held; ///< Controls held during the current run of steps
+		int           run; ///< Number of steps in the current run
+
+		void storeRun ();
+
+	public:
+		Replay  ();
+		~Replay ();
+
+		void        record          (const char* replayFile);
+		int         play            (const char* replayFile);
+		const char* getLevel        ();
+		int         getDifficulty   ();
+		int         getCanvasWidth  ();
+		int         getCanvasHeight ();
+		bool        isActive        ();
+		void        start           (const char* level, int levelDifficulty);
+		void        stop            ();
+		int         control         (Player* player);
+		int         check           (unsigned int step, unsigned int hash);
+
+};
+
+
+// Variable
+
+EXTERN Replay replay;
+
+#endif
+
@@ -0,0 +1,215 @@
+
+/**
+ *
+ * @file rewind.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created rewind.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Keeps the states a level had at each of the last few steps. Each state is
+ * a straight copy of the regions of memory added to it, so capturing one costs
+ * no more than copying those bytes.
+ *
+ */
+
+
+#include "rewind.h"
+
+#include <string.h>
+
+
+/**
+ * Create a rewind with no regions, remembering a state for each of the last
+ * REWIND_STEPS steps.
+ */
+Rewind::Rewind () {
+
+	nRegions = 0;
+	size = 0;
+	nStates = REWIND_STEPS;
+	states = NULL;
+
+	memset(held, 0, sizeof(held));
+
+	return;
+
+}
+
+
+/**
+ * Create a rewind with no regions.
+ *
+ * @param stateCount Number of states to remember, a power of 2 no greater than
+ * REWIND_STEPS
+ */
+Rewind::Rewind (int stateCount) {
+
+	nRegions = 0;
+	size = 0;
+	nStates = (stateCount < REWIND_STEPS)? stateCount: REWIND_STEPS;
+	states = NULL;
+
+	memset(held, 0, sizeof(held));
+
+	return;
+
+}
+
+
+/**
+ * Delete the remembered states.
+ */
+Rewind::~Rewind () {
+
+	if (states) delete[] states;
+
+	return;
+
+}
+
+
+/**
+ * Remove every region, and forget every state.
+ */
+void Rewind::clear () {
+
+	if (states) delete[] states;
+	states = NULL;
+
+	nRegions = 0;
+	size = 0;
+
+	memset(held, 0, sizeof(held));
+
+	return;
+
+}
+
+
+/**
+ * Add a region of memory to the state. The states remembered so far are
+ * forgotten, as they do not include it.
+ *
+ * @param data The memory
+ * @param regionSize Number of bytes
+ */
+void Rewind::add (void* data, int regionSize) {
+
+	if (!data || (regionSize <= 0) || (nRegions >= REWIND_REGIONS)) return;
+
+	if (states) delete[] states;
+	states = NULL;
+
+	memset(held, 0, sizeof(held));
+
+	regions[nRegions].data = data;
+	regions[nRegions].size = regionSize;
+	nRegions++;
+
+	size += regionSize;
+
+	return;
+
+}
+
+
+/**
+ * Remember the state at the given step, in place of the state as many steps
+ * before as there are states.
+ *
+ * @param step The step
+ *
+ * @return Whether or not the state was captured
+ */
+bool Rewind::capture (unsigned int step) {
+
+	unsigned char* state;
+	int slot, count;
+
+	if (!size) return false;
+
+	if (!states) states = new unsigned char[nStates * size];
+
+	slot = step & (nStates - 1);
+	state = states + (slot * size);
+
+	for (count = 0; count < nRegions; count++) {
+
+		memcpy(state, regions[count].data, regions[count].size);
+		state += regions[count].size;
+
+	}
+
+	stateSteps[slot] = step;
+	held[slot] = true;
+
+	return true;
+
+}
+
+
+/**
+ * Note that the state at the given step cannot be captured, so that the
+ * state it would have replaced is not mistaken for it.
+ *
+ * @param step The step
+ */
+void Rewind::forget (unsigned int step) {
+
+	held[step & (nStates - 1)] = false;
+
+	return;
+
+}
+
+
+/**
+ * Put back the state at the given step, if it is still remembered.
+ *
+ * @param step The step
+ *
+ * @return Whether or not the state was put back
+ */
+bool Rewind::restore (unsigned int step) {
+
+	unsigned char* state;
+	int slot, count;
+
+	slot = step & (nStates - 1);
+
+	if (!held[slot] || (stateSteps[slot] != step)) return false;
+
+	state = states + (slot * size);
+
+	for (count = 0; count < nRegions; count++) {
+
+		memcpy(regions[count].data, state, regions[count].size);
+		state += regions[count].size;
+
+	}
+
+	return true;
+
+}
+
+
+/**
+ * Get the size of each state.
+ *
+ * @return Number of bytes
+ */
+int Rewind::getSize () {
+
+	return size;
+
+}
+
@@ -0,0 +1,73 @@
+
+/**
+ *
+ * @file rewind.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created rewind.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _REWIND_H
+#define _REWIND_H
+
+
+// Constants
+
+#define REWIND_STEPS   16 /* Most states remembered, must be a power of 2 */
+#define REWIND_REGIONS 32 /* Most regions of memory making up the state */
+
+
+// Datatype
+
+/// Region of memory making up part of a level's state
+typedef struct {
+
+	void* data; ///< The memory
+	int   size; ///< Number of bytes
+
+} RewindRegion;
+
+
+// Class
+
+/// The states a level had at each of the last few steps, so that it can be
+/// taken back to one of them. The state is whatever memory has been added to
+/// it, copied as it stands, so must not include anything which is allocated
+/// or freed between steps.
+class Rewind {
+
+	private:
+		RewindRegion   regions[REWIND_REGIONS]; ///< The memory making up the state
+		int            nRegions; ///< Number of regions
+		int            size; ///< Total size of the regions
+		int            nStates; ///< Number of states remembered, a power of 2
+		unsigned char* states; ///< The remembered states, allocated when first needed
+		unsigned int   stateSteps[REWIND_STEPS]; ///< Step at which each remembered state was captured
+		bool           held[REWIND_STEPS]; ///< Whether or not each state is remembered
+
+	public:
+		Rewind  ();
+		Rewind  (int stateCount);
+		~Rewind ();
+
+		void clear   ();
+		void add     (void* data, int regionSize);
+		bool capture (unsigned int step);
+		void forget  (unsigned int step);
+		bool restore (unsigned int step);
+		int  getSize ();
+
+};
+
+#endif
+
@@ -0,0 +1,112 @@
+
+/**
+ *
+ * @file viewport.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created viewport.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Points the canvas at part of itself, so that drawing code which fills the
+ * canvas fills only that part.
+ *
+ */
+
+
+#include "viewport.h"
+
+#include "io/gfx/video.h"
+
+
+/**
+ * Create an unused viewport.
+ */
+Viewport::Viewport () {
+
+	surface = NULL;
+	base = NULL;
+	wholeCanvas = NULL;
+
+	return;
+
+}
+
+
+/**
+ * Delete the viewport. The canvas's pixels are left alone.
+ */
+Viewport::~Viewport () {
+
+	if (surface) SDL_FreeSurface(surface);
+
+	return;
+
+}
+
+
+/**
+ * Use part of the canvas as the canvas, until end() is called. If that part
+ * cannot be used, drawing carries on into the whole canvas.
+ *
+ * @param area The part of the canvas, which must be within it
+ */
+void Viewport::begin (SDL_Rect* area) {
+
+	unsigned char* pixels;
+
+	pixels = ((unsigned char *)(canvas->pixels)) + (canvas->pitch * area->y) + area->x;
+
+	// The surface is made again if the canvas or the viewport has changed
+	if (!surface || (pixels != base) || (surface->pitch != canvas->pitch) ||
+		(surface->w != area->w) || (surface->h != area->h)) {
+
+		if (surface) SDL_FreeSurface(surface);
+
+		surface = SDL_CreateRGBSurfaceFrom(pixels, area->w, area->h, 8, canvas->pitch, 0, 0, 0, 0);
+		base = pixels;
+
+		if (!surface) return;
+
+	}
+
+	// Sharing the canvas's palette means colours are matched exactly as they
+	// would be when drawing to the canvas
+	SDL_SetSurfacePalette(surface, canvas->format->palette);
+
+	wholeCanvas = canvas;
+	wholeW = canvasW;
+	wholeH = canvasH;
+
+	canvas = surface;
+	canvasW = area->w;
+	canvasH = area->h;
+
+	return;
+
+}
+
+
+/**
+ * Go back to using the whole canvas.
+ */
+void Viewport::end () {
+
+	if (!wholeCanvas) return;
+
+	canvas = wholeCanvas;
+	canvasW = wholeW;
+	canvasH = wholeH;
+	wholeCanvas = NULL;
+
+	return;
+
+}
+
@@ -0,0 +1,67 @@
+
+/**
+ *
+ * @file viewport.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created viewport.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Lets a level draw each of several views into its own part of the canvas.
+ *
+ */
+
+
+#ifndef _VIEWPORT_H
+#define _VIEWPORT_H
+
+
+#include "OpenJazz.h"
+
+#define SDL2
+
+#ifdef SDL2
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+
+// Constant
+
+#define MAX_VIEWPORTS 2 /* Most views of a level shown side by side */
+
+
+// Class
+
+/// Part of the canvas used in place of the whole canvas while a view is
+/// drawn. Its pixels are the canvas's own, so nothing needs copying, and the
+/// level's caches are shared between all its views.
+class Viewport {
+
+	private:
+		SDL_Surface*   surface; ///< Surface sharing the canvas's pixels within the viewport, or NULL
+		unsigned char* base; ///< The first canvas pixel of the viewport, when the surface was made
+		SDL_Surface*   wholeCanvas; ///< The whole canvas, while the viewport is in use, or NULL
+		int            wholeW; ///< The whole canvas's width, while the viewport is in use
+		int            wholeH; ///< The whole canvas's height, while the viewport is in use
+
+	public:
+		Viewport  ();
+		~Viewport ();
+
+		void begin (SDL_Rect* area);
+		void end   ();
+
+};
+
+#endif
+
@@ -37,9 +37,12 @@
 #define JOYSTICKHDWN 0x700
 
 
-// Variable
+// Variables
 
 EXTERN unsigned int globalTicks;
+EXTERN Uint64       globalClock; ///< Time the current frame started, in microseconds
+EXTERN bool         headless; ///< Whether or not running as a dedicated server, without video or audio
+EXTERN bool         latencyTest; ///< Whether or not to flash the frame after each press, to measure input latency
 
 
 // Enum
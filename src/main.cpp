@@ -29,18 +29,33 @@
 #define SDL2
 
 #include "game/game.h"
+#include "io/assetcache.h"
 #include "io/controls.h"
 #include "io/file.h"
+#include "io/gfx/capture.h"
 #include "io/gfx/font.h"
 #include "io/gfx/video.h"
+#include "io/loadprofile.h"
 #include "io/network.h"
 #include "io/sound.h"
 #include "jj2level/jj2level.h"
 #include "jj1level/jj1level.h"
+#include "menu/catalogue.h"
 #include "menu/menu.h"
 #include "player/player.h"
 #include "jj1scene/jj1scene.h"
+#include "level/benchmark.h"
+#include "level/replay.h"
+#include "clock.h"
+#include "jobs.h"
 #include "loop.h"
+#include "memtrack.h"
+#include "microbench.h"
+#include "pacer.h"
+#include "pressure.h"
+#include "profile.h"
+#include "residency.h"
+#include "scratch.h"
 #include "setup.h"
 #include "util.h"
 
@@ -64,6 +79,7 @@
 	#include <fs_info.h>
 #endif
 
+#include <stdlib.h>
 #include <string.h>
 
 #if defined(WIZ) || defined(GP2X)
@@ -72,12 +88,56 @@
 
 #ifdef __SYMBIAN32__
 extern char KOpenJazzPath[256];
-extern float sinf (float);
-#else
-	#include <math.h>
 #endif
 
-#define PI 3.141592f
+
+GameModeType serverMode; ///< Game mode of a dedicated server
+char*        serverLevel = NULL; ///< First level of a dedicated server
+char*        relayAddress = NULL; ///< Server passed on by a relay
+char*        spectateAddress = NULL; ///< Server to watch, instead of running the menu
+
+
+/**
+ * Find the game mode with the given name, for a dedicated server.
+ *
+ * @param name The name of the mode: coop, battle, teambattle or race
+ * @param modeType Variable to receive the mode
+ *
+ * @return Whether or not the name was recognised
+ */
+static bool getServerMode (const char* name, GameModeType* modeType) {
+
+	if (!strcmp(name, "coop")) *modeType = M_COOP;
+	else if (!strcmp(name, "battle")) *modeType = M_BATTLE;
+	else if (!strcmp(name, "teambattle")) *modeType = M_TEAMBATTLE;
+	else if (!strcmp(name, "race")) *modeType = M_RACE;
+	else return false;
+
+	return true;
+
+}
+
+
+/**
+ * Log how long a phase of start-up took.
+ *
+ * @param phase Description of the phase
+ * @param phaseTicks Time at which the phase started, which becomes the time at
+ * which the next phase starts
+ */
+static void logStartUpPhase (const char* phase, unsigned int* phaseTicks) {
+
+	unsigned int ticks;
+
+	ticks = getTicks();
+
+	log(phase, ticks - *phaseTicks);
+
+	*phaseTicks = ticks;
+
+	return;
+
+}
 
 
 /**
@@ -91,8 +151,7 @@ extern float sinf (float);
  */
 void startUp (int argc, char *argv[]) {
 
-	File* file;
-	unsigned char* pixels = NULL;
+	unsigned int startTicks, phaseTicks;
 	int count;
 	int screenW = DEFAULT_SCREEN_WIDTH;
 	int screenH = DEFAULT_SCREEN_HEIGHT;
@@ -103,6 +162,20 @@ void startUp (int argc, char *argv[]) {
 	bool fullscreen = false;
 #endif
 
+	startClock();
+	startTicks = phaseTicks = getTicks();
+
+
+	// Share work between the cores from the start, as loading uses them
+	jobs.start();
+
+
+	// When memory runs short, preloading stops before anything a level uses
+	// is freed
+	memoryPressure.add("preloader", RP_PRELOAD, AssetCache::relievePreload, &assetCache, true);
+	memoryPressure.add("unused assets", RP_UNUSED, AssetCache::relieveUnused, &assetCache, true);
+	memoryPressure.start();
+
 
 	// Determine paths
 
@@ -144,6 +217,24 @@ void startUp (int argc, char *argv[]) {
 
 	for (count = 1; count < argc; count++) {
 
+		// The dedicated server's mode and level are not paths
+		if (!strcmp(argv[count], "--server")) {
+
+			count += 2;
+
+			continue;
+
+		}
+
+		// Nor are the addresses of servers to relay or watch
+		if (!strcmp(argv[count], "--relay") || !strcmp(argv[count], "--spectate")) {
+
+			count++;
+
+			continue;
+
+		}
+
 		// If it isn't an option, it should be a path
 		if (argv[count][0] != '-') {
 
@@ -206,6 +297,14 @@ void startUp (int argc, char *argv[]) {
 
 	firstPath = new Path(firstPath, createString(""));
 
+	// List the files in each path, rather than looking in each path for them
+	indexPaths();
+
+	// Find the levels while the rest of start-up goes on
+	catalogue.start();
+
+	logStartUpPhase("Start-up: paths (ms)", &phaseTicks);
+
 
 
 	// Default settings
@@ -223,9 +322,92 @@ void startUp (int argc, char *argv[]) {
 	setup.load(&screenW, &screenH, &fullscreen, &scaleFactor);
 
 
+	logStartUpPhase("Start-up: settings (ms)", &phaseTicks);
+
+
 	// Get command-line override
 	for (count = 1; count < argc; count++) {
 
+		// Dedicated server, e.g. --server battle LEVEL0.000 to host the level
+		// without a window or audio
+		if (!strcmp(argv[count], "--server")) {
+
+			if ((count + 2 >= argc) || !getServerMode(argv[count + 1], &serverMode)) {
+
+				log("Usage: OpenJazz --server <coop|battle|teambattle|race> <level>");
+
+				delete firstPath;
+
+				throw E_DATA;
+
+			}
+
+			serverLevel = argv[count + 2];
+			count += 2;
+
+			continue;
+
+		}
+
+		// Relay, e.g. --relay 192.168.0.2 to pass a server's game on to
+		// spectators, without a window or audio
+		if (!strcmp(argv[count], "--relay") || !strcmp(argv[count], "--spectate")) {
+
+			if (count + 1 >= argc) {
+
+				log("Usage: OpenJazz --relay <address> or --spectate <address>");
+
+				delete firstPath;
+
+				throw E_DATA;
+
+			}
+
+			if (argv[count][2] == 'r') relayAddress = argv[count + 1];
+			else spectateAddress = argv[count + 1];
+
+			count++;
+
+			continue;
+
+		}
+
+		// Input latency test, flashing the screen for the frame after each
+		// press and logging how long it took to be presented
+		if (!strcmp(argv[count], "--latency")) {
+
+			latencyTest = true;
+
+			continue;
+
+		}
+
+		// Benchmark comparison, e.g. --bench-runs 9 --bench-baseline old.txt
+		// --bench-results new.txt to run the benchmark nine times, keep the
+		// results, and fail if any are worse than those kept before
+		if (!strcmp(argv[count], "--bench-runs") || !strcmp(argv[count], "--bench-baseline") ||
+			!strcmp(argv[count], "--bench-results")) {
+
+			if (count + 1 >= argc) {
+
+				log("Usage: OpenJazz --bench-runs <count>, --bench-baseline <file> or --bench-results <file>");
+
+				delete firstPath;
+
+				throw E_DATA;
+
+			}
+
+			if (argv[count][9] == 'u') bench.requestRuns(atoi(argv[count + 1]));
+			else if (argv[count][9] == 'a') bench.requestBaseline(argv[count + 1]);
+			else bench.requestResults(argv[count + 1]);
+
+			count++;
+
+			continue;
+
+		}
+
 		// If there's a hyphen, it should be an option
 		if (argv[count][0] == '-') {
 
@@ -237,16 +419,84 @@ void startUp (int argc, char *argv[]) {
 				setSoundVolume(0);
 			}
 
+			// Audio buffer size and rate, e.g. -l for low latency, or
+			// -b512 -r48000
+			if (argv[count][1] == 'l') setAudioFormat(SOUND_SAMPLES_LOW, 0);
+			if (argv[count][1] == 'b') setAudioFormat(atoi(argv[count] + 2), 0);
+			if (argv[count][1] == 'r') setAudioFormat(0, atoi(argv[count] + 2));
+
+			// Replays, e.g. -wfirst.rep to record the next level played, or
+			// -pfirst.rep to play it back
+			if (argv[count][1] == 'w') replay.record(argv[count] + 2);
+			if (argv[count][1] == 'p') replay.play(argv[count] + 2);
+
+			// Benchmark, e.g. -sfirst.rep to play the replay back as fast as
+			// possible, silently and without drawing, and log the step times
+			if (argv[count][1] == 's') {
+
+				replay.play(argv[count] + 2);
+				bench.requestSteps(argv[count] + 2);
+				setMusicVolume(0);
+				setSoundVolume(0);
+
+			}
+
+			// Most clients a server accepts, e.g. -c64
+			if ((argv[count][1] == 'c') && (atoi(argv[count] + 2) > 0) &&
+				(atoi(argv[count] + 2) <= MAX_CLIENTS))
+				setup.maxClients = atoi(argv[count] + 2);
+
+			// Two players sharing the screen in local games, the second using
+			// the second joystick or W, A, S, D, left shift, left control and
+			// tab
+			if (argv[count][1] == '2') {
+
+				setup.localPlayers = 2;
+				controls.setJoystick(0);
+				secondControls.useSecondSet();
+
+			}
+
+#ifdef SDL2
+			// True-colour mode, drawing level tiles from copies expanded to
+			// 32 bits
+			if (argv[count][1] == 't') video.setTrueColour(true);
+#endif
+
+			// Kernel benchmarks, printed as JSON
+			if (argv[count][1] == 'k') bench.requestKernels();
+
+			// Drawing benchmark, e.g. -vLEVEL0.000,LEVEL1.000 to sweep the view
+			// across each level and log the frame times
+			if (argv[count][1] == 'v') {
+
+				bench.requestFrames(argv[count] + 2);
+				setMusicVolume(0);
+				setSoundVolume(0);
+
+			}
+
 		}
 
 	}
 
 
-	// Create the game's window
+	// Create the game's window, or for a dedicated server just somewhere for
+	// loading screens to be drawn
 
 	canvas = NULL;
 
-	if (!video.init(screenW, screenH, fullscreen)) {
+	if (headless) {
+
+		if (!video.initHeadless()) {
+
+			delete firstPath;
+
+			throw E_VIDEO;
+
+		}
+
+	} else if (!video.init(screenW, screenH, fullscreen)) {
 
 		delete firstPath;
 
@@ -254,28 +504,42 @@ void startUp (int argc, char *argv[]) {
 
 	}
 
+	if (!headless) video.setIntegerScale(setup.integerScale);
+#ifdef SDL2
+	if (!headless) video.setDynamicResolution(setup.dynamicResolution);
+#endif
+	pacer.setTarget(setup.paceTarget);
+
 #ifdef SCALE
-	video.setScaleFactor(scaleFactor);
+	if (!headless) video.setScaleFactor(scaleFactor);
 #endif
 
 
-	if (SDL_NumJoysticks() > 0) SDL_JoystickOpen(0);
+	if (!headless && (SDL_NumJoysticks() > 0)) SDL_JoystickOpen(0);
+
+	logStartUpPhase("Start-up: video (ms)", &phaseTicks);
 
 
 	// Set up audio
-	openAudio();
+	if (!headless) {
 
+		openAudio();
 
+		// The menu music plays often enough to keep once it has been heard
+		cacheMusic("MENUSNG.PSM");
 
-	// Load fonts
+	}
 
-	// Open the panel, which contains two fonts
+	logStartUpPhase("Start-up: audio (ms)", &phaseTicks);
 
-	try {
 
-		file = new File("PANEL.000", false);
 
-	} catch (int e) {
+	// Load fonts
+
+	// The panel, which contains two more fonts, is loaded with the first level
+	// but its absence means the game's data cannot be found
+
+	if (!fileExists("PANEL.000")) {
 
 		closeAudio();
 
@@ -295,14 +559,10 @@ void startUp (int argc, char *argv[]) {
 		alert->Go();
 #endif
 
-		throw e;
+		throw E_FILE;
 
 	}
 
-	pixels = file->loadRLE(46272);
-
-	delete file;
-
 	panelBigFont = NULL;
 	panelSmallFont = NULL;
 	font2 = NULL;
@@ -312,8 +572,6 @@ void startUp (int argc, char *argv[]) {
 
 	try {
 
-		panelBigFont = new Font(pixels + (40 * 320), true);
-		panelSmallFont = new Font(pixels + (48 * 320), false);
 		font2 = new Font("FONT2.0FN");
 		fontbig = new Font("FONTBIG.0FN");
 		fontiny = new Font("FONTINY.0FN");
@@ -322,15 +580,11 @@ void startUp (int argc, char *argv[]) {
 
 	} catch (int e) {
 
-		if (panelBigFont) delete panelBigFont;
-		if (panelSmallFont) delete panelSmallFont;
 		if (font2) delete font2;
 		if (fontbig) delete fontbig;
 		if (fontiny) delete fontiny;
 		if (fontmn1) delete fontmn1;
 
-		delete[] pixels;
-
 		closeAudio();
 
 		delete firstPath;
@@ -339,16 +593,12 @@ void startUp (int argc, char *argv[]) {
 
 	}
 
-	delete[] pixels;
+	logStartUpPhase("Start-up: fonts (ms)", &phaseTicks);
 
 
 	// Establish arbitrary timing
-	globalTicks = SDL_GetTicks() - 20;
-
-
-	// Fill trigonometric function look-up tables
-	for (count = 0; count < 1024; count++)
-		sinLut[count] = fixed(sinf(2 * PI * float(count) / 1024.0f) * 1024.0f);
+	globalClock = getClock() - (20 * (CLOCK_RATE / 1000));
+	globalTicks = globalClock / (CLOCK_RATE / 1000);
 
 
 	// Initiate networking
@@ -358,6 +608,9 @@ void startUp (int argc, char *argv[]) {
 	level = NULL;
 	jj2Level = NULL;
 
+	logStartUpPhase("Start-up: other (ms)", &phaseTicks);
+	log("Start-up: total (ms)", phaseTicks - startTicks);
+
 }
 
 
@@ -379,16 +632,33 @@ void shutDown () {
 	delete fontmn2;
 
 #ifdef SCALE
-	if (video.getScaleFactor() > 1) SDL_FreeSurface(canvas);
+	if (video.getScaleFactor() > 1) freeSurface(canvas);
 #endif
 
+	// Free the tile sets and sprites kept between levels, first finishing any
+	// preloading, as that may prefetch music
+	memoryPressure.stop();
+	assetCache.clear();
+
 	closeAudio();
 
+	// Nothing is left for other cores to do
+	video.finishRendering();
+	capture.finish();
+	catalogue.finish();
 
 	// Save settings to config file
 	setup.save();
+	setup.finish();
+
+	jobs.stop();
 
+	// Frames recorded in a profiled build are summarised beside it
+	PROFILE_SAVE();
+	MEMORY_LOG();
 
+
+	clearPathIndex();
 	delete firstPath;
 
 }
@@ -403,10 +673,139 @@ int play () {
 	
 	MainMenu *mainMenu = NULL;
 	JJ1Scene *scene = NULL;
+	Game *game = NULL;
+	char *levelFile;
+	const char *levels;
+	int length, run;
 
 	// Start the opening music
     
 
+	if (bench.getMode() == BM_KERNELS) return runMicrobenchmarks();
+
+	// Host the level until told to stop, instead of running the menu
+	if (headless) {
+
+		try {
+
+			if (relayAddress) game = new RelayGame(relayAddress);
+			else game = new ServerGame(serverMode, serverLevel, 0);
+
+		} catch (int e) {
+
+			logError("Could not start the server", relayAddress? relayAddress: serverLevel);
+
+			return e;
+
+		}
+
+		log(relayAddress? "Relaying": "Serving", relayAddress? relayAddress: serverLevel);
+
+		game->play();
+
+		delete game;
+
+		return E_NONE;
+
+	}
+
+	// Watch a game instead of running the menu
+	if (spectateAddress) {
+
+		try {
+
+			game = new ClientGame(spectateAddress, true);
+
+		} catch (int e) {
+
+			logError("Could not watch the game", spectateAddress);
+
+			return e;
+
+		}
+
+		game->play();
+
+		delete game;
+
+		return E_NONE;
+
+	}
+
+	// Play back a replay instead of running the menu, once for each run of a
+	// benchmark
+	if (replay.getLevel()) {
+
+		for (run = 0; run < bench.getRuns(); run++) {
+
+			// The replay is played back from the start again
+			if (run && (replay.play(bench.getReplay()) != E_NONE)) break;
+
+			try {
+
+				game = new LocalGame(replay.getLevel(), replay.getDifficulty(), 1);
+
+			} catch (int e) {
+
+				return e;
+
+			}
+
+			levelFile = createString(replay.getLevel());
+			bench.setLabel(levelFile);
+			game->playLevel(levelFile);
+			bench.setLabel(NULL);
+			delete[] levelFile;
+
+			delete game;
+
+		}
+
+		return bench.finish();
+
+	}
+
+	// Draw each of the levels to benchmark instead of running the menu
+	for (run = 0; bench.getLevels() && (run < bench.getRuns()); run++) {
+
+		levels = bench.getLevels();
+
+		while (*levels) {
+
+			for (length = 0; levels[length] && (levels[length] != ','); length++);
+
+			levelFile = new char[length + 1];
+			memcpy(levelFile, levels, length);
+			levelFile[length] = 0;
+
+			try {
+
+				game = new LocalGame(levelFile, 0, 1);
+
+			} catch (int e) {
+
+				delete[] levelFile;
+
+				return e;
+
+			}
+
+			bench.setLabel(levelFile);
+			game->playLevel(levelFile);
+			bench.setLabel(NULL);
+
+			delete game;
+			delete[] levelFile;
+
+			levels += length;
+			if (*levels) levels++;
+
+		}
+
+	}
+
+	if (bench.getLevels()) return bench.finish();
+
 	playMusic("MENUSNG.PSM");
 
 	// Load and play the startup cutscene
@@ -477,10 +876,50 @@ int play () {
 }
 
 
+static bool         latencyDue = false; ///< Whether or not the coming frame follows a press being timed
+static unsigned int latencyPress = 0; ///< Time of the press being timed
+
+
+/**
+ * Fill the canvas with the brightest colour in the palette, so that a camera
+ * can see when the frame following a press is shown.
+ */
+static void flashCanvas () {
+
+	SDL_Color* palette;
+	int count, brightest, brightness, most;
+
+	palette = video.getPalette();
+	brightest = 0;
+	most = -1;
+
+	for (count = 0; count < 256; count++) {
+
+		brightness = palette[count].r + palette[count].g + palette[count].b;
+
+		if (brightness > most) {
+
+			brightest = count;
+			most = brightness;
+
+		}
+
+	}
+
+	SDL_FillRect(canvas, NULL, brightest);
+
+	return;
+
+}
+
+
 /**
  * Process iteration.
  *
- * Called once per game iteration. Updates timing, video, and input
+ * Called once per game iteration. Shows what has been drawn, waits until the
+ * next frame is due, then updates timing and input. Input is read as late as
+ * possible, just before the level steps which use it, and what they draw is
+ * shown as soon as the next iteration starts.
  *
  * @param type Type of loop. Normal, typing, or input configuration
  * @param paletteEffects Palette effects to apply to video output
@@ -491,23 +930,55 @@ int play () {
 int loop (LoopType type, PaletteEffect* paletteEffects, bool effectsStopped) {
 
 	SDL_Event event;
-	int prevTicks, ret;
+	int ret;
 
 
-	// Update tick count
-	prevTicks = globalTicks;
-	globalTicks = SDL_GetTicks();
+	// Show what has been drawn
+	if (!headless) {
+
+		if (latencyDue) flashCanvas();
+
+		pacer.drawn();
+		video.flip(getTicks() - globalTicks, paletteEffects, effectsStopped);
+
+		if (latencyDue) {
 
-	if (globalTicks - prevTicks < 4) {
+			log("Input to present (ms)", SDL_GetTicks() - latencyPress);
+			latencyDue = false;
 
-		// Limit framerate
-		SDL_Delay(4 + prevTicks - globalTicks);
-		globalTicks = SDL_GetTicks();
+		}
 
 	}
 
-	// Show what has been drawn
-	video.flip(globalTicks - prevTicks, paletteEffects, effectsStopped);
+	// Nothing drawn or sent this frame needs its frame memory any longer
+	resetFrameScratch();
+
+	// Wait until the next frame is due, then update tick count
+	PROFILE_BEGIN(PZ_WAIT);
+	pacer.wait();
+	PROFILE_END(PZ_WAIT);
+	PROFILE_FRAME();
+
+	// Game logic keeps to whole milliseconds, while pacing and interpolation
+	// use the finer time
+	globalClock = getClock();
+	globalTicks = globalClock / (CLOCK_RATE / 1000);
+
+	memoryPressure.check();
+
+	// A dedicated server has no window or input, so only needs to know when
+	// to stop
+	if (headless) {
+
+		while (SDL_PollEvent(&event)) {
+
+			if (event.type == SDL_QUIT) return E_QUIT;
+
+		}
+
+		return E_NONE;
+
+	}
 
 
 	// Process system events
@@ -515,11 +986,28 @@ int loop (LoopType type, PaletteEffect* paletteEffects, bool effectsStopped) {
 
 		if (event.type == SDL_QUIT) return E_QUIT;
 
+		pacer.input();
+
+		// The frame drawn after the first press is flashed
+		if (latencyTest && !latencyDue &&
+			((event.type == SDL_KEYDOWN) || (event.type == SDL_JOYBUTTONDOWN) ||
+			(event.type == SDL_MOUSEBUTTONDOWN) || (event.type == SDL_FINGERDOWN))) {
+
+			latencyPress = event.common.timestamp;
+			latencyDue = true;
+
+		}
+
 		ret = controls.update(&event, type);
 
 		if (ret != E_NONE) return ret;
 
+		// The second player's controls are only used in play
+		if ((setup.localPlayers > 1) && (type == NORMAL_LOOP))
+			secondControls.update(&event, type);
+
 		video.update(&event);
+		capture.update(&event);
 
 #if defined(WIZ) || defined(GP2X)
 		if ((event.type == SDL_JOYBUTTONDOWN) ||
@@ -545,6 +1033,8 @@ int loop (LoopType type, PaletteEffect* paletteEffects, bool effectsStopped) {
 
 	controls.loop();
 
+	if (setup.localPlayers > 1) secondControls.loop();
+
 
 #if defined(WIZ) || defined(GP2X)
 	WIZ_AdjustVolume( volume_direction );
@@ -567,7 +1057,7 @@ int loop (LoopType type, PaletteEffect* paletteEffects, bool effectsStopped) {
  */
 int main(int argc, char *argv[]) {
 
-	int ret;
+	int count, ret;
 
 	// Early platform init
 
@@ -593,7 +1083,16 @@ int main(int argc, char *argv[]) {
         }
     } 
 
-	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER | SDL_INIT_JOYSTICK) < 0) {
+	// A dedicated server needs neither video, audio nor input
+	for (count = 1; count < argc; count++) {
+
+		if (!strcmp(argv[count], "--server") || !strcmp(argv[count], "--relay"))
+			headless = true;
+
+	}
+
+	if (SDL_Init(headless? SDL_INIT_TIMER | SDL_INIT_EVENTS:
+		SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER | SDL_INIT_JOYSTICK) < 0) {
 
 		logError("Could not start SDL", SDL_GetError());
 
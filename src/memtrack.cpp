@@ -0,0 +1,435 @@
+
+/**
+ *
+ * @file memtrack.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created memtrack.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Replaces the global new and delete, so that every allocation made with them
+ * is counted against the tag of the scope it was made in. Each allocation
+ * carries a header holding its size and tag, so that it is counted off the
+ * same tag when deleted, whichever scope that happens in. Memory allocated
+ * by libraries with malloc is not counted. Allocations which fail call the new
+ * handler, as they would without tracking.
+ *
+ */
+
+
+#include "memtrack.h"
+
+#ifdef TRACK_MEMORY
+
+#include "util.h"
+
+#include <new>
+#include <stdlib.h>
+
+
+// The header is padded so that the memory after it stays aligned
+#define MEMORY_HEADER 16
+
+
+/// Size and tag of an allocation, kept before it
+typedef struct {
+
+	size_t size; ///< Number of bytes requested
+	int    tag; ///< The tag it is counted against
+
+} MemoryHeader;
+
+
+static thread_local MemoryTag currentTag = MEM_OTHER; ///< Tag of the current thread's scope
+static long long int currentBytes[MEMORY_TAGS]; ///< Bytes allocated for each tag
+static long long int peakBytes[MEMORY_TAGS]; ///< Most bytes allocated for each tag at once
+static long long int totalBytes; ///< Bytes allocated for every tag
+static int           overBudget; ///< Whether or not the budget has been exceeded since last warned
+
+
+/**
+ * Tag the memory allocated by the current thread until the scope ends.
+ *
+ * @param tag The tag
+ */
+MemoryScope::MemoryScope (MemoryTag tag) {
+
+	outer = currentTag;
+	currentTag = tag;
+
+	return;
+
+}
+
+
+/**
+ * Go back to tagging memory as it was before the scope.
+ */
+MemoryScope::~MemoryScope () {
+
+	currentTag = outer;
+
+	return;
+
+}
+
+
+/**
+ * Allocate memory, counting it against the current scope's tag. A warning is
+ * logged the first time the budget is exceeded, so that it is known what had
+ * been allocated before any allocation fails.
+ *
+ * @param size Number of bytes
+ *
+ * @return The memory, or NULL if it could not be allocated
+ */
+static void* allocate (size_t size) {
+
+	MemoryHeader* header;
+	long long int current, peak, total;
+
+	header = (MemoryHeader *)malloc(MEMORY_HEADER + (size? size: 1));
+
+	if (!header) {
+
+		log("Could not allocate bytes", (int)size);
+		logMemory();
+
+		return NULL;
+
+	}
+
+	header->size = size;
+	header->tag = currentTag;
+
+	// Peaks are only raised, never lowered, by other threads
+	current = __atomic_add_fetch(currentBytes + header->tag, (long long int)size, __ATOMIC_RELAXED);
+	peak = __atomic_load_n(peakBytes + header->tag, __ATOMIC_RELAXED);
+
+	while ((current > peak) &&
+		!__atomic_compare_exchange_n(peakBytes + header->tag, &peak, current, true,
+			__ATOMIC_RELAXED, __ATOMIC_RELAXED));
+
+	total = __atomic_add_fetch(&totalBytes, (long long int)size, __ATOMIC_RELAXED);
+
+	if ((total > ((long long int)MEMORY_BUDGET << 20)) &&
+		!__atomic_exchange_n(&overBudget, 1, __ATOMIC_RELAXED)) {
+
+		log("Memory budget exceeded (MB)", MEMORY_BUDGET);
+		logMemory();
+
+	}
+
+	return ((unsigned char *)header) + MEMORY_HEADER;
+
+}
+
+
+/**
+ * Allocate memory, calling the new handler for as long as it frees some, as
+ * the standard allocator would.
+ *
+ * @param size Number of bytes
+ *
+ * @return The memory
+ */
+static void* allocateOrRelieve (size_t size) {
+
+	void* memory;
+	std::new_handler handler;
+
+	memory = allocate(size);
+
+	while (!memory) {
+
+		handler = std::get_new_handler();
+
+		if (!handler) throw std::bad_alloc();
+
+		handler();
+
+		memory = allocate(size);
+
+	}
+
+	return memory;
+
+}
+
+
+/**
+ * Free memory, counting it off the tag it was allocated with.
+ *
+ * @param memory The memory, or NULL
+ */
+static void release (void* memory) {
+
+	MemoryHeader* header;
+	long long int total;
+
+	if (!memory) return;
+
+	header = (MemoryHeader *)(((unsigned char *)memory) - MEMORY_HEADER);
+
+	__atomic_sub_fetch(currentBytes + header->tag, (long long int)header->size, __ATOMIC_RELAXED);
+	total = __atomic_sub_fetch(&totalBytes, (long long int)header->size, __ATOMIC_RELAXED);
+
+	// Warn again if the budget is exceeded again
+	if (total <= ((long long int)MEMORY_BUDGET << 20))
+		__atomic_store_n(&overBudget, 0, __ATOMIC_RELAXED);
+
+	free(header);
+
+	return;
+
+}
+
+
+/**
+ * Get the memory currently allocated for a tag.
+ *
+ * @param tag The tag
+ *
+ * @return Number of kilobytes
+ */
+int getMemoryCurrent (MemoryTag tag) {
+
+	return __atomic_load_n(currentBytes + tag, __ATOMIC_RELAXED) >> 10;
+
+}
+
+
+/**
+ * Get the most memory allocated for a tag at once.
+ *
+ * @param tag The tag
+ *
+ * @return Number of kilobytes
+ */
+int getMemoryPeak (MemoryTag tag) {
+
+	return __atomic_load_n(peakBytes + tag, __ATOMIC_RELAXED) >> 10;
+
+}
+
+
+/**
+ * Get the memory currently allocated for every tag.
+ *
+ * @return Number of kilobytes
+ */
+int getMemoryTotal () {
+
+	return __atomic_load_n(&totalBytes, __ATOMIC_RELAXED) >> 10;
+
+}
+
+
+/**
+ * Get the short name of a tag, for the statistics overlay and the log.
+ *
+ * @param tag The tag
+ *
+ * @return The name
+ */
+const char* getMemoryName (MemoryTag tag) {
+
+	const char* names[MEMORY_TAGS] = {"other", "level", "sprite", "tiles", "sound", "scene", "net"};
+
+	return names[tag];
+
+}
+
+
+/**
+ * Log the memory currently allocated for each tag, and the most allocated at
+ * once.
+ */
+void logMemory () {
+
+	int count;
+
+	for (count = 0; count < MEMORY_TAGS; count++) {
+
+		log("Memory", getMemoryName((MemoryTag)count));
+		log("  current (kB)", getMemoryCurrent((MemoryTag)count));
+		log("  peak (kB)", getMemoryPeak((MemoryTag)count));
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Allocate memory for an object.
+ *
+ * @param size Number of bytes
+ *
+ * @return The memory
+ */
+void* operator new (size_t size) {
+
+	return allocateOrRelieve(size);
+
+}
+
+
+/**
+ * Allocate memory for an array.
+ *
+ * @param size Number of bytes
+ *
+ * @return The memory
+ */
+void* operator new[] (size_t size) {
+
+	return allocateOrRelieve(size);
+
+}
+
+
+/**
+ * Allocate memory for an object, without throwing if there is none.
+ *
+ * @param size Number of bytes
+ *
+ * @return The memory, or NULL
+ */
+void* operator new (size_t size, const std::nothrow_t&) noexcept {
+
+	try {
+
+		return allocateOrRelieve(size);
+
+	} catch (std::bad_alloc& e) {
+
+		return NULL;
+
+	}
+
+}
+
+
+/**
+ * Allocate memory for an array, without throwing if there is none.
+ *
+ * @param size Number of bytes
+ *
+ * @return The memory, or NULL
+ */
+void* operator new[] (size_t size, const std::nothrow_t&) noexcept {
+
+	try {
+
+		return allocateOrRelieve(size);
+
+	} catch (std::bad_alloc& e) {
+
+		return NULL;
+
+	}
+
+}
+
+
+/**
+ * Free an object's memory.
+ *
+ * @param memory The memory
+ */
+void operator delete (void* memory) noexcept {
+
+	release(memory);
+
+	return;
+
+}
+
+
+/**
+ * Free an array's memory.
+ *
+ * @param memory The memory
+ */
+void operator delete[] (void* memory) noexcept {
+
+	release(memory);
+
+	return;
+
+}
+
+
+/**
+ * Free an object's memory, of known size.
+ *
+ * @param memory The memory
+ * @param size Number of bytes, which the header already holds
+ */
+void operator delete (void* memory, size_t size) noexcept {
+
+	(void)size;
+
+	release(memory);
+
+	return;
+
+}
+
+
+/**
+ * Free an array's memory, of known size.
+ *
+ * @param memory The memory
+ * @param size Number of bytes, which the header already holds
+ */
+void operator delete[] (void* memory, size_t size) noexcept {
+
+	(void)size;
+
+	release(memory);
+
+	return;
+
+}
+
+
+/**
+ * Free an object's memory, allocated without throwing.
+ *
+ * @param memory The memory
+ */
+void operator delete (void* memory, const std::nothrow_t&) noexcept {
+
+	release(memory);
+
+	return;
+
+}
+
+
+/**
+ * Free an array's memory, allocated without throwing.
+ *
+ * @param memory The memory
+ */
+void operator delete[] (void* memory, const std::nothrow_t&) noexcept {
+
+	release(memory);
+
+	return;
+
+}
+
+#endif
+
@@ -0,0 +1,98 @@
+
+/**
+ *
+ * @file memtrack.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created memtrack.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Accounts for the memory allocated with new, by the part of the game which
+ * allocated it. Only built when TRACK_MEMORY is defined (e.g. make
+ * DEFINES=-DTRACK_MEMORY), otherwise the macros expand to nothing.
+ *
+ */
+
+
+#ifndef _MEMTRACK_H
+#define _MEMTRACK_H
+
+
+#include "OpenJazz.h"
+
+#ifdef TRACK_MEMORY
+
+
+// Constants
+
+// Megabytes which may be allocated before a warning is logged
+#ifndef MEMORY_BUDGET
+	#define MEMORY_BUDGET 2048
+#endif
+
+
+// Enum
+
+/// Parts of the game which memory is allocated for
+enum MemoryTag {
+
+	MEM_OTHER = 0, ///< Anything outside the other scopes
+	MEM_LEVEL = 1, ///< Loading levels, including their arenas
+	MEM_SPRITES = 2, ///< Sprites and animations
+	MEM_TILES = 3, ///< Tile sets
+	MEM_SOUND = 4, ///< Sound effects and music
+	MEM_SCENE = 5, ///< Cutscenes
+	MEM_NETWORK = 6 ///< Network games
+
+};
+
+#define MEMORY_TAGS 7
+
+
+// Class
+
+/// Tags the memory allocated by the current thread until it goes out of
+/// scope
+class MemoryScope {
+
+	private:
+		MemoryTag outer; ///< The tag before the scope
+
+	public:
+		MemoryScope  (MemoryTag tag);
+		~MemoryScope ();
+
+};
+
+
+// Functions
+
+EXTERN int         getMemoryCurrent (MemoryTag tag);
+EXTERN int         getMemoryPeak    (MemoryTag tag);
+EXTERN int         getMemoryTotal   ();
+EXTERN const char* getMemoryName    (MemoryTag tag);
+EXTERN void        logMemory        ();
+
+
+// Macros
+
+#define MEMORY_SCOPE(tag) MemoryScope memoryScope(tag) ///< Tag the memory allocated in the rest of the block
+#define MEMORY_LOG() logMemory() ///< Log the memory allocated for each tag
+
+#else
+
+#define MEMORY_SCOPE(tag)
+#define MEMORY_LOG()
+
+#endif
+
+#endif
+
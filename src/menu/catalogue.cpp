@@ -0,0 +1,367 @@
+
+/**
+ *
+ * @file catalogue.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created catalogue.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Lists the levels in the paths, with their titles. Reading each JJ2 level's
+ * title means opening it, so the list is kept in a file between runs, and only
+ * made again once files have been added to, removed from or renamed in the
+ * paths.
+ *
+ */
+
+
+#include "catalogue.h"
+
+#include "io/file.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+/**
+ * Create an empty catalogue.
+ */
+LevelCatalogue::LevelCatalogue () {
+
+	nEntries = 0;
+	building = false;
+
+	return;
+
+}
+
+
+/**
+ * Add a file to the catalogue if it is a level. Called for each file in the
+ * path index, so must not open the file.
+ *
+ * @param name The file's name, in lower case
+ * @param data The catalogue
+ */
+void LevelCatalogue::addEntry (const char* name, void* data) {
+
+	LevelCatalogue* catalogue;
+	CatalogueEntry* entry;
+	int length, place;
+
+	catalogue = (LevelCatalogue*)data;
+	length = strlen(name);
+
+	if (length >= FILE_NAME_LENGTH) return;
+
+	if (catalogue->nEntries == CATALOGUE_LEVELS) return;
+
+	// Find the level's place, keeping the catalogue in order of file name
+	for (place = catalogue->nEntries; (place > 0) && (strcmp(catalogue->entries[place - 1].fileName, name) > 0); place--);
+
+	entry = catalogue->entries + place;
+
+	if ((length > 4) && !strcmp(name + length - 4, ".j2l")) {
+
+		memmove(entry + 1, entry, (catalogue->nEntries - place) * sizeof(CatalogueEntry));
+		entry->type = LT_JJ2;
+		entry->title[0] = 0; // Read once the index is no longer locked
+
+	} else if ((length == 10) && !strncmp(name, "level", 5) &&
+		(name[5] >= '0') && (name[5] <= '9') && (name[6] == '.') &&
+		(name[7] >= '0') && (name[7] <= '9') && (name[8] >= '0') &&
+		(name[8] <= '9') && (name[9] >= '0') && (name[9] <= '9')) {
+
+		// JJ1 levels have no title, so they are named after their place
+		memmove(entry + 1, entry, (catalogue->nEntries - place) * sizeof(CatalogueEntry));
+		entry->type = LT_JJ1;
+		snprintf(entry->title, CATALOGUE_TITLE + 1, "world %d level %d", atoi(name + 7), name[5] - '0' + 1);
+
+	} else return;
+
+	strcpy(entry->fileName, name);
+	catalogue->nEntries++;
+
+	return;
+
+}
+
+
+/**
+ * Read a JJ2 level's title from its header.
+ *
+ * @param entry The level's entry
+ */
+void LevelCatalogue::readTitle (CatalogueEntry* entry) {
+
+	File* file;
+	unsigned char* title;
+	int count;
+
+	try {
+
+		file = new File(entry->fileName, false);
+
+	} catch (int e) {
+
+		strcpy(entry->title, entry->fileName);
+
+		return;
+
+	}
+
+	file->seek(188, true);
+	title = file->loadBlock(CATALOGUE_TITLE);
+
+	// The menu font only has lower case letters
+	for (count = 0; (count < CATALOGUE_TITLE) && title[count]; count++) {
+
+		if ((title[count] >= 'A') && (title[count] <= 'Z')) entry->title[count] = title[count] - 'A' + 'a';
+		else entry->title[count] = title[count];
+
+	}
+
+	entry->title[count] = 0;
+
+	if (!count) strcpy(entry->title, entry->fileName);
+
+	delete[] title;
+	delete file;
+
+	return;
+
+}
+
+
+/**
+ * Load the catalogue kept from an earlier run.
+ *
+ * @param pathsTime When files were last added to, removed from or renamed in
+ * the paths
+ *
+ * @return Whether or not the catalogue was loaded, and is still up to date
+ */
+bool LevelCatalogue::load (int pathsTime) {
+
+	File* file;
+	unsigned char* block;
+	int count;
+
+	if (!hasFile(CATALOGUE_FILE)) return false;
+
+	try {
+
+		file = new File(CATALOGUE_FILE, false);
+
+	} catch (int e) {
+
+		return false;
+
+	}
+
+	if ((file->loadChar() != CATALOGUE_VERSION) || (file->loadInt() != pathsTime)) {
+
+		delete file;
+
+		return false;
+
+	}
+
+	nEntries = file->loadShort(CATALOGUE_LEVELS);
+
+	for (count = 0; count < nEntries; count++) {
+
+		entries[count].type = (LevelType)file->loadChar();
+
+		block = file->loadBlock(FILE_NAME_LENGTH);
+		memcpy(entries[count].fileName, block, FILE_NAME_LENGTH);
+		entries[count].fileName[FILE_NAME_LENGTH - 1] = 0;
+		delete[] block;
+
+		block = file->loadBlock(CATALOGUE_TITLE);
+		memcpy(entries[count].title, block, CATALOGUE_TITLE);
+		entries[count].title[CATALOGUE_TITLE] = 0;
+		delete[] block;
+
+	}
+
+	delete file;
+
+	return true;
+
+}
+
+
+/**
+ * Keep the catalogue for later runs.
+ *
+ * @param pathsTime When files were last added to, removed from or renamed in
+ * the paths
+ */
+void LevelCatalogue::save (int pathsTime) {
+
+	File* file;
+	int count;
+
+	try {
+
+		file = new File(CATALOGUE_FILE, true);
+
+	} catch (int e) {
+
+		return;
+
+	}
+
+	file->storeChar(CATALOGUE_VERSION);
+	file->storeInt(pathsTime);
+	file->storeShort(nEntries);
+
+	for (count = 0; count < nEntries; count++) {
+
+		file->storeChar(entries[count].type);
+		file->storeBlock((unsigned char*)entries[count].fileName, FILE_NAME_LENGTH);
+		file->storeBlock((unsigned char*)entries[count].title, CATALOGUE_TITLE);
+
+	}
+
+	delete file;
+
+	return;
+
+}
+
+
+/**
+ * Make the catalogue, or load it if it is still up to date. Run in the
+ * background.
+ *
+ * @param data The catalogue
+ */
+void LevelCatalogue::build (void* data) {
+
+	LevelCatalogue* catalogue;
+	int count;
+
+	catalogue = (LevelCatalogue*)data;
+
+	if (catalogue->load(getPathsTime())) return;
+
+	catalogue->nEntries = 0;
+	visitFiles(addEntry, catalogue);
+
+	for (count = 0; count < catalogue->nEntries; count++) {
+
+		if (catalogue->entries[count].type == LT_JJ2) catalogue->readTitle(catalogue->entries + count);
+
+	}
+
+	// Creating the file changes the time of its directory, so that has to be
+	// done before the time is found. Writing it again leaves the time alone.
+	if (!hasFile(CATALOGUE_FILE)) catalogue->save(0);
+
+	catalogue->save(getPathsTime());
+
+	return;
+
+}
+
+
+/**
+ * Start making the catalogue in the background. Must be called once the paths
+ * have been indexed.
+ */
+void LevelCatalogue::start () {
+
+	if (building) return;
+
+	// Without worker threads, the catalogue is made now
+	jobs.prepare(&job, build, this, NULL, true);
+	jobs.submit(&job);
+
+	building = true;
+
+	return;
+
+}
+
+
+/**
+ * Wait for the catalogue to be made.
+ */
+void LevelCatalogue::finish () {
+
+	if (!building) return;
+
+	jobs.wait(&job);
+
+	building = false;
+
+	return;
+
+}
+
+
+/**
+ * Find how many levels are in the catalogue.
+ *
+ * @return Number of levels
+ */
+int LevelCatalogue::getLevels () {
+
+	return nEntries;
+
+}
+
+
+/**
+ * Find a level's file name.
+ *
+ * @param level The level's position in the catalogue
+ *
+ * @return The file name
+ */
+const char* LevelCatalogue::getFileName (int level) {
+
+	return entries[level].fileName;
+
+}
+
+
+/**
+ * Find a level's title.
+ *
+ * @param level The level's position in the catalogue
+ *
+ * @return The title
+ */
+const char* LevelCatalogue::getTitle (int level) {
+
+	return entries[level].title;
+
+}
+
+
+/**
+ * Find a level's type.
+ *
+ * @param level The level's position in the catalogue
+ *
+ * @return The type
+ */
+LevelType LevelCatalogue::getType (int level) {
+
+	return entries[level].type;
+
+}
+
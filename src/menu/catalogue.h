@@ -0,0 +1,90 @@
+
+/**
+ *
+ * @file catalogue.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created catalogue.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * The levels which can be played, found in the background at start-up so that
+ * the menus can list them without waiting for the file system.
+ *
+ */
+
+
+#ifndef _CATALOGUE_H
+#define _CATALOGUE_H
+
+
+#include "level/level.h"
+#include "jobs.h"
+#include "OpenJazz.h"
+
+
+// Constants
+
+#define CATALOGUE_LEVELS  256 /* Most levels listed */
+#define CATALOGUE_TITLE   32 /* Most characters in each level's title */
+#define CATALOGUE_PAGE    8 /* Levels shown on each page of the menu */
+#define CATALOGUE_FILE    "levels.ojc" /* Where the catalogue is kept between runs */
+#define CATALOGUE_VERSION 1 /* Changed whenever the catalogue file's layout changes */
+
+
+// Datatype
+
+/// A level which can be played
+typedef struct {
+
+	char      fileName[FILE_NAME_LENGTH]; ///< The level's file name, in lower case
+	char      title[CATALOGUE_TITLE + 1]; ///< The level's title
+	LevelType type; ///< The level's type
+
+} CatalogueEntry;
+
+
+// Class
+
+/// The levels found in the paths. Built by a background job, so finish() must
+/// be called before anything else is read.
+class LevelCatalogue {
+
+	private:
+		CatalogueEntry entries[CATALOGUE_LEVELS]; ///< The levels, in order of file name
+		int            nEntries; ///< Number of levels
+		Job            job; ///< Job building the catalogue
+		bool           building; ///< Whether or not the job has been submitted and not waited for
+
+		static void build     (void* data);
+		static void addEntry  (const char* name, void* data);
+		bool        load      (int pathsTime);
+		void        readTitle (CatalogueEntry* entry);
+		void        save      (int pathsTime);
+
+	public:
+		LevelCatalogue ();
+
+		void        start       ();
+		void        finish      ();
+		int         getLevels   ();
+		const char* getFileName (int level);
+		const char* getTitle    (int level);
+		LevelType   getType     (int level);
+
+};
+
+
+// Variable
+
+EXTERN LevelCatalogue catalogue; ///< The levels which can be played
+
+#endif
+
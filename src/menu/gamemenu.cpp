@@ -24,6 +24,7 @@
 
 
 #include "menu.h"
+#include "catalogue.h"
 
 #include "game/game.h"
 #include "game/gamemode.h"
@@ -32,15 +33,18 @@
 #include "io/gfx/video.h"
 #include "io/sound.h"
 #include "loop.h"
+#include "pacer.h"
+#include "residency.h"
+#include "setup.h"
 #include "util.h"
 
 
 /**
- * Create the game menu.
+ * Load the difficulty and episode images.
  *
- * @param file File containing menu graphics
+ * @param file File containing menu graphics, positioned at the images
  */
-GameMenu::GameMenu (File *file) {
+void GameMenu::loadImages (File *file) {
 
 	unsigned char pixel;
 	int count, col;
@@ -55,9 +59,6 @@ GameMenu::GameMenu (File *file) {
 	SDL_SetColorKey(difficultyScreen, SDL_SRCCOLORKEY, 0);
 	#endif
 
-	// Default difficulty setting
-	difficulty = 1;
-
 
 	// Load the episode pictures (max. 10 episodes + bonus level)
 
@@ -102,15 +103,86 @@ GameMenu::GameMenu (File *file) {
 
 
 /**
- * Delete the game menu.
+ * Free the difficulty and episode images while a level runs.
+ *
+ * @param data The game menu
  */
-GameMenu::~GameMenu () {
+void GameMenu::releaseImages (void* data) {
 
+	GameMenu* menu;
 	int count;
 
-	for (count = 0; count < 11; count++) SDL_FreeSurface(episodeScreens[count]);
+	menu = (GameMenu *)data;
 
-	SDL_FreeSurface(difficultyScreen);
+	for (count = 0; count < 11; count++) freeSurface(menu->episodeScreens[count]);
+
+	freeSurface(menu->difficultyScreen);
+
+	return;
+
+}
+
+
+/**
+ * Load the difficulty and episode images again.
+ *
+ * @param data The game menu
+ *
+ * @return Error code
+ */
+int GameMenu::reloadImages (void* data) {
+
+	GameMenu* menu;
+	File* file;
+
+	menu = (GameMenu *)data;
+
+	try {
+
+		file = new File("MENU.000", false);
+
+	} catch (int e) {
+
+		return e;
+
+	}
+
+	file->seek(menu->fileOffset, true);
+	menu->loadImages(file);
+
+	delete file;
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Create the game menu.
+ *
+ * @param file File containing menu graphics
+ */
+GameMenu::GameMenu (File *file) {
+
+	// Default difficulty setting
+	difficulty = 1;
+
+	fileOffset = file->tell();
+	loadImages(file);
+
+	resident = residency.add("game menu", releaseImages, reloadImages, this);
+
+	return;
+
+}
+
+
+/**
+ * Delete the game menu.
+ */
+GameMenu::~GameMenu () {
+
+	if (residency.remove(resident)) releaseImages(this);
 
 	return;
 
@@ -136,7 +208,7 @@ int GameMenu::playNewGame (GameModeType mode, char* firstLevel) {
 
 		try {
 
-			game = new LocalGame(firstLevel, difficulty);
+			game = new LocalGame(firstLevel, difficulty, setup.localPlayers);
 
 		} catch (int e) {
 
@@ -236,7 +308,10 @@ int GameMenu::newGameDifficulty (GameModeType mode, char* firstLevel) {
 
 		}
 
-		SDL_Delay(T_MENU_FRAME);
+		pacer.idle(true);
+
+		// The images are released while levels run
+		if (residency.use(resident) < 0) return E_FILE;
 
 		video.clearScreen(0);
 
@@ -261,7 +336,7 @@ int GameMenu::newGameDifficulty (GameModeType mode, char* firstLevel) {
 		src.h = 100;
 		dst.x = (canvasW >> 1) - 40;
 		dst.y = (canvasH >> 1) - 50;
-		SDL_SetPaletteColors(difficultyScreen->format->palette, canvas->format->palette->colors, 0, 256);
+		video.syncSurfacePalette(difficultyScreen);
 		SDL_BlitSurface(difficultyScreen, &src, canvas, &dst);
 
 		showEscString();
@@ -368,7 +443,7 @@ int GameMenu::loadGame () {
 		}
 
 
-		SDL_Delay(T_MENU_FRAME);
+		pacer.idle(true);
 
 		video.clearScreen(15);
 
@@ -395,7 +470,8 @@ int GameMenu::loadGame () {
 
 
 /**
- * Run the new game level selection menu.
+ * Run the new game level selection menu, listing the levels found in the
+ * paths before falling back to typing a file name.
  *
  * @param mode Game mode
  *
@@ -403,8 +479,64 @@ int GameMenu::loadGame () {
  */
 int GameMenu::newGameLevel (GameModeType mode) {
 
+	const char* options[CATALOGUE_PAGE + 2];
+	const char* files[CATALOGUE_PAGE + 2];
 	char* fileName;
-	int ret;
+	int levels, page, shown, count, chosen, ret;
+
+	// The levels have been listed in the background since start-up
+	catalogue.finish();
+	levels = catalogue.getLevels();
+
+	page = chosen = 0;
+
+	while (levels) {
+
+		for (shown = 0; (shown < CATALOGUE_PAGE) && (page + shown < levels); shown++) {
+
+			options[shown] = catalogue.getTitle(page + shown);
+			files[shown] = catalogue.getFileName(page + shown);
+
+		}
+
+		count = shown;
+
+		if (levels > CATALOGUE_PAGE) {
+
+			options[count] = "more levels";
+			files[count++] = NULL;
+
+		}
+
+		options[count] = "type a file name";
+		files[count++] = NULL;
+
+		ret = generic(options, count, chosen, files);
+
+		if (ret < 0) return ret;
+
+		if (chosen < shown) {
+
+			fileName = createString(catalogue.getFileName(page + chosen));
+			ret = newGameDifficulty(mode, fileName);
+			delete[] fileName;
+
+			if (ret < 0) return ret;
+
+		} else if (chosen == count - 1) {
+
+			break;
+
+		} else {
+
+			page += CATALOGUE_PAGE;
+			if (page >= levels) page = 0;
+
+			chosen = 0;
+
+		}
+
+	}
 
 	fileName = createString("level0.000");
 
@@ -482,10 +614,12 @@ int GameMenu::newGameEpisode (GameModeType mode) {
 		"episode 4", "episode 5", "episode 6", "episode a", "episode b",
 		"episode c", "episode x", "bonus stage", "specific level"};
 	bool exists[12];
-	char *check;
+	char files[10][FILE_NAME_LENGTH];
 	SDL_Rect dst;
 	int episode, count, x, y;
 
+	if (residency.use(resident) < 0) return E_FILE;
+
 	video.setPalette(palette);
 	//video.setPalette(palette);
 
@@ -495,18 +629,12 @@ int GameMenu::newGameEpisode (GameModeType mode) {
 		else if ((count >= 6) && (count < 9)) x = (count + 4) * 3;
 		else x = 50;
 
-		check = createFileName("LEVEL", 0, x);
-		exists[count] = fileExists(check);
-		delete[] check;
+		writeFileName(files[count], FILE_NAME_LENGTH, "LEVEL", 0, x);
+		exists[count] = fileExists(files[count]);
 
-		if (exists[count]) 
-		SDL_SetPaletteColors(episodeScreens[count]->format->palette, canvas->format->palette->colors, 0, 256);
-		#ifdef SDL2
-		else {
-			SDL_SetPaletteColors (episodeScreens[count]->format->palette, canvas->format->palette->colors, 0, 256);
-		}
-		#else
-		else SDL_SetPalette(episodeScreens[count], SDL_LOGPAL, greyPalette, 0, 256);
+		// With SDL2, the screens are given the canvas's palette when drawn
+		#ifndef SDL2
+		if (!exists[count]) SDL_SetPalette(episodeScreens[count], SDL_LOGPAL, greyPalette, 0, 256);
 		#endif // SDL2
 	}
 
@@ -565,8 +693,12 @@ int GameMenu::newGameEpisode (GameModeType mode) {
 
 		}
 
+		// Start loading the highlighted episode's first level
+		prefetchLevel(((episode < 10) && exists[episode])? files[episode]: NULL);
+
+		pacer.idle(true);
 
-		SDL_Delay(T_MENU_FRAME);
+		if (residency.use(resident) < 0) return E_FILE;
 
 		video.clearScreen(0);
 
@@ -575,12 +707,12 @@ int GameMenu::newGameEpisode (GameModeType mode) {
 
 		if ((episode < episodes - 1) || (episode < 6)) {
             
-			SDL_SetPaletteColors(episodeScreens[episode]->format->palette, canvas->format->palette->colors, 0, 256);
+			video.syncSurfacePalette(episodeScreens[episode]);
 			SDL_BlitSurface(episodeScreens[episode], NULL, canvas, &dst);
 
 		} else if ((episode == 10) && (episodes > 6)) {
 
-	        SDL_SetPaletteColors(episodeScreens[episodes - 1]->format->palette, canvas->format->palette->colors, 0, 256);
+			video.syncSurfacePalette(episodeScreens[episodes - 1]);
 			SDL_BlitSurface(episodeScreens[episodes - 1], NULL, canvas, &dst);
 
 		}
@@ -638,7 +770,7 @@ int GameMenu::joinGame () {
 
 	try {
 
-		game = new ClientGame(netAddress);
+		game = new ClientGame(netAddress, false);
 
 	} catch (int e) {
 
@@ -33,15 +33,20 @@
 #include "io/gfx/font.h"
 #include "jj1scene/jj1scene.h"
 #include "loop.h"
+#include "pacer.h"
+#include "residency.h"
 #include "util.h"
 
 #include <time.h>
 
 
 /**
- * Create the main menu.
+ * Load the OpenJazz logo and the main menu's images.
+ *
+ * @return The file containing the menu graphics, positioned after the main
+ * menu's images
  */
-MainMenu::MainMenu () {
+File* MainMenu::loadImages () {
 
 	File *file;
 	time_t currentTime;
@@ -72,7 +77,7 @@ MainMenu::MainMenu () {
 
 	} catch (int e) {
 
-		SDL_FreeSurface(logo);
+		freeSurface(logo);
 
 		throw e;
 
@@ -115,6 +120,9 @@ MainMenu::MainMenu () {
 	}
 
 #ifdef SDL2
+	video.ownSurfacePalette(logo);
+	video.ownSurfacePalette(background);
+	video.ownSurfacePalette(highlight);
     SDL_SetPaletteColors(logo->format->palette, palette, 0, 256);
 	SDL_SetPaletteColors(background->format->palette, palette, 0, 256);
 	SDL_SetPaletteColors(highlight->format->palette, palette, 0, 256);
@@ -128,10 +136,76 @@ MainMenu::MainMenu () {
 	SDL_SetColorKey(logo, SDL_SRCCOLORKEY, 28);
 #endif // SDL2
 
+	return file;
+
+}
+
+
+/**
+ * Free the main menu's images while a level runs.
+ *
+ * @param data The main menu
+ */
+void MainMenu::releaseImages (void* data) {
+
+	MainMenu* menu;
+
+	menu = (MainMenu *)data;
+
+	freeSurface(menu->background);
+	freeSurface(menu->highlight);
+	freeSurface(menu->logo);
+
+	return;
+
+}
+
+
+/**
+ * Load the main menu's images again.
+ *
+ * @param data The main menu
+ *
+ * @return Error code
+ */
+int MainMenu::reloadImages (void* data) {
+
+	File* file;
+
+	try {
+
+		file = ((MainMenu *)data)->loadImages();
+
+	} catch (int e) {
+
+		return e;
+
+	}
+
+	delete file;
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Create the main menu.
+ */
+MainMenu::MainMenu () {
+
+	File *file;
+
+	file = loadImages();
+
 	gameMenu = new GameMenu(file);
 
 	delete file;
 
+	resident = residency.add("main menu", releaseImages, reloadImages, this);
+
+	demoGame = NULL;
+
 	return;
 
 }
@@ -142,9 +216,9 @@ MainMenu::MainMenu () {
  */
 MainMenu::~MainMenu () {
 
-	SDL_FreeSurface(background);
-	SDL_FreeSurface(highlight);
-	SDL_FreeSurface(logo);
+	dropDemo();
+
+	if (residency.remove(resident)) releaseImages(this);
 
 	delete gameMenu;
 
@@ -153,6 +227,19 @@ MainMenu::~MainMenu () {
 }
 
 
+/**
+ * Delete the game playing the demos, along with the demo level it kept.
+ */
+void MainMenu::dropDemo () {
+
+	if (demoGame) delete demoGame;
+	demoGame = NULL;
+
+	return;
+
+}
+
+
 /**
  * Process a main menu selection.
  *
@@ -165,6 +252,9 @@ int MainMenu::select (int option) {
 	JJ1Scene *scene;
 	SetupMenu setupMenu;
 
+	// Other games take the players and event pools the demo level uses
+	dropDemo();
+
 	playSound(S_ORB);
 
 	switch (option) {
@@ -371,19 +461,21 @@ int MainMenu::main () {
 
 		if (idleTime <= globalTicks) {
 
-			Game* game = NULL;
+			if (!demoGame) {
 
-			try {
+				try {
 
-				game = new LocalGame("", 0);
+					demoGame = new LocalGame("", 0, 1);
 
-			} catch (int e) {
+				} catch (int e) {
+
+					// Do nothing
 
-				// Do nothing
+				}
 
 			}
 
-			if (game) {
+			if (demoGame) {
 
 				// Load the macro
 
@@ -398,10 +490,9 @@ int MainMenu::main () {
 					fileName = createString("MACRO.1");
 					fileName[6] += macro;
 
-					if (game->playLevel(fileName) == E_QUIT) {
+					if (demoGame->playLevel(fileName) == E_QUIT) {
 
 						delete[] fileName;
-						delete game;
 
 						return E_QUIT;
 
@@ -411,9 +502,6 @@ int MainMenu::main () {
 
 				}
 
-
-				delete game;
-
 				playMusic("MENUSNG.PSM");
 
 				// Restore the main menu palette
@@ -425,7 +513,10 @@ int MainMenu::main () {
 
 		}
 
-		SDL_Delay(T_MENU_FRAME);
+		pacer.idle(true);
+
+		// The images are released while levels run
+		if (residency.use(resident) < 0) return E_FILE;
 
 
 		//as long as we're drawing plasma, we don't need to clear the screen.
@@ -29,16 +29,34 @@
 
 #include "menu.h"
 
+#include "io/assetcache.h"
 #include "io/controls.h"
 #include "io/gfx/font.h"
 #include "io/gfx/video.h"
 #include "io/sound.h"
+#include "jj1level/jj1level.h"
+#include "jj2level/jj2level.h"
 #include "loop.h"
+#include "pacer.h"
 #include "util.h"
 
 #include <string.h>
 
 
+/**
+ * Create a menu, with no level highlighted.
+ */
+Menu::Menu () {
+
+	prefetchFile[0] = 0;
+	prefetchTime = 0;
+	prefetching = false;
+
+	return;
+
+}
+
+
 /**
  * Show the "(Minus) quits" string.
  */
@@ -79,7 +97,7 @@ int Menu::message (const char* text) {
 		if (controls.release(C_ENTER) || controls.release(C_ESCAPE) || controls.wasCursorReleased())
 			return E_NONE;
 
-		SDL_Delay(T_MENU_FRAME);
+		pacer.idle(true);
 
 		video.clearScreen(15);
 
@@ -94,16 +112,67 @@ int Menu::message (const char* text) {
 }
 
 
+/**
+ * Preload the assets of the level the user has highlighted, such as its tile
+ * set and music, so that it starts quickly if chosen. Called every frame.
+ * Nothing is preloaded until the level has been highlighted for a moment, and
+ * moving to something else cancels any preloading.
+ *
+ * @param fileName The level's file name, or NULL if no level is highlighted
+ */
+void Menu::prefetchLevel (const char* fileName) {
+
+	int length;
+
+	if (!fileName) fileName = "";
+
+	if (strcmp(fileName, prefetchFile)) {
+
+		// The level highlighted before is no longer needed
+		if (prefetching) assetCache.cancelPreload();
+
+		prefetching = false;
+		prefetchTime = globalTicks;
+
+		if (strlen(fileName) < FILE_NAME_LENGTH) strcpy(prefetchFile, fileName);
+		else prefetchFile[0] = 0;
+
+		return;
+
+	}
+
+	if (!prefetchFile[0] || prefetching || (globalTicks < prefetchTime + T_PREFETCH)) return;
+
+	// Wait for any cancelled preloading to stop, rather than for its files
+	if (assetCache.isPreloading()) return;
+
+	// Only JJ2 levels end in .j2l
+	length = strlen(prefetchFile);
+
+	if ((length > 4) && (!strcmp(prefetchFile + length - 4, ".j2l") || !strcmp(prefetchFile + length - 4, ".J2L")))
+		assetCache.preload(JJ2Level::preload, prefetchFile);
+	else
+		assetCache.preload(JJ1Level::preload, prefetchFile);
+
+	prefetching = true;
+
+	return;
+
+}
+
+
 /**
  * Let the user select from a menu of the given options.
  *
  * @param optionNames Array of option names
  * @param options The number of options (and size of the names array)
  * @param chosen Which option is selected
+ * @param optionFiles Array of the level file each option would start, each
+ * preloaded while its option is highlighted, or NULL
  *
  * @return Error code
  */
-int Menu::generic (const char** optionNames, int options, int& chosen) {
+int Menu::generic (const char** optionNames, int options, int& chosen, const char** optionFiles) {
 
 	int x, y, count;
 
@@ -150,7 +219,9 @@ int Menu::generic (const char** optionNames, int options, int& chosen) {
 
 		}
 
-		SDL_Delay(T_MENU_FRAME);
+		if (optionFiles) prefetchLevel(optionFiles[chosen]);
+
+		pacer.idle(true);
 
 		video.clearScreen(0);
 
@@ -260,7 +331,7 @@ int Menu::textInput (const char* request, char*& text) {
 		}
 
 
-		SDL_Delay(T_MENU_FRAME);
+		pacer.idle(true);
 
 		video.clearScreen(15);
 
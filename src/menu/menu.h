@@ -36,16 +36,27 @@
 // Demo timeout
 #define T_DEMO 20000
 
+// Time a level is highlighted before its assets are preloaded
+#define T_PREFETCH 250
+
 
 // Classes
 
 /// Menu base class, providing generic menu screens
 class Menu {
 
+	private:
+		char         prefetchFile[FILE_NAME_LENGTH]; ///< Level file highlighted, or empty
+		unsigned int prefetchTime; ///< When the level file was highlighted
+		bool         prefetching; ///< Whether or not the level's assets have been sent to the preloader
+
 	protected:
+		Menu ();
+
 		void showEscString ();
 		int  message       (const char* text);
-		int  generic       (const char** optionNames, int options, int& chosen);
+		void prefetchLevel (const char* fileName);
+		int  generic       (const char** optionNames, int options, int& chosen, const char** optionFiles = NULL);
 		int  textInput     (const char* request, char*& text);
 
 };
@@ -60,6 +71,12 @@ class GameMenu : public Menu {
 		SDL_Color     greyPalette[256]; ///< Greyed-out episode selection palette
 		int           episodes; ///< Number of episodes
 		unsigned char difficulty; ///< Difficulty setting (0 = easy, 1 = medium, 2 = hard, 3 = turbo (hard in JJ2 levels))
+		int           fileOffset; ///< Position of the images in the menu graphics file
+		int           resident; ///< Residency of the images
+
+		void        loadImages    (File* file);
+		static void releaseImages (void* data);
+		static int  reloadImages  (void* data);
 
 		int playNewGame       (GameModeType mode, char* firstLevel);
 		int newGameDifficulty (GameModeType mode, char* firstLevel);
@@ -103,9 +120,15 @@ class MainMenu : public Menu {
 		SDL_Surface* highlight; ///< Menu image with highlighted text
 		SDL_Surface* logo; ///< OJ logo image
 		GameMenu*    gameMenu; ///< New game menu
+		Game*        demoGame; ///< Game playing the demos, kept with the last demo level played, or NULL
 		SDL_Color    palette[256]; ///< Menu palette
+		int          resident; ///< Residency of the images
 
-		int select (int option);
+		File*       loadImages    ();
+		static void releaseImages (void* data);
+		static int  reloadImages  (void* data);
+		void        dropDemo      ();
+		int         select        (int option);
 
 	public:
 		MainMenu  ();
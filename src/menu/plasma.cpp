@@ -22,6 +22,7 @@
 
 #include "plasma.h"
 
+#include "fixedmath.h"
 #include "level/level.h"
 #include "util.h"
 #include "io/gfx/video.h"
@@ -33,6 +34,10 @@
 #include <SDL.h>
 #endif
 
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	#include <arm_neon.h>
+#endif
+
 
 /**
  * Create the plasma.
@@ -44,10 +49,22 @@ Plasma::Plasma(){
 	p2=0;
 	p3=0;
 
+	columns = NULL;
+	nColumns = 0;
+
 	//fSin, fCos: pi = 512
 	// -1024 < out < 1024
 }
 
+/**
+ * Delete the plasma.
+ */
+Plasma::~Plasma(){
+
+	delete[] columns;
+
+}
+
 /**
  * Draw the plasma.
  *
@@ -59,8 +76,10 @@ int Plasma::draw(){
 	int t1,t2,t3,t4;
 	int w,h,pitch;
 	unsigned char *px;
-	unsigned char colour;
-	unsigned int colb;
+	unsigned short int colb;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	uint16x8_t vColb, vMask;
+#endif
 
 	// draw plasma
 
@@ -72,20 +91,46 @@ int Plasma::draw(){
 
 	px = (unsigned char *)canvas->pixels;
 
+	if (w > nColumns) {
+
+		delete[] columns;
+		columns = new unsigned short int[w];
+		nColumns = w;
+
+	}
+
+	// The column terms are the same for every row, so find them once.
+	// Only the bottom 14 bits of each sum affect the colour, so sums are
+	// kept to 16 bits and allowed to wrap.
+    t3 = p2;
+    t4 = p3;
+	for(x=0;x<w;x++){
+
+		columns[x] = (fCos(t3*4)<<3)+(fCos(t4*4)<<3);
+
+		t3 += 3;
+		t4 += 2;
+	}
+
+#if defined(__ARM_NEON) && defined(__aarch64__)
+	vMask = vdupq_n_u16(0xF);
+#endif
+
     t1 = p0;
     t2 = p1;
     for(y=0;y<h;y++){
-        t3 = p2;
-        t4 = p3;
 		colb = (fCos(t1*4)<<3)+(fCos(t2*4)<<3)+(32<<10);
-        for(x=0;x<w;x++){
-
-			colour = ((colb+(fCos(t3*4)<<3)+(fCos(t4*4)<<3))>>10) & 0xF;
+		x = 0;
+#if defined(__ARM_NEON) && defined(__aarch64__)
+		vColb = vdupq_n_u16(colb);
+		for(;x+8<=w;x+=8){
 
-            t3 += 3;
-            t4 += 2;
+			vst1_u8(px + x, vmovn_u16(vandq_u16(vshrq_n_u16(vaddq_u16(vColb, vld1q_u16(columns + x)), 10), vMask)));
+		}
+#endif
+        for(;x<w;x++){
 
-            px[x] = colour;
+			px[x] = ((unsigned short int)(colb + columns[x]) >> 10) & 0xF;
 		}
 		// go to next row
 		px += pitch;
@@ -24,9 +24,12 @@ class Plasma {
 
 	private:
 		int p0,p1,p2,p3;
+		unsigned short int* columns; ///< Each column's share of the colour, for the current frame
+		int                 nColumns; ///< Number of columns the table can hold
 
 	public:
 		Plasma ();
+		~Plasma ();
 
 		int draw();
 
@@ -32,6 +32,7 @@
 #include "io/sound.h"
 #include "player/player.h"
 #include "loop.h"
+#include "pacer.h"
 #include "setup.h"
 #include "util.h"
 
@@ -91,7 +92,7 @@ int SetupMenu::setupKeyboard () {
 		}
 
 
-		SDL_Delay(T_MENU_FRAME);
+		pacer.idle(true);
 
 		video.clearScreen(0);
 
@@ -286,7 +287,7 @@ int SetupMenu::setupJoystick () {
 			controls.wasCursorReleased())) return E_NONE;
 
 
-		SDL_Delay(T_MENU_FRAME);
+		pacer.idle(true);
 
 		video.clearScreen(0);
 
@@ -362,7 +363,7 @@ int SetupMenu::setupResolution () {
 
 		}
 
-		SDL_Delay(T_MENU_FRAME);
+		pacer.idle(true);
 
 		video.clearScreen(0);
 
@@ -496,7 +497,7 @@ int SetupMenu::setupScaling () {
 			(x >= 32) && (x < 132) && (y >= canvasH - 12) &&
 			controls.wasCursorReleased()) return E_NONE;
 
-		SDL_Delay(T_MENU_FRAME);
+		pacer.idle(true);
 
 		video.clearScreen(0);
 
@@ -585,7 +586,7 @@ int SetupMenu::setupSound () {
 
 		}
 
-		SDL_Delay(T_MENU_FRAME);
+		pacer.idle(true);
 
 		video.clearScreen(0);
 
@@ -641,13 +642,15 @@ int SetupMenu::setupSound () {
  */
 int SetupMenu::setupMain () {
 
-	const char* setupOptions[7] = {"character", "keyboard", "joystick", "resolution", "scaling", "sound", "gameplay"};
+	const char* setupOptions[8] = {"character", "keyboard", "joystick", "resolution", "scaling", "frame rate", "sound", "gameplay"};
 	const char* setupCharacterOptions[5] = {"name", "fur", "bandana", "gun", "wristband"};
 	const char* setupCharacterColOptions[8] = {"white", "red", "orange", "yellow", "green", "blue", "animation 1", "animation 2"};
 	const unsigned char setupCharacterCols[8] = {PC_GREY, PC_RED, PC_ORANGE, PC_YELLOW, PC_LGREEN, PC_BLUE, PC_SANIM, PC_LANIM};
-	const char* setupModsOff[3] = {"slow motion off", "take extra items", "one-bird limit"};
-	const char* setupModsOn[3] = {"slow motion on", "leave extra items", "unlimited birds"};
-	const char* setupMods[3];
+	const char* setupModsOff[4] = {"slow motion off", "take extra items", "one-bird limit", "rollback off"};
+	const char* setupModsOn[4] = {"slow motion on", "leave extra items", "unlimited birds", "rollback on"};
+	const char* setupMods[4];
+	const char* setupScaleModes[3] = {"fill the screen", "whole multiples", "dynamic resolution"};
+	const char* setupPaceTargets[PACE_TARGETS] = {"vsync", "30 fps", "60 fps", "120 fps", "uncapped"};
 	int ret;
 	int option, suboption, subsuboption;
 
@@ -656,14 +659,23 @@ int SetupMenu::setupMain () {
 	setupMods[0] = (setup.slowMotion? setupModsOn[0]: setupModsOff[0]);
 	setupMods[1] = (setup.leaveUnneeded? setupModsOn[1]: setupModsOff[1]);
 	setupMods[2] = (setup.manyBirds? setupModsOn[2]: setupModsOff[2]);
+	setupMods[3] = (setup.rollback? setupModsOn[3]: setupModsOff[3]);
 
 	video.setPalette(menuPalette);
 
 	while (true) {
 
-		ret = generic(setupOptions, 7, option);
+		ret = generic(setupOptions, 8, option);
+
+		if (ret == E_RETURN) {
+
+			// Every change made in the menu is written at once
+			setup.save();
+
+			return E_NONE;
+
+		}
 
-		if (ret == E_RETURN) return E_NONE;
 		if (ret < 0) return ret;
 
 		switch (option) {
@@ -739,6 +751,25 @@ int SetupMenu::setupMain () {
 
 #ifdef SCALE
 				if (setupScaling() == E_QUIT) return E_QUIT;
+#elif defined(SDL2)
+				// The canvas stays as it is, and is enlarged as it is shown
+				if (video.isIntegerScale()) suboption = 1;
+				else suboption = video.isDynamicResolution()? 2: 0;
+
+				ret = generic(setupScaleModes, 3, suboption);
+
+				if (ret == E_QUIT) return E_QUIT;
+
+				if (ret == E_NONE) {
+
+					// Dynamic resolution fills the screen, from a canvas which
+					// shrinks in levels when frames take too long
+					setup.integerScale = (suboption == 1);
+					setup.dynamicResolution = (suboption == 2);
+					video.setIntegerScale(setup.integerScale);
+					video.setDynamicResolution(setup.dynamicResolution);
+
+				}
 #else
 				if (message("FEATURE NOT AVAILABLE") == E_QUIT) return E_QUIT;
 #endif
@@ -747,17 +778,33 @@ int SetupMenu::setupMain () {
 
 			case 5:
 
-				if (setupSound() == E_QUIT) return E_QUIT;
+				suboption = setup.paceTarget;
+				ret = generic(setupPaceTargets, PACE_TARGETS, suboption);
+
+				if (ret == E_QUIT) return E_QUIT;
+
+				if (ret == E_NONE) {
+
+					setup.paceTarget = (PaceTarget)suboption;
+					pacer.setTarget(setup.paceTarget);
+
+				}
 
 				break;
 
 			case 6:
 
+				if (setupSound() == E_QUIT) return E_QUIT;
+
+				break;
+
+			case 7:
+
 				suboption = 0;
 
 				while (true) {
 
-					ret = generic(setupMods, 3, suboption);
+					ret = generic(setupMods, 4, suboption);
 
 					if (ret == E_QUIT) return E_QUIT;
 					if (ret < 0) break;
@@ -770,6 +817,7 @@ int SetupMenu::setupMain () {
 					setup.slowMotion = (setupMods[0] == setupModsOn[0]);
 					setup.leaveUnneeded = (setupMods[1] == setupModsOn[1]);
 					setup.manyBirds = (setupMods[2] == setupModsOn[2]);
+					setup.rollback = (setupMods[3] == setupModsOn[3]);
 
 				}
 
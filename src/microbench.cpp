@@ -0,0 +1,948 @@
+
+/**
+ *
+ * @file microbench.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created microbench.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Times the hot kernels in isolation, on generated data and on the game's own
+ * data where it is available, and prints one line of JSON for each. Kernels
+ * with NEON versions are also checked against their C versions.
+ *
+ */
+
+
+#include "microbench.h"
+
+#include "game/game.h"
+#include "io/file.h"
+#include "io/gfx/blitter.h"
+#include "io/gfx/paletteeffects.h"
+#include "io/gfx/sprite.h"
+#include "io/gfx/video.h"
+#include "io/psmplug.h"
+#include "io/sound.h"
+#include "jj1level/jj1level.h"
+#include "jj2level/jj2level.h"
+#include "level/arena.h"
+#include "level/rewind.h"
+#include "menu/plasma.h"
+#include "clock.h"
+#include "util.h"
+#include "miniz.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/// A kernel to time, taking its data
+typedef void (*Kernel) (void* data);
+
+/// Data for decoding kernels
+typedef struct {
+
+	File*          file; ///< File holding the encoded data
+	unsigned char* encoded; ///< The encoded data, for decoders reading it directly
+	unsigned char* buffer; ///< Buffer for the decoded data
+	int            compressedLength; ///< Length of the encoded data
+	int            length; ///< Length of the decoded data
+
+} DecodeData;
+
+/// Data for the palette expansion kernel
+typedef struct {
+
+	unsigned char* pixels; ///< Palette indices
+	Uint32*        row; ///< Expanded row
+	Uint32         lut[256]; ///< Colour of each palette index
+	int            width; ///< Pixels in each row
+	int            height; ///< Number of rows
+
+} ExpandData;
+
+/// Data for the palette effect kernel
+typedef struct {
+
+	PaletteEffect* effects; ///< Chain of effects
+	SDL_Color      palette[256]; ///< Palette the effects are applied to
+
+} PaletteData;
+
+/// Data for the audio kernel
+typedef struct {
+
+	unsigned char* stream; ///< Buffer for the mixed audio
+	int            voices; ///< Number of clips to keep playing
+	int            length; ///< Length of the buffer, in bytes
+
+} AudioData;
+
+/// Data for the JJ2 layer drawing kernel
+typedef struct {
+
+	JJ2Layer*  layer; ///< Layer to draw
+	BlitImage* tileImages; ///< Prepared tiles
+	SDL_Rect   band; ///< Band of the canvas to draw, covering all of it
+
+} LayerData;
+
+/// Data for the JJ2 sprite decoding kernel
+typedef struct {
+
+	unsigned char* parameters; ///< Sprite parameters, as in anims.j2a
+	unsigned char* compressed; ///< Compressed sprite pixels
+	unsigned char* pixels; ///< Space for the decoded pixels
+	Sprite         sprite; ///< Sprite receiving the decoded pixels
+	Sprite         flippedSprite; ///< Mirror of the sprite
+
+} SpriteData;
+
+
+/**
+ * Get the time in nanoseconds, from the microsecond clock. Multiplying the
+ * performance counter itself soon overflows.
+ *
+ * @return The time
+ */
+static unsigned long long getNanoseconds () {
+
+	return getClock() * 1000ULL;
+
+}
+
+
+/**
+ * Time a kernel, and print the result. The kernel is run repeatedly for at
+ * least MICROBENCH_TIME in each trial, and the median trial is reported.
+ *
+ * @param name Name of the kernel
+ * @param dataName Name of the data the kernel runs on
+ * @param bytes Amount of data each run of the kernel handles
+ * @param kernel The kernel
+ * @param data The kernel's data
+ */
+static void runKernel (const char* name, const char* dataName, int bytes, Kernel kernel, void* data) {
+
+	unsigned long long trials[MICROBENCH_TRIALS];
+	unsigned long long start, time, swap;
+	int trial, count, iterations;
+
+	// Warm up, so the first trial is not paying for cold caches
+	kernel(data);
+
+	iterations = 0;
+
+	for (trial = 0; trial < MICROBENCH_TRIALS; trial++) {
+
+		start = getNanoseconds();
+		count = 0;
+
+		do {
+
+			kernel(data);
+			count++;
+			time = getNanoseconds() - start;
+
+		} while (time < MICROBENCH_TIME * 1000000ULL);
+
+		trials[trial] = time / count;
+		iterations += count;
+
+	}
+
+	// Sort the trials to find the median
+	for (trial = 1; trial < MICROBENCH_TRIALS; trial++) {
+
+		for (count = trial; (count > 0) && (trials[count - 1] > trials[count]); count--) {
+
+			swap = trials[count];
+			trials[count] = trials[count - 1];
+			trials[count - 1] = swap;
+
+		}
+
+	}
+
+	printf("{\"kernel\": \"%s\", \"data\": \"%s\", \"bytes\": %d, \"iterations\": %d, \"ns\": %llu}\n",
+		name, dataName, bytes, iterations, trials[MICROBENCH_TRIALS >> 1]);
+	fflush(stdout);
+
+	return;
+
+}
+
+
+/**
+ * Decode a block of RLE data.
+ *
+ * @param data The decoding data
+ */
+static void decodeRLE (void* data) {
+
+	DecodeData* decode;
+
+	decode = (DecodeData *)data;
+
+	decode->file->seek(0, true);
+	delete[] decode->file->loadRLE(decode->length);
+
+	return;
+
+}
+
+
+/**
+ * Decode a block of LZ data.
+ *
+ * @param data The decoding data
+ */
+static void decodeLZ (void* data) {
+
+	DecodeData* decode;
+
+	decode = (DecodeData *)data;
+
+	decode->file->seek(0, true);
+	decode->file->loadLZ(decode->compressedLength, decode->buffer, decode->length);
+
+	return;
+
+}
+
+
+/**
+ * Decode a block of LZ data with miniz's own decompressor, to compare with.
+ *
+ * @param data The decoding data
+ */
+static void decodeTinfl (void* data) {
+
+	DecodeData* decode;
+	tinfl_decompressor inflator;
+	size_t inLength, outLength;
+
+	decode = (DecodeData *)data;
+
+	inLength = decode->compressedLength;
+	outLength = decode->length;
+
+	tinfl_init(&inflator);
+	tinfl_decompress(&inflator, decode->encoded, &inLength, decode->buffer, decode->buffer, &outLength,
+		TINFL_FLAG_PARSE_ZLIB_HEADER | TINFL_FLAG_USING_NON_WRAPPING_OUTPUT_BUF);
+
+	return;
+
+}
+
+
+/**
+ * Generate level-like data: runs of repeated values between stretches of
+ * varied values.
+ *
+ * @param buffer Buffer to fill
+ * @param length Length of the buffer
+ */
+static void generateData (unsigned char* buffer, int length) {
+
+	unsigned int seed;
+	int pos, count;
+
+	seed = 1;
+	pos = 0;
+
+	while (pos < length) {
+
+		seed = (seed * 1103515245) + 12345;
+		count = ((seed >> 16) & 63) + 1;
+		if (count > length - pos) count = length - pos;
+
+		if (seed & 0x80000000) memset(buffer + pos, seed >> 8, count);
+		else for (; count; count--, pos++) buffer[pos] = (pos * 7) + (seed >> 24);
+
+		pos += count;
+
+	}
+
+	return;
+
+}
+
+
+/**
+ * Time RLE and LZ decoding.
+ */
+static void benchDecoding () {
+
+	DecodeData decode;
+	unsigned char* raw;
+	unsigned char* encoded;
+	mz_ulong encodedLength;
+	int pos, count;
+
+	decode.length = 64000;
+	raw = new unsigned char[decode.length];
+	generateData(raw, decode.length);
+
+	// RLE encode the data, with runs and literal stretches of up to 127 bytes
+	encoded = new unsigned char[2 + (decode.length << 1)];
+	encodedLength = 2;
+	pos = 0;
+
+	while (pos < decode.length) {
+
+		for (count = 1; (pos + count < decode.length) && (count < 127) && (raw[pos + count] == raw[pos]); count++);
+
+		if (count > 2) {
+
+			encoded[encodedLength++] = 128 | count;
+			encoded[encodedLength++] = raw[pos];
+
+		} else {
+
+			for (count = 1; (pos + count < decode.length) && (count < 127) && (raw[pos + count] != raw[pos + count - 1]); count++);
+
+			encoded[encodedLength++] = count;
+			memcpy(encoded + encodedLength, raw + pos, count);
+			encodedLength += count;
+
+		}
+
+		pos += count;
+
+	}
+
+	encoded[0] = (encodedLength - 2) & 255;
+	encoded[1] = (encodedLength - 2) >> 8;
+
+	decode.file = new File(encoded, encodedLength);
+	runKernel("rle", "synthetic", decode.length, decodeRLE, &decode);
+	delete decode.file;
+
+	delete[] encoded;
+
+
+	// RLE decode the panel, as each JJ1 level does
+	try {
+
+		decode.file = new File("PANEL.000", false);
+		decode.length = 46272;
+		runKernel("rle", "PANEL.000", decode.length, decodeRLE, &decode);
+		delete decode.file;
+
+	} catch (int e) {
+
+		// Do nothing
+
+	}
+
+
+	// Compress the data as JJ2 files are, then decompress it
+	decode.length = 64000;
+	encodedLength = mz_compressBound(decode.length);
+	encoded = new unsigned char[encodedLength];
+	mz_compress(encoded, &encodedLength, raw, decode.length);
+
+	decode.file = new File(encoded, encodedLength);
+	decode.encoded = encoded;
+	decode.buffer = new unsigned char[decode.length];
+	decode.compressedLength = encodedLength;
+	runKernel("lz", "synthetic", decode.length, decodeLZ, &decode);
+
+	// The decoded data must be exactly what was compressed
+	if (memcmp(decode.buffer, raw, decode.length)) log("LZ decoding does not match the original data");
+
+	runKernel("lz-tinfl", "synthetic", decode.length, decodeTinfl, &decode);
+	delete[] decode.buffer;
+	delete decode.file;
+
+	delete[] encoded;
+	delete[] raw;
+
+	return;
+
+}
+
+
+/**
+ * Check points across the level's mask, downwards then upwards.
+ *
+ * @param data Unused
+ */
+static void checkMasks (void* data) {
+
+	fixed x, y;
+	int hits;
+
+	(void)data;
+
+	hits = 0;
+
+	for (y = 0; y < TTOF(LH); y += ITOF(13))
+		for (x = 0; x < TTOF(LW); x += ITOF(29))
+			hits += level->checkMaskDown(x, y) + level->checkMaskUp(x, y);
+
+	// Keep the result, so the checks are not optimised away
+	if (hits < 0) log("Impossible mask result", hits);
+
+	return;
+
+}
+
+
+/**
+ * Time mask checks in a JJ1 level.
+ */
+static void benchMasks () {
+
+	Game* game;
+	char* fileName;
+
+	if (!fileExists("LEVEL0.000")) return;
+
+	fileName = createString("LEVEL0.000");
+
+	try {
+
+		game = new LocalGame(fileName, 0, 1);
+
+	} catch (int e) {
+
+		delete[] fileName;
+
+		return;
+
+	}
+
+	try {
+
+		level = new JJ1Level(game, fileName, false, false);
+
+	} catch (int e) {
+
+		level = NULL;
+
+	}
+
+	if (level) {
+
+		runKernel("mask", fileName, 2 * (TTOI(LW) / 29 + 1) * (TTOI(LH) / 13 + 1), checkMasks, NULL);
+
+		delete level;
+		level = NULL;
+
+	}
+
+	delete game;
+	delete[] fileName;
+
+	return;
+
+}
+
+
+#ifdef SDL2
+/**
+ * Expand a screen of palette indices, row by row.
+ *
+ * @param data The expansion data
+ */
+static void expandScreen (void* data) {
+
+	ExpandData* expand;
+	int y;
+
+	expand = (ExpandData *)data;
+
+	for (y = 0; y < expand->height; y++)
+		expandRow(expand->pixels + (expand->width * y), expand->row, expand->width, expand->lut);
+
+	return;
+
+}
+#endif
+
+
+/**
+ * Draw the menu's plasma to the canvas.
+ *
+ * @param data The plasma
+ */
+static void drawPlasma (void* data) {
+
+	((Plasma *)data)->draw();
+
+	return;
+
+}
+
+
+/**
+ * Apply a chain of palette effects.
+ *
+ * @param data The palette effect data
+ */
+static void applyEffects (void* data) {
+
+	PaletteData* effects;
+
+	effects = (PaletteData *)data;
+
+	effects->effects->apply(effects->palette, false, T_STEP, false);
+
+	return;
+
+}
+
+
+/**
+ * Time drawing and palette kernels.
+ */
+static void benchDrawing () {
+
+	PaletteData effects;
+	Plasma plasma;
+#ifdef SDL2
+	ExpandData expand;
+	int count;
+
+	expand.width = canvasW;
+	expand.height = canvasH;
+	expand.pixels = new unsigned char[expand.width * expand.height];
+	expand.row = new Uint32[expand.width];
+
+	generateData(expand.pixels, expand.width * expand.height);
+
+	for (count = 0; count < 256; count++) expand.lut[count] = count * 0x010101;
+
+	runKernel("expand", "synthetic", expand.width * expand.height, expandScreen, &expand);
+
+	delete[] expand.row;
+	delete[] expand.pixels;
+#endif
+
+	runKernel("plasma", "synthetic", canvasW * canvasH, drawPlasma, &plasma);
+
+	// A chain like a JJ1 level's, with a fade on top
+	memcpy(effects.palette, video.getPalette(), sizeof(effects.palette));
+	effects.effects = new FadeInPaletteEffect(1000000,
+		new RotatePaletteEffect(112, 16, F32,
+		new RotatePaletteEffect(240, 16, F16, NULL)));
+
+	runKernel("palette", "synthetic", 256, applyEffects, &effects);
+
+	delete effects.effects;
+
+	return;
+
+}
+
+
+/**
+ * Mix a buffer of audio, keeping the given number of clips playing.
+ *
+ * @param data The audio data
+ */
+static void mixAudio (void* data) {
+
+	AudioData* audio;
+	int count;
+
+	audio = (AudioData *)data;
+
+	for (count = 1; count <= audio->voices; count++)
+		if (!isSoundPlaying(count)) playSound(count);
+
+	audioCallback(NULL, audio->stream, audio->length);
+
+	return;
+
+}
+
+
+/**
+ * Time mixing audio with different numbers of voices.
+ */
+static void benchAudio () {
+
+	AudioData audio;
+	char name[12];
+
+	if (!sounds) return;
+
+	audio.length = 4096;
+	audio.stream = new unsigned char[audio.length];
+
+	// Keep the audio device from mixing at the same time
+	SDL_LockAudio();
+
+	for (audio.voices = 1; audio.voices <= 16; audio.voices <<= 2) {
+
+		snprintf(name, sizeof(name), "voices%d", audio.voices);
+		runKernel("audio", name, audio.length, mixAudio, &audio);
+
+	}
+
+	SDL_UnlockAudio();
+
+	delete[] audio.stream;
+
+	return;
+
+}
+
+
+/**
+ * Draw a JJ2 layer across the canvas.
+ *
+ * @param data The layer data
+ */
+static void drawLayer (void* data) {
+
+	LayerData* layer;
+
+	layer = (LayerData *)data;
+
+	if (SDL_MUSTLOCK(canvas)) SDL_LockSurface(canvas);
+
+	layer->layer->draw(layer->tileImages, NULL, &(layer->band), NULL, 0, NULL, NULL);
+
+	if (SDL_MUSTLOCK(canvas)) SDL_UnlockSurface(canvas);
+
+	return;
+
+}
+
+
+/**
+ * Decode a JJ2 sprite, as each sprite in anims.j2a is.
+ *
+ * @param data The sprite data
+ */
+static void decodeSprite (void* data) {
+
+	SpriteData* sprite;
+
+	sprite = (SpriteData *)data;
+
+	JJ2Level::loadSprite(sprite->parameters, sprite->compressed, sprite->pixels,
+		&(sprite->sprite), &(sprite->flippedSprite));
+
+	return;
+
+}
+
+
+/**
+ * Time drawing a JJ2 layer and decoding a JJ2 sprite, using synthetic tiles,
+ * layer and sprite.
+ */
+static void benchJJ2 () {
+
+	Arena arena;
+	LayerData layer;
+	SpriteData* sprite;
+	unsigned char* tileSet;
+	unsigned char* dictionary;
+	unsigned short int* words;
+	unsigned int seed;
+	fixed oldViewX, oldViewY;
+	int tiles, width, height, pitch;
+	int count, x, y, length;
+
+
+	// Tiles which are opaque, keyed in places, or empty
+	tiles = 64;
+	tileSet = new unsigned char[tiles << 10];
+
+	generateData(tileSet, tiles << 10);
+
+	for (count = 0; count < tiles; count++) {
+
+		for (y = 0; y < 32; y++) {
+
+			for (x = 0; x < 32; x++) {
+
+				if (!tileSet[(count << 10) + (y << 5) + x]) tileSet[(count << 10) + (y << 5) + x] = 1;
+
+				if (((count & 3) == 1) && (((x + y) & 15) < 5)) tileSet[(count << 10) + (y << 5) + x] = 0;
+				else if ((count & 3) == 2) tileSet[(count << 10) + (y << 5) + x] = 0;
+
+			}
+
+		}
+
+	}
+
+	layer.tileImages = createBlitImages(tileSet, 32, tiles, tiles, 0);
+
+
+	// A repeating layer made from a dictionary of groups of four tiles, some
+	// of them flipped, and some cells left empty
+	width = 256;
+	height = 64;
+	pitch = width >> 2;
+
+	dictionary = new unsigned char[256 << 3];
+	words = new unsigned short int[height * pitch];
+	seed = 1;
+
+	for (count = 0; count < 256 << 2; count++) {
+
+		seed = (seed * 1103515245) + 12345;
+		x = (seed >> 16) % tiles;
+		if (seed & 0x100) x |= 0x400;
+		if ((seed & 0x3000) == 0x3000) x = 0;
+
+		dictionary[count << 1] = x & 255;
+		dictionary[(count << 1) + 1] = x >> 8;
+
+	}
+
+	for (count = 0; count < height * pitch; count++) {
+
+		seed = (seed * 1103515245) + 12345;
+		words[count] = (seed >> 16) & 255;
+
+	}
+
+	layer.layer = new JJ2Layer(3, width, height, F1, F1, &arena);
+	layer.layer->setWords(words, pitch, dictionary, false, tiles, false);
+
+	layer.band.x = 0;
+	layer.band.y = 0;
+	layer.band.w = canvasW;
+	layer.band.h = canvasH;
+
+	// A view which is not aligned to the tiles
+	oldViewX = viewX;
+	oldViewY = viewY;
+	viewX = ITOF(1013);
+	viewY = ITOF(517);
+
+	runKernel("jj2layer", "synthetic", canvasW * canvasH, drawLayer, &layer);
+
+	viewX = oldViewX;
+	viewY = oldViewY;
+
+	delete layer.layer;
+	delete[] words;
+	delete[] dictionary;
+	delete[] layer.tileImages;
+	delete[] tileSet;
+
+
+	// A sprite of runs of pixels and gaps, with some rows ended early
+	width = 64;
+	height = 48;
+
+	sprite = new SpriteData;
+	sprite->parameters = new unsigned char[24];
+	sprite->pixels = new unsigned char[width * height];
+
+	// At worst, a skip, a copy and one pixel for each pixel, and a row end
+	sprite->compressed = new unsigned char[height * ((width * 3) + 1)];
+
+	memset(sprite->parameters, 0, 24);
+	sprite->parameters[0] = width;
+	sprite->parameters[2] = height;
+	sprite->parameters[8] = (-(width >> 1)) & 255;
+	sprite->parameters[9] = 255;
+	sprite->parameters[10] = (-height) & 255;
+	sprite->parameters[11] = 255;
+
+	length = 0;
+
+	for (y = 0; y < height; y++) {
+
+		x = 0;
+
+		while (x < width - 8) {
+
+			seed = (seed * 1103515245) + 12345;
+
+			// Skip some pixels
+			if (seed & 7) {
+
+				sprite->compressed[length++] = seed & 7;
+				x += seed & 7;
+
+			}
+
+			// Copy some pixels
+			count = ((seed >> 16) & 15) + 1;
+			if (count > width - x) count = width - x;
+
+			sprite->compressed[length++] = 128 | count;
+
+			for (; count; count--, x++) sprite->compressed[length++] = ((seed >> 8) & 127) + x + 1;
+
+			// End some rows early
+			if (!(seed & 0x70000)) break;
+
+		}
+
+		// Move to the next row
+		sprite->compressed[length++] = 128;
+
+	}
+
+	runKernel("jj2sprite", "synthetic", width * height, decodeSprite, sprite);
+
+	delete[] sprite->pixels;
+	delete[] sprite->compressed;
+	delete[] sprite->parameters;
+	delete sprite;
+
+	return;
+
+}
+
+
+/**
+ * Check that each of the mixer's NEON kernels gives exactly the same output as
+ * its C version, on the same random data, printing the results as lines of
+ * JSON. Nothing is checked in builds without NEON.
+ *
+ * @return The number of kernels whose versions differ
+ */
+static int checkMixing () {
+
+	const char* names[MODPLUG_KERNELS] = {"convert16", "stereofill",
+		"fir-mono8", "fir-mono16", "fir-stereo8", "fir-stereo16"};
+	int* input;
+	unsigned char* plain;
+	unsigned char* neon;
+	unsigned int seed;
+	int samples, kernel, count, length, failures;
+	bool exact;
+
+	samples = 1024;
+
+	// Enough for the FIR filters' 16-bit stereo sample frames
+	input = new int[(samples << 1) + 8];
+	plain = new unsigned char[(samples << 3) + 8];
+	neon = new unsigned char[(samples << 3) + 8];
+
+	// Beyond the range the mixer clips to, but small enough that the offsets
+	// never overflow as they decay
+	seed = 1;
+
+	for (count = 0; count < (samples << 1) + 8; count++) {
+
+		seed = (seed * 1103515245) + 12345;
+		input[count] = ((int)seed) >> 4;
+
+	}
+
+	failures = 0;
+
+	for (kernel = 0; kernel < MODPLUG_KERNELS; kernel++) {
+
+		length = ModPlug_RunKernel(kernel, 0, input, samples, plain);
+
+		if (!length) continue;
+
+		exact = (ModPlug_RunKernel(kernel, 1, input, samples, neon) == length) &&
+			!memcmp(plain, neon, length);
+
+		printf("{\"check\": \"%s\", \"data\": \"random\", \"bytes\": %d, \"exact\": %s}\n",
+			names[kernel], length, exact? "true": "false");
+
+		if (!exact) failures++;
+
+	}
+
+	fflush(stdout);
+
+	delete[] neon;
+	delete[] plain;
+	delete[] input;
+
+	return failures;
+
+}
+
+
+/**
+ * Capture a level's state.
+ *
+ * @param data The rewind
+ */
+static void captureState (void* data) {
+
+	static unsigned int step = 0;
+
+	((Rewind *)data)->capture(step++);
+
+	return;
+
+}
+
+
+/**
+ * Time capturing the state of a JJ1 level, as done each step when rolling
+ * back. The regions are the size of a JJ1 level's grids.
+ */
+static void benchRewind () {
+
+	Rewind rewind;
+	GridElement* grid;
+	unsigned char* eventHits;
+	unsigned int* eventTimes;
+
+	grid = new GridElement[LH * LW];
+	eventHits = new unsigned char[LH * LW];
+	eventTimes = new unsigned int[LH * LW];
+
+	memset(grid, 0, sizeof(GridElement) * LH * LW);
+	memset(eventHits, 0, LH * LW);
+	memset(eventTimes, 0, sizeof(unsigned int) * LH * LW);
+
+	rewind.add(grid, sizeof(GridElement) * LH * LW);
+	rewind.add(eventHits, LH * LW);
+	rewind.add(eventTimes, sizeof(unsigned int) * LH * LW);
+
+	runKernel("rewind", "jj1", rewind.getSize(), captureState, &rewind);
+
+	delete[] eventTimes;
+	delete[] eventHits;
+	delete[] grid;
+
+	return;
+
+}
+
+
+/**
+ * Time each kernel, printing the results as lines of JSON.
+ *
+ * @return Error code (E_REGRESSION if a NEON kernel does not match its C
+ * version)
+ */
+int runMicrobenchmarks () {
+
+	int failures;
+
+	failures = checkMixing();
+
+	benchDecoding();
+	benchMasks();
+	benchDrawing();
+	benchAudio();
+	benchJJ2();
+	benchRewind();
+
+	return failures? E_REGRESSION: E_NONE;
+
+}
+
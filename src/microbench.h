@@ -0,0 +1,43 @@
+
+/**
+ *
+ * @file microbench.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created microbench.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _MICROBENCH_H
+#define _MICROBENCH_H
+
+
+#include "OpenJazz.h"
+
+
+// Constants
+
+// Shortest time each trial of a kernel runs for, in milliseconds
+#ifndef MICROBENCH_TIME
+	#define MICROBENCH_TIME 100
+#endif
+
+// Number of trials of each kernel, of which the median is reported
+#define MICROBENCH_TRIALS 5
+
+
+// Function
+
+EXTERN int runMicrobenchmarks ();
+
+#endif
+
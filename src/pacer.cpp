@@ -0,0 +1,321 @@
+
+/**
+ *
+ * @file pacer.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created pacer.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Paces the frames shown by the main loop. Each frame has a deadline, set
+ * from the last one, and the loop sleeps until it is due, giving way to
+ * yielding just before so as not to oversleep. Frames which are late do not
+ * make the next ones hurry to catch up.
+ *
+ */
+
+
+#include "pacer.h"
+
+#include "io/gfx/video.h"
+#include "clock.h"
+#include "loop.h"
+
+
+/**
+ * Create the frame pacer, pacing frames by vsync.
+ */
+FramePacer::FramePacer () {
+
+	target = PT_VSYNC;
+	deadline = 0;
+	woken = 0;
+	lastInput = 0;
+	jitter = 0;
+	worstJitter = 0;
+	load = 0;
+	refresh = 0;
+	idleFrame = false;
+	stillFrame = false;
+
+	return;
+
+}
+
+
+/**
+ * Set how often frames are shown. Only uncapped frames stop waiting for the
+ * display.
+ *
+ * @param newTarget How often frames are shown
+ */
+void FramePacer::setTarget (PaceTarget newTarget) {
+
+	target = newTarget;
+	worstJitter = 0;
+
+	video.setVsync(target != PT_UNCAPPED);
+
+	return;
+
+}
+
+
+/**
+ * Get how often frames are shown.
+ *
+ * @return How often frames are shown
+ */
+PaceTarget FramePacer::getTarget () {
+
+	return target;
+
+}
+
+
+/**
+ * Note that the coming frame is in a menu or scene, so need not be shown as
+ * often.
+ *
+ * @param still Whether or not nothing moves unless there is input, so that
+ * frames can be shown less often still once there has been none for a while
+ */
+void FramePacer::idle (bool still) {
+
+	idleFrame = true;
+	stillFrame = still;
+
+	return;
+
+}
+
+
+/**
+ * Note that there has been input, so idle frames are shown at their usual
+ * rate again.
+ */
+void FramePacer::input () {
+
+	lastInput = globalTicks;
+
+	return;
+
+}
+
+
+/**
+ * Find how long the coming frame should follow the last.
+ *
+ * @return The interval, in microseconds
+ */
+int FramePacer::getInterval () {
+
+	if (idleFrame) {
+
+		idleFrame = false;
+
+		if (stillFrame && (globalTicks - lastInput > PACE_IDLE_DELAY))
+			return PACE_IDLE_FRAME * 1000;
+
+		return T_MENU_FRAME * 1000;
+
+	}
+
+	// A dedicated server has no display to keep to
+	if (headless) return PACE_MIN_FRAME * 1000;
+
+	switch (target) {
+
+		case PT_30:
+
+			return 1000000 / 30;
+
+		case PT_60:
+
+			return 1000000 / 60;
+
+		case PT_120:
+
+			return 1000000 / 120;
+
+		case PT_UNCAPPED:
+
+			return 0;
+
+		default:
+
+			break;
+
+	}
+
+	// The display's refresh does the rest
+	return PACE_MIN_FRAME * 1000;
+
+}
+
+
+/**
+ * Find how long the coming frame may take to draw without being late. Frames
+ * paced by vsync, or not paced at all, have until the display next refreshes.
+ *
+ * @return The budget, in microseconds
+ */
+int FramePacer::getBudget () {
+
+	SDL_DisplayMode mode;
+
+	switch (target) {
+
+		case PT_30:
+
+			return 1000000 / 30;
+
+		case PT_60:
+
+			return 1000000 / 60;
+
+		case PT_120:
+
+			return 1000000 / 120;
+
+		default:
+
+			break;
+
+	}
+
+	if (!refresh) {
+
+		refresh = 60;
+
+		if (!SDL_GetCurrentDisplayMode(0, &mode) && (mode.refresh_rate > 0))
+			refresh = mode.refresh_rate;
+
+	}
+
+	return 1000000 / refresh;
+
+}
+
+
+/**
+ * Note that the coming frame has been drawn, and is about to be shown. The
+ * time taken since the last wait ended counts towards the load. Showing the
+ * frame does not, as it may itself wait for the display.
+ */
+void FramePacer::drawn () {
+
+	int time, budget;
+
+	if (!woken) return;
+
+	time = (int)(getClock() - woken);
+	budget = getBudget();
+
+	// A single slow frame, such as one after loading, has limited effect
+	if (time > budget << 2) time = budget << 2;
+
+	load += ((time * 100) / budget - load) / 8;
+
+	return;
+
+}
+
+
+/**
+ * Sleep until the coming frame is due.
+ */
+void FramePacer::wait () {
+
+	Uint64 now, interval;
+	int remaining, late;
+
+	interval = getInterval();
+	now = getClock();
+
+	deadline += interval;
+
+	// A frame which is already due starts the schedule afresh, rather than
+	// hurrying the frames after it
+	if (deadline <= now) {
+
+		deadline = now;
+		woken = now;
+
+		return;
+
+	}
+
+	// No frame waits longer than a whole interval, even if the target has
+	// just changed
+	if (deadline > now + interval) deadline = now + interval;
+
+	while (true) {
+
+		now = getClock();
+
+		if (now >= deadline) break;
+
+		remaining = (int)(deadline - now);
+
+		// Sleep for most of the time, then yield until the deadline
+		if (remaining > PACE_SPIN) SDL_Delay((remaining - PACE_SPIN) / 1000);
+		else SDL_Delay(0);
+
+	}
+
+	woken = now;
+	late = (int)(now - deadline);
+
+	jitter += (late - jitter) / 16;
+	if (late > worstJitter) worstJitter = late;
+
+	return;
+
+}
+
+
+/**
+ * Get how late frames have been shown, on average.
+ *
+ * @return The lateness, in microseconds
+ */
+int FramePacer::getJitter () {
+
+	return jitter;
+
+}
+
+
+/**
+ * Get how late any frame has been shown, since the target was last set.
+ *
+ * @return The lateness, in microseconds
+ */
+int FramePacer::getWorstJitter () {
+
+	return worstJitter;
+
+}
+
+
+/**
+ * Get how much of each frame's budget has been spent drawing it, on average.
+ * Frames which took longer than their budget count for more than 100.
+ *
+ * @return The percentage
+ */
+int FramePacer::getLoad () {
+
+	return load;
+
+}
+
@@ -0,0 +1,102 @@
+
+/**
+ *
+ * @file pacer.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created pacer.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ */
+
+
+#ifndef _PACER_H
+#define _PACER_H
+
+
+#include "OpenJazz.h"
+
+#define SDL2
+
+#ifdef SDL2
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+
+// Constants
+
+#define PACE_MIN_FRAME  4 /* Fewest milliseconds between frames when paced by vsync */
+#define PACE_IDLE_DELAY 5000 /* Milliseconds without input before idle frames slow down further */
+#define PACE_IDLE_FRAME 100 /* Milliseconds between idle frames once slowed down */
+#define PACE_SPIN       1000 /* Microseconds before a deadline at which sleeping gives way to yielding */
+
+
+// Enum
+
+/// How often frames are shown
+enum PaceTarget {
+
+	PT_VSYNC = 0, ///< As often as the display refreshes
+	PT_30 = 1, ///< No more than 30 frames per second
+	PT_60 = 2, ///< No more than 60 frames per second
+	PT_120 = 3, ///< No more than 120 frames per second
+	PT_UNCAPPED = 4 ///< As often as possible, without waiting for the display, for benchmarking
+
+};
+
+#define PACE_TARGETS 5
+
+
+// Class
+
+/// Keeps frames to a steady rate, sleeping until each is due. Frames in
+/// menus and scenes are shown less often, and those in which nothing moves
+/// less often still once there has been no input for a while.
+class FramePacer {
+
+	private:
+		PaceTarget   target; ///< How often frames are shown
+		Uint64       deadline; ///< When the next frame is due, in microseconds
+		Uint64       woken; ///< When the last wait ended, in microseconds, or 0
+		unsigned int lastInput; ///< Time of the last input
+		int          jitter; ///< Average lateness of frames, in microseconds
+		int          worstJitter; ///< Greatest lateness of any frame, in microseconds
+		int          load; ///< Average percentage of each frame's budget spent drawing it
+		int          refresh; ///< The display's refresh rate, or 0 if not yet known
+		bool         idleFrame; ///< Whether or not the coming frame is in a menu or scene
+		bool         stillFrame; ///< Whether or not nothing moves in the coming frame unless there is input
+
+		int getInterval ();
+		int getBudget   ();
+
+	public:
+		FramePacer ();
+
+		void       setTarget      (PaceTarget newTarget);
+		PaceTarget getTarget      ();
+		void       idle           (bool still);
+		void       input          ();
+		void       drawn          ();
+		void       wait           ();
+		int        getJitter      ();
+		int        getWorstJitter ();
+		int        getLoad        ();
+
+};
+
+
+// Variable
+
+EXTERN FramePacer pacer; ///< Paces the frames shown by loop()
+
+#endif
+
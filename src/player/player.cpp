@@ -34,6 +34,7 @@
 
 #include "game/game.h"
 #include "io/controls.h"
+#include "io/file.h"
 #include "util.h"
 
 #include <string.h>
@@ -542,3 +543,46 @@ void Player::receive (unsigned char *buffer) {
 
 }
 
+
+/**
+ * Write the player's progress to a file.
+ *
+ * @param file The file
+ */
+void Player::save (File* file) {
+
+	int count;
+
+	for (count = 0; count < 5; count++) file->storeInt(ammo[count]);
+
+	file->storeChar(ammoType + 1);
+	file->storeInt(score);
+	file->storeChar(lives);
+	file->storeChar(fireSpeed);
+	file->storeChar(flockSize);
+
+	return;
+
+}
+
+
+/**
+ * Read the player's progress from a file, as written by save().
+ *
+ * @param file The file
+ */
+void Player::load (File* file) {
+
+	int count;
+
+	for (count = 0; count < 5; count++) ammo[count] = file->loadInt();
+
+	ammoType = file->loadChar() - 1;
+	score = file->loadInt();
+	lives = file->loadChar();
+	fireSpeed = file->loadChar();
+	flockSize = file->loadChar();
+
+	return;
+
+}
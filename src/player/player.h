@@ -74,6 +74,7 @@ enum PlayerColour {
 // Classes
 
 class Anim;
+class File;
 class JJ1LevelPlayer;
 class JJ1BonusLevelPlayer;
 class JJ2LevelPlayer;
@@ -134,6 +135,8 @@ class Player {
 
 		void            send              (unsigned char* buffer);
 		void            receive           (unsigned char* buffer);
+		void            save              (File* file);
+		void            load              (File* file);
 
 		friend class JJ1LevelPlayer;
 		friend class JJ2LevelPlayer;
@@ -0,0 +1,263 @@
+
+/**
+ *
+ * @file pressure.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created pressure.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Empties registered caches in order of priority when memory runs short.
+ *
+ * When memory is tracked, the main thread checks each frame how much is
+ * allocated. Beyond PRESSURE_SOFT megabytes, caches of data no level is using
+ * are emptied, and any preloading is cancelled first. Beyond PRESSURE_HARD,
+ * caches the level is using are emptied too, as they can be made again.
+ *
+ * Whether or not memory is tracked, an allocation which fails calls the new
+ * handler, which empties one cache at a time until the allocation succeeds.
+ * The handler may run on any thread, so it only empties caches which allow
+ * that, and gives up rather than wait for a cache another thread holds.
+ *
+ */
+
+
+#include "pressure.h"
+
+#include "memtrack.h"
+#include "util.h"
+
+#include <new>
+
+
+static thread_local bool relieving = false; ///< Whether or not the current thread is emptying caches
+
+
+/**
+ * Create an empty set of caches.
+ */
+MemoryPressure::MemoryPressure () {
+
+	int count;
+
+	for (count = 0; count < RELIEVERS; count++) relievers[count].relieve = NULL;
+
+	lock = 0;
+	pressed = false;
+
+	return;
+
+}
+
+
+/**
+ * Free memory for an allocation which has failed, or give up.
+ */
+void MemoryPressure::handleNew () {
+
+	bool relieved;
+
+	// Emptying a cache may itself allocate
+	if (relieving) throw std::bad_alloc();
+
+	relieving = true;
+	relieved = memoryPressure.relieve(RP_RENDERED, false);
+	relieving = false;
+
+	if (!relieved) throw std::bad_alloc();
+
+	return;
+
+}
+
+
+/**
+ * Empty caches in order of priority.
+ *
+ * @param most The last priority to empty
+ * @param mainThread Whether or not this is the main thread, and is to stop
+ * emptying caches once enough memory is free
+ *
+ * @return Whether or not any memory was freed
+ */
+bool MemoryPressure::relieve (ReliefPriority most, bool mainThread) {
+
+	int priority, count;
+	bool relieved;
+
+	// Another thread may be emptying caches, or registering one
+	if (!SDL_AtomicTryLock(&lock)) return false;
+
+	relieved = false;
+
+	for (priority = 0; priority <= most; priority++) {
+
+		for (count = 0; count < RELIEVERS; count++) {
+
+			if (!relievers[count].relieve || (relievers[count].priority != priority) ||
+				(!mainThread && !relievers[count].anyThread))
+				continue;
+
+			if (relievers[count].relieve(relievers[count].data)) {
+
+				relieved = true;
+
+				// One cache at a time is enough for a failed allocation
+				if (!mainThread) {
+
+					SDL_AtomicUnlock(&lock);
+
+					return true;
+
+				}
+
+			}
+
+		}
+
+#ifdef TRACK_MEMORY
+		if (mainThread && (getMemoryTotal() <= PRESSURE_SOFT << 10)) break;
+#endif
+
+	}
+
+	SDL_AtomicUnlock(&lock);
+
+	return relieved;
+
+}
+
+
+/**
+ * Start emptying caches when allocations fail.
+ */
+void MemoryPressure::start () {
+
+	std::set_new_handler(handleNew);
+
+	return;
+
+}
+
+
+/**
+ * Stop emptying caches when allocations fail, before the caches are freed.
+ */
+void MemoryPressure::stop () {
+
+	std::set_new_handler(NULL);
+
+	return;
+
+}
+
+
+/**
+ * Register a cache.
+ *
+ * @param name The cache's name, which must not be freed
+ * @param priority When the cache is emptied
+ * @param relieve Function emptying the cache
+ * @param data Passed to the function
+ * @param anyThread Whether or not the function may be called by any thread,
+ * while the cache may be in use
+ *
+ * @return The cache's index, or -1 if there is no room, in which case the
+ * cache is never emptied
+ */
+int MemoryPressure::add (const char* name, ReliefPriority priority, RelieveFunction relieve, void* data, bool anyThread) {
+
+	int count;
+
+	SDL_AtomicLock(&lock);
+
+	for (count = 0; count < RELIEVERS; count++) {
+
+		if (!relievers[count].relieve) {
+
+			relievers[count].name = name;
+			relievers[count].data = data;
+			relievers[count].priority = priority;
+			relievers[count].anyThread = anyThread;
+			relievers[count].relieve = relieve;
+
+			SDL_AtomicUnlock(&lock);
+
+			return count;
+
+		}
+
+	}
+
+	SDL_AtomicUnlock(&lock);
+
+	return -1;
+
+}
+
+
+/**
+ * Forget a cache. Called by its owner before freeing it.
+ *
+ * @param index The cache's index, or -1
+ */
+void MemoryPressure::remove (int index) {
+
+	if (index < 0) return;
+
+	// Waits for any thread emptying the cache
+	SDL_AtomicLock(&lock);
+
+	relievers[index].relieve = NULL;
+
+	SDL_AtomicUnlock(&lock);
+
+	return;
+
+}
+
+
+/**
+ * Empty caches if too much memory is allocated. Called by the main thread
+ * every frame, and cheap enough for that while memory is plentiful.
+ */
+void MemoryPressure::check () {
+
+#ifdef TRACK_MEMORY
+	int total;
+
+	total = getMemoryTotal();
+
+	if (total <= PRESSURE_SOFT << 10) {
+
+		pressed = false;
+
+		return;
+
+	}
+
+	// Warn once each time memory runs short
+	if (!pressed) {
+
+		log("Memory running short (kB)", total);
+		pressed = true;
+
+	}
+
+	relieving = true;
+	relieve((total > PRESSURE_HARD << 10)? RP_RENDERED: RP_UNUSED, true);
+	relieving = false;
+#endif
+
+	return;
+
+}
+
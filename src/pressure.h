@@ -0,0 +1,116 @@
+
+/**
+ *
+ * @file pressure.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created pressure.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Frees cached memory, least needed first, when memory runs short.
+ *
+ */
+
+
+#ifndef _PRESSURE_H
+#define _PRESSURE_H
+
+
+#include "OpenJazz.h"
+
+#define SDL2
+
+#ifdef SDL2
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+
+// Constants
+
+#define RELIEVERS 16 /* Most caches which can be registered at once */
+
+// Megabytes allocated beyond which caches are emptied, when memory is tracked
+#ifndef PRESSURE_SOFT
+	#define PRESSURE_SOFT 1536
+#endif
+
+// Megabytes allocated beyond which even caches used by the level are emptied
+#ifndef PRESSURE_HARD
+	#define PRESSURE_HARD 1792
+#endif
+
+
+// Enum
+
+/// The order in which caches are emptied
+enum ReliefPriority {
+
+	RP_PRELOAD = 0, ///< Work for levels which may never be played
+	RP_UNUSED = 1, ///< Data no level is using
+	RP_RENDERED = 2 ///< Data the level is using, but can make again
+
+};
+
+#define RELIEF_PRIORITIES 3
+
+
+// Datatypes
+
+typedef bool (*RelieveFunction) (void* data); ///< Frees a cache's memory, returning whether or not any was freed
+
+/// A cache which can be emptied
+typedef struct {
+
+	const char*     name; ///< The cache's name, for the log
+	RelieveFunction relieve; ///< Empties the cache, or NULL if the entry is free
+	void*           data; ///< Passed to the function
+	ReliefPriority  priority; ///< When the cache is emptied
+	bool            anyThread; ///< Whether or not the cache may be emptied by any thread, rather than only the main thread
+
+} Reliever;
+
+
+// Class
+
+/// Caches which give up their memory when it runs short. Caches are emptied
+/// when too much is allocated, and by the new handler when an allocation
+/// fails.
+class MemoryPressure {
+
+	private:
+		Reliever     relievers[RELIEVERS]; ///< The caches
+		SDL_SpinLock lock; ///< Guards the caches against threads emptying them
+		bool         pressed; ///< Whether or not too much was allocated when last checked
+
+		static void handleNew ();
+
+		bool relieve (ReliefPriority most, bool mainThread);
+
+	public:
+		MemoryPressure ();
+
+		void start  ();
+		void stop   ();
+		int  add    (const char* name, ReliefPriority priority, RelieveFunction relieve, void* data, bool anyThread);
+		void remove (int index);
+		void check  ();
+
+};
+
+
+// Variable
+
+EXTERN MemoryPressure memoryPressure; ///< Caches emptied when memory runs short
+
+#endif
+
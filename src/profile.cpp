@@ -0,0 +1,609 @@
+
+/**
+ *
+ * @file profile.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created profile.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Times zones of each frame. Each thread writes its timings to its own ring,
+ * so timing a zone takes no lock. Once a frame, the main thread gathers the
+ * timings from every ring into that frame's totals, and adds the frame to the
+ * record if a level is being played. The summary of the record is written as
+ * CSV, so that it can be collected from testers' machines.
+ *
+ */
+
+
+#include "profile.h"
+
+#ifdef PROFILE
+
+#include "io/file.h"
+#include "level/level.h"
+#include "util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+
+/**
+ * Create the profiler, with no timings.
+ */
+Profiler::Profiler () {
+
+	memset(rings, 0, sizeof(rings));
+	memset(frameTimes, 0, sizeof(frameTimes));
+	memset(zoneTimes, 0, sizeof(zoneTimes));
+
+	SDL_AtomicSet(&nRings, 0);
+
+	frequency = 0;
+	frameStart = 0;
+	frame = 0;
+
+	record = NULL;
+	nRecorded = 0;
+	nDropped = 0;
+	nLevels = 0;
+	level = -1;
+
+	return;
+
+}
+
+
+/**
+ * Delete the record.
+ */
+Profiler::~Profiler () {
+
+	int count;
+
+	if (record) delete[] record;
+
+	for (count = 0; count < nLevels; count++) delete[] levelNames[count];
+
+	return;
+
+}
+
+
+/**
+ * Find the ring belonging to the current thread, claiming one if it has none.
+ *
+ * @return The ring, or NULL if there are none left
+ */
+ProfileRing* Profiler::getRing () {
+
+	SDL_threadID id;
+	int count, index;
+
+	id = SDL_ThreadID();
+
+	for (count = 0; count < SDL_AtomicGet(&nRings); count++) {
+
+		if (rings[count].thread == id) return rings + count;
+
+	}
+
+	index = SDL_AtomicAdd(&nRings, 1);
+
+	if (index >= PROFILE_THREADS) {
+
+		SDL_AtomicAdd(&nRings, -1);
+
+		return NULL;
+
+	}
+
+	rings[index].thread = id;
+
+	return rings + index;
+
+}
+
+
+/**
+ * Start timing a zone.
+ *
+ * @param zone The zone
+ */
+void Profiler::begin (ProfileZone zone) {
+
+	ProfileRing* ring;
+
+	ring = getRing();
+
+	if (ring) ring->starts[zone] = SDL_GetPerformanceCounter();
+
+	return;
+
+}
+
+
+/**
+ * Stop timing a zone, adding the time spent in it to the current frame.
+ *
+ * @param zone The zone
+ */
+void Profiler::end (ProfileZone zone) {
+
+	ProfileRing* ring;
+	ProfileSample* sample;
+	Uint64 now;
+	int written;
+
+	ring = getRing();
+
+	if (!ring || !ring->starts[zone]) return;
+
+	now = SDL_GetPerformanceCounter();
+
+	if (!frequency) frequency = SDL_GetPerformanceFrequency();
+
+	written = SDL_AtomicGet(&ring->written);
+
+	// Timings the main thread has not gathered in time are lost
+	sample = ring->samples + (written & (PROFILE_SAMPLES - 1));
+	sample->zone = zone;
+	sample->time = ((now - ring->starts[zone]) * 1000000) / frequency;
+
+	SDL_MemoryBarrierRelease();
+	SDL_AtomicSet(&ring->written, written + 1);
+
+	return;
+
+}
+
+
+/**
+ * Finish the current frame, gathering every thread's timings for it.
+ */
+void Profiler::endFrame () {
+
+	ProfileRing* ring;
+	ProfileSample* sample;
+	ProfileFrame* recorded;
+	unsigned int* totals;
+	Uint64 now;
+	int count, written;
+
+	now = SDL_GetPerformanceCounter();
+
+	if (!frequency) frequency = SDL_GetPerformanceFrequency();
+
+	totals = zoneTimes[frame & (PROFILE_HISTORY - 1)];
+	memset(totals, 0, sizeof(unsigned int) * PROFILE_ZONES);
+
+	for (count = 0; count < SDL_AtomicGet(&nRings); count++) {
+
+		ring = rings + count;
+
+		written = SDL_AtomicGet(&ring->written);
+		SDL_MemoryBarrierAcquire();
+
+		if (written - ring->read > PROFILE_SAMPLES) ring->read = written - PROFILE_SAMPLES;
+
+		while (ring->read != written) {
+
+			sample = ring->samples + (ring->read & (PROFILE_SAMPLES - 1));
+			totals[sample->zone] += sample->time;
+			ring->read++;
+
+		}
+
+	}
+
+	// The first frame has no start
+	if (frameStart) {
+
+		frameTimes[frame & (PROFILE_HISTORY - 1)] = ((now - frameStart) * 1000000) / frequency;
+
+		if ((level >= 0) && (nRecorded < PROFILE_RECORD)) {
+
+			recorded = record + nRecorded;
+			recorded->time = frameTimes[frame & (PROFILE_HISTORY - 1)];
+
+			for (count = 0; count < PROFILE_ZONES; count++)
+				recorded->zones[count] = (totals[count] < 65535)? totals[count]: 65535;
+
+			recorded->viewX = FTOI(viewX);
+			recorded->viewY = FTOI(viewY);
+			recorded->level = level;
+
+			nRecorded++;
+
+		} else if (level >= 0) {
+
+			nDropped++;
+
+		}
+
+		frame++;
+
+	}
+
+	frameStart = now;
+
+	return;
+
+}
+
+
+/**
+ * Get the average time spent in a zone each frame.
+ *
+ * @param zone The zone
+ *
+ * @return Number of microseconds
+ */
+int Profiler::getZoneTime (ProfileZone zone) {
+
+	unsigned int total;
+	int count, frames;
+
+	frames = (frame < PROFILE_HISTORY)? frame: PROFILE_HISTORY;
+
+	if (!frames) return 0;
+
+	total = 0;
+
+	for (count = 0; count < frames; count++) total += zoneTimes[count][zone];
+
+	return total / frames;
+
+}
+
+
+/**
+ * Get the length of a recent frame.
+ *
+ * @param age Number of frames since the frame, 0 being the last
+ *
+ * @return Number of microseconds, or 0 if the frame is no longer kept
+ */
+int Profiler::getFrameTime (int age) {
+
+	if ((age < 0) || (age >= frame) || (age >= PROFILE_HISTORY)) return 0;
+
+	return frameTimes[(frame - 1 - age) & (PROFILE_HISTORY - 1)];
+
+}
+
+
+/**
+ * Get the length of frame which the given percentage of recent frames are no
+ * longer than.
+ *
+ * @param percentile The percentage
+ *
+ * @return Number of microseconds
+ */
+int Profiler::getPercentile (int percentile) {
+
+	unsigned int sorted[PROFILE_HISTORY];
+	unsigned int time;
+	int count, place, frames;
+
+	frames = (frame < PROFILE_HISTORY)? frame: PROFILE_HISTORY;
+
+	if (!frames) return 0;
+
+	// Insertion sort, as there are few frames
+	for (count = 0; count < frames; count++) {
+
+		time = frameTimes[count];
+
+		for (place = count; (place > 0) && (sorted[place - 1] > time); place--)
+			sorted[place] = sorted[place - 1];
+
+		sorted[place] = time;
+
+	}
+
+	return sorted[((frames - 1) * percentile) / 100];
+
+}
+
+
+/**
+ * Get the short name of a zone, for the statistics overlay.
+ *
+ * @param zone The zone
+ *
+ * @return The name
+ */
+const char* Profiler::getZoneName (ProfileZone zone) {
+
+	const char* names[PROFILE_ZONES] = {"loop", "step", "draw", "flip", "pal", "wait", "audio", "net"};
+
+	return names[zone];
+
+}
+
+
+/**
+ * Start recording the frames played in a level. The record is allocated the
+ * first time, so that recording does not allocate memory between frames.
+ *
+ * @param name The level's file name
+ */
+void Profiler::enterLevel (const char* name) {
+
+	int count;
+
+	if (!record) record = new ProfileFrame[PROFILE_RECORD];
+
+	for (count = 0; count < nLevels; count++) {
+
+		if (!strcmp(levelNames[count], name)) break;
+
+	}
+
+	if (count == nLevels) {
+
+		// Levels beyond the last are counted with it
+		if (nLevels == PROFILE_LEVELS) count = PROFILE_LEVELS - 1;
+		else levelNames[nLevels++] = createString(name);
+
+	}
+
+	level = count;
+
+	return;
+
+}
+
+
+/**
+ * Stop recording frames, and write the summary of those recorded so far.
+ */
+void Profiler::leaveLevel () {
+
+	if (level < 0) return;
+
+	level = -1;
+
+	save();
+
+	return;
+
+}
+
+
+/**
+ * Count the recorded frames of each length.
+ *
+ * @param index The level whose frames are counted, or -1 for every level
+ * @param histogram Number of frames in each PROFILE_BUCKET microseconds
+ *
+ * @return Number of frames counted
+ */
+int Profiler::fillHistogram (int index, unsigned int* histogram) {
+
+	int count, bucket, frames;
+
+	memset(histogram, 0, sizeof(unsigned int) * PROFILE_BUCKETS);
+	frames = 0;
+
+	for (count = 0; count < nRecorded; count++) {
+
+		if ((index >= 0) && (record[count].level != index)) continue;
+
+		bucket = record[count].time / PROFILE_BUCKET;
+		if (bucket >= PROFILE_BUCKETS) bucket = PROFILE_BUCKETS - 1;
+
+		histogram[bucket]++;
+		frames++;
+
+	}
+
+	return frames;
+
+}
+
+
+/**
+ * Find the time within which the given proportion of frames were shown.
+ *
+ * @param histogram Number of frames in each PROFILE_BUCKET microseconds
+ * @param frames Number of frames counted
+ * @param permille The proportion of frames, in thousandths
+ *
+ * @return The time, in microseconds
+ */
+static int getHistogramTime (unsigned int* histogram, int frames, int permille) {
+
+	int count, bucket;
+
+	count = 0;
+
+	for (bucket = 0; bucket < PROFILE_BUCKETS - 1; bucket++) {
+
+		count += histogram[bucket];
+
+		if ((long long int)count * 1000 >= (long long int)frames * permille) break;
+
+	}
+
+	return (bucket + 1) * PROFILE_BUCKET;
+
+}
+
+
+/**
+ * Write a row of the summary, with the percentiles of frame length and the
+ * average time spent in each zone.
+ *
+ * @param text Where to write the row
+ * @param size Space left for it
+ * @param index The level whose frames are summarised, or -1 for every level
+ *
+ * @return Length of the row
+ */
+int Profiler::summarise (char* text, int size, int index) {
+
+	unsigned int histogram[PROFILE_BUCKETS];
+	long long int zones[PROFILE_ZONES];
+	unsigned int worst;
+	int count, zone, frames, length;
+
+	frames = fillHistogram(index, histogram);
+
+	if (!frames) return 0;
+
+	memset(zones, 0, sizeof(zones));
+	worst = 0;
+
+	for (count = 0; count < nRecorded; count++) {
+
+		if ((index >= 0) && (record[count].level != index)) continue;
+
+		for (zone = 0; zone < PROFILE_ZONES; zone++) zones[zone] += record[count].zones[zone];
+
+		if (record[count].time > worst) worst = record[count].time;
+
+	}
+
+	length = snprintf(text, size, "%s,%d,%d,%d,%d,%d,%u",
+		(index >= 0)? levelNames[index]: "all", frames,
+		getHistogramTime(histogram, frames, 500),
+		getHistogramTime(histogram, frames, 900),
+		getHistogramTime(histogram, frames, 990),
+		getHistogramTime(histogram, frames, 999), worst);
+
+	for (zone = 0; (zone < PROFILE_ZONES) && (length < size); zone++)
+		length += snprintf(text + length, size - length, ",%d", (int)(zones[zone] / frames));
+
+	if (length < size) length += snprintf(text + length, size - length, "\n");
+
+	return (length < size)? length: size;
+
+}
+
+
+/**
+ * Write the summary of the frames recorded so far to PROFILE_FILE: the
+ * percentiles of frame length for each level and overall, with the average
+ * time spent in each zone, then the worst frames, with where they were shown,
+ * then the histogram of every frame's length. All times are in microseconds.
+ */
+void Profiler::save () {
+
+	unsigned int histogram[PROFILE_BUCKETS];
+	int worst[PROFILE_WORST];
+	ProfileFrame* recorded;
+	File* file;
+	char* text;
+	int size, length, count, place, nWorst, zone, frames;
+
+	if (!nRecorded) return;
+
+	size = ((nLevels + 1) * 192) + (PROFILE_WORST * 128) + (PROFILE_BUCKETS * 16) + 512;
+	text = new char[size];
+
+	// Percentiles and zones
+	length = snprintf(text, size, "level,frames,p50,p90,p99,p99.9,worst");
+
+	for (zone = 0; (zone < PROFILE_ZONES) && (length < size); zone++)
+		length += snprintf(text + length, size - length, ",%s", getZoneName((ProfileZone)zone));
+
+	if (length < size) length += snprintf(text + length, size - length, "\n");
+
+	for (count = -1; (count < nLevels) && (length < size); count++)
+		length += summarise(text + length, size - length, count);
+
+	if (length < size) length += snprintf(text + length, size - length, "dropped,%d\n", nDropped);
+
+	// The longest frames, longest first
+	nWorst = 0;
+
+	for (count = 0; count < nRecorded; count++) {
+
+		for (place = nWorst; (place > 0) && (record[worst[place - 1]].time < record[count].time); place--) {
+
+			if (place < PROFILE_WORST) worst[place] = worst[place - 1];
+
+		}
+
+		if (place < PROFILE_WORST) {
+
+			worst[place] = count;
+			if (nWorst < PROFILE_WORST) nWorst++;
+
+		}
+
+	}
+
+	if (length < size)
+		length += snprintf(text + length, size - length, "\nworst frame,level,time,view x,view y");
+
+	for (zone = 0; (zone < PROFILE_ZONES) && (length < size); zone++)
+		length += snprintf(text + length, size - length, ",%s", getZoneName((ProfileZone)zone));
+
+	if (length < size) length += snprintf(text + length, size - length, "\n");
+
+	for (count = 0; (count < nWorst) && (length < size); count++) {
+
+		recorded = record + worst[count];
+
+		length += snprintf(text + length, size - length, "%d,%s,%u,%d,%d",
+			worst[count], levelNames[recorded->level], recorded->time,
+			recorded->viewX, recorded->viewY);
+
+		for (zone = 0; (zone < PROFILE_ZONES) && (length < size); zone++)
+			length += snprintf(text + length, size - length, ",%d", recorded->zones[zone]);
+
+		if (length < size) length += snprintf(text + length, size - length, "\n");
+
+	}
+
+	// Every frame's length, in the buckets with any frames
+	frames = fillHistogram(-1, histogram);
+
+	if (length < size)
+		length += snprintf(text + length, size - length, "\nfrom,frames,of %d\n", frames);
+
+	for (count = 0; (count < PROFILE_BUCKETS) && (length < size); count++) {
+
+		if (histogram[count])
+			length += snprintf(text + length, size - length, "%d,%u\n",
+				count * PROFILE_BUCKET, histogram[count]);
+
+	}
+
+	if (length > size - 1) length = size - 1;
+
+	try {
+
+		file = new File(PROFILE_FILE, true);
+
+	} catch (int e) {
+
+		delete[] text;
+
+		return;
+
+	}
+
+	file->storeBlock((unsigned char *)text, length);
+
+	delete file;
+	delete[] text;
+
+	return;
+
+}
+
+#endif
+
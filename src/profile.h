@@ -0,0 +1,178 @@
+
+/**
+ *
+ * @file profile.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created profile.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Times zones of each frame while the game is played, for the statistics
+ * overlay, and records every frame played in a level for a summary written to
+ * PROFILE_FILE. Only built when PROFILE is defined (e.g. make
+ * DEFINES=-DPROFILE), otherwise the macros expand to nothing.
+ *
+ */
+
+
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+
+#include "OpenJazz.h"
+
+#ifdef PROFILE
+
+#define SDL2
+
+#ifdef SDL2
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+
+// Constants
+
+#define PROFILE_THREADS 4 /* Most threads which time zones */
+#define PROFILE_SAMPLES 256 /* Timings each thread can hold between frames, must be a power of 2 */
+#define PROFILE_HISTORY 128 /* Frames whose timings are kept */
+#define PROFILE_FILE    "openjazz-frames.csv" /* Summary of the frames recorded, written beside the configuration file */
+#define PROFILE_RECORD  32768 /* Most frames recorded in a session */
+#define PROFILE_LEVELS  64 /* Most levels named in a session */
+#define PROFILE_BUCKET  100 /* Microseconds covered by each bucket of the frame time histogram */
+#define PROFILE_BUCKETS 1000 /* Buckets in the histogram, longer frames being counted in the last */
+#define PROFILE_WORST   10 /* Number of worst frames listed */
+
+
+// Enum
+
+/// Parts of a frame which are timed separately
+enum ProfileZone {
+
+	PZ_LOOP = 0, ///< Level::loop, including showing the frame and waiting
+	PZ_STEP = 1, ///< Taking level steps
+	PZ_DRAW = 2, ///< Drawing the level
+	PZ_FLIP = 3, ///< Showing what has been drawn
+	PZ_PALETTE = 4, ///< Applying palette effects
+	PZ_WAIT = 5, ///< Waiting until the next frame is due
+	PZ_AUDIO = 6, ///< Mixing sound, on the audio thread
+	PZ_NETWORK = 7 ///< Sending and receiving network messages
+
+};
+
+#define PROFILE_ZONES 8
+
+
+// Datatypes
+
+/// The time spent in a zone
+typedef struct {
+
+	unsigned char zone; ///< The zone
+	unsigned int  time; ///< Microseconds spent in it
+
+} ProfileSample;
+
+/// The timings taken by one thread. Only that thread writes them, and only the
+/// main thread reads them.
+typedef struct {
+
+	SDL_threadID  thread; ///< The thread
+	Uint64        starts[PROFILE_ZONES]; ///< When each zone was last begun, in performance counter ticks
+	ProfileSample samples[PROFILE_SAMPLES]; ///< The timings, in a ring
+	SDL_atomic_t  written; ///< Number of timings written
+	int           read; ///< Number of timings read
+
+} ProfileRing;
+
+/// A frame played in a level
+typedef struct {
+
+	unsigned int   time; ///< Length of the frame, in microseconds
+	unsigned short zones[PROFILE_ZONES]; ///< Time spent in each zone, in microseconds, at most 65535
+	short          viewX; ///< View x-coordinate, in pixels
+	short          viewY; ///< View y-coordinate, in pixels
+	unsigned char  level; ///< Index of the level's name
+
+} ProfileFrame;
+
+
+// Class
+
+/// Timings of each zone over the last few frames, and a record of every frame
+/// played in a level
+class Profiler {
+
+	private:
+		ProfileRing   rings[PROFILE_THREADS]; ///< Each thread's timings
+		SDL_atomic_t  nRings; ///< Number of rings claimed
+		Uint64        frequency; ///< Performance counter ticks per second
+		Uint64        frameStart; ///< When the current frame started, in performance counter ticks
+		unsigned int  frameTimes[PROFILE_HISTORY]; ///< Length of each frame, in microseconds
+		unsigned int  zoneTimes[PROFILE_HISTORY][PROFILE_ZONES]; ///< Time spent in each zone in each frame
+		int           frame; ///< Number of frames timed
+		ProfileFrame* record; ///< Every frame played in a level, allocated when the first level starts
+		int           nRecorded; ///< Number of frames in the record
+		int           nDropped; ///< Number of frames played after the record was full
+		char*         levelNames[PROFILE_LEVELS]; ///< Names of the levels played
+		int           nLevels; ///< Number of levels named
+		int           level; ///< Index of the level being played, or -1
+
+		ProfileRing* getRing       ();
+		int          fillHistogram (int index, unsigned int* histogram);
+		int          summarise     (char* text, int size, int index);
+
+	public:
+		Profiler  ();
+		~Profiler ();
+
+		void        begin         (ProfileZone zone);
+		void        end           (ProfileZone zone);
+		void        endFrame      ();
+		int         getZoneTime   (ProfileZone zone);
+		int         getFrameTime  (int age);
+		int         getPercentile (int percentile);
+		const char* getZoneName   (ProfileZone zone);
+		void        enterLevel    (const char* name);
+		void        leaveLevel    ();
+		void        save          ();
+
+};
+
+
+// Variable
+
+EXTERN Profiler profiler; ///< Times zones of each frame
+
+
+// Macros
+
+#define PROFILE_BEGIN(zone) profiler.begin(zone) ///< Start timing a zone
+#define PROFILE_END(zone) profiler.end(zone) ///< Stop timing a zone
+#define PROFILE_FRAME() profiler.endFrame() ///< Finish the frame's timings
+#define PROFILE_LEVEL(name) profiler.enterLevel(name) ///< Start recording frames in a level
+#define PROFILE_LEAVE() profiler.leaveLevel() ///< Stop recording frames, and write the summary
+#define PROFILE_SAVE() profiler.save() ///< Write the summary
+
+#else
+
+#define PROFILE_BEGIN(zone)
+#define PROFILE_END(zone)
+#define PROFILE_FRAME()
+#define PROFILE_LEVEL(name)
+#define PROFILE_LEAVE()
+#define PROFILE_SAVE()
+
+#endif
+
+#endif
+
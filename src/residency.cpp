@@ -0,0 +1,166 @@
+
+/**
+ *
+ * @file residency.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created residency.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Releases registered resources, such as the menus' images, while a level
+ * runs. Each owner calls use() before touching its resource, which reloads it
+ * if it has been released.
+ *
+ */
+
+
+#include "residency.h"
+
+#include "util.h"
+
+#include <stddef.h>
+
+
+/**
+ * Create an empty set of resources.
+ */
+Residency::Residency () {
+
+	int count;
+
+	for (count = 0; count < RESIDENTS; count++) residents[count].release = NULL;
+
+	nResident = 0;
+
+	return;
+
+}
+
+
+/**
+ * Register a loaded resource.
+ *
+ * @param name The resource's name, which must not be freed
+ * @param release Function freeing the resource
+ * @param reload Function loading the resource again
+ * @param data Passed to the functions
+ *
+ * @return The resource's index, or -1 if there is no room, in which case the
+ * resource is never released
+ */
+int Residency::add (const char* name, ReleaseFunction release, ReloadFunction reload, void* data) {
+
+	int count;
+
+	for (count = 0; count < RESIDENTS; count++) {
+
+		if (!residents[count].release) {
+
+			residents[count].name = name;
+			residents[count].release = release;
+			residents[count].reload = reload;
+			residents[count].data = data;
+			residents[count].resident = true;
+			nResident++;
+
+			return count;
+
+		}
+
+	}
+
+	return -1;
+
+}
+
+
+/**
+ * Forget a resource, without releasing it. Called by its owner before
+ * freeing it.
+ *
+ * @param index The resource's index, or -1
+ *
+ * @return Whether or not the resource is loaded, and so needs freeing
+ */
+bool Residency::remove (int index) {
+
+	if ((index < 0) || !residents[index].release) return true;
+
+	residents[index].release = NULL;
+
+	if (!residents[index].resident) return false;
+
+	nResident--;
+
+	return true;
+
+}
+
+
+/**
+ * Make sure a resource is loaded, reloading it if it has been released.
+ *
+ * @param index The resource's index, or -1
+ *
+ * @return Error code
+ */
+int Residency::use (int index) {
+
+	int ret;
+
+	if ((index < 0) || !residents[index].release || residents[index].resident)
+		return E_NONE;
+
+	ret = residents[index].reload(residents[index].data);
+
+	if (ret < 0) {
+
+		log("Could not reload", residents[index].name);
+
+		return ret;
+
+	}
+
+	residents[index].resident = true;
+	nResident++;
+
+	return E_NONE;
+
+}
+
+
+/**
+ * Release every loaded resource. Cheap enough to call every frame, as nothing
+ * is done once they have all been released.
+ */
+void Residency::release () {
+
+	int count;
+
+	if (!nResident) return;
+
+	for (count = 0; count < RESIDENTS; count++) {
+
+		if (residents[count].release && residents[count].resident) {
+
+			residents[count].release(residents[count].data);
+			residents[count].resident = false;
+
+		}
+
+	}
+
+	nResident = 0;
+
+	return;
+
+}
+
@@ -0,0 +1,79 @@
+
+/**
+ *
+ * @file residency.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created residency.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Keeps track of resources which are only needed outside levels, so that they
+ * can be released while a level runs and reloaded when next used.
+ *
+ */
+
+
+#ifndef _RESIDENCY_H
+#define _RESIDENCY_H
+
+
+#include "OpenJazz.h"
+
+
+// Constant
+
+#define RESIDENTS 16 /* Most resources which can be registered at once */
+
+
+// Datatypes
+
+typedef void (*ReleaseFunction) (void* data); ///< Frees a resource
+typedef int  (*ReloadFunction)  (void* data); ///< Loads a resource again, returning an error code
+
+/// A resource which can be released
+typedef struct {
+
+	const char*     name; ///< The resource's name, for the log
+	ReleaseFunction release; ///< Frees the resource, or NULL if the entry is free
+	ReloadFunction  reload; ///< Loads the resource again
+	void*           data; ///< Passed to the functions
+	bool            resident; ///< Whether or not the resource is loaded
+
+} Resident;
+
+
+// Class
+
+/// Resources which can be released while they are not needed. Only used by
+/// the main thread.
+class Residency {
+
+	private:
+		Resident residents[RESIDENTS]; ///< The resources
+		int      nResident; ///< Number of resources loaded
+
+	public:
+		Residency ();
+
+		int  add     (const char* name, ReleaseFunction release, ReloadFunction reload, void* data);
+		bool remove  (int index);
+		int  use     (int index);
+		void release ();
+
+};
+
+
+// Variable
+
+EXTERN Residency residency; ///< Resources released while levels run
+
+#endif
+
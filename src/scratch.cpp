@@ -0,0 +1,212 @@
+
+/**
+ *
+ * @file scratch.cpp
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created scratch.cpp
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Each thread hands out frame memory from its own buffer, so no locking is
+ * needed. Anything which does not fit is taken from the heap, and the buffer
+ * grows to fit the whole frame when it is next reset, so once the game has
+ * settled its frames take nothing from the heap.
+ *
+ * The main thread resets its buffer at the end of each frame. Worker threads
+ * reset theirs the first time they allocate in a later frame, so memory they
+ * take must only be used by jobs which are waited for within the frame, never
+ * by background jobs.
+ *
+ */
+
+
+#include "scratch.h"
+
+#define SDL2
+
+#ifdef SDL2
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+#include <stddef.h>
+
+
+// The header is padded so that overflow contents stay aligned
+#define SCRATCH_HEADER ((sizeof(ScratchOverflow) + SCRATCH_ALIGN - 1) & ~(SCRATCH_ALIGN - 1))
+
+
+// Datatype
+
+/// Memory which did not fit into a thread's buffer
+typedef struct ScratchOverflow {
+
+	struct ScratchOverflow* next; ///< The next overflow
+
+} ScratchOverflow;
+
+
+// Class
+
+/// One thread's frame memory
+class FrameScratch {
+
+	public:
+		unsigned char*   buffer; ///< Memory handed out first, or NULL if not yet needed
+		ScratchOverflow* overflows; ///< Memory handed out once the buffer was full
+		int              size; ///< Number of bytes in the buffer
+		int              used; ///< Bytes of the buffer handed out this frame
+		int              wanted; ///< Bytes handed out this frame, including overflows
+		int              frame; ///< The frame the memory was handed out in
+
+		FrameScratch  ();
+		~FrameScratch ();
+
+		void reset ();
+
+};
+
+
+static SDL_atomic_t scratchFrame = {0}; ///< Incremented at the end of each frame
+static thread_local FrameScratch scratch; ///< The current thread's frame memory
+
+
+/**
+ * Create an empty buffer. Memory is only taken once the thread allocates.
+ */
+FrameScratch::FrameScratch () {
+
+	buffer = NULL;
+	overflows = NULL;
+	size = 0;
+	used = 0;
+	wanted = 0;
+	frame = 0;
+
+	return;
+
+}
+
+
+/**
+ * Delete the buffer, when its thread ends.
+ */
+FrameScratch::~FrameScratch () {
+
+	reset();
+
+	delete[] buffer;
+
+	return;
+
+}
+
+
+/**
+ * Free every overflow, and make the buffer big enough to have held
+ * everything handed out since the last reset.
+ */
+void FrameScratch::reset () {
+
+	ScratchOverflow* overflow;
+
+	while (overflows) {
+
+		overflow = overflows->next;
+		delete[] (unsigned char *)overflows;
+		overflows = overflow;
+
+	}
+
+	if (wanted > size) {
+
+		delete[] buffer;
+
+		size = (wanted + SCRATCH_SIZE - 1) & ~(SCRATCH_SIZE - 1);
+		buffer = new unsigned char[size];
+
+	}
+
+	used = 0;
+	wanted = 0;
+
+	return;
+
+}
+
+
+/**
+ * Allocate memory which lasts until the end of the frame. The memory is not
+ * cleared, and is never freed individually.
+ *
+ * @param size Number of bytes to allocate
+ *
+ * @return The memory
+ */
+void* frameAllocate (int size) {
+
+	ScratchOverflow* overflow;
+	unsigned char* memory;
+	int frame;
+
+	size = (size + SCRATCH_ALIGN - 1) & ~(SCRATCH_ALIGN - 1);
+
+	// Worker threads find out here that a frame has ended
+	frame = SDL_AtomicGet(&scratchFrame);
+
+	if (scratch.frame != frame) {
+
+		scratch.reset();
+		scratch.frame = frame;
+
+	}
+
+	if (!scratch.buffer) {
+
+		scratch.size = SCRATCH_SIZE;
+		scratch.buffer = new unsigned char[scratch.size];
+
+	}
+
+	scratch.wanted += size;
+
+	if (scratch.used + size <= scratch.size) {
+
+		memory = scratch.buffer + scratch.used;
+		scratch.used += size;
+
+		return memory;
+
+	}
+
+	overflow = (ScratchOverflow *)(new unsigned char[SCRATCH_HEADER + size]);
+	overflow->next = scratch.overflows;
+	scratch.overflows = overflow;
+
+	return ((unsigned char *)overflow) + SCRATCH_HEADER;
+
+}
+
+
+/**
+ * End the frame, so that all frame memory can be used again. Called by the
+ * main thread once each frame has been shown.
+ */
+void resetFrameScratch () {
+
+	scratch.frame = SDL_AtomicAdd(&scratchFrame, 1) + 1;
+	scratch.reset();
+
+	return;
+
+}
+
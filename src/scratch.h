@@ -0,0 +1,43 @@
+
+/**
+ *
+ * @file scratch.h
+ *
+ * Part of the OpenJazz project
+ *
+ * @par History:
+ * - 14th October 2026: Created scratch.h
+ *
+ * @par Licence:
+ * Copyright (c) 2005-2017 Alister Thomson
+ *
+ * OpenJazz is distributed under the terms of
+ * the GNU General Public License, version 2.0
+ *
+ * @par Description:
+ * Memory which only lasts until the end of the frame, taken from a buffer
+ * belonging to the current thread rather than from the heap.
+ *
+ */
+
+
+#ifndef _SCRATCH_H
+#define _SCRATCH_H
+
+
+#include "OpenJazz.h"
+
+
+// Constants
+
+#define SCRATCH_SIZE  (64 << 10) /* Bytes each thread's buffer starts with */
+#define SCRATCH_ALIGN 16 /* Allocations start at multiples of this */
+
+
+// Functions
+
+EXTERN void* frameAllocate     (int size);
+EXTERN void  resetFrameScratch ();
+
+#endif
+
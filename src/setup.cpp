@@ -27,11 +27,15 @@
 #include "io/controls.h"
 #include "io/file.h"
 #include "io/gfx/video.h"
+#include "io/network.h"
 #include "io/sound.h"
 #include "player/player.h"
 #include "setup.h"
 #include "util.h"
 
+#include <stdio.h>
+#include <string.h>
+
 
 #ifdef __SYMBIAN32__
     #ifdef UIQ3
@@ -45,6 +49,8 @@
     #define CONFIG_FILE "openjazz.cfg"
 #endif
 
+#define CONFIG_TEMP_SUFFIX ".tmp" /* Added to the name of the file written before it replaces the old one */
+
 
 /**
  * Create default setup
@@ -60,6 +66,16 @@ Setup::Setup () {
 	characterCols[2] = CHAR_GUN;
 	characterCols[3] = CHAR_WBAND;
 
+	maxClients = DEFAULT_CLIENTS;
+	localPlayers = 1;
+	integerScale = false;
+	dynamicResolution = false;
+	paceTarget = PT_VSYNC;
+
+	savedLength = 0;
+	writeLength = 0;
+	saving = false;
+
 	return;
 
 }
@@ -81,6 +97,7 @@ Setup::~Setup () {
 void Setup::load (int* videoW, int* videoH, bool* fullscreen, int* videoScale) {
 
 	File* file;
+	unsigned char* block;
 	int count;
 
 	// Open config file
@@ -173,6 +190,37 @@ void Setup::load (int* videoW, int* videoH, bool* fullscreen, int* videoScale) {
 	setup.slowMotion = ((count & 4) != 0);
 	setup.manyBirds = ((count & 1) != 0);
 	setup.leaveUnneeded = ((count & 2) != 0);
+	setup.rollback = ((count & 8) != 0);
+
+	// Read the server's client limit, which older files do not have
+	if (file->tell() < file->getSize()) {
+
+		count = file->loadChar();
+
+		if ((count > 0) && (count <= MAX_CLIENTS)) setup.maxClients = count;
+
+	}
+
+	// Read the display options, which older files do not have
+	if (file->tell() < file->getSize()) {
+
+		count = file->loadChar();
+		setup.integerScale = ((count & 1) != 0);
+		if (((count >> 1) & 7) < PACE_TARGETS) setup.paceTarget = (PaceTarget)((count >> 1) & 7);
+		setup.dynamicResolution = ((count & 16) != 0);
+
+	}
+
+	// Keep the contents, so that unchanged settings are not written again
+	if (file->getSize() <= SETUP_SIZE) {
+
+		file->seek(0, true);
+		block = file->loadBlock(file->getSize());
+		memcpy(saved, block, file->getSize());
+		savedLength = file->getSize();
+		delete[] block;
+
+	}
 
 
 	delete file;
@@ -184,42 +232,82 @@ void Setup::load (int* videoW, int* videoH, bool* fullscreen, int* videoScale) {
 
 
 /**
- * Save settings to config file.
+ * Add a byte to a buffer.
+ *
+ * @param buffer The buffer
+ * @param length The length of the buffer's contents, which is increased
+ * @param val The byte
  */
-void Setup::save () {
+static void storeChar (unsigned char* buffer, int& length, unsigned char val) {
 
-	File *file;
-	int count;
-	int videoScale;
+	buffer[length++] = val;
 
-	// Open config file
-	try {
+	return;
 
-		file = new File(CONFIG_FILE, true);
+}
 
-	} catch (int e) {
 
-		file = NULL;
+/**
+ * Add an unsigned short int to a buffer, in the order File::storeShort() uses.
+ *
+ * @param buffer The buffer
+ * @param length The length of the buffer's contents, which is increased
+ * @param val The value
+ */
+static void storeShort (unsigned char* buffer, int& length, unsigned short int val) {
 
-	}
+	buffer[length++] = val & 255;
+	buffer[length++] = val >> 8;
 
-	// Check that the config file was opened
-	if (!file) {
+	return;
 
-		logError("Could not write configuration file",
-			"File could not be opened.");
+}
 
-		return;
 
-	}
+/**
+ * Add a signed int to a buffer, in the order File::storeInt() uses.
+ *
+ * @param buffer The buffer
+ * @param length The length of the buffer's contents, which is increased
+ * @param val The value
+ */
+static void storeInt (unsigned char* buffer, int& length, signed int val) {
+
+	unsigned int uval;
+
+	uval = *((unsigned int *)&val);
+
+	buffer[length++] = uval & 255;
+	buffer[length++] = (uval >> 8) & 255;
+	buffer[length++] = (uval >> 16) & 255;
+	buffer[length++] = uval >> 24;
+
+	return;
+
+}
+
+
+/**
+ * Write the settings into a buffer, laid out as in the configuration file.
+ *
+ * @param buffer Buffer of SETUP_SIZE bytes
+ *
+ * @return The length of the settings
+ */
+int Setup::serialise (unsigned char* buffer) {
 
+	int length;
+	int count;
+	int videoScale;
+
+	length = 0;
 
 	// Write the version number
-	file->storeChar(5);
+	storeChar(buffer, length, 5);
 
 	// Write video settings
-	file->storeShort(video.getWidth());
-	file->storeShort(video.getHeight());
+	storeShort(buffer, length, video.getWidth());
+	storeShort(buffer, length, video.getHeight());
 #ifdef SCALE
 	videoScale = video.getScaleFactor();
 #else
@@ -229,57 +317,167 @@ void Setup::save () {
 #ifndef FULLSCREEN_ONLY
 	videoScale |= video.isFullscreen()? 1: 0;
 #endif
-	file->storeChar(videoScale);
+	storeChar(buffer, length, videoScale);
 
 
 	// Write controls
 	for (count = 0; count < CONTROLS - 4; count++)
-		file->storeInt(controls.getKey(count));
+		storeInt(buffer, length, controls.getKey(count));
 
 	for (count = 0; count < CONTROLS; count++)
-		file->storeInt(controls.getButton(count));
+		storeInt(buffer, length, controls.getButton(count));
 
 	for (count = 0; count < CONTROLS; count++) {
 
-		file->storeInt(controls.getAxis(count));
-		file->storeInt(controls.getAxisDirection(count));
+		storeInt(buffer, length, controls.getAxis(count));
+		storeInt(buffer, length, controls.getAxisDirection(count));
 
 	}
 
 	for (count = 0; count < CONTROLS; count++) {
 
-		file->storeInt(controls.getHat(count));
-		file->storeInt(controls.getHatDirection(count));
+		storeInt(buffer, length, controls.getHat(count));
+		storeInt(buffer, length, controls.getHatDirection(count));
 
 	}
 
 	// Write the player's name
 	for (count = 0; count < STRING_LENGTH; count++)
-		file->storeChar(setup.characterName[count]);
+		storeChar(buffer, length, characterName[count]);
 
 	// Write the player's colour
-	file->storeChar(setup.characterCols[0]);
-	file->storeChar(setup.characterCols[1]);
-	file->storeChar(setup.characterCols[2]);
-	file->storeChar(setup.characterCols[3]);
+	storeChar(buffer, length, characterCols[0]);
+	storeChar(buffer, length, characterCols[1]);
+	storeChar(buffer, length, characterCols[2]);
+	storeChar(buffer, length, characterCols[3]);
 
 	// Write the music and sound effect volume
-	file->storeChar(getMusicVolume());
-	file->storeChar(getSoundVolume());
+	storeChar(buffer, length, getMusicVolume());
+	storeChar(buffer, length, getSoundVolume());
 
 	// Write gameplay options
 
 	count = 0;
 
-	if (setup.slowMotion) count |= 4;
-	if (setup.manyBirds) count |= 1;
-	if (setup.leaveUnneeded) count |= 2;
+	if (slowMotion) count |= 4;
+	if (manyBirds) count |= 1;
+	if (leaveUnneeded) count |= 2;
+	if (rollback) count |= 8;
+
+	storeChar(buffer, length, count);
+
+	// Write the server's client limit
+	storeChar(buffer, length, maxClients);
 
-	file->storeChar(count);
+	// Write the display options
+	storeChar(buffer, length, (dynamicResolution? 16: 0) | (paceTarget << 1) | (integerScale? 1: 0));
 
+	return length;
 
+}
+
+
+/**
+ * Write the settings to a new file, which then replaces the configuration
+ * file, so that an interrupted write leaves the old file whole. Run in the
+ * background.
+ *
+ * @param data The setup
+ */
+void Setup::write (void* data) {
+
+	Setup* owner;
+	File* file;
+	char* tempPath;
+	char* filePath;
+
+	owner = (Setup*)data;
+
+	try {
+
+		file = new File(CONFIG_FILE CONFIG_TEMP_SUFFIX, true);
+
+	} catch (int e) {
+
+		logError("Could not write configuration file",
+			"File could not be opened.");
+
+		return;
+
+	}
+
+	file->storeBlock(owner->contents, owner->writeLength);
+
+	tempPath = createString(file->getPath());
+
+	// Closing the file flushes it
 	delete file;
 
+	// The new file sits beside the one it replaces
+	filePath = createString(tempPath);
+	filePath[strlen(filePath) - strlen(CONFIG_TEMP_SUFFIX)] = 0;
+
+	// Some platforms will not rename over an existing file
+	if (rename(tempPath, filePath)) {
+
+		remove(filePath);
+
+		if (rename(tempPath, filePath)) logError("Could not write configuration file", filePath);
+
+	}
+
+	delete[] filePath;
+	delete[] tempPath;
+
+	return;
+
+}
+
+
+/**
+ * Save settings to config file in the background, if they have changed since
+ * it was last read or written. Called as the setup menu is left, so that any
+ * number of changes made there are written once.
+ */
+void Setup::save () {
+
+	unsigned char buffer[SETUP_SIZE];
+	int newLength;
+
+	newLength = serialise(buffer);
+
+	if ((newLength == savedLength) && !memcmp(buffer, saved, newLength)) return;
+
+	// The job may still be reading the last settings written
+	finish();
+
+	memcpy(contents, buffer, newLength);
+	writeLength = newLength;
+	memcpy(saved, buffer, newLength);
+	savedLength = newLength;
+
+	// Without worker threads, the file is written now
+	jobs.prepare(&saveJob, write, this, NULL, true);
+	jobs.submit(&saveJob);
+
+	saving = true;
+
+	return;
+
+}
+
+
+/**
+ * Wait for settings being saved to be written. Must be called before the job
+ * system stops.
+ */
+void Setup::finish () {
+
+	if (!saving) return;
+
+	jobs.wait(&saveJob);
+
+	saving = false;
 
 	return;
 
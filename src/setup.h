@@ -23,28 +23,54 @@
 #define _SETUP_H
 
 
+#include "io/controls.h"
 #include "player/player.h"
+#include "jobs.h"
+#include "pacer.h"
 
 #include "OpenJazz.h"
 
 
+// Constant
+
+#define SETUP_SIZE (6 + ((CONTROLS - 4) * 4) + (CONTROLS * 20) + STRING_LENGTH + 9) /* Largest configuration file */
+
+
 // Class
 
 /// Configuration
 class Setup {
 
+	private:
+		unsigned char saved[SETUP_SIZE]; ///< The configuration file's contents, as last read or written
+		int           savedLength; ///< Length of the configuration file, or 0 if unknown
+		unsigned char contents[SETUP_SIZE]; ///< Settings being written in the background
+		int           writeLength; ///< Length of the settings being written
+		Job           saveJob; ///< Job writing the settings
+		bool          saving; ///< Whether or not the job has been submitted and not waited for
+
+		static void write     (void* data);
+		int         serialise (unsigned char* buffer);
+
 	public:
 		char*         characterName;
 		unsigned char characterCols[PCOLOURS];
 		bool          slowMotion;
 		bool          leaveUnneeded;
 		bool          manyBirds;
+		bool          rollback; ///< Whether to roll back for late controls in small battles and races
+		int           maxClients; ///< Most clients a server accepts
+		int           localPlayers; ///< Players sharing the screen in local games
+		bool          integerScale; ///< Whether to only enlarge the canvas by whole multiples
+		bool          dynamicResolution; ///< Whether to shrink the canvas in levels when frames take too long
+		PaceTarget    paceTarget; ///< How often frames are shown
 
 		Setup  ();
 		~Setup ();
 
-		void load (int* videoW, int* videoH, bool* fullscreen, int* videoScale);
-		void save ();
+		void load   (int* videoW, int* videoH, bool* fullscreen, int* videoScale);
+		void save   ();
+		void finish ();
 
 };
 
@@ -41,25 +41,12 @@
  */
 bool fileExists (const char * fileName) {
 
-	File *file;
-
 #ifdef VERBOSE
 	printf("Check: ");
 #endif
 
-	try {
-
-		file = new File(fileName, false);
-
-	} catch (int e) {
-
-		return false;
-
-	}
-
-	delete file;
-
-	return true;
+	// Only look for the file, rather than reading it
+	return hasFile(fileName);
 
 }
 
@@ -131,13 +118,11 @@ char * createString (const char *string) {
  */
 char * createString (const char *first, const char *second) {
 
-	char *concatenated;
+	int size;
 
-	concatenated = new char[strlen(first) + strlen(second) + 1];
-	strcpy(concatenated, first);
-	strcat(concatenated, second);
+	size = strlen(first) + strlen(second) + 1;
 
-	return concatenated;
+	return writeString(new char[size], size, first, second);
 
 }
 
@@ -152,19 +137,11 @@ char * createString (const char *first, const char *second) {
  */
 char * createFileName (const char *type, int extension) {
 
-	char *fileName;
-	int pos;
+	int size;
 
-	pos = strlen(type);
-	fileName = new char[pos + 5];
-	strcpy(fileName, type);
-	fileName[pos++] = '.';
-	fileName[pos++] = '0' + ((extension / 100) % 10);
-	fileName[pos++] = '0' + ((extension / 10) % 10);
-	fileName[pos++] = '0' + (extension % 10);
-	fileName[pos] = 0;
+	size = strlen(type) + 5;
 
-	return fileName;
+	return writeFileName(new char[size], size, type, extension);
 
 }
 
@@ -179,16 +156,11 @@ char * createFileName (const char *type, int extension) {
  */
 char * createFileName (const char *type, const char *extension) {
 
-	char *fileName;
-	int pos;
+	int size;
 
-	pos = strlen(type);
-	fileName = new char[pos + strlen(extension) + 2];
-	strcpy(fileName, type);
-	fileName[pos++] = '.';
-	strcpy(fileName + pos, extension);
+	size = strlen(type) + strlen(extension) + 2;
 
-	return fileName;
+	return writeFileName(new char[size], size, type, extension);
 
 }
 
@@ -205,20 +177,130 @@ char * createFileName (const char *type, const char *extension) {
  */
 char * createFileName (const char *type, int level, int extension) {
 
-	char *fileName;
+	int size;
+
+	size = strlen(type) + 6;
+
+	return writeFileName(new char[size], size, type, level, extension);
+
+}
+
+
+/**
+ * Write the concatenation of two strings into a buffer, instead of allocating
+ * a new string.
+ *
+ * @param buffer The buffer
+ * @param size The size of the buffer
+ * @param first The string to form the start
+ * @param second The string to form the end
+ *
+ * @return The buffer, or NULL if the strings do not fit
+ */
+char * writeString (char *buffer, int size, const char *first, const char *second) {
+
+	int pos;
+
+	pos = strlen(first);
+
+	if (pos + (int)strlen(second) >= size) return NULL;
+
+	strcpy(buffer, first);
+	strcpy(buffer + pos, second);
+
+	return buffer;
+
+}
+
+
+/**
+ * Write a file name with a 3-digit numerical extension into a buffer, instead
+ * of allocating a new string.
+ *
+ * @param buffer The buffer
+ * @param size The size of the buffer
+ * @param type The pre-dot file name
+ * @param extension The number to constitute the extension
+ *
+ * @return The buffer, or NULL if the file name does not fit
+ */
+char * writeFileName (char *buffer, int size, const char *type, int extension) {
+
 	int pos;
 
 	pos = strlen(type);
-	fileName = new char[pos + 6];
-	strcpy(fileName, type);
-	fileName[pos++] = '0' + (level % 10);
-	fileName[pos++] = '.';
-	fileName[pos++] = '0' + ((extension / 100) % 10);
-	fileName[pos++] = '0' + ((extension / 10) % 10);
-	fileName[pos++] = '0' + (extension % 10);
-	fileName[pos] = 0;
 
-	return fileName;
+	if (pos + 5 > size) return NULL;
+
+	strcpy(buffer, type);
+	buffer[pos++] = '.';
+	buffer[pos++] = '0' + ((extension / 100) % 10);
+	buffer[pos++] = '0' + ((extension / 10) % 10);
+	buffer[pos++] = '0' + (extension % 10);
+	buffer[pos] = 0;
+
+	return buffer;
+
+}
+
+
+/**
+ * Write a file name with the given extension into a buffer, instead of
+ * allocating a new string.
+ *
+ * @param buffer The buffer
+ * @param size The size of the buffer
+ * @param type The pre-dot file name
+ * @param extension The extension
+ *
+ * @return The buffer, or NULL if the file name does not fit
+ */
+char * writeFileName (char *buffer, int size, const char *type, const char *extension) {
+
+	int pos;
+
+	pos = strlen(type);
+
+	if (pos + (int)strlen(extension) + 2 > size) return NULL;
+
+	strcpy(buffer, type);
+	buffer[pos++] = '.';
+	strcpy(buffer + pos, extension);
+
+	return buffer;
+
+}
+
+
+/**
+ * Write a file name with a 1-digit numerical suffix and a 3-digit numerical
+ * extension into a buffer, instead of allocating a new string.
+ *
+ * @param buffer The buffer
+ * @param size The size of the buffer
+ * @param type The pre-dot file name
+ * @param level The number to constitute the suffix
+ * @param extension The number to constitute the extension
+ *
+ * @return The buffer, or NULL if the file name does not fit
+ */
+char * writeFileName (char *buffer, int size, const char *type, int level, int extension) {
+
+	int pos;
+
+	pos = strlen(type);
+
+	if (pos + 6 > size) return NULL;
+
+	strcpy(buffer, type);
+	buffer[pos++] = '0' + (level % 10);
+	buffer[pos++] = '.';
+	buffer[pos++] = '0' + ((extension / 100) % 10);
+	buffer[pos++] = '0' + ((extension / 10) % 10);
+	buffer[pos++] = '0' + (extension % 10);
+	buffer[pos] = 0;
+
+	return buffer;
 
 }
 
@@ -300,31 +382,3 @@ void logError (const char *message, const char *detail) {
 
 }
 
-
-/**
- * Get the sine of the given angle
- *
- * @param angle The given angle (where 1024 represents a full circle)
- *
- * @return The sine of the angle
- */
-fixed fSin (fixed angle) {
-
-	return sinLut[angle & 1023];
-
-}
-
-
-/**
- * Get the cosine of the given angle
- *
- * @param angle The given angle (where 1024 represetns a full circle)
- *
- * @return The cosine of the angle
- */
-fixed fCos (fixed angle) {
-
-	return sinLut[(angle + 256) & 1023];
-
-}
-
@@ -36,12 +36,6 @@
 #endif
 
 
-// Variable
-
-/// Trigonometric function look-up table
-EXTERN fixed sinLut[1024];
-
-
 // Functions
 
 EXTERN bool               fileExists           (const char *fileName);
@@ -53,12 +47,14 @@ EXTERN char*              createFileName       (const char *type, int extension)
 EXTERN char*              createFileName       (const char *type, const char *extension);
 EXTERN char*              createFileName       (const char *type, int level, int extension);
 EXTERN char*              createEditableString (const char *string);
+EXTERN char*              writeString          (char *buffer, int size, const char *first, const char *second);
+EXTERN char*              writeFileName        (char *buffer, int size, const char *type, int extension);
+EXTERN char*              writeFileName        (char *buffer, int size, const char *type, const char *extension);
+EXTERN char*              writeFileName        (char *buffer, int size, const char *type, int level, int extension);
 EXTERN void               log                  (const char *message);
 EXTERN void               log                  (const char *message, const char *detail);
 EXTERN void               log                  (const char *message, int number);
 EXTERN void               logError             (const char *message, const char *detail);
-EXTERN fixed              fSin                 (fixed angle);
-EXTERN fixed              fCos                 (fixed angle);
 
 #endif
 